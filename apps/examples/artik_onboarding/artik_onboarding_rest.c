@@ -501,6 +501,12 @@ artik_error StartWebServer(bool start, enum ApiSet api_set)
 			return E_NOT_INITIALIZED;
 		}
 
+		/*
+		 * This runs on a thread started by a callback, stop first so that
+		 * the response of that callback is sent before its route goes.
+		 */
+		http_server_stop(https_server);
+
 		if (api_set & API_SET_WIFI) {
 			http_server_deregister_cb(https_server, HTTP_METHOD_GET, API_WIFI_ACCESS_POINTS);
 			http_server_deregister_cb(https_server, HTTP_METHOD_POST, API_WIFI_CONFIG);
@@ -512,7 +518,6 @@ artik_error StartWebServer(bool start, enum ApiSet api_set)
 			http_server_deregister_cb(https_server, HTTP_METHOD_PUT, API_CLOUD_REGISTRATION);
 		}
 
-		http_server_stop(https_server);
 		http_server_release(&https_server);
 		https_server = NULL;
 		printf("Web server stopped\n");
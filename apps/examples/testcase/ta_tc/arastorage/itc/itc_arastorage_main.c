@@ -21,6 +21,7 @@
 #include <tinyara/config.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <arastorage/arastorage.h>
 #include <apps/shell/tash.h>
 #include <tinyara/fs/fs_utils.h>
@@ -39,6 +40,7 @@
 #define QUERY_LENGTH 128
 
 #define DATA_SET_NUM 10
+#define BENCHMARK_ROWS 100
 
  /****************************************************************************
  *  Global Variables
@@ -630,6 +632,75 @@ void itc_arastorage_cursor_get_string_value_p(void)
 }
 
 
+static long itc_arastorage_elapsed_us(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000L;
+}
+
+/**
+* @testcase             itc_arastorage_db_prepare_benchmark_p
+* @brief                To compare repeated inserts through db_exec with a prepared statement
+* @scenario             Inserts BENCHMARK_ROWS tuples each way and prints the elapsed time of both
+* @apicovered           db_exec, db_prepare, db_bind_int, db_bind_long, db_step, db_finalize
+* @precondition         Database resource must be initialized
+* @postcondition        NA
+*/
+void itc_arastorage_db_prepare_benchmark_p(void)
+{
+    db_result_t ret;
+    db_stmt_t *stmt;
+    struct timespec start;
+    struct timespec end;
+    long exec_us;
+    long step_us;
+    int index;
+
+    snprintf(g_query, QUERY_LENGTH, "CREATE RELATION %s;", RELATION_NAME_QUERY);
+    ret = db_exec(g_query);
+    TC_ASSERT_EQ("db_exec", ret, DB_OK);
+    snprintf(g_query, QUERY_LENGTH, "CREATE ATTRIBUTE %s DOMAIN int IN %s;", g_attribute_set[0],
+             RELATION_NAME_QUERY);
+    ret = db_exec(g_query);
+    TC_ASSERT_EQ("db_exec", ret, DB_OK);
+    snprintf(g_query, QUERY_LENGTH, "CREATE ATTRIBUTE %s DOMAIN long IN %s;", g_attribute_set[1],
+             RELATION_NAME_QUERY);
+    ret = db_exec(g_query);
+    TC_ASSERT_EQ("db_exec", ret, DB_OK);
+
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (index = 0; index < BENCHMARK_ROWS; index++) {
+        snprintf(g_query, QUERY_LENGTH, "INSERT (%d, %ld) INTO %s;", index,
+                 g_arastorage_data_set[0].long_value + index, RELATION_NAME_QUERY);
+        ret = db_exec(g_query);
+        TC_ASSERT_EQ("db_exec", ret, DB_OK);
+    }
+    clock_gettime(CLOCK_REALTIME, &end);
+    exec_us = itc_arastorage_elapsed_us(&start, &end);
+
+    snprintf(g_query, QUERY_LENGTH, "INSERT (?, ?) INTO %s;", RELATION_NAME_QUERY);
+    clock_gettime(CLOCK_REALTIME, &start);
+    stmt = db_prepare(g_query);
+    TC_ASSERT_NEQ("db_prepare", stmt, NULL);
+    for (index = 0; index < BENCHMARK_ROWS; index++) {
+        db_bind_int(stmt, 0, BENCHMARK_ROWS + index);
+        db_bind_long(stmt, 1, g_arastorage_data_set[0].long_value + index);
+        ret = db_step(stmt, NULL);
+        TC_ASSERT_EQ_CLEANUP("db_step", ret, DB_OK, db_get_result_message(ret), db_finalize(stmt));
+    }
+    ret = db_finalize(stmt);
+    clock_gettime(CLOCK_REALTIME, &end);
+    TC_ASSERT_EQ("db_finalize", ret, DB_OK);
+    step_us = itc_arastorage_elapsed_us(&start, &end);
+
+    printf("%d inserts : db_exec %ld us, db_step %ld us\n", BENCHMARK_ROWS, exec_us, step_us);
+
+    snprintf(g_query, QUERY_LENGTH, "REMOVE RELATION %s;", RELATION_NAME_QUERY);
+    ret = db_exec(g_query);
+    TC_ASSERT_EQ("db_exec", ret, DB_OK);
+
+    TC_SUCCESS_RESULT();
+}
+
 
 int itc_arastorage_launcher(int argc, FAR char *argv[])
 {
@@ -659,6 +730,7 @@ int itc_arastorage_launcher(int argc, FAR char *argv[])
         itc_arastorage_cursor_get_double_value_p();
 #endif
         itc_arastorage_cursor_get_string_value_p();
+        itc_arastorage_db_prepare_benchmark_p();
     } else {
         printf("Startup FAIL\n");
     }
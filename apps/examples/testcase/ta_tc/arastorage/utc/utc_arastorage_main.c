@@ -39,6 +39,7 @@
 #define QUERY_LENGTH 128
 
 #define DATA_SET_NUM 10
+#define BTREE_TUPLE_NUM 5000
 /****************************************************************************
  *  Global Variables
  ****************************************************************************/
@@ -358,6 +359,462 @@ void utc_arastorage_db_query_tc_n(void)
 	printf("PASS!\n");
 }
 
+void utc_arastorage_db_prepare_tc_p(void)
+{
+	db_result_t res;
+	db_stmt_t *stmt;
+	db_cursor_t *cursor;
+	char query[QUERY_LENGTH];
+	char fruit[32];
+	int i;
+
+	printf("%d. db_prepare Positive Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	snprintf(query, QUERY_LENGTH, "INSERT (?, ?, ?) INTO %s;", RELATION_NAME);
+	stmt = db_prepare(query);
+	if (stmt == NULL) {
+		printf("db_prepare Failed(Insert)\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	for (i = 0; i < DATA_SET_NUM; i++) {
+		memset(fruit, 0, sizeof(fruit));
+		strncpy(fruit, g_arastorage_data_set[i].string_value, sizeof(fruit) - 1);
+		if (DB_ERROR(db_bind_int(stmt, 0, g_arastorage_data_set[i].int_value + DATA_SET_NUM)) ||
+			DB_ERROR(db_bind_long(stmt, 1, g_arastorage_data_set[i].long_value)) ||
+			DB_ERROR(db_bind_string(stmt, 2, fruit))) {
+			printf("db_bind Failed Tuple Row : %d\n", i);
+			db_finalize(stmt);
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+		res = db_step(stmt, NULL);
+		if (DB_ERROR(res)) {
+			printf("db_step Failed(Insert Data) res : %d Tuple Row : %d\n", res, i);
+			db_finalize(stmt);
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+	}
+	db_finalize(stmt);
+
+	snprintf(query, QUERY_LENGTH, "SELECT %s, %s FROM %s WHERE %s > ?;", g_attribute_set[0],
+			 g_attribute_set[1], RELATION_NAME, g_attribute_set[0]);
+	stmt = db_prepare(query);
+	if (stmt == NULL) {
+		printf("db_prepare Failed(Select)\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	/* The same plan answers a different question on every step */
+	for (i = 0; i < DATA_SET_NUM; i++) {
+		db_bind_int(stmt, 0, DATA_SET_NUM + i);
+		res = db_step(stmt, &cursor);
+		if (DB_ERROR(res) || cursor == NULL) {
+			printf("db_step Failed(Select) res : %d\n", res);
+			db_finalize(stmt);
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+		if (cursor_get_count(cursor) != DATA_SET_NUM - i) {
+			printf("db_step Failed : %d rows, expected %d\n", cursor_get_count(cursor), DATA_SET_NUM - i);
+			db_cursor_free(cursor);
+			db_finalize(stmt);
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+		db_cursor_free(cursor);
+	}
+
+	res = db_finalize(stmt);
+	if (DB_ERROR(res)) {
+		printf("db_finalize Failed : %d\n", res);
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	printf("PASS!\n");
+}
+
+void utc_arastorage_db_prepare_tc_n(void)
+{
+	db_stmt_t *stmt;
+	db_cursor_t *cursor;
+	char query[QUERY_LENGTH];
+
+	printf("%d. db_prepare Negative Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	/* Try to prepare NULL and a broken query */
+	if (db_prepare(NULL) != NULL || db_prepare("SELECT FROM;") != NULL) {
+		printf("db_prepare Failed with invalid query\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* Parameters are only accepted by prepared statements */
+	snprintf(query, QUERY_LENGTH, "INSERT (?, 1, 'a') INTO %s;", RELATION_NAME);
+	if (DB_SUCCESS(db_exec(query))) {
+		printf("db_exec Failed : unbound parameter accepted\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	snprintf(query, QUERY_LENGTH, "SELECT %s FROM %s WHERE %s > ?;", g_attribute_set[0],
+			 RELATION_NAME, g_attribute_set[0]);
+	stmt = db_prepare(query);
+	if (stmt == NULL) {
+		printf("db_prepare Failed\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* Try to step without bound parameters, bind out of range and bind a string to a condition */
+	if (DB_SUCCESS(db_step(stmt, &cursor)) || DB_SUCCESS(db_bind_int(stmt, 1, 0)) ||
+		DB_SUCCESS(db_bind_string(stmt, 0, "apple"))) {
+		printf("db_step Failed with invalid parameters\n");
+		db_finalize(stmt);
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_finalize(stmt);
+
+	if (DB_SUCCESS(db_step(NULL, &cursor)) || DB_SUCCESS(db_finalize(NULL))) {
+		printf("db_step Failed with NULL statement\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	printf("PASS!\n");
+}
+
+void utc_arastorage_db_query_stream_tc_p(void)
+{
+	db_cursor_t *cursor;
+	char query[QUERY_LENGTH];
+	int rows;
+
+	printf("%d. db_query_stream Positive Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	snprintf(query, QUERY_LENGTH, "SELECT %s, %s FROM %s WHERE %s > 0 LIMIT 3;", g_attribute_set[0],
+			 g_attribute_set[1], RELATION_NAME, g_attribute_set[0]);
+	cursor = db_query_stream(query);
+	if (cursor == NULL) {
+		printf("db_query_stream Failed\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* Rows appear one by one, and the scan stops at the limit */
+	rows = 0;
+	if (DB_SUCCESS(cursor_move_first(cursor))) {
+		do {
+			if (cursor_get_int_value(cursor, 0) <= 0) {
+				break;
+			}
+			rows++;
+		} while (DB_SUCCESS(cursor_move_next(cursor)));
+	}
+	if (rows != 3 || cursor_get_count(cursor) != 3 || !cursor_is_last_row(cursor)) {
+		printf("db_query_stream Failed : %d rows\n", rows);
+		db_cursor_free(cursor);
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_cursor_free(cursor);
+	printf("PASS!\n");
+}
+
+void utc_arastorage_db_query_stream_tc_n(void)
+{
+	db_cursor_t *cursor;
+	char query[QUERY_LENGTH];
+
+	printf("%d. db_query_stream Negative Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	if (db_query_stream(NULL) != NULL) {
+		printf("db_query_stream Failed with NULL value\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	snprintf(query, QUERY_LENGTH, "SELECT %s FROM %s LIMIT 0;", g_attribute_set[0], RELATION_NAME);
+	if (db_query_stream(query) != NULL) {
+		printf("db_query_stream Failed with LIMIT 0\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	snprintf(query, QUERY_LENGTH, "SELECT %s, %s FROM %s WHERE %s > 0;", g_attribute_set[0],
+			 g_attribute_set[1], RELATION_NAME, g_attribute_set[0]);
+	cursor = db_query_stream(query);
+	if (cursor == NULL) {
+		printf("db_query_stream Failed\n");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* A streaming cursor does not move backwards */
+	cursor_move_first(cursor);
+	cursor_move_next(cursor);
+	if (DB_SUCCESS(cursor_move_prev(cursor)) || DB_SUCCESS(cursor_move_first(cursor))) {
+		printf("db_query_stream Failed : cursor moved backwards\n");
+		db_cursor_free(cursor);
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_cursor_free(cursor);
+	printf("PASS!\n");
+}
+
+void utc_arastorage_db_query_snapshot_tc_p(void)
+{
+	db_cursor_t *old_cursor;
+	db_cursor_t *cursor;
+	db_result_t res;
+	char query[QUERY_LENGTH];
+	int rows;
+	int i;
+
+	printf("%d. db_query snapshot Positive Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	res = db_exec("CREATE RELATION snap;");
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE id DOMAIN int IN snap;");
+	}
+	for (i = 1; DB_SUCCESS(res) && i <= DATA_SET_NUM; i++) {
+		snprintf(query, QUERY_LENGTH, "INSERT (%d) INTO snap;", i);
+		res = db_exec(query);
+	}
+	if (DB_ERROR(res)) {
+		printf("db_exec Failed(Fill relation) : %d\n", res);
+		db_exec("REMOVE RELATION snap;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	old_cursor = db_query("SELECT id FROM snap;");
+	if (old_cursor == NULL) {
+		printf("db_query Failed\n");
+		db_exec("REMOVE RELATION snap;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* Tuples removed and inserted later stay out of sight of the open cursor */
+	cursor = db_query("REMOVE FROM snap WHERE id > 5;");
+	if (cursor != NULL) {
+		db_cursor_free(cursor);
+	}
+	db_exec("INSERT (100) INTO snap;");
+
+	rows = 0;
+	if (DB_SUCCESS(cursor_move_first(old_cursor))) {
+		do {
+			if (cursor_get_int_value(old_cursor, 0) != rows + 1) {
+				break;
+			}
+			rows++;
+		} while (DB_SUCCESS(cursor_move_next(old_cursor)));
+	}
+	db_cursor_free(old_cursor);
+	if (rows != DATA_SET_NUM) {
+		printf("db_query Failed : old cursor read %d rows\n", rows);
+		db_exec("REMOVE RELATION snap;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	cursor = db_query("SELECT id FROM snap;");
+	if (cursor == NULL || cursor_get_count(cursor) != 6) {
+		printf("db_query Failed : removal not visible to a new query\n");
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		db_exec("REMOVE RELATION snap;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_cursor_free(cursor);
+	db_exec("REMOVE RELATION snap;");
+	printf("PASS!\n");
+}
+
+void utc_arastorage_db_exec_btree_tc_p(void)
+{
+	db_cursor_t *cursor;
+	db_result_t res;
+	char query[QUERY_LENGTH];
+	int i;
+
+	printf("%d. db_exec of BTREE indexed relation Positive Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	res = db_exec("CREATE RELATION big;");
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE id DOMAIN long IN big;");
+	}
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE INDEX big.id TYPE BTREE;");
+	}
+	if (DB_ERROR(res)) {
+		printf("db_exec Failed(Create indexed relation) : %d\n", res);
+		db_exec("REMOVE RELATION big;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* A BTREE indexed relation is not bound to the tuple limit of the others */
+	for (i = 0; i < BTREE_TUPLE_NUM; i++) {
+		snprintf(query, QUERY_LENGTH, "INSERT (%d) INTO big;", i);
+		res = db_exec(query);
+		if (DB_ERROR(res)) {
+			printf("db_exec Failed(Insert into indexed relation) : row %d, %d\n", i, res);
+			db_exec("REMOVE RELATION big;");
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+	}
+
+	cursor = db_query("SELECT id FROM big;");
+	if (cursor == NULL || cursor_get_count(cursor) != BTREE_TUPLE_NUM) {
+		printf("db_query Failed : indexed relation lost tuples\n");
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		db_exec("REMOVE RELATION big;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_cursor_free(cursor);
+
+	snprintf(query, QUERY_LENGTH, "SELECT id FROM big WHERE id >= %d AND id < %d;", BTREE_TUPLE_NUM - 1000, BTREE_TUPLE_NUM - 500);
+	cursor = db_query(query);
+	if (cursor == NULL || cursor_get_count(cursor) != 500 || DB_ERROR(cursor_move_first(cursor)) || cursor_get_long_value(cursor, 0) != BTREE_TUPLE_NUM - 1000) {
+		printf("db_query Failed : wrong range from the BTREE index\n");
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		db_exec("REMOVE RELATION big;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_cursor_free(cursor);
+	db_exec("REMOVE RELATION big;");
+	printf("PASS!\n");
+}
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+void utc_arastorage_db_exec_columnar_tc_p(void)
+{
+	db_cursor_t *cursor;
+	db_result_t res;
+	char query[QUERY_LENGTH];
+	double sum;
+	int rows;
+	int i;
+
+	printf("%d. db_exec of COLUMNAR relation Positive Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	res = db_exec("CREATE RELATION series TYPE COLUMNAR;");
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE stamp DOMAIN long IN series;");
+	}
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE level DOMAIN int IN series;");
+	}
+	if (DB_ERROR(res)) {
+		printf("db_exec Failed(Create columnar relation) : %d\n", res);
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	/* Enough rows to seal at least one block and leave some in the tail */
+	rows = CONFIG_ARASTORAGE_COLUMN_BLOCK_ROWS + CONFIG_ARASTORAGE_COLUMN_BLOCK_ROWS / 2;
+	sum = 0;
+	for (i = 0; i < rows; i++) {
+		snprintf(query, QUERY_LENGTH, "INSERT (%d, %d) INTO series;", 1000 + i * 10, i % 8);
+		if (DB_ERROR(db_exec(query))) {
+			printf("db_exec Failed(Insert into columnar relation) : row %d\n", i);
+			db_exec("REMOVE RELATION series;");
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+		sum += i % 8;
+	}
+
+	cursor = db_query("SELECT COUNT(stamp), SUM(level) FROM series;");
+	if (cursor == NULL || DB_ERROR(cursor_move_first(cursor))) {
+		printf("db_query Failed on columnar relation\n");
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		db_exec("REMOVE RELATION series;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+#ifdef CONFIG_ARCH_FLOAT_H
+	if (cursor_get_double_value(cursor, 0) != rows || cursor_get_double_value(cursor, 1) != sum) {
+		printf("db_query Failed on columnar relation : wrong aggregate\n");
+		db_cursor_free(cursor);
+		db_exec("REMOVE RELATION series;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+#endif
+	db_cursor_free(cursor);
+	db_exec("REMOVE RELATION series;");
+	printf("PASS!\n");
+}
+#endif
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+void utc_arastorage_db_exec_memory_tc_p(void)
+{
+	db_cursor_t *cursor;
+	db_result_t res;
+	char query[QUERY_LENGTH];
+	int rows;
+	int i;
+
+	printf("%d. db_exec of MEMORY relation Positive Unit Test started. Please wait...\n", g_arastorage_tc_count++);
+
+	res = db_exec("CREATE RELATION cache TYPE MEMORY;");
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE id DOMAIN int IN cache;");
+	}
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE level DOMAIN int IN cache;");
+	}
+	if (DB_ERROR(res)) {
+		printf("db_exec Failed(Create memory relation) : %d\n", res);
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+
+	rows = 32;
+	for (i = 0; i < rows; i++) {
+		snprintf(query, QUERY_LENGTH, "INSERT (%d, %d) INTO cache;", i, i % 4);
+		if (DB_ERROR(db_exec(query))) {
+			printf("db_exec Failed(Insert into memory relation) : row %d\n", i);
+			db_exec("REMOVE RELATION cache;");
+			g_arastorage_tc_fail_count++;
+			return;
+		}
+	}
+
+	cursor = db_query("SELECT id, level FROM cache WHERE id >= 16;");
+	if (cursor == NULL || cursor_get_count(cursor) != rows - 16) {
+		printf("db_query Failed on memory relation\n");
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		db_exec("REMOVE RELATION cache;");
+		g_arastorage_tc_fail_count++;
+		return;
+	}
+	db_cursor_free(cursor);
+	db_exec("REMOVE RELATION cache;");
+	printf("PASS!\n");
+}
+#endif
+
 void utc_arastorage_db_get_result_message_tc_p(void)
 {
 	db_result_t res;
@@ -1428,6 +1885,16 @@ int arastorage_sample_launcher(int argc, FAR char *argv[])
 	utc_arastorage_db_init_tc_p();
 	utc_arastorage_db_exec_tc_p();
 	utc_arastorage_db_query_tc_p();
+	utc_arastorage_db_prepare_tc_p();
+	utc_arastorage_db_query_stream_tc_p();
+	utc_arastorage_db_query_snapshot_tc_p();
+	utc_arastorage_db_exec_btree_tc_p();
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	utc_arastorage_db_exec_columnar_tc_p();
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	utc_arastorage_db_exec_memory_tc_p();
+#endif
 	utc_arastorage_db_get_result_message_tc_p();
 	utc_arastorage_db_print_header_tc_p();
 	utc_arastorage_db_print_tuple_tc_p();
@@ -1466,6 +1933,8 @@ int arastorage_sample_launcher(int argc, FAR char *argv[])
 	db_init();
 	utc_arastorage_db_exec_tc_n();
 	utc_arastorage_db_query_tc_n();
+	utc_arastorage_db_prepare_tc_n();
+	utc_arastorage_db_query_stream_tc_n();
 	utc_arastorage_db_get_result_message_tc_n();
 	utc_arastorage_db_print_header_tc_n();
 	utc_arastorage_db_print_tuple_tc_n();
@@ -0,0 +1,299 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+* @testcase		http_load_01 (server)
+* @brief		To measure the throughput and the latency of the HTTP server.
+*			It starts a HTTP server on port 8080 and sends keep-alive GET requests to it from local clients.
+* @scenario		1. Run the load test at TASH using the command "webserver loadtest [clients] [requests]".
+*			2. Check the requests per second and the p99 latency printed at the end.
+*			   Both only count the answered requests, the failed ones are reported as errors.
+* @apicovered		http_server_init, http_server_start, http_server_stop, http_send_response
+* @precondition		The loopback interface is enabled.
+* @postcondition
+*/
+
+#include <tinyara/config.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <apps/netutils/webserver/http_server.h>
+
+#define LOADTEST_PORT         8080
+#define LOADTEST_CLIENTS      4
+#define LOADTEST_MAX_CLIENTS  8
+#define LOADTEST_REQUESTS     200
+#define LOADTEST_STACK_SIZE   (1024 * 4)
+#define LOADTEST_BUF_SIZE     256
+
+struct loadtest_client {
+	pthread_t tid;
+	int nrequests;
+	int nerrors;
+	int nanswered;
+	uint32_t *latency;		/* usec of each answered request */
+};
+
+static const char g_loadtest_request[] = "GET /loadtest HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+
+static void loadtest_get_callback(struct http_client_t *client, struct http_req_message *req)
+{
+	if (http_send_response(client, 200, "OK", NULL) < 0) {
+		printf("Error: Fail to send response\n");
+	}
+}
+
+static uint32_t loadtest_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static int loadtest_connect(void)
+{
+	struct sockaddr_in addr;
+	struct timeval tv;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	tv.tv_sec = HTTP_CONF_SOCKET_TIMEOUT_MSEC / 1000;
+	tv.tv_usec = (HTTP_CONF_SOCKET_TIMEOUT_MSEC % 1000) * 1000;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (struct timeval *)&tv, sizeof(struct timeval));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(LOADTEST_PORT);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Read one response, framed by its Content-Length. Returns 1 if the server
+ * keeps the connection alive, 0 if it closes it and -1 on error.
+ */
+static int loadtest_read_response(int fd, char *buf)
+{
+	int len = 0;
+	int ret;
+	char *body;
+	char *field;
+
+	while (1) {
+		ret = recv(fd, buf + len, LOADTEST_BUF_SIZE - 1 - len, 0);
+		if (ret <= 0) {
+			return -1;
+		}
+		len += ret;
+		buf[len] = '\0';
+
+		body = strstr(buf, "\r\n\r\n");
+		if (body == NULL) {
+			continue;
+		}
+		body += 4;
+		field = strstr(buf, "Content-Length: ");
+		if (field == NULL || field > body) {
+			return -1;
+		}
+		if (buf + len - body >= atoi(field + 16)) {
+			break;
+		}
+	}
+
+	if (strncmp(buf, "HTTP/1.1 200", 12) != 0) {
+		return -1;
+	}
+
+	return strstr(buf, "Connection: keep-alive") != NULL;
+}
+
+static pthread_addr_t loadtest_client_thread(pthread_addr_t arg)
+{
+	struct loadtest_client *client = (struct loadtest_client *)arg;
+	char buf[LOADTEST_BUF_SIZE];
+	uint32_t start;
+	int alive = 0;
+	int fd = -1;
+	int ret;
+	int i;
+
+	for (i = 0; i < client->nrequests; i++) {
+		start = loadtest_usec();
+		if (!alive) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			fd = loadtest_connect();
+			if (fd < 0) {
+				client->nerrors++;
+				continue;
+			}
+		}
+
+		ret = -1;
+		if (send(fd, g_loadtest_request, sizeof(g_loadtest_request) - 1, 0) == sizeof(g_loadtest_request) - 1) {
+			ret = loadtest_read_response(fd, buf);
+		}
+		if (ret < 0) {
+			client->nerrors++;
+		} else {
+			client->latency[client->nanswered++] = loadtest_usec() - start;
+		}
+		alive = (ret > 0);
+	}
+
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static int loadtest_compare(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void loadtest_usage(void)
+{
+	printf("\n  webserver loadtest usage:\n");
+	printf("   $ webserver loadtest [clients] [requests]\n");
+	printf("\n [clients]  : number of client threads, 1 to %d (default %d)\n", LOADTEST_MAX_CLIENTS, LOADTEST_CLIENTS);
+	printf(" [requests] : number of requests of each client (default %d)\n", LOADTEST_REQUESTS);
+}
+
+int webserver_loadtest(int argc, char **argv)
+{
+	struct http_server_t *server;
+	struct loadtest_client clients[LOADTEST_MAX_CLIENTS];
+	pthread_attr_t attr;
+	uint32_t *latency;
+	uint32_t start;
+	uint32_t elapsed;
+	int nclients = LOADTEST_CLIENTS;
+	int nrequests = LOADTEST_REQUESTS;
+	int total;
+	int nanswered = 0;
+	int nerrors = 0;
+	int i;
+
+	if (argc > 2) {
+		nclients = atoi(argv[2]);
+	}
+	if (argc > 3) {
+		nrequests = atoi(argv[3]);
+	}
+	if (nclients < 1 || nclients > LOADTEST_MAX_CLIENTS || nrequests < 1) {
+		loadtest_usage();
+		return -1;
+	}
+
+	total = nclients * nrequests;
+	latency = (uint32_t *)malloc(total * sizeof(uint32_t));
+	if (latency == NULL) {
+		printf("Error: Cannot allocate %d latencies\n", total);
+		return -1;
+	}
+
+	server = http_server_init(LOADTEST_PORT);
+	if (server == NULL) {
+		printf("Error: Cannot allocate server structure!!\n");
+		free(latency);
+		return -1;
+	}
+	http_server_register_cb(server, HTTP_METHOD_GET, NULL, loadtest_get_callback);
+	if (http_server_start(server) < 0) {
+		printf("Fail to start HTTP server\n");
+		http_server_deregister_cb(server, HTTP_METHOD_GET, NULL);
+		http_server_release(&server);
+		free(latency);
+		return -1;
+	}
+	usleep(100000);
+
+	printf("Load test: %d clients x %d requests on port %d\n", nclients, nrequests, LOADTEST_PORT);
+
+	start = loadtest_usec();
+	for (i = 0; i < nclients; i++) {
+		clients[i].nrequests = nrequests;
+		clients[i].nerrors = 0;
+		clients[i].nanswered = 0;
+		clients[i].latency = latency + i * nrequests;
+
+		pthread_attr_init(&attr);
+		pthread_attr_setstacksize(&attr, LOADTEST_STACK_SIZE);
+		if (pthread_create(&clients[i].tid, &attr, loadtest_client_thread, &clients[i]) != 0) {
+			printf("Error: Cannot create client thread!!\n");
+			nclients = i;
+			total = nclients * nrequests;
+			break;
+		}
+		pthread_setname_np(clients[i].tid, "loadtest client");
+	}
+
+	/* Only the answered requests have a latency, gather them */
+	for (i = 0; i < nclients; i++) {
+		pthread_join(clients[i].tid, NULL);
+		nerrors += clients[i].nerrors;
+		memmove(latency + nanswered, clients[i].latency, clients[i].nanswered * sizeof(uint32_t));
+		nanswered += clients[i].nanswered;
+	}
+	elapsed = loadtest_usec() - start;
+
+	http_server_stop(server);
+	http_server_deregister_cb(server, HTTP_METHOD_GET, NULL);
+	http_server_release(&server);
+
+	if (total > 0) {
+		printf("requests : %d (%d errors)\n", total, nerrors);
+		printf("elapsed  : %u ms\n", elapsed / 1000);
+		printf("req/s    : %u\n", (uint32_t)((uint64_t)nanswered * 1000000 / (elapsed ? elapsed : 1)));
+	}
+	if (nanswered > 0) {
+		qsort(latency, nanswered, sizeof(uint32_t), loadtest_compare);
+		printf("latency  : p50 %u us, p99 %u us, max %u us\n",
+			   latency[nanswered / 2], latency[(nanswered * 99) / 100], latency[nanswered - 1]);
+	}
+
+	free(latency);
+	return nerrors ? -1 : 0;
+}
@@ -121,6 +121,8 @@ static const char g_httpcnlost[] = "close";
 struct http_server_t *http_server = NULL;
 struct http_server_t *https_server = NULL;
 
+int webserver_loadtest(int argc, char **argv);
+
 /* GET callbacks */
 void http_get_root(struct http_client_t *client, struct http_req_message *req)
 {
@@ -149,7 +151,12 @@ void http_get_device_id(struct http_client_t *client, struct http_req_message *r
 	printf("%s\n", req->url);
 	printf("%s\n", req->query_string);
 
-	snprintf(buf, sizeof(buf), "You asked for device.");
+	/* The value of ':id' in devid_url */
+	if (req->nparams > 0) {
+		snprintf(buf, sizeof(buf), "You asked for device %s.", req->params[0].value);
+	} else {
+		snprintf(buf, sizeof(buf), "You asked for device.");
+	}
 
 	if (http_send_response(client, 200, buf, NULL) < 0) {
 		printf("Error: Fail to send response\n");
@@ -307,9 +314,10 @@ void print_webserver_usage(void)
 {
 	printf("\n  webserver usage:\n");
 	printf("   $ webserver [operation]\n");
-	printf("\n [operation]   : %%s (webserver start or stop)\n");
+	printf("\n [operation]   : %%s (webserver start, stop or loadtest)\n");
 	printf("\n example:\n");
 	printf("  $ webserver start\n");
+	printf("  $ webserver loadtest 4 200\n");
 }
 
 void register_callbacks(struct http_server_t *server)
@@ -350,6 +358,11 @@ pthread_addr_t httptest_cb(void *arg)
 	struct webserver_input *input;
 
 	input = arg;
+	if (input->argc >= 2 && !strcmp(input->argv[1], "loadtest")) {
+		webserver_loadtest(input->argc, input->argv);
+		return NULL;
+	}
+
 	if (input->argc != 2) {
 		print_webserver_usage();
 		return NULL;
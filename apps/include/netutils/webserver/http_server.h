@@ -85,10 +85,16 @@
 #define HTTP_CONF_CLIENT_STACKSIZE              8192
 #define HTTP_CONF_MIN_TLS_MEMORY                80000
 #define HTTP_CONF_SOCKET_TIMEOUT_MSEC           5000
+#ifdef CONFIG_NETUTILS_WEBSERVER_CLIENT_HANDLE
+#define HTTP_CONF_MAX_CLIENT_HANDLE             CONFIG_NETUTILS_WEBSERVER_CLIENT_HANDLE
+#else
 #define HTTP_CONF_MAX_CLIENT_HANDLE             1
+#endif
 #define HTTP_CONF_SERVER_MQ_MAX_MSG             10
 #define HTTP_CONF_SERVER_MQ_PRIO                50
 #define HTTP_CONF_SERVER_SIGWAKEUP              18
+#define HTTP_CONF_KEEPALIVE_TIMEOUT_MSEC        5000
+#define HTTP_CONF_KEEPALIVE_MAX_REQUESTS        100
 
 #define HTTP_CONF_MAX_REQUEST_LENGTH            4096
 #define HTTP_CONF_MAX_REQUEST_LINE_LENGTH       256
@@ -100,6 +106,7 @@
 #define HTTP_CONF_MAX_DIVIDED_PATH_LENGTH       32
 #define HTTP_CONF_MAX_SLASH_COUNT               32
 #define HTTP_CONF_MAX_QUERY_HANDLER_COUNT       64
+#define HTTP_CONF_MAX_ROUTE_PARAMS              4
 #define HTTP_CONF_MAX_ENTITY_LENGTH             2048
 
 #define HTTP_ERROR_400            "Bad Request"
@@ -112,6 +119,7 @@
 
 struct http_client_t;
 struct http_keyvalue_list_t;
+struct http_route_node_t;
 
 /**
  * @brief http server ssl config structure.
@@ -134,8 +142,20 @@ typedef enum {
 	HTTP_SERVER_STOP,
 } http_server_state_t;
 
+/**
+ * @brief parameter captured from the url of a request.
+ */
+
+struct http_route_param_t {
+	const char *key;
+	const char *value;
+};
+
 /**
  * @brief http request message.
+ *        params holds the values of the ':name' and '*' segments of the
+ *        url_format the request matched, in the order of the url_format.
+ *        They are valid until the callback returns.
  */
 
 struct http_req_message {
@@ -147,6 +167,8 @@ struct http_req_message {
 	char *entity;
 	char *query_string;
 	int encoding;
+	int nparams;
+	struct http_route_param_t params[HTTP_CONF_MAX_ROUTE_PARAMS];
 };
 
 /**
@@ -168,6 +190,11 @@ struct http_server_t {
 	pthread_t c_tid[HTTP_CONF_MAX_CLIENT_HANDLE];
 	mqd_t msg_q;
 
+	sem_t                     client_sem;
+	struct http_client_t      *done_clients;
+	int                       busy_clients;
+	int                       notify_pipe[2];
+
 	int                       tls_init;
 #ifdef CONFIG_NET_SECURITY_TLS
 	mbedtls_ssl_config        tls_conf;
@@ -181,8 +208,8 @@ struct http_server_t {
 
 	struct sockaddr_in             servaddr;
 	http_cb_t cb[4];
-	struct http_query_handler_t
-	*query_handlers[HTTP_CONF_MAX_QUERY_HANDLER_COUNT];
+	struct http_route_node_t *routes;
+	int nroutes;
 #ifdef CONFIG_NETUTILS_WEBSOCKET
 	struct websocket_cb_t ws_cb;
 #endif
@@ -215,6 +242,9 @@ int http_server_start(struct http_server_t *server);
 /**
  * @brief http_server_stop() stops the webserver.
  *        Both HTTP server and HTTPS server are stoped by this function.
+ *        It returns once the callbacks running have returned and the
+ *        responses they queued are sent, so the server can be released
+ *        right after. It cannot be called from a callback.
  *
  * @param[in] server pointer of the webserver to be stopped.
  * @return On success, HTTP_OK(0) is returned.
@@ -241,7 +271,10 @@ void http_server_release(struct http_server_t **server);
  *                   - HTTP_METHOD_PUT
  *                   - HTTP_METHOD_POST
  *                   - HTTP_METHOD_DELETE
- * @param[in] url_format url to register cb.
+ * @param[in] url_format url to register cb. A segment ':name' matches any
+ *                       segment, a last segment '*' matches the rest of
+ *                       the url. Both are captured in msg->params.
+ *                       A segment given as is takes precedence.
  * @param[in] func pointer of the callback function.
  * @return On success, HTTP_OK(0) is returned.
  *         On failure, HTTP_ERROR(-1) is returned.
@@ -268,6 +301,8 @@ int http_server_deregister_cb(struct http_server_t *server, int method, const ch
 /**
  * @brief http_send_response() sends the response.
  *        If receive request, you must send a response by this function.
+ *        The response is queued and sent by the server once the callback
+ *        returns, so it must be called from the callback of the request.
  *
  * @param[in] server a pointer of HTTP request.
  * @param[in] status status code of a response.
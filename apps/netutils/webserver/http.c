@@ -20,14 +20,19 @@
 #include <apps/netutils/webserver/http_server.h>
 #include <apps/netutils/webserver/http_keyvalue_list.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <tinyara/clock.h>
 
 #include "http.h"
 #include "http_client.h"
+#include "http_arch.h"
 #include "http_log.h"
 
 #define MAX_ACCEPTED_FD    20
 #define ACCEPT_TIMEOUT_MS  100
+#define KEEPALIVE_POLL_MS  10
 #define HTTP_LISTENING_HANDLER_STACKSIZE (1024 * 4)
+#define HTTPS_LISTENING_HANDLER_STACKSIZE (1024 * 8)
 #define HTTP_CLIENT_HANDLER_STACKSIZE    (1024 * 4)
 #define HTTPS_CLIENT_HANDLER_STACKSIZE    (1024 * 8)
 
@@ -45,8 +50,8 @@ int http_server_mq_flush(mqd_t msg_q)
 
 	while (mqattr.mq_curmsgs != 0) {
 		mq_timedreceive(msg_q, (char *)&msg, mqattr.mq_msgsize, NULL, &t);
-		if (msg.event == HTTP_CONNECT_EVENT) {
-			close(msg.data);
+		if (msg.event == HTTP_REQUEST_EVENT) {
+			http_close_client(msg.client);
 		}
 		mq_getattr(msg_q, &mqattr);
 	}
@@ -82,20 +87,328 @@ int http_server_mq_close(int port)
 	return mq_unlink(msg_name);
 }
 
+static void http_server_close_conn(struct http_client_t **conn)
+{
+	http_close_client(*conn);
+	*conn = NULL;
+}
+
+static int http_server_add_conn(struct http_client_t **conns, struct http_client_t *client)
+{
+	int i;
+
+	for (i = 0; i < MAX_ACCEPTED_FD; ++i) {
+		if (conns[i] == NULL) {
+			conns[i] = client;
+			return i;
+		}
+	}
+
+	HTTP_LOGE("Error: Too many request be piled\n");
+	return -1;
+}
+
+static int http_server_set_nonblock(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		HTTP_LOGE("Error: Fail to set O_NONBLOCK %d\n", fd);
+		return HTTP_ERROR;
+	}
+
+	return HTTP_OK;
+}
+
+/*
+ * Queue a job of a connection to the client handlers. The connection
+ * stays in the table but belongs to a handler until it is handed back.
+ */
+static int http_server_post(struct http_server_t *server, mqd_t msg_q, struct http_client_t *client, http_server_event_t event)
+{
+	struct http_msg_t msg;
+	int state = client->state;
+
+	msg.event = event;
+	msg.data = client->client_fd;
+	msg.client = client;
+	client->state = HTTP_CLIENT_DISPATCH;
+
+	while (sem_wait(&server->client_sem) != OK) {
+	}
+	++server->busy_clients;
+	sem_post(&server->client_sem);
+
+	if (mq_send(msg_q, (char *)&msg, sizeof(struct http_msg_t), 1) != OK) {
+		HTTP_LOGE("Send Error %d\n", getpid());
+		while (sem_wait(&server->client_sem) != OK) {
+		}
+		--server->busy_clients;
+		sem_post(&server->client_sem);
+		client->state = state;
+		return HTTP_ERROR;
+	}
+
+	return HTTP_OK;
+}
+
+/*
+ * Read the next request of a connection, it may already be buffered when
+ * the client pipelines its requests. Returns HTTP_ERROR if the connection
+ * has to be closed.
+ */
+static int http_server_read_conn(struct http_client_t *client)
+{
+	int ret;
+
+	client->since = clock_systimer();
+	ret = http_client_read(client);
+	if (ret < 0) {
+		return HTTP_ERROR;
+	}
+
+	client->state = ret ? HTTP_CLIENT_QUEUED : HTTP_CLIENT_READ;
+	return HTTP_OK;
+}
+
+/* Called once the responses of a request are sent */
+static int http_server_next_request(struct http_client_t **conn)
+{
+	struct http_client_t *client = *conn;
+
+#ifdef CONFIG_NETUTILS_WEBSOCKET
+	if (client->ws_state >= MIN_WS_HEADER_FIELD) {
+		/* The websocket thread owns the socket from now on */
+		if (http_client_open_websocket(client) != HTTP_OK) {
+			http_server_close_conn(conn);
+			return HTTP_ERROR;
+		}
+		http_client_release(client);
+		*conn = NULL;
+		return HTTP_OK;
+	}
+#endif
+
+	if (!client->keep_alive || http_server_read_conn(client) != HTTP_OK) {
+		http_server_close_conn(conn);
+		return HTTP_ERROR;
+	}
+
+	return HTTP_OK;
+}
+
+#ifdef CONFIG_NET_SECURITY_TLS
+static int http_server_handshake_conn(struct http_client_t **conn)
+{
+	struct http_client_t *client = *conn;
+	int ret;
+
+	ret = http_client_tls_handshake(client);
+	if (ret == 0) {
+		return HTTP_OK;
+	}
+
+	/* The first request may already be decrypted along with the handshake */
+	if (ret < 0 || http_server_read_conn(client) != HTTP_OK) {
+		http_server_close_conn(conn);
+		return HTTP_ERROR;
+	}
+
+	return HTTP_OK;
+}
+#endif
+
+/* Events a connection waits for in poll() */
+static short http_server_conn_events(struct http_client_t *client)
+{
+#ifdef CONFIG_NET_SECURITY_TLS
+	if (client->state == HTTP_CLIENT_HANDSHAKE) {
+		return client->tls_want_write ? POLLOUT : POLLIN;
+	}
+#endif
+	return (client->state == HTTP_CLIENT_READ) ? POLLIN : POLLOUT;
+}
+
+static int http_server_write_conn(struct http_client_t **conn)
+{
+	struct http_client_t *client = *conn;
+	int ret;
+
+	client->state = HTTP_CLIENT_WRITE;
+	client->since = clock_systimer();
+	ret = http_client_write(client);
+	if (ret < 0) {
+		http_server_close_conn(conn);
+		return HTTP_ERROR;
+	} else if (ret == 0) {
+		return HTTP_OK;
+	}
+
+	return http_server_next_request(conn);
+}
+
+/*
+ * Take back the connections handed back by the client handlers and move
+ * them on, and return the number of jobs still held by the handlers.
+ */
+static int http_server_take_clients(struct http_server_t *server, struct http_client_t **conns)
+{
+	struct http_client_t *client;
+	struct http_client_t *next;
+	int busy;
+	int i;
+
+	while (sem_wait(&server->client_sem) != OK) {
+	}
+	client = server->done_clients;
+	server->done_clients = NULL;
+	busy = server->busy_clients;
+	sem_post(&server->client_sem);
+
+	for (; client; client = next) {
+		next = client->next;
+		client->next = NULL;
+
+		for (i = 0; i < MAX_ACCEPTED_FD && conns[i] != client; ++i) {
+		}
+		if (i == MAX_ACCEPTED_FD) {
+			http_close_client(client);
+			continue;
+		}
+
+		if (server->state != HTTP_SERVER_RUN) {
+			/* Stopping, send what is queued and close */
+			if (client->responses == NULL) {
+				http_server_close_conn(&conns[i]);
+				continue;
+			}
+			client->keep_alive = false;
+			client->state = HTTP_CLIENT_WRITE;
+			client->since = clock_systimer();
+		} else if (client->responses) {
+			http_server_write_conn(&conns[i]);
+		} else {
+			http_server_next_request(&conns[i]);
+		}
+	}
+
+	return busy;
+}
+
+/*
+ * Hand a connection back to the server thread. The server thread keeps
+ * running until every job is handed back, even once a stop is requested,
+ * so the server is never released under a client handler.
+ */
+void http_server_return_client(struct http_server_t *server, struct http_client_t *client)
+{
+	while (sem_wait(&server->client_sem) != OK) {
+	}
+	--server->busy_clients;
+	client->next = server->done_clients;
+	server->done_clients = client;
+
+	/* Wake the server up from poll() */
+	if (server->notify_pipe[1] >= 0) {
+		write(server->notify_pipe[1], ".", 1);
+	}
+	sem_post(&server->client_sem);
+}
+
+static void http_server_accept(struct http_server_t *server, struct http_client_t **conns)
+{
+	struct sockaddr_in client_addr;
+	struct http_client_t *client;
+	struct mallinfo data;
+	struct timeval tv;
+	socklen_t addrlen;
+	int sock_fd;
+	int i;
+
+	addrlen = sizeof(struct sockaddr_in);
+	sock_fd = accept(*(volatile int *)&server->listen_fd,
+					 (struct sockaddr *)&client_addr,
+					 &addrlen);
+	if (sock_fd < 0) {
+		if (errno != EWOULDBLOCK) {
+			HTTP_LOGE("Error: Accept client error!!\n");
+		}
+		return;
+	}
+
+	HTTP_LOGD("Client %d is accepted ipaddr: %d.%d.%d.%d\n", sock_fd,
+			  (int)((client_addr.sin_addr.s_addr & 0xFF)),
+			  (int)((client_addr.sin_addr.s_addr & 0xFF00) >> 8),
+			  (int)((client_addr.sin_addr.s_addr & 0xFF0000) >> 16),
+			  (int)((client_addr.sin_addr.s_addr & 0xFF000000) >> 24));
+
+	data = mallinfo();
+	if (data.fordblks < HTTP_CONF_MIN_TLS_MEMORY * HTTP_CONF_MAX_CLIENT_HANDLE) {
+		HTTP_LOGE("Error: Not enough memory :: %d\n", data.fordblks);
+		close(sock_fd);
+		return;
+	}
+	HTTP_LOGD("Free Mem %d\n", data.fordblks);
+
+	/* A websocket still reads and writes blocking */
+	tv.tv_sec = HTTP_CONF_SOCKET_TIMEOUT_MSEC / 1000;
+	tv.tv_usec = (HTTP_CONF_SOCKET_TIMEOUT_MSEC % 1000) * 1000;
+	if (setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO,
+				   (struct timeval *)&tv, sizeof(struct timeval)) < 0) {
+		HTTP_LOGE("Error: Fail to setsockopt\n");
+	}
+
+	client = http_client_init(server, sock_fd);
+	if (client == NULL) {
+		HTTP_LOGE("Error: Cannot init client!!\n");
+		close(sock_fd);
+		return;
+	}
+
+	i = http_server_add_conn(conns, client);
+	if (i < 0) {
+		http_close_client(client);
+		return;
+	}
+
+	client->keep_alive = true;
+	client->since = clock_systimer();
+	if (http_server_set_nonblock(sock_fd) != HTTP_OK) {
+		http_server_close_conn(&conns[i]);
+		return;
+	}
+#ifdef CONFIG_NET_SECURITY_TLS
+	if (server->tls_init) {
+		/* The handshake is run by the poll loop */
+		if (http_client_tls_init(client) != HTTP_OK) {
+			HTTP_LOGE("Error: Cannot initialize TLS!! Close client.. %d\n", sock_fd);
+			http_server_close_conn(&conns[i]);
+			return;
+		}
+		client->state = HTTP_CLIENT_HANDSHAKE;
+		return;
+	}
+#endif
+	client->state = HTTP_CLIENT_READ;
+}
+
 pthread_addr_t http_server_handler(pthread_addr_t arg)
 {
-	fd_set readfds;
-	int fdcnt = 0;
-	int fdarr[MAX_ACCEPTED_FD] = {0,};
+	struct http_client_t *conns[MAX_ACCEPTED_FD];
+	struct pollfd fds[MAX_ACCEPTED_FD + 2];
+	int fd_conn[MAX_ACCEPTED_FD + 2];
 	mqd_t msg_q;
 	struct http_msg_t msg;
-	socklen_t addrlen;
-	int sock_fd, ret, cnt, i, maxfd = 0;
-	struct timeval tv, accept_to;
-	struct sockaddr_in client_addr;
+	struct http_client_t *client;
+	int ret, i, nfds, busy, timeout;
+	char notify_buf[MAX_ACCEPTED_FD];
+	systime_t now;
+	systime_t limit;
 	struct mq_attr mqattr;
 	struct http_server_t *server = (struct http_server_t *)arg;
 
+	HTTP_MEMSET(conns, 0, sizeof(conns));
+
 	if ((msg_q = http_server_mq_open(server->port)) == NULL) {
 		HTTP_LOGE("msg queue open fail in http_server_handler %d\n" , server->port);
 		goto stop;
@@ -108,110 +421,185 @@ pthread_addr_t http_server_handler(pthread_addr_t arg)
 	 */
 	HTTP_LOGD("Accepting connections on port %d began.\n", server->port);
 
-	accept_to.tv_sec = ACCEPT_TIMEOUT_MS / 1000;
-	accept_to.tv_usec = (ACCEPT_TIMEOUT_MS % 1000) * 1000;
-	if (setsockopt(server->listen_fd, SOL_SOCKET, SO_RCVTIMEO,
-				   (struct timeval *)&accept_to, sizeof(struct timeval)) < 0) {
-		HTTP_LOGE("Error: Fail to setsockopt\n");
+	if (http_server_set_nonblock(server->listen_fd) != HTTP_OK) {
+		goto stop;
 	}
 
 	server->state = HTTP_SERVER_RUN;
 
 	while (server->state == HTTP_SERVER_RUN) {
-		addrlen = sizeof(struct sockaddr_in);
-		sock_fd = accept(*(volatile int *)&server->listen_fd,
-						 (struct sockaddr *)&client_addr,
-						 &addrlen);
-		if (sock_fd < 0 && errno != EWOULDBLOCK) {
-			HTTP_LOGE("Error: Accept client error!!\n");
-			continue;
+		/*
+		 * One poll() drives every connection: it runs the TLS handshakes,
+		 * reads and frames the requests and writes the responses without
+		 * blocking, so a slow client only delays itself. A complete
+		 * request is queued to the client handlers, which run the
+		 * callbacks and hand the connection back. A handler handing a
+		 * connection back writes to the notify pipe. Without pipes, poll
+		 * often while the handlers hold connections so that they are
+		 * moved on soon after.
+		 */
+		busy = http_server_take_clients(server, conns);
+		now = clock_systimer();
+
+		nfds = 0;
+		fds[nfds].fd = server->listen_fd;
+		fds[nfds].events = POLLIN;
+		fd_conn[nfds++] = -1;
+		if (server->notify_pipe[0] >= 0) {
+			fds[nfds].fd = server->notify_pipe[0];
+			fds[nfds].events = POLLIN;
+			fd_conn[nfds++] = -1;
 		}
 
-		if (sock_fd > 0) {
-			tv.tv_sec = HTTP_CONF_SOCKET_TIMEOUT_MSEC / 1000;
-			tv.tv_usec = (HTTP_CONF_SOCKET_TIMEOUT_MSEC % 1000) * 1000;
-			if (setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO,
-						   (struct timeval *)&tv, sizeof(struct timeval)) < 0) {
-				HTTP_LOGE("Error: Fail to setsockopt\n");
+		for (i = 0; i < MAX_ACCEPTED_FD; ++i) {
+			client = conns[i];
+			if (client == NULL) {
+				continue;
 			}
 
-			HTTP_LOGD("Client %d is accepted ipaddr: %d.%d.%d.%d\n", sock_fd,
-					  (int)((client_addr.sin_addr.s_addr & 0xFF)),
-					  (int)((client_addr.sin_addr.s_addr & 0xFF00) >> 8),
-					  (int)((client_addr.sin_addr.s_addr & 0xFF0000) >> 16),
-					  (int)((client_addr.sin_addr.s_addr & 0xFF000000) >> 24));
-			for (i = 0; i < MAX_ACCEPTED_FD; ++i) {
-				if (!fdarr[i]) {
-					if (sock_fd > maxfd) {
-						maxfd = sock_fd;
-					}
-					fdarr[i] = sock_fd;
-					++fdcnt;
-					break;
+			if (client->state == HTTP_CLIENT_QUEUED) {
+				if (busy >= HTTP_CONF_SERVER_MQ_MAX_MSG) {
+					continue;
 				}
-				if (i + 1 == MAX_ACCEPTED_FD) {
-					HTTP_LOGE("Error: Too many request be piled\n");
+				if (http_server_post(server, msg_q, client, HTTP_REQUEST_EVENT) != HTTP_OK) {
+					http_server_close_conn(&conns[i]);
+					continue;
 				}
+				busy++;
 			}
+
+			if (client->state != HTTP_CLIENT_READ && client->state != HTTP_CLIENT_WRITE &&
+				client->state != HTTP_CLIENT_HANDSHAKE) {
+				continue;
+			}
+
+			/* An idle connection waits for the keep-alive timeout */
+			if (client->state == HTTP_CLIENT_READ && client->buf_len == 0) {
+				limit = MSEC2TICK(HTTP_CONF_KEEPALIVE_TIMEOUT_MSEC);
+			} else {
+				limit = MSEC2TICK(HTTP_CONF_SOCKET_TIMEOUT_MSEC);
+			}
+			if (now - client->since >= limit) {
+				HTTP_LOGD("Client %d timed out, close\n", client->client_fd);
+				http_server_close_conn(&conns[i]);
+				continue;
+			}
+
+			fds[nfds].fd = client->client_fd;
+			fds[nfds].events = http_server_conn_events(client);
+			fd_conn[nfds++] = i;
 		}
 
-		if (fdcnt > 0) {
-			cnt = 0;
-			FD_ZERO(&readfds);
-			for (i = 0; i < MAX_ACCEPTED_FD; ++i) {
-				if (fdarr[i]) {
-					FD_SET(fdarr[i], &readfds);
-					++cnt;
-				}
-				if (cnt == fdcnt) {
-					break;
+		if (busy > 0 && server->notify_pipe[0] < 0) {
+			timeout = KEEPALIVE_POLL_MS;
+		} else {
+			timeout = ACCEPT_TIMEOUT_MS;
+		}
+
+		ret = poll(fds, nfds, timeout);
+		if (ret <= 0) {
+			continue;
+		}
+
+		for (i = 0; i < nfds; ++i) {
+			if (fds[i].revents == 0) {
+				continue;
+			}
+
+			if (fd_conn[i] < 0) {
+				if (fds[i].fd == server->listen_fd) {
+					http_server_accept(server, conns);
+				} else {
+					read(fds[i].fd, notify_buf, sizeof(notify_buf));
 				}
+				continue;
 			}
-			ret = select(maxfd + 1, &readfds, (fd_set *)0, (fd_set *)0, NULL);
-			if (ret > 0) {
-				cnt = 0;
-				for (i = 0; i < MAX_ACCEPTED_FD; ++i) {
-					if (fdarr[i]) {
-						if (FD_ISSET(fdarr[i], &readfds)) {
-							++cnt;
-							sock_fd = fdarr[i];
-							fdarr[i] = 0;
-							--fdcnt;
-
-							msg.event = HTTP_CONNECT_EVENT;
-							msg.data = sock_fd;
-
-							mq_getattr(msg_q, &mqattr);
-							if (mqattr.mq_curmsgs > HTTP_CONF_SERVER_MQ_MAX_MSG - 1) {
-								if (sock_fd > 0) {
-									close(sock_fd);
-								}
-								continue;
-							}
-
-							if (mq_send(msg_q, (char *)&msg, mqattr.mq_msgsize, 1) != OK) {
-								HTTP_LOGE("Send Error %d\n", getpid());
-								if (sock_fd > 0) {
-									close(sock_fd);
-								}
-								continue;
-							}
-						}
-						if (cnt == ret) {
-							break;
-						}
-					}
+
+			client = conns[fd_conn[i]];
+			if (client->state == HTTP_CLIENT_READ) {
+				if (http_server_read_conn(client) != HTTP_OK) {
+					http_server_close_conn(&conns[fd_conn[i]]);
 				}
+#ifdef CONFIG_NET_SECURITY_TLS
+			} else if (client->state == HTTP_CLIENT_HANDSHAKE) {
+				http_server_handshake_conn(&conns[fd_conn[i]]);
+#endif
+			} else {
+				http_server_write_conn(&conns[fd_conn[i]]);
 			}
 		}
 	}
 stop:
+	/*
+	 * Let the client handlers finish the jobs already queued and hand
+	 * their connections back, and write out the responses queued on the
+	 * connections before closing them, each within the socket timeout.
+	 * The server is only marked as stopped once no handler holds a job,
+	 * as it may be released right after.
+	 */
+	for (;;) {
+		busy = http_server_take_clients(server, conns);
+		now = clock_systimer();
+
+		nfds = 0;
+		if (server->notify_pipe[0] >= 0) {
+			fds[nfds].fd = server->notify_pipe[0];
+			fds[nfds].events = POLLIN;
+			fd_conn[nfds++] = -1;
+		}
+
+		for (i = 0; i < MAX_ACCEPTED_FD; ++i) {
+			client = conns[i];
+			if (client == NULL || client->state == HTTP_CLIENT_DISPATCH) {
+				continue;
+			}
+
+			if (client->state != HTTP_CLIENT_WRITE ||
+				now - client->since >= MSEC2TICK(HTTP_CONF_SOCKET_TIMEOUT_MSEC)) {
+				http_server_close_conn(&conns[i]);
+				continue;
+			}
+
+			client->keep_alive = false;
+			fds[nfds].fd = client->client_fd;
+			fds[nfds].events = POLLOUT;
+			fd_conn[nfds++] = i;
+		}
+
+		if (busy == 0 && (nfds == 0 || fd_conn[nfds - 1] < 0)) {
+			break;
+		}
+
+		if (busy > 0 && server->notify_pipe[0] < 0) {
+			timeout = KEEPALIVE_POLL_MS;
+		} else {
+			timeout = ACCEPT_TIMEOUT_MS;
+		}
+
+		if (poll(fds, nfds, timeout) <= 0) {
+			continue;
+		}
+
+		for (i = 0; i < nfds; ++i) {
+			if (fds[i].revents == 0) {
+				continue;
+			}
+
+			if (fd_conn[i] < 0) {
+				read(fds[i].fd, notify_buf, sizeof(notify_buf));
+			} else {
+				http_server_write_conn(&conns[fd_conn[i]]);
+			}
+		}
+	}
+
 	if (msg_q >= 0) {
 		http_server_mq_flush(msg_q);
 
 		for (i = 0; i < HTTP_CONF_MAX_CLIENT_HANDLE; i++) {
 			msg.event = HTTP_STOP_EVENT;
 			msg.data = -1;
+			msg.client = NULL;
 			mq_send(msg_q, (char *)&msg, mqattr.mq_msgsize, 1);
 		}
 
@@ -227,6 +615,16 @@ stop:
 			HTTP_LOGD("mq close error %d\n", server->port);
 		}
 	}
+
+	while (sem_wait(&server->client_sem) != OK) {
+	}
+	for (i = 0; i < 2; i++) {
+		if (server->notify_pipe[i] >= 0) {
+			close(server->notify_pipe[i]);
+			server->notify_pipe[i] = -1;
+		}
+	}
+	sem_post(&server->client_sem);
 	HTTP_LOGD("http_server_handler stop :%d\n", server->port);
 
 	server->state = HTTP_SERVER_STOP;
@@ -237,6 +635,7 @@ stop:
 int http_server_start(struct http_server_t *server)
 {
 	pthread_attr_t attr;
+	unsigned int srv_handle_stack = HTTP_LISTENING_HANDLER_STACKSIZE;
 	unsigned int cli_handle_stack = HTTP_CLIENT_HANDLER_STACKSIZE;
 	int reuse = 1;
 	int i;
@@ -275,9 +674,30 @@ int http_server_start(struct http_server_t *server)
 		return HTTP_ERROR;
 	}
 
+	sem_init(&server->client_sem, 0, 1);
+	server->done_clients = NULL;
+	server->busy_clients = 0;
+	server->notify_pipe[0] = -1;
+	server->notify_pipe[1] = -1;
+#ifdef CONFIG_PIPES
+	if (pipe(server->notify_pipe) < 0) {
+		HTTP_LOGE("Error: Cannot create notify pipe!!\n");
+		server->notify_pipe[0] = -1;
+		server->notify_pipe[1] = -1;
+	}
+#endif
+
+#ifdef CONFIG_NET_SECURITY_TLS
+	/* The server thread runs the handshakes, decrypts the requests and encrypts the responses */
+	if (server->tls_init) {
+		srv_handle_stack = HTTPS_LISTENING_HANDLER_STACKSIZE;
+		cli_handle_stack = HTTPS_CLIENT_HANDLER_STACKSIZE;
+	}
+#endif
+
 	pthread_attr_init(&attr);
 	pthread_attr_setschedpolicy(&attr, SCHED_RR);
-	pthread_attr_setstacksize(&attr, HTTP_LISTENING_HANDLER_STACKSIZE);
+	pthread_attr_setstacksize(&attr, srv_handle_stack);
 
 	if (pthread_create(&server->tid, &attr, http_server_handler, (void *)server) != 0) {
 		HTTP_LOGE("Error: Cannot create server thread!!\n");
@@ -286,12 +706,6 @@ int http_server_start(struct http_server_t *server)
 	pthread_setname_np(server->tid, "listening webserver");
 	pthread_detach(server->tid);
 
-#ifdef CONFIG_NET_SECURITY_TLS
-	if (server->tls_init) {
-		cli_handle_stack = HTTPS_CLIENT_HANDLER_STACKSIZE;
-	}
-#endif
-
 	for (i = 0; i < HTTP_CONF_MAX_CLIENT_HANDLE; i++) {
 		pthread_attr_init(&attr);
 		pthread_attr_setschedpolicy(&attr, SCHED_RR);
@@ -35,16 +35,21 @@
 
 typedef enum {
 	HTTP_ERROR_EVENT,
-	HTTP_CONNECT_EVENT,
+	HTTP_REQUEST_EVENT,
 	HTTP_STOP_EVENT,
 } http_server_event_t;
 
+struct http_server_t;
+struct http_client_t;
+
 struct http_msg_t {
 	http_server_event_t event;
 	int data;
+	struct http_client_t *client;
 };
 
 int http_server_mq_flush(mqd_t msg_q);
 mqd_t http_server_mq_open(int port);
 int http_server_mq_close(int port);
+void http_server_return_client(struct http_server_t *server, struct http_client_t *client);
 #endif
@@ -26,8 +26,10 @@
  * Below is for TinyAra
  */
 #define HTTP_MALLOC malloc
+#define HTTP_REALLOC realloc
 #define HTTP_MEMSET memset
 #define HTTP_MEMCPY memcpy
+#define HTTP_MEMMOVE memmove
 #define HTTP_FREE   free
 #define HTTP_ATOI   atoi
 
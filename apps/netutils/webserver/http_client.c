@@ -17,6 +17,9 @@
  ****************************************************************************/
 
 #include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 #include <apps/netutils/webserver/http_err.h>
 #include <apps/netutils/webserver/http_keyvalue_list.h>
 #include <apps/netutils/webclient.h>
@@ -31,16 +34,10 @@
 #include "http_arch.h"
 #include "http_log.h"
 
-#define MIN_WS_HEADER_FIELD 2
-
 pthread_addr_t http_handle_client(pthread_addr_t arg)
 {
 	struct http_server_t *server = (struct http_server_t *)arg;
 	struct http_msg_t msg;
-	int result;
-	struct http_keyvalue_list_t request_params;
-	int sock_fd;
-	struct mallinfo data;
 	struct http_client_t *p;
 	mqd_t msg_q;
 	struct mq_attr mqattr;
@@ -52,59 +49,31 @@ pthread_addr_t http_handle_client(pthread_addr_t arg)
 
 	mq_getattr(msg_q, &mqattr);
 
+	/*
+	 * The server thread reads and writes the connections, a client
+	 * handler only runs the callbacks of a received request.
+	 */
 	while (1) {
 		if (mq_receive(msg_q, (char *)&msg, mqattr.mq_msgsize, NULL) < 0) {
 			return NULL;
 		}
 
-		sock_fd = msg.data;
-
 		if (msg.event == HTTP_STOP_EVENT) {
-			close(sock_fd);
+			close(msg.data);
 			break;
 		}
 
-		data = mallinfo();
-
-		if (data.fordblks < HTTP_CONF_MIN_TLS_MEMORY * HTTP_CONF_MAX_CLIENT_HANDLE) {
-			HTTP_LOGE("Error: Not enough memory :: %d\n", data.fordblks);
-			close(sock_fd);
-			continue;
-
-		}
-
-		HTTP_LOGD("Free Mem %d\n", data.fordblks);
-
-		p = http_client_init(server, sock_fd);
-
-		if (p == NULL) {
-			HTTP_LOGE("Error: Cannot init client!!\n");
-			close(sock_fd);
-			continue;
-		}
-
-		HTTP_LOGD("Client %d.\n", p->client_fd);
+		p = msg.client;
 
-#ifdef CONFIG_NET_SECURITY_TLS
-		if (server->tls_init) {
-			if (http_client_tls_init(p) != HTTP_OK) {
-				HTTP_LOGE("Error: Cannot initialize TLS!! Close client.. %d\n", sock_fd);
-				http_client_release(p);
-				continue;
+		if (msg.event == HTTP_REQUEST_EVENT) {
+			if (http_client_handle_request(p) != HTTP_OK) {
+				HTTP_LOGD("Client %d  in error case.\n", p->client_fd);
+			} else {
+				HTTP_LOGD("Client %d  in normal case.\n", p->client_fd);
 			}
 		}
-#endif
-		http_keyvalue_list_init(&request_params);
-		result = http_recv_and_handle_request(p, &request_params);
-		http_keyvalue_list_release(&request_params);
 
-		if (result != HTTP_OK) {
-			HTTP_LOGD("Client %d  in error case.\n", sock_fd);
-		} else {
-			HTTP_LOGD("Client %d  in normal case.\n", sock_fd);
-		}
-		http_client_release(p);
-		HTTP_LOGD("Release client....\n");
+		http_server_return_client(server, p);
 	}
 
 	mq_close(msg_q);
@@ -131,11 +100,20 @@ struct http_client_t *http_client_init(struct http_server_t *server, int sock_fd
 
 int http_client_release(struct http_client_t *client)
 {
+	struct http_response_t *resp;
+
 #ifdef CONFIG_NET_SECURITY_TLS
 	if (client->server->tls_init && client->ws_state < MIN_WS_HEADER_FIELD) {
 		http_client_tls_release(client);
 	}
 #endif
+	while ((resp = client->responses) != NULL) {
+		client->responses = resp->next;
+		HTTP_FREE(resp);
+	}
+	if (client->buf) {
+		HTTP_FREE(client->buf);
+	}
 	HTTP_FREE(client);
 	HTTP_LOGD("Free Client\n");
 	return HTTP_OK;
@@ -366,130 +344,323 @@ int http_parse_message(char *buf, int buf_len, int *method, char *url,
 	return read_finish;
 }
 
-int http_recv_and_handle_request(struct http_client_t *client, struct http_keyvalue_list_t *request_params)
+/*
+ * Find the end of the request at the head of buf, so that requests
+ * pipelined on a connection are handled one by one. Returns the length of
+ * the request, 0 if it is not complete yet or HTTP_ERROR if it is
+ * malformed. keep_alive is set from the protocol version and from the
+ * Connection header.
+ */
+static int http_request_length(const char *buf, int buf_len, int *keep_alive)
+{
+	int line_start = 0;
+	int line_end;
+	int header_end = -1;
+	int content_len = 0;
+	int chunked = false;
+	long chunk_len;
+	int pos;
+
+	/* Request line */
+	line_end = http_find_first_crlf(buf, buf_len, 0);
+	if (line_end < 0) {
+		return 0;
+	}
+	*keep_alive = (line_end >= 8 && strncmp(buf + line_end - 8, "HTTP/1.1", 8) == 0);
+	line_start = line_end + 2;
+
+	/* Header fields up to the empty line */
+	while (header_end < 0) {
+		line_end = http_find_first_crlf(buf, buf_len, line_start - 1);
+		if (line_end < 0) {
+			return 0;
+		}
+		if (line_end == line_start) {
+			header_end = line_end + 2;
+		} else if (strncasecmp(buf + line_start, "Content-Length:", 15) == 0) {
+			content_len = atoi(buf + line_start + 15);
+		} else if (strncasecmp(buf + line_start, "Transfer-Encoding:", 18) == 0) {
+			chunked = (strncasecmp(buf + line_start + 18, " chunked", 8) == 0);
+		} else if (strncasecmp(buf + line_start, "Connection:", 11) == 0) {
+			if (strncasecmp(buf + line_start + 11, " keep-alive", 11) == 0) {
+				*keep_alive = true;
+			} else {
+				/* close, or an Upgrade to a websocket */
+				*keep_alive = false;
+			}
+		}
+		line_start = line_end + 2;
+	}
+
+	if (!chunked) {
+		if (content_len < 0) {
+			return HTTP_ERROR;
+		}
+		return (buf_len - header_end >= content_len) ? header_end + content_len : 0;
+	}
+
+	/*
+	 * Chunked body, walk the chunks up to the last one and its trailer.
+	 * The chunks are dispatched one by one and each may be answered, so
+	 * the connection is closed after such a request.
+	 */
+	*keep_alive = false;
+	pos = header_end;
+	while (1) {
+		line_end = http_find_first_crlf(buf, buf_len, pos);
+		if (line_end < 0) {
+			return 0;
+		}
+		chunk_len = strtol(buf + pos, NULL, 16);
+		pos = line_end + 2;
+
+		/* A chunk that cannot fit in the request buffer is never completed */
+		if (chunk_len < 0 || chunk_len > HTTP_CONF_MAX_REQUEST_LENGTH - pos) {
+			return HTTP_ERROR;
+		}
+		if (chunk_len == 0) {
+			break;
+		}
+		pos += chunk_len + 2;
+		if (pos > buf_len) {
+			return 0;
+		}
+	}
+
+	while (1) {
+		if (pos + 2 <= buf_len && buf[pos] == '\r' && buf[pos + 1] == '\n') {
+			return pos + 2;
+		}
+		line_end = http_find_first_crlf(buf, buf_len, pos);
+		if (line_end < 0) {
+			return 0;
+		}
+		pos = line_end + 2;
+	}
+}
+
+int http_client_read(struct http_client_t *client)
 {
-	char *buf;
-	int len = 0;
+	int len;
+
+	if (client->buf == NULL) {
+		client->buf = HTTP_MALLOC(HTTP_CONF_MAX_REQUEST_LENGTH);
+		if (client->buf == NULL) {
+			HTTP_LOGE("Error: Fail to malloc buf\n");
+			return HTTP_ERROR;
+		}
+		client->buf_len = 0;
+	}
+
+	/* Read until a whole request is buffered or the socket would block */
+	while ((client->req_len = http_request_length(client->buf, client->buf_len, &client->keep_alive)) == 0) {
+		if (client->buf_len >= HTTP_CONF_MAX_REQUEST_LENGTH - 1) {
+			HTTP_LOGE("Error: Request size is too large!!\n");
+			return HTTP_ERROR;
+		}
+#ifdef CONFIG_NET_SECURITY_TLS
+		if (client->server->tls_init) {
+			len = mbedtls_ssl_read(&(client->tls_ssl), (unsigned char *)client->buf + client->buf_len,
+								   HTTP_CONF_MAX_REQUEST_LENGTH - 1 - client->buf_len);
+			if (len == MBEDTLS_ERR_SSL_WANT_READ || len == MBEDTLS_ERR_SSL_WANT_WRITE) {
+				break;
+			}
+		} else
+#endif
+		{
+			len = recv(client->client_fd, client->buf + client->buf_len,
+					   HTTP_CONF_MAX_REQUEST_LENGTH - 1 - client->buf_len, 0);
+			if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				break;
+			}
+		}
+		if (len < 0) {
+			HTTP_LOGE("Error: Receive Fail %d\n", len);
+			return HTTP_ERROR;
+		} else if (len == 0) {
+			HTTP_LOGD("Finish read\n");
+			return HTTP_ERROR;
+		}
+		client->buf_len += len;
+	}
+
+	if (client->req_len < 0) {
+		HTTP_LOGE("Error: Malformed request\n");
+		return HTTP_ERROR;
+	} else if (client->req_len == 0) {
+		/* An idle connection does not hold a buffer */
+		if (client->buf_len == 0) {
+			HTTP_FREE(client->buf);
+			client->buf = NULL;
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
+int http_client_handle_request(struct http_client_t *client)
+{
+	char *buf = client->buf;
 	char *body = NULL;
-	int read_finish = false;
+	int read_finish;
+	int result = HTTP_ERROR;
 
 	int method = HTTP_METHOD_UNKNOWN;
 	char url[HTTP_CONF_MAX_REQUEST_HEADER_URL_LENGTH] = { 0, };
-	int buf_len = 0;
-	int remain = HTTP_CONF_MAX_REQUEST_LENGTH;
+	char next;
 	int enc = HTTP_CONTENT_LENGTH;
 	struct http_req_message req;
+	struct http_keyvalue_list_t request_params;
 	int state = HTTP_REQUEST_HEADER;
 	struct http_message_len_t mlen = {0,};
 	struct sockaddr_in addr;
-	socklen_t addr_len;
+	socklen_t addr_len = sizeof(addr);
 
 	client->ws_state = 0;
-
-	buf = HTTP_MALLOC(HTTP_CONF_MAX_REQUEST_LENGTH);
-	if (buf == NULL) {
-		HTTP_LOGE("Error: Fail to malloc buf\n");
-		close(client->client_fd);
-		return HTTP_ERROR;
+	client->responded = false;
+	if (++client->nrequests >= HTTP_CONF_KEEPALIVE_MAX_REQUESTS) {
+		client->keep_alive = false;
 	}
 
 	if (getpeername(client->client_fd, (struct sockaddr *)&addr, &addr_len) < 0) {
 		HTTP_LOGE("Error: Fail to getpeername\n");
-		goto errout;
+		goto out;
+	}
+
+	if (http_keyvalue_list_init(&request_params) == HTTP_ERROR) {
+		goto out;
 	}
+
+	HTTP_MEMSET(&req, 0, sizeof(req));
 	req.req_msg = buf;
 	req.url = url;
-	req.headers = request_params;
+	req.headers = &request_params;
 	req.client_ip = addr.sin_addr.s_addr;
 
-	while (!read_finish) {
-		if (remain <= 0) {
-			HTTP_LOGE("Error: Request size is too large!!\n");
-			goto errout;
+	/* Parse this request only, the parser terminates it in place */
+	next = buf[client->req_len];
+	read_finish = http_parse_message(buf, client->req_len, &method, url, &body, &enc, &state, &mlen, &request_params, client, NULL, &req);
+	if (read_finish != HTTP_ERROR && read_finish && method != HTTP_METHOD_UNKNOWN) {
+		if (enc == HTTP_CONTENT_LENGTH) {
+			req.entity = body;
+			http_dispatch_url(client, &req);
 		}
+		result = HTTP_OK;
+	}
+	buf[client->req_len] = next;
+
+	if (enc == HTTP_CHUNKED_ENCODING) {
+		HTTP_FREE(body);
+	}
+	http_keyvalue_list_release(&request_params);
+
+out:
+	/*
+	 * A request left without a response would stall the ones behind it,
+	 * close the connection as for a single request. The connection of a
+	 * websocket is handed over once the response is sent.
+	 */
+	if (result != HTTP_OK || !client->responded || client->ws_state >= MIN_WS_HEADER_FIELD) {
+		client->keep_alive = false;
+	}
+
+	/* Move the pipelined requests to the head of the buffer */
+	client->buf_len -= client->req_len;
+	HTTP_MEMMOVE(client->buf, client->buf + client->req_len, client->buf_len);
+	client->req_len = 0;
+	if (client->buf_len == 0) {
+		HTTP_FREE(client->buf);
+		client->buf = NULL;
+	}
+
+	return result;
+}
+
+int http_client_write(struct http_client_t *client)
+{
+	struct http_response_t *resp;
+	int ret;
+
+	while ((resp = client->responses) != NULL) {
 #ifdef CONFIG_NET_SECURITY_TLS
 		if (client->server->tls_init) {
-			len = mbedtls_ssl_read(&(client->tls_ssl), (unsigned char *)buf + buf_len, HTTP_CONF_MAX_REQUEST_LENGTH - buf_len);
+			ret = mbedtls_ssl_write(&(client->tls_ssl), (unsigned char *)resp->data + client->sent, resp->len - client->sent);
+			if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+				return 0;
+			}
 		} else
 #endif
 		{
-			len = recv(client->client_fd, buf + buf_len, HTTP_CONF_MAX_REQUEST_LENGTH - buf_len, 0);
+			ret = send(client->client_fd, resp->data + client->sent, resp->len - client->sent, 0);
+			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				return 0;
+			}
 		}
-		if (len < 0) {
-			HTTP_LOGE("Error: Receive Fail %d\n", len);
-			goto errout;
-		} else if (len == 0) {
-			HTTP_LOGD("Finish read\n");
-			goto errout;
+
+		if (ret < 1) {
+			HTTP_LOGE("Error: Fail to send response\n");
+			return HTTP_ERROR;
 		}
-		buf_len += len;
-		remain -= len;
 
-		read_finish = http_parse_message(buf, len, &method, url, &body, &enc, &state, &mlen, request_params, client, NULL, &req);
-		if (read_finish == HTTP_ERROR) {
-			goto errout;
+		client->sent += ret;
+		if (client->sent == resp->len) {
+			client->responses = resp->next;
+			client->sent = 0;
+			HTTP_FREE(resp);
 		}
 	}
-	if (method == HTTP_METHOD_UNKNOWN) {
-		goto errout;
-	}
 
-	if (enc == HTTP_CONTENT_LENGTH) {
-		req.entity = body;
-		http_dispatch_url(client, &req);
-	}
+	return 1;
+}
 
 #ifdef CONFIG_NETUTILS_WEBSOCKET
-	/* open websocket */
-	if (client->ws_state >= MIN_WS_HEADER_FIELD) {
-		websocket_t *ws = NULL;
-		ws = websocket_find_table();
-		if (ws == NULL) {
-			goto errout;
-		}
-		memset(ws, 0, sizeof(websocket_t));
-		ws->fd = client->client_fd;
-		ws->cb = &client->server->ws_cb;
+/*
+ * Hand the connection over to a websocket thread once the response to the
+ * upgrade request is sent. The websocket reads and writes blocking.
+ */
+int http_client_open_websocket(struct http_client_t *client)
+{
+	websocket_t *ws = NULL;
+	int flags;
+
+	flags = fcntl(client->client_fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(client->client_fd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+		return HTTP_ERROR;
+	}
+
+	ws = websocket_find_table();
+	if (ws == NULL) {
+		return HTTP_ERROR;
+	}
+	memset(ws, 0, sizeof(websocket_t));
+	ws->fd = client->client_fd;
+	ws->cb = &client->server->ws_cb;
 #ifdef CONFIG_NET_SECURITY_TLS
-		if (client->server->tls_init) {
-			ws->tls_enabled = 1;
-			ws->tls_net.fd = client->tls_client_fd.fd;
-			ws->tls_ssl = (mbedtls_ssl_context *)malloc(sizeof(mbedtls_ssl_context));
-			memcpy(ws->tls_ssl, &client->tls_ssl, sizeof(mbedtls_ssl_context));
-			ws->tls_conf = &client->server->tls_conf;
-			mbedtls_ssl_set_bio(ws->tls_ssl, &ws->tls_net, mbedtls_net_send, mbedtls_net_recv, NULL);
-		}
-#endif
-		pthread_attr_init(&ws->thread_attr);
-		pthread_attr_setstacksize(&ws->thread_attr, WEBSOCKET_STACKSIZE);
-		pthread_attr_setschedpolicy(&ws->thread_attr, SCHED_RR);
-		if (pthread_create(&ws->thread_id, &ws->thread_attr,
-						   (pthread_startroutine_t)websocket_server_init,
-						   (pthread_addr_t)ws) != 0) {
-			HTTP_LOGE("Error: Cannot create websocket thread!!\n");
-			goto errout;
-		}
-		pthread_setname_np(ws->thread_id, "websocket handle server");
-		pthread_detach(ws->thread_id);
-	} else
+	if (client->server->tls_init) {
+		ws->tls_enabled = 1;
+		ws->tls_net.fd = client->tls_client_fd.fd;
+		ws->tls_ssl = (mbedtls_ssl_context *)malloc(sizeof(mbedtls_ssl_context));
+		memcpy(ws->tls_ssl, &client->tls_ssl, sizeof(mbedtls_ssl_context));
+		ws->tls_conf = &client->server->tls_conf;
+		mbedtls_ssl_set_bio(ws->tls_ssl, &ws->tls_net, mbedtls_net_send, mbedtls_net_recv, NULL);
+	}
 #endif
-	{
-		close(client->client_fd);
+	pthread_attr_init(&ws->thread_attr);
+	pthread_attr_setstacksize(&ws->thread_attr, WEBSOCKET_STACKSIZE);
+	pthread_attr_setschedpolicy(&ws->thread_attr, SCHED_RR);
+	if (pthread_create(&ws->thread_id, &ws->thread_attr,
+					   (pthread_startroutine_t)websocket_server_init,
+					   (pthread_addr_t)ws) != 0) {
+		HTTP_LOGE("Error: Cannot create websocket thread!!\n");
+		return HTTP_ERROR;
 	}
+	pthread_setname_np(ws->thread_id, "websocket handle server");
+	pthread_detach(ws->thread_id);
 
-	HTTP_FREE(buf);
-	if (enc == HTTP_CHUNKED_ENCODING) {
-		HTTP_FREE(body);
-	}
 	return HTTP_OK;
-errout:
-	close(client->client_fd);
-	HTTP_FREE(buf);
-	if (enc == HTTP_CHUNKED_ENCODING) {
-		HTTP_FREE(body);
-	}
-	return HTTP_ERROR;
 }
+#endif
 
 void http_handle_file(struct http_client_t *client, int method, const char *url, char *entity)
 {
@@ -562,85 +733,139 @@ void http_handle_file(struct http_client_t *client, int method, const char *url,
 	}
 }
 
-int http_send_response(struct http_client_t *client, int status, const char *body, struct http_keyvalue_list_t *headers)
+/*
+ * Appends to a response being formatted and returns its new length. Past
+ * the end of buf only the length is counted, so that a first pass with a
+ * size of 0 gives the size of the buffer to allocate.
+ */
+static int http_append(char *buf, int size, int len, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	if (len < size) {
+		n = vsnprintf(buf + len, size - len, fmt, ap);
+	} else {
+		n = vsnprintf(NULL, 0, fmt, ap);
+	}
+	va_end(ap);
+
+	return n < 0 ? len : len + n;
+}
+
+static int http_format_response(struct http_client_t *client, int status, const char *body, struct http_keyvalue_list_t *headers, char *buf, int size)
 {
-	char *buf;
-	int buflen = 0, ret, sndlen;
+	int buflen = 0;
+	int has_length = false;
+	int has_connection = false;
 	struct http_keyvalue_t *cur = NULL;
 
-	buf = HTTP_MALLOC(HTTP_CONF_MAX_REQUEST_LENGTH);
-	if (buf == NULL) {
-		HTTP_LOGE("Error: Fail to malloc buffer\n");
-		return HTTP_ERROR;
-	}
 #ifdef CONFIG_NETUTILS_WEBSOCKET
 	if (client->ws_state >= MIN_WS_HEADER_FIELD) {
 		unsigned char accept_key[WEBSOCKET_ACCEPT_KEY_LEN] = {0, };
 		websocket_create_accept_key(accept_key, WEBSOCKET_ACCEPT_KEY_LEN, client->ws_key, WEBSOCKET_CLIENT_KEY_LEN);
-		buflen = snprintf(buf, HTTP_CONF_MAX_REQUEST_LENGTH,
-						  "HTTP/1.1 101 Switching Protocols\r\n"
-						  "Upgrade: websocket\r\n"
-						  "Connection: Upgrade\r\n"
-						  "Sec-WebSocket-Accept: %s\r\n\r\n",
-						  accept_key);
-	} else
+		return http_append(buf, size, buflen,
+						   "HTTP/1.1 101 Switching Protocols\r\n"
+						   "Upgrade: websocket\r\n"
+						   "Connection: Upgrade\r\n"
+						   "Sec-WebSocket-Accept: %s\r\n\r\n",
+						   accept_key);
+	}
 #endif
-	{
-		buflen = snprintf(buf, HTTP_CONF_MAX_REQUEST_LENGTH, "HTTP/1.1 %d %s\r\n",
-						  status, (status == 200) ? "OK" : body);
-		if (headers) {
-			cur = headers->head->next;
-			while (cur != headers->tail) {
-				buflen += snprintf(buf + buflen, HTTP_CONF_MAX_REQUEST_LENGTH - buflen,
-								   "%s: %s\r\n", cur->key, cur->value);
-				cur = cur->next;
-			}
-		}
 
-		if (status == 200) {
-			if (headers == NULL) {
-				buflen += snprintf(buf + buflen, HTTP_CONF_MAX_REQUEST_LENGTH - buflen,
-								   "Content-type: text/html\r\n"
-								   "Connection: close\r\n");
-				if (body) {
-					buflen += snprintf(buf + buflen,
-									   HTTP_CONF_MAX_REQUEST_LENGTH - buflen,
-									   "Content-Length: %d\r\n"
-									   "\r\n"
-									   "%s",
-									   strlen(body), body);
-				} else {
-					buflen += snprintf(buf + buflen,
-									   HTTP_CONF_MAX_REQUEST_LENGTH - buflen,
-									   "\r\n");
+	buflen = http_append(buf, size, buflen, "HTTP/1.1 %d %s\r\n",
+						 status, (status == 200) ? "OK" : body);
+	if (headers) {
+		cur = headers->head->next;
+		while (cur != headers->tail) {
+			buflen = http_append(buf, size, buflen,
+								 "%s: %s\r\n", cur->key, cur->value);
+			if (strcasecmp(cur->key, "Content-Length") == 0) {
+				has_length = true;
+			} else if (strcasecmp(cur->key, "Connection") == 0) {
+				has_connection = true;
+				if (strcasecmp(cur->value, "keep-alive") != 0) {
+					client->keep_alive = false;
 				}
-			} else {
-				snprintf(buf + buflen, HTTP_CONF_MAX_REQUEST_LENGTH - buflen,
-						 "\r\n%s", body);
 			}
+			cur = cur->next;
 		}
 	}
 
-	sndlen = strlen(buf);
-	buflen = 0;
-	while (sndlen > 0) {
-#ifdef CONFIG_NET_SECURITY_TLS
-		if (client->server->tls_init) {
-			ret = mbedtls_ssl_write(&(client->tls_ssl), (unsigned char *)buf + buflen, sndlen);
-		} else
-#endif
-		{
-			ret = send(client->client_fd, buf + buflen, sndlen, 0);
-		}
+	/*
+	 * The connection can only be kept alive when the client can find
+	 * the end of the response.
+	 */
+	if (status == 200 && headers != NULL && !has_length) {
+		client->keep_alive = false;
+	}
+	if (!has_connection) {
+		buflen = http_append(buf, size, buflen,
+							 "Connection: %s\r\n",
+							 client->keep_alive ? "keep-alive" : "close");
+	}
 
-		if (ret < 1) {
-			HTTP_FREE(buf);
-			return HTTP_ERROR;
+	if (status == 200) {
+		if (headers == NULL) {
+			buflen = http_append(buf, size, buflen,
+								 "Content-type: text/html\r\n");
+			if (body) {
+				buflen = http_append(buf, size, buflen,
+									 "Content-Length: %d\r\n"
+									 "\r\n"
+									 "%s",
+									 (int)strlen(body), body);
+			} else {
+				buflen = http_append(buf, size, buflen,
+									 "Content-Length: 0\r\n"
+									 "\r\n");
+			}
 		} else {
-			sndlen -= ret;
-			buflen += ret;
+			buflen = http_append(buf, size, buflen,
+								 "\r\n%s", body);
 		}
+	} else if (!has_length) {
+		buflen = http_append(buf, size, buflen,
+							 "Content-Length: 0\r\n\r\n");
+	} else {
+		buflen = http_append(buf, size, buflen,
+							 "\r\n");
 	}
-	HTTP_FREE(buf);
+
+	return buflen;
+}
+
+int http_send_response(struct http_client_t *client, int status, const char *body, struct http_keyvalue_list_t *headers)
+{
+	struct http_response_t *resp;
+	struct http_response_t **tail;
+	int len;
+
+	/*
+	 * The buffer is sized to the whole response, a body larger than a
+	 * request must not be cut while Content-Length still counts it.
+	 */
+	len = http_format_response(client, status, body, headers, NULL, 0);
+	resp = HTTP_MALLOC(sizeof(struct http_response_t) + len + 1);
+	if (resp == NULL) {
+		HTTP_LOGE("Error: Fail to malloc buffer\n");
+		client->keep_alive = false;
+		return HTTP_ERROR;
+	}
+	resp->data = (char *)(resp + 1);
+	resp->len = http_format_response(client, status, body, headers, resp->data, len + 1);
+	client->responded = true;
+
+	/*
+	 * The response is queued on the connection and sent by the server
+	 * thread once the socket is writable, a handler never blocks on a
+	 * slow client.
+	 */
+	resp->next = NULL;
+	for (tail = &client->responses; *tail != NULL; tail = &(*tail)->next) {
+	}
+	*tail = resp;
+
 	return HTTP_OK;
 }
@@ -19,6 +19,7 @@
 #ifndef __http_client_h__
 #define __http_client_h__
 
+#include <tinyara/clock.h>
 #include <apps/netutils/webserver/http_server.h>
 #include <apps/netutils/webclient.h>
 #include <apps/netutils/websocket.h>
@@ -36,19 +37,52 @@
 #include "tls/ssl_cache.h"
 #endif
 
+#define MIN_WS_HEADER_FIELD 2
+
 enum {
 	HTTP_REQUEST_HEADER, HTTP_REQUEST_PARAMETERS, HTTP_REQUEST_BODY
 };
 
+/* State of a connection in the server thread */
+enum {
+	HTTP_CLIENT_HANDSHAKE,	/* running the TLS handshake */
+	HTTP_CLIENT_READ,		/* waiting for a request */
+	HTTP_CLIENT_QUEUED,		/* request read, waiting for a free client handler */
+	HTTP_CLIENT_DISPATCH,	/* request queued to a client handler */
+	HTTP_CLIENT_WRITE		/* sending the responses */
+};
+
+struct http_response_t {
+	struct http_response_t *next;
+	int len;
+	char *data;
+};
+
 struct http_client_t {
 	int client_fd;
 	struct http_server_t *server;
 	int ws_state;
 	unsigned char ws_key[WEBSOCKET_CLIENT_KEY_LEN];
 
+	/* Keep-alive state, the connection outlives the request */
+	int keep_alive;
+	int responded;
+	int nrequests;
+	struct http_client_t *next;
+
+	/* Connection state, owned by the server thread out of a client handler */
+	int state;
+	systime_t since;
+	char *buf;
+	int buf_len;
+	int req_len;
+	struct http_response_t *responses;
+	int sent;
+
 #ifdef CONFIG_NET_SECURITY_TLS
 	mbedtls_ssl_context       tls_ssl;
 	mbedtls_net_context       tls_client_fd;
+	int                       tls_want_write;
 #endif
 };
 
@@ -74,10 +108,16 @@ int http_parse_message(char *buf, int buf_len, int *method, char *url,
 					   struct http_client_t *client,
 					   struct http_client_response_t *response,
 					   struct http_req_message *req);
-int   http_recv_and_handle_request(struct http_client_t *client, struct http_keyvalue_list_t *request_params);
+int   http_client_read(struct http_client_t *client);
+int   http_client_write(struct http_client_t *client);
+int   http_client_handle_request(struct http_client_t *client);
+#ifdef CONFIG_NETUTILS_WEBSOCKET
+int   http_client_open_websocket(struct http_client_t *client);
+#endif
 
 #ifdef CONFIG_NET_SECURITY_TLS
 int   http_client_tls_init(struct http_client_t *client);
+int   http_client_tls_handshake(struct http_client_t *client);
 int   http_client_tls_release(struct http_client_t *client);
 int   http_server_tls_release(struct http_server_t *server);
 #endif
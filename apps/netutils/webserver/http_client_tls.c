@@ -41,20 +41,34 @@ int http_client_tls_init(struct http_client_t *client)
 
 	mbedtls_ssl_set_bio(&(client->tls_ssl), &(client->tls_client_fd),
 						mbedtls_net_send, mbedtls_net_recv, NULL);
+	client->tls_want_write = false;
+
+	return HTTP_OK;
+}
+
+/*
+ * Run the handshake as far as the non-blocking socket allows. Returns
+ * HTTP_ERROR on failure, 0 while it waits for the socket, in the direction
+ * given by tls_want_write, and 1 once it is complete.
+ */
+int http_client_tls_handshake(struct http_client_t *client)
+{
+	int result;
 
-	/* Handshake */
 	HTTP_LOGD("  . Performing the SSL/TLS handshake...");
 
-	while ((result = mbedtls_ssl_handshake(&(client->tls_ssl))) != 0) {
-		if (result != MBEDTLS_ERR_SSL_WANT_READ && result != MBEDTLS_ERR_SSL_WANT_WRITE) {
-			HTTP_LOGE("Error: mbedtls_ssl_handshake returned %d\n", result);
-			return HTTP_ERROR;
-		}
+	result = mbedtls_ssl_handshake(&(client->tls_ssl));
+	if (result == MBEDTLS_ERR_SSL_WANT_READ || result == MBEDTLS_ERR_SSL_WANT_WRITE) {
+		client->tls_want_write = (result == MBEDTLS_ERR_SSL_WANT_WRITE);
+		return 0;
+	} else if (result != 0) {
+		HTTP_LOGE("Error: mbedtls_ssl_handshake returned %d\n", result);
+		return HTTP_ERROR;
 	}
 
 	HTTP_LOGD("Ok\n");
 
-	return HTTP_OK;
+	return 1;
 }
 
 int http_client_tls_release(struct http_client_t *client)
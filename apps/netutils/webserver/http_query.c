@@ -29,101 +29,323 @@
 #include "http_arch.h"
 #include "http_log.h"
 
-static int http_compare_dq(struct http_divided_query_t *src, struct http_divided_query_t *dest, struct http_keyvalue_list_t *params_list)
+/* Length of the segment at seg, up to the next '/' or the end of the url */
+static int http_route_segment_len(const char *seg)
 {
-	int i = 0;
+	int len = 0;
+
+	while (seg[len] != '\0' && seg[len] != '/') {
+		len++;
+	}
+
+	return len;
+}
+
+static unsigned int http_route_hash(const char *seg, int len)
+{
+	unsigned int hash = 5381;
+
+	while (len--) {
+		hash = hash * 33 + (unsigned char)*seg++;
+	}
+
+	return hash;
+}
+
+static int http_route_segment_type(const char *seg, int len)
+{
+	if (len > 1 && seg[0] == ':') {
+		return HTTP_ROUTE_PARAM;
+	} else if (len == 1 && seg[0] == '*') {
+		return HTTP_ROUTE_WILDCARD;
+	}
+
+	return HTTP_ROUTE_LITERAL;
+}
 
-	if (src->slash_count == dest->slash_count) {
-		bool same = true;
-		for (i = 0; i < src->slash_count; i++) {
-			char *src_path = src->paths + (i * HTTP_CONF_MAX_DIVIDED_PATH_LENGTH);
-			char *dest_path = dest->paths + (i * HTTP_CONF_MAX_DIVIDED_PATH_LENGTH);
-
-			if (strcmp(src_path, dest_path) != 0) {
-				/*
-				 * Consider variable string such as ':id', ':num'
-				 */
-				if (src_path[1] != ':' && dest_path[1] != ':') {
-					same = false;
-					break;
+/*
+ * Find the child of node for a segment of a url_format, and add it if
+ * create is set. A ':name' segment shares the param child whatever its
+ * name, the names are kept with the callbacks.
+ */
+static struct http_route_node_t *http_route_child(struct http_route_node_t *node, const char *seg, int len, int create)
+{
+	struct http_route_node_t **link = &node->child;
+	struct http_route_node_t *child;
+	int type = http_route_segment_type(seg, len);
+
+	for (child = node->child; child; child = child->next) {
+		if (child->type == type &&
+			(type != HTTP_ROUTE_LITERAL || (strncmp(child->segment, seg, len) == 0 && child->segment[len] == '\0'))) {
+			return child;
+		}
+		/* Keep the literal children ahead of the param and wildcard ones */
+		if (child->type <= type) {
+			link = &child->next;
+		}
+	}
+
+	if (!create) {
+		return NULL;
+	}
+
+	child = (struct http_route_node_t *)HTTP_MALLOC(sizeof(struct http_route_node_t) + (type == HTTP_ROUTE_LITERAL ? len : 0));
+	if (child == NULL) {
+		return NULL;
+	}
+	HTTP_MEMSET(child, 0, sizeof(struct http_route_node_t));
+	child->type = type;
+	if (type == HTTP_ROUTE_LITERAL) {
+		HTTP_MEMCPY(child->segment, seg, len);
+		child->segment[len] = '\0';
+		child->hash = http_route_hash(seg, len);
+	}
+	child->next = *link;
+	*link = child;
+
+	return child;
+}
+
+/*
+ * Walk the route table along a url_format. Returns the node of its last
+ * segment, or NULL if it is not in the table and create is not set. The
+ * names of its ':name' and '*' segments are copied to names, '\0'
+ * separated, if names is not NULL.
+ */
+static struct http_route_node_t *http_route_find(struct http_server_t *server, const char *url_format, int create, char *names, int *nparams)
+{
+	struct http_route_node_t *node;
+	const char *seg = url_format;
+	int depth = 0;
+	int len;
+
+	if (server->routes == NULL) {
+		if (!create) {
+			return NULL;
+		}
+		server->routes = (struct http_route_node_t *)HTTP_MALLOC(sizeof(struct http_route_node_t));
+		if (server->routes == NULL) {
+			return NULL;
+		}
+		HTTP_MEMSET(server->routes, 0, sizeof(struct http_route_node_t));
+	}
+	node = server->routes;
+	*nparams = 0;
+
+	if (*seg != '/') {
+		return NULL;
+	}
+
+	while (*seg == '/') {
+		seg++;
+		len = http_route_segment_len(seg);
+
+		/* The url of a request has no trailing '/' but the root */
+		if (len == 0 && seg[0] == '\0' && depth > 0) {
+			break;
+		}
+		if (++depth > HTTP_CONF_MAX_SLASH_COUNT) {
+			return NULL;
+		}
+
+		node = http_route_child(node, seg, len, create);
+		if (node == NULL) {
+			return NULL;
+		}
+
+		if (node->type != HTTP_ROUTE_LITERAL) {
+			if (++(*nparams) > HTTP_CONF_MAX_ROUTE_PARAMS) {
+				return NULL;
+			}
+			if (names) {
+				if (node->type == HTTP_ROUTE_PARAM) {
+					HTTP_MEMCPY(names, seg + 1, len - 1);
+					names += len - 1;
 				} else {
-					if (params_list) {
-						if (src_path[1] == ':') {
-							HTTP_LOGD("Add Parameter : [%s: %s]\n", src_path + 2, dest_path + 1);
-							http_keyvalue_list_add(params_list, src_path + 2, dest_path + 1);
-						} else if (dest_path[1] == ':') {
-							HTTP_LOGD("Add Parameter : [%s: %s]\n", dest_path + 2, src_path + 1);
-							http_keyvalue_list_add(params_list, dest_path + 2, src_path + 1);
-						}
-					}
+					*names++ = '*';
+				}
+				*names++ = '\0';
+			}
+			if (node->type == HTTP_ROUTE_WILDCARD) {
+				/* Matches the rest of the url */
+				seg += len;
+				if (*seg != '\0') {
+					return NULL;
+				}
+				break;
+			}
+		}
+		seg += len;
+	}
+
+	if (*seg != '\0') {
+		return NULL;
+	}
+
+	return node;
+}
+
+/* Free the nodes left without callbacks and children below node */
+static int http_route_prune(struct http_route_node_t *node)
+{
+	struct http_route_node_t **link = &node->child;
+	struct http_route_node_t *child;
+	int i;
+
+	while ((child = *link) != NULL) {
+		if (http_route_prune(child)) {
+			*link = child->next;
+			HTTP_FREE(child);
+		} else {
+			link = &child->next;
+		}
+	}
+
+	if (node->child) {
+		return false;
+	}
+	for (i = HTTP_METHOD_GET; i <= HTTP_METHOD_DELETE; i++) {
+		if (node->func[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void http_route_free(struct http_route_node_t *node)
+{
+	struct http_route_node_t *child;
+	struct http_route_node_t *next;
+	int i;
+
+	for (child = node->child; child; child = next) {
+		next = child->next;
+		http_route_free(child);
+	}
+	for (i = HTTP_METHOD_GET; i <= HTTP_METHOD_DELETE; i++) {
+		if (node->names[i]) {
+			HTTP_FREE(node->names[i]);
+		}
+	}
+	HTTP_FREE(node);
+}
+
+/*
+ * Match the segments of a url, '\0' separated from seg to end, below
+ * node. A literal segment is tried before a ':name' one and a '*' one,
+ * so that only a url sharing a prefix with both kinds goes back. The
+ * values of the ':name' and '*' segments are stored in req->params.
+ */
+static struct http_route_node_t *http_route_match(struct http_route_node_t *node, char *seg, char *end, int method, struct http_req_message *req)
+{
+	struct http_route_node_t *child;
+	struct http_route_node_t *found;
+	unsigned int hash;
+	int len;
+	int i;
+
+	if (seg >= end) {
+		return node->func[method] ? node : NULL;
+	}
+
+	len = strlen(seg);
+	hash = http_route_hash(seg, len);
+	for (child = node->child; child; child = child->next) {
+		if (child->type == HTTP_ROUTE_LITERAL) {
+			if (child->hash != hash || strcmp(child->segment, seg) != 0) {
+				continue;
+			}
+			found = http_route_match(child, seg + len + 1, end, method, req);
+		} else if (req->nparams >= HTTP_CONF_MAX_ROUTE_PARAMS) {
+			continue;
+		} else if (child->type == HTTP_ROUTE_PARAM) {
+			req->params[req->nparams++].value = seg;
+			found = http_route_match(child, seg + len + 1, end, method, req);
+			if (found == NULL) {
+				req->nparams--;
+			}
+		} else {
+			if (child->func[method] == NULL) {
+				continue;
+			}
+			/* Join the rest of the url back */
+			for (i = 0; seg + i < end - 1; i++) {
+				if (seg[i] == '\0') {
+					seg[i] = '/';
 				}
 			}
+			req->params[req->nparams++].value = seg;
+			return child;
 		}
 
-		if (same) {
-			return HTTP_OK;
+		if (found) {
+			return found;
 		}
 	}
 
-	return HTTP_ERROR;
+	return NULL;
 }
 
 int http_dispatch_url(struct http_client_t *client, struct http_req_message *req)
 {
-	int i = 0;
 	char query[HTTP_CONF_MAX_URL_QUERY_LENGTH] = {0, };
 	char params[HTTP_CONF_MAX_URL_PARAMS_LENGTH] = {0, };
-	struct http_divided_query_t dq;
-	struct http_keyvalue_list_t params_list;
+	char segs[HTTP_CONF_MAX_URL_QUERY_LENGTH];
+	struct http_route_node_t *node = NULL;
 	char *origin_url = req->url;
+	char *name;
+	int len;
+	int i;
 
 	if (http_divide_query_params(req->url, query, params)) {
 		return HTTP_ERROR;
 	}
 	req->url = query;
 	req->query_string = params;
+	req->nparams = 0;
 
-	http_parse_query(query, &dq);
-	if (http_keyvalue_list_init(&params_list) == HTTP_ERROR) {
-		http_keyvalue_list_release(&params_list);
-		http_release_query(&dq);
-		return HTTP_ERROR;
-	}
-
-	/* Parse url params */
-	if (strlen(params) > 0) {
-		http_parse_params(params, &params_list);
-	}
-
-	for (i = 0; i < HTTP_CONF_MAX_QUERY_HANDLER_COUNT; i++) {
-		struct http_query_handler_t *cur = client->server->query_handlers[i];
-
-		if (cur) {
-			if (cur->method == req->method && http_compare_dq(&cur->dq, &dq, &params_list) == HTTP_OK) {
-				cur->func(client, req);
-				req->url = origin_url;
-				http_keyvalue_list_release(&params_list);
-				http_release_query(&dq);
-				return HTTP_OK;
+	/*
+	 * The route table is walked over a copy of the path split at each
+	 * '/', the captured params point into it.
+	 */
+	if (client->server->routes && query[0] == '/' &&
+		req->method >= HTTP_METHOD_GET && req->method <= HTTP_METHOD_DELETE) {
+		len = strlen(query);
+		HTTP_MEMCPY(segs, query + 1, len);
+		for (i = 0; i < len - 1; i++) {
+			if (segs[i] == '/') {
+				segs[i] = '\0';
 			}
 		}
+		node = http_route_match(client->server->routes, segs, segs + len, req->method, req);
 	}
 
-	if (client->server->cb[req->method]) {
-		client->server->cb[req->method](client, req);
+	if (node) {
+		name = node->names[req->method];
+		for (i = 0; i < req->nparams; i++) {
+			req->params[i].key = name;
+			HTTP_LOGD("Add Parameter : [%s: %s]\n", req->params[i].key, req->params[i].value);
+			name += strlen(name) + 1;
+		}
+		node->func[req->method](client, req);
+	} else {
+		req->nparams = 0;
+		if (client->server->cb[req->method]) {
+			client->server->cb[req->method](client, req);
+		}
 	}
 
 	req->url = origin_url;
-	http_keyvalue_list_release(&params_list);
-	http_release_query(&dq);
 	return HTTP_OK;
 }
 
 int http_server_register_cb(struct http_server_t *server, int method, const char *url_format, http_cb_t func)
 {
-	int i = 0;
-	int empty_slot = 0;
-	struct http_query_handler_t *cur = NULL;
+	struct http_route_node_t *node;
+	char names[HTTP_CONF_MAX_URL_QUERY_LENGTH];
+	int nparams;
+	int len;
 
 	if (server == NULL) {
 		HTTP_LOGE("Error: Server is NULL\n");
@@ -140,42 +362,49 @@ int http_server_register_cb(struct http_server_t *server, int method, const char
 		return HTTP_OK;
 	}
 
-	/* Find empty slot */
-	for (i = 0; i < HTTP_CONF_MAX_QUERY_HANDLER_COUNT; i++) {
-		if (server->query_handlers[i] == NULL) {
-			break;
-		}
+	len = strlen(url_format);
+	if (len >= HTTP_CONF_MAX_URL_QUERY_LENGTH || func == NULL) {
+		HTTP_LOGE("Error: Incorrect url format!!\n");
+		return HTTP_ERROR;
 	}
 
-	if (i == HTTP_CONF_MAX_QUERY_HANDLER_COUNT) {
-		HTTP_LOGE("Error: Not exist empty dq slot!!\n");
+	if (server->nroutes >= HTTP_CONF_MAX_QUERY_HANDLER_COUNT) {
+		HTTP_LOGE("Error: Not exist empty route slot!!\n");
 		return HTTP_ERROR;
 	}
 
-	empty_slot = i;
-
-	server->query_handlers[empty_slot] = (struct http_query_handler_t *)HTTP_MALLOC(sizeof(struct http_query_handler_t));
-	if (server->query_handlers[empty_slot] == NULL) {
-		HTTP_LOGE("Error : Cannot allocate dq slot!!\n");
+	/* Compile the url_format into the route table */
+	node = http_route_find(server, url_format, true, names, &nparams);
+	if (node == NULL) {
+		HTTP_LOGE("Error : Cannot add route %s!!\n", url_format);
+		http_route_prune(server->routes);
 		return HTTP_ERROR;
 	}
 
-	cur = server->query_handlers[empty_slot];
-
-	HTTP_MEMSET(cur, 0, sizeof(struct http_query_handler_t));
-
-	http_parse_query(url_format, &cur->dq);
-
-	cur->method = method;
-	cur->func = func;
+	if (node->func[method] == NULL) {
+		len = 0;
+		while (nparams--) {
+			len += strlen(names + len) + 1;
+		}
+		node->names[method] = (char *)HTTP_MALLOC(len + 1);
+		if (node->names[method] == NULL) {
+			HTTP_LOGE("Error : Cannot add route %s!!\n", url_format);
+			http_route_prune(server->routes);
+			return HTTP_ERROR;
+		}
+		HTTP_MEMCPY(node->names[method], names, len);
+		node->names[method][len] = '\0';
+		server->nroutes++;
+	}
+	node->func[method] = func;
 
 	return HTTP_OK;
 }
 
 int http_server_deregister_cb(struct http_server_t *server, int method, const char *url_format)
 {
-	int i = 0;
-	struct http_divided_query_t dq;
+	struct http_route_node_t *node;
+	int nparams;
 
 	if (server == NULL) {
 		HTTP_LOGE("Error: Server is NULL\n");
@@ -192,55 +421,27 @@ int http_server_deregister_cb(struct http_server_t *server, int method, const ch
 		return HTTP_OK;
 	}
 
-	http_parse_query(url_format, &dq);
-
-	for (i = 0; i < HTTP_CONF_MAX_QUERY_HANDLER_COUNT; i++) {
-		if (server->query_handlers[i] != NULL) {
-			if (server->query_handlers[i]->method == method &&
-				http_compare_dq(&server->query_handlers[i]->dq, &dq, NULL) == HTTP_OK) {
-				http_release_query(&server->query_handlers[i]->dq);
-				HTTP_FREE(server->query_handlers[i]);
-				server->query_handlers[i] = NULL;
-				http_release_query(&dq);
-				return HTTP_OK;
-			}
-		}
+	node = http_route_find(server, url_format, false, NULL, &nparams);
+	if (node == NULL || node->func[method] == NULL) {
+		return HTTP_ERROR;
 	}
 
-	http_release_query(&dq);
-	return HTTP_ERROR;
+	node->func[method] = NULL;
+	HTTP_FREE(node->names[method]);
+	node->names[method] = NULL;
+	server->nroutes--;
+	http_route_prune(server->routes);
+
+	return HTTP_OK;
 }
 
-int http_parse_query(const char *query, struct http_divided_query_t *dq)
+void http_release_routes(struct http_server_t *server)
 {
-	int i = 0;
-	int query_len = (int)strlen(query);
-	int slash_position[HTTP_CONF_MAX_SLASH_COUNT + 1] = {0, };
-
-	HTTP_MEMSET(dq, 0, sizeof(struct http_divided_query_t));
-
-	for (i = 0; i < query_len; i++) {
-		if (query[i] == '/') {
-			slash_position[dq->slash_count++] = i;
-		}
-	}
-
-	/* Set the last slash position as query length. To calculate devided path length */
-	slash_position[dq->slash_count] = query_len;
-
-	dq->paths = (char *)HTTP_MALLOC(dq->slash_count * HTTP_CONF_MAX_DIVIDED_PATH_LENGTH);
-	if (!(dq->paths)) {
-		return HTTP_ERROR;
+	if (server->routes) {
+		http_route_free(server->routes);
+		server->routes = NULL;
 	}
-
-	HTTP_MEMSET(dq->paths, 0, dq->slash_count * HTTP_CONF_MAX_DIVIDED_PATH_LENGTH);
-
-	for (i = 0; i < dq->slash_count; i++) {
-		HTTP_MEMCPY(dq->paths + (i * HTTP_CONF_MAX_DIVIDED_PATH_LENGTH),
-					query + slash_position[i], slash_position[i + 1] - slash_position[i]);
-	}
-
-	return HTTP_OK;
+	server->nroutes = 0;
 }
 
 int http_parse_params(const char *params, struct http_keyvalue_list_t *params_list)
@@ -287,13 +488,6 @@ int http_parse_params(const char *params, struct http_keyvalue_list_t *params_li
 	return HTTP_OK;
 }
 
-void http_release_query(struct http_divided_query_t *dq)
-{
-	if (dq->paths) {
-		HTTP_FREE(dq->paths);
-	}
-}
-
 int http_divide_query_params(const char *url, char *query, char *params)
 {
 	int i = 0;
@@ -21,15 +21,24 @@
 
 #include <stdio.h>
 
-struct http_divided_query_t {
-	int slash_count;
-	char *paths;
+enum {
+	HTTP_ROUTE_LITERAL, HTTP_ROUTE_PARAM, HTTP_ROUTE_WILDCARD
 };
 
-struct http_query_handler_t {
-	int method;
-	struct http_divided_query_t dq;
-	http_cb_t func;
+/*
+ * A node of the route table, one per segment of the registered
+ * url_formats. The children of a node are listed literal segments first,
+ * then the ':name' segment and the '*' segment, in the order they are
+ * tried.
+ */
+struct http_route_node_t {
+	struct http_route_node_t *child;
+	struct http_route_node_t *next;
+	int type;
+	unsigned int hash;						/* hash of a literal segment */
+	http_cb_t func[HTTP_METHOD_DELETE + 1];
+	char *names[HTTP_METHOD_DELETE + 1];	/* param names of the url_format, '\0' separated */
+	char segment[1];						/* literal segment, allocated with the node */
 };
 
 /* Pre definition */
@@ -38,9 +47,8 @@ struct http_client_t;
 struct http_keyvalue_list_t;
 
 int  http_divide_query_params(const char *url, char *query, char *params);
-int  http_parse_query(const char *query, struct http_divided_query_t *dq);
 int  http_parse_params(const char *params, struct http_keyvalue_list_t *params_list);
-void http_release_query(struct http_divided_query_t *dq);
+void http_release_routes(struct http_server_t *server);
 
 int  http_dispatch_url(struct http_client_t *client, struct http_req_message *req);
 
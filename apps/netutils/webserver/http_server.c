@@ -21,6 +21,7 @@
 #include <apps/netutils/webserver/http_server.h>
 
 #include "http_client.h"
+#include "http_query.h"
 #include "http_arch.h"
 #include "http_log.h"
 
@@ -46,8 +47,9 @@ struct http_server_t *http_server_init(int port)
 	p->tls_init = 0;
 	p->state = HTTP_SERVER_INIT;
 
-	/* Init server query handler */
-	HTTP_MEMSET(p->query_handlers, 0, sizeof(struct http_query_handler_t *) * HTTP_CONF_MAX_QUERY_HANDLER_COUNT);
+	/* Init server route table */
+	p->routes = NULL;
+	p->nroutes = 0;
 
 	return p;
 }
@@ -66,6 +68,7 @@ void http_server_release(struct http_server_t **server)
 			http_server_tls_release(*server);
 		}
 #endif
+		http_release_routes(*server);
 		HTTP_FREE(*server);
 		*server = NULL;
 	}
@@ -79,11 +82,21 @@ void http_close_client(struct http_client_t *client)
 
 int http_server_stop(struct http_server_t *server)
 {
+	int i;
+
 	if (server == NULL) {
 		HTTP_LOGE("Error: Server must be started before stop\n");
 		return HTTP_ERROR;
 	}
 
+	/* The stop waits for the callbacks to return */
+	for (i = 0; i < HTTP_CONF_MAX_CLIENT_HANDLE; i++) {
+		if (pthread_equal(pthread_self(), server->c_tid[i])) {
+			HTTP_LOGE("Error: Server cannot be stopped from its callbacks\n");
+			return HTTP_ERROR;
+		}
+	}
+
 	server->state = HTTP_SERVER_STOP_REQ;
 
 	while (server->state != HTTP_SERVER_STOP) {
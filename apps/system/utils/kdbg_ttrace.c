@@ -35,6 +35,7 @@ int selected_tags = 0;
 static void show_help(void);
 static void wait_ttrace_dump(void);
 
+#ifndef CONFIG_TTRACE_COMPACT
 static int print_uid_packet(struct trace_packet *packet)
 {
 	int8_t uid = packet->codelen & ~TTRACE_CODE_UNIQUE;
@@ -84,6 +85,69 @@ static int print_packet(struct trace_packet *packet)
 		return print_message_packet(packet);
 	}
 }
+#else
+/* Trace clock of the last record printed.  Records carry the time elapsed
+ * since the previous one, SYNC records the absolute value.
+ */
+
+static uint32_t g_clock;
+
+static int print_record(uint8_t *rec)
+{
+	uint32_t delta;
+	uint32_t pid;
+	uint32_t ticks;
+	uint32_t usec;
+	uint32_t lost;
+	int len = rec[0];
+	int off = TTRACE_REC_HDR_BYTES;
+
+	if (len <= TTRACE_REC_HDR_BYTES) {
+		return TTRACE_REC_HDR_BYTES;
+	}
+
+	off += ttrace_getvarint(&rec[off], &delta);
+	g_clock += delta;
+
+	switch (rec[1]) {
+	case TTRACE_REC_SYNC:
+		off += ttrace_getvarint(&rec[off], &ticks);
+		off += ttrace_getvarint(&rec[off], &usec);
+		off += ttrace_getvarint(&rec[off], &lost);
+		g_clock = rec[off] | (rec[off + 1] << 8) | (rec[off + 2] << 16) | ((uint32_t)rec[off + 3] << 24);
+		printf("[%010u] sync|ticks=%u usec_per_tick=%u dropped=%u\r\n", g_clock, ticks, usec, lost);
+		break;
+	case TTRACE_REC_TASK:
+		off += ttrace_getvarint(&rec[off], &pid);
+		printf("[%010u] %03u: task|%.*s\r\n", g_clock, pid, len - off, (char *)&rec[off]);
+		break;
+	case TTRACE_REC_BEGIN:
+		off += ttrace_getvarint(&rec[off], &pid);
+		printf("[%010u] %03u: %c|%.*s\r\n", g_clock, pid, TTRACE_EVENT_TYPE_BEGIN, len - off, (char *)&rec[off]);
+		break;
+	case TTRACE_REC_BEGIN_U:
+		off += ttrace_getvarint(&rec[off], &pid);
+		printf("[%010u] %03u: %c|%u\r\n", g_clock, pid, TTRACE_EVENT_TYPE_BEGIN, rec[off]);
+		break;
+	case TTRACE_REC_END:
+		off += ttrace_getvarint(&rec[off], &pid);
+		printf("[%010u] %03u: %c|\r\n", g_clock, pid, TTRACE_EVENT_TYPE_END);
+		break;
+	case TTRACE_REC_SCHED:
+		off += ttrace_getvarint(&rec[off], &pid);
+		printf("[%010u] s|prev_pid=%u prev_prio=%u prev_state=%u", g_clock, pid, rec[off], rec[off + 1]);
+		off += 2;
+		ttrace_getvarint(&rec[off], &pid);
+		printf(" ==> next_pid=%u next_prio=%u\r\n", pid, rec[len - 1]);
+		break;
+	default:
+		printf("[%010u] unknown record %u\r\n", g_clock, rec[1]);
+		break;
+	}
+
+	return len;
+}
+#endif
 
 static void show_help()
 {
@@ -93,7 +157,7 @@ static void show_help()
 	printf("    -f     Finish tracing and print result\r\n");
 	printf("    -i     Show information(state, available/selected/TP used tags, bufsize)\r\n");
 	printf("    -d     Dump trace buffer, It should be run after finish\r\n");
-	printf("    -p     Print trace buffer, It should be run after finish)\r\n");
+	printf("    -p     Print and consume the packets in trace buffer\r\n");
 }
 
 static int assign_tag(char *name)
@@ -122,7 +186,7 @@ static int parse_args(int argc, char **args)
 	 * -t : TTRACE_SELECTED_TAG, select tags(hidden to user)
 	 * -g : TTRACE_FUNC_TAG, TP's tag(hidden to user)
 	 * -d : TTRACE_DUMP, dump mode(hang), It should be run after finish.
-	 * -p : TTRACE_PRINT, print traces, It should be run after finish.
+	 * -p : TTRACE_PRINT, print and consume traces, also while tracing.
 	 */
 	while (1) {
 		optarg = NULL;
@@ -223,7 +287,11 @@ static int read_tracebuffer(FILE *file, int bufsize)
 	}
 
 	while (offset < read_len) {
+#ifdef CONFIG_TTRACE_COMPACT
+		offset += print_record((uint8_t *)(buffer + offset));
+#else
 		offset += print_packet((struct trace_packet *)(buffer + offset));
+#endif
 	}
 
 	free_tracebuffer(buffer);
@@ -161,6 +161,9 @@ typedef struct _db_handle_s db_handle_t;
 struct _db_cursor_s;
 typedef struct _db_cursor_s db_cursor_t;
 
+struct db_stmt_s;
+typedef struct db_stmt_s db_stmt_t;
+
 typedef int db_storage_id_t;
 
 typedef uint32_t cursor_row_t;
@@ -196,6 +199,13 @@ db_result_t db_init(void);
 */
 db_result_t db_deinit(void);
 
+/**
+* @brief write back all buffered tuples and dirty cached pages to storage.
+* @param none
+* @return On success, 1 is returned. On failure, a negative value is returned.
+* @since Tizen RT v1.1
+*/
+db_result_t db_flush(void);
 
 /**
 * @brief Create Component of Arastorage.
@@ -218,6 +228,85 @@ db_result_t db_exec(char *format);
 */
 db_cursor_t *db_query(char *format);
 
+/**
+* @brief Run a query whose rows are evaluated as the cursor moves forward.
+*        Nothing is read before the first cursor_move_first() or cursor_move_next(),
+*        and a LIMIT clause stops the scan once enough rows were returned.
+*        The cursor can not move backwards, cursor_get_count() returns the number
+*        of rows read so far, and the relation stays loaded until db_cursor_free().
+*        Queries with aggregates are evaluated completely, as in db_query().
+*
+* @param[in] query sentence
+* @return On success, pointer of db_cursor_t returned. On failure, a NULL is returned.
+* @since Tizen RT v1.1
+*/
+db_cursor_t *db_query_stream(char *format);
+
+/**
+* @brief Parse a query once so that it can be executed many times by db_step().
+*        Each '?' in the values of an INSERT or in place of a constant in a WHERE
+*        clause is a parameter, numbered from 0 in order of appearance.
+*
+* @param[in] query sentence
+* @return On success, pointer of prepared statement is returned. On failure, a NULL is returned.
+* @since Tizen RT v1.1
+*/
+db_stmt_t *db_prepare(char *format);
+
+/**
+* @brief Bind an int value to a parameter of a prepared statement.
+*        The value is kept for following db_step() calls until it is bound again.
+*
+* @param[in] prepared statement
+* @param[in] index of parameter
+* @param[in] value
+* @return On success, positive value is returned. On failure, a negative value is returned.
+* @since Tizen RT v1.1
+*/
+db_result_t db_bind_int(db_stmt_t *stmt, int index, int value);
+
+/**
+* @brief Bind a long value to a parameter of a prepared statement.
+*
+* @param[in] prepared statement
+* @param[in] index of parameter
+* @param[in] value
+* @return On success, positive value is returned. On failure, a negative value is returned.
+* @since Tizen RT v1.1
+*/
+db_result_t db_bind_long(db_stmt_t *stmt, int index, long value);
+
+/**
+* @brief Bind a string value to a parameter in the values of a prepared INSERT.
+*        The string is not copied and must stay valid until db_step() is called.
+*
+* @param[in] prepared statement
+* @param[in] index of parameter
+* @param[in] value
+* @return On success, positive value is returned. On failure, a negative value is returned.
+* @since Tizen RT v1.1
+*/
+db_result_t db_bind_string(db_stmt_t *stmt, int index, char *value);
+
+/**
+* @brief Execute a prepared statement with the currently bound parameters.
+*        While an INSERT is prepared, its relation stays loaded and cannot be removed.
+*
+* @param[in] prepared statement
+* @param[out] cursor of selected data for SELECT and REMOVE FROM, may be NULL otherwise
+* @return On success, positive value is returned. On failure, a negative value is returned.
+* @since Tizen RT v1.1
+*/
+db_result_t db_step(db_stmt_t *stmt, db_cursor_t **cursor);
+
+/**
+* @brief Release a prepared statement.
+*
+* @param[in] prepared statement
+* @return On success, positive value is returned. On failure, a negative value is returned.
+* @since Tizen RT v1.1
+*/
+db_result_t db_finalize(db_stmt_t *stmt);
 
 /**
 * @brief free allocated cursor data. This should be called before application terminated.
@@ -96,6 +96,8 @@
 #define AQL_FLAG_AGGREGATE              1
 #define AQL_FLAG_SELECT_ALL             2
 #define AQL_FLAG_ASSIGN                 4
+#define AQL_FLAG_COLUMNAR               8
+#define AQL_FLAG_MEMORY                 16
 
 #define AQL_CLEAR(adt)                  aql_clear(adt)
 #define AQL_SET_TYPE(adt, type)  (((adt))->optype = (type))
@@ -124,6 +126,8 @@
 	aql_add_operand_value((adt), (value))
 #define AQL_ATTRIBUTE_COUNT(adt)        ((adt)->attribute_count)
 #define AQL_SET_CONDITION(adt, cond)    ((adt)->lvm_instance = (cond))
+#define AQL_SET_LIMIT(adt, count)       ((adt)->limit = (count))
+#define AQL_GET_LIMIT(adt)              ((adt)->limit)
 #define AQL_ADD_VALUE(adt, domain, value)                               \
 	aql_add_value((adt), (domain), (value))
 
@@ -193,6 +197,12 @@ enum token_e {
 
 	ATTRIBUTE,
 	BPLUSTREE,					/* 48 */
+	BTREE,
+	PARAMETER,
+	LIMIT,
+	COLUMNAR,
+	HASH,
+	MEMORY,
 
 	INTEGER_VALUE = 251,
 	FLOAT_VALUE = 252,
@@ -245,9 +255,20 @@ struct aql_adt_s {
 	uint32_t optype;
 	uint8_t flags;
 	void *lvm_instance;
+	tuple_id_t limit;			/* Maximum number of result rows, 0 for no limit */
+	uint8_t parameter_count;
+	int8_t parameter_values[AQL_PARAMETER_LIMIT];	/* Slot in values, or -1 for a WHERE operand */
 };
 typedef struct aql_adt_s aql_adt_t;
 
+/* A statement parsed once by db_prepare() and executed by db_step(). */
+struct db_stmt_s {
+	aql_adt_t adt;
+	relation_t *rel;			/* Relation kept loaded between INSERTs */
+	long operands[AQL_PARAMETER_LIMIT];	/* Values bound to WHERE operands */
+	uint32_t bound;				/* Bitmap of the bound parameters */
+};
+
 /****************************************************************************
 * Global Function Prototypes
 ****************************************************************************/
@@ -260,5 +281,9 @@ void aql_add_relation(aql_adt_t *adt, char *rel);
 aql_status_t aql_parse(aql_adt_t *adt, char *query_string);
 db_result_t aql_add_attribute(aql_adt_t *adt, char *name, domain_t domain, unsigned element_size, int processed_only);
 db_result_t aql_add_value(aql_adt_t *adt, domain_t domain, void *value);
+int aql_add_parameter(aql_adt_t *adt, int is_value);
+
+db_result_t aql_init_handle(db_handle_t **handle);
+db_result_t aql_deinit_handle(db_handle_t **handle);
 
 #endif							/* !AQL_H */
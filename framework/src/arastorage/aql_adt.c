@@ -85,6 +85,8 @@ void aql_clear(aql_adt_t *adt)
 	adt->attribute_count = 0;
 	adt->value_count = 0;
 	adt->flags = 0;
+	adt->limit = 0;
+	adt->parameter_count = 0;
 	memset(adt->aggregators, 0, sizeof(adt->aggregators));
 }
 
@@ -160,3 +162,31 @@ db_result_t aql_add_value(aql_adt_t *adt, domain_t domain, void *value_ptr)
 
 	return DB_OK;
 }
+
+/*
+ * Registers a '?' placeholder and returns its parameter number, or -1 when
+ * there is no room left. A placeholder in the values of an INSERT takes a
+ * value slot which db_bind_*() fills in later.
+ */
+int aql_add_parameter(aql_adt_t *adt, int is_value)
+{
+	attribute_value_t *value;
+
+	if (adt->parameter_count == AQL_PARAMETER_LIMIT) {
+		return -1;
+	}
+
+	if (is_value) {
+		if (adt->value_count == AQL_ATTRIBUTE_LIMIT) {
+			return -1;
+		}
+		value = &adt->values[adt->value_count];
+		value->domain = DOMAIN_UNSPECIFIED;
+		VALUE_LONG(value) = 0;
+		adt->parameter_values[adt->parameter_count] = adt->value_count++;
+	} else {
+		adt->parameter_values[adt->parameter_count] = -1;
+	}
+
+	return adt->parameter_count++;
+}
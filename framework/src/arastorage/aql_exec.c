@@ -68,6 +68,9 @@
 #include "relation.h"
 #include "result.h"
 #include "aql.h"
+#include "lvm.h"
+#include "index.h"
+#include "snapshot.h"
 
 /****************************************************************************
 * Private Functions
@@ -91,6 +94,11 @@ db_result_t aql_deinit_handle(db_handle_t **handle)
 		return DB_ARGUMENT_ERROR;
 	}
 	res = DB_OK;
+	index_release_iterator(&(*handle)->index_iterator);
+	if ((*handle)->snapshot != NULL) {
+		snapshot_close((*handle)->snapshot);
+		(*handle)->snapshot = NULL;
+	}
 	if ((*handle)->rel != NULL) {
 		res = relation_release((*handle)->rel);
 		if (DB_ERROR(res)) {
@@ -146,73 +154,103 @@ relation_t *aql_get_relation(aql_adt_t *adt)
 	return relation_load(adt->relations[first_rel_arg]);
 }
 
-db_result_t db_exec(char *format)
+/* Reclaims the tuples removed from rel once no query can see them. The caller holds the catalog lock. */
+static void aql_collect(relation_t *rel)
+{
+	if (snapshot_collectable(rel) && DB_ERROR(relation_vacuum(rel))) {
+		DB_LOG_E("DB : Failed to vacuum relation %s\n", rel->name);
+	}
+}
+
+/* Returns true unless rel has a BTREE index, which has no fixed tuple limit. */
+static bool aql_tuple_limited(relation_t *rel)
+{
+	attribute_t *attr;
+
+	for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+		if (attr->index == NULL) {
+			index_load(rel, attr);
+		}
+		if (attr->index != NULL && ((index_t *)attr->index)->type == INDEX_BTREE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Executes a parsed statement; rel is loaded here unless given by the caller. */
+static db_result_t aql_execute(aql_adt_t *adt, relation_t *rel)
 {
 	db_result_t res;
-	aql_adt_t adt;
-	relation_t *rel = NULL;
 	aql_attribute_t *attr;
 	attribute_t *relattr = NULL;
 	uint32_t optype;
-	res = aql_get_parse_result(format, &adt);
-
-	if (DB_ERROR(res)) {
-		DB_LOG_E("DB : Parsing Error in db_create : %d\n", res);
-		return DB_PARSING_ERROR;
-	}
+	bool loaded = false;
 
-	optype = AQL_GET_OP_TYPE(AQL_GET_TYPE(&adt));
+	optype = AQL_GET_OP_TYPE(AQL_GET_TYPE(adt));
 	if (optype == AQL_OP_TYPE_QUERY) {
 		DB_LOG_E("DB : AQL OP TYPE Error \n");
 		return DB_ARGUMENT_ERROR;
 	}
 
-	optype = AQL_GET_EXEC_TYPE(AQL_GET_TYPE(&adt));
-	if (optype != AQL_TYPE_CREATE_RELATION) {
-		rel = aql_get_relation(&adt);
+	/* Writers run one at a time, queries keep reading their snapshots */
+	snapshot_lock();
+
+	optype = AQL_GET_EXEC_TYPE(AQL_GET_TYPE(adt));
+	/* relation_remove() loads the relation itself and fails while it is in use */
+	if (optype != AQL_TYPE_CREATE_RELATION && optype != AQL_TYPE_REMOVE_RELATION && rel == NULL) {
+		rel = aql_get_relation(adt);
 		if (rel == NULL) {
 			DB_LOG_E("DB : get relation Failed\n");
+			snapshot_unlock();
 			return DB_RELATIONAL_ERROR;
 		}
+		loaded = true;
 	}
 
 	res = DB_RELATIONAL_ERROR;
 
 	switch (optype) {
 	case AQL_TYPE_CREATE_ATTRIBUTE:
-		attr = &(adt.attributes[0]);
+		attr = &(adt->attributes[0]);
 		if (relation_attribute_add(rel, DB_STORAGE, attr->name, attr->domain, attr->element_size) != NULL) {
 			res = DB_OK;
 		}
 		break;
 	case AQL_TYPE_CREATE_INDEX:
-		relattr = relation_attribute_get(rel, adt.attributes[0].name);
+		relattr = relation_attribute_get(rel, adt->attributes[0].name);
 		if (relattr == NULL) {
 			res = DB_NAME_ERROR;
 			break;
 		}
-		res = index_create(AQL_GET_INDEX_TYPE(&adt), rel, relattr);
+		res = index_create(AQL_GET_INDEX_TYPE(adt), rel, relattr);
 		break;
 	case AQL_TYPE_CREATE_RELATION:
-		if (relation_create(adt.relations[0], DB_STORAGE) != NULL) {
+		if (relation_create(adt->relations[0], (AQL_GET_FLAGS(adt) & AQL_FLAG_MEMORY) ? DB_VOLATILE : DB_STORAGE, (AQL_GET_FLAGS(adt) & AQL_FLAG_COLUMNAR) ? DB_LAYOUT_COLUMN : DB_LAYOUT_ROW) != NULL) {
 			res = DB_OK;
 		}
 		break;
 	case AQL_TYPE_INSERT:
-		if (relation_cardinality(rel) < DB_TUPLE_LIMIT) {
-			res = relation_insert(rel, adt.values);
+		if (relation_cardinality(rel) < DB_TUPLE_LIMIT || !aql_tuple_limited(rel)) {
+			res = relation_insert(rel, adt->values);
 			if (DB_SUCCESS(res)) {
 				res = DB_OK;
+				aql_collect(rel);
 			}
 		} else {
 			res = DB_LIMIT_ERROR;
 		}
 		break;
 	case AQL_TYPE_REMOVE_ATTRIBUTE:
-		res = relation_attribute_remove(rel, adt.attributes[0].name);
+		res = relation_attribute_remove(rel, adt->attributes[0].name);
 		break;
 	case AQL_TYPE_REMOVE_INDEX:
-		relattr = relation_attribute_get(rel, adt.attributes[0].name);
+		if (snapshot_active(rel)) {
+			/* A query may still be iterating over the index */
+			res = DB_BUSY_ERROR;
+			break;
+		}
+		relattr = relation_attribute_get(rel, adt->attributes[0].name);
 		if (relattr != NULL) {
 			index_load(rel, relattr);
 			if (relattr->index != NULL) {
@@ -225,20 +263,22 @@ db_result_t db_exec(char *format)
 		}
 		break;
 	case AQL_TYPE_REMOVE_RELATION:
-		res = relation_remove(adt.relations[0], 1);
+		res = relation_remove(adt->relations[0], 1);
 		break;
 	default:
 		break;
 	}
-	if (rel != NULL) {
+	if (loaded) {
 		relation_release(rel);
 	}
+	snapshot_unlock();
 	return res;
 }
 
-db_cursor_t *db_query(char *format)
+/* Runs a parsed query. The LVM instance of adt is handed over to the query handle,
+   which a streaming cursor keeps until it is freed. */
+static db_cursor_t *aql_query(aql_adt_t *adt, bool stream)
 {
-	aql_adt_t adt;
 	relation_t *rel;
 	uint32_t optype;
 	db_handle_t *handler;
@@ -248,34 +288,37 @@ db_cursor_t *db_query(char *format)
 	handler = NULL;
 	cursor = NULL;
 
-	if (DB_ERROR(aql_get_parse_result(format, &adt))) {
-		DB_LOG_E("DB : Parsing Error in db_create : %d\n");
-		return NULL;
-	}
-	optype = AQL_GET_OP_TYPE(AQL_GET_TYPE(&adt));
+	optype = AQL_GET_OP_TYPE(AQL_GET_TYPE(adt));
 	if (optype != AQL_OP_TYPE_QUERY) {
 		DB_LOG_E("DB : AQL OP TYPE Error \n");
 		return NULL;
 	}
+	/* Held while the query sets up and finishes, and for the whole of a REMOVE */
+	snapshot_lock();
+
 #ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
 	if (DB_SUCCESS(storage_flush_insert_buffer())) {
 		DB_LOG_D("DB : flush insert buffer!!\n");
 	}
 #endif
 
-	rel = aql_get_relation(&adt);
+	rel = aql_get_relation(adt);
 	if (rel == NULL) {
+		snapshot_unlock();
+		if (adt->lvm_instance != NULL) {
+			free(adt->lvm_instance);
+		}
 		return NULL;
 	}
 
-	optype = AQL_GET_EXEC_TYPE(AQL_GET_TYPE(&adt));
+	optype = AQL_GET_EXEC_TYPE(AQL_GET_TYPE(adt));
 	switch (optype) {
 	case AQL_TYPE_REMOVE_TUPLES:
 		/* Overwrite the attribute array with a full copy of the original
 		   relation's attributes. */
-		adt.attribute_count = 0;
+		adt->attribute_count = 0;
 		for (attr_ptr = list_head(rel->attributes); attr_ptr != NULL; attr_ptr = attr_ptr->next) {
-			AQL_ADD_ATTRIBUTE(&adt, attr_ptr->name, DOMAIN_UNSPECIFIED, 0);
+			AQL_ADD_ATTRIBUTE(adt, attr_ptr->name, DOMAIN_UNSPECIFIED, 0);
 		}
 	/* FALLTHROUGH */
 	case AQL_TYPE_SELECT:
@@ -283,15 +326,30 @@ db_cursor_t *db_query(char *format)
 			DB_LOG_E("DB: Init handle failed\n");
 			goto errout;
 		}
-		if (DB_ERROR(relation_select(&handler, rel, &adt))) {
+		if (DB_ERROR(relation_select(&handler, rel, adt))) {
 			DB_LOG_E("DB: Failed relation_select\n");
 			goto errout;
 		}
-		cursor = relation_process_result(handler);
+		/* Aggregates need every tuple before the first row exists. */
+		if (stream && optype == AQL_TYPE_SELECT && !(handler->adt_flags & AQL_FLAG_AGGREGATE)) {
+			handler->flags |= DB_HANDLE_FLAG_STREAM;
+		}
+		if (optype == AQL_TYPE_SELECT) {
+			/* The snapshot is read without the lock */
+			snapshot_unlock();
+			cursor = relation_process_result(handler);
+			snapshot_lock();
+		} else {
+			cursor = relation_process_result(handler);
+		}
 		if (cursor == NULL) {
 			DB_LOG_E("DB: Failed to process cursor tuples\n");
 			goto errout;
 		}
+		if (cursor->handle != NULL) {
+			snapshot_unlock();
+			return cursor;
+		}
 		break;
 	case AQL_TYPE_FLUSH:
 	//TODO flush operation will be implemented later
@@ -305,6 +363,7 @@ db_cursor_t *db_query(char *format)
 		}
 	}
 	aql_deinit_handle(&handler);
+	snapshot_unlock();
 
 	return cursor;
 
@@ -318,6 +377,243 @@ errout:
 	}
 
 	aql_deinit_handle(&handler);
+	snapshot_unlock();
 
 	return NULL;
 }
+
+db_result_t db_exec(char *format)
+{
+	db_result_t res;
+	aql_adt_t adt;
+
+	res = aql_get_parse_result(format, &adt);
+	if (DB_ERROR(res)) {
+		DB_LOG_E("DB : Parsing Error in db_create : %d\n", res);
+		return DB_PARSING_ERROR;
+	}
+	if (adt.parameter_count > 0) {
+		DB_LOG_E("DB : Parameters need db_prepare\n");
+		return DB_ARGUMENT_ERROR;
+	}
+
+	return aql_execute(&adt, NULL);
+}
+
+static db_cursor_t *aql_query_string(char *format, bool stream)
+{
+	aql_adt_t adt;
+
+	if (DB_ERROR(aql_get_parse_result(format, &adt))) {
+		DB_LOG_E("DB : Parsing Error in db_create : %d\n");
+		return NULL;
+	}
+	if (adt.parameter_count > 0) {
+		DB_LOG_E("DB : Parameters need db_prepare\n");
+		if (adt.lvm_instance != NULL) {
+			free(adt.lvm_instance);
+		}
+		return NULL;
+	}
+
+	return aql_query(&adt, stream);
+}
+
+db_cursor_t *db_query(char *format)
+{
+	return aql_query_string(format, false);
+}
+
+db_cursor_t *db_query_stream(char *format)
+{
+	return aql_query_string(format, true);
+}
+
+db_stmt_t *db_prepare(char *format)
+{
+	db_stmt_t *stmt;
+
+	stmt = (db_stmt_t *)malloc(sizeof(db_stmt_t));
+	if (stmt == NULL) {
+		return NULL;
+	}
+	memset(stmt, 0, sizeof(db_stmt_t));
+
+	if (DB_ERROR(aql_get_parse_result(format, &stmt->adt))) {
+		DB_LOG_E("DB : Parsing Error in db_prepare\n");
+		if (stmt->adt.lvm_instance != NULL) {
+			free(stmt->adt.lvm_instance);
+		}
+		free(stmt);
+		return NULL;
+	}
+
+	if (AQL_GET_EXEC_TYPE(AQL_GET_TYPE(&stmt->adt)) == AQL_TYPE_INSERT) {
+		/* Keep the relation and its tuple file open for the following steps */
+		snapshot_lock();
+		stmt->rel = aql_get_relation(&stmt->adt);
+		snapshot_unlock();
+		if (stmt->rel == NULL) {
+			db_finalize(stmt);
+			return NULL;
+		}
+	}
+
+	return stmt;
+}
+
+static attribute_value_t *stmt_value(db_stmt_t *stmt, int index)
+{
+	if (stmt == NULL || index < 0 || index >= stmt->adt.parameter_count || stmt->adt.parameter_values[index] < 0) {
+		return NULL;
+	}
+	return &stmt->adt.values[(int)stmt->adt.parameter_values[index]];
+}
+
+db_result_t db_bind_long(db_stmt_t *stmt, int index, long value)
+{
+	attribute_value_t *param;
+
+	if (stmt == NULL || index < 0 || index >= stmt->adt.parameter_count) {
+		return DB_ARGUMENT_ERROR;
+	}
+
+	param = stmt_value(stmt, index);
+	if (param != NULL) {
+		param->domain = DOMAIN_LONG;
+		VALUE_LONG(param) = value;
+	} else {
+		stmt->operands[index] = value;
+	}
+	stmt->bound |= 1 << index;
+
+	return DB_OK;
+}
+
+db_result_t db_bind_int(db_stmt_t *stmt, int index, int value)
+{
+	attribute_value_t *param;
+
+	param = stmt_value(stmt, index);
+	if (param == NULL) {
+		/* Condition operands are evaluated as long values */
+		return db_bind_long(stmt, index, value);
+	}
+
+	param->domain = DOMAIN_INT;
+	/* Stored like the parser stores integer constants */
+	VALUE_LONG(param) = value;
+	stmt->bound |= 1 << index;
+
+	return DB_OK;
+}
+
+db_result_t db_bind_string(db_stmt_t *stmt, int index, char *value)
+{
+	attribute_value_t *param;
+
+	if (value == NULL) {
+		return DB_ARGUMENT_ERROR;
+	}
+
+	param = stmt_value(stmt, index);
+	if (param == NULL) {
+		return stmt == NULL || index < 0 || index >= stmt->adt.parameter_count ? DB_ARGUMENT_ERROR : DB_TYPE_ERROR;
+	}
+
+	param->domain = DOMAIN_STRING;
+	VALUE_STRING(param) = (unsigned char *)value;
+	stmt->bound |= 1 << index;
+
+	return DB_OK;
+}
+
+db_result_t db_step(db_stmt_t *stmt, db_cursor_t **cursor)
+{
+	lvm_instance_t *condition;
+	lvm_instance_t *lvm;
+	db_cursor_t *result;
+	int i;
+
+	if (cursor != NULL) {
+		*cursor = NULL;
+	}
+	if (stmt == NULL) {
+		return DB_ARGUMENT_ERROR;
+	}
+	if (stmt->bound != (uint32_t)((1ULL << stmt->adt.parameter_count) - 1)) {
+		DB_LOG_E("DB : Not all parameters are bound\n");
+		return DB_ARGUMENT_ERROR;
+	}
+
+	if (AQL_GET_OP_TYPE(AQL_GET_TYPE(&stmt->adt)) != AQL_OP_TYPE_QUERY) {
+		return aql_execute(&stmt->adt, stmt->rel);
+	}
+
+	/* The query consumes its own copy of the compiled condition */
+	condition = (lvm_instance_t *)stmt->adt.lvm_instance;
+	if (condition != NULL) {
+		lvm = (lvm_instance_t *)malloc(sizeof(lvm_instance_t));
+		if (lvm == NULL) {
+			return DB_ALLOCATION_ERROR;
+		}
+		lvm_clone(lvm, condition);
+		for (i = 0; i < stmt->adt.parameter_count; i++) {
+			if (stmt->adt.parameter_values[i] < 0) {
+				lvm_bind_long(lvm, i, stmt->operands[i]);
+			}
+		}
+		AQL_SET_CONDITION(&stmt->adt, lvm);
+	}
+
+	result = aql_query(&stmt->adt, false);
+	AQL_SET_CONDITION(&stmt->adt, condition);
+	if (result == NULL) {
+		return DB_RELATIONAL_ERROR;
+	}
+
+	if (cursor != NULL) {
+		*cursor = result;
+	} else {
+		snapshot_lock();
+		cursor_deinit(result);
+		snapshot_unlock();
+	}
+	return DB_OK;
+}
+
+db_result_t db_finalize(db_stmt_t *stmt)
+{
+	attribute_value_t *value;
+	int i;
+	int j;
+
+	if (stmt == NULL) {
+		return DB_ARGUMENT_ERROR;
+	}
+
+	if (stmt->rel != NULL) {
+		snapshot_lock();
+		relation_release(stmt->rel);
+		snapshot_unlock();
+	}
+	if (stmt->adt.lvm_instance != NULL) {
+		free(stmt->adt.lvm_instance);
+	}
+
+	/* Free the string constants copied by the parser, not the bound ones */
+	for (i = 0; i < stmt->adt.value_count; i++) {
+		value = &stmt->adt.values[i];
+		for (j = 0; j < stmt->adt.parameter_count; j++) {
+			if (stmt->adt.parameter_values[j] == i) {
+				break;
+			}
+		}
+		if (j == stmt->adt.parameter_count && value->domain == DOMAIN_STRING) {
+			free(VALUE_STRING(value));
+		}
+	}
+
+	free(stmt);
+	return DB_OK;
+}
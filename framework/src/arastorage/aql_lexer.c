@@ -87,8 +87,9 @@ static const struct keyword keywords[] = {
 	{"*", MUL},
 	{"/", DIV},
 	{"#", COMMENT},
+	{"?", PARAMETER},
 
-	{">=", GEQ},				/* 13 */
+	{">=", GEQ},				/* 14 */
 	{"<=", LEQ},
 	{"<>", NOT_EQUAL},
 	{"<-", ASSIGN},
@@ -97,7 +98,7 @@ static const struct keyword keywords[] = {
 	{"ON", ON},
 	{"IN", IN},
 
-	{"ALL", ALL},				/* 21 */
+	{"ALL", ALL},				/* 22 */
 	{"AND", AND},
 	{"NOT", NOT},
 	{"SUM", SUM},
@@ -105,18 +106,21 @@ static const struct keyword keywords[] = {
 	{"MIN", MIN},
 	{"INT", INT},
 
-	{"INTO", INTO},				/* 28 */
+	{"INTO", INTO},				/* 29 */
 	{"FROM", FROM},
 	{"MEAN", MEAN},
 	{"JOIN", JOIN},
 	{"LONG", LONG},
 	{"TYPE", TYPE},
+	{"HASH", HASH},
 
-	{"WHERE", WHERE},			/* 34 */
+	{"WHERE", WHERE},			/* 36 */
 	{"COUNT", COUNT},
 	{"INDEX", INDEX},
+	{"BTREE", BTREE},
+	{"LIMIT", LIMIT},
 
-	{"INSERT", INSERT},			/* 37 */
+	{"INSERT", INSERT},			/* 41 */
 	{"SELECT", SELECT},
 	{"REMOVE", REMOVE},
 	{"CREATE", CREATE},
@@ -125,19 +129,21 @@ static const struct keyword keywords[] = {
 	{"STRING", STRING},
 	{"INLINE", INLINE},
 	{"REMAIN", REMAIN},
+	{"MEMORY", MEMORY},
 
-	{"PROJECT", PROJECT},		/* 46 */
+	{"PROJECT", PROJECT},		/* 51 */
 
-	{"RELATION", RELATION},		/* 47 */
+	{"RELATION", RELATION},		/* 52 */
+	{"COLUMNAR", COLUMNAR},
 
-	{"ATTRIBUTE", ATTRIBUTE},	/* 48 */
+	{"ATTRIBUTE", ATTRIBUTE},	/* 54 */
 	{"BPLUSTREE", BPLUSTREE}
 };
 
 /* Provides a pointer to the first keyword of a specific length. */
-static const int8_t skip_hint[] = { 0, 13, 21, 28, 34, 37, 46, 47, 48 };
+static const int8_t skip_hint[] = { 0, 14, 22, 29, 36, 41, 51, 52, 54 };
 
-static char separators[] = "#.;,() \t\n";
+static char separators[] = "#.;,()? \t\n";
 
 /****************************************************************************
 * Private Functions
@@ -261,6 +261,11 @@ PARSER(values)
 	case INTEGER_VALUE:
 		AQL_ADD_VALUE(adt, DOMAIN_INT, VALUE);
 		break;
+	case PARAMETER:
+		if (aql_add_parameter(adt, 1) < 0) {
+			RETURN(SYNTAX_ERROR);
+		}
+		break;
 	default:
 		RETURN(SYNTAX_ERROR);
 	}
@@ -278,6 +283,7 @@ PARSER(values)
 PARSER(operand)
 {
 	lvm_instance_t *p;
+	int param;
 
 	p = adt->lvm_instance;
 
@@ -295,6 +301,13 @@ PARSER(operand)
 	case INTEGER_VALUE:
 		lvm_set_long(p, *(long *)lexer->value);
 		break;
+	case PARAMETER:
+		param = aql_add_parameter(adt, 0);
+		if (param < 0) {
+			RETURN(SYNTAX_ERROR);
+		}
+		lvm_set_parameter(p, param);
+		break;
 	default:
 		RETURN(SYNTAX_ERROR);
 	}
@@ -469,6 +482,20 @@ PARSER(where)
 	return STATUS_OK;
 }
 
+PARSER(limit)
+{
+	long count;
+
+	CONSUME(INTEGER_VALUE);
+	count = *(long *)lexer->value;
+	if (count <= 0) {
+		RETURN(SYNTAX_ERROR);
+	}
+	AQL_SET_LIMIT(adt, count);
+
+	RETURN(STATUS_OK);
+}
+
 PARSER(select)
 {
 	lvm_instance_t *lvm;
@@ -508,9 +535,22 @@ PARSER(select)
 			AQL_SET_CONDITION(adt, NULL);
 			RETURN(SYNTAX_ERROR);
 		}
-	} else {
+		NEXT;
+	}
+
+	if (TOKEN == LIMIT) {
+		if (!PARSE(limit)) {
+			if (adt->lvm_instance != NULL) {
+				free(adt->lvm_instance);
+				AQL_SET_CONDITION(adt, NULL);
+			}
+			RETURN(SYNTAX_ERROR);
+		}
+	} else if (adt->lvm_instance == NULL) {
 		REWIND;
 		RETURN(STATUS_OK);
+	} else {
+		REWIND;
 	}
 
 	CONSUME(END);
@@ -602,10 +642,7 @@ PARSER(remove_from)
 
 	AQL_SET_TYPE(adt, AQL_TYPE_REMOVE_TUPLES);
 
-	/* Use a temporary persistent relation to assign the query result to. */
-	AQL_SET_FLAG(adt, AQL_FLAG_ASSIGN);
-	AQL_ADD_RELATION(adt, REMOVE_RELATION);
-
+	/* Tuples are removed in place, readers keep seeing their snapshot. */
 	CONSUME(IDENTIFIER);
 	AQL_ADD_RELATION(adt, VALUE);
 
@@ -692,6 +729,8 @@ PARSER_TOKEN(index_type)
 	switch (TOKEN) {
 	case INLINE:
 	case BPLUSTREE:
+	case BTREE:
+	case HASH:
 		return TOKEN;
 	default:
 		return NONE;
@@ -729,6 +768,12 @@ PARSER(create_index)
 	case BPLUSTREE:
 		type = INDEX_BPLUSTREE;
 		break;
+	case BTREE:
+		type = INDEX_BTREE;
+		break;
+	case HASH:
+		type = INDEX_HASH;
+		break;
 	default:
 		RETURN(SYNTAX_ERROR);
 	}
@@ -746,6 +791,28 @@ PARSER(create_relation)
 	AQL_SET_TYPE(adt, AQL_TYPE_CREATE_RELATION);
 	AQL_ADD_RELATION(adt, VALUE);
 
+	NEXT;
+	if (TOKEN != TYPE) {
+		REWIND;
+		RETURN(STATUS_OK);
+	}
+
+	NEXT;
+	switch (TOKEN) {
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	case COLUMNAR:
+		AQL_SET_FLAG(adt, AQL_FLAG_COLUMNAR);
+		break;
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	case MEMORY:
+		AQL_SET_FLAG(adt, AQL_FLAG_MEMORY);
+		break;
+#endif
+	default:
+		RETURN(SYNTAX_ERROR);
+	}
+
 	RETURN(STATUS_OK);
 }
 
@@ -66,6 +66,7 @@
 #include "db_debug.h"
 #include "result.h"
 #include "aql.h"
+#include "snapshot.h"
 #include <arastorage/arastorage.h>
 
 /****************************************************************************
@@ -74,6 +75,12 @@
 db_result_t db_init(void)
 {
 	db_result_t res;
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	res = storage_memory_init();
+	if (res != DB_OK) {
+		return res;
+	}
+#endif
 	res = relation_init();
 	if (res != DB_OK) {
 		return res;
@@ -82,25 +89,79 @@ db_result_t db_init(void)
 	if (res != DB_OK) {
 		return res;
 	}
+	res = snapshot_init();
+	if (res != DB_OK) {
+		return res;
+	}
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	res = storage_cache_init();
+	if (res != DB_OK) {
+		return res;
+	}
+#endif
 #ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
 	res = storage_write_buffer_init();
 	if (res != DB_OK) {
 		return res;
 	}
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* Replays the rows which were not written back before a power cut */
+	res = storage_wal_init();
+	if (res != DB_OK) {
+		return res;
+	}
 #endif
 	return res;
 }
 
 db_result_t db_deinit()
 {
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	storage_wal_deinit();
+#endif
 #ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	storage_flush_insert_buffer();
 	storage_write_buffer_deinit();
 #endif
 	relation_deinit();
 	index_deinit();
+	snapshot_deinit();
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	storage_column_deinit();
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	storage_cache_deinit();
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	/* Volatile relations do not outlive the database */
+	storage_memory_deinit();
+#endif
 	return DB_OK;
 }
 
+db_result_t db_flush(void)
+{
+	db_result_t res = DB_OK;
+
+	snapshot_lock();
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* A checkpoint writes back everything and empties the log */
+	res = storage_wal_checkpoint(true);
+#else
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	res = storage_flush_insert_buffer();
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	if (res == DB_OK) {
+		res = storage_cache_flush();
+	}
+#endif
+#endif
+	snapshot_unlock();
+	return res;
+}
+
 void db_set_output_function(db_output_function_t f)
 {
 	output = f;
@@ -167,7 +228,13 @@ db_result_t db_print_header(db_cursor_t *cursor)
 
 db_result_t db_cursor_free(db_cursor_t *cursor)
 {
-	return cursor_deinit(cursor);
+	db_result_t res;
+
+	/* Closing the snapshot of the cursor releases its relation */
+	snapshot_lock();
+	res = cursor_deinit(cursor);
+	snapshot_unlock();
+	return res;
 }
 
 
@@ -29,6 +29,49 @@
 #include "storage.h"
 #include "memb.h"
 #include "relation.h"
+#include "aql.h"
+#include "snapshot.h"
+
+/****************************************************************************
+* Private Functions
+****************************************************************************/
+
+/* Evaluate tuples until the next one fulfilling the condition of a
+   streaming cursor, and make it the current row. */
+static db_result_t cursor_stream_next(db_cursor_t *cursor)
+{
+	db_result_t res;
+
+	while (db_processing_status(cursor->handle)) {
+		res = relation_process_select(&cursor->handle, cursor);
+		if (DB_ERROR(res)) {
+			DB_LOG_E("DB: Failed to process tuples : %d\n", res);
+			return res;
+		}
+		if (res == DB_GOT_ROW) {
+			cursor->current_cursor_row++;
+			cursor->cursor_rows = cursor->current_cursor_row + 1;
+			return DB_OK;
+		}
+		if (res == DB_FINISHED) {
+			cursor->handle->flags &= ~DB_HANDLE_FLAG_PROCESSING;
+		}
+	}
+	return DB_CURSOR_ERROR;
+}
+
+/* A streaming cursor only moves forward, one row at a time. */
+static db_result_t cursor_stream_move_to(db_cursor_t *cursor, tuple_id_t row_id)
+{
+	if (cursor->cursor_rows > 0 && row_id == cursor->current_cursor_row) {
+		return DB_OK;
+	}
+	if (row_id != cursor->current_cursor_row + 1) {
+		DB_LOG_E("streaming cursor can not move to row %d\n", row_id);
+		return DB_CURSOR_ERROR;
+	}
+	return cursor_stream_next(cursor);
+}
 
 /****************************************************************************
 * Public Functions
@@ -37,12 +80,16 @@
 /* Update current cursor id and storage id. */
 db_result_t cursor_move_to(db_cursor_t *cursor, tuple_id_t row_id)
 {
+	if (cursor != NULL && cursor->handle != NULL) {
+		return cursor_stream_move_to(cursor, row_id);
+	}
+
 	if (IS_EMPTY_CURSOR(cursor)) {
 		DB_LOG_E("Empty Cursor\n");
 		return DB_CURSOR_ERROR;
 	}
 
-	if (row_id >= DB_CURSOR_RESULT_ENTRY || row_id >= cursor->cursor_rows) {
+	if (row_id >= cursor->cursor_rows) {
 		DB_LOG_E("invalid row id\n");
 		return DB_CURSOR_ERROR;
 	}
@@ -77,6 +124,15 @@ db_result_t cursor_move_first(db_cursor_t *cursor)
 /* Search the last set tuple id and update storage id corresponding it. */
 db_result_t cursor_move_last(db_cursor_t *cursor)
 {
+	db_result_t res;
+
+	if (cursor != NULL && cursor->handle != NULL) {
+		/* Drain the stream, its last row stays current. */
+		do {
+			res = cursor_stream_next(cursor);
+		} while (DB_SUCCESS(res));
+		return cursor->cursor_rows > 0 ? DB_OK : DB_CURSOR_ERROR;
+	}
 	return cursor_move_to(cursor, cursor->cursor_rows - 1);
 }
 
@@ -113,6 +169,9 @@ bool cursor_is_first_row(db_cursor_t *cursor)
 	if (cursor->current_cursor_row != 0) {
 		return false;
 	}
+	if (cursor->handle != NULL) {
+		return cursor->cursor_rows > 0;
+	}
 	//check whether pointing storage row id is true
 	for (i = 0; i < cursor->total_rows; i++) {
 		index = GET_INDEX(i);
@@ -138,6 +197,10 @@ bool cursor_is_last_row(db_cursor_t *cursor)
 	if (cursor->current_cursor_row != cursor->cursor_rows - 1) {
 		return false;
 	}
+	if (cursor->handle != NULL) {
+		/* Known only once the scan has ended */
+		return cursor->cursor_rows > 0 && !db_processing_status(cursor->handle);
+	}
 	//check whether pointing storage row id is true
 	int i, index, pos;
 
@@ -162,7 +225,7 @@ db_result_t cursor_data_add(db_cursor_t *cursor, tuple_id_t tuple_id)
 		return DB_CURSOR_ERROR;
 	}
 
-	if (tuple_id >= DB_CURSOR_RESULT_ENTRY || tuple_id >= cursor->total_rows) {
+	if (tuple_id >= cursor->total_rows) {
 		DB_LOG_E("invalid tuple id error\n");
 		return DB_CURSOR_ERROR;
 	}
@@ -235,11 +298,24 @@ attribute_id_t cursor_get_attr_index(db_cursor_t *cursor, const char *attr_name)
 	return INVALID_CURSOR_VALUE;
 }
 
+/* The snapshot a cursor reads, or NULL if the cursor opens the tuple file by name */
+static db_snapshot_t *cursor_snapshot(db_cursor_t *cursor)
+{
+	if (cursor->snapshot != NULL) {
+		return cursor->snapshot;
+	}
+	if (cursor->handle != NULL) {
+		return cursor->handle->snapshot;
+	}
+	return NULL;
+}
+
 db_result_t cursor_get_value_storage(attribute_value_t *value, db_cursor_t *cursor, unsigned col)
 {
 	int fd, offset;
 	attribute_t attr;
 	unsigned char *buf;
+	db_snapshot_t *snapshot;
 
 	if (col >= cursor->attribute_count) {
 		DB_LOG_E("DB: Requested value (%d) is out of bounds; max = (%d)\n", col, cursor->attribute_count);
@@ -252,6 +328,7 @@ db_result_t cursor_get_value_storage(attribute_value_t *value, db_cursor_t *curs
 	}
 
 	buf = cursor->tuple;
+	snapshot = cursor_snapshot(cursor);
 
 	memcpy(attr.name, cursor->attr_map[col].name, sizeof(attr.name));
 	attr.domain = cursor->attr_map[col].domain;
@@ -261,9 +338,24 @@ db_result_t cursor_get_value_storage(attribute_value_t *value, db_cursor_t *curs
 		/* If the type of value is aggregate value, we don't need to read storage.
 		 Because aggregate result is already calculated and stored in buffer. */
 		buf += cursor->attr_map[col].offset;
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	} else if (TUPLE_FILE_IS_COLUMNAR(cursor->name)) {
+		if (storage_column_read(cursor->name, snapshot != NULL ? snapshot->tuple_storage : INVALID_STORAGE_ID, cursor->storage_row_length, cursor->attr_map[col].offset, attr.element_size, cursor->current_storage_row, buf) != DB_OK) {
+			DB_LOG_E("failed to read column of %s\n", cursor->name);
+			return DB_CURSOR_ERROR;
+		}
+#endif
 	} else {
 		/* Otherwise, Read tuple value from storage. */
 		offset = cursor->current_storage_row * cursor->storage_row_length + cursor->attr_map[col].offset;
+		if (snapshot != NULL) {
+			/* A writer may be appending to the file; read what the snapshot holds */
+			if (storage_read_from(snapshot->tuple_storage, buf, offset, attr.element_size) != DB_OK) {
+				DB_LOG_E("failed to read storage %s\n", cursor->name);
+				return DB_CURSOR_ERROR;
+			}
+			return db_phy_to_value(value, &attr, buf);
+		}
 		fd = storage_open(cursor->name, O_RDONLY);
 		if (fd < 0) {
 			DB_LOG_E("failed to open storage %s\n", cursor->name);
@@ -402,7 +494,7 @@ void cursor_clean_data(db_cursor_t *cursor)
 	cursor->row_arr = NULL;
 }
 
-db_result_t cursor_init(db_cursor_t **cursor, relation_t *rel)
+db_result_t cursor_init(db_cursor_t **cursor, relation_t *rel, tuple_id_t rows)
 {
 	int arr_size;
 	if (*cursor == NULL) {
@@ -411,17 +503,13 @@ db_result_t cursor_init(db_cursor_t **cursor, relation_t *rel)
 
 	cursor_clean_data(*cursor);
 
-	arr_size = GET_CURSOR_DATA_ARR_SIZE(rel->cardinality);
-	if (arr_size > DB_CURSOR_LIMIT) {
-		return DB_CURSOR_ERROR;
-	}
-
+	arr_size = GET_CURSOR_DATA_ARR_SIZE(rows);
 	(*cursor)->row_arr = (uint32_t *)malloc(sizeof(uint32_t) * arr_size);
 	if ((*cursor)->row_arr == NULL) {
 		return DB_CURSOR_ERROR;
 	}
 	memset((*cursor)->row_arr, 0, arr_size * sizeof(uint32_t));
-	(*cursor)->total_rows = rel->cardinality;
+	(*cursor)->total_rows = rows;
 
 	(*cursor)->storage_row_length = rel->row_length;
 	memcpy((*cursor)->name, rel->tuple_filename, sizeof(rel->tuple_filename));
@@ -430,11 +518,39 @@ db_result_t cursor_init(db_cursor_t **cursor, relation_t *rel)
 	return DB_OK;
 }
 
+db_result_t cursor_stream_init(db_cursor_t *cursor, db_handle_t *handle)
+{
+	if (cursor == NULL || handle == NULL) {
+		return DB_CURSOR_ERROR;
+	}
+
+	cursor_clean_data(cursor);
+	if (DB_ERROR(cursor_data_set(cursor, handle->attr_map, handle->result_rel->attribute_count))) {
+		return DB_CURSOR_ERROR;
+	}
+
+	/* No row bitmap: rows are counted as they are read. */
+	cursor->total_rows = handle->snapshot != NULL ? handle->snapshot->rows : handle->rel->cardinality;
+	cursor->storage_row_length = handle->rel->row_length;
+	memcpy(cursor->name, handle->rel->tuple_filename, sizeof(handle->rel->tuple_filename));
+	memcpy(cursor->rel_name, handle->rel->name, sizeof(handle->rel->name));
+	cursor->handle = handle;
+
+	return DB_OK;
+}
+
 db_result_t cursor_deinit(db_cursor_t *cursor)
 {
 	if (cursor == NULL) {
 		return DB_CURSOR_ERROR;
 	}
+	if (cursor->handle != NULL) {
+		aql_deinit_handle(&cursor->handle);
+	}
+	if (cursor->snapshot != NULL) {
+		snapshot_close(cursor->snapshot);
+		cursor->snapshot = NULL;
+	}
 	if (cursor->row_arr) {
 		free(cursor->row_arr);
 		cursor->row_arr = NULL;
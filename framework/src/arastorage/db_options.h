@@ -127,6 +127,11 @@
 #define AQL_ATTRIBUTE_LIMIT             6
 #endif							/* AQL_ATTRIBUTE_LIMIT */
 
+/* The maximum number of parameters in a prepared statement (at most 32). */
+#ifndef AQL_PARAMETER_LIMIT
+#define AQL_PARAMETER_LIMIT             8
+#endif							/* AQL_PARAMETER_LIMIT */
+
 /*----------------------------------------------------------------------------*/
 
 /*
@@ -163,32 +168,17 @@
 #define CONFIG_MOUNT_POINT "/mnt/"
 #endif
 
-/* The maximum number of tuples in a relation. */
+/* The maximum number of tuples in a relation without a BTREE index. */
 #ifndef DB_TUPLE_LIMIT
 #define DB_TUPLE_LIMIT          2000
 #endif							/* DB_TUPLE_LIMIT */
 
-/* The number of int array in a cursor. */
-#ifndef DB_CURSOR_LIMIT
-#define DB_CURSOR_LIMIT          ((DB_TUPLE_LIMIT / (sizeof(uint32_t)*8)) + 1)
-#endif							/* DB_CURSOR_LIMIT */
-
-/* The maximum number of tuples in a cursor. */
-#ifndef DB_CURSOR_RESULT_ENTRY
-#define DB_CURSOR_RESULT_ENTRY          ((DB_CURSOR_LIMIT) * (sizeof(uint32_t)*8))
-#endif							/* DB_CURSOR_RESULT_ENTRY */
-
 /* The name of the intermediate "result" relation file, which is used
    for presenting the result of a query to a user. */
 #ifndef RESULT_RELATION
 #define RESULT_RELATION "db-res"
 #endif							/* RESULT_RELATION */
 
-/* The name of the relation used for processing a REMOVE query. */
-#ifndef REMOVE_RELATION
-#define REMOVE_RELATION "db-rem"
-#endif							/* REMOVE_RELATION */
-
 #define INDEX_NAME_SUFFIX ".idx"
 
 #define INDEX_NAME_LENGTH (RELATION_NAME_LENGTH + sizeof(INDEX_NAME_SUFFIX) - 1)
@@ -197,6 +187,12 @@
 
 #define TUPLE_NAME_LENGTH 14
 
+#define COLUMN_FILE_NAME "col"
+
+#define COLUMN_DIRECTORY_SUFFIX ".d"
+
+#define VERSION_FILE_SUFFIX ".x"
+
 #define HEAP_FILE_NAME "heap"
 
 #define HEAP_FILE_LENGTH 15
@@ -205,9 +201,50 @@
 
 #define BUCKET_FILE_LENGTH 15
 
+#define BTREE_FILE_NAME "btr"
+
+#define BTREE_FILE_LENGTH 14
+
+#define HASH_FILE_NAME "hsh"
+
+#define HASH_FILE_LENGTH 14
+
 #define TEMP_FILE_SUFFIX ".tmp"
 
 #define TEMP_FILE_SUFFIX_LENGTH 4
+
+#define WAL_FILE_NAME "db.wal"
+
+/* The maximum number of files tracked by the page cache. */
+#ifndef DB_CACHE_FILE_LIMIT
+#define DB_CACHE_FILE_LIMIT             16
+#endif							/* DB_CACHE_FILE_LIMIT */
+
+/* The maximum number of files opened at the same time through the page cache. */
+#ifndef DB_CACHE_HANDLE_LIMIT
+#define DB_CACHE_HANDLE_LIMIT           16
+#endif							/* DB_CACHE_HANDLE_LIMIT */
+
+/* Files of volatile relations begin with this character, which cannot start a relation name. */
+#define MEMORY_FILE_PREFIX "~"
+
+/* Long enough for the prefix, a relation name and the suffixes of its index catalog. */
+#define MEMORY_FILE_NAME_LENGTH (sizeof(MEMORY_FILE_PREFIX) + INDEX_NAME_LENGTH + TEMP_FILE_SUFFIX_LENGTH)
+
+/* The maximum number of files of volatile relations. */
+#ifndef DB_MEMORY_FILE_LIMIT
+#define DB_MEMORY_FILE_LIMIT            16
+#endif							/* DB_MEMORY_FILE_LIMIT */
+
+/* The maximum number of files of volatile relations opened at the same time. */
+#ifndef DB_MEMORY_HANDLE_LIMIT
+#define DB_MEMORY_HANDLE_LIMIT          16
+#endif							/* DB_MEMORY_HANDLE_LIMIT */
+
+/* The maximum number of decoded column blocks kept in RAM. */
+#ifndef DB_COLUMN_CACHE_LIMIT
+#define DB_COLUMN_CACHE_LIMIT           AQL_ATTRIBUTE_LIMIT
+#endif							/* DB_COLUMN_CACHE_LIMIT */
 /*----------------------------------------------------------------------------*/
 
 /* Index options. */
@@ -216,6 +253,16 @@
 #define DB_INDEX_COST                   64
 #endif							/* DB_INDEX_COST */
 
+/* The percentage of removed tuples in a relation above which a writer
+   compacts its tuple file. */
+#ifndef DB_VACUUM_THRESHOLD
+#ifdef CONFIG_ARASTORAGE_VACUUM_THRESHOLD
+#define DB_VACUUM_THRESHOLD             CONFIG_ARASTORAGE_VACUUM_THRESHOLD
+#else
+#define DB_VACUUM_THRESHOLD             40
+#endif
+#endif							/* DB_VACUUM_THRESHOLD */
+
 /* The maximum number of Maxheap indexes. */
 #ifndef DB_HEAP_INDEX_LIMIT
 #define DB_HEAP_INDEX_LIMIT             1
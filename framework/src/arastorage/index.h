@@ -77,7 +77,9 @@ struct index_api_s;
 enum index_e {
 	INDEX_NONE = 0,
 	INDEX_INLINE = 1,
-	INDEX_BPLUSTREE = 2
+	INDEX_BPLUSTREE = 2,
+	INDEX_BTREE = 3,
+	INDEX_HASH = 4
 };
 typedef enum index_e index_type_t;
 
@@ -106,6 +108,8 @@ struct index_iterator_s {
 	attribute_value_t max_value;
 	tuple_id_t next_item_no;
 	tuple_id_t found_items;
+	struct db_snapshot_s *snapshot;	/* The tuples the iterator searches */
+	void *opaque_data;			/* Iteration state of the index, freed by index_release_iterator() */
 };
 typedef struct index_iterator_s index_iterator_t;
 
@@ -119,6 +123,7 @@ struct index_api_s {
 	db_result_t(*insert)(index_t *, attribute_value_t *, tuple_id_t);
 	db_result_t(*delete)(index_t *, attribute_value_t *);
 	tuple_id_t(*get_next)(index_iterator_t *, uint8_t);
+	db_result_t(*vacuum)(index_t *);
 };
 
 typedef struct index_api_s index_api_t;
@@ -128,6 +133,8 @@ typedef struct index_api_s index_api_t;
 ****************************************************************************/
 extern index_api_t index_inline;
 extern index_api_t index_bplustree;
+extern index_api_t index_btree;
+extern index_api_t index_hash;
 
 /****************************************************************************
  * Internal function prototypes
@@ -141,6 +148,7 @@ db_result_t index_insert(index_t *, attribute_value_t *, tuple_id_t);
 db_result_t index_delete(index_t *, attribute_value_t *);
 db_result_t index_get_iterator(index_iterator_t *, index_t *, attribute_value_t *, attribute_value_t *);
 tuple_id_t index_get_next(index_iterator_t *, uint8_t);
+void index_release_iterator(index_iterator_t *);
 int index_exists(attribute_t *);
 db_result_t index_deinit(void);
 #endif							/* !INDEX_H */
@@ -55,6 +55,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "result.h"
 #include "db_options.h"
@@ -63,6 +64,8 @@
 #include "memb.h"
 #include "random.h"
 #include "rw_locks.h"
+#include "relation.h"
+#include "snapshot.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -83,11 +86,10 @@
 
 /* The total number of states possible of a node */
 #define NODE_STATES 255
-#define CONFIG_VACUUM_THRESHOLD 40
 
-#ifdef CONFIG_ARASTORAGE_ENABLE_VACUUM
-#define VACUUM_THRESHOLD CONFIG_VACUUM_THRESHOLD
-#endif
+/* Attempts to read a bucket another task holds in the cache, and the wait between them */
+#define BUCKET_READ_RETRY 100
+#define BUCKET_READ_WAIT_US 1000
 
 #define max(a, b) ({ __typeof__(a) _a = (a);  __typeof__(b) _b = (b); _a > _b ? _a : _b; })
 #define min(a, b) ({ __typeof__(a) _a = (a);  __typeof__(b) _b = (b); _a < _b ? _a : _b; })
@@ -249,6 +251,15 @@ struct tree_s {
 };
 typedef struct tree_s tree_t;
 
+/* Iteration state of a query, kept in the opaque_data of its iterator */
+struct tree_iter_s {
+	uint16_t bucket_id;
+	uint8_t start;
+	bool finished;
+	bucket_t bucket;			/* A copy, so writers may change the bucket meanwhile */
+};
+typedef struct tree_iter_s tree_iter_t;
+
 /****************************************************************************
  * Private variables
  ****************************************************************************/
@@ -282,12 +293,15 @@ static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
 static db_result_t delete(index_t *, attribute_value_t *);
 static tuple_id_t get_next(index_iterator_t *, uint8_t);
 static db_result_t vacuum(tree_t *, relation_t *);
+static db_result_t vacuum_index(index_t *);
+static bucket_t *bucket_wait(tree_t *, int);
+static void tree_flush(tree_t *);
 
 /****************************************************************************
 * Private Functions
 ****************************************************************************/
 #ifdef CONFIG_ARASTORAGE_ENABLE_FLUSHING
-static int db_flush(tree_t *, relation_t *);
+static int flush_old_tuples(tree_t *, relation_t *);
 #endif
 
 index_api_t index_bplustree = {
@@ -299,7 +313,8 @@ index_api_t index_bplustree = {
 	release,
 	insert,
 	delete,
-	get_next
+	get_next,
+	vacuum_index
 };
 
 /****************************************************************************
@@ -347,7 +362,7 @@ static db_result_t create(index_t *index)
 	}
 
 	/* Generating the file to store the tree structure */
-	snprintf(tree_filename, HEAP_FILE_LENGTH, "%s.%x\0", HEAP_FILE_NAME, (unsigned)(random_rand() & 0xffff));
+	storage_name_file(index->rel, tree_filename, HEAP_FILE_LENGTH, HEAP_FILE_NAME);
 
 	result = storage_generate_file(tree_filename);
 	if (result == DB_INDEX_ERROR) {
@@ -360,7 +375,7 @@ static db_result_t create(index_t *index)
 	DB_LOG_D("DB: Generated the tree file \"%s\" using %lu bytes of space\n", index->descriptor_file, (unsigned long)CONFIG_NODE_LIMIT * sizeof(tree_node_t));
 
 	/* Generating bucket file to store <key, tuple_id> pair */
-	snprintf(bucket_filename, BUCKET_FILE_LENGTH, "%s.%x\0", BUCKET_FILE_NAME, (unsigned)(random_rand() & 0xffff));
+	storage_name_file(index->rel, bucket_filename, BUCKET_FILE_LENGTH, BUCKET_FILE_NAME);
 
 	result = storage_generate_file(bucket_filename);
 	if (result == DB_INDEX_ERROR) {
@@ -716,21 +731,36 @@ static db_result_t insert(index_t *index, attribute_value_t *key, tuple_id_t val
 {
 	tree_t *tree;
 	long long_key;
-	qnode_t *tmp_node;
 
 	tree = (tree_t *)index->opaque_data;
 	long_key = db_value_to_long(key);
 
 #ifdef CONFIG_ARASTORAGE_ENABLE_FLUSHING
 	if ((tree->inserted) >= DB_TUPLES_LIMIT) {
-		db_flush(tree, index->rel);
-		value = value - DB_TUPLES_LIMIT / 2;
+		flush_old_tuples(tree, index->rel);
+		/* The tuple is stored after the ones kept */
+		value = index->rel->next_row;
 	}
 #endif
 	if (insert_item_btree(tree, (int)long_key, (int)value) == TREE_INSERT_FAIL) {
 		DB_LOG_E("DB: Failed to insert key %ld into a bplus-tree index\n", long_key);
 		return DB_INDEX_ERROR;
 	}
+	tree_flush(tree);
+
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: tree_flush
+ *
+ * Description: Writes the tree metadata and the dirty cache entries to flash
+ *
+ ****************************************************************************/
+static void tree_flush(tree_t *tree)
+{
+	qnode_t *tmp_node;
+
 	storage_write_to(tree->tree_storage, tree, 0, sizeof(tree_t));
 
 	/* Bucket Cache being flushed */
@@ -750,8 +780,6 @@ static db_result_t insert(index_t *index, attribute_value_t *key, tuple_id_t val
 		}
 		tmp_node = tmp_node->next;
 	}
-
-	return DB_OK;
 }
 
 static db_result_t delete(index_t *index, attribute_value_t *value)
@@ -777,6 +805,127 @@ static uint16_t next_bucket(tree_t *tree, bucket_t *bucket)
 	return next_bucket;
 }
 
+/****************************************************************************
+ * Name: bucket_wait
+ *
+ * Description: Reads a bucket into the cache and locks it there, waiting
+ *              a while if another task holds it
+ *
+ ****************************************************************************/
+static bucket_t *bucket_wait(tree_t *tree, int bucket_id)
+{
+	bucket_t *bucket;
+	int retry;
+
+	for (retry = 0; retry < BUCKET_READ_RETRY; retry++) {
+		bucket = bucket_read(tree, bucket_id);
+		if (bucket != NULL) {
+			return bucket;
+		}
+		usleep(BUCKET_READ_WAIT_US);
+	}
+	DB_LOG_E("DB: Bucket %d stays locked\n", bucket_id);
+	return NULL;
+}
+
+/****************************************************************************
+ * Name: bucket_copy
+ *
+ * Description: Copies a bucket for an iterator. The caller holds the tree
+ *              lock for reading, so the bucket is not split meanwhile.
+ *
+ ****************************************************************************/
+static db_result_t bucket_copy(tree_t *tree, int bucket_id, tree_iter_t *iter)
+{
+	bucket_t *bucket;
+
+	bucket = bucket_wait(tree, bucket_id);
+	if (bucket == NULL) {
+		return DB_INDEX_ERROR;
+	}
+	memcpy(&iter->bucket, bucket, sizeof(bucket_t));
+	modify_cache(tree, bucket_id, BUCKET, UNLOCK);
+
+	iter->bucket_id = bucket_id;
+	iter->start = 0;
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: select_next
+ *
+ * Description: Returns the tuple id of the next tuple matching a query.
+ *              Each iterator walks copies of the buckets, so any number of
+ *              queries run beside each other and beside a writer, which
+ *              is only kept from splitting a bucket while it is copied.
+ *
+ ****************************************************************************/
+static tuple_id_t select_next(index_iterator_t *iterator, tree_t *tree, uint16_t key_min, uint16_t key_max)
+{
+	tree_iter_t *iter;
+	pair_t *path;
+	uint16_t bucket_id;
+	db_result_t result;
+	int i;
+
+	iter = (tree_iter_t *)iterator->opaque_data;
+	if (iter == NULL) {
+		iter = (tree_iter_t *)malloc(sizeof(tree_iter_t));
+		if (iter == NULL) {
+			return INVALID_TUPLE;
+		}
+		iterator->opaque_data = iter;
+
+		/* Find the bucket of the smallest key */
+		rw_lock_read(&(tree->tree_lock));
+		while ((path = tree_find(tree, key_min)) == NULL) {
+			rw_unlock_read(&(tree->tree_lock));
+			usleep(BUCKET_READ_WAIT_US);
+			rw_lock_read(&(tree->tree_lock));
+		}
+		bucket_id = path[tree->levels].key;
+		free(path);
+		pthread_mutex_lock(&(tree->bucket_lock));
+		tree->lock_buckets[bucket_id] = 0;
+		pthread_mutex_unlock(&(tree->bucket_lock));
+
+		result = bucket_copy(tree, bucket_id, iter);
+		rw_unlock_read(&(tree->tree_lock));
+		iter->finished = DB_ERROR(result);
+	}
+
+	while (!iter->finished) {
+		/* Iterate over the key-value pairs in the bucket and find the ones which satisfy the condition */
+		for (i = iter->start; i < iter->bucket.next_free_slot; i++) {
+			if ((key_min <= iter->bucket.pairs[i].key) && (iter->bucket.pairs[i].key <= key_max)) {
+				iterator->found_items++;
+				iterator->next_item_no = iterator->found_items;
+				iter->start = i + 1;
+				return iter->bucket.pairs[i].value;
+			}
+		}
+
+		bucket_id = next_bucket(tree, &iter->bucket);
+		if (bucket_id == (uint16_t)-1) {
+			break;
+		}
+		rw_lock_read(&(tree->tree_lock));
+		result = bucket_copy(tree, bucket_id, iter);
+		rw_unlock_read(&(tree->tree_lock));
+		if (DB_ERROR(result) || iter->bucket.info[1] > key_max) {
+			break;
+		}
+	}
+
+	iter->finished = true;
+	if (iterator->found_items == 0) {
+		iterator->next_item_no = 0;
+	} else {
+		iterator->next_item_no = 1;
+	}
+	return INVALID_TUPLE;
+}
+
 /****************************************************************************
  * Name: get_next
  *
@@ -807,20 +956,26 @@ static tuple_id_t get_next(index_iterator_t *iterator, uint8_t matched_condition
 	key_max = *(int *)&iterator->max_value;
 	tree = (tree_t *)iterator->index->opaque_data;
 
-	/* To initialize the iterator_cache */
+	if (matched_condition == TRUE) {
+		return select_next(iterator, tree, key_min, key_max);
+	}
+
+	/* Removing entries, the writer holds the tree from the first call to the last */
 	if (iterator->next_item_no == 0) {	/* removed the condition of iterator inequality */
 		if (iterator->found_items == 0) {
 			rw_lock_write(&(tree->tree_lock));
 			pair_t *path = tree_find(tree, key_min);
 			if (path == NULL) {
+				rw_unlock_write(&(tree->tree_lock));
 				return INVALID_TUPLE;
 			}
 			uint16_t bucket_id = path[tree->levels].key;
 			free(path);
-			/* TODO
-			 * Absent of non-cast return handling, should be taken care in the definition
-			 */
-			cache.bucket = bucket_read(tree, bucket_id);
+			cache.bucket = bucket_wait(tree, bucket_id);
+			if (cache.bucket == NULL) {
+				rw_unlock_write(&(tree->tree_lock));
+				return INVALID_TUPLE;
+			}
 			cache.bucket_id = bucket_id;
 			cache.start = 0;
 			cache.end = cache.bucket->next_free_slot;
@@ -833,47 +988,38 @@ static tuple_id_t get_next(index_iterator_t *iterator, uint8_t matched_condition
 			iterator->found_items++;
 			iterator->next_item_no = iterator->found_items;
 
-			/* matched condition is FALSE when the query is for remove tuples */
-			if (matched_condition == FALSE) {
-				tuple_id_t tmp = cache.bucket->pairs[i].value;
-				if (cache.end > (i + 1)) {
-					cache.bucket->pairs[i] = cache.bucket->pairs[cache.end - 1];
-
-					/* Start Bucket chaining */
-					int iter = 0;
-					uint16_t new_min = cache.bucket->info[1];
-					uint16_t new_max = cache.bucket->info[2];
-					for (; iter < cache.bucket->next_free_slot - 1; iter++) {
-						new_min = min(cache.bucket->pairs[iter].key, new_min);
-						new_max = max(cache.bucket->pairs[iter].key, new_max);
-					}
-					cache.bucket->info[1] = new_min;
-					cache.bucket->info[2] = new_max;
-					/* End of Bucket chaining */
+			tuple_id_t tmp = cache.bucket->pairs[i].value;
+			if (cache.end > (i + 1)) {
+				cache.bucket->pairs[i] = cache.bucket->pairs[cache.end - 1];
+
+				/* Start Bucket chaining */
+				int iter = 0;
+				uint16_t new_min = cache.bucket->info[1];
+				uint16_t new_max = cache.bucket->info[2];
+				for (; iter < cache.bucket->next_free_slot - 1; iter++) {
+					new_min = min(cache.bucket->pairs[iter].key, new_min);
+					new_max = max(cache.bucket->pairs[iter].key, new_max);
 				}
-
-				cache.bucket->next_free_slot--;
-				tree->deleted++;
-				cache.end--;
-				cache.start = i;
-				return tmp;
-			} else {
-				cache.start = i + 1;
+				cache.bucket->info[1] = new_min;
+				cache.bucket->info[2] = new_max;
+				/* End of Bucket chaining */
 			}
-			return cache.bucket->pairs[i].value;
+
+			cache.bucket->next_free_slot--;
+			tree->deleted++;
+			cache.end--;
+			cache.start = i;
+			return tmp;
 		}
 	}
 
-	/* case when delete query comes */
-	if (matched_condition == FALSE) {
-		modify_cache(tree, cache.bucket_id, BUCKET, INVALIDATE);
-		cache_write_bucket(tree, cache.bucket_id, cache.bucket);
-		if ((double)(tree->deleted) / tree->inserted >= VACUUM_THRESHOLD) {
-			vacuum(tree, iterator->index->rel);
-		}
-	} else {
-		modify_cache(tree, cache.bucket_id, BUCKET, UNLOCK);
+	modify_cache(tree, cache.bucket_id, BUCKET, INVALIDATE);
+	cache_write_bucket(tree, cache.bucket_id, cache.bucket);
+#ifdef CONFIG_ARASTORAGE_ENABLE_VACUUM
+	if ((unsigned long)tree->deleted * 100 >= (unsigned long)tree->inserted * DB_VACUUM_THRESHOLD) {
+		vacuum(tree, iterator->index->rel);
 	}
+#endif
 	pthread_mutex_lock(&(tree->bucket_lock));
 	tree->lock_buckets[cache.bucket_id] = 0;
 	cache.bucket_id = next_bucket(tree, cache.bucket);
@@ -895,25 +1041,25 @@ static tuple_id_t get_next(index_iterator_t *iterator, uint8_t matched_condition
 	tree->lock_buckets[cache.bucket_id] = 1;
 	pthread_mutex_unlock(&(tree->bucket_lock));
 
-	cache.start = 0;
-	cache.end = cache.bucket->next_free_slot;
-
-	/* TODO
-	 * Absent of non-cast return handling, should be taken care in the definition
-	 */
-	cache.bucket = bucket_read(tree, cache.bucket_id);
-	if (cache.bucket->info[1] > key_max) {
-		modify_cache(tree, cache.bucket_id, BUCKET, UNLOCK);
+	cache.bucket = bucket_wait(tree, cache.bucket_id);
+	if (cache.bucket == NULL || cache.bucket->info[1] > key_max) {
+		if (cache.bucket != NULL) {
+			modify_cache(tree, cache.bucket_id, BUCKET, UNLOCK);
+		}
+		pthread_mutex_lock(&(tree->bucket_lock));
+		tree->lock_buckets[cache.bucket_id] = 0;
+		pthread_mutex_unlock(&(tree->bucket_lock));
 		if (iterator->found_items == 0) {
 			iterator->next_item_no = 0;
 		} else {
 			iterator->next_item_no = 1;
 		}
-		pthread_mutex_unlock(&(tree->bucket_lock));
 		rw_unlock_write(&(tree->tree_lock));
 		return INVALID_TUPLE;
 
 	}
+	cache.start = 0;
+	cache.end = cache.bucket->next_free_slot;
 	iterator->next_item_no = 1;
 	return get_next(iterator, matched_condition);
 }
@@ -923,81 +1069,170 @@ static tuple_id_t get_next(index_iterator_t *iterator, uint8_t matched_condition
  *
  * Description: Reclaims the space of all the deleted tuples.
  *              Creates a new tuple storage file with all the valid tuples
- *              and removes the old one.
+ *              in the order of the buckets, renumbers the index entries
+ *              after it and removes the old file. Tuples removed through
+ *              the relation are dropped together with their entries. The
+ *              caller makes sure no query reads the relation.
  *
  ****************************************************************************/
 static db_result_t vacuum(tree_t *tree, relation_t *rel)
 {
-	char tuple_path[TUPLE_NAME_LENGTH];
+	char tuple_path[TUPLE_NAME_LENGTH + 1];
 	db_result_t result;
 	relation_t old_rel;
-	memcpy(&old_rel, rel, sizeof(relation_t));
-	unsigned long long offset;
+	storage_row_t temp;
+	bucket_t *bucket;
+	tuple_id_t tup;
+	int num_tuples;
 	int fd;
 	int id;
-	int num_tuples = 0;
-
-	offset = 0;
+	int num;
+	int ind;
 
-	fd = storage_open(rel->name, O_WRONLY);
-	result = storage_write_to(fd, rel->name, offset, sizeof(rel->name));
-	if (result != DB_OK) {
-		storage_close(fd);
-		storage_remove(rel->name);
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* Logged tuple ids refer to the tuple file which is about to be replaced */
+	storage_wal_checkpoint(true);
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	if (DB_ERROR(storage_flush_insert_buffer())) {
 		return DB_STORAGE_ERROR;
 	}
-	offset += sizeof(rel->name);
+#endif
+	memcpy(&old_rel, rel, sizeof(relation_t));
 
 	/* Generate new tuple file */
-	snprintf(tuple_path, TUPLE_NAME_LENGTH, "%s.%x\0", TUPLE_FILE_NAME, (unsigned)(random_rand() & 0xffff));
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		result = storage_column_generate(tuple_path);
+	} else {
+		storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
+		result = storage_generate_file(tuple_path);
+	}
+#else
+	storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
 	result = storage_generate_file(tuple_path);
+#endif
 	if (result == DB_STORAGE_ERROR) {
-		storage_close(fd);
-		storage_remove(rel->tuple_filename);
 		return DB_STORAGE_ERROR;
 	}
-	strncpy(rel->tuple_filename, tuple_path, TUPLE_NAME_LENGTH);
 
-	result = storage_write_to(fd, rel->tuple_filename, offset, sizeof(rel->tuple_filename));
-
-	storage_close(fd);
-	if (result != DB_OK) {
-		storage_remove(rel->tuple_filename);
-		return DB_STORAGE_ERROR;
+	temp = malloc(rel->row_length);
+	if (temp == NULL) {
+		storage_remove(tuple_path);
+		return DB_ALLOCATION_ERROR;
 	}
 
 	/* Set the fields of the relation structure */
-	rel->tuple_storage = storage_open(rel->tuple_filename, O_RDWR);
-
-	rel->next_row = num_tuples;
-	rel->cardinality = num_tuples;
-	storage_row_t temp = malloc(sizeof(rel->row_length));
-	if (temp == NULL) {
-		return DB_ALLOCATION_ERROR;
+	strlcpy(rel->tuple_filename, tuple_path, sizeof(rel->tuple_filename));
+	rel->tuple_storage = storage_open(rel->tuple_filename, O_APPEND | O_RDWR);
+	rel->next_row = 0;
+	rel->cardinality = 0;
+	if (rel->tuple_storage < 0) {
+		result = DB_STORAGE_ERROR;
+		goto errout;
 	}
 
-	/* Iterate over all the buckets to read the tuples from storage and put them in new tuple file */
+	/* Copy the tuples left in the order of the buckets; the entries are
+	   renumbered only once the new file is complete */
 	for (id = 0; id < tree->off_buckets; id++) {
-		bucket_t *bucket = bucket_read(tree, id);
-		int num;
+		bucket = bucket_wait(tree, id);
+		if (bucket == NULL) {
+			result = DB_INDEX_ERROR;
+			goto errout;
+		}
 		for (num = 0; num < bucket->next_free_slot; num++) {
-			tuple_id_t tup;
 			tup = bucket->pairs[num].value;
+			if (snapshot_removed(&old_rel, tup)) {
+				continue;
+			}
+			result = storage_get_row(&old_rel, &tup, temp);
+			if (result == DB_OK) {
+				result = storage_put_row(rel, temp, FALSE);
+			}
+			if (result != DB_OK) {
+				modify_cache(tree, id, BUCKET, UNLOCK);
+				result = DB_STORAGE_ERROR;
+				goto errout;
+			}
+		}
+		modify_cache(tree, id, BUCKET, UNLOCK);
+	}
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	if (DB_ERROR(storage_flush_insert_buffer())) {
+		result = DB_STORAGE_ERROR;
+		goto errout;
+	}
+#endif
+
+	/* The relation file names the new tuple file from now on */
+	fd = storage_open_relation(rel, O_WRONLY);
+	if (fd < 0) {
+		result = DB_STORAGE_ERROR;
+		goto errout;
+	}
+	result = storage_write_to(fd, rel->tuple_filename, 0, sizeof(rel->tuple_filename));
+	storage_close(fd);
+	if (result != DB_OK) {
+		goto errout;
+	}
+	free(temp);
 
-			storage_get_row(&old_rel, &tup, temp);
-			storage_put_row(rel, temp, FALSE);
-			bucket->pairs[num].value = num_tuples;
+	num_tuples = 0;
+	for (id = 0; id < tree->off_buckets; id++) {
+		bucket = bucket_wait(tree, id);
+		if (bucket == NULL) {
+			DB_LOG_E("PANIC BUCKET %d NOT RENUMBERED\n", id);
+			continue;
+		}
+		for (num = 0, ind = 0; num < bucket->next_free_slot; num++) {
+			if (snapshot_removed(&old_rel, bucket->pairs[num].value)) {
+				continue;
+			}
+			bucket->pairs[ind].key = bucket->pairs[num].key;
+			bucket->pairs[ind].value = num_tuples;
 			num_tuples++;
+			ind++;
 		}
+		bucket->next_free_slot = ind;
 		modify_cache(tree, id, BUCKET, DIRTY);
 		modify_cache(tree, id, BUCKET, UNLOCK);
 	}
-	free(temp);
-	tree->inserted -= tree->deleted;
+	tree->inserted = num_tuples;
 	tree->deleted = 0;
+	tree_flush(tree);
 
+	if (old_rel.tuple_storage >= 0) {
+		storage_close(old_rel.tuple_storage);
+	}
 	storage_remove(old_rel.tuple_filename);
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(&old_rel)) {
+		storage_column_drop(old_rel.tuple_filename);
+	}
+#endif
 	return DB_OK;
+
+errout:
+	free(temp);
+	if (rel->tuple_storage >= 0) {
+		storage_close(rel->tuple_storage);
+	}
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	storage_write_buffer_clean();
+#endif
+	storage_remove(rel->tuple_filename);
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		storage_column_drop(rel->tuple_filename);
+	}
+#endif
+	memcpy(rel, &old_rel, sizeof(relation_t));
+	return result;
+}
+
+static db_result_t vacuum_index(index_t *index)
+{
+	return vacuum((tree_t *)index->opaque_data, index->rel);
 }
 
 /****************************************************************************
@@ -1041,6 +1276,11 @@ static cache_result_t modify_cache(tree_t *tree, int id, cache_type_t cache, op_
 	}
 	if (temp == end) {
 		DB_LOG_E("PANIC CACHE OPERATION FOR A NON EXISTENT ENTRY\n");
+		if (cache == NODE) {
+			pthread_mutex_unlock(&(tree->node_cache_lock));
+		} else {
+			pthread_mutex_unlock(&(tree->buck_cache_lock));
+		}
 		return CACHE_NOT_EXIST;
 	}
 	if (cache == NODE) {
@@ -1376,6 +1616,7 @@ static pair_t *tree_find(tree_t *tree, int key)
 		 */
 		node = tree_read(tree, id);
 		if (node == NULL) {
+			free(path);
 			return NULL;
 		}
 		index = id;
@@ -1399,6 +1640,7 @@ static pair_t *tree_find(tree_t *tree, int key)
 			if (tree->lock_buckets[node->id[index]]) {
 				pthread_mutex_unlock(&(tree->bucket_lock));
 				modify_cache(tree, id, NODE, UNLOCK);
+				free(path);
 				return NULL;
 			} else {
 				tree->lock_buckets[node->id[index]] = 1;
@@ -1878,13 +2120,13 @@ retry:
 
 #ifdef CONFIG_ARASTORAGE_ENABLE_FLUSHING
 /****************************************************************************
- * Name: db_flush
+ * Name: flush_old_tuples
  *
  * Description: Removes the old tuples from storage in case the tuple
  *              storage limit is reached
  *
  ****************************************************************************/
-static int db_flush(tree_t *tree, relation_t *rel)
+static int flush_old_tuples(tree_t *tree, relation_t *rel)
 {
 	DB_LOG_D("Started flushing the database. Deleted till now: %d\n", tree->deleted);
 	char tuple_path[TUPLE_NAME_LENGTH];
@@ -1892,44 +2134,36 @@ static int db_flush(tree_t *tree, relation_t *rel)
 	relation_t old_rel;
 	int flush_threshold = DB_TUPLES_LIMIT / 2;
 	memcpy(&old_rel, rel, sizeof(relation_t));
-	unsigned long long offset;
 	int fd;
 
-	offset = 0;
-	fd = storage_open(rel->name, O_WRONLY);
-	result = storage_write_to(fd, rel->name, offset, sizeof(rel->name));
-	if (result != DB_OK) {
-		storage_close(fd);
-		storage_remove(rel->name);
-		return DB_STORAGE_ERROR;
-	}
-	offset += sizeof(rel->name);
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* Logged tuple ids refer to the tuple file which is about to be replaced */
+	storage_wal_checkpoint(true);
+#endif
 
 	/* Create a new tuple file */
-	snprintf(tuple_path, TUPLE_NAME_LENGTH, "%s.%x\0", TUPLE_FILE_NAME, (unsigned)(random_rand() & 0xffff));
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		result = storage_column_generate(tuple_path);
+	} else {
+		storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
+		result = storage_generate_file(tuple_path);
+	}
+#else
+	storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
 	result = storage_generate_file(tuple_path);
+#endif
 	if (result == DB_STORAGE_ERROR) {
-		storage_close(fd);
-		storage_remove(rel->tuple_filename);
 		return DB_STORAGE_ERROR;
 	}
 	strncpy(rel->tuple_filename, tuple_path, TUPLE_NAME_LENGTH);
-
-	/* char buff[sizeof(rel->tuple_filename)+13] */
-	result = storage_write_to(fd, rel->tuple_filename, offset, sizeof(rel->tuple_filename));
-
-	storage_close(fd);
-	if (result != DB_OK) {
-		storage_remove(rel->tuple_filename);
-		return DB_STORAGE_ERROR;
-	}
-	rel->tuple_storage = storage_open(rel->tuple_filename, O_RDWR);
+	rel->tuple_storage = storage_open(rel->tuple_filename, O_APPEND | O_RDWR);
 
 	int id;
 	int num_tuples = 0;
 	rel->next_row = num_tuples;
 	rel->cardinality = num_tuples;
-	storage_row_t temp = malloc(sizeof(rel->row_length));
+	storage_row_t temp = malloc(rel->row_length);
 	if (temp == NULL) {
 		return DB_ALLOCATION_ERROR;
 	}
@@ -1948,7 +2182,7 @@ static int db_flush(tree_t *tree, relation_t *rel)
 			tuple_id_t tup;
 			tup = bucket->pairs[num].value;
 
-			if (tup >= flush_threshold) {
+			if (tup >= flush_threshold && !snapshot_removed(&old_rel, tup)) {
 				storage_get_row(&old_rel, &tup, temp);
 				storage_put_row(rel, temp, FALSE);
 				uint16_t tmp_key = bucket->pairs[num].key;
@@ -1979,7 +2213,29 @@ static int db_flush(tree_t *tree, relation_t *rel)
 	free(temp);
 	tree->inserted -= tree->deleted;
 	tree->deleted = 0;
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	storage_flush_insert_buffer();
+#endif
+
+	/* The relation file names the new tuple file from now on */
+	fd = storage_open_relation(rel, O_WRONLY);
+	if (fd < 0 || storage_write_to(fd, rel->tuple_filename, 0, sizeof(rel->tuple_filename)) != DB_OK) {
+		DB_LOG_E("DB: Failed to store the tuple file name of %s\n", rel->name);
+	}
+	if (fd >= 0) {
+		storage_close(fd);
+	}
+
+	if (old_rel.tuple_storage >= 0) {
+		storage_close(old_rel.tuple_storage);
+	}
 	storage_remove(old_rel.tuple_filename);
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(&old_rel)) {
+		storage_column_drop(old_rel.tuple_filename);
+	}
+#endif
+	snapshot_forget(rel, old_rel.tuple_filename);
 	DB_LOG_D("Flushed the database.\n");
 	return DB_OK;
 }
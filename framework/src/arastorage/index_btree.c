@@ -0,0 +1,944 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      A paged B+tree index whose height grows and shrinks with the
+ *      number of keys. Unlike index_bplustree, keys are neither folded
+ *      into a fixed key space nor limited by a fixed number of leaves.
+ *
+ *      Every entry is the pair <key, tuple id>, so duplicate keys are
+ *      kept as distinct entries ordered by tuple id. Leaves are linked
+ *      in both directions, which lets get_next() walk a key range in
+ *      order without going back to the root.
+ *
+ *      File layout : [meta][page 1][page 2]...
+ *      Page 0 is never used so that it can act as the null page id.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "result.h"
+#include "db_options.h"
+#include "db_debug.h"
+#include "storage.h"
+#include "random.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define BTREE_ORDER         CONFIG_ARASTORAGE_BTREE_ORDER
+#define BTREE_MIN_KEYS      (BTREE_ORDER / 2)
+#define BTREE_MAGIC         0x42545245	/* "BTRE" */
+#define BTREE_NULL_PAGE     0
+
+#define BTREE_PAGE_OFFSET(page) \
+	(sizeof(btree_meta_t) + ((unsigned long)(page) - 1) * sizeof(btree_node_t))
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef uint32_t btree_page_t;
+
+struct btree_key_s {
+	long key;
+	tuple_id_t tuple_id;
+};
+typedef struct btree_key_s btree_key_t;
+
+/*
+ * A node holds one spare key and child slot so that an insertion can
+ * be applied first and the node split afterwards when it overflows.
+ * In leaves, children[] is unused and the tuple id lives in the key.
+ */
+struct btree_node_s {
+	uint16_t is_leaf;
+	uint16_t count;
+	btree_page_t next;
+	btree_page_t prev;
+	btree_key_t keys[BTREE_ORDER + 1];
+	btree_page_t children[BTREE_ORDER + 2];
+};
+typedef struct btree_node_s btree_node_t;
+
+/* Tree metadata kept at the beginning of the index file */
+struct btree_meta_s {
+	uint32_t magic;
+	btree_page_t root;		/* Page id of the root node */
+	btree_page_t npages;		/* Number of pages ever allocated in the file */
+	btree_page_t free_head;		/* Head of the list of released pages */
+	uint32_t entries;		/* Number of <key, tuple id> entries, stored at release */
+	uint8_t height;			/* Number of levels including the leaves */
+};
+typedef struct btree_meta_s btree_meta_t;
+
+/* Tree state maintained in RAM */
+struct btree_s {
+	db_storage_id_t storage;
+	btree_meta_t meta;
+	btree_meta_t stored;		/* Metadata as last written to the file */
+	pthread_mutex_t lock;
+};
+typedef struct btree_s btree_t;
+
+/*
+ * Iteration state for get_next(), kept in the opaque_data of each
+ * iterator. The leaf is a copy, so a writer may split the tree while a
+ * query walks it; keys up to the last one returned are skipped then.
+ */
+struct btree_iter_s {
+	btree_page_t page;
+	uint16_t slot;
+	btree_key_t last;
+	btree_node_t leaf;
+};
+typedef struct btree_iter_s btree_iter_t;
+
+enum btree_result_e {
+	BTREE_ERROR = -1,
+	BTREE_OK = 0,
+	BTREE_SPLIT = 1,
+	BTREE_NOT_FOUND = 2
+};
+typedef enum btree_result_e btree_result_t;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *, uint8_t);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+index_api_t index_btree = {
+	INDEX_BTREE,
+	INDEX_API_EXTERNAL | INDEX_API_RANGE_QUERIES,
+	create,
+	destroy,
+	load,
+	release,
+	insert,
+	delete,
+	get_next,
+	NULL
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static int key_compare(const btree_key_t *k1, const btree_key_t *k2)
+{
+	if (k1->key != k2->key) {
+		return k1->key < k2->key ? -1 : 1;
+	}
+	if (k1->tuple_id != k2->tuple_id) {
+		return k1->tuple_id < k2->tuple_id ? -1 : 1;
+	}
+	return 0;
+}
+
+/* Returns the first slot whose key is not less than the given key. */
+static int node_lower_bound(btree_node_t *node, const btree_key_t *key)
+{
+	int low = 0;
+	int high = node->count;
+	int mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (key_compare(&node->keys[mid], key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/*
+ * Returns the child to descend into. A separator is the smallest key of
+ * its right subtree, so keys equal to a separator go right.
+ */
+static int node_child_slot(btree_node_t *node, const btree_key_t *key)
+{
+	int low = 0;
+	int high = node->count;
+	int mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (key_compare(&node->keys[mid], key) <= 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+static db_result_t meta_write(btree_t *tree)
+{
+	if (DB_ERROR(storage_write_to(tree->storage, &tree->meta, 0, sizeof(btree_meta_t)))) {
+		return DB_STORAGE_ERROR;
+	}
+	tree->stored = tree->meta;
+	return DB_OK;
+}
+
+/* Writes the metadata only when the pages of the tree changed. */
+static db_result_t meta_sync(btree_t *tree)
+{
+	if (tree->meta.root == tree->stored.root && tree->meta.npages == tree->stored.npages && tree->meta.free_head == tree->stored.free_head && tree->meta.height == tree->stored.height) {
+		return DB_OK;
+	}
+	return meta_write(tree);
+}
+
+static db_result_t node_read(btree_t *tree, btree_page_t page, btree_node_t *node)
+{
+	if (page == BTREE_NULL_PAGE || page > tree->meta.npages) {
+		DB_LOG_E("DB: Invalid btree page %lu\n", (unsigned long)page);
+		return DB_INDEX_ERROR;
+	}
+	return storage_read_from(tree->storage, node, BTREE_PAGE_OFFSET(page), sizeof(btree_node_t));
+}
+
+static db_result_t node_write(btree_t *tree, btree_page_t page, btree_node_t *node)
+{
+	return storage_write_to(tree->storage, node, BTREE_PAGE_OFFSET(page), sizeof(btree_node_t));
+}
+
+/* Takes a page from the free list, or extends the file by one page. */
+static btree_page_t page_alloc(btree_t *tree)
+{
+	btree_node_t node;
+	btree_page_t page;
+
+	if (tree->meta.free_head != BTREE_NULL_PAGE) {
+		page = tree->meta.free_head;
+		if (DB_ERROR(node_read(tree, page, &node))) {
+			return BTREE_NULL_PAGE;
+		}
+		tree->meta.free_head = node.children[0];
+		return page;
+	}
+
+	return ++tree->meta.npages;
+}
+
+/*
+ * Released pages are linked through children[0] and keep no leaf link,
+ * so that an iterator holding an older copy of a leaf cannot walk into
+ * the free list.
+ */
+static void page_free(btree_t *tree, btree_page_t page)
+{
+	btree_node_t node;
+
+	memset(&node, 0, sizeof(btree_node_t));
+	node.children[0] = tree->meta.free_head;
+	if (DB_SUCCESS(node_write(tree, page, &node))) {
+		tree->meta.free_head = page;
+	}
+}
+
+static void node_init(btree_node_t *node, uint16_t is_leaf)
+{
+	memset(node, 0, sizeof(btree_node_t));
+	node->is_leaf = is_leaf;
+}
+
+/****************************************************************************
+ * Name: node_split
+ *
+ * Description: Moves the upper half of an overflowed node into a newly
+ *              allocated page. The separator to be inserted in the parent
+ *              is returned through sep, and the new page id through
+ *              new_page.
+ *
+ ****************************************************************************/
+static btree_result_t node_split(btree_t *tree, btree_page_t page, btree_node_t *node, btree_key_t *sep, btree_page_t *new_page)
+{
+	btree_node_t *right;
+	btree_node_t *sibling;
+	btree_page_t right_page;
+	int mid;
+
+	right = (btree_node_t *)malloc(sizeof(btree_node_t));
+	if (right == NULL) {
+		return BTREE_ERROR;
+	}
+
+	right_page = page_alloc(tree);
+	if (right_page == BTREE_NULL_PAGE) {
+		free(right);
+		return BTREE_ERROR;
+	}
+
+	node_init(right, node->is_leaf);
+	mid = node->count / 2;
+
+	if (node->is_leaf) {
+		right->count = node->count - mid;
+		memcpy(right->keys, &node->keys[mid], right->count * sizeof(btree_key_t));
+		node->count = mid;
+		*sep = right->keys[0];
+
+		/* Link the new leaf into the leaf chain */
+		right->next = node->next;
+		right->prev = page;
+		if (node->next != BTREE_NULL_PAGE) {
+			sibling = (btree_node_t *)malloc(sizeof(btree_node_t));
+			if (sibling == NULL || DB_ERROR(node_read(tree, node->next, sibling))) {
+				free(sibling);
+				free(right);
+				return BTREE_ERROR;
+			}
+			sibling->prev = right_page;
+			node_write(tree, node->next, sibling);
+			free(sibling);
+		}
+		node->next = right_page;
+	} else {
+		/* The middle key moves up and is not kept in either half */
+		*sep = node->keys[mid];
+		right->count = node->count - mid - 1;
+		memcpy(right->keys, &node->keys[mid + 1], right->count * sizeof(btree_key_t));
+		memcpy(right->children, &node->children[mid + 1], (right->count + 1) * sizeof(btree_page_t));
+		node->count = mid;
+	}
+
+	if (DB_ERROR(node_write(tree, right_page, right)) || DB_ERROR(node_write(tree, page, node))) {
+		free(right);
+		return BTREE_ERROR;
+	}
+
+	free(right);
+	*new_page = right_page;
+	return BTREE_SPLIT;
+}
+
+static btree_result_t insert_rec(btree_t *tree, btree_page_t page, btree_key_t *key, btree_key_t *sep, btree_page_t *new_page)
+{
+	btree_node_t *node;
+	btree_result_t result;
+	btree_key_t child_sep;
+	btree_page_t child_page;
+	int slot;
+
+	node = (btree_node_t *)malloc(sizeof(btree_node_t));
+	if (node == NULL) {
+		return BTREE_ERROR;
+	}
+	if (DB_ERROR(node_read(tree, page, node))) {
+		free(node);
+		return BTREE_ERROR;
+	}
+
+	if (node->is_leaf) {
+		slot = node_lower_bound(node, key);
+		if (slot < node->count && key_compare(&node->keys[slot], key) == 0) {
+			/* The entry is already present */
+			free(node);
+			return BTREE_NOT_FOUND;
+		}
+		memmove(&node->keys[slot + 1], &node->keys[slot], (node->count - slot) * sizeof(btree_key_t));
+		node->keys[slot] = *key;
+		node->count++;
+	} else {
+		slot = node_child_slot(node, key);
+		result = insert_rec(tree, node->children[slot], key, &child_sep, &child_page);
+		if (result != BTREE_SPLIT) {
+			free(node);
+			return result;
+		}
+		memmove(&node->keys[slot + 1], &node->keys[slot], (node->count - slot) * sizeof(btree_key_t));
+		memmove(&node->children[slot + 2], &node->children[slot + 1], (node->count - slot) * sizeof(btree_page_t));
+		node->keys[slot] = child_sep;
+		node->children[slot + 1] = child_page;
+		node->count++;
+	}
+
+	if (node->count > BTREE_ORDER) {
+		result = node_split(tree, page, node, sep, new_page);
+	} else {
+		result = DB_ERROR(node_write(tree, page, node)) ? BTREE_ERROR : BTREE_OK;
+	}
+
+	free(node);
+	return result;
+}
+
+/****************************************************************************
+ * Name: merge_nodes
+ *
+ * Description: Appends right into left and removes the separator at
+ *              sep_slot together with the pointer to right from parent.
+ *
+ ****************************************************************************/
+static db_result_t merge_nodes(btree_t *tree, btree_node_t *parent, int sep_slot, btree_node_t *left, btree_node_t *right)
+{
+	btree_page_t left_page = parent->children[sep_slot];
+	btree_page_t right_page = parent->children[sep_slot + 1];
+	btree_node_t *sibling;
+
+	if (left->is_leaf) {
+		memcpy(&left->keys[left->count], right->keys, right->count * sizeof(btree_key_t));
+		left->count += right->count;
+		left->next = right->next;
+		if (right->next != BTREE_NULL_PAGE) {
+			sibling = (btree_node_t *)malloc(sizeof(btree_node_t));
+			if (sibling == NULL || DB_ERROR(node_read(tree, right->next, sibling))) {
+				free(sibling);
+				return DB_INDEX_ERROR;
+			}
+			sibling->prev = left_page;
+			node_write(tree, right->next, sibling);
+			free(sibling);
+		}
+	} else {
+		left->keys[left->count] = parent->keys[sep_slot];
+		memcpy(&left->keys[left->count + 1], right->keys, right->count * sizeof(btree_key_t));
+		memcpy(&left->children[left->count + 1], right->children, (right->count + 1) * sizeof(btree_page_t));
+		left->count += right->count + 1;
+	}
+
+	memmove(&parent->keys[sep_slot], &parent->keys[sep_slot + 1], (parent->count - sep_slot - 1) * sizeof(btree_key_t));
+	memmove(&parent->children[sep_slot + 1], &parent->children[sep_slot + 2], (parent->count - sep_slot - 1) * sizeof(btree_page_t));
+	parent->count--;
+
+	if (DB_ERROR(node_write(tree, left_page, left))) {
+		return DB_INDEX_ERROR;
+	}
+	page_free(tree, right_page);
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: rebalance
+ *
+ * Description: Restores the minimum occupancy of parent->children[slot]
+ *              by borrowing a key from a sibling, or by merging with it
+ *              when both siblings are at their minimum.
+ *
+ ****************************************************************************/
+static db_result_t rebalance(btree_t *tree, btree_node_t *parent, int slot)
+{
+	btree_node_t *child;
+	btree_node_t *sibling;
+	db_result_t result = DB_OK;
+
+	child = (btree_node_t *)malloc(sizeof(btree_node_t));
+	sibling = (btree_node_t *)malloc(sizeof(btree_node_t));
+	if (child == NULL || sibling == NULL) {
+		result = DB_ALLOCATION_ERROR;
+		goto out;
+	}
+
+	if (DB_ERROR(node_read(tree, parent->children[slot], child))) {
+		result = DB_INDEX_ERROR;
+		goto out;
+	}
+	if (child->count >= BTREE_MIN_KEYS) {
+		goto out;
+	}
+
+	/* Borrow from the left sibling */
+	if (slot > 0) {
+		if (DB_ERROR(node_read(tree, parent->children[slot - 1], sibling))) {
+			result = DB_INDEX_ERROR;
+			goto out;
+		}
+		if (sibling->count > BTREE_MIN_KEYS) {
+			memmove(&child->keys[1], &child->keys[0], child->count * sizeof(btree_key_t));
+			if (child->is_leaf) {
+				child->keys[0] = sibling->keys[sibling->count - 1];
+				parent->keys[slot - 1] = child->keys[0];
+			} else {
+				memmove(&child->children[1], &child->children[0], (child->count + 1) * sizeof(btree_page_t));
+				child->keys[0] = parent->keys[slot - 1];
+				child->children[0] = sibling->children[sibling->count];
+				parent->keys[slot - 1] = sibling->keys[sibling->count - 1];
+			}
+			child->count++;
+			sibling->count--;
+			if (DB_ERROR(node_write(tree, parent->children[slot - 1], sibling)) || DB_ERROR(node_write(tree, parent->children[slot], child))) {
+				result = DB_INDEX_ERROR;
+			}
+			goto out;
+		}
+	}
+
+	/* Borrow from the right sibling */
+	if (slot < parent->count) {
+		if (DB_ERROR(node_read(tree, parent->children[slot + 1], sibling))) {
+			result = DB_INDEX_ERROR;
+			goto out;
+		}
+		if (sibling->count > BTREE_MIN_KEYS) {
+			if (child->is_leaf) {
+				child->keys[child->count] = sibling->keys[0];
+				memmove(&sibling->keys[0], &sibling->keys[1], (sibling->count - 1) * sizeof(btree_key_t));
+				parent->keys[slot] = sibling->keys[0];
+			} else {
+				child->keys[child->count] = parent->keys[slot];
+				child->children[child->count + 1] = sibling->children[0];
+				parent->keys[slot] = sibling->keys[0];
+				memmove(&sibling->keys[0], &sibling->keys[1], (sibling->count - 1) * sizeof(btree_key_t));
+				memmove(&sibling->children[0], &sibling->children[1], sibling->count * sizeof(btree_page_t));
+			}
+			child->count++;
+			sibling->count--;
+			if (DB_ERROR(node_write(tree, parent->children[slot + 1], sibling)) || DB_ERROR(node_write(tree, parent->children[slot], child))) {
+				result = DB_INDEX_ERROR;
+			}
+			goto out;
+		}
+		/* Both neighbours are at their minimum, merge with the right one */
+		result = merge_nodes(tree, parent, slot, child, sibling);
+		goto out;
+	}
+
+	/* The child is the rightmost one, merge it into its left sibling */
+	result = merge_nodes(tree, parent, slot - 1, sibling, child);
+
+out:
+	free(child);
+	free(sibling);
+	return result;
+}
+
+static btree_result_t delete_rec(btree_t *tree, btree_page_t page, btree_key_t *key)
+{
+	btree_node_t *node;
+	btree_result_t result;
+	int slot;
+
+	node = (btree_node_t *)malloc(sizeof(btree_node_t));
+	if (node == NULL) {
+		return BTREE_ERROR;
+	}
+	if (DB_ERROR(node_read(tree, page, node))) {
+		free(node);
+		return BTREE_ERROR;
+	}
+
+	if (node->is_leaf) {
+		slot = node_lower_bound(node, key);
+		if (slot >= node->count || key_compare(&node->keys[slot], key) != 0) {
+			free(node);
+			return BTREE_NOT_FOUND;
+		}
+		memmove(&node->keys[slot], &node->keys[slot + 1], (node->count - slot - 1) * sizeof(btree_key_t));
+		node->count--;
+		result = DB_ERROR(node_write(tree, page, node)) ? BTREE_ERROR : BTREE_OK;
+		free(node);
+		return result;
+	}
+
+	slot = node_child_slot(node, key);
+	result = delete_rec(tree, node->children[slot], key);
+	if (result == BTREE_OK) {
+		if (DB_ERROR(rebalance(tree, node, slot)) || DB_ERROR(node_write(tree, page, node))) {
+			result = BTREE_ERROR;
+		}
+	}
+	free(node);
+	return result;
+}
+
+/* Finds the leaf and the slot of the first entry not less than key. */
+static db_result_t btree_seek(btree_t *tree, btree_key_t *key, btree_page_t *page, uint16_t *slot, btree_node_t *node)
+{
+	btree_page_t current = tree->meta.root;
+
+	while (1) {
+		if (DB_ERROR(node_read(tree, current, node))) {
+			return DB_INDEX_ERROR;
+		}
+		if (node->is_leaf) {
+			break;
+		}
+		current = node->children[node_child_slot(node, key)];
+	}
+
+	*page = current;
+	*slot = node_lower_bound(node, key);
+	return DB_OK;
+}
+
+static btree_t *btree_alloc(void)
+{
+	btree_t *tree;
+
+	tree = (btree_t *)malloc(sizeof(btree_t));
+	if (tree == NULL) {
+		return NULL;
+	}
+	memset(tree, 0, sizeof(btree_t));
+	tree->storage = INVALID_STORAGE_ID;
+	pthread_mutex_init(&tree->lock, NULL);
+	return tree;
+}
+
+/****************************************************************************
+ * Name: create
+ *
+ * Description: Generates the index file holding the tree metadata and an
+ *              empty root leaf.
+ *
+ ****************************************************************************/
+static db_result_t create(index_t *index)
+{
+	char filename[DB_MAX_FILENAME_LENGTH];
+	btree_node_t root;
+	btree_t *tree;
+
+	tree = btree_alloc();
+	if (tree == NULL) {
+		DB_LOG_E("DB: Failed to allocate a btree\n");
+		return DB_ALLOCATION_ERROR;
+	}
+
+	storage_name_file(index->rel, filename, BTREE_FILE_LENGTH, BTREE_FILE_NAME);
+	if (DB_ERROR(storage_generate_file(filename))) {
+		DB_LOG_E("DB: Failed to generate a btree file\n");
+		free(tree);
+		return DB_STORAGE_ERROR;
+	}
+
+	tree->storage = storage_open(filename, O_RDWR);
+	if (tree->storage < 0) {
+		storage_remove(filename);
+		free(tree);
+		return DB_STORAGE_ERROR;
+	}
+
+	tree->meta.magic = BTREE_MAGIC;
+	tree->meta.root = 1;
+	tree->meta.npages = 1;
+	tree->meta.free_head = BTREE_NULL_PAGE;
+	tree->meta.entries = 0;
+	tree->meta.height = 1;
+
+	node_init(&root, TRUE);
+	if (DB_ERROR(meta_write(tree)) || DB_ERROR(node_write(tree, tree->meta.root, &root))) {
+		storage_close(tree->storage);
+		storage_remove(filename);
+		free(tree);
+		return DB_STORAGE_ERROR;
+	}
+
+	memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+	index->opaque_data = tree;
+
+	DB_LOG_D("DB: Created a btree index in \"%s\"\n", index->descriptor_file);
+	return DB_OK;
+}
+
+static db_result_t destroy(index_t *index)
+{
+	/* The index file itself is removed by the index manager */
+	if (index->opaque_data != NULL) {
+		return release(index);
+	}
+	return DB_OK;
+}
+
+static db_result_t load(index_t *index)
+{
+	btree_t *tree;
+
+	tree = btree_alloc();
+	if (tree == NULL) {
+		DB_LOG_E("DB: Failed to allocate a btree while loading\n");
+		return DB_ALLOCATION_ERROR;
+	}
+
+	tree->storage = storage_open(index->descriptor_file, O_RDWR);
+	if (tree->storage < 0) {
+		DB_LOG_E("DB: Failed to open btree file %s\n", index->descriptor_file);
+		free(tree);
+		return DB_STORAGE_ERROR;
+	}
+
+	if (DB_ERROR(storage_read_from(tree->storage, &tree->meta, 0, sizeof(btree_meta_t))) || tree->meta.magic != BTREE_MAGIC) {
+		DB_LOG_E("DB: Invalid btree metadata in %s\n", index->descriptor_file);
+		storage_close(tree->storage);
+		free(tree);
+		return DB_STORAGE_ERROR;
+	}
+	tree->stored = tree->meta;
+
+	index->opaque_data = tree;
+
+	DB_LOG_D("DB: Loaded btree index from %s, height %d, %lu entries\n", index->descriptor_file, tree->meta.height, (unsigned long)tree->meta.entries);
+	return DB_OK;
+}
+
+static db_result_t release(index_t *index)
+{
+	btree_t *tree;
+	db_result_t result;
+
+	tree = (btree_t *)index->opaque_data;
+	if (tree == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+
+	result = meta_write(tree);
+	storage_close(tree->storage);
+	pthread_mutex_destroy(&tree->lock);
+	free(tree);
+	index->opaque_data = NULL;
+
+	return result;
+}
+
+static db_result_t insert(index_t *index, attribute_value_t *value, tuple_id_t tuple_id)
+{
+	btree_t *tree;
+	btree_key_t key;
+	btree_key_t sep;
+	btree_page_t new_page;
+	btree_node_t *root;
+	btree_result_t result;
+
+	tree = (btree_t *)index->opaque_data;
+	key.key = db_value_to_long(value);
+	key.tuple_id = tuple_id;
+
+	pthread_mutex_lock(&tree->lock);
+
+	result = insert_rec(tree, tree->meta.root, &key, &sep, &new_page);
+	if (result == BTREE_SPLIT) {
+		/* The root was split, so the tree grows by one level */
+		root = (btree_node_t *)malloc(sizeof(btree_node_t));
+		if (root == NULL) {
+			result = BTREE_ERROR;
+			goto out;
+		}
+		node_init(root, FALSE);
+		root->count = 1;
+		root->keys[0] = sep;
+		root->children[0] = tree->meta.root;
+		root->children[1] = new_page;
+
+		tree->meta.root = page_alloc(tree);
+		if (tree->meta.root == BTREE_NULL_PAGE || DB_ERROR(node_write(tree, tree->meta.root, root))) {
+			free(root);
+			result = BTREE_ERROR;
+			goto out;
+		}
+		free(root);
+		tree->meta.height++;
+		DB_LOG_D("DB: btree grew to height %d\n", tree->meta.height);
+		result = BTREE_OK;
+	}
+
+	if (result == BTREE_OK) {
+		tree->meta.entries++;
+	}
+
+	if (result != BTREE_ERROR && DB_ERROR(meta_sync(tree))) {
+		result = BTREE_ERROR;
+	}
+
+out:
+	pthread_mutex_unlock(&tree->lock);
+
+	if (result == BTREE_ERROR) {
+		DB_LOG_E("DB: Failed to insert key %ld into a btree index\n", key.key);
+		return DB_INDEX_ERROR;
+	}
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: delete
+ *
+ * Description: Removes every entry whose key equals the given value.
+ *
+ ****************************************************************************/
+static db_result_t delete(index_t *index, attribute_value_t *value)
+{
+	btree_t *tree;
+	btree_node_t *node;
+	btree_node_t *root;
+	btree_key_t key;
+	btree_page_t page;
+	btree_page_t old_root;
+	uint16_t slot;
+	db_result_t result = DB_OK;
+
+	tree = (btree_t *)index->opaque_data;
+	key.key = db_value_to_long(value);
+	key.tuple_id = 0;
+
+	node = (btree_node_t *)malloc(sizeof(btree_node_t));
+	if (node == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+
+	pthread_mutex_lock(&tree->lock);
+
+	while (1) {
+		key.tuple_id = 0;
+		if (DB_ERROR(btree_seek(tree, &key, &page, &slot, node))) {
+			result = DB_INDEX_ERROR;
+			break;
+		}
+		if (slot >= node->count) {
+			if (node->next == BTREE_NULL_PAGE || DB_ERROR(node_read(tree, node->next, node))) {
+				break;
+			}
+			slot = 0;
+		}
+		if (node->count == 0 || node->keys[slot].key != key.key) {
+			break;
+		}
+
+		key.tuple_id = node->keys[slot].tuple_id;
+		if (delete_rec(tree, tree->meta.root, &key) != BTREE_OK) {
+			result = DB_INDEX_ERROR;
+			break;
+		}
+		tree->meta.entries--;
+
+		/* An inner root left without keys is replaced by its only child */
+		root = node;
+		if (DB_ERROR(node_read(tree, tree->meta.root, root))) {
+			result = DB_INDEX_ERROR;
+			break;
+		}
+		if (!root->is_leaf && root->count == 0) {
+			old_root = tree->meta.root;
+			tree->meta.root = root->children[0];
+			tree->meta.height--;
+			page_free(tree, old_root);
+			DB_LOG_D("DB: btree shrank to height %d\n", tree->meta.height);
+		}
+	}
+
+	if (DB_ERROR(meta_sync(tree))) {
+		result = DB_STORAGE_ERROR;
+	}
+
+	pthread_mutex_unlock(&tree->lock);
+	free(node);
+	return result;
+}
+
+/****************************************************************************
+ * Name: get_next
+ *
+ * Description: Returns the tuple id of the next entry within the range of
+ *              the iterator. The first call descends from the root to the
+ *              first matching leaf; later calls follow the leaf chain.
+ *
+ ****************************************************************************/
+static tuple_id_t get_next(index_iterator_t *iterator, uint8_t matched_condition)
+{
+	btree_t *tree;
+	btree_iter_t *iter;
+	btree_key_t key;
+	btree_page_t prev;
+	bool reseek = false;
+	tuple_id_t tuple_id = INVALID_TUPLE;
+	long max;
+
+	tree = (btree_t *)iterator->index->opaque_data;
+	max = db_value_to_long(&iterator->max_value);
+
+	iter = (btree_iter_t *)iterator->opaque_data;
+	if (iter == NULL) {
+		iter = (btree_iter_t *)malloc(sizeof(btree_iter_t));
+		if (iter == NULL) {
+			return INVALID_TUPLE;
+		}
+		iterator->opaque_data = iter;
+	}
+
+	pthread_mutex_lock(&tree->lock);
+
+	if (iterator->next_item_no == 0) {
+		key.key = db_value_to_long(&iterator->min_value);
+		key.tuple_id = 0;
+		if (DB_ERROR(btree_seek(tree, &key, &iter->page, &iter->slot, &iter->leaf))) {
+			goto out;
+		}
+	} else {
+		key = iter->last;
+	}
+
+	for (;;) {
+		while (iter->slot >= iter->leaf.count) {
+			if (iter->leaf.next == BTREE_NULL_PAGE) {
+				goto out;
+			}
+			prev = iter->page;
+			iter->page = iter->leaf.next;
+			if (DB_ERROR(node_read(tree, iter->page, &iter->leaf))) {
+				goto out;
+			}
+			iter->slot = 0;
+
+			/*
+			 * The copy was stale and its next page was freed or reused.
+			 * A copy read under the lock is current, so seek only once.
+			 */
+			if (!iter->leaf.is_leaf || iter->leaf.prev != prev) {
+				if (reseek || DB_ERROR(btree_seek(tree, &key, &iter->page, &iter->slot, &iter->leaf))) {
+					goto out;
+				}
+				reseek = true;
+			}
+		}
+		if (iterator->next_item_no == 0 || key_compare(&iter->leaf.keys[iter->slot], &iter->last) > 0) {
+			break;
+		}
+		/* Moved to the next leaf by a split since the copy was read */
+		iter->slot++;
+	}
+
+	if (iter->leaf.keys[iter->slot].key > max) {
+		goto out;
+	}
+
+	iter->last = iter->leaf.keys[iter->slot];
+	tuple_id = iter->last.tuple_id;
+	iter->slot++;
+	iterator->next_item_no++;
+	iterator->found_items++;
+
+out:
+	pthread_mutex_unlock(&tree->lock);
+	return tuple_id;
+}
@@ -0,0 +1,812 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      An extendible hash index for equality lookups. A directory of
+ *      2^depth slots, addressed by the low bits of the key hash, points
+ *      to bucket pages. A full bucket is split in two, doubling the
+ *      directory when needed, so that a lookup reads a single directory
+ *      slot and, in most cases, a single bucket page.
+ *
+ *      Once the directory has reached its maximum depth, or when all the
+ *      entries of a bucket share the same hash bits, further entries go
+ *      to overflow pages chained from the bucket.
+ *
+ *      File layout : [meta][directory][page 1][page 2]...
+ *      The directory is allocated for the maximum depth when the file is
+ *      created, and page 0 is never used so that it can act as the null
+ *      page id.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "result.h"
+#include "db_options.h"
+#include "db_debug.h"
+#include "storage.h"
+#include "random.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define HASH_BUCKET_SIZE    CONFIG_ARASTORAGE_HASH_BUCKET_SIZE
+#define HASH_MAX_DEPTH      CONFIG_ARASTORAGE_HASH_MAX_DEPTH
+#define HASH_MAGIC          0x48415348	/* "HASH" */
+#define HASH_NULL_PAGE      0
+
+#define HASH_DIRECTORY_SIZE (1UL << HASH_MAX_DEPTH)
+#define HASH_MASK(depth)    ((1UL << (depth)) - 1)
+
+#define HASH_SLOT_OFFSET(slot) \
+	(sizeof(hash_meta_t) + (unsigned long)(slot) * sizeof(hash_page_t))
+#define HASH_PAGE_OFFSET(page) \
+	(HASH_SLOT_OFFSET(HASH_DIRECTORY_SIZE) + ((unsigned long)(page) - 1) * sizeof(hash_bucket_t))
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef uint32_t hash_page_t;
+
+struct hash_entry_s {
+	long key;
+	tuple_id_t tuple_id;
+};
+typedef struct hash_entry_s hash_entry_t;
+
+/*
+ * Only the first page of a chain is pointed to by the directory and
+ * carries a meaningful local depth; overflow pages inherit it.
+ */
+struct hash_bucket_s {
+	uint16_t depth;			/* Number of hash bits shared by the entries */
+	uint16_t count;
+	hash_page_t overflow;		/* Next page of the chain, or of the free list */
+	hash_entry_t entries[HASH_BUCKET_SIZE];
+};
+typedef struct hash_bucket_s hash_bucket_t;
+
+/* Hash metadata kept at the beginning of the index file */
+struct hash_meta_s {
+	uint32_t magic;
+	hash_page_t npages;		/* Number of pages ever allocated in the file */
+	hash_page_t free_head;		/* Head of the list of released pages */
+	uint32_t entries;		/* Number of <key, tuple id> entries */
+	uint8_t depth;			/* Number of hash bits addressing the directory */
+};
+typedef struct hash_meta_s hash_meta_t;
+
+/* Hash state maintained in RAM */
+struct hash_s {
+	db_storage_id_t storage;
+	hash_meta_t meta;
+	pthread_mutex_t lock;
+};
+typedef struct hash_s hash_t;
+
+/*
+ * Iteration state for get_next(), kept in the opaque_data of each
+ * iterator. The tuple ids of the current key are copied in one go, so a
+ * writer may split the bucket while a query walks them.
+ */
+struct hash_iter_s {
+	long key;
+	tuple_id_t count;
+	tuple_id_t next;
+	tuple_id_t capacity;
+	tuple_id_t tuple_ids[];
+};
+typedef struct hash_iter_s hash_iter_t;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *, uint8_t);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+index_api_t index_hash = {
+	INDEX_HASH,
+	INDEX_API_EXTERNAL,
+	create,
+	destroy,
+	load,
+	release,
+	insert,
+	delete,
+	get_next,
+	NULL
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/* Mixes the key so that sequential keys spread over the low bits. */
+static uint32_t key_hash(long key)
+{
+	uint32_t hash;
+
+	hash = (uint32_t)key ^ (uint32_t)(((unsigned long)key >> 16) >> 16);
+	hash *= 0x9e3779b1;
+	return hash ^ (hash >> 16);
+}
+
+static int tuple_id_compare(const void *a, const void *b)
+{
+	tuple_id_t t1 = *(const tuple_id_t *)a;
+	tuple_id_t t2 = *(const tuple_id_t *)b;
+
+	return t1 < t2 ? -1 : (t1 > t2 ? 1 : 0);
+}
+
+static db_result_t meta_write(hash_t *hash)
+{
+	return storage_write_to(hash->storage, &hash->meta, 0, sizeof(hash_meta_t));
+}
+
+static db_result_t slot_read(hash_t *hash, unsigned long slot, hash_page_t *page)
+{
+	return storage_read_from(hash->storage, page, HASH_SLOT_OFFSET(slot), sizeof(hash_page_t));
+}
+
+static db_result_t slot_write(hash_t *hash, unsigned long slot, hash_page_t page)
+{
+	return storage_write_to(hash->storage, &page, HASH_SLOT_OFFSET(slot), sizeof(hash_page_t));
+}
+
+static db_result_t bucket_read(hash_t *hash, hash_page_t page, hash_bucket_t *bucket)
+{
+	if (page == HASH_NULL_PAGE || page > hash->meta.npages) {
+		DB_LOG_E("DB: Invalid hash page %lu\n", (unsigned long)page);
+		return DB_INDEX_ERROR;
+	}
+	return storage_read_from(hash->storage, bucket, HASH_PAGE_OFFSET(page), sizeof(hash_bucket_t));
+}
+
+static db_result_t bucket_write(hash_t *hash, hash_page_t page, hash_bucket_t *bucket)
+{
+	return storage_write_to(hash->storage, bucket, HASH_PAGE_OFFSET(page), sizeof(hash_bucket_t));
+}
+
+/* Takes a page from the free list, or extends the file by one page. */
+static hash_page_t page_alloc(hash_t *hash)
+{
+	hash_bucket_t bucket;
+	hash_page_t page;
+
+	if (hash->meta.free_head != HASH_NULL_PAGE) {
+		page = hash->meta.free_head;
+		if (DB_ERROR(bucket_read(hash, page, &bucket))) {
+			return HASH_NULL_PAGE;
+		}
+		hash->meta.free_head = bucket.overflow;
+		return page;
+	}
+
+	return ++hash->meta.npages;
+}
+
+static void page_free(hash_t *hash, hash_page_t page)
+{
+	hash_bucket_t bucket;
+
+	memset(&bucket, 0, sizeof(hash_bucket_t));
+	bucket.overflow = hash->meta.free_head;
+	if (DB_SUCCESS(bucket_write(hash, page, &bucket))) {
+		hash->meta.free_head = page;
+	}
+}
+
+/****************************************************************************
+ * Name: chain_collect
+ *
+ * Description: Copies every entry of the chain starting at page into a
+ *              newly allocated array, returned through entries, and
+ *              releases the overflow pages of the chain. The first page
+ *              is read into bucket.
+ *
+ ****************************************************************************/
+static db_result_t chain_collect(hash_t *hash, hash_page_t page, hash_bucket_t *bucket, hash_entry_t **entries, int *count)
+{
+	hash_bucket_t overflow;
+	hash_entry_t *array = NULL;
+	hash_entry_t *grown;
+	hash_page_t next;
+	int n = 0;
+
+	if (DB_ERROR(bucket_read(hash, page, bucket))) {
+		return DB_INDEX_ERROR;
+	}
+
+	memcpy(&overflow, bucket, sizeof(hash_bucket_t));
+	for (;;) {
+		grown = (hash_entry_t *)realloc(array, (n + overflow.count + 1) * sizeof(hash_entry_t));
+		if (grown == NULL) {
+			free(array);
+			return DB_ALLOCATION_ERROR;
+		}
+		array = grown;
+		memcpy(&array[n], overflow.entries, overflow.count * sizeof(hash_entry_t));
+		n += overflow.count;
+
+		next = overflow.overflow;
+		if (next == HASH_NULL_PAGE) {
+			break;
+		}
+		if (DB_ERROR(bucket_read(hash, next, &overflow))) {
+			free(array);
+			return DB_INDEX_ERROR;
+		}
+		page_free(hash, next);
+	}
+
+	bucket->count = 0;
+	bucket->overflow = HASH_NULL_PAGE;
+	*entries = array;
+	*count = n;
+	return DB_OK;
+}
+
+/* Writes entries into the chain starting at page, adding overflow pages as needed. */
+static db_result_t chain_store(hash_t *hash, hash_page_t page, uint16_t depth, hash_entry_t *entries, int count)
+{
+	hash_bucket_t bucket;
+	hash_page_t next;
+	int n;
+
+	for (;;) {
+		memset(&bucket, 0, sizeof(hash_bucket_t));
+		bucket.depth = depth;
+		n = count < HASH_BUCKET_SIZE ? count : HASH_BUCKET_SIZE;
+		memcpy(bucket.entries, entries, n * sizeof(hash_entry_t));
+		bucket.count = n;
+		entries += n;
+		count -= n;
+
+		next = HASH_NULL_PAGE;
+		if (count > 0) {
+			next = page_alloc(hash);
+			if (next == HASH_NULL_PAGE) {
+				return DB_INDEX_ERROR;
+			}
+		}
+		bucket.overflow = next;
+		if (DB_ERROR(bucket_write(hash, page, &bucket))) {
+			return DB_STORAGE_ERROR;
+		}
+		if (next == HASH_NULL_PAGE) {
+			return DB_OK;
+		}
+		page = next;
+	}
+}
+
+/****************************************************************************
+ * Name: bucket_split
+ *
+ * Description: Splits the bucket addressed by slot on the next hash bit.
+ *              The entries whose bit is set move to a new page and the
+ *              directory slots sharing that bit are pointed to it. The
+ *              directory is doubled first when the bucket already uses
+ *              every bit of it.
+ *
+ ****************************************************************************/
+static db_result_t bucket_split(hash_t *hash, unsigned long slot, hash_page_t page)
+{
+	hash_bucket_t bucket;
+	hash_entry_t *entries;
+	hash_page_t new_page;
+	hash_page_t target;
+	unsigned long base;
+	unsigned long i;
+	uint16_t depth;
+	int count;
+	int low;
+	int j;
+	db_result_t result;
+
+	result = chain_collect(hash, page, &bucket, &entries, &count);
+	if (DB_ERROR(result)) {
+		return result;
+	}
+	depth = bucket.depth;
+
+	if (depth == hash->meta.depth) {
+		for (i = 0; i < (1UL << depth); i++) {
+			if (DB_ERROR(slot_read(hash, i, &target)) || DB_ERROR(slot_write(hash, i + (1UL << depth), target))) {
+				result = DB_STORAGE_ERROR;
+				goto out;
+			}
+		}
+		hash->meta.depth++;
+		DB_LOG_D("DB: hash directory grew to depth %d\n", hash->meta.depth);
+	}
+
+	new_page = page_alloc(hash);
+	if (new_page == HASH_NULL_PAGE) {
+		result = DB_INDEX_ERROR;
+		goto out;
+	}
+
+	/* Entries staying in the old page are moved to the front */
+	low = 0;
+	for (j = 0; j < count; j++) {
+		if (!(key_hash(entries[j].key) & (1UL << depth))) {
+			hash_entry_t entry = entries[j];
+			entries[j] = entries[low];
+			entries[low++] = entry;
+		}
+	}
+
+	result = chain_store(hash, page, depth + 1, entries, low);
+	if (DB_SUCCESS(result)) {
+		result = chain_store(hash, new_page, depth + 1, &entries[low], count - low);
+	}
+	if (DB_ERROR(result)) {
+		goto out;
+	}
+
+	base = (slot & HASH_MASK(depth)) | (1UL << depth);
+	for (i = base; i < (1UL << hash->meta.depth); i += 1UL << (depth + 1)) {
+		if (DB_ERROR(slot_write(hash, i, new_page))) {
+			result = DB_STORAGE_ERROR;
+			goto out;
+		}
+	}
+
+out:
+	free(entries);
+	return result;
+}
+
+/*
+ * Returns whether splitting the chain would separate its entries, i.e.
+ * whether they differ in one of the hash bits the directory may still use.
+ */
+static int bucket_splittable(hash_t *hash, hash_page_t page, uint32_t bits)
+{
+	hash_bucket_t bucket;
+	int i;
+
+	while (page != HASH_NULL_PAGE) {
+		if (DB_ERROR(bucket_read(hash, page, &bucket))) {
+			return FALSE;
+		}
+		for (i = 0; i < bucket.count; i++) {
+			if ((key_hash(bucket.entries[i].key) & HASH_MASK(HASH_MAX_DEPTH)) != bits) {
+				return TRUE;
+			}
+		}
+		page = bucket.overflow;
+	}
+	return FALSE;
+}
+
+static db_result_t hash_insert(hash_t *hash, hash_entry_t *entry)
+{
+	hash_bucket_t bucket;
+	hash_page_t first;
+	hash_page_t page;
+	hash_page_t last;
+	unsigned long slot;
+	uint32_t bits;
+
+	bits = key_hash(entry->key);
+
+	for (;;) {
+		slot = bits & HASH_MASK(hash->meta.depth);
+		if (DB_ERROR(slot_read(hash, slot, &first))) {
+			return DB_STORAGE_ERROR;
+		}
+
+		page = first;
+		do {
+			if (DB_ERROR(bucket_read(hash, page, &bucket))) {
+				return DB_INDEX_ERROR;
+			}
+			if (bucket.count < HASH_BUCKET_SIZE) {
+				bucket.entries[bucket.count++] = *entry;
+				return bucket_write(hash, page, &bucket);
+			}
+			last = page;
+			page = bucket.overflow;
+		} while (page != HASH_NULL_PAGE);
+
+		if (DB_ERROR(bucket_read(hash, first, &bucket))) {
+			return DB_INDEX_ERROR;
+		}
+		if (bucket.depth < HASH_MAX_DEPTH && bucket_splittable(hash, first, bits & HASH_MASK(HASH_MAX_DEPTH))) {
+			if (DB_ERROR(bucket_split(hash, slot, first))) {
+				return DB_INDEX_ERROR;
+			}
+			continue;
+		}
+
+		/* Splitting cannot help, so the chain grows by an overflow page */
+		page = page_alloc(hash);
+		if (page == HASH_NULL_PAGE || DB_ERROR(bucket_read(hash, last, &bucket))) {
+			return DB_INDEX_ERROR;
+		}
+		bucket.overflow = page;
+		if (DB_ERROR(bucket_write(hash, last, &bucket))) {
+			return DB_STORAGE_ERROR;
+		}
+		memset(&bucket, 0, sizeof(hash_bucket_t));
+		bucket.count = 1;
+		bucket.entries[0] = *entry;
+		return bucket_write(hash, page, &bucket);
+	}
+}
+
+/****************************************************************************
+ * Name: hash_lookup
+ *
+ * Description: Copies the tuple ids of every entry with the given key into
+ *              the iteration state, growing it as needed, in tuple id
+ *              order.
+ *
+ ****************************************************************************/
+static db_result_t hash_lookup(hash_t *hash, index_iterator_t *iterator, long key)
+{
+	hash_bucket_t bucket;
+	hash_iter_t *iter;
+	hash_page_t page;
+	tuple_id_t capacity;
+	int i;
+
+	iter = (hash_iter_t *)iterator->opaque_data;
+	iter->key = key;
+	iter->count = 0;
+	iter->next = 0;
+
+	if (DB_ERROR(slot_read(hash, key_hash(key) & HASH_MASK(hash->meta.depth), &page))) {
+		return DB_STORAGE_ERROR;
+	}
+
+	while (page != HASH_NULL_PAGE) {
+		if (DB_ERROR(bucket_read(hash, page, &bucket))) {
+			return DB_INDEX_ERROR;
+		}
+		for (i = 0; i < bucket.count; i++) {
+			if (bucket.entries[i].key != key) {
+				continue;
+			}
+			if (iter->count == iter->capacity) {
+				capacity = iter->capacity * 2;
+				iter = (hash_iter_t *)realloc(iter, sizeof(hash_iter_t) + capacity * sizeof(tuple_id_t));
+				if (iter == NULL) {
+					free(iterator->opaque_data);
+					iterator->opaque_data = NULL;
+					return DB_ALLOCATION_ERROR;
+				}
+				iter->capacity = capacity;
+				iterator->opaque_data = iter;
+			}
+			iter->tuple_ids[iter->count++] = bucket.entries[i].tuple_id;
+		}
+		page = bucket.overflow;
+	}
+
+	qsort(iter->tuple_ids, iter->count, sizeof(tuple_id_t), tuple_id_compare);
+	return DB_OK;
+}
+
+static hash_t *hash_alloc(void)
+{
+	hash_t *hash;
+
+	hash = (hash_t *)malloc(sizeof(hash_t));
+	if (hash == NULL) {
+		return NULL;
+	}
+	memset(hash, 0, sizeof(hash_t));
+	hash->storage = INVALID_STORAGE_ID;
+	pthread_mutex_init(&hash->lock, NULL);
+	return hash;
+}
+
+/****************************************************************************
+ * Name: create
+ *
+ * Description: Generates the index file holding the hash metadata, the
+ *              directory and a single empty bucket.
+ *
+ ****************************************************************************/
+static db_result_t create(index_t *index)
+{
+	char filename[DB_MAX_FILENAME_LENGTH];
+	hash_page_t directory[32];
+	hash_bucket_t bucket;
+	hash_t *hash;
+	unsigned long slot;
+	unsigned long n;
+
+	hash = hash_alloc();
+	if (hash == NULL) {
+		DB_LOG_E("DB: Failed to allocate a hash\n");
+		return DB_ALLOCATION_ERROR;
+	}
+
+	storage_name_file(index->rel, filename, HASH_FILE_LENGTH, HASH_FILE_NAME);
+	if (DB_ERROR(storage_generate_file(filename))) {
+		DB_LOG_E("DB: Failed to generate a hash file\n");
+		free(hash);
+		return DB_STORAGE_ERROR;
+	}
+
+	hash->storage = storage_open(filename, O_RDWR);
+	if (hash->storage < 0) {
+		storage_remove(filename);
+		free(hash);
+		return DB_STORAGE_ERROR;
+	}
+
+	hash->meta.magic = HASH_MAGIC;
+	hash->meta.npages = 1;
+	hash->meta.free_head = HASH_NULL_PAGE;
+	hash->meta.entries = 0;
+	hash->meta.depth = 0;
+
+	if (DB_ERROR(meta_write(hash))) {
+		goto errout;
+	}
+
+	/* The whole directory is written so that the bucket pages follow it */
+	memset(directory, 0, sizeof(directory));
+	directory[0] = 1;
+	for (slot = 0; slot < HASH_DIRECTORY_SIZE; slot += n) {
+		n = HASH_DIRECTORY_SIZE - slot;
+		if (n > sizeof(directory) / sizeof(directory[0])) {
+			n = sizeof(directory) / sizeof(directory[0]);
+		}
+		if (DB_ERROR(storage_write_to(hash->storage, directory, HASH_SLOT_OFFSET(slot), n * sizeof(hash_page_t)))) {
+			goto errout;
+		}
+		directory[0] = HASH_NULL_PAGE;
+	}
+
+	memset(&bucket, 0, sizeof(hash_bucket_t));
+	if (DB_ERROR(bucket_write(hash, 1, &bucket))) {
+		goto errout;
+	}
+
+	memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+	index->opaque_data = hash;
+
+	DB_LOG_D("DB: Created a hash index in \"%s\"\n", index->descriptor_file);
+	return DB_OK;
+
+errout:
+	storage_close(hash->storage);
+	storage_remove(filename);
+	free(hash);
+	return DB_STORAGE_ERROR;
+}
+
+static db_result_t destroy(index_t *index)
+{
+	/* The index file itself is removed by the index manager */
+	if (index->opaque_data != NULL) {
+		return release(index);
+	}
+	return DB_OK;
+}
+
+static db_result_t load(index_t *index)
+{
+	hash_t *hash;
+
+	hash = hash_alloc();
+	if (hash == NULL) {
+		DB_LOG_E("DB: Failed to allocate a hash while loading\n");
+		return DB_ALLOCATION_ERROR;
+	}
+
+	hash->storage = storage_open(index->descriptor_file, O_RDWR);
+	if (hash->storage < 0) {
+		DB_LOG_E("DB: Failed to open hash file %s\n", index->descriptor_file);
+		free(hash);
+		return DB_STORAGE_ERROR;
+	}
+
+	if (DB_ERROR(storage_read_from(hash->storage, &hash->meta, 0, sizeof(hash_meta_t))) || hash->meta.magic != HASH_MAGIC || hash->meta.depth > HASH_MAX_DEPTH) {
+		DB_LOG_E("DB: Invalid hash metadata in %s\n", index->descriptor_file);
+		storage_close(hash->storage);
+		free(hash);
+		return DB_STORAGE_ERROR;
+	}
+
+	index->opaque_data = hash;
+
+	DB_LOG_D("DB: Loaded hash index from %s, depth %d, %lu entries\n", index->descriptor_file, hash->meta.depth, (unsigned long)hash->meta.entries);
+	return DB_OK;
+}
+
+static db_result_t release(index_t *index)
+{
+	hash_t *hash;
+	db_result_t result;
+
+	hash = (hash_t *)index->opaque_data;
+	if (hash == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+
+	result = meta_write(hash);
+	storage_close(hash->storage);
+	pthread_mutex_destroy(&hash->lock);
+	free(hash);
+	index->opaque_data = NULL;
+
+	return result;
+}
+
+static db_result_t insert(index_t *index, attribute_value_t *value, tuple_id_t tuple_id)
+{
+	hash_t *hash;
+	hash_entry_t entry;
+	db_result_t result;
+
+	hash = (hash_t *)index->opaque_data;
+	entry.key = db_value_to_long(value);
+	entry.tuple_id = tuple_id;
+
+	pthread_mutex_lock(&hash->lock);
+
+	result = hash_insert(hash, &entry);
+	if (DB_SUCCESS(result)) {
+		hash->meta.entries++;
+	}
+	if (DB_ERROR(meta_write(hash))) {
+		result = DB_STORAGE_ERROR;
+	}
+
+	pthread_mutex_unlock(&hash->lock);
+
+	if (DB_ERROR(result)) {
+		DB_LOG_E("DB: Failed to insert key %ld into a hash index\n", entry.key);
+		return DB_INDEX_ERROR;
+	}
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: delete
+ *
+ * Description: Removes every entry whose key equals the given value. The
+ *              remaining entries of the chain are packed again, but
+ *              buckets are never merged back.
+ *
+ ****************************************************************************/
+static db_result_t delete(index_t *index, attribute_value_t *value)
+{
+	hash_t *hash;
+	hash_bucket_t bucket;
+	hash_entry_t *entries;
+	hash_page_t page;
+	long key;
+	int count;
+	int kept;
+	int i;
+	db_result_t result;
+
+	hash = (hash_t *)index->opaque_data;
+	key = db_value_to_long(value);
+
+	pthread_mutex_lock(&hash->lock);
+
+	if (DB_ERROR(slot_read(hash, key_hash(key) & HASH_MASK(hash->meta.depth), &page))) {
+		result = DB_STORAGE_ERROR;
+		goto out;
+	}
+
+	result = chain_collect(hash, page, &bucket, &entries, &count);
+	if (DB_ERROR(result)) {
+		goto out;
+	}
+
+	kept = 0;
+	for (i = 0; i < count; i++) {
+		if (entries[i].key != key) {
+			entries[kept++] = entries[i];
+		}
+	}
+	hash->meta.entries -= count - kept;
+
+	result = chain_store(hash, page, bucket.depth, entries, kept);
+	free(entries);
+
+	if (DB_ERROR(meta_write(hash))) {
+		result = DB_STORAGE_ERROR;
+	}
+
+out:
+	pthread_mutex_unlock(&hash->lock);
+	return result;
+}
+
+/****************************************************************************
+ * Name: get_next
+ *
+ * Description: Returns the tuple id of the next entry within the range of
+ *              the iterator. Keys are looked up one at a time from the
+ *              minimum to the maximum of the range; the index manager
+ *              only hands over ranges small enough for this to be cheaper
+ *              than a scan.
+ *
+ ****************************************************************************/
+static tuple_id_t get_next(index_iterator_t *iterator, uint8_t matched_condition)
+{
+	hash_t *hash;
+	hash_iter_t *iter;
+	tuple_id_t tuple_id = INVALID_TUPLE;
+	long max;
+
+	hash = (hash_t *)iterator->index->opaque_data;
+	max = db_value_to_long(&iterator->max_value);
+
+	if (iterator->opaque_data == NULL) {
+		iter = (hash_iter_t *)malloc(sizeof(hash_iter_t) + HASH_BUCKET_SIZE * sizeof(tuple_id_t));
+		if (iter == NULL) {
+			return INVALID_TUPLE;
+		}
+		iter->key = max;
+		iter->count = 0;
+		iter->next = 0;
+		iter->capacity = HASH_BUCKET_SIZE;
+		iterator->opaque_data = iter;
+	}
+
+	pthread_mutex_lock(&hash->lock);
+
+	if (iterator->next_item_no == 0 && DB_ERROR(hash_lookup(hash, iterator, db_value_to_long(&iterator->min_value)))) {
+		goto out;
+	}
+
+	iter = (hash_iter_t *)iterator->opaque_data;
+	while (iter->next >= iter->count) {
+		if (iter->key >= max) {
+			goto out;
+		}
+		if (DB_ERROR(hash_lookup(hash, iterator, iter->key + 1))) {
+			goto out;
+		}
+		iter = (hash_iter_t *)iterator->opaque_data;
+	}
+
+	tuple_id = iter->tuple_ids[iter->next++];
+	iterator->next_item_no++;
+	iterator->found_items++;
+
+out:
+	pthread_mutex_unlock(&hash->lock);
+	return tuple_id;
+}
@@ -66,7 +66,7 @@
 #include "result.h"
 #include "storage.h"
 #include "db_debug.h"
-
+#include "snapshot.h"
 
 /****************************************************************************
 * Private Function Prototypes
@@ -87,6 +87,12 @@ struct search_handle {
 
 struct search_handle handle;
 
+/* The tuple range an iterator walks, kept in its opaque_data */
+struct search_range {
+	tuple_id_t start;
+	tuple_id_t end;
+};
+
 /*
  * The create, destroy, load, release, insert, and delete operations
  * of the index API always succeed because the index does not store
@@ -103,43 +109,56 @@ index_api_t index_inline = {
 	null_op,
 	insert,
 	delete,
-	get_next
+	get_next,
+	NULL
 };
 
 /****************************************************************************
 * Private Functions
 ****************************************************************************/
-static attribute_value_t *get_value(tuple_id_t *index, relation_t *rel, attribute_t *attr)
+static attribute_value_t *get_value(index_iterator_t *index_iterator, tuple_id_t *index, attribute_value_t *value)
 {
+	relation_t *rel;
+	attribute_t *attr;
+	db_result_t result;
+
+	rel = index_iterator->index->rel;
+	attr = index_iterator->index->attr;
+
 	unsigned char row[rel->row_length];
-	static attribute_value_t value;
 
-	if (DB_ERROR(storage_get_row(rel, index, row))) {
+	if (index_iterator->snapshot != NULL) {
+		result = snapshot_get_row(index_iterator->snapshot, *index, row);
+	} else {
+		result = storage_get_row(rel, index, row);
+	}
+	if (result != DB_OK) {
 		return NULL;
 	}
 
-	if (DB_ERROR(relation_get_value(rel, attr, row, &value))) {
+	if (DB_ERROR(relation_get_value(rel, attr, row, value))) {
 		DB_LOG_E("DB: Unable to retrieve a value from tuple %ld\n", (long)(*index));
 		return NULL;
 	}
 
-	return &value;
+	return value;
 }
 
 static tuple_id_t binary_search(index_iterator_t *index_iterator, attribute_value_t *target_value, int exact_match)
 {
-	relation_t *rel;
-	attribute_t *attr;
+	attribute_value_t value;
 	attribute_value_t *cmp_value;
 	tuple_id_t min;
 	tuple_id_t max;
 	tuple_id_t center;
 
-	rel = index_iterator->index->rel;
-	attr = index_iterator->index->attr;
-
-	max = relation_cardinality(rel);
-	if (max == INVALID_TUPLE) {
+	if (index_iterator->snapshot != NULL) {
+		/* Tuples appended since the query started are not searched */
+		max = index_iterator->snapshot->rows;
+	} else {
+		max = relation_cardinality(index_iterator->index->rel);
+	}
+	if (max == INVALID_TUPLE || max == 0) {
 		return INVALID_TUPLE;
 	}
 	max--;
@@ -148,7 +167,7 @@ static tuple_id_t binary_search(index_iterator_t *index_iterator, attribute_valu
 	do {
 		center = min + ((max - min) / 2);
 
-		cmp_value = get_value(&center, rel, attr);
+		cmp_value = get_value(index_iterator, &center, &value);
 		if (cmp_value == NULL) {
 			DB_LOG_E("DB: Failed to get the center value, index = %ld\n", (long)center);
 			return INVALID_TUPLE;
@@ -156,6 +175,9 @@ static tuple_id_t binary_search(index_iterator_t *index_iterator, attribute_valu
 
 		if (db_value_to_long(target_value) > db_value_to_long(cmp_value)) {
 			min = center + 1;
+		} else if (center == 0) {
+			/* Every tuple is greater than or equal to the target */
+			break;
 		} else {
 			max = center - 1;
 		}
@@ -213,25 +235,36 @@ static db_result_t delete(index_t *index, attribute_value_t *value)
 
 static tuple_id_t get_next(index_iterator_t *iterator, uint8_t inverse_condition)
 {
-	static tuple_id_t cached_start;
-	static tuple_id_t cached_end;
+	struct search_range *range;
 
 	if (iterator->next_item_no == 0) {
 		/*
 		 * We conduct the actual index search when the caller attempts to
 		 * access the first item in the iteration. The first and last tuple
-		 * id:s of the result get cached for subsequent iterations.
+		 * id:s of the result get cached in the iterator for subsequent
+		 * iterations, so concurrent queries do not share them.
 		 */
-		if (DB_ERROR(range_search(iterator, &cached_start, &cached_end))) {
-			cached_start = 0;
-			cached_end = 0;
+		range = (struct search_range *)iterator->opaque_data;
+		if (range == NULL) {
+			range = (struct search_range *)malloc(sizeof(struct search_range));
+			if (range == NULL) {
+				return INVALID_TUPLE;
+			}
+			iterator->opaque_data = range;
+		}
+		if (DB_ERROR(range_search(iterator, &range->start, &range->end))) {
+			range->start = 0;
+			range->end = 0;
 			return INVALID_TUPLE;
 		}
-		DB_LOG_D("DB: Cached the tuple range (%ld,%ld)\n", (long)cached_start, (long)cached_end);
+		DB_LOG_D("DB: Cached the tuple range (%ld,%ld)\n", (long)range->start, (long)range->end);
 		++iterator->next_item_no;
-		return cached_start;
-	} else if (cached_start + iterator->next_item_no <= cached_end) {
-		return cached_start + iterator->next_item_no++;
+		return range->start;
+	}
+
+	range = (struct search_range *)iterator->opaque_data;
+	if (range->start + iterator->next_item_no <= range->end) {
+		return range->start + iterator->next_item_no++;
 	}
 
 	return INVALID_TUPLE;
@@ -72,7 +72,9 @@
 * Private Types
 ****************************************************************************/
 static index_api_t *index_components[] = { &index_inline,
-										   &index_bplustree
+										   &index_bplustree,
+										   &index_btree,
+										   &index_hash
 										 };
 
 pthread_attr_t g_attr;
@@ -365,6 +367,8 @@ db_result_t index_get_iterator(index_iterator_t *iterator, index_t *index, attri
 	iterator->min_value = *min_value;
 	iterator->max_value = *max_value;
 	iterator->next_item_no = 0;
+	iterator->snapshot = NULL;
+	iterator->opaque_data = NULL;
 
 	DB_LOG_D("DB: Acquired an index iterator for %s.%s over the range (%ld,%ld)\n", index->rel->name, index->attr->name, min_value->u.long_value, max_value->u.long_value);
 
@@ -399,6 +403,15 @@ tuple_id_t index_get_next(index_iterator_t *iterator, uint8_t matched_condition)
 	return iterator->index->api->get_next(iterator, matched_condition);
 }
 
+/* Frees the iteration state an index kept in the iterator */
+void index_release_iterator(index_iterator_t *iterator)
+{
+	if (iterator->opaque_data != NULL) {
+		free(iterator->opaque_data);
+		iterator->opaque_data = NULL;
+	}
+}
+
 /****************************************************************************
 * Private Functions
 ****************************************************************************/
@@ -477,15 +490,14 @@ db_result_t db_indexing(relation_t *rel)
 	cardinality = relation_cardinality(rel);
 
 	for (tuple_id = 0; tuple_id < cardinality; tuple_id++) {
-		memset(row, 0, sizeof(row));
+		memset(row, 0, rel->row_length);
 		result = storage_get_row(rel, &tuple_id, row);
 		if (DB_ERROR(result)) {
 			DB_LOG_E("DB: Failed to get a row in relation %s!\n", rel->name);
 			goto errout;
 		}
 
-		row += offset;
-		result = db_phy_to_value(&value, index->attr, row);
+		result = db_phy_to_value(&value, index->attr, row + offset);
 		if (DB_ERROR(result)) {
 			DB_LOG_E("DB: Failed to get value from row\n");
 			goto errout;
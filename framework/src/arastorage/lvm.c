@@ -284,6 +284,11 @@ void lvm_reset(lvm_instance_t *p)
 	memset(p->derivations, 0, sizeof(p->derivations));
 }
 
+void lvm_clone(lvm_instance_t *dst, lvm_instance_t *src)
+{
+	memcpy(dst, src, sizeof(*dst));
+}
+
 lvm_ip_t lvm_jump_to_operand(lvm_instance_t *p)
 {
 	lvm_ip_t old_end;
@@ -461,6 +466,46 @@ void lvm_set_variable(lvm_instance_t *p, char *name)
 	}
 }
 
+void lvm_set_parameter(lvm_instance_t *p, long param)
+{
+	operand_t op;
+
+	op.type = LVM_PARAMETER;
+	op.value.l = param;
+
+	lvm_set_operand(p, &op);
+}
+
+/* Turns every placeholder of parameter param into the constant l. */
+lvm_status_t lvm_bind_long(lvm_instance_t *p, long param, long l)
+{
+	lvm_status_t status;
+	node_type_t type;
+	operand_t operand;
+	lvm_ip_t ip;
+
+	status = INVALID_IDENTIFIER;
+	ip = 0;
+	while (ip < p->end) {
+		memcpy(&type, p->code + ip, sizeof(type));
+		ip += sizeof(type);
+		if (type != LVM_OPERAND) {
+			ip += sizeof(operator_t);
+			continue;
+		}
+		memcpy(&operand, p->code + ip, sizeof(operand));
+		if (operand.type == LVM_PARAMETER && operand.value.l == param) {
+			operand.type = LVM_LONG;
+			operand.value.l = l;
+			memcpy(p->code + ip, &operand, sizeof(operand));
+			status = LVM_TRUE;
+		}
+		ip += sizeof(operand);
+	}
+
+	return status;
+}
+
 static void create_intersection(derivation_t *result, derivation_t *d1, derivation_t *d2)
 {
 	int i;
@@ -715,6 +760,9 @@ static lvm_ip_t print_operand(lvm_instance_t *p, lvm_ip_t index)
 	case LVM_LONG:
 		DB_LOG_D("long:%ld ", operand.value.l);
 		break;
+	case LVM_PARAMETER:
+		DB_LOG_D("param:%ld ", operand.value.l);
+		break;
 	default:
 		DB_LOG_D("?? ");
 		break;
@@ -118,7 +118,8 @@ typedef enum lvm_operator_e operator_t;
 enum operand_type_e {
 	LVM_VARIABLE,
 	LVM_FLOAT,
-	LVM_LONG
+	LVM_LONG,
+	LVM_PARAMETER				/* Placeholder of a prepared statement, value.l is its number */
 };
 typedef enum operand_type_e operand_type_t;
 
@@ -184,5 +185,7 @@ void lvm_set_operand(lvm_instance_t *p, operand_t *op);
 void lvm_set_operand_value(lvm_instance_t *p, attribute_t *attr, unsigned char *value);
 void lvm_set_long(lvm_instance_t *p, long l);
 void lvm_set_variable(lvm_instance_t *p, char *name);
+void lvm_set_parameter(lvm_instance_t *p, long param);
+lvm_status_t lvm_bind_long(lvm_instance_t *p, long param, long l);
 
 #endif							/* LVM_H */
@@ -57,6 +57,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include <fcntl.h>
 #include <tinyara/config.h>
 #include <sys/types.h>
 
@@ -69,6 +70,8 @@
 #include "memb.h"
 #include "aql.h"
 #include "relation.h"
+#include "random.h"
+#include "snapshot.h"
 
 /****************************************************************************
 * Global Function Prototypes
@@ -195,6 +198,7 @@ static void relation_free(relation_t *rel)
 		}
 	} while (attr != NULL);
 
+	snapshot_free(rel);
 	list_remove(relations, rel);
 	memb_free(&relations_memb, rel);
 }
@@ -244,13 +248,20 @@ relation_t *relation_load(char *name)
 		return NULL;
 	}
 
+	if (DB_ERROR(snapshot_load(rel))) {
+		snapshot_free(rel);
+		memb_free(&relations_memb, rel);
+		return NULL;
+	}
+
 	memcpy(rel->name, name, sizeof(rel->name));
 	rel->name[sizeof(rel->name) - 1] = '\0';
 	rel->references = 1;
 	list_add(relations, rel);
 
 end:
-	if (rel->dir == DB_STORAGE && DB_ERROR(storage_load(rel))) {
+	/* Later references share the descriptor opened by the first one */
+	if (rel->dir != DB_MEMORY && rel->tuple_storage < 0 && DB_ERROR(storage_load(rel))) {
 		relation_release(rel);
 		return NULL;
 	}
@@ -273,11 +284,15 @@ db_result_t relation_release(relation_t *rel)
 		if (DB_ERROR(res)) {
 			return res;
 		}
+		if (rel->dir == DB_MEMORY) {
+			/* Nothing can load an in-memory relation again. */
+			relation_free(rel);
+		}
 	}
 	return DB_OK;
 }
 
-relation_t *relation_create(char *name, db_direction_t dir)
+relation_t *relation_create(char *name, db_direction_t dir, db_layout_t layout)
 {
 	relation_t old_rel;
 	relation_t *rel;
@@ -300,8 +315,14 @@ relation_t *relation_create(char *name, db_direction_t dir)
 
 		rel->name[sizeof(rel->name) - 1] = '\0';
 		rel->dir = dir;
-		if (dir == DB_STORAGE) {
+		if (dir != DB_MEMORY) {
 			storage_drop_relation(rel, 1);
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+			if (layout == DB_LAYOUT_COLUMN && DB_ERROR(storage_column_generate(rel->tuple_filename))) {
+				memb_free(&relations_memb, rel);
+				return NULL;
+			}
+#endif
 			if (storage_put_relation(rel) == DB_OK) {
 				list_add(relations, rel);
 				return rel;
@@ -421,6 +442,7 @@ db_result_t relation_set_primary_key(relation_t *rel, char *name)
 db_result_t relation_remove(char *name, int remove_tuples)
 {
 	relation_t *rel;
+	attribute_t *attr;
 	db_result_t result;
 
 	rel = relation_load(name);
@@ -437,11 +459,204 @@ db_result_t relation_remove(char *name, int remove_tuples)
 		return DB_BUSY_ERROR;
 	}
 
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* Logged rows must not be replayed into a later relation of the same name */
+	storage_wal_checkpoint(true);
+#endif
+	if (remove_tuples) {
+		snapshot_drop(rel);
+		/* A later relation of the same name must not find these indexes */
+		for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+			if (attr->index == NULL) {
+				index_load(rel, attr);
+			}
+			if (attr->index != NULL && DB_ERROR(index_destroy(attr->index))) {
+				DB_LOG_E("DB: Failed to remove the index of %s.%s\n", rel->name, attr->name);
+			}
+		}
+	}
 	result = storage_drop_relation(rel, remove_tuples);
 	relation_free(rel);
 	return result;
 }
 
+/* Copies the tuples of rel left after its removals to a new tuple file, in order */
+static db_result_t relation_compact(relation_t *rel)
+{
+	char tuple_path[TUPLE_NAME_LENGTH + 1];
+	relation_t old_rel;
+	storage_row_t row;
+	tuple_id_t tuple_id;
+	tuple_id_t cardinality;
+	db_result_t result;
+	int fd;
+
+	cardinality = relation_cardinality(rel);
+	if (cardinality == INVALID_TUPLE) {
+		return DB_STORAGE_ERROR;
+	}
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		result = storage_column_generate(tuple_path);
+	} else {
+		storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
+		result = storage_generate_file(tuple_path);
+	}
+#else
+	storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
+	result = storage_generate_file(tuple_path);
+#endif
+	if (DB_ERROR(result)) {
+		return DB_STORAGE_ERROR;
+	}
+
+	row = (storage_row_t)malloc(sizeof(char) * rel->row_length + 1);
+	if (row == NULL) {
+		storage_remove(tuple_path);
+		return DB_ALLOCATION_ERROR;
+	}
+
+	memcpy(&old_rel, rel, sizeof(relation_t));
+	strlcpy(rel->tuple_filename, tuple_path, sizeof(rel->tuple_filename));
+	rel->cardinality = 0;
+	rel->next_row = 0;
+	result = storage_load(rel);
+
+	for (tuple_id = 0; DB_SUCCESS(result) && tuple_id < cardinality; tuple_id++) {
+		if (snapshot_removed(rel, tuple_id)) {
+			continue;
+		}
+		result = storage_get_row(&old_rel, &tuple_id, row);
+		if (result == DB_OK) {
+			result = storage_put_row(rel, row, FALSE);
+		}
+	}
+	free(row);
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	if (DB_SUCCESS(result)) {
+		result = storage_flush_insert_buffer();
+	}
+#endif
+
+	if (DB_SUCCESS(result)) {
+		/* The relation file names the new tuple file from now on */
+		fd = storage_open_relation(rel, O_WRONLY);
+		if (fd < 0) {
+			result = DB_STORAGE_ERROR;
+		} else {
+			result = storage_write_to(fd, rel->tuple_filename, 0, sizeof(rel->tuple_filename));
+			storage_close(fd);
+		}
+	}
+
+	if (DB_ERROR(result)) {
+		DB_LOG_E("DB: Failed to compact relation %s\n", rel->name);
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+		storage_write_buffer_clean();
+#endif
+		storage_unload(rel);
+		storage_remove(tuple_path);
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+		if (RELATION_IS_COLUMNAR(rel)) {
+			storage_column_drop(tuple_path);
+		}
+#endif
+		memcpy(rel, &old_rel, sizeof(relation_t));
+		return result;
+	}
+
+	/* Drop the file which is not used any more */
+	storage_close(old_rel.tuple_storage);
+	storage_remove(old_rel.tuple_filename);
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(&old_rel)) {
+		storage_column_drop(old_rel.tuple_filename);
+	}
+#endif
+	return DB_OK;
+}
+
+/*
+ * Reclaims the space of the tuples removed from rel and drops their
+ * version records. A B+-tree index compacts the tuple file through its
+ * vacuum operation, which keeps its entries valid; otherwise the tuples
+ * keep their order, which inline indexes rely on. The other indexes are
+ * built again. The caller holds the catalog lock, and no snapshot of rel
+ * is open.
+ */
+db_result_t relation_vacuum(relation_t *rel)
+{
+	char old_filename[TUPLE_NAME_LENGTH + 1];
+	attribute_t *attr;
+	index_t *index;
+	index_t *compactor;
+	index_type_t type;
+	db_result_t result;
+	bool ordered;
+
+	if (rel->version_count == 0 || !RELATION_HAS_TUPLES(rel)) {
+		return DB_OK;
+	}
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* Logged tuple ids refer to the tuple file which is about to be replaced */
+	storage_wal_checkpoint(true);
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	if (DB_ERROR(storage_flush_insert_buffer())) {
+		return DB_STORAGE_ERROR;
+	}
+#endif
+
+	compactor = NULL;
+	ordered = false;
+	for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+		if (attr->index == NULL) {
+			index_load(rel, attr);
+		}
+		index = (index_t *)attr->index;
+		if (index == NULL) {
+			continue;
+		}
+		if (index->type == INDEX_INLINE) {
+			ordered = true;
+		} else if (compactor == NULL && index->api->vacuum != NULL) {
+			compactor = index;
+		}
+	}
+	if (ordered) {
+		compactor = NULL;
+	}
+
+	memcpy(old_filename, rel->tuple_filename, sizeof(old_filename));
+	if (compactor != NULL) {
+		result = compactor->api->vacuum(compactor);
+	} else {
+		result = relation_compact(rel);
+	}
+	if (DB_ERROR(result)) {
+		return result;
+	}
+	DB_LOG_D("DB: Compacted relation %s to %lu tuples\n", rel->name, (unsigned long)rel->cardinality);
+
+	/* Tuple ids changed, the entries of the other indexes are stale */
+	for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+		index = (index_t *)attr->index;
+		if (index == NULL || index == compactor || index->type == INDEX_INLINE) {
+			continue;
+		}
+		type = index->type;
+		if (DB_ERROR(index_destroy(index)) || DB_ERROR(index_create(type, rel, attr))) {
+			DB_LOG_E("DB: Failed to rebuild the index of %s.%s\n", rel->name, attr->name);
+			result = DB_INDEX_ERROR;
+		}
+	}
+
+	snapshot_forget(rel, old_filename);
+	return result;
+}
+
 db_result_t relation_insert(relation_t *rel, attribute_value_t *values)
 {
 	attribute_t *attr;
@@ -449,6 +664,9 @@ db_result_t relation_insert(relation_t *rel, attribute_value_t *values)
 	unsigned char *ptr;
 	attribute_value_t *value;
 	db_result_t result;
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	tuple_id_t tuple_id;
+#endif
 
 	value = values;
 
@@ -512,8 +730,114 @@ db_result_t relation_insert(relation_t *rel, attribute_value_t *values)
 
 	DB_LOG_V(")\n");
 
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	/* Only a stored row is logged, a failed insert must not come back on replay */
+	tuple_id = relation_cardinality(rel);
+	result = storage_put_row(rel, record, FALSE);
+	if (DB_SUCCESS(result) && DB_ERROR(storage_wal_append(rel, tuple_id, record))) {
+		result = DB_STORAGE_ERROR;
+	}
+	if (DB_SUCCESS(result)) {
+		result = storage_wal_checkpoint(false);
+	}
+	return result;
+#else
 	return storage_put_row(rel, record, FALSE);
+#endif
+}
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+/*
+ * Stores a row recovered from the write-ahead log at its place in the
+ * tuple file. Index updates are not logged, so the indexes of the
+ * relation are rebuilt with relation_reindex() once the log is replayed.
+ */
+db_result_t relation_replay(char *name, tuple_id_t tuple_id, unsigned char *row, unsigned length)
+{
+	relation_t *rel;
+	tuple_id_t cardinality;
+	db_result_t result = DB_OK;
+
+	rel = relation_load(name);
+	if (rel == NULL) {
+		/* The relation was removed after the row was logged. */
+		return DB_OK;
+	}
+
+	cardinality = relation_cardinality(rel);
+	if (length != rel->row_length || cardinality == INVALID_TUPLE || tuple_id > cardinality) {
+		DB_LOG_E("DB: Logged row %lu does not fit relation %s\n", (unsigned long)tuple_id, name);
+		result = DB_STORAGE_ERROR;
+		goto end;
+	}
+
+	/*
+	 * A row below the cardinality is written again: the pages of the tuple
+	 * file are written back in any order, so a later page may have reached
+	 * the file before the page of this row did.
+	 */
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		if (tuple_id < cardinality) {
+			/* Columns are only appended; the row was written back before the power cut. */
+			goto end;
+		}
+		result = storage_column_put_row(rel, row);
+	} else {
+		result = storage_write_to(rel->tuple_storage, row, tuple_id * rel->row_length, length);
+	}
+#else
+	result = storage_write_to(rel->tuple_storage, row, tuple_id * rel->row_length, length);
+#endif
+	if (DB_ERROR(result) || tuple_id < cardinality) {
+		goto end;
+	}
+	rel->cardinality++;
+	rel->next_row = rel->cardinality;
+
+end:
+	relation_release(rel);
+	return result;
+}
+
+/*
+ * Rebuilds the indexes of a relation from its tuples. The index pages
+ * written back before a power cut may miss replayed rows, or hold rows
+ * which never reached the tuple file.
+ */
+db_result_t relation_reindex(char *name)
+{
+	relation_t *rel;
+	attribute_t *attr;
+	index_t *index;
+	index_type_t type;
+	db_result_t result = DB_OK;
+
+	rel = relation_load(name);
+	if (rel == NULL) {
+		return DB_OK;
+	}
+
+	for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+		if (attr->index == NULL) {
+			index_load(rel, attr);
+		}
+		index = (index_t *)attr->index;
+		if (index == NULL || index->type == INDEX_INLINE) {
+			/* An inline index is the tuple file itself */
+			continue;
+		}
+		type = index->type;
+		if (DB_ERROR(index_destroy(index)) || DB_ERROR(index_create(type, rel, attr))) {
+			DB_LOG_E("DB: Failed to rebuild the index of %s.%s\n", rel->name, attr->name);
+			result = DB_INDEX_ERROR;
+		}
+	}
+
+	relation_release(rel);
+	return result;
 }
+#endif
 
 /*
  * Update aggregation value whenever each tuple is read.
@@ -612,6 +936,35 @@ static db_result_t generate_attribute_map(source_dest_map_t *attr_map, unsigned
 	return DB_OK;
 }
 
+/*
+ * Reads the current tuple of a query from its snapshot. Only the
+ * attributes the query uses are read from a columnar relation, so a scan
+ * never decodes the other columns; the rest of the row is left unset.
+ */
+static db_result_t relation_get_row(db_handle_t *handle, storage_row_t row)
+{
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	source_dest_map_t *attr_map_ptr;
+	source_dest_map_t *attr_map_end;
+	db_result_t result;
+
+	if (handle->tuple_id >= handle->snapshot->rows) {
+		return DB_FINISHED;
+	}
+	if (RELATION_IS_COLUMNAR(handle->rel)) {
+		attr_map_end = handle->attr_map + handle->result_rel->attribute_count;
+		for (attr_map_ptr = handle->attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
+			result = storage_column_read(handle->rel->tuple_filename, handle->snapshot->tuple_storage, handle->rel->row_length, attr_map_ptr->from_offset, attr_map_ptr->from_attr->element_size, handle->tuple_id, row + attr_map_ptr->from_offset);
+			if (result != DB_OK) {
+				return result;
+			}
+		}
+		return DB_OK;
+	}
+#endif
+	return snapshot_get_row(handle->snapshot, handle->tuple_id, row);
+}
+
 static void select_index(db_handle_t **handle)
 {
 	index_t *index;
@@ -645,6 +998,7 @@ static void select_index(db_handle_t **handle)
 	if (index != NULL) {
 		/* We found a suitable index; get an iterator for it. */
 		if (index_get_iterator(&((*handle)->index_iterator), index, &av_min, &av_max) == DB_OK) {
+			(*handle)->index_iterator.snapshot = (*handle)->snapshot;
 			(*handle)->flags |= DB_HANDLE_FLAG_SEARCH_INDEX;
 		}
 	} else {
@@ -652,29 +1006,6 @@ static void select_index(db_handle_t **handle)
 	}
 }
 
-static void relation_index_clear(relation_t *rel)
-{
-	char *filename;
-	attribute_t *attr_ptr;
-	int len;
-
-	len = strlen(rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
-	filename = (char *)malloc(sizeof(char) * len);
-	if (filename == NULL) {
-		return;
-	}
-	snprintf(filename, len, "%s%s\0", rel->name, INDEX_NAME_SUFFIX);
-	storage_remove(filename);
-	attr_ptr = list_head(rel->attributes);
-	while (attr_ptr != NULL) {
-		if (attr_ptr->index != NULL) {
-			attr_ptr->index = NULL;
-		}
-		attr_ptr = attr_ptr->next;
-	}
-	free(filename);
-}
-
 static db_result_t generate_selection_result(db_handle_t **handle, relation_t *rel)
 {
 	relation_t *result_rel;
@@ -778,6 +1109,11 @@ db_result_t relation_process_select(db_handle_t **handle, db_cursor_t *cursor)
 	attribute_count = (*handle)->result_rel->attribute_count;
 	attr_map_end = (*handle)->attr_map + attribute_count;
 
+	if ((*handle)->limit > 0 && (*handle)->current_row >= (*handle)->limit && !((*handle)->adt_flags & AQL_FLAG_AGGREGATE)) {
+		/* LIMIT reached, the remaining tuples are never read. */
+		return DB_FINISHED;
+	}
+
 	if ((*handle)->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
 		(*handle)->tuple_id = index_get_next(&((*handle)->index_iterator), TRUE);
 		if ((*handle)->tuple_id == INVALID_TUPLE) {
@@ -795,6 +1131,13 @@ db_result_t relation_process_select(db_handle_t **handle, db_cursor_t *cursor)
 		(*handle)->tuple_id++;
 	}
 
+	if (!snapshot_visible((*handle)->snapshot, (*handle)->tuple_id)) {
+		if (((*handle)->flags & DB_HANDLE_FLAG_SEARCH_INDEX) || (*handle)->tuple_id < (*handle)->snapshot->rows) {
+			/* Stored after or removed before the query started */
+			return DB_OK;
+		}
+	}
+
 	row = (storage_row_t)malloc(sizeof(char) * (*handle)->rel->row_length + 1);
 	if (row == NULL) {
 		DB_LOG_E("DB: Failed to allocate row\n");
@@ -803,7 +1146,7 @@ db_result_t relation_process_select(db_handle_t **handle, db_cursor_t *cursor)
 
 	/* Put the tuples fulfilling the- given condition into a new relation.
 	   The tuples may be projected. */
-	result = storage_get_row((*handle)->rel, &((*handle)->tuple_id), row);
+	result = relation_get_row(*handle, row);
 	if (DB_ERROR(result)) {
 		DB_LOG_E("DB: Failed to get a row in relation %s!\n", (*handle)->rel->name);
 		goto errout;
@@ -822,7 +1165,7 @@ db_result_t relation_process_select(db_handle_t **handle, db_cursor_t *cursor)
 		from_ptr = row + attr_map_ptr->from_offset;
 		from_attr = attr_map_ptr->from_attr;
 
-		if (from_attr->domain == DOMAIN_INT || from_attr->domain == DOMAIN_LONG) {
+		if ((*handle)->lvm_instance != NULL && (from_attr->domain == DOMAIN_INT || from_attr->domain == DOMAIN_LONG)) {
 			lvm_set_operand_value((*handle)->lvm_instance, from_attr, from_ptr);
 		}
 
@@ -855,6 +1198,11 @@ db_result_t relation_process_select(db_handle_t **handle, db_cursor_t *cursor)
 					goto errout;
 				}
 			}
+		} else if ((*handle)->flags & DB_HANDLE_FLAG_STREAM) {
+			/* Hand the tuple to the cursor which asked for it. */
+			cursor->current_storage_row = (*handle)->tuple_id;
+			free(row);
+			return DB_GOT_ROW;
 		} else {
 			result = cursor_data_add(cursor, (*handle)->tuple_id);
 			if (DB_ERROR(result)) {
@@ -880,7 +1228,11 @@ processing_aggregation:
 	}
 
 	/* Copy aggregated result to tuple in cursor */
-	memcpy(cursor->tuple, result_row, sizeof(cursor->tuple));
+	if ((*handle)->result_rel->row_length > sizeof(cursor->tuple)) {
+		result = DB_LIMIT_ERROR;
+		goto errout;
+	}
+	memcpy(cursor->tuple, result_row, (*handle)->result_rel->row_length);
 
 	(*handle)->current_row = 0;
 	(*handle)->adt_flags &= ~AQL_FLAG_AGGREGATE; /* Stop the aggregation. */
@@ -904,46 +1256,56 @@ errout:
 	return result;
 }
 
+/*
+ * Removes the tuples matching the condition of a REMOVE query one by one.
+ * A removed tuple stays in the tuple file with a version record, so
+ * queries which started before keep reading it; the removals are
+ * committed together once every tuple was evaluated.
+ */
 db_result_t relation_process_remove(db_handle_t **handle, db_cursor_t *cursor)
 {
 	db_result_t result;
 	unsigned attribute_count;
 	unsigned char *from_ptr;
 	attribute_t *from_attr;
-	index_t *index;
 	storage_row_t row = NULL;
-	tuple_t result_row;
 	source_dest_map_t *attr_map_ptr, *attr_map_end;
-	int i;
+	db_snapshot_t *snapshot;
+	tuple_id_t i;
 
 	if ((*handle)->tuple == NULL) {
 		return DB_ALLOCATION_ERROR;
 	}
 
-	result_row = (*handle)->tuple;
 	attribute_count = (*handle)->result_rel->attribute_count;
 	attr_map_end = (*handle)->attr_map + attribute_count;
 
 	/* Search all tuples sequentially without index. */
 	(*handle)->tuple_id++;
+	if ((*handle)->tuple_id >= (*handle)->snapshot->rows) {
+		goto end_removal;
+	}
+	if (!snapshot_visible((*handle)->snapshot, (*handle)->tuple_id)) {
+		return DB_OK;
+	}
 
 	row = (storage_row_t)malloc(sizeof(char) * (*handle)->rel->row_length + 1);
 	if (row == NULL) {
 		DB_LOG_E("DB: Failed to allocate row\n");
-		return DB_ALLOCATION_ERROR;
+		result = DB_ALLOCATION_ERROR;
+		goto errout;
 	}
 
-	/* Put the tuples fulfilling the- given condition into a new relation.
-	   The tuples may be projected. */
-	result = storage_get_row((*handle)->rel, &((*handle)->tuple_id), row);
+	result = relation_get_row(*handle, row);
 	if (DB_ERROR(result)) {
 		DB_LOG_E("DB: Failed to get a row in relation %s!\n", (*handle)->rel->name);
 		goto errout;
 	} else if (result == DB_FINISHED) {
+		free(row);
 		goto end_removal;
 	}
 
-	/* Process the attributes in the result relation. */
+	/* Evaluate the condition for this tuple. */
 	for (attr_map_ptr = (*handle)->attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
 		from_ptr = row + attr_map_ptr->from_offset;
 		from_attr = attr_map_ptr->from_attr;
@@ -951,91 +1313,59 @@ db_result_t relation_process_remove(db_handle_t **handle, db_cursor_t *cursor)
 		if (from_attr->domain == DOMAIN_INT || from_attr->domain == DOMAIN_LONG) {
 			lvm_set_operand_value((*handle)->lvm_instance, from_attr, from_ptr);
 		}
-
-		if (from_attr->flags & ATTRIBUTE_FLAG_NO_STORE) {
-			/* The attribute is used just for the predicate,
-			   so do not copy the current value into the result. */
-			continue;
-		}
-
-		memcpy(result_row + attr_map_ptr->to_offset, from_ptr, from_attr->element_size);
 	}
+	free(row);
 
-	/* Check whether the given predicate is true for this tuple. */
-	if ((*handle)->lvm_instance == NULL || lvm_execute((*handle)->lvm_instance) == FALSE) {
-		result = storage_put_row((*handle)->result_rel, result_row, TRUE);
+	if ((*handle)->lvm_instance != NULL && lvm_execute((*handle)->lvm_instance) == TRUE) {
+		result = snapshot_remove((*handle)->rel, (*handle)->tuple_id);
 		if (DB_ERROR(result)) {
-			DB_LOG_E("DB: Failed to store a row in the result relation!\n");
+			DB_LOG_E("DB: Failed to remove tuple %lu\n", (unsigned long)(*handle)->tuple_id);
 			goto errout;
 		}
-
 		(*handle)->current_row++;
-		if (row != NULL) {
-			free(row);
-		}
-		return DB_GOT_ROW;
 	}
 
-	if (row != NULL) {
-		free(row);
-	}
 	return DB_OK;
 
 end_removal:
-	DB_LOG_E("DB: Finished removing tuples. Result relation has %d tuples\n", (*handle)->result_rel->cardinality);
-
-#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
-	/* Flush insert buffer to make sure of writing tuples in new relation */
-	if (DB_SUCCESS(storage_flush_insert_buffer())) {
-		DB_LOG_D("DB : flush insert buffer!!\n");
-	}
-#endif
-
-	relation_release((*handle)->rel);
+	DB_LOG_D("DB: Finished removing tuples. %lu tuples were removed\n", (unsigned long)(*handle)->current_row);
 
-	/* Rename the name of new relation to old relation */
-	result = relation_rename((*handle)->result_rel->name, (*handle)->rel->name);
+	result = snapshot_commit((*handle)->rel);
 	if (DB_ERROR(result)) {
-		DB_LOG_E("DB: Failed to rename newly created relation\n");
+		DB_LOG_E("DB: Failed to commit the removal\n");
 		goto errout;
 	}
-	memcpy((*handle)->result_rel->name, (*handle)->rel->name, sizeof((*handle)->result_rel->name));
 
-	/* Destory exsting index for old relation */
-	index = (*handle)->index_iterator.index;
-	if (index != NULL) {
-		index_destroy(index);
-		relation_index_clear((*handle)->result_rel);
+	/* Reclaim the space right away unless another query still reads the tuples */
+	snapshot_close((*handle)->snapshot);
+	(*handle)->snapshot = NULL;
+	if (snapshot_collectable((*handle)->rel) && DB_ERROR(relation_vacuum((*handle)->rel))) {
+		DB_LOG_E("DB: Failed to vacuum relation %s\n", (*handle)->rel->name);
 	}
 
-	/* Process finished, we allocate cursor for result of remove */
-	if (DB_ERROR(cursor_init(&cursor, (*handle)->result_rel)) || DB_ERROR(cursor_data_set(cursor, (*handle)->attr_map, (*handle)->result_rel->attribute_count))) {
+	/* Process finished, we allocate cursor for the remaining tuples */
+	snapshot = snapshot_open((*handle)->rel);
+	if (snapshot == NULL) {
+		return DB_STORAGE_ERROR;
+	}
+	if (DB_ERROR(cursor_init(&cursor, (*handle)->rel, snapshot->rows)) || DB_ERROR(cursor_data_set(cursor, (*handle)->attr_map, (*handle)->result_rel->attribute_count))) {
 		DB_LOG_E("DB: Failed to init cursor and set cursor data\n");
-		goto errout;
+		snapshot_close(snapshot);
+		return DB_CURSOR_ERROR;
 	}
+	cursor->snapshot = snapshot;
 
-	/* Add cursor tuple data to new relation created by remove operation for update. */
-	for (i = 0; i < (*handle)->result_rel->cardinality; i++) {
-		if (DB_ERROR(cursor_data_add(cursor, i))) {
-			DB_LOG_E("DB: Failed to add cursor tuple data into new relation\n");
-			goto errout;
+	for (i = 0; i < snapshot->rows; i++) {
+		if (snapshot_visible(snapshot, i) && DB_ERROR(cursor_data_add(cursor, i))) {
+			DB_LOG_E("DB: Failed to add cursor tuple data of the relation\n");
+			return DB_CURSOR_ERROR;
 		}
 	}
 
-	if (row != NULL) {
-		free(row);
-	}
-
 	return DB_FINISHED;
 
 errout:
-#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
-	storage_write_buffer_clean();
-#endif
-
-	if (row != NULL) {
-		free(row);
-	}
+	snapshot_abort((*handle)->rel);
 
 	return result;
 }
@@ -1044,6 +1374,7 @@ db_cursor_t *relation_process_result(db_handle_t *handler)
 {
 	db_result_t res;
 	db_cursor_t *cursor;
+	bool keep_snapshot;
 
 	cursor = (db_cursor_t *)malloc(sizeof(db_cursor_t));
 	if (cursor == NULL) {
@@ -1054,13 +1385,25 @@ db_cursor_t *relation_process_result(db_handle_t *handler)
 
 	/* when SELECT, cursor row data is set in processing tuple by tuple.
 	   So we need to initialize cursor and make cursor data before processing tuples */
+	if (handler->flags & DB_HANDLE_FLAG_STREAM) {
+		/* Tuples are evaluated later, as the application moves the cursor. */
+		if (DB_ERROR(cursor_stream_init(cursor, handler))) {
+			DB_LOG_E("DB: Failed to init streaming cursor\n");
+			cursor_deinit(cursor);
+			return NULL;
+		}
+		return cursor;
+	}
+
 	if (handler->optype == AQL_TYPE_SELECT) {
-		if (DB_ERROR(cursor_init(&cursor, handler->rel)) || DB_ERROR(cursor_data_set(cursor, handler->attr_map, handler->result_rel->attribute_count))) {
+		if (DB_ERROR(cursor_init(&cursor, handler->rel, handler->snapshot->rows)) || DB_ERROR(cursor_data_set(cursor, handler->attr_map, handler->result_rel->attribute_count))) {
 			DB_LOG_E("DB: Failed to init cursor and set cursor data\n");
 			cursor_deinit(cursor);
 			return NULL;
 		}
 	}
+	/* The rows are read after the query ends, from the same snapshot */
+	keep_snapshot = handler->optype == AQL_TYPE_SELECT && !(handler->adt_flags & AQL_FLAG_AGGREGATE);
 
 	res = DB_ARGUMENT_ERROR;
 	while (db_processing_status(handler)) {
@@ -1073,6 +1416,10 @@ db_cursor_t *relation_process_result(db_handle_t *handler)
 		switch (res) {
 		case DB_FINISHED:
 			DB_LOG_V("DB: Processing tuples is done!\n");
+			if (keep_snapshot) {
+				cursor->snapshot = handler->snapshot;
+				handler->snapshot = NULL;
+			}
 			return cursor;
 		case DB_OK:
 			continue;
@@ -1102,18 +1449,29 @@ db_result_t relation_select(db_handle_t **handle, relation_t *rel, void *adt_ptr
 	(*handle)->adt_flags = AQL_GET_FLAGS(adt);
 	(*handle)->lvm_instance = (lvm_instance_t *)adt->lvm_instance;
 
+	(*handle)->limit = AQL_GET_LIMIT(adt);
+
 	if (AQL_GET_FLAGS(adt) & AQL_FLAG_ASSIGN) {
 		name = adt->relations[0];
 		dir = DB_STORAGE;
+
+		relation_remove(name, 1);
+		relation_create(name, dir, DB_LAYOUT_ROW);
+		(*handle)->result_rel = relation_load(name);
 	} else {
-		name = RESULT_RELATION;
+		/* A plain SELECT result only describes the projection. It stays
+		   private to this handle, so cursors that are still streaming do
+		   not share it, and it never touches the storage. */
 		dir = DB_MEMORY;
+		(*handle)->result_rel = relation_allocate();
+		if ((*handle)->result_rel != NULL) {
+			(*handle)->result_rel->cardinality = 0;
+			(*handle)->result_rel->dir = dir;
+			(*handle)->result_rel->references = 1;
+			strncpy((*handle)->result_rel->name, RESULT_RELATION, sizeof((*handle)->result_rel->name) - 1);
+		}
 	}
 
-	relation_remove(name, 1);
-	relation_create(name, dir);
-	(*handle)->result_rel = relation_load(name);
-
 	if ((*handle)->result_rel == NULL) {
 		DB_LOG_E("DB: Failed to load a relation for the query result\n");
 		return DB_ALLOCATION_ERROR;
@@ -1186,6 +1544,12 @@ db_result_t relation_select(db_handle_t **handle, relation_t *rel, void *adt_ptr
 		return DB_RELATIONAL_ERROR;
 	}
 
+	(*handle)->snapshot = snapshot_open(rel);
+	if ((*handle)->snapshot == NULL) {
+		DB_LOG_E("DB: Failed to take a snapshot of relation %s\n", rel->name);
+		return DB_STORAGE_ERROR;
+	}
+
 	return generate_selection_result(handle, rel);
 }
 
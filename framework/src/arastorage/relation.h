@@ -59,6 +59,7 @@
  ****************************************************************************/
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <arastorage/arastorage.h>
 #include "db_options.h"
@@ -97,10 +98,14 @@
 #define IS_INVALID_CURSOR_ROW(a) ((a) == NULL || ((a)->current_cursor_row >= (a)->cursor_rows))
 
 /* check current storage row is valid or invalid*/
-#define IS_INVALID_STORAGE_ROW(a) ((a) == NULL || ((a)->current_storage_row >= (a)->total_rows) || (a)->current_storage_row >= DB_CURSOR_RESULT_ENTRY)
+#define IS_INVALID_STORAGE_ROW(a) ((a) == NULL || ((a)->current_storage_row >= (a)->total_rows))
 
 #define RELATION_HAS_TUPLES(rel) ((rel)->tuple_storage >= 0)
 
+/* A columnar relation is told apart by the name of its tuple file */
+#define TUPLE_FILE_IS_COLUMNAR(name) (strncmp((name), COLUMN_FILE_NAME ".", sizeof(COLUMN_FILE_NAME)) == 0)
+#define RELATION_IS_COLUMNAR(rel) TUPLE_FILE_IS_COLUMNAR((rel)->tuple_filename)
+
 /* Specific API will return Below if cursor value is something wrong */
 #define INVALID_CURSOR_VALUE -1
 
@@ -109,16 +114,26 @@
 ****************************************************************************/
 enum db_direction_e {
 	DB_MEMORY = 0,
-	DB_STORAGE = 1
+	DB_STORAGE = 1,
+	DB_VOLATILE = 2				/* Stored like DB_STORAGE, in files kept in RAM */
 };
 typedef enum db_direction_e db_direction_t;
 
+enum db_layout_e {
+	DB_LAYOUT_ROW = 0,
+	DB_LAYOUT_COLUMN = 1
+};
+typedef enum db_layout_e db_layout_t;
+
 enum db_value_type_e {
 	NORMAL_VALUE = 0,
 	AGGREGATE_VALUE = 1
 };
 typedef enum db_value_type_e db_value_type_t;
 
+struct db_version_s;
+struct db_snapshot_s;
+
 /*
  * A relation consists of a name, a set of domains, a set of indexes,
  * and a set of keys. Each relation must have a primary key.
@@ -134,6 +149,9 @@ struct relation_s {
 	db_storage_id_t tuple_storage;
 	db_direction_t dir;
 	uint8_t references;
+	struct db_version_s *versions;	/* Removed tuples, sorted by tuple id */
+	tuple_id_t version_count;
+	tuple_id_t version_limit;
 	char name[RELATION_NAME_LENGTH + 1];
 	char tuple_filename[TUPLE_NAME_LENGTH + 1];
 };
@@ -159,6 +177,8 @@ struct _db_cursor_s {
 	attribute_id_t attribute_count;
 	size_t storage_row_length;
 	uint32_t *row_arr;
+	db_handle_t *handle;		/* Query still being evaluated by a streaming cursor */
+	struct db_snapshot_s *snapshot;	/* The tuples the cursor reads */
 	unsigned char tuple[DB_MAX_ELEMENT_SIZE + 1];
 	char name[TUPLE_NAME_LENGTH + 1];
 	char rel_name[RELATION_NAME_LENGTH + 1];
@@ -169,7 +189,8 @@ struct _db_cursor_s {
  * Internal function prototypes
  ****************************************************************************/
 /* Operations for cursor processing */
-db_result_t cursor_init(db_cursor_t **cursor, relation_t *rel);
+db_result_t cursor_init(db_cursor_t **cursor, relation_t *rel, tuple_id_t rows);
+db_result_t cursor_stream_init(db_cursor_t *cursor, db_handle_t *handle);
 db_result_t cursor_load(db_cursor_t **target, db_cursor_t *src);
 db_result_t cursor_data_add(db_cursor_t *cursor, tuple_id_t tuple_id);
 db_result_t cursor_deinit(db_cursor_t *cursor);
@@ -181,9 +202,10 @@ db_result_t relation_deinit(void);
 db_result_t relation_process_remove(db_handle_t **, db_cursor_t *);
 db_result_t relation_process_select(db_handle_t **, db_cursor_t *);
 db_cursor_t *relation_process_result(db_handle_t *);
+int db_processing_status(db_handle_t *);
 relation_t *relation_load(char *);
 db_result_t relation_release(relation_t *);
-relation_t *relation_create(char *, db_direction_t);
+relation_t *relation_create(char *, db_direction_t, db_layout_t);
 db_result_t relation_rename(char *, char *);
 attribute_t *relation_attribute_add(relation_t *, db_direction_t, char *, domain_t, size_t);
 attribute_t *relation_attribute_get(relation_t *, char *);
@@ -194,5 +216,10 @@ db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
 db_result_t relation_select(db_handle_t **, relation_t *, void *);
 tuple_id_t relation_cardinality(relation_t *);
+db_result_t relation_vacuum(relation_t *);
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+db_result_t relation_replay(char *, tuple_id_t, unsigned char *, unsigned);
+db_result_t relation_reindex(char *);
+#endif
 
 #endif              /* RELATION_H */
@@ -145,7 +145,7 @@ db_result_t db_value_to_phy(unsigned char *ptr, attribute_t *attr, attribute_val
 
 	switch (attr->domain) {
 	case DOMAIN_STRING:
-		memcpy(ptr, VALUE_STRING(value), attr->element_size);
+		strncpy((char *)ptr, (char *)VALUE_STRING(value), attr->element_size);
 		ptr[attr->element_size - 1] = '\0';
 		break;
 	case DOMAIN_INT:
@@ -71,6 +71,7 @@
 #define DB_HANDLE_FLAG_INDEX_STEP       0x01
 #define DB_HANDLE_FLAG_SEARCH_INDEX     0x02
 #define DB_HANDLE_FLAG_PROCESSING       0x04
+#define DB_HANDLE_FLAG_STREAM           0x08
 #define DB_HANDLE_FLAG_INVALID          0x00
 
 /****************************************************************************
@@ -98,6 +99,7 @@ struct _db_handle_s {
 	index_iterator_t index_iterator;
 	tuple_id_t tuple_id;
 	tuple_id_t current_row;
+	tuple_id_t limit;
 	relation_t *rel;
 	relation_t *result_rel;
 	tuple_t tuple;
@@ -107,6 +109,7 @@ struct _db_handle_s {
 	uint8_t ncolumns;
 	void *lvm_instance;
 	source_dest_map_t *attr_map;
+	struct db_snapshot_s *snapshot;
 };
 
 /****************************************************************************
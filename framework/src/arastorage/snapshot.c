@@ -0,0 +1,534 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      Snapshots of relations for readers running beside a writer.
+ *
+ *      Statements which change the catalog or the tuples of a relation
+ *      hold the catalog lock from start to end. A query holds it only
+ *      while it loads the relation and takes a snapshot, and while it
+ *      releases them; the scan in between runs unlocked.
+ *
+ *      Inserted tuples are only ever appended, so a snapshot records the
+ *      number of stored tuples and ignores the ones after it. A removed
+ *      tuple stays where it is and gets a version record naming the
+ *      transaction which removed it. The records of a relation are kept
+ *      in RAM, sorted by tuple id, and appended to "<tuple file>.x" when
+ *      their transaction commits; a record of INVALID_TUPLE ends every
+ *      commit, so a commit cut short by a power cut is ignored.
+ *
+ *      Once enough tuples are removed and no snapshot of the relation is
+ *      open, the next writer compacts the tuple file through
+ *      relation_vacuum() and the version records are dropped with it.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <tinyara/config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "db_options.h"
+#include "db_debug.h"
+#include "relation.h"
+#include "storage.h"
+#include "snapshot.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define VERSION_PENDING     ((db_txn_t)-1)
+#define VERSION_CHUNK       16
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static pthread_mutex_t g_catalog_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Protects the version records, which readers search without the catalog lock */
+static pthread_mutex_t g_version_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The following are only used with the catalog lock held */
+static db_txn_t g_txn;
+static db_snapshot_t *g_snapshots;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static void version_filename(const char *tuple_filename, char *path, size_t size)
+{
+	snprintf(path, size, "%s%s", tuple_filename, VERSION_FILE_SUFFIX);
+}
+
+/* Returns the position of the first record not below tuple_id */
+static tuple_id_t version_find(relation_t *rel, tuple_id_t tuple_id)
+{
+	tuple_id_t low;
+	tuple_id_t high;
+	tuple_id_t center;
+
+	low = 0;
+	high = rel->version_count;
+	while (low < high) {
+		center = low + (high - low) / 2;
+		if (rel->versions[center].tuple_id < tuple_id) {
+			low = center + 1;
+		} else {
+			high = center;
+		}
+	}
+	return low;
+}
+
+static db_result_t version_add(relation_t *rel, tuple_id_t tuple_id, db_txn_t xmax)
+{
+	struct db_version_s *versions;
+	tuple_id_t pos;
+
+	if (rel->version_count == rel->version_limit) {
+		versions = (struct db_version_s *)realloc(rel->versions, (rel->version_limit + VERSION_CHUNK) * sizeof(struct db_version_s));
+		if (versions == NULL) {
+			return DB_ALLOCATION_ERROR;
+		}
+		rel->versions = versions;
+		rel->version_limit += VERSION_CHUNK;
+	}
+
+	pos = version_find(rel, tuple_id);
+	if (pos < rel->version_count && rel->versions[pos].tuple_id == tuple_id) {
+		/* Removed already */
+		return DB_OK;
+	}
+	memmove(&rel->versions[pos + 1], &rel->versions[pos], (rel->version_count - pos) * sizeof(struct db_version_s));
+	rel->versions[pos].tuple_id = tuple_id;
+	rel->versions[pos].xmax = xmax;
+	rel->version_count++;
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+db_result_t snapshot_init(void)
+{
+	g_txn = 0;
+	g_snapshots = NULL;
+	return DB_OK;
+}
+
+void snapshot_deinit(void)
+{
+	/* Snapshots are owned by the cursors the application failed to free */
+	g_snapshots = NULL;
+}
+
+void snapshot_lock(void)
+{
+	pthread_mutex_lock(&g_catalog_lock);
+}
+
+void snapshot_unlock(void)
+{
+	pthread_mutex_unlock(&g_catalog_lock);
+}
+
+/****************************************************************************
+ * Name: snapshot_open
+ *
+ * Description: Takes a snapshot of rel for a query. The snapshot holds a
+ *              reference to rel and a descriptor of its own, so it may be
+ *              read without the catalog lock. The caller holds the lock.
+ *
+ ****************************************************************************/
+db_snapshot_t *snapshot_open(relation_t *rel)
+{
+	db_snapshot_t *snapshot;
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	/* Buffered tuples are counted in the cardinality */
+	if (DB_ERROR(storage_flush_insert_buffer())) {
+		return NULL;
+	}
+#endif
+
+	snapshot = (db_snapshot_t *)malloc(sizeof(db_snapshot_t));
+	if (snapshot == NULL) {
+		return NULL;
+	}
+
+	snapshot->rel = rel;
+	snapshot->txn = g_txn;
+	snapshot->rows = relation_cardinality(rel);
+	snapshot->removed = rel->version_count;
+	snapshot->tuple_storage = INVALID_STORAGE_ID;
+	if (snapshot->rows == INVALID_TUPLE) {
+		free(snapshot);
+		return NULL;
+	}
+
+	if (RELATION_HAS_TUPLES(rel)) {
+		snapshot->tuple_storage = storage_open(rel->tuple_filename, O_RDONLY);
+		if (snapshot->tuple_storage < 0) {
+			DB_LOG_E("DB: Failed to open %s for a snapshot\n", rel->tuple_filename);
+			free(snapshot);
+			return NULL;
+		}
+	} else {
+		snapshot->rows = 0;
+	}
+
+	rel->references++;
+	snapshot->next = g_snapshots;
+	g_snapshots = snapshot;
+	return snapshot;
+}
+
+/* Releases a snapshot. The caller holds the catalog lock. */
+void snapshot_close(db_snapshot_t *snapshot)
+{
+	db_snapshot_t **link;
+
+	if (snapshot == NULL) {
+		return;
+	}
+
+	for (link = &g_snapshots; *link != NULL; link = &(*link)->next) {
+		if (*link == snapshot) {
+			*link = snapshot->next;
+			break;
+		}
+	}
+
+	if (snapshot->tuple_storage >= 0) {
+		storage_close(snapshot->tuple_storage);
+	}
+	relation_release(snapshot->rel);
+	free(snapshot);
+}
+
+/****************************************************************************
+ * Name: snapshot_visible
+ *
+ * Description: Tells whether tuple_id was stored and not removed when the
+ *              snapshot was taken.
+ *
+ ****************************************************************************/
+bool snapshot_visible(db_snapshot_t *snapshot, tuple_id_t tuple_id)
+{
+	relation_t *rel;
+	tuple_id_t pos;
+	bool visible;
+
+	if (tuple_id >= snapshot->rows) {
+		return false;
+	}
+	if (snapshot->removed == 0) {
+		/* Records added since are all newer than the snapshot */
+		return true;
+	}
+
+	rel = snapshot->rel;
+	pthread_mutex_lock(&g_version_lock);
+	pos = version_find(rel, tuple_id);
+	visible = pos >= rel->version_count || rel->versions[pos].tuple_id != tuple_id || rel->versions[pos].xmax > snapshot->txn;
+	pthread_mutex_unlock(&g_version_lock);
+
+	return visible;
+}
+
+/* Reads tuple tuple_id of the snapshot through its own descriptor */
+db_result_t snapshot_get_row(db_snapshot_t *snapshot, tuple_id_t tuple_id, storage_row_t row)
+{
+	relation_t *rel;
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	attribute_t *attr;
+	db_result_t result;
+	unsigned offset;
+#endif
+
+	if (tuple_id >= snapshot->rows) {
+		return DB_FINISHED;
+	}
+
+	rel = snapshot->rel;
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		offset = 0;
+		for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+			result = storage_column_read(rel->tuple_filename, snapshot->tuple_storage, rel->row_length, offset, attr->element_size, tuple_id, row + offset);
+			if (result != DB_OK) {
+				return result;
+			}
+			offset += attr->element_size;
+		}
+		return DB_OK;
+	}
+#endif
+	return storage_read_from(snapshot->tuple_storage, row, (unsigned long)tuple_id * rel->row_length, rel->row_length);
+}
+
+/****************************************************************************
+ * Name: snapshot_remove
+ *
+ * Description: Marks tuple_id of rel removed by the running transaction.
+ *              Snapshots see the removal once snapshot_commit() returns.
+ *
+ ****************************************************************************/
+db_result_t snapshot_remove(relation_t *rel, tuple_id_t tuple_id)
+{
+	db_result_t result;
+
+	pthread_mutex_lock(&g_version_lock);
+	result = version_add(rel, tuple_id, VERSION_PENDING);
+	pthread_mutex_unlock(&g_version_lock);
+
+	return result;
+}
+
+/****************************************************************************
+ * Name: snapshot_commit
+ *
+ * Description: Stores the removals of the running transaction with one
+ *              write, then makes them visible to later snapshots.
+ *
+ ****************************************************************************/
+db_result_t snapshot_commit(relation_t *rel)
+{
+	char path[TUPLE_NAME_LENGTH + sizeof(VERSION_FILE_SUFFIX)];
+	tuple_id_t *record;
+	db_storage_id_t fd;
+	tuple_id_t count;
+	tuple_id_t i;
+	ssize_t length;
+
+	count = 0;
+	for (i = 0; i < rel->version_count; i++) {
+		if (rel->versions[i].xmax == VERSION_PENDING) {
+			count++;
+		}
+	}
+	if (count == 0) {
+		return DB_OK;
+	}
+
+	record = (tuple_id_t *)malloc((count + 1) * sizeof(tuple_id_t));
+	if (record == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+	count = 0;
+	for (i = 0; i < rel->version_count; i++) {
+		if (rel->versions[i].xmax == VERSION_PENDING) {
+			record[count++] = rel->versions[i].tuple_id;
+		}
+	}
+	record[count++] = INVALID_TUPLE;
+
+	version_filename(rel->tuple_filename, path, sizeof(path));
+	fd = storage_open(path, O_RDWR | O_APPEND | O_CREAT);
+	if (fd < 0) {
+		free(record);
+		return DB_STORAGE_ERROR;
+	}
+	length = storage_write(fd, record, count * sizeof(tuple_id_t));
+	storage_close(fd);
+	free(record);
+	if (length != count * sizeof(tuple_id_t)) {
+		DB_LOG_E("DB: Failed to store the removals of %s\n", rel->name);
+		return DB_STORAGE_ERROR;
+	}
+
+	pthread_mutex_lock(&g_version_lock);
+	for (i = 0; i < rel->version_count; i++) {
+		if (rel->versions[i].xmax == VERSION_PENDING) {
+			rel->versions[i].xmax = g_txn + 1;
+		}
+	}
+	pthread_mutex_unlock(&g_version_lock);
+	g_txn++;
+
+	return DB_OK;
+}
+
+/* Forgets the removals of the running transaction */
+void snapshot_abort(relation_t *rel)
+{
+	tuple_id_t i;
+	tuple_id_t kept;
+
+	pthread_mutex_lock(&g_version_lock);
+	for (i = 0, kept = 0; i < rel->version_count; i++) {
+		if (rel->versions[i].xmax != VERSION_PENDING) {
+			rel->versions[kept++] = rel->versions[i];
+		}
+	}
+	rel->version_count = kept;
+	pthread_mutex_unlock(&g_version_lock);
+}
+
+/****************************************************************************
+ * Name: snapshot_load
+ *
+ * Description: Reads the committed removals of a relation being loaded.
+ *              They are older than any snapshot.
+ *
+ ****************************************************************************/
+db_result_t snapshot_load(relation_t *rel)
+{
+	char path[TUPLE_NAME_LENGTH + sizeof(VERSION_FILE_SUFFIX)];
+	tuple_id_t record[VERSION_CHUNK];
+	db_storage_id_t fd;
+	db_result_t result;
+	unsigned long committed;
+	unsigned long pos;
+	ssize_t length;
+	int i;
+
+	rel->version_count = 0;
+	version_filename(rel->tuple_filename, path, sizeof(path));
+	fd = storage_open(path, O_RDONLY);
+	if (fd < 0) {
+		/* Nothing was ever removed */
+		return DB_OK;
+	}
+
+	/* Records after the last end of commit belong to a torn commit */
+	committed = 0;
+	pos = 0;
+	while ((length = storage_read(fd, record, sizeof(record))) > 0) {
+		for (i = 0; i < length / sizeof(tuple_id_t); i++, pos++) {
+			if (record[i] == INVALID_TUPLE) {
+				committed = pos;
+			}
+		}
+	}
+
+	result = DB_OK;
+	pos = 0;
+	storage_seek(fd, 0, SEEK_SET);
+	pthread_mutex_lock(&g_version_lock);
+	while (pos < committed && DB_SUCCESS(result) && (length = storage_read(fd, record, sizeof(record))) > 0) {
+		for (i = 0; i < length / sizeof(tuple_id_t) && pos < committed; i++, pos++) {
+			if (record[i] != INVALID_TUPLE && DB_ERROR(version_add(rel, record[i], 0))) {
+				result = DB_ALLOCATION_ERROR;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&g_version_lock);
+	storage_close(fd);
+
+	DB_LOG_D("DB: Relation %s has %lu removed tuples\n", rel->name, (unsigned long)rel->version_count);
+	return result;
+}
+
+/* Frees the version records of a relation leaving the memory */
+void snapshot_free(relation_t *rel)
+{
+	pthread_mutex_lock(&g_version_lock);
+	if (rel->versions != NULL) {
+		free(rel->versions);
+	}
+	rel->versions = NULL;
+	rel->version_count = 0;
+	rel->version_limit = 0;
+	pthread_mutex_unlock(&g_version_lock);
+}
+
+/* Removes the version file of a relation being dropped */
+void snapshot_drop(relation_t *rel)
+{
+	char path[TUPLE_NAME_LENGTH + sizeof(VERSION_FILE_SUFFIX)];
+
+	version_filename(rel->tuple_filename, path, sizeof(path));
+	storage_remove(path);
+	snapshot_free(rel);
+}
+
+/* Tells whether a snapshot of rel is open. The caller holds the catalog lock. */
+bool snapshot_active(relation_t *rel)
+{
+	db_snapshot_t *snapshot;
+
+	for (snapshot = g_snapshots; snapshot != NULL; snapshot = snapshot->next) {
+		if (snapshot->rel == rel) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Tells whether a committed transaction removed tuple_id of rel */
+bool snapshot_removed(relation_t *rel, tuple_id_t tuple_id)
+{
+	tuple_id_t pos;
+	bool removed;
+
+	pthread_mutex_lock(&g_version_lock);
+	pos = version_find(rel, tuple_id);
+	removed = pos < rel->version_count && rel->versions[pos].tuple_id == tuple_id && rel->versions[pos].xmax != VERSION_PENDING;
+	pthread_mutex_unlock(&g_version_lock);
+
+	return removed;
+}
+
+/****************************************************************************
+ * Name: snapshot_collectable
+ *
+ * Description: Tells whether the removed tuples of rel make up
+ *              DB_VACUUM_THRESHOLD percent of it and no snapshot can see
+ *              them any more. The caller holds the catalog lock.
+ *
+ ****************************************************************************/
+bool snapshot_collectable(relation_t *rel)
+{
+#ifdef CONFIG_ARASTORAGE_ENABLE_VACUUM
+	tuple_id_t cardinality;
+
+	if (rel->version_count == 0 || snapshot_active(rel)) {
+		return false;
+	}
+	cardinality = relation_cardinality(rel);
+	if (cardinality == INVALID_TUPLE) {
+		return false;
+	}
+	return (unsigned long)rel->version_count * 100 >= (unsigned long)cardinality * DB_VACUUM_THRESHOLD;
+#else
+	return false;
+#endif
+}
+
+/****************************************************************************
+ * Name: snapshot_forget
+ *
+ * Description: Drops the version records of rel once its removed tuples
+ *              are compacted away from the tuple file tuple_filename.
+ *
+ ****************************************************************************/
+void snapshot_forget(relation_t *rel, const char *tuple_filename)
+{
+	char path[TUPLE_NAME_LENGTH + sizeof(VERSION_FILE_SUFFIX)];
+
+	version_filename(tuple_filename, path, sizeof(path));
+	storage_remove(path);
+	snapshot_free(rel);
+}
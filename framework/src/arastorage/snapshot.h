@@ -0,0 +1,82 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <arastorage/arastorage.h>
+#include "relation.h"
+#include "storage.h"
+
+/****************************************************************************
+* Public Type Definitions
+****************************************************************************/
+typedef uint32_t db_txn_t;
+
+/* A tuple removed by transaction xmax */
+struct db_version_s {
+	tuple_id_t tuple_id;
+	db_txn_t xmax;
+};
+
+/*
+ * The tuples a query sees: those stored before it started and not yet
+ * removed by a transaction committed at that time. Tuples are appended
+ * in commit order, so the number of stored tuples is the insert horizon.
+ */
+struct db_snapshot_s {
+	struct db_snapshot_s *next;
+	relation_t *rel;
+	db_txn_t txn;				/* Last transaction committed when taken */
+	tuple_id_t rows;			/* Tuples stored when taken */
+	tuple_id_t removed;			/* Tuples removed when taken */
+	db_storage_id_t tuple_storage;	/* Read-only descriptor of the tuple file */
+};
+typedef struct db_snapshot_s db_snapshot_t;
+
+/****************************************************************************
+* Global Function Prototypes
+****************************************************************************/
+db_result_t snapshot_init(void);
+void snapshot_deinit(void);
+
+void snapshot_lock(void);
+void snapshot_unlock(void);
+
+db_snapshot_t *snapshot_open(relation_t *);
+void snapshot_close(db_snapshot_t *);
+bool snapshot_visible(db_snapshot_t *, tuple_id_t);
+db_result_t snapshot_get_row(db_snapshot_t *, tuple_id_t, storage_row_t);
+
+db_result_t snapshot_remove(relation_t *, tuple_id_t);
+db_result_t snapshot_commit(relation_t *);
+void snapshot_abort(relation_t *);
+
+db_result_t snapshot_load(relation_t *);
+void snapshot_free(relation_t *);
+void snapshot_drop(relation_t *);
+bool snapshot_active(relation_t *);
+bool snapshot_removed(relation_t *, tuple_id_t);
+bool snapshot_collectable(relation_t *);
+void snapshot_forget(relation_t *, const char *);
+
+#endif							/* __SNAPSHOT_H__ */
@@ -62,6 +62,18 @@
 #include "relation.h"
 
 #define INVALID_STORAGE_ID -1
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+/* Descriptors of files kept in RAM start here, above those of the file system */
+#define STORAGE_MEMORY_ID_BASE 0x4000
+#define STORAGE_ID_IS_MEMORY(fd) ((fd) >= STORAGE_MEMORY_ID_BASE)
+
+/* The files of a volatile relation are told apart by their names */
+#define STORAGE_FILE_IS_MEMORY(name) ((name)[0] == MEMORY_FILE_PREFIX[0])
+#define STORAGE_FILE_PREFIX(rel) ((rel)->dir == DB_VOLATILE ? MEMORY_FILE_PREFIX : "")
+#else
+#define STORAGE_FILE_PREFIX(rel) ""
+#endif
 /****************************************************************************
 * Public Type Definitions
 ****************************************************************************/
@@ -72,7 +84,7 @@ struct insert_buffer_s {
 	int data_size;				/* size of data in buffer */
 };
 
-struct insert_buffer_s g_storage_write_buffer;
+extern struct insert_buffer_s g_storage_write_buffer;
 #endif
 
 typedef unsigned char *storage_row_t;
@@ -82,6 +94,8 @@ typedef unsigned char *storage_row_t;
 ****************************************************************************/
 db_result_t heap_generate_file(char *);
 db_result_t storage_generate_file(char *);
+void storage_name_file(relation_t *, char *, size_t, const char *);
+db_storage_id_t storage_open_relation(relation_t *, int);
 
 db_result_t storage_load(relation_t *);
 db_result_t storage_unload(relation_t *);
@@ -119,4 +133,49 @@ ssize_t storage_write(db_storage_id_t, void *, unsigned);
 ssize_t storage_get_availbyte_size(void);
 #endif
 
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+db_result_t storage_cache_init(void);
+void storage_cache_deinit(void);
+db_result_t storage_cache_flush(void);
+db_result_t storage_cache_sync(const char *);
+bool storage_cache_bypass(const char *);
+db_result_t storage_cache_attach(db_storage_id_t, const char *, int);
+db_result_t storage_cache_detach(db_storage_id_t);
+void storage_cache_discard(const char *);
+void storage_cache_rename(const char *, const char *);
+off_t storage_cache_seek(db_storage_id_t, unsigned long, int);
+ssize_t storage_cache_read(db_storage_id_t, void *, unsigned);
+ssize_t storage_cache_write(db_storage_id_t, void *, unsigned);
+#endif
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+db_result_t storage_memory_init(void);
+void storage_memory_deinit(void);
+db_storage_id_t storage_memory_open(const char *, int);
+db_storage_id_t storage_memory_close(db_storage_id_t);
+db_result_t storage_memory_remove(const char *);
+db_result_t storage_memory_rename(const char *, const char *);
+off_t storage_memory_seek(db_storage_id_t, unsigned long, int);
+ssize_t storage_memory_read(db_storage_id_t, void *, unsigned);
+ssize_t storage_memory_write(db_storage_id_t, void *, unsigned);
+#endif
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+db_result_t storage_wal_init(void);
+void storage_wal_deinit(void);
+db_result_t storage_wal_append(relation_t *, tuple_id_t, unsigned char *);
+db_result_t storage_wal_commit(void);
+db_result_t storage_wal_checkpoint(bool);
+#endif
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+db_result_t storage_column_generate(char *);
+db_result_t storage_column_drop(const char *);
+db_result_t storage_column_get_row_amount(relation_t *, tuple_id_t *);
+db_result_t storage_column_put_row(relation_t *, storage_row_t);
+db_result_t storage_column_get_row(relation_t *, tuple_id_t, storage_row_t);
+db_result_t storage_column_read(const char *, db_storage_id_t, unsigned, unsigned, unsigned, tuple_id_t, unsigned char *);
+void storage_column_deinit(void);
+#endif
+
 #endif							/* STORAGE_H */
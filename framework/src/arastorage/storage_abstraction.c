@@ -20,6 +20,7 @@
  * Included Files
  ****************************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -29,6 +30,23 @@
 #include "db_debug.h"
 #include "storage.h"
 
+/****************************************************************************
+* Private Functions
+****************************************************************************/
+/* Allocates the full path of filename under the mount point */
+static char *storage_path(const char *filename)
+{
+	size_t len;
+	char *path;
+
+	len = strlen(CONFIG_MOUNT_POINT) + strlen(filename) + 1;
+	path = (char *)malloc(sizeof(char) * len);
+	if (path != NULL) {
+		snprintf(path, len, "%s%s", CONFIG_MOUNT_POINT, filename);
+	}
+	return path;
+}
+
 /****************************************************************************
 * Public Functions
 ****************************************************************************/
@@ -43,12 +61,32 @@ db_storage_id_t storage_open(const char *filename, int oflag)
 {
 	db_storage_id_t fd;
 	char *rel_path;
-	rel_path = (char *)malloc(sizeof(char) * (strlen(CONFIG_MOUNT_POINT) + strlen(filename) + 1));
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_FILE_IS_MEMORY(filename)) {
+		return storage_memory_open(filename, oflag);
+	}
+#endif
+	rel_path = storage_path(filename);
 	if (rel_path == NULL) {
 		return INVALID_STORAGE_ID;
 	}
-	snprintf(rel_path, DB_MAX_FILENAME_LENGTH, "%s%s\0", CONFIG_MOUNT_POINT, filename);
-	fd = open(rel_path, oflag);
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	if (!storage_cache_bypass(filename)) {
+		/* O_APPEND is emulated by the page cache so that it can write back any page,
+		   and a partly written page is read in first, even through O_WRONLY */
+		if ((oflag & O_ACCMODE) == O_WRONLY) {
+			oflag = (oflag & ~O_ACCMODE) | O_RDWR;
+		}
+		fd = open(rel_path, oflag & ~O_APPEND, 0666);
+		if (fd >= 0 && DB_ERROR(storage_cache_attach(fd, filename, oflag))) {
+			close(fd);
+			fd = INVALID_STORAGE_ID;
+		}
+		free(rel_path);
+		return fd;
+	}
+#endif
+	fd = open(rel_path, oflag, 0666);
 	free(rel_path);
 	return fd;
 }
@@ -56,6 +94,14 @@ db_storage_id_t storage_open(const char *filename, int oflag)
 /* It mapped with close function in specific file system */
 db_storage_id_t storage_close(db_storage_id_t fd)
 {
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_ID_IS_MEMORY(fd)) {
+		return storage_memory_close(fd);
+	}
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	storage_cache_detach(fd);
+#endif
 	return close(fd);
 }
 
@@ -64,14 +110,21 @@ db_result_t storage_remove(const char *filename)
 {
 	char *rel_path;
 	int res = DB_STORAGE_ERROR;
-	rel_path = (char *)malloc(sizeof(char) * (strlen(CONFIG_MOUNT_POINT) + strlen(filename) + 1));
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_FILE_IS_MEMORY(filename)) {
+		return storage_memory_remove(filename);
+	}
+#endif
+	rel_path = storage_path(filename);
 	if (rel_path == NULL) {
 		return DB_STORAGE_ERROR;
 	}
-	snprintf(rel_path, DB_MAX_FILENAME_LENGTH, "%s%s\0", CONFIG_MOUNT_POINT, filename);
 	if (unlink(rel_path) == OK) {
 		res = DB_OK;
 	}
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	storage_cache_discard(filename);
+#endif
 	free(rel_path);
 	return res;
 }
@@ -82,22 +135,35 @@ db_result_t storage_rename(const char *old_name, const char *new_name)
 	char *old_path;
 	char *new_path;
 	int res = DB_STORAGE_ERROR;
-	old_path = (char *)malloc(sizeof(char) * (strlen(CONFIG_MOUNT_POINT) + strlen(old_name) + 1));
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_FILE_IS_MEMORY(old_name) || STORAGE_FILE_IS_MEMORY(new_name)) {
+		/* A file cannot move between RAM and the file system */
+		if (!STORAGE_FILE_IS_MEMORY(old_name) || !STORAGE_FILE_IS_MEMORY(new_name)) {
+			return DB_STORAGE_ERROR;
+		}
+		return storage_memory_rename(old_name, new_name);
+	}
+#endif
+	old_path = storage_path(old_name);
 	if (old_path == NULL) {
 		return DB_STORAGE_ERROR;
 	}
 
-	new_path = (char *)malloc(sizeof(char) * (strlen(CONFIG_MOUNT_POINT) + strlen(new_name) + 1));
+	new_path = storage_path(new_name);
 	if (new_path == NULL) {
 		free(old_path);
 		return DB_STORAGE_ERROR;
 	}
 
-	snprintf(old_path, DB_MAX_FILENAME_LENGTH, "%s%s\0", CONFIG_MOUNT_POINT, old_name);
-	snprintf(new_path, DB_MAX_FILENAME_LENGTH, "%s%s\0", CONFIG_MOUNT_POINT, new_name);
-
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	/* Write back first so that the renamed file is complete on storage */
+	storage_cache_sync(old_name);
+#endif
 	if (rename(old_path, new_path) == OK) {
 		res = DB_OK;
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+		storage_cache_rename(old_name, new_name);
+#endif
 	}
 	free(old_path);
 	free(new_path);
@@ -107,19 +173,46 @@ db_result_t storage_rename(const char *old_name, const char *new_name)
 /* It mapped with seek function in specific file system */
 off_t storage_seek(db_storage_id_t fd, unsigned long offset, int whence)
 {
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_ID_IS_MEMORY(fd)) {
+		return storage_memory_seek(fd, offset, whence);
+	}
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	return storage_cache_seek(fd, offset, whence);
+#else
 	return lseek(fd, offset, whence);
+#endif
 }
 
 /* It mapped with read function in specific file system */
 ssize_t storage_read(db_storage_id_t fd, void *buffer, unsigned length)
 {
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_ID_IS_MEMORY(fd)) {
+		return storage_memory_read(fd, buffer, length);
+	}
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	return storage_cache_read(fd, buffer, length);
+#else
 	return read(fd, buffer, length);
+#endif
 }
 
 /* It mapped with write function in specific file system */
 ssize_t storage_write(db_storage_id_t fd, void *buffer, unsigned length)
 {
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	if (STORAGE_ID_IS_MEMORY(fd)) {
+		return storage_memory_write(fd, buffer, length);
+	}
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	return storage_cache_write(fd, buffer, length);
+#else
 	return write(fd, buffer, length);
+#endif
 }
 
 #ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
@@ -0,0 +1,723 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      A page cache shared by every file of the database.
+ *
+ *      Files are cached in fixed-size pages held in a single pool whose
+ *      size is set by CONFIG_ARASTORAGE_PAGE_CACHE_SIZE. Pages are found
+ *      through a hash of <file, page number> and evicted with the CLOCK
+ *      algorithm. Writes only mark pages dirty; dirty pages are written
+ *      back when they are evicted, when the last writer closes the file,
+ *      or when storage_cache_flush() is called.
+ *
+ *      Pages are associated with a file name rather than a descriptor,
+ *      so every descriptor opened on the same file sees the same data,
+ *      and clean pages survive a close/open cycle of the file.
+ *
+ *      The tree and bucket files of the bplus-tree index are not cached
+ *      here, as that index keeps its own node and bucket caches.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <tinyara/config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "db_options.h"
+#include "db_debug.h"
+#include "storage.h"
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define CACHE_PAGE_SIZE     CONFIG_ARASTORAGE_PAGE_SIZE
+#define PAGE_FRAMES         (CONFIG_ARASTORAGE_PAGE_CACHE_SIZE / CONFIG_ARASTORAGE_PAGE_SIZE)
+#define PAGE_HASH_SIZE      PAGE_FRAMES
+#define PAGE_NONE           -1
+
+#define PAGE_FLAG_VALID     0x01
+#define PAGE_FLAG_DIRTY     0x02
+#define PAGE_FLAG_REFERENCE 0x04
+
+#define PAGE_HASH(file, page)   ((((unsigned)(file) * 31) + (unsigned)(page)) % PAGE_HASH_SIZE)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+struct cache_file_s {
+	char name[DB_MAX_FILENAME_LENGTH];
+	off_t size;					/* Size including data not written back yet */
+	uint8_t used;
+	uint8_t refs;				/* Number of open descriptors */
+	uint8_t writers;			/* Number of open descriptors allowing writes */
+	uint8_t failed;				/* A page was lost since the failure was last reported */
+	db_storage_id_t wfd;		/* A writable descriptor used for write-back */
+};
+typedef struct cache_file_s cache_file_t;
+
+struct cache_handle_s {
+	db_storage_id_t fd;
+	int8_t file;				/* Index in g_files, PAGE_NONE if unused */
+	uint8_t append;
+	uint8_t writable;
+	off_t pos;
+};
+typedef struct cache_handle_s cache_handle_t;
+
+struct cache_frame_s {
+	int16_t next;				/* Next frame in the same hash chain */
+	int8_t file;
+	uint8_t flags;
+	unsigned long page;
+	unsigned char *data;
+};
+typedef struct cache_frame_s cache_frame_t;
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+static cache_file_t g_files[DB_CACHE_FILE_LIMIT];
+static cache_handle_t g_handles[DB_CACHE_HANDLE_LIMIT];
+static cache_frame_t g_frames[PAGE_FRAMES];
+static int16_t g_hash[PAGE_HASH_SIZE];
+static unsigned char *g_pool;
+static int g_clock_hand;
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static cache_handle_t *handle_find(db_storage_id_t fd)
+{
+	int i;
+
+	for (i = 0; i < DB_CACHE_HANDLE_LIMIT; i++) {
+		if (g_handles[i].file != PAGE_NONE && g_handles[i].fd == fd) {
+			return &g_handles[i];
+		}
+	}
+	return NULL;
+}
+
+static int file_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < DB_CACHE_FILE_LIMIT; i++) {
+		if (g_files[i].used && strncmp(g_files[i].name, name, DB_MAX_FILENAME_LENGTH) == 0) {
+			return i;
+		}
+	}
+	return PAGE_NONE;
+}
+
+static void hash_remove(int idx)
+{
+	int16_t *link;
+	unsigned bucket;
+
+	bucket = PAGE_HASH(g_frames[idx].file, g_frames[idx].page);
+	for (link = &g_hash[bucket]; *link != PAGE_NONE; link = &g_frames[*link].next) {
+		if (*link == idx) {
+			*link = g_frames[idx].next;
+			break;
+		}
+	}
+	g_frames[idx].next = PAGE_NONE;
+}
+
+static int frame_lookup(int file, unsigned long page)
+{
+	int idx;
+
+	for (idx = g_hash[PAGE_HASH(file, page)]; idx != PAGE_NONE; idx = g_frames[idx].next) {
+		if (g_frames[idx].file == file && g_frames[idx].page == page) {
+			return idx;
+		}
+	}
+	return PAGE_NONE;
+}
+
+static void frame_invalidate(int idx)
+{
+	hash_remove(idx);
+	g_frames[idx].flags = 0;
+	g_frames[idx].file = PAGE_NONE;
+}
+
+static db_result_t frame_write_back(int idx)
+{
+	cache_frame_t *frame = &g_frames[idx];
+	cache_file_t *file = &g_files[frame->file];
+	off_t offset;
+	size_t length;
+
+	if (!(frame->flags & PAGE_FLAG_DIRTY)) {
+		return DB_OK;
+	}
+
+	offset = (off_t)frame->page * CACHE_PAGE_SIZE;
+	length = CACHE_PAGE_SIZE;
+	if (offset >= file->size) {
+		/* The file was truncated below this page */
+		frame->flags &= ~PAGE_FLAG_DIRTY;
+		return DB_OK;
+	}
+	if (offset + length > file->size) {
+		length = file->size - offset;
+	}
+
+	if (file->wfd < 0 || lseek(file->wfd, offset, SEEK_SET) == (off_t)-1 || write(file->wfd, frame->data, length) != length) {
+		DB_LOG_E("DB: Failed to write back page %lu of %s\n", frame->page, file->name);
+		/* Retrying would keep the frame forever; drop it and report the loss later */
+		file->failed = 1;
+		frame_invalidate(idx);
+		return DB_STORAGE_ERROR;
+	}
+
+	frame->flags &= ~PAGE_FLAG_DIRTY;
+	return DB_OK;
+}
+
+/* Picks a frame to reuse with the CLOCK algorithm. */
+static int frame_victim(void)
+{
+	cache_frame_t *frame;
+	int scanned;
+
+	for (scanned = 0; scanned < 2 * PAGE_FRAMES; scanned++) {
+		frame = &g_frames[g_clock_hand];
+		g_clock_hand = (g_clock_hand + 1) % PAGE_FRAMES;
+
+		if (!(frame->flags & PAGE_FLAG_VALID)) {
+			return frame - g_frames;
+		}
+		if (frame->flags & PAGE_FLAG_REFERENCE) {
+			frame->flags &= ~PAGE_FLAG_REFERENCE;
+			continue;
+		}
+		if (DB_SUCCESS(frame_write_back(frame - g_frames))) {
+			frame_invalidate(frame - g_frames);
+		}
+		return frame - g_frames;
+	}
+
+	return PAGE_NONE;
+}
+
+/* Returns the frame holding the page, reading it from fd if needed. */
+static int frame_get(int file, db_storage_id_t fd, unsigned long page)
+{
+	cache_frame_t *frame;
+	unsigned bucket;
+	off_t offset;
+	ssize_t r;
+	int idx;
+
+	idx = frame_lookup(file, page);
+	if (idx != PAGE_NONE) {
+		g_frames[idx].flags |= PAGE_FLAG_REFERENCE;
+		return idx;
+	}
+
+	idx = frame_victim();
+	if (idx == PAGE_NONE) {
+		DB_LOG_E("DB: No page frame available\n");
+		return PAGE_NONE;
+	}
+
+	frame = &g_frames[idx];
+	memset(frame->data, 0, CACHE_PAGE_SIZE);
+
+	offset = (off_t)page * CACHE_PAGE_SIZE;
+	if (offset < g_files[file].size) {
+		if (lseek(fd, offset, SEEK_SET) == (off_t)-1) {
+			return PAGE_NONE;
+		}
+		r = read(fd, frame->data, CACHE_PAGE_SIZE);
+		if (r < 0) {
+			return PAGE_NONE;
+		}
+	}
+
+	frame->file = file;
+	frame->page = page;
+	frame->flags = PAGE_FLAG_VALID | PAGE_FLAG_REFERENCE;
+
+	bucket = PAGE_HASH(file, page);
+	frame->next = g_hash[bucket];
+	g_hash[bucket] = idx;
+
+	return idx;
+}
+
+/* Writes back and optionally drops every page of a file. */
+static db_result_t file_sync(int file, bool drop)
+{
+	db_result_t result = DB_OK;
+	int idx;
+
+	for (idx = 0; idx < PAGE_FRAMES; idx++) {
+		if ((g_frames[idx].flags & PAGE_FLAG_VALID) && g_frames[idx].file == file) {
+			if (!drop) {
+				frame_write_back(idx);
+			} else {
+				frame_invalidate(idx);
+			}
+		}
+	}
+	if (g_files[file].failed) {
+		g_files[file].failed = 0;
+		result = DB_STORAGE_ERROR;
+	}
+	return result;
+}
+
+/* Makes its pages reach the media, not only the file system buffers. */
+static db_result_t file_commit(int file)
+{
+	if (g_files[file].wfd >= 0 && fsync(g_files[file].wfd) < 0) {
+		g_files[file].failed = 1;
+	}
+	if (g_files[file].failed) {
+		g_files[file].failed = 0;
+		return DB_STORAGE_ERROR;
+	}
+	return DB_OK;
+}
+
+/* Makes room in the file table by forgetting a closed file. */
+static int file_alloc(void)
+{
+	int i;
+
+	for (i = 0; i < DB_CACHE_FILE_LIMIT; i++) {
+		if (!g_files[i].used) {
+			return i;
+		}
+	}
+	for (i = 0; i < DB_CACHE_FILE_LIMIT; i++) {
+		if (g_files[i].refs == 0) {
+			/* A closed file has no dirty page left */
+			file_sync(i, true);
+			g_files[i].used = 0;
+			return i;
+		}
+	}
+	return PAGE_NONE;
+}
+
+static void file_forget(int file)
+{
+	file_sync(file, true);
+	if (g_files[file].refs == 0) {
+		g_files[file].used = 0;
+	} else {
+		/* Still open through a stale name; keep the slot but make it unreachable */
+		g_files[file].name[0] = '\0';
+	}
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+db_result_t storage_cache_init(void)
+{
+	int i;
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool == NULL) {
+		g_pool = (unsigned char *)malloc(PAGE_FRAMES * CACHE_PAGE_SIZE);
+		if (g_pool == NULL) {
+			pthread_mutex_unlock(&g_cache_lock);
+			DB_LOG_E("DB: Failed to allocate the page cache\n");
+			return DB_ALLOCATION_ERROR;
+		}
+		memset(g_files, 0, sizeof(g_files));
+		for (i = 0; i < DB_CACHE_HANDLE_LIMIT; i++) {
+			g_handles[i].file = PAGE_NONE;
+		}
+		for (i = 0; i < PAGE_HASH_SIZE; i++) {
+			g_hash[i] = PAGE_NONE;
+		}
+		for (i = 0; i < PAGE_FRAMES; i++) {
+			g_frames[i].next = PAGE_NONE;
+			g_frames[i].file = PAGE_NONE;
+			g_frames[i].flags = 0;
+			g_frames[i].data = g_pool + i * CACHE_PAGE_SIZE;
+		}
+		g_clock_hand = 0;
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+
+	DB_LOG_D("DB: Page cache of %d pages of %d bytes\n", PAGE_FRAMES, CACHE_PAGE_SIZE);
+	return DB_OK;
+}
+
+void storage_cache_deinit(void)
+{
+	storage_cache_flush();
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool != NULL) {
+		free(g_pool);
+		g_pool = NULL;
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+}
+
+db_result_t storage_cache_flush(void)
+{
+	db_result_t result = DB_OK;
+	int idx;
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool != NULL) {
+		for (idx = 0; idx < PAGE_FRAMES; idx++) {
+			if (g_frames[idx].flags & PAGE_FLAG_VALID) {
+				frame_write_back(idx);
+			}
+		}
+		for (idx = 0; idx < DB_CACHE_FILE_LIMIT; idx++) {
+			if (g_files[idx].used && DB_ERROR(file_commit(idx))) {
+				result = DB_STORAGE_ERROR;
+			}
+		}
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+
+	return result;
+}
+
+/* Writes back the pages of a single file, e.g. before it is renamed */
+db_result_t storage_cache_sync(const char *name)
+{
+	db_result_t result = DB_OK;
+	int idx;
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool != NULL) {
+		idx = file_find(name);
+		if (idx != PAGE_NONE) {
+			file_sync(idx, false);
+			result = file_commit(idx);
+		}
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+
+	return result;
+}
+
+/* Tells whether storage_open() should leave the file uncached */
+bool storage_cache_bypass(const char *name)
+{
+	return strncmp(name, HEAP_FILE_NAME ".", sizeof(HEAP_FILE_NAME)) == 0 || strncmp(name, BUCKET_FILE_NAME ".", sizeof(BUCKET_FILE_NAME)) == 0;
+}
+
+/****************************************************************************
+ * Name: storage_cache_attach
+ *
+ * Description: Registers a descriptor opened by storage_open(). The
+ *              descriptor must have been opened without O_APPEND, which
+ *              is emulated here so that write-back can seek freely.
+ *
+ ****************************************************************************/
+db_result_t storage_cache_attach(db_storage_id_t fd, const char *name, int oflag)
+{
+	cache_handle_t *handle = NULL;
+	cache_file_t *file;
+	int idx;
+	int i;
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool == NULL) {
+		/* Not initialized yet, the descriptor is used uncached */
+		pthread_mutex_unlock(&g_cache_lock);
+		return DB_OK;
+	}
+
+	for (i = 0; i < DB_CACHE_HANDLE_LIMIT; i++) {
+		if (g_handles[i].file == PAGE_NONE) {
+			handle = &g_handles[i];
+			break;
+		}
+	}
+
+	idx = file_find(name);
+	if (idx == PAGE_NONE && handle != NULL) {
+		idx = file_alloc();
+		if (idx != PAGE_NONE) {
+			file = &g_files[idx];
+			memset(file, 0, sizeof(cache_file_t));
+			strncpy(file->name, name, DB_MAX_FILENAME_LENGTH - 1);
+			file->used = 1;
+			file->wfd = INVALID_STORAGE_ID;
+			file->size = lseek(fd, 0, SEEK_END);
+			if (file->size == (off_t)-1) {
+				file->used = 0;
+				idx = PAGE_NONE;
+			}
+		}
+	}
+
+	if (handle == NULL || idx == PAGE_NONE) {
+		pthread_mutex_unlock(&g_cache_lock);
+		DB_LOG_E("DB: Page cache has no slot left for %s\n", name);
+		return DB_LIMIT_ERROR;
+	}
+
+	file = &g_files[idx];
+	if (oflag & O_TRUNC) {
+		file_sync(idx, true);
+		file->size = 0;
+	}
+
+	handle->fd = fd;
+	handle->file = idx;
+	handle->pos = 0;
+	handle->append = (oflag & O_APPEND) ? 1 : 0;
+	handle->writable = (oflag & O_ACCMODE) != O_RDONLY;
+
+	file->refs++;
+	if (handle->writable) {
+		file->writers++;
+		file->wfd = fd;
+	}
+
+	pthread_mutex_unlock(&g_cache_lock);
+	return DB_OK;
+}
+
+db_result_t storage_cache_detach(db_storage_id_t fd)
+{
+	cache_handle_t *handle;
+	cache_file_t *file;
+	db_result_t result = DB_OK;
+	int i;
+
+	pthread_mutex_lock(&g_cache_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_cache_lock);
+		return DB_OK;
+	}
+
+	file = &g_files[handle->file];
+	if (handle->writable) {
+		if (file->writers == 1) {
+			/* The last writer is leaving, nobody could write back later */
+			result = file_sync(handle->file, false);
+			file->wfd = INVALID_STORAGE_ID;
+		} else if (file->wfd == fd) {
+			for (i = 0; i < DB_CACHE_HANDLE_LIMIT; i++) {
+				if (&g_handles[i] != handle && g_handles[i].file == handle->file && g_handles[i].writable) {
+					file->wfd = g_handles[i].fd;
+					break;
+				}
+			}
+		}
+		file->writers--;
+	}
+	file->refs--;
+	if (file->refs == 0 && file->name[0] == '\0') {
+		file_sync(handle->file, true);
+		file->used = 0;
+	}
+	handle->file = PAGE_NONE;
+
+	pthread_mutex_unlock(&g_cache_lock);
+	return result;
+}
+
+void storage_cache_discard(const char *name)
+{
+	int idx;
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool != NULL) {
+		idx = file_find(name);
+		if (idx != PAGE_NONE) {
+			file_forget(idx);
+		}
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+}
+
+void storage_cache_rename(const char *old_name, const char *new_name)
+{
+	int idx;
+
+	pthread_mutex_lock(&g_cache_lock);
+	if (g_pool != NULL) {
+		idx = file_find(new_name);
+		if (idx != PAGE_NONE) {
+			file_forget(idx);
+		}
+		idx = file_find(old_name);
+		if (idx != PAGE_NONE) {
+			memset(g_files[idx].name, 0, DB_MAX_FILENAME_LENGTH);
+			strncpy(g_files[idx].name, new_name, DB_MAX_FILENAME_LENGTH - 1);
+		}
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+}
+
+off_t storage_cache_seek(db_storage_id_t fd, unsigned long offset, int whence)
+{
+	cache_handle_t *handle;
+	off_t pos;
+
+	pthread_mutex_lock(&g_cache_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_cache_lock);
+		return lseek(fd, offset, whence);
+	}
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = handle->pos + offset;
+		break;
+	case SEEK_END:
+		pos = g_files[handle->file].size + offset;
+		break;
+	default:
+		pos = (off_t)-1;
+		break;
+	}
+	if (pos >= 0) {
+		handle->pos = pos;
+	}
+
+	pthread_mutex_unlock(&g_cache_lock);
+	return pos;
+}
+
+ssize_t storage_cache_read(db_storage_id_t fd, void *buffer, unsigned length)
+{
+	cache_handle_t *handle;
+	cache_file_t *file;
+	unsigned char *dst = buffer;
+	unsigned long page;
+	unsigned offset;
+	unsigned chunk;
+	ssize_t done = 0;
+	int idx;
+
+	pthread_mutex_lock(&g_cache_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_cache_lock);
+		return read(fd, buffer, length);
+	}
+
+	file = &g_files[handle->file];
+	if (handle->pos >= file->size) {
+		pthread_mutex_unlock(&g_cache_lock);
+		return 0;
+	}
+	if (handle->pos + length > file->size) {
+		length = file->size - handle->pos;
+	}
+
+	while (done < length) {
+		page = handle->pos / CACHE_PAGE_SIZE;
+		offset = handle->pos % CACHE_PAGE_SIZE;
+		chunk = CACHE_PAGE_SIZE - offset;
+		if (chunk > length - done) {
+			chunk = length - done;
+		}
+
+		idx = frame_get(handle->file, fd, page);
+		if (idx == PAGE_NONE) {
+			break;
+		}
+		memcpy(dst + done, g_frames[idx].data + offset, chunk);
+		done += chunk;
+		handle->pos += chunk;
+	}
+
+	pthread_mutex_unlock(&g_cache_lock);
+	return done > 0 ? done : -1;
+}
+
+ssize_t storage_cache_write(db_storage_id_t fd, void *buffer, unsigned length)
+{
+	cache_handle_t *handle;
+	cache_file_t *file;
+	unsigned char *src = buffer;
+	unsigned long page;
+	unsigned offset;
+	unsigned chunk;
+	ssize_t done = 0;
+	int idx;
+
+	pthread_mutex_lock(&g_cache_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_cache_lock);
+		return write(fd, buffer, length);
+	}
+	if (!handle->writable) {
+		pthread_mutex_unlock(&g_cache_lock);
+		return -1;
+	}
+
+	file = &g_files[handle->file];
+	if (handle->append) {
+		handle->pos = file->size;
+	}
+
+	while (done < length) {
+		page = handle->pos / CACHE_PAGE_SIZE;
+		offset = handle->pos % CACHE_PAGE_SIZE;
+		chunk = CACHE_PAGE_SIZE - offset;
+		if (chunk > length - done) {
+			chunk = length - done;
+		}
+
+		idx = frame_get(handle->file, fd, page);
+		if (idx == PAGE_NONE) {
+			break;
+		}
+		memcpy(g_frames[idx].data + offset, src + done, chunk);
+		g_frames[idx].flags |= PAGE_FLAG_DIRTY;
+		done += chunk;
+		handle->pos += chunk;
+		if (handle->pos > file->size) {
+			file->size = handle->pos;
+		}
+	}
+
+	pthread_mutex_unlock(&g_cache_lock);
+	return done > 0 ? done : -1;
+}
+
+#endif							/* CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE */
@@ -0,0 +1,962 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      Columnar storage of the tuples of a relation.
+ *
+ *      A relation created with "CREATE RELATION name TYPE COLUMNAR" keeps
+ *      its newest rows row-wise in its tuple file (the tail). Once the
+ *      tail holds CONFIG_ARASTORAGE_COLUMN_BLOCK_ROWS rows, they are
+ *      sealed: every attribute is encoded into a block appended to a file
+ *      of its own ("<tuple file>.<column>"), the file offsets of the new
+ *      blocks are appended to the directory ("<tuple file>.d"), and the
+ *      tail is emptied. Sealed blocks are never modified.
+ *
+ *      Integer columns are encoded per block with whichever is smallest:
+ *      delta-of-delta (regular series such as timestamps), frame of
+ *      reference bit-packing (values within a narrow range), or the raw
+ *      values. Other domains are stored raw.
+ *
+ *      The tail starts with the number of rows sealed when it was
+ *      written. A power cut between appending a directory entry and
+ *      emptying the tail thus leaves rows which are skipped on reading
+ *      and dropped by the next seal.
+ *
+ *      Decoded blocks are kept in a small LRU cache, so a scan decodes
+ *      each block of the columns it reads only once.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <tinyara/config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "db_options.h"
+#include "db_debug.h"
+#include "random.h"
+#include "storage.h"
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define COLUMN_BLOCK_ROWS       CONFIG_ARASTORAGE_COLUMN_BLOCK_ROWS
+#define COLUMN_CACHE_ENTRIES    DB_COLUMN_CACHE_LIMIT
+
+/* A tuple file name followed by COLUMN_DIRECTORY_SUFFIX or ".<column>",
+   where a column number has up to three digits */
+#define COLUMN_PATH_LENGTH      (TUPLE_NAME_LENGTH + 4)
+
+#define COLUMN_ENCODING_RAW     0
+#define COLUMN_ENCODING_FOR     1	/* Frame of reference, bit-packed */
+#define COLUMN_ENCODING_DOD     2	/* Delta-of-delta */
+
+/* Bit widths of the zigzag encoded delta-of-delta buckets. Bucket n is
+   prefixed by n + 1 one bits and, except for the last one, a zero bit.
+   A zero delta-of-delta is a single zero bit. */
+#define DOD_BUCKETS             4
+
+/* Worst case size of an encoded integer: 4 prefix bits and 32 bits */
+#define DOD_MAX_BYTES           5
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+struct column_tail_s {
+	tuple_id_t base;			/* Rows sealed when the tail was written */
+	uint16_t block_rows;
+	uint16_t reserved;
+};
+
+struct column_dir_s {
+	uint16_t block_rows;
+	uint16_t row_length;
+	uint8_t columns;
+	uint8_t reserved[3];
+};
+
+struct column_desc_s {
+	uint16_t offset;			/* Offset of the attribute in a row */
+	uint8_t element_size;
+	uint8_t domain;
+};
+
+struct column_block_s {
+	uint32_t base;				/* First value (DOD) or minimum (FOR) */
+	uint32_t delta;				/* First delta (DOD) */
+	uint32_t length;			/* Bytes of encoded values following the header */
+	uint16_t rows;
+	uint8_t encoding;
+	uint8_t width;				/* Bits per value (FOR) */
+};
+
+struct column_bits_s {
+	unsigned char *buf;			/* NULL to only count the bits */
+	uint32_t pos;
+};
+
+struct column_cache_s {
+	char name[TUPLE_NAME_LENGTH + 1];
+	unsigned offset;
+	tuple_id_t first;			/* First row of the decoded block */
+	uint16_t rows;
+	uint8_t element_size;
+	uint32_t stamp;				/* Last use, for LRU eviction */
+	size_t capacity;
+	unsigned char *data;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static const uint8_t g_dod_width[DOD_BUCKETS] = { 7, 9, 12, 32 };
+
+static struct column_cache_s g_column_cache[COLUMN_CACHE_ENTRIES];
+static uint32_t g_column_clock;
+static pthread_mutex_t g_column_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static void bits_put(struct column_bits_s *bits, uint32_t value, uint8_t count)
+{
+	while (count-- > 0) {
+		if (bits->buf != NULL && (value & 1)) {
+			bits->buf[bits->pos >> 3] |= 1 << (bits->pos & 7);
+		}
+		value >>= 1;
+		bits->pos++;
+	}
+}
+
+static uint32_t bits_get(struct column_bits_s *bits, uint8_t count)
+{
+	uint32_t value = 0;
+	uint8_t i;
+
+	for (i = 0; i < count; i++, bits->pos++) {
+		if (bits->buf[bits->pos >> 3] & (1 << (bits->pos & 7))) {
+			value |= 1u << i;
+		}
+	}
+	return value;
+}
+
+static void dod_put(struct column_bits_s *bits, int32_t dod)
+{
+	uint32_t zigzag;
+	int i;
+
+	zigzag = ((uint32_t)dod << 1) ^ (uint32_t)(dod >> 31);
+	if (zigzag == 0) {
+		bits_put(bits, 0, 1);
+		return;
+	}
+	for (i = 0; i < DOD_BUCKETS - 1 && (zigzag >> g_dod_width[i]) != 0; i++) ;
+
+	bits_put(bits, (1u << (i + 1)) - 1, i + 1);
+	if (i < DOD_BUCKETS - 1) {
+		bits_put(bits, 0, 1);
+	}
+	bits_put(bits, zigzag, g_dod_width[i]);
+}
+
+static int32_t dod_get(struct column_bits_s *bits)
+{
+	uint32_t zigzag;
+	int n;
+
+	for (n = 0; n < DOD_BUCKETS && bits_get(bits, 1); n++) ;
+	if (n == 0) {
+		return 0;
+	}
+	zigzag = bits_get(bits, g_dod_width[n - 1]);
+	return (int32_t)((zigzag >> 1) ^ (0 - (zigzag & 1)));
+}
+
+/* Integers are stored big-endian; INT values are sign-extended so that the
+   frame of reference of a block with negative values stays narrow. */
+static uint32_t column_get_value(const unsigned char *ptr, uint8_t size)
+{
+	uint32_t value = 0;
+	uint8_t i;
+
+	for (i = 0; i < size; i++) {
+		value = (value << 8) | ptr[i];
+	}
+	if (size < sizeof(uint32_t) && (ptr[0] & 0x80)) {
+		value |= ~0u << (size * 8);
+	}
+	return value;
+}
+
+static void column_set_value(unsigned char *ptr, uint8_t size, uint32_t value)
+{
+	while (size-- > 0) {
+		ptr[size] = value & 0xff;
+		value >>= 8;
+	}
+}
+
+static uint32_t column_encode_dod(struct column_bits_s *bits, struct column_block_s *block, const uint32_t *values)
+{
+	uint32_t delta;
+	uint32_t prev;
+	uint16_t i;
+
+	block->base = values[0];
+	block->delta = block->rows > 1 ? values[1] - values[0] : 0;
+	delta = block->delta;
+	for (i = 2; i < block->rows; i++) {
+		prev = delta;
+		delta = values[i] - values[i - 1];
+		dod_put(bits, (int32_t)(delta - prev));
+	}
+	return bits->pos;
+}
+
+static void column_encode_for(struct column_bits_s *bits, struct column_block_s *block, const uint32_t *values)
+{
+	uint16_t i;
+
+	for (i = 0; i < block->rows; i++) {
+		bits_put(bits, values[i] - block->base, block->width);
+	}
+}
+
+/* Chooses the smallest encoding for the values and encodes them into payload */
+static void column_encode(struct column_block_s *block, const uint32_t *values, uint8_t size, unsigned char *payload)
+{
+	struct column_bits_s bits;
+	uint32_t dod_bits;
+	uint32_t for_bits;
+	uint32_t raw_bits;
+	uint32_t range;
+	int32_t min;
+	int32_t max;
+	uint16_t i;
+
+	min = max = (int32_t)values[0];
+	for (i = 1; i < block->rows; i++) {
+		if ((int32_t)values[i] < min) {
+			min = (int32_t)values[i];
+		} else if ((int32_t)values[i] > max) {
+			max = (int32_t)values[i];
+		}
+	}
+	range = (uint32_t)max - (uint32_t)min;
+	for (block->width = 0; block->width < 32 && (range >> block->width) != 0; block->width++) ;
+
+	bits.buf = NULL;
+	bits.pos = 0;
+	dod_bits = column_encode_dod(&bits, block, values);
+	for_bits = (uint32_t)block->rows * block->width;
+	raw_bits = (uint32_t)block->rows * size * 8;
+
+	bits.buf = payload;
+	bits.pos = 0;
+	if (dod_bits < for_bits && dod_bits < raw_bits) {
+		block->encoding = COLUMN_ENCODING_DOD;
+		column_encode_dod(&bits, block, values);
+		block->width = 0;
+	} else if (for_bits < raw_bits) {
+		block->encoding = COLUMN_ENCODING_FOR;
+		block->base = (uint32_t)min;
+		block->delta = 0;
+		column_encode_for(&bits, block, values);
+	} else {
+		block->encoding = COLUMN_ENCODING_RAW;
+		block->base = block->delta = 0;
+		block->width = 0;
+		for (i = 0; i < block->rows; i++) {
+			column_set_value(payload + i * size, size, values[i]);
+		}
+		bits.pos = raw_bits;
+	}
+	block->length = (bits.pos + 7) / 8;
+}
+
+static void column_decode(const struct column_block_s *block, unsigned char *payload, uint8_t size, unsigned char *out)
+{
+	struct column_bits_s bits;
+	uint32_t value;
+	uint32_t delta;
+	uint16_t i;
+
+	bits.buf = payload;
+	bits.pos = 0;
+
+	switch (block->encoding) {
+	case COLUMN_ENCODING_FOR:
+		for (i = 0; i < block->rows; i++) {
+			column_set_value(out + i * size, size, block->base + bits_get(&bits, block->width));
+		}
+		break;
+	case COLUMN_ENCODING_DOD:
+		value = block->base;
+		delta = block->delta;
+		for (i = 0; i < block->rows; i++) {
+			if (i >= 2) {
+				delta += (uint32_t)dod_get(&bits);
+			}
+			if (i >= 1) {
+				value += delta;
+			}
+			column_set_value(out + i * size, size, value);
+		}
+		break;
+	default:
+		memcpy(out, payload, block->rows * size);
+		break;
+	}
+}
+
+/****************************************************************************
+ * Name: column_dir_open
+ *
+ * Description: Opens the directory of a columnar relation and counts the
+ *              rows held in sealed blocks. A relation without directory
+ *              has not sealed any block yet.
+ *
+ ****************************************************************************/
+static db_storage_id_t column_dir_open(const char *name, struct column_dir_s *dir, tuple_id_t *sealed)
+{
+	char path[COLUMN_PATH_LENGTH + 1];
+	db_storage_id_t fd;
+	off_t size;
+	off_t header;
+
+	*sealed = 0;
+	snprintf(path, sizeof(path), "%s%s", name, COLUMN_DIRECTORY_SUFFIX);
+	fd = storage_open(path, O_RDONLY);
+	if (fd < 0) {
+		return INVALID_STORAGE_ID;
+	}
+
+	if (storage_read(fd, dir, sizeof(*dir)) != sizeof(*dir) || dir->columns == 0 || dir->block_rows == 0) {
+		storage_close(fd);
+		return INVALID_STORAGE_ID;
+	}
+
+	header = sizeof(*dir) + dir->columns * sizeof(struct column_desc_s);
+	size = storage_seek(fd, 0, SEEK_END);
+	if (size < header) {
+		storage_close(fd);
+		return INVALID_STORAGE_ID;
+	}
+
+	*sealed = (tuple_id_t)((size - header) / (dir->columns * sizeof(uint32_t))) * dir->block_rows;
+	return fd;
+}
+
+/* Reads the tail header and the number of rows in the tail file */
+static db_result_t column_tail_read(db_storage_id_t fd, unsigned row_length, struct column_tail_s *tail, tuple_id_t *rows)
+{
+	off_t size;
+
+	size = storage_seek(fd, 0, SEEK_END);
+	if (size == (off_t)-1) {
+		return DB_STORAGE_ERROR;
+	}
+	if (size < (off_t)sizeof(*tail)) {
+		/* Emptied by a seal which was cut short */
+		tail->base = INVALID_TUPLE;
+		tail->block_rows = COLUMN_BLOCK_ROWS;
+		*rows = 0;
+		return DB_OK;
+	}
+	if (DB_ERROR(storage_read_from(fd, tail, 0, sizeof(*tail)))) {
+		return DB_STORAGE_ERROR;
+	}
+	*rows = row_length > 0 ? (tuple_id_t)((size - sizeof(*tail)) / row_length) : 0;
+	return DB_OK;
+}
+
+static struct column_cache_s *column_cache_find(const char *name, unsigned offset, tuple_id_t tuple_id)
+{
+	struct column_cache_s *entry;
+	int i;
+
+	for (i = 0; i < COLUMN_CACHE_ENTRIES; i++) {
+		entry = &g_column_cache[i];
+		if (entry->data != NULL && entry->offset == offset && tuple_id >= entry->first && tuple_id - entry->first < entry->rows && strcmp(entry->name, name) == 0) {
+			entry->stamp = ++g_column_clock;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static struct column_cache_s *column_cache_victim(void)
+{
+	struct column_cache_s *victim;
+	int i;
+
+	victim = &g_column_cache[0];
+	for (i = 0; i < COLUMN_CACHE_ENTRIES; i++) {
+		if (g_column_cache[i].data == NULL) {
+			return &g_column_cache[i];
+		}
+		if (g_column_cache[i].stamp < victim->stamp) {
+			victim = &g_column_cache[i];
+		}
+	}
+	return victim;
+}
+
+/****************************************************************************
+ * Name: column_block_load
+ *
+ * Description: Decodes the block holding tuple_id of the column at offset
+ *              into the cache. The directory fd is positioned anywhere.
+ *
+ ****************************************************************************/
+static struct column_cache_s *column_block_load(const char *name, db_storage_id_t dir_fd, struct column_dir_s *dir, unsigned offset, tuple_id_t tuple_id)
+{
+	char path[COLUMN_PATH_LENGTH + 1];
+	struct column_desc_s desc;
+	struct column_block_s block;
+	struct column_cache_s *entry;
+	unsigned char *payload;
+	db_storage_id_t fd;
+	uint32_t position;
+	uint32_t block_no;
+	size_t size;
+	uint8_t column;
+
+	for (column = 0; column < dir->columns; column++) {
+		if (DB_ERROR(storage_read_from(dir_fd, &desc, sizeof(*dir) + column * sizeof(desc), sizeof(desc)))) {
+			return NULL;
+		}
+		if (desc.offset == offset) {
+			break;
+		}
+	}
+	if (column == dir->columns) {
+		DB_LOG_E("DB: No column at offset %u in %s\n", offset, name);
+		return NULL;
+	}
+
+	block_no = tuple_id / dir->block_rows;
+	if (DB_ERROR(storage_read_from(dir_fd, &position, sizeof(*dir) + dir->columns * sizeof(desc) + (block_no * dir->columns + column) * sizeof(position), sizeof(position)))) {
+		return NULL;
+	}
+
+	snprintf(path, sizeof(path), "%s.%u", name, (unsigned)column);
+	fd = storage_open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	payload = NULL;
+	entry = NULL;
+	if (DB_ERROR(storage_read_from(fd, &block, position, sizeof(block))) || block.rows == 0 || block.rows > dir->block_rows) {
+		DB_LOG_E("DB: Broken block %lu of %s\n", (unsigned long)block_no, path);
+		goto out;
+	}
+	payload = (unsigned char *)malloc(block.length + 1);
+	if (payload == NULL) {
+		goto out;
+	}
+	if (block.length > 0 && DB_ERROR(storage_read_from(fd, payload, position + sizeof(block), block.length))) {
+		goto out;
+	}
+
+	entry = column_cache_victim();
+	size = (size_t)block.rows * desc.element_size;
+	if (entry->capacity < size) {
+		if (entry->data != NULL) {
+			free(entry->data);
+		}
+		entry->capacity = 0;
+		entry->data = (unsigned char *)malloc(size);
+		if (entry->data == NULL) {
+			entry = NULL;
+			goto out;
+		}
+		entry->capacity = size;
+	}
+	column_decode(&block, payload, desc.element_size, entry->data);
+
+	strncpy(entry->name, name, sizeof(entry->name) - 1);
+	entry->name[sizeof(entry->name) - 1] = '\0';
+	entry->offset = offset;
+	entry->first = block_no * dir->block_rows;
+	entry->rows = block.rows;
+	entry->element_size = desc.element_size;
+	entry->stamp = ++g_column_clock;
+
+out:
+	if (payload != NULL) {
+		free(payload);
+	}
+	storage_close(fd);
+	return entry;
+}
+
+/* Appends the block of one column of rows to its file */
+static db_result_t column_block_append(const char *name, uint8_t column, attribute_t *attr, unsigned offset, unsigned row_length, unsigned char *rows, uint16_t count, uint32_t *position)
+{
+	char path[COLUMN_PATH_LENGTH + 1];
+	struct column_block_s block;
+	unsigned char *payload;
+	uint32_t *values;
+	db_storage_id_t fd;
+	db_result_t result;
+	off_t end;
+	size_t size;
+	uint16_t i;
+
+	memset(&block, 0, sizeof(block));
+	block.rows = count;
+	size = (size_t)count * attr->element_size;
+	if (size < (size_t)count * DOD_MAX_BYTES) {
+		size = (size_t)count * DOD_MAX_BYTES;
+	}
+	payload = (unsigned char *)malloc(size);
+	if (payload == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+	memset(payload, 0, size);
+
+	if (attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG) {
+		values = (uint32_t *)malloc(count * sizeof(uint32_t));
+		if (values == NULL) {
+			free(payload);
+			return DB_ALLOCATION_ERROR;
+		}
+		for (i = 0; i < count; i++) {
+			values[i] = column_get_value(rows + i * row_length + offset, attr->element_size);
+		}
+		column_encode(&block, values, attr->element_size, payload);
+		free(values);
+	} else {
+		block.encoding = COLUMN_ENCODING_RAW;
+		for (i = 0; i < count; i++) {
+			memcpy(payload + i * attr->element_size, rows + i * row_length + offset, attr->element_size);
+		}
+		block.length = count * attr->element_size;
+	}
+
+	result = DB_STORAGE_ERROR;
+	snprintf(path, sizeof(path), "%s.%u", name, (unsigned)column);
+	fd = storage_open(path, O_RDWR | O_APPEND | O_CREAT);
+	if (fd >= 0) {
+		end = storage_seek(fd, 0, SEEK_END);
+		if (end != (off_t)-1 && storage_write(fd, &block, sizeof(block)) == sizeof(block) && storage_write(fd, payload, block.length) == block.length) {
+			*position = (uint32_t)end;
+			result = DB_OK;
+		}
+		storage_close(fd);
+	}
+	DB_LOG_D("DB: Sealed %u values of %s.%u as %u bytes, encoding %d\n", count, name, column, block.length, block.encoding);
+
+	free(payload);
+	return result;
+}
+
+/****************************************************************************
+ * Name: column_seal
+ *
+ * Description: Moves the sealable rows of the tail into column blocks and
+ *              rewrites the tail with the remaining rows.
+ *
+ ****************************************************************************/
+static db_result_t column_seal(relation_t *rel, struct column_tail_s *tail, tuple_id_t rows)
+{
+	char path[COLUMN_PATH_LENGTH + 1];
+	struct column_dir_s dir;
+	struct column_desc_s desc;
+	uint32_t positions[rel->attribute_count + 1];
+	unsigned char *buffer;
+	attribute_t *attr;
+	db_storage_id_t fd;
+	db_result_t result;
+	tuple_id_t sealed;
+	tuple_id_t skip;
+	unsigned offset;
+	uint8_t column;
+
+	fd = column_dir_open(rel->tuple_filename, &dir, &sealed);
+	if (fd >= 0) {
+		storage_close(fd);
+	} else {
+		memset(&dir, 0, sizeof(dir));
+		dir.block_rows = tail->block_rows;
+		dir.row_length = rel->row_length;
+		dir.columns = rel->attribute_count;
+	}
+	if (tail->base == INVALID_TUPLE) {
+		tail->base = sealed;
+	}
+	if (sealed < tail->base || dir.row_length != rel->row_length || dir.columns != rel->attribute_count) {
+		DB_LOG_E("DB: Directory of %s does not match its tail\n", rel->name);
+		return DB_INCONSISTENCY_ERROR;
+	}
+
+	/* Rows sealed before a power cut are still in the tail */
+	skip = sealed - tail->base;
+	if (skip > rows) {
+		skip = rows;
+	}
+
+	buffer = (unsigned char *)malloc((rows - skip) * rel->row_length + 1);
+	if (buffer == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+	if (rows > skip && DB_ERROR(storage_read_from(rel->tuple_storage, buffer, sizeof(*tail) + skip * rel->row_length, (rows - skip) * rel->row_length))) {
+		free(buffer);
+		return DB_STORAGE_ERROR;
+	}
+
+	result = DB_OK;
+	while (rows - skip >= dir.block_rows) {
+		if (sealed == 0) {
+			/* The first block creates the directory */
+			snprintf(path, sizeof(path), "%s%s", rel->tuple_filename, COLUMN_DIRECTORY_SUFFIX);
+			fd = storage_open(path, O_RDWR | O_APPEND | O_CREAT | O_TRUNC);
+			if (fd < 0) {
+				result = DB_STORAGE_ERROR;
+				break;
+			}
+			result = storage_write(fd, &dir, sizeof(dir)) == sizeof(dir) ? DB_OK : DB_STORAGE_ERROR;
+			offset = 0;
+			for (attr = list_head(rel->attributes); attr != NULL && DB_SUCCESS(result); attr = attr->next) {
+				desc.offset = offset;
+				desc.element_size = attr->element_size;
+				desc.domain = attr->domain;
+				offset += attr->element_size;
+				if (storage_write(fd, &desc, sizeof(desc)) != sizeof(desc)) {
+					result = DB_STORAGE_ERROR;
+				}
+			}
+			storage_close(fd);
+			if (DB_ERROR(result)) {
+				break;
+			}
+		}
+
+		offset = 0;
+		column = 0;
+		for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next, column++) {
+			result = column_block_append(rel->tuple_filename, column, attr, offset, rel->row_length, buffer, dir.block_rows, &positions[column]);
+			if (DB_ERROR(result)) {
+				break;
+			}
+			offset += attr->element_size;
+		}
+		if (DB_ERROR(result)) {
+			break;
+		}
+
+		/* The directory entry commits the block */
+		snprintf(path, sizeof(path), "%s%s", rel->tuple_filename, COLUMN_DIRECTORY_SUFFIX);
+		fd = storage_open(path, O_RDWR | O_APPEND);
+		if (fd < 0) {
+			result = DB_STORAGE_ERROR;
+			break;
+		}
+		if (storage_write(fd, positions, dir.columns * sizeof(uint32_t)) != dir.columns * sizeof(uint32_t)) {
+			result = DB_STORAGE_ERROR;
+		}
+		storage_close(fd);
+		if (DB_ERROR(result)) {
+			break;
+		}
+
+		memmove(buffer, buffer + dir.block_rows * rel->row_length, (rows - skip - dir.block_rows) * rel->row_length);
+		rows -= dir.block_rows;
+		sealed += dir.block_rows;
+	}
+
+	if (DB_SUCCESS(result)) {
+		/* Rewrite the tail with the rows left over, unseen by readers */
+		pthread_mutex_lock(&g_column_lock);
+		storage_close(rel->tuple_storage);
+		rel->tuple_storage = storage_open(rel->tuple_filename, O_RDWR | O_APPEND | O_TRUNC);
+		if (rel->tuple_storage < 0) {
+			result = DB_STORAGE_ERROR;
+		} else {
+			tail->base = sealed;
+			if (storage_write(rel->tuple_storage, tail, sizeof(*tail)) != sizeof(*tail) || (rows > skip && storage_write(rel->tuple_storage, buffer, (rows - skip) * rel->row_length) != (rows - skip) * rel->row_length)) {
+				result = DB_STORAGE_ERROR;
+			}
+		}
+		pthread_mutex_unlock(&g_column_lock);
+	}
+
+	free(buffer);
+	return result;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: storage_column_generate
+ *
+ * Description: Names and creates the empty tail of a new columnar relation.
+ *
+ ****************************************************************************/
+db_result_t storage_column_generate(char *tuple_path)
+{
+	struct column_tail_s tail;
+	db_storage_id_t fd;
+	ssize_t r;
+
+	snprintf(tuple_path, TUPLE_NAME_LENGTH, "%s.%x", COLUMN_FILE_NAME, (unsigned)(random_rand() & 0xffff));
+	fd = storage_open(tuple_path, O_RDWR | O_APPEND | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		DB_LOG_E("DB: Failed to create the tail %s\n", tuple_path);
+		return DB_STORAGE_ERROR;
+	}
+
+	memset(&tail, 0, sizeof(tail));
+	tail.block_rows = COLUMN_BLOCK_ROWS;
+	r = storage_write(fd, &tail, sizeof(tail));
+	storage_close(fd);
+	if (r != sizeof(tail)) {
+		storage_remove(tuple_path);
+		return DB_STORAGE_ERROR;
+	}
+
+	/* Blocks of a dropped relation with the same name must not be reused */
+	storage_column_drop(tuple_path);
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: storage_column_drop
+ *
+ * Description: Removes the column files and the directory which belong to
+ *              a tail. The tail itself is removed by the caller.
+ *
+ ****************************************************************************/
+db_result_t storage_column_drop(const char *name)
+{
+	char path[COLUMN_PATH_LENGTH + 1];
+	struct column_dir_s dir;
+	db_storage_id_t fd;
+	tuple_id_t sealed;
+	uint8_t column;
+	int i;
+
+	pthread_mutex_lock(&g_column_lock);
+	for (i = 0; i < COLUMN_CACHE_ENTRIES; i++) {
+		if (strcmp(g_column_cache[i].name, name) == 0) {
+			g_column_cache[i].name[0] = '\0';
+			g_column_cache[i].rows = 0;
+		}
+	}
+	pthread_mutex_unlock(&g_column_lock);
+
+	fd = column_dir_open(name, &dir, &sealed);
+	if (fd >= 0) {
+		storage_close(fd);
+		for (column = 0; column < dir.columns; column++) {
+			snprintf(path, sizeof(path), "%s.%u", name, (unsigned)column);
+			storage_remove(path);
+		}
+	}
+	snprintf(path, sizeof(path), "%s%s", name, COLUMN_DIRECTORY_SUFFIX);
+	storage_remove(path);
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: storage_column_get_row_amount
+ *
+ * Description: Counts the rows of a columnar relation, sealed or not.
+ *
+ ****************************************************************************/
+db_result_t storage_column_get_row_amount(relation_t *rel, tuple_id_t *amount)
+{
+	struct column_dir_s dir;
+	struct column_tail_s tail;
+	db_storage_id_t fd;
+	tuple_id_t sealed;
+	tuple_id_t rows;
+
+	fd = column_dir_open(rel->tuple_filename, &dir, &sealed);
+	if (fd >= 0) {
+		storage_close(fd);
+	}
+	if (DB_ERROR(column_tail_read(rel->tuple_storage, rel->row_length, &tail, &rows))) {
+		return DB_STORAGE_ERROR;
+	}
+
+	*amount = sealed;
+	if (tail.base != INVALID_TUPLE && tail.base + rows > sealed) {
+		*amount = tail.base + rows;
+	}
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: storage_column_put_row
+ *
+ * Description: Appends a row to the tail and seals the tail once it holds
+ *              a full block.
+ *
+ ****************************************************************************/
+db_result_t storage_column_put_row(relation_t *rel, storage_row_t row)
+{
+	struct column_tail_s tail;
+	tuple_id_t rows;
+
+	if (DB_ERROR(column_tail_read(rel->tuple_storage, rel->row_length, &tail, &rows))) {
+		return DB_STORAGE_ERROR;
+	}
+	if (tail.base == INVALID_TUPLE) {
+		/* Restore the tail header first */
+		if (DB_ERROR(column_seal(rel, &tail, 0))) {
+			return DB_STORAGE_ERROR;
+		}
+		rows = 0;
+	}
+
+	if (storage_seek(rel->tuple_storage, 0, SEEK_END) == (off_t)-1 || storage_write(rel->tuple_storage, row, rel->row_length) != rel->row_length) {
+		DB_LOG_E("DB: Failed to store %u bytes\n", rel->row_length);
+		return DB_STORAGE_ERROR;
+	}
+
+	if (rows + 1 >= tail.block_rows) {
+		return column_seal(rel, &tail, rows + 1);
+	}
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Name: storage_column_read
+ *
+ * Description: Reads size bytes at offset of row tuple_id of the columnar
+ *              relation whose tail is name. fd is the tail opened by the
+ *              caller, or INVALID_STORAGE_ID to open it here. Returns
+ *              DB_FINISHED beyond the last row.
+ *
+ ****************************************************************************/
+db_result_t storage_column_read(const char *name, db_storage_id_t fd, unsigned row_length, unsigned offset, unsigned size, tuple_id_t tuple_id, unsigned char *buf)
+{
+	struct column_cache_s *entry;
+	struct column_dir_s dir;
+	struct column_tail_s tail;
+	db_storage_id_t tail_fd;
+	db_storage_id_t dir_fd;
+	db_result_t result;
+	tuple_id_t sealed;
+	tuple_id_t rows;
+
+	/* A writer sealing the tail rewrites it under the lock as well */
+	pthread_mutex_lock(&g_column_lock);
+	entry = column_cache_find(name, offset, tuple_id);
+	if (entry != NULL) {
+		memcpy(buf, entry->data + (tuple_id - entry->first) * entry->element_size, size < entry->element_size ? size : entry->element_size);
+		pthread_mutex_unlock(&g_column_lock);
+		return DB_OK;
+	}
+
+	tail_fd = fd >= 0 ? fd : storage_open(name, O_RDONLY);
+	if (tail_fd < 0) {
+		pthread_mutex_unlock(&g_column_lock);
+		return DB_STORAGE_ERROR;
+	}
+	result = column_tail_read(tail_fd, row_length, &tail, &rows);
+	if (DB_ERROR(result)) {
+		goto out;
+	}
+
+	if (tail.base != INVALID_TUPLE && tuple_id >= tail.base) {
+		/* Rows the tail still holds after a cut short seal are identical
+		   to their sealed copies, so the tail is read whenever it can. */
+		if (tuple_id - tail.base >= rows) {
+			result = DB_FINISHED;
+		} else {
+			result = storage_read_from(tail_fd, buf, sizeof(tail) + (tuple_id - tail.base) * row_length + offset, size);
+		}
+		goto out;
+	}
+
+	dir_fd = column_dir_open(name, &dir, &sealed);
+	if (tuple_id >= sealed) {
+		result = DB_FINISHED;
+	} else {
+		entry = column_block_load(name, dir_fd, &dir, offset, tuple_id);
+		if (entry == NULL) {
+			result = DB_STORAGE_ERROR;
+		} else {
+			memcpy(buf, entry->data + (tuple_id - entry->first) * entry->element_size, size < entry->element_size ? size : entry->element_size);
+		}
+	}
+	if (dir_fd >= 0) {
+		storage_close(dir_fd);
+	}
+
+out:
+	if (tail_fd != fd) {
+		storage_close(tail_fd);
+	}
+	pthread_mutex_unlock(&g_column_lock);
+	return result;
+}
+
+/****************************************************************************
+ * Name: storage_column_get_row
+ *
+ * Description: Assembles row tuple_id of a columnar relation.
+ *
+ ****************************************************************************/
+db_result_t storage_column_get_row(relation_t *rel, tuple_id_t tuple_id, storage_row_t row)
+{
+	attribute_t *attr;
+	db_result_t result;
+	unsigned offset;
+
+	offset = 0;
+	for (attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+		result = storage_column_read(rel->tuple_filename, rel->tuple_storage, rel->row_length, offset, attr->element_size, tuple_id, row + offset);
+		if (result != DB_OK) {
+			return result;
+		}
+		offset += attr->element_size;
+	}
+	return DB_OK;
+}
+
+void storage_column_deinit(void)
+{
+	int i;
+
+	pthread_mutex_lock(&g_column_lock);
+	for (i = 0; i < COLUMN_CACHE_ENTRIES; i++) {
+		if (g_column_cache[i].data != NULL) {
+			free(g_column_cache[i].data);
+		}
+		memset(&g_column_cache[i], 0, sizeof(g_column_cache[i]));
+	}
+	pthread_mutex_unlock(&g_column_lock);
+}
+
+#endif							/* CONFIG_ARASTORAGE_ENABLE_COLUMNAR */
@@ -68,6 +68,12 @@
 #include "random.h"
 #include "storage.h"
 
+/****************************************************************************
+* Pre-processor Definitions
+****************************************************************************/
+/* Long enough for a relation name and the prefix of volatile files */
+#define RELATION_FILE_LENGTH (RELATION_NAME_LENGTH + sizeof(MEMORY_FILE_PREFIX))
+
 /****************************************************************************
 * Private Types
 ****************************************************************************/
@@ -83,6 +89,22 @@ struct index_record_s {
 	uint8_t type;
 };
 
+/****************************************************************************
+* Public Data
+****************************************************************************/
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+struct insert_buffer_s g_storage_write_buffer;
+#endif
+
+/****************************************************************************
+* Private Functions
+****************************************************************************/
+/* Names the file describing rel, which is kept in RAM if rel is volatile */
+static void relation_file_name(relation_t *rel, char *name)
+{
+	snprintf(name, RELATION_FILE_LENGTH, "%s%s", STORAGE_FILE_PREFIX(rel), rel->name);
+}
+
 /****************************************************************************
 * Public Functions
 ****************************************************************************/
@@ -142,6 +164,24 @@ db_result_t storage_generate_file(char *filename)
 	return DB_OK;
 }
 
+/*
+ * Names a new tuple or index file of rel after base and a random number.
+ * The files of a volatile relation get the prefix which keeps them in RAM.
+ */
+void storage_name_file(relation_t *rel, char *name, size_t size, const char *base)
+{
+	snprintf(name, size, "%s%s.%x", STORAGE_FILE_PREFIX(rel), base, (unsigned)(random_rand() & 0xffff));
+}
+
+/* Opens the file describing rel, which names its tuple file */
+db_storage_id_t storage_open_relation(relation_t *rel, int oflag)
+{
+	char name[RELATION_FILE_LENGTH];
+
+	relation_file_name(rel, name);
+	return storage_open(name, oflag);
+}
+
 db_result_t storage_load(relation_t *rel)
 {
 	rel->tuple_storage = storage_open(rel->tuple_filename, O_APPEND | O_RDWR);
@@ -171,12 +211,26 @@ db_result_t storage_get_relation(relation_t *rel, char *name)
 	int fd;
 	ssize_t r;
 	int i;
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	char path[RELATION_FILE_LENGTH];
+#endif
 
 	struct attribute_record_s record;
 	db_result_t result;
 
 	DB_LOG_D("DB: relation : %s\n", name);
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	/* Volatile relations are looked up first, which spares the file system */
+	snprintf(path, sizeof(path), "%s%s", MEMORY_FILE_PREFIX, name);
+	fd = storage_open(path, O_RDONLY);
+	if (fd >= 0) {
+		rel->dir = DB_VOLATILE;
+	} else {
+		fd = storage_open(name, O_RDONLY);
+	}
+#else
 	fd = storage_open(name, O_RDONLY);
+#endif
 	if (fd < 0) {
 		return DB_STORAGE_ERROR;
 	}
@@ -222,16 +276,18 @@ db_result_t storage_put_relation(relation_t *rel)
 	ssize_t r;
 	db_result_t result;
 	char tuple_path[TUPLE_NAME_LENGTH];
+	char name[RELATION_FILE_LENGTH];
 
-	storage_remove(rel->name);
+	relation_file_name(rel, name);
+	storage_remove(name);
 
-	fd = storage_open(rel->name, O_RDWR | O_APPEND | O_CREAT | O_TRUNC);
+	fd = storage_open_relation(rel, O_RDWR | O_APPEND | O_CREAT | O_TRUNC);
 	if (fd < 0) {
 		return DB_STORAGE_ERROR;
 	}
 
 	if (rel->tuple_filename[0] == '\0') {
-		snprintf(tuple_path, TUPLE_NAME_LENGTH, "%s.%x\0", TUPLE_FILE_NAME, (unsigned)(random_rand() & 0xffff));
+		storage_name_file(rel, tuple_path, TUPLE_NAME_LENGTH, TUPLE_FILE_NAME);
 		result = storage_generate_file(tuple_path);
 		if (DB_ERROR(result)) {
 			storage_close(fd);
@@ -262,7 +318,7 @@ db_result_t storage_put_attribute(relation_t *rel, attribute_t *attr)
 
 	DB_LOG_D("DB: put_attribute(%s, %s)\n", rel->name, attr->name);
 
-	fd = storage_open(rel->name, O_RDWR | O_APPEND);
+	fd = storage_open_relation(rel, O_RDWR | O_APPEND);
 	if (fd < 0) {
 		return DB_STORAGE_ERROR;
 	}
@@ -274,7 +330,10 @@ db_result_t storage_put_attribute(relation_t *rel, attribute_t *attr)
 	r = storage_write(fd, &record, sizeof(record));
 	storage_close(fd);
 	if (r != sizeof(record)) {
-		storage_remove(rel->name);
+		char name[RELATION_FILE_LENGTH];
+
+		relation_file_name(rel, name);
+		storage_remove(name);
 		return DB_STORAGE_ERROR;
 	}
 	return DB_OK;
@@ -282,6 +341,8 @@ db_result_t storage_put_attribute(relation_t *rel, attribute_t *attr)
 
 db_result_t storage_drop_relation(relation_t *rel, int remove_tuples)
 {
+	char name[RELATION_FILE_LENGTH];
+
 	DB_LOG_D("Unlink rel = %s, tuple = %s\n", rel->name, rel->tuple_filename);
 	if (remove_tuples && RELATION_HAS_TUPLES(rel)) {
 		storage_close(rel->tuple_storage);
@@ -289,10 +350,16 @@ db_result_t storage_drop_relation(relation_t *rel, int remove_tuples)
 			DB_LOG_D("Failed to remove tuple file : %s\n", rel->tuple_filename);
 			return DB_STORAGE_ERROR;
 		}
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+		if (RELATION_IS_COLUMNAR(rel)) {
+			storage_column_drop(rel->tuple_filename);
+		}
+#endif
 	}
 
-	if (DB_ERROR(storage_remove(rel->name))) {
-		DB_LOG_D("Failed to remove relation file : %s\n", rel->name);
+	relation_file_name(rel, name);
+	if (DB_ERROR(storage_remove(name))) {
+		DB_LOG_D("Failed to remove relation file : %s\n", name);
 		return DB_STORAGE_ERROR;
 	}
 
@@ -320,12 +387,12 @@ db_result_t storage_get_index(index_t *index, relation_t *rel, attribute_t *attr
 	db_result_t result;
 	int len;
 
-	len = strlen(rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
+	len = strlen(STORAGE_FILE_PREFIX(rel)) + strlen(rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
 	filename = (char *)malloc(sizeof(char) * len);
 	if (filename == NULL) {
 		return DB_ALLOCATION_ERROR;
 	}
-	snprintf(filename, len, "%s%s\0", rel->name, INDEX_NAME_SUFFIX);
+	snprintf(filename, len, "%s%s%s\0", STORAGE_FILE_PREFIX(rel), rel->name, INDEX_NAME_SUFFIX);
 	fd = storage_open(filename, O_RDONLY);
 	if (fd < 0) {
 		free(filename);
@@ -358,13 +425,13 @@ db_result_t storage_put_index(index_t *index)
 	struct index_record_s record;
 	int len;
 
-	len = strlen(index->rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
+	len = strlen(STORAGE_FILE_PREFIX(index->rel)) + strlen(index->rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
 
 	filename = (char *)malloc(sizeof(char) * len);
 	if (filename == NULL) {
 		return DB_ALLOCATION_ERROR;
 	}
-	snprintf(filename, len, "%s%s\0", index->rel->name, INDEX_NAME_SUFFIX);
+	snprintf(filename, len, "%s%s%s\0", STORAGE_FILE_PREFIX(index->rel), index->rel->name, INDEX_NAME_SUFFIX);
 	fd = storage_open(filename, O_WROK | O_APPEND | O_CREAT);
 	if (fd < 0) {
 		free(filename);
@@ -400,12 +467,12 @@ db_result_t storage_remove_index(relation_t *rel, attribute_t *attr)
 	size_t offset;
 	db_result_t res;
 
-	len = strlen(rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
+	len = strlen(STORAGE_FILE_PREFIX(rel)) + strlen(rel->name) + strlen(INDEX_NAME_SUFFIX) + 1;
 	filename = malloc(sizeof(char) * len);
 	if (filename == NULL) {
 		return DB_STORAGE_ERROR;
 	}
-	snprintf(filename, len, "%s%s\0", rel->name, INDEX_NAME_SUFFIX);
+	snprintf(filename, len, "%s%s%s\0", STORAGE_FILE_PREFIX(rel), rel->name, INDEX_NAME_SUFFIX);
 	fd = storage_open(filename, O_RDONLY);
 	if (fd < 0) {
 		free(filename);
@@ -434,7 +501,7 @@ db_result_t storage_remove_index(relation_t *rel, attribute_t *attr)
 			storage_close(fd);
 			return DB_STORAGE_ERROR;
 		}
-		snprintf(new_filename, len, "%s%s%s\0", rel->name, INDEX_NAME_SUFFIX, TEMP_FILE_SUFFIX);
+		snprintf(new_filename, len, "%s%s\0", filename, TEMP_FILE_SUFFIX);
 		res = storage_generate_file(new_filename);
 		if (DB_ERROR(res)) {
 			free(filename);
@@ -493,6 +560,11 @@ db_result_t storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t
 	ssize_t r;
 	tuple_id_t nrows;
 
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		return storage_column_get_row(rel, *tuple_id, row);
+	}
+#endif
 	if (DB_ERROR(storage_get_row_amount(rel, &nrows))) {
 		return DB_STORAGE_ERROR;
 	}
@@ -530,7 +602,16 @@ db_result_t storage_put_row(relation_t *rel, storage_row_t row, uint8_t flag)
 	unsigned length;
 
 	length = rel->row_length;
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	if (RELATION_IS_COLUMNAR(rel)) {
+		/* The tail bypasses the insert buffer, sealing reads it back */
+		result = storage_column_put_row(rel, row);
+	} else {
+		result = storage_write_row(rel->tuple_storage, row, length, rel->tuple_filename);
+	}
+#else
 	result = storage_write_row(rel->tuple_storage, row, length, rel->tuple_filename);
+#endif
 
 	if (DB_ERROR(result)) {
 		DB_LOG_D("DB: Failed to store %u bytes\n", length);
@@ -545,22 +626,28 @@ db_result_t storage_put_row(relation_t *rel, storage_row_t row, uint8_t flag)
 db_result_t storage_write_row(db_storage_id_t fd, storage_row_t row, unsigned length, char *filename)
 {
 #ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
-	if (strncmp(g_storage_write_buffer.file_name, filename, TUPLE_NAME_LENGTH) != 0) {
-		storage_flush_insert_buffer();
-	}
-	if ((g_storage_write_buffer.data_size + length) >= storage_get_write_buffer_size()) {
-		storage_flush_insert_buffer();
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+	/* Rows of volatile relations go straight to RAM */
+	if (!STORAGE_ID_IS_MEMORY(fd))
+#endif
+	{
+		if (strncmp(g_storage_write_buffer.file_name, filename, TUPLE_NAME_LENGTH) != 0) {
+			storage_flush_insert_buffer();
+		}
+		if ((g_storage_write_buffer.data_size + length) >= storage_get_write_buffer_size()) {
+			storage_flush_insert_buffer();
+		}
+		memcpy(g_storage_write_buffer.buffer + g_storage_write_buffer.data_size, row, length);
+		g_storage_write_buffer.data_size += length;
+		memcpy(g_storage_write_buffer.file_name, filename, strlen(filename));
+		return DB_OK;
 	}
-	memcpy(g_storage_write_buffer.buffer + g_storage_write_buffer.data_size, row, length);
-	g_storage_write_buffer.data_size += length;
-	memcpy(g_storage_write_buffer.file_name, filename, strlen(filename));
-#else
+#endif
 	if (storage_write(fd, row, length) < 0) {
 		DB_LOG_D("DB: Failed to store %u bytes\n", length);
 		return DB_STORAGE_ERROR;
 	}
 	DB_LOG_D("DB: Stored a of %d bytes\n", length);
-#endif
 
 	return DB_OK;
 }
@@ -599,6 +686,10 @@ db_result_t storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 
 	if (rel->row_length == 0) {
 		*amount = 0;
+#ifdef CONFIG_ARASTORAGE_ENABLE_COLUMNAR
+	} else if (RELATION_IS_COLUMNAR(rel)) {
+		return storage_column_get_row_amount(rel, amount);
+#endif
 	} else {
 		offset = storage_seek(rel->tuple_storage, 0, SEEK_END);
 		if (offset == (off_t)-1) {
@@ -0,0 +1,411 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      Files kept in RAM for volatile relations.
+ *
+ *      A relation created with "CREATE RELATION name TYPE MEMORY" names
+ *      its relation, tuple and index files with MEMORY_FILE_PREFIX. The
+ *      storage abstraction hands such files to this module instead of
+ *      the file system, so the rest of the database reads and writes
+ *      them through the usual descriptors, and they never reach the
+ *      flash nor the page cache.
+ *
+ *      The data of a file grows in chunks of
+ *      CONFIG_ARASTORAGE_MEMORY_CHUNK_SIZE bytes, and all files together
+ *      never hold more than CONFIG_ARASTORAGE_MEMORY_SIZE bytes. A write
+ *      beyond that limit fails like a write to a full file system.
+ *      Every file is dropped by db_deinit().
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <tinyara/config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "db_options.h"
+#include "db_debug.h"
+#include "list.h"
+#include "memb.h"
+#include "storage.h"
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define MEMORY_CHUNK_SIZE   CONFIG_ARASTORAGE_MEMORY_CHUNK_SIZE
+#define MEMORY_SIZE         CONFIG_ARASTORAGE_MEMORY_SIZE
+#define MEMORY_NONE         NULL
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+struct memory_file_s {
+	struct memory_file_s *next;
+	char name[MEMORY_FILE_NAME_LENGTH];
+	unsigned char *data;
+	size_t size;
+	size_t capacity;
+	uint8_t refs;				/* Number of open descriptors */
+	uint8_t linked;				/* Whether the file can still be opened by name */
+};
+typedef struct memory_file_s memory_file_t;
+
+struct memory_handle_s {
+	memory_file_t *file;		/* MEMORY_NONE if unused */
+	uint8_t append;
+	uint8_t writable;
+	off_t pos;
+};
+typedef struct memory_handle_s memory_handle_t;
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+LIST(memory_files);
+MEMB(memory_files_memb, memory_file_t, DB_MEMORY_FILE_LIMIT);
+
+static memory_handle_t g_handles[DB_MEMORY_HANDLE_LIMIT];
+static size_t g_memory_used;	/* Bytes allocated for the data of every file */
+static pthread_mutex_t g_memory_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static memory_handle_t *handle_find(db_storage_id_t fd)
+{
+	int idx = fd - STORAGE_MEMORY_ID_BASE;
+
+	if (idx < 0 || idx >= DB_MEMORY_HANDLE_LIMIT || g_handles[idx].file == MEMORY_NONE) {
+		return NULL;
+	}
+	return &g_handles[idx];
+}
+
+static memory_file_t *file_find(const char *name)
+{
+	memory_file_t *file;
+
+	for (file = list_head(memory_files); file != NULL; file = file->next) {
+		if (strncmp(file->name, name, sizeof(file->name)) == 0) {
+			return file;
+		}
+	}
+	return NULL;
+}
+
+static void file_free(memory_file_t *file)
+{
+	g_memory_used -= file->capacity;
+	free(file->data);
+	memb_free(&memory_files_memb, file);
+}
+
+/* Makes a file unreachable by name; it is freed once its last descriptor is closed. */
+static void file_unlink(memory_file_t *file)
+{
+	list_remove(memory_files, file);
+	file->linked = FALSE;
+	if (file->refs == 0) {
+		file_free(file);
+	}
+}
+
+/* Grows the data of a file so that it holds at least size bytes. */
+static db_result_t file_reserve(memory_file_t *file, size_t size)
+{
+	unsigned char *data;
+	size_t capacity;
+
+	if (size <= file->capacity) {
+		return DB_OK;
+	}
+
+	capacity = (size + MEMORY_CHUNK_SIZE - 1) / MEMORY_CHUNK_SIZE * MEMORY_CHUNK_SIZE;
+	if (g_memory_used - file->capacity + capacity > MEMORY_SIZE) {
+		DB_LOG_E("DB: Out of memory for volatile file %s\n", file->name);
+		return DB_FULL_ERROR;
+	}
+
+	data = (unsigned char *)realloc(file->data, capacity);
+	if (data == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+	g_memory_used += capacity - file->capacity;
+	file->data = data;
+	file->capacity = capacity;
+	return DB_OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+db_result_t storage_memory_init(void)
+{
+	int i;
+
+	pthread_mutex_lock(&g_memory_lock);
+	list_init(memory_files);
+	memb_init(&memory_files_memb);
+	for (i = 0; i < DB_MEMORY_HANDLE_LIMIT; i++) {
+		g_handles[i].file = MEMORY_NONE;
+	}
+	g_memory_used = 0;
+	pthread_mutex_unlock(&g_memory_lock);
+
+	return DB_OK;
+}
+
+/* Drops every volatile file, including those still open. */
+void storage_memory_deinit(void)
+{
+	memory_file_t *file;
+	int i;
+
+	pthread_mutex_lock(&g_memory_lock);
+	for (i = 0; i < DB_MEMORY_HANDLE_LIMIT; i++) {
+		if (g_handles[i].file != MEMORY_NONE) {
+			g_handles[i].file->refs--;
+			if (!g_handles[i].file->linked && g_handles[i].file->refs == 0) {
+				file_free(g_handles[i].file);
+			}
+			g_handles[i].file = MEMORY_NONE;
+		}
+	}
+	while ((file = list_pop(memory_files)) != NULL) {
+		file->linked = FALSE;
+		file_free(file);
+	}
+	pthread_mutex_unlock(&g_memory_lock);
+}
+
+db_storage_id_t storage_memory_open(const char *name, int oflag)
+{
+	memory_file_t *file;
+	int i;
+
+	if (strlen(name) >= MEMORY_FILE_NAME_LENGTH) {
+		return INVALID_STORAGE_ID;
+	}
+
+	pthread_mutex_lock(&g_memory_lock);
+	for (i = 0; i < DB_MEMORY_HANDLE_LIMIT && g_handles[i].file != MEMORY_NONE; i++) ;
+	if (i == DB_MEMORY_HANDLE_LIMIT) {
+		pthread_mutex_unlock(&g_memory_lock);
+		DB_LOG_E("DB: Too many volatile files are open\n");
+		return INVALID_STORAGE_ID;
+	}
+
+	file = file_find(name);
+	if (file == NULL) {
+		if (!(oflag & O_CREAT)) {
+			pthread_mutex_unlock(&g_memory_lock);
+			return INVALID_STORAGE_ID;
+		}
+		file = (memory_file_t *)memb_alloc(&memory_files_memb);
+		if (file == NULL) {
+			pthread_mutex_unlock(&g_memory_lock);
+			DB_LOG_E("DB: Too many volatile files\n");
+			return INVALID_STORAGE_ID;
+		}
+		memset(file, 0, sizeof(memory_file_t));
+		strncpy(file->name, name, sizeof(file->name) - 1);
+		file->linked = TRUE;
+		list_add(memory_files, file);
+	} else if ((oflag & O_TRUNC) && (oflag & O_ACCMODE) != O_RDONLY) {
+		file->size = 0;
+	}
+
+	file->refs++;
+	g_handles[i].file = file;
+	g_handles[i].append = (oflag & O_APPEND) != 0;
+	g_handles[i].writable = (oflag & O_ACCMODE) != O_RDONLY;
+	g_handles[i].pos = 0;
+	pthread_mutex_unlock(&g_memory_lock);
+
+	return STORAGE_MEMORY_ID_BASE + i;
+}
+
+db_storage_id_t storage_memory_close(db_storage_id_t fd)
+{
+	memory_handle_t *handle;
+	memory_file_t *file;
+
+	pthread_mutex_lock(&g_memory_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return INVALID_STORAGE_ID;
+	}
+
+	file = handle->file;
+	handle->file = MEMORY_NONE;
+	if (--file->refs == 0 && !file->linked) {
+		file_free(file);
+	}
+	pthread_mutex_unlock(&g_memory_lock);
+
+	return OK;
+}
+
+db_result_t storage_memory_remove(const char *name)
+{
+	memory_file_t *file;
+
+	pthread_mutex_lock(&g_memory_lock);
+	file = file_find(name);
+	if (file != NULL) {
+		file_unlink(file);
+	}
+	pthread_mutex_unlock(&g_memory_lock);
+
+	return file != NULL ? DB_OK : DB_STORAGE_ERROR;
+}
+
+db_result_t storage_memory_rename(const char *old_name, const char *new_name)
+{
+	memory_file_t *file;
+	memory_file_t *target;
+
+	if (strlen(new_name) >= MEMORY_FILE_NAME_LENGTH) {
+		return DB_STORAGE_ERROR;
+	}
+
+	pthread_mutex_lock(&g_memory_lock);
+	file = file_find(old_name);
+	if (file == NULL) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return DB_STORAGE_ERROR;
+	}
+
+	/* Like rename(), an existing file of the new name is replaced */
+	target = file_find(new_name);
+	if (target != NULL && target != file) {
+		file_unlink(target);
+	}
+	memset(file->name, 0, sizeof(file->name));
+	strncpy(file->name, new_name, sizeof(file->name) - 1);
+	pthread_mutex_unlock(&g_memory_lock);
+
+	return DB_OK;
+}
+
+off_t storage_memory_seek(db_storage_id_t fd, unsigned long offset, int whence)
+{
+	memory_handle_t *handle;
+	off_t pos;
+
+	pthread_mutex_lock(&g_memory_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return (off_t)-1;
+	}
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = handle->pos + offset;
+		break;
+	case SEEK_END:
+		pos = handle->file->size + offset;
+		break;
+	default:
+		pos = (off_t)-1;
+		break;
+	}
+	if (pos >= 0) {
+		handle->pos = pos;
+	}
+
+	pthread_mutex_unlock(&g_memory_lock);
+	return pos;
+}
+
+ssize_t storage_memory_read(db_storage_id_t fd, void *buffer, unsigned length)
+{
+	memory_handle_t *handle;
+	memory_file_t *file;
+
+	pthread_mutex_lock(&g_memory_lock);
+	handle = handle_find(fd);
+	if (handle == NULL) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return -1;
+	}
+
+	file = handle->file;
+	if (handle->pos >= file->size) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return 0;
+	}
+	if (handle->pos + length > file->size) {
+		length = file->size - handle->pos;
+	}
+	memcpy(buffer, file->data + handle->pos, length);
+	handle->pos += length;
+
+	pthread_mutex_unlock(&g_memory_lock);
+	return length;
+}
+
+ssize_t storage_memory_write(db_storage_id_t fd, void *buffer, unsigned length)
+{
+	memory_handle_t *handle;
+	memory_file_t *file;
+
+	pthread_mutex_lock(&g_memory_lock);
+	handle = handle_find(fd);
+	if (handle == NULL || !handle->writable) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return -1;
+	}
+
+	file = handle->file;
+	if (handle->append) {
+		handle->pos = file->size;
+	}
+	if (DB_ERROR(file_reserve(file, handle->pos + length))) {
+		pthread_mutex_unlock(&g_memory_lock);
+		return -1;
+	}
+
+	/* A gap left by seeking beyond the end reads back as zeros */
+	if (handle->pos > file->size) {
+		memset(file->data + file->size, 0, handle->pos - file->size);
+	}
+	memcpy(file->data + handle->pos, buffer, length);
+	handle->pos += length;
+	if (handle->pos > file->size) {
+		file->size = handle->pos;
+	}
+
+	pthread_mutex_unlock(&g_memory_lock);
+	return length;
+}
+
+#endif							/* CONFIG_ARASTORAGE_ENABLE_MEMORY_RELATIONS */
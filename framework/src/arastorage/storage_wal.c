@@ -0,0 +1,452 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+
+/**
+ * \file
+ *      A write-ahead log for inserted tuples.
+ *
+ *      Every row stored by relation_insert() is appended to a single log
+ *      file as a checksummed record before it reaches the tuple file.
+ *      Records are collected in RAM and committed with one write and one
+ *      fsync once CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_COUNT records are
+ *      pending or the oldest pending record is older than
+ *      CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_MS (group commit).
+ *
+ *      When the log grows beyond CONFIG_ARASTORAGE_WAL_CHECKPOINT_SIZE the
+ *      insert buffer and the page cache are written back and the log is
+ *      truncated. On db_init() the records of the log are replayed, so
+ *      rows still held in the insert buffer or page cache at a power cut
+ *      are restored. A torn record at the end of the log ends the replay.
+ *      Index updates are not logged; the indexes of every relation found
+ *      in the log are rebuilt from its tuples after the replay.
+ *
+ *      The log is written with plain POSIX calls on purpose: it is never
+ *      read back during normal operation and must not take pages from
+ *      the page cache.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <tinyara/config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <crc32.h>
+#ifdef CONFIG_SCHED_WORKQUEUE
+#include <tinyara/clock.h>
+#include <tinyara/wqueue.h>
+#endif
+
+#include "db_options.h"
+#include "db_debug.h"
+#include "relation.h"
+#include "storage.h"
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define WAL_RECORD_MAGIC    0x57414c52	/* "WALR" */
+#define WAL_BUFFER_SIZE     CONFIG_ARASTORAGE_WAL_BUFFER_SIZE
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+struct wal_record_s {
+	uint32_t magic;
+	uint32_t crc;				/* Over the record with crc = 0, followed by the row */
+	tuple_id_t tuple_id;
+	uint16_t length;			/* Length of the row following the record */
+	uint16_t reserved;
+	char relation[RELATION_NAME_LENGTH + 1];
+};
+
+typedef struct wal_record_s wal_record_t;
+
+struct wal_s {
+	int fd;
+	unsigned char *buffer;		/* Records waiting for the next commit */
+	size_t used;
+	unsigned pending;			/* Number of records in buffer */
+	off_t size;					/* Bytes committed to the log file */
+	struct timespec first;		/* When the oldest pending record was logged */
+#ifdef CONFIG_SCHED_WORKQUEUE
+	struct work_s work;
+#endif
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static struct wal_s g_wal = { .fd = -1 };
+static pthread_mutex_t g_wal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static int wal_open(int oflag)
+{
+	char *path;
+	int fd;
+
+	path = (char *)malloc(DB_MAX_FILENAME_LENGTH);
+	if (path == NULL) {
+		return -1;
+	}
+	snprintf(path, DB_MAX_FILENAME_LENGTH, "%s%s", CONFIG_MOUNT_POINT, WAL_FILE_NAME);
+	fd = open(path, oflag, 0666);
+	free(path);
+	return fd;
+}
+
+static uint32_t wal_checksum(wal_record_t *record, unsigned char *row)
+{
+	uint32_t saved;
+	uint32_t crc;
+
+	saved = record->crc;
+	record->crc = 0;
+	crc = crc32((uint8_t *)record, sizeof(wal_record_t));
+	crc = crc32part(row, record->length, crc);
+	record->crc = saved;
+	return crc;
+}
+
+static long wal_pending_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - g_wal.first.tv_sec) * 1000 + (now.tv_nsec - g_wal.first.tv_nsec) / 1000000;
+}
+
+static db_result_t wal_write(void *buffer, size_t length)
+{
+	unsigned char *ptr = buffer;
+	ssize_t r;
+
+	while (length > 0) {
+		r = write(g_wal.fd, ptr, length);
+		if (r <= 0) {
+			return DB_STORAGE_ERROR;
+		}
+		ptr += r;
+		length -= r;
+		g_wal.size += r;
+	}
+	return DB_OK;
+}
+
+/* Writes the pending records with one write and makes them durable. */
+static db_result_t wal_commit(void)
+{
+	if (g_wal.pending == 0) {
+		return DB_OK;
+	}
+
+	if (DB_ERROR(wal_write(g_wal.buffer, g_wal.used)) || fsync(g_wal.fd) < 0) {
+		DB_LOG_E("DB: Failed to commit %u log records\n", g_wal.pending);
+		return DB_STORAGE_ERROR;
+	}
+
+	DB_LOG_D("DB: Committed %u log records (%d bytes)\n", g_wal.pending, g_wal.used);
+	g_wal.used = 0;
+	g_wal.pending = 0;
+	return DB_OK;
+}
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+/* Commits a batch which did not fill up within the group commit period. */
+static void wal_timeout_worker(FAR void *arg)
+{
+	pthread_mutex_lock(&g_wal_lock);
+	if (g_wal.fd >= 0) {
+		wal_commit();
+	}
+	pthread_mutex_unlock(&g_wal_lock);
+}
+#endif
+
+/* Adds name to the relations replayed so far unless it is there already. */
+static db_result_t wal_replayed(char (**names)[RELATION_NAME_LENGTH + 1], unsigned *nnames, char *name)
+{
+	char (*grown)[RELATION_NAME_LENGTH + 1];
+	unsigned i;
+
+	for (i = 0; i < *nnames; i++) {
+		if (strcmp((*names)[i], name) == 0) {
+			return DB_OK;
+		}
+	}
+	grown = realloc(*names, (*nnames + 1) * sizeof(**names));
+	if (grown == NULL) {
+		return DB_ALLOCATION_ERROR;
+	}
+	memcpy(grown[*nnames], name, sizeof(*grown));
+	*names = grown;
+	(*nnames)++;
+	return DB_OK;
+}
+
+static db_result_t wal_replay(void)
+{
+	wal_record_t record;
+	char (*names)[RELATION_NAME_LENGTH + 1] = NULL;
+	unsigned nnames = 0;
+	unsigned char *row = NULL;
+	unsigned char *grown;
+	unsigned row_size = 0;
+	unsigned count = 0;
+	db_result_t result = DB_OK;
+	ssize_t r;
+	unsigned i;
+
+	for (;;) {
+		r = read(g_wal.fd, &record, sizeof(wal_record_t));
+		if (r != sizeof(wal_record_t) || record.magic != WAL_RECORD_MAGIC) {
+			break;
+		}
+		if (record.length > row_size) {
+			grown = (unsigned char *)realloc(row, record.length);
+			if (grown == NULL) {
+				result = DB_ALLOCATION_ERROR;
+				break;
+			}
+			row = grown;
+			row_size = record.length;
+		}
+		r = read(g_wal.fd, row, record.length);
+		if (r != record.length || wal_checksum(&record, row) != record.crc) {
+			DB_LOG_E("DB: Torn log record after %u records\n", count);
+			break;
+		}
+		record.relation[RELATION_NAME_LENGTH] = '\0';
+		if (DB_ERROR(relation_replay(record.relation, record.tuple_id, row, record.length))) {
+			DB_LOG_E("DB: Failed to replay a row of %s\n", record.relation);
+		}
+		if (DB_ERROR(wal_replayed(&names, &nnames, record.relation))) {
+			result = DB_ALLOCATION_ERROR;
+			break;
+		}
+		count++;
+	}
+	DB_LOG_D("DB: Replayed %u log records\n", count);
+
+	/* Index updates are not logged; rebuild the indexes from the recovered tuples */
+	for (i = 0; i < nnames; i++) {
+		if (DB_ERROR(relation_reindex(names[i]))) {
+			DB_LOG_E("DB: Failed to rebuild the indexes of %s\n", names[i]);
+		}
+	}
+
+	free(names);
+	free(row);
+	return result;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: storage_wal_init
+ *
+ * Description: Opens the log, replays the records left by the previous
+ *              session and starts a new, empty log.
+ *
+ ****************************************************************************/
+db_result_t storage_wal_init(void)
+{
+	pthread_mutex_lock(&g_wal_lock);
+	if (g_wal.fd >= 0) {
+		pthread_mutex_unlock(&g_wal_lock);
+		return DB_OK;
+	}
+
+	g_wal.buffer = (unsigned char *)malloc(WAL_BUFFER_SIZE);
+	if (g_wal.buffer == NULL) {
+		pthread_mutex_unlock(&g_wal_lock);
+		return DB_ALLOCATION_ERROR;
+	}
+	g_wal.used = 0;
+	g_wal.pending = 0;
+	g_wal.size = 0;
+
+	g_wal.fd = wal_open(O_RDONLY);
+	if (g_wal.fd >= 0) {
+		wal_replay();
+		close(g_wal.fd);
+		g_wal.fd = -1;
+	}
+	pthread_mutex_unlock(&g_wal_lock);
+
+	/* Replayed rows have to reach their tuple files before the log is emptied */
+	return storage_wal_checkpoint(true);
+}
+
+void storage_wal_deinit(void)
+{
+	storage_wal_checkpoint(true);
+
+	pthread_mutex_lock(&g_wal_lock);
+#ifdef CONFIG_SCHED_WORKQUEUE
+	work_cancel(LPWORK, &g_wal.work);
+#endif
+	if (g_wal.fd >= 0) {
+		close(g_wal.fd);
+		g_wal.fd = -1;
+	}
+	if (g_wal.buffer != NULL) {
+		free(g_wal.buffer);
+		g_wal.buffer = NULL;
+	}
+	pthread_mutex_unlock(&g_wal_lock);
+}
+
+/****************************************************************************
+ * Name: storage_wal_append
+ *
+ * Description: Logs a row just stored as tuple_id of rel. The row is
+ *              durable once the group it belongs to is committed.
+ *
+ ****************************************************************************/
+db_result_t storage_wal_append(relation_t *rel, tuple_id_t tuple_id, unsigned char *row)
+{
+	db_result_t result = DB_OK;
+	wal_record_t record;
+	size_t length;
+
+	if (rel->dir != DB_STORAGE) {
+		return DB_OK;
+	}
+
+	memset(&record, 0, sizeof(wal_record_t));
+	record.magic = WAL_RECORD_MAGIC;
+	record.tuple_id = tuple_id;
+	record.length = rel->row_length;
+	strlcpy(record.relation, rel->name, sizeof(record.relation));
+	record.crc = wal_checksum(&record, row);
+	length = sizeof(wal_record_t) + record.length;
+
+	pthread_mutex_lock(&g_wal_lock);
+	if (g_wal.fd < 0) {
+		pthread_mutex_unlock(&g_wal_lock);
+		return DB_OK;
+	}
+
+	if (g_wal.used + length > WAL_BUFFER_SIZE) {
+		result = wal_commit();
+	}
+
+	if (length > WAL_BUFFER_SIZE) {
+		/* Too large to be grouped; commit it on its own */
+		if (DB_SUCCESS(result) && (DB_ERROR(wal_write(&record, sizeof(wal_record_t))) || DB_ERROR(wal_write(row, record.length)) || fsync(g_wal.fd) < 0)) {
+			result = DB_STORAGE_ERROR;
+		}
+		pthread_mutex_unlock(&g_wal_lock);
+		return result;
+	}
+
+	memcpy(g_wal.buffer + g_wal.used, &record, sizeof(wal_record_t));
+	memcpy(g_wal.buffer + g_wal.used + sizeof(wal_record_t), row, record.length);
+	g_wal.used += length;
+	if (g_wal.pending++ == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &g_wal.first);
+#ifdef CONFIG_SCHED_WORKQUEUE
+		if (CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_MS > 0 && CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_COUNT > 1) {
+			work_queue(LPWORK, &g_wal.work, wal_timeout_worker, NULL, MSEC2TICK(CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_MS));
+		}
+#endif
+	}
+
+	if (g_wal.pending >= CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_COUNT || wal_pending_ms() >= CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_MS) {
+		result = wal_commit();
+	}
+	pthread_mutex_unlock(&g_wal_lock);
+
+	return result;
+}
+
+/* Commits the pending records regardless of the group commit policy. */
+db_result_t storage_wal_commit(void)
+{
+	db_result_t result = DB_OK;
+
+	pthread_mutex_lock(&g_wal_lock);
+	if (g_wal.fd >= 0) {
+		result = wal_commit();
+	}
+	pthread_mutex_unlock(&g_wal_lock);
+	return result;
+}
+
+/****************************************************************************
+ * Name: storage_wal_checkpoint
+ *
+ * Description: Writes back every logged row to its tuple file and empties
+ *              the log. Unless forced, it only does so once the log has
+ *              grown beyond CONFIG_ARASTORAGE_WAL_CHECKPOINT_SIZE.
+ *
+ ****************************************************************************/
+db_result_t storage_wal_checkpoint(bool force)
+{
+	db_result_t result = DB_OK;
+
+	pthread_mutex_lock(&g_wal_lock);
+	if (g_wal.buffer == NULL || (!force && g_wal.size + g_wal.used < CONFIG_ARASTORAGE_WAL_CHECKPOINT_SIZE)) {
+		pthread_mutex_unlock(&g_wal_lock);
+		return DB_OK;
+	}
+
+#ifdef CONFIG_ARASTORAGE_ENABLE_WRITE_BUFFER
+	result = storage_flush_insert_buffer();
+#endif
+#ifdef CONFIG_ARASTORAGE_ENABLE_PAGE_CACHE
+	if (DB_SUCCESS(result)) {
+		result = storage_cache_flush();
+	}
+#endif
+	if (DB_ERROR(result)) {
+		/* Keep the log; the rows are not safe in their tuple files yet */
+		pthread_mutex_unlock(&g_wal_lock);
+		return result;
+	}
+
+	if (g_wal.fd >= 0) {
+		close(g_wal.fd);
+	}
+	g_wal.fd = wal_open(O_WRONLY | O_CREAT | O_TRUNC);
+	g_wal.used = 0;
+	g_wal.pending = 0;
+	g_wal.size = 0;
+	if (g_wal.fd < 0) {
+		DB_LOG_E("DB: Failed to open the log file\n");
+		result = DB_STORAGE_ERROR;
+	}
+	pthread_mutex_unlock(&g_wal_lock);
+
+	return result;
+}
+
+#endif							/* CONFIG_ARASTORAGE_ENABLE_WAL */
@@ -171,6 +171,51 @@ int create_packet_u(struct trace_packet *packet, char type, int8_t uid)
 	return ret;
 }
 
+#ifdef CONFIG_TTRACE_COMPACT
+/* Compact records are sent without time: the driver adds it, together with
+ * the task names, when the record enters the trace buffer.
+ */
+
+int send_record(uint8_t *rec, int len)
+{
+	rec[0] = (uint8_t)len;
+	return write(fd, rec, len);
+}
+
+int create_record(uint8_t *rec, uint8_t kind, pid_t pid)
+{
+	rec[1] = kind;
+	return TTRACE_REC_HDR_BYTES + ttrace_putvarint(&rec[TTRACE_REC_HDR_BYTES], pid);
+}
+
+int create_record_sched(uint8_t *rec, struct tcb_s *prev, struct tcb_s *next)
+{
+	int len;
+
+	/* A NULL task is the idle task, reported as pid 0 */
+
+	if (prev != NULL) {
+		len = create_record(rec, TTRACE_REC_SCHED, prev->pid);
+		rec[len++] = prev->sched_priority;
+		rec[len++] = prev->task_state;
+	} else {
+		len = create_record(rec, TTRACE_REC_SCHED, 0);
+		rec[len++] = 0;
+		rec[len++] = 3;
+	}
+
+	if (next != NULL) {
+		len += ttrace_putvarint(&rec[len], next->pid);
+		rec[len++] = next->sched_priority;
+	} else {
+		len += ttrace_putvarint(&rec[len], 0);
+		rec[len++] = 0;
+	}
+
+	return len;
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -179,7 +224,11 @@ int trace_sched(struct tcb_s *prev_tcb, struct tcb_s *next_tcb)
 {
 	int ret = TTRACE_VALID;
 	int tag = TTRACE_TAG_TASK;
+#ifdef CONFIG_TTRACE_COMPACT
+	uint8_t rec[TTRACE_REC_MAX_BYTES];
+#else
 	struct trace_packet packet;
+#endif
 
 	if (is_fd_available() < 0) {
 		return TTRACE_INVALID;
@@ -189,6 +238,9 @@ int trace_sched(struct tcb_s *prev_tcb, struct tcb_s *next_tcb)
 		return TTRACE_INVALID;
 	}
 
+#ifdef CONFIG_TTRACE_COMPACT
+	ret = send_record(rec, create_record_sched(rec, prev_tcb, next_tcb));
+#else
 	ret = create_packet_sched(&packet, prev_tcb, next_tcb);
 	if (ret == TTRACE_INVALID) {
 		assert(0);
@@ -197,6 +249,7 @@ int trace_sched(struct tcb_s *prev_tcb, struct tcb_s *next_tcb)
 	//show_sched_packet(&packet);
 
 	ret = send_packet_sched(&packet);
+#endif
 	return ret;
 
 }
@@ -212,8 +265,13 @@ int trace_sched(struct tcb_s *prev_tcb, struct tcb_s *next_tcb)
 int trace_begin(int tag, char *str, ...)
 {
 	int ret = TTRACE_VALID;
-	struct trace_packet packet;
 	va_list ap;
+#ifdef CONFIG_TTRACE_COMPACT
+	uint8_t rec[TTRACE_REC_MAX_BYTES];
+	int len;
+#else
+	struct trace_packet packet;
+#endif
 
 	if (is_fd_available() < 0) {
 		return TTRACE_INVALID;
@@ -223,6 +281,23 @@ int trace_begin(int tag, char *str, ...)
 		return TTRACE_INVALID;
 	}
 
+#ifdef CONFIG_TTRACE_COMPACT
+	/* The message is not NUL terminated */
+
+	len = create_record(rec, TTRACE_REC_BEGIN, getpid());
+	va_start(ap, str);
+	ret = vsnprintf((char *)&rec[len], TTRACE_MSG_BYTES + 1, str, ap);
+	va_end(ap);
+	if (ret < 0) {
+		return TTRACE_INVALID;
+	}
+
+	if (ret > TTRACE_MSG_BYTES) {
+		ret = TTRACE_MSG_BYTES;
+	}
+
+	ret = send_record(rec, len + ret);
+#else
 	va_start(ap, str);
 	ret = create_packet(&packet, TTRACE_EVENT_TYPE_BEGIN, str, ap);
 	va_end(ap);
@@ -233,13 +308,19 @@ int trace_begin(int tag, char *str, ...)
 	//show_packet(&packet);
 
 	ret = send_packet(&packet);
+#endif
 	return ret;
 }
 
 int trace_begin_u(int tag, int8_t uid)
 {
 	int ret = TTRACE_VALID;
+#ifdef CONFIG_TTRACE_COMPACT
+	uint8_t rec[TTRACE_REC_MAX_BYTES];
+	int len;
+#else
 	struct trace_packet packet;
+#endif
 
 	if (is_fd_available() < 0) {
 		return TTRACE_INVALID;
@@ -249,6 +330,11 @@ int trace_begin_u(int tag, int8_t uid)
 		return TTRACE_INVALID;
 	}
 
+#ifdef CONFIG_TTRACE_COMPACT
+	len = create_record(rec, TTRACE_REC_BEGIN_U, getpid());
+	rec[len++] = (uint8_t)uid;
+	ret = send_record(rec, len);
+#else
 	ret = create_packet_u(&packet, TTRACE_EVENT_TYPE_BEGIN, uid);
 	if (ret == TTRACE_INVALID) {
 		assert(0);
@@ -257,6 +343,7 @@ int trace_begin_u(int tag, int8_t uid)
 	//show_packet(&packet);
 
 	ret = send_packet(&packet);
+#endif
 	return ret;
 }
 
@@ -273,7 +360,11 @@ int trace_begin_u(int tag, int8_t uid)
 int trace_end(int tag)
 {
 	int ret = TTRACE_VALID;
+#ifdef CONFIG_TTRACE_COMPACT
+	uint8_t rec[TTRACE_REC_MAX_BYTES];
+#else
 	struct trace_packet packet;
+#endif
 
 	if (is_fd_available() < 0) {
 		return TTRACE_INVALID;
@@ -283,6 +374,9 @@ int trace_end(int tag)
 		return TTRACE_INVALID;
 	}
 
+#ifdef CONFIG_TTRACE_COMPACT
+	ret = send_record(rec, create_record(rec, TTRACE_REC_END, getpid()));
+#else
 	ret = create_packet_u(&packet, TTRACE_EVENT_TYPE_END, 0);
 	if (ret == TTRACE_INVALID) {
 		assert(0);
@@ -291,6 +385,7 @@ int trace_end(int tag)
 	//show_packet(&packet);
 
 	ret = send_packet(&packet);
+#endif
 	return ret;
 }
 
@@ -145,6 +145,9 @@ void work_process(FAR struct usr_wqueue_s *wqueue)
 	systime_t ctick;
 	uint32_t next;
 	int ret;
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	systime_t latency;
+#endif
 
 	/* Then process queued work.  Lock the work queue while we process items
 	 * in the work list.
@@ -196,6 +199,9 @@ void work_process(FAR struct usr_wqueue_s *wqueue)
 				/* Extract the work argument (before unlocking the work queue) */
 
 				arg = work->arg;
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+				latency = elapsed - work->delay;
+#endif
 
 				/* Mark the work as no longer being queued */
 
@@ -207,6 +213,11 @@ void work_process(FAR struct usr_wqueue_s *wqueue)
 
 				work_unlock();
 				worker(arg);
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+				/* Record the work with the resolution of the system tick */
+
+				work_stats_record(USRWORK, worker, latency * USEC_PER_TICK, (clock_systimer() - ctick) * USEC_PER_TICK);
+#endif
 
 				/* Now, unfortunately, since we unlocked the work queue we don't
 				 * know the state of the work list and we will have to start
@@ -0,0 +1,76 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * arch/arm/src/armv7-r/arm_perf.c
+ *
+ * Cycle counter of the ARMv7-R performance monitors.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <stdint.h>
+
+#include <tinyara/arch.h>
+
+#include "sctlr.h"
+
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define PMCNTENSET_C       (1 << 31)	/* Enable the cycle counter */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: up_perf_init
+ *
+ * Description:
+ *   Start the cycle counter.  It counts every CPU cycle, without divider.
+ *
+ ****************************************************************************/
+
+void up_perf_init(void)
+{
+	cp15_wrpmcr((cp15_rdpmcr() | PCMR_E) & ~PCMR_D);
+	cp15_wrpmcntenset(PMCNTENSET_C);
+}
+
+/****************************************************************************
+ * Name: up_perf_gettime
+ *
+ * Description:
+ *   Return the cycle counter.  It wraps around every 2^32 cycles.
+ *
+ ****************************************************************************/
+
+uint32_t up_perf_gettime(void)
+{
+	return cp15_rdpmccntr();
+}
+
+#endif							/* CONFIG_ARCH_HAVE_PERF_EVENTS */
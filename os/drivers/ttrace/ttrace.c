@@ -34,45 +34,97 @@
 #include <poll.h>
 #include <errno.h>
 #include <assert.h>
+#include <stddef.h>
 #include <debug.h>
+#include <ttrace.h>
 
 #include <tinyara/fs/fs.h>
 #include <tinyara/kmalloc.h>
 #include <tinyara/fs/fs.h>
 #include <tinyara/arch.h>
+#include <tinyara/clock.h>
+#include <tinyara/sched.h>
+#include <tinyara/ttrace_internal.h>
 
 #include <arch/irq.h>
 
-
 /****************************************************************************
- * Private Types
+ * Pre-processor Definitions
  ****************************************************************************/
 
-#define TTRACE_START           's'
-#define TTRACE_FINISH          'f'
-#define TTRACE_INFO            'i'
-#define TTRACE_SELECTED_TAG    't'
-#define TTRACE_FUNC_TAG        'g'
-#define TTRACE_USED_BUFSIZE    'u'
-#define TTRACE_BUFFER          'b'
-
 #define TTRACE_STATE_IDLE       0
 #define TTRACE_STATE_RUNNING    1
 
 #define TTRACE_OVERFLOW        -2
-#define TTRACE_INVALID         -1
-#define TTRACE_VALID            0
 
-#define NO_HOLDER               ((pid_t)-1)
+/* Ring positions count bytes and wrap at the largest multiple of the buffer
+ * size below 2^31, so that the ring index of a position is its remainder
+ * and the distance between two positions tells which one is ahead.
+ */
+
+#define TTRACE_POS_WRAP         ((0x80000000u / CONFIG_TTRACE_BUFSIZE) * CONFIG_TTRACE_BUFSIZE)
+
+/* Length of a packet given its codelen byte.  Packets with a unique code
+ * carry no message.
+ */
+
+#define TTRACE_HDR_BYTES        (sizeof(struct trace_packet) - TTRACE_MSG_BYTES)
+#define TTRACE_PACKET_BYTES(c)  (((c) & TTRACE_CODE_UNIQUE) ? TTRACE_HDR_BYTES : sizeof(struct trace_packet))
+
+/* Length of the packet or record starting at 'p'.  Compact records start
+ * with their length.
+ */
+
+#ifdef CONFIG_TTRACE_COMPACT
+#define TTRACE_MIN_BYTES        TTRACE_REC_HDR_BYTES
+#define TTRACE_LENGTH(p)        ((size_t)*(FAR const uint8_t *)(p))
+#else
+#define TTRACE_MIN_BYTES        TTRACE_HDR_BYTES
+#define TTRACE_LENGTH(p)        TTRACE_PACKET_BYTES(((FAR const struct trace_packet *)(p))->codelen)
+#endif
+
+/* Trace clock of the compact records */
+
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+#define ttrace_clock()          up_perf_gettime()
+#else
+#define ttrace_clock()          ((uint32_t)clock_systimer())
+#endif
+
+/* The writer runs with interrupts disabled and the reader does not lock at
+ * all, so on a single CPU only the compiler may reorder their accesses.
+ */
+
+#define ttrace_barrier()        __asm__ __volatile__("" ::: "memory")
 
 /****************************************************************************
  * Private Types
  ****************************************************************************/
 
+/* The trace buffer is a ring of whole packets.  Packets are appended at
+ * 'head' by ttrace_write() and consumed from 'tail' by ttrace_read().
+ * With CONFIG_TTRACE_OVERWRITE, the writer discards the oldest packets to
+ * make room and 'oldest' is the first packet still in the ring; otherwise
+ * new packets are dropped when the ring is full and 'oldest' follows
+ * 'tail'.
+ */
+
 struct ttrace_dev_s {
-	uint16_t ttrace_head;      /* The head index (where data is added) */
-	size_t ttrace_bufsize;     /* Size of the trace buffer */
-	FAR char *ttrace_packets;  /* Trace packets buffer */
+	volatile uint32_t head;    /* Position where the next packet is added */
+	volatile uint32_t tail;    /* Position of the next packet to read */
+	volatile uint32_t oldest;  /* Position of the oldest packet kept */
+	uint32_t npackets;         /* Packets added */
+	uint32_t ndropped;         /* Packets dropped because the ring was full */
+	uint32_t noverwritten;     /* Packets overwritten before being read */
+	size_t bufsize;            /* Size of the trace buffer */
+	FAR char *packets;         /* Trace packets buffer */
+#ifdef CONFIG_TTRACE_COMPACT
+	uint32_t last;             /* Trace clock of the last record */
+	uint32_t synctick;         /* System tick of the last SYNC record */
+#endif
+#ifndef CONFIG_DISABLE_POLL
+	FAR struct pollfd *fds[CONFIG_TTRACE_NPOLLWAITERS];
+#endif
 };
 
 /****************************************************************************
@@ -82,6 +134,9 @@ struct ttrace_dev_s {
 static ssize_t ttrace_read(FAR struct file *, FAR char *, size_t);
 static ssize_t ttrace_write(FAR struct file *, FAR const char *, size_t);
 static int ttrace_ioctl(FAR struct file *, int, unsigned long);
+#ifndef CONFIG_DISABLE_POLL
+static int ttrace_poll(FAR struct file *, FAR struct pollfd *, bool);
+#endif
 
 /****************************************************************************
  * Private Data
@@ -94,6 +149,9 @@ static const struct file_operations g_ttracefops = {
 	ttrace_write, /* write */
 	0,            /* seek */
 	ttrace_ioctl  /* ioctl */
+#ifndef CONFIG_DISABLE_POLL
+	, ttrace_poll /* poll */
+#endif
 };
 
 /* This is the pre-allocated buffer used for the T-trace */
@@ -101,72 +159,502 @@ static char g_packets[CONFIG_TTRACE_BUFSIZE];
 static uint32_t g_state = TTRACE_STATE_IDLE;
 static uint32_t g_selected_tag = 0;
 
+#ifdef CONFIG_TTRACE_COMPACT
+/* Pids that have been named by a TASK record since tracing started,
+ * indexed like the pid hash table of the scheduler.
+ */
+
+static pid_t g_named[CONFIG_MAX_TASKS];
+#endif
+
 /* This is the device structure for the T-trace function. It
  * must be statically initialized because the T-trace ttrace_putc function
  * could be called before the driver initialization logic executes.
  */
 
 static struct ttrace_dev_s g_sysdev = {
-	0,                        /* ttrace_head */
-	CONFIG_TTRACE_BUFSIZE,    /* ttrace_bufsize */
-	g_packets                 /* ttrace_packets_buffer */
+	0,                        /* head */
+	0,                        /* tail */
+	0,                        /* oldest */
+	0,                        /* npackets */
+	0,                        /* ndropped */
+	0,                        /* noverwritten */
+	CONFIG_TTRACE_BUFSIZE,    /* bufsize */
+	g_packets,                /* packets */
 };
 
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: ttrace_distance
+ *
+ * Description:
+ *   Return the number of bytes from position 'from' to position 'to'.
+ *
+ ****************************************************************************/
+
+static inline uint32_t ttrace_distance(uint32_t to, uint32_t from)
+{
+	return to >= from ? to - from : to + TTRACE_POS_WRAP - from;
+}
+
+/****************************************************************************
+ * Name: ttrace_advance
+ ****************************************************************************/
+
+static inline uint32_t ttrace_advance(uint32_t pos, uint32_t nbytes)
+{
+	pos += nbytes;
+	return pos >= TTRACE_POS_WRAP ? pos - TTRACE_POS_WRAP : pos;
+}
+
+/****************************************************************************
+ * Name: ttrace_isahead
+ *
+ * Description:
+ *   Return true if position 'a' is after position 'b'.
+ *
+ ****************************************************************************/
+
+static inline bool ttrace_isahead(uint32_t a, uint32_t b)
+{
+	uint32_t dist = ttrace_distance(a, b);
+	return dist != 0 && dist < TTRACE_POS_WRAP / 2;
+}
+
+/****************************************************************************
+ * Name: ttrace_copyin and ttrace_copyout
+ *
+ * Description:
+ *   Copy bytes to or from the ring at a position, wrapping at its end.
+ *
+ ****************************************************************************/
+
+static void ttrace_copyin(FAR struct ttrace_dev_s *priv, uint32_t pos, FAR const char *src, size_t len)
+{
+	size_t ndx = pos % priv->bufsize;
+	size_t first = priv->bufsize - ndx;
+
+	if (first >= len) {
+		memcpy(priv->packets + ndx, src, len);
+	} else {
+		memcpy(priv->packets + ndx, src, first);
+		memcpy(priv->packets, src + first, len - first);
+	}
+}
+
+static void ttrace_copyout(FAR struct ttrace_dev_s *priv, uint32_t pos, FAR char *dest, size_t len)
+{
+	size_t ndx = pos % priv->bufsize;
+	size_t first = priv->bufsize - ndx;
+
+	if (first >= len) {
+		memcpy(dest, priv->packets + ndx, len);
+	} else {
+		memcpy(dest, priv->packets + ndx, first);
+		memcpy(dest + first, priv->packets, len - first);
+	}
+}
+
+/****************************************************************************
+ * Name: ttrace_used
+ *
+ * Description:
+ *   Return the number of bytes that can be read.
+ *
+ ****************************************************************************/
+
+static uint32_t ttrace_used(FAR struct ttrace_dev_s *priv)
+{
+	uint32_t start = priv->tail;
+	uint32_t oldest = priv->oldest;
+
+	if (ttrace_isahead(oldest, start)) {
+		start = oldest;
+	}
+
+	return ttrace_distance(priv->head, start);
+}
+
+/****************************************************************************
+ * Name: ttrace_pollnotify
+ ****************************************************************************/
+
+#ifndef CONFIG_DISABLE_POLL
+static void ttrace_pollnotify(FAR struct ttrace_dev_s *priv, pollevent_t eventset)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_TTRACE_NPOLLWAITERS; i++) {
+		struct pollfd *fds = priv->fds[i];
+		if (fds) {
+			fds->revents |= (fds->events & eventset);
+			if (fds->revents != 0) {
+				sem_post(fds->sem);
+			}
+		}
+	}
+}
+#else
+#define ttrace_pollnotify(priv, event)
+#endif
+
+/****************************************************************************
+ * Name: ttrace_put
+ *
+ * Description:
+ *   Append a packet or record to the ring.  Must be called with interrupts
+ *   disabled.  Sets '*notify' if the ring was empty.
+ *
+ ****************************************************************************/
+
+static int ttrace_put(FAR struct ttrace_dev_s *priv, FAR const char *buffer, size_t len, FAR bool *notify)
+{
+	uint32_t head;
+	uint32_t oldest;
+
+	head = priv->head;
+	oldest = priv->oldest;
+	if (ttrace_isahead(priv->tail, oldest)) {
+		oldest = priv->tail;
+	}
+
+	if (ttrace_distance(head, oldest) + len > priv->bufsize) {
+#ifdef CONFIG_TTRACE_OVERWRITE
+		/* Discard the oldest packets and publish the new oldest position
+		 * before their bytes are reused.  'tail' is pulled along so that
+		 * it never falls half the position range behind 'oldest' while
+		 * nobody reads, which would make it look ahead again.
+		 */
+
+		do {
+#ifdef CONFIG_TTRACE_COMPACT
+			oldest = ttrace_advance(oldest, (uint8_t)priv->packets[oldest % priv->bufsize]);
+#else
+			oldest = ttrace_advance(oldest, TTRACE_PACKET_BYTES(priv->packets[(oldest + offsetof(struct trace_packet, codelen)) % priv->bufsize]));
+#endif
+			priv->noverwritten++;
+		} while (ttrace_distance(head, oldest) + len > priv->bufsize);
+
+		priv->oldest = oldest;
+		priv->tail = oldest;
+		ttrace_barrier();
+#else
+		priv->ndropped++;
+		return TTRACE_OVERFLOW;
+#endif
+	} else {
+		priv->oldest = oldest;
+	}
+
+	ttrace_copyin(priv, head, buffer, len);
+	ttrace_barrier();
+
+	*notify |= head == oldest;
+	priv->head = ttrace_advance(head, len);
+	priv->npackets++;
+
+	return OK;
+}
+
+#ifdef CONFIG_TTRACE_COMPACT
+/****************************************************************************
+ * Name: ttrace_record
+ *
+ * Description:
+ *   Append a compact record, inserting the time elapsed since the previous
+ *   record.  Must be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+static int ttrace_record(FAR struct ttrace_dev_s *priv, uint8_t kind, uint32_t now, FAR const uint8_t *payload, size_t paylen, FAR bool *notify)
+{
+	uint8_t rec[TTRACE_REC_MAX_BYTES];
+	size_t len;
+	int ret;
+
+	len = TTRACE_REC_HDR_BYTES;
+	len += ttrace_putvarint(&rec[len], now - priv->last);
+	if (len + paylen > TTRACE_REC_MAX_BYTES) {
+		paylen = TTRACE_REC_MAX_BYTES - len;
+	}
+
+	memcpy(&rec[len], payload, paylen);
+	len += paylen;
+
+	rec[0] = (uint8_t)len;
+	rec[1] = kind;
+
+	ret = ttrace_put(priv, (FAR const char *)rec, len, notify);
+	if (ret == OK) {
+		priv->last = now;
+	}
+
+	return ret;
+}
+
+/****************************************************************************
+ * Name: ttrace_sync
+ *
+ * Description:
+ *   Append a SYNC record relating the trace clock to the system timer.
+ *
+ ****************************************************************************/
+
+static void ttrace_sync(FAR struct ttrace_dev_s *priv, FAR bool *notify)
+{
+	uint8_t payload[3 * TTRACE_VARINT_MAX_BYTES + 4];
+	uint32_t ticks;
+	uint32_t now;
+	size_t len;
+
+	ticks = (uint32_t)clock_systimer();
+	now = ttrace_clock();
+
+	len = ttrace_putvarint(payload, ticks);
+	len += ttrace_putvarint(&payload[len], USEC_PER_TICK);
+	len += ttrace_putvarint(&payload[len], priv->ndropped);
+	payload[len++] = (uint8_t)now;
+	payload[len++] = (uint8_t)(now >> 8);
+	payload[len++] = (uint8_t)(now >> 16);
+	payload[len++] = (uint8_t)(now >> 24);
+
+	if (ttrace_record(priv, TTRACE_REC_SYNC, now, payload, len, notify) == OK) {
+		priv->synctick = ticks;
+	}
+}
+
+/****************************************************************************
+ * Name: ttrace_name
+ *
+ * Description:
+ *   Append a TASK record with the name of 'pid' unless it was named since
+ *   tracing started.
+ *
+ ****************************************************************************/
+
+static void ttrace_name(FAR struct ttrace_dev_s *priv, uint32_t pid, uint32_t now, FAR bool *notify)
+{
+	uint8_t payload[TTRACE_VARINT_MAX_BYTES + TTRACE_MSG_BYTES];
+	FAR pid_t *named = &g_named[pid & (CONFIG_MAX_TASKS - 1)];
+	size_t len;
+
+	if (*named == (pid_t)pid) {
+		return;
+	}
+
+	len = ttrace_putvarint(payload, pid);
+#if CONFIG_TASK_NAME_SIZE > 0
+	{
+		FAR struct tcb_s *tcb = sched_gettcb((pid_t)pid);
+		if (tcb != NULL) {
+			size_t namelen = strnlen(tcb->name, TTRACE_MSG_BYTES);
+			memcpy(&payload[len], tcb->name, namelen);
+			len += namelen;
+		}
+	}
+#endif
+
+	if (ttrace_record(priv, TTRACE_REC_TASK, now, payload, len, notify) == OK) {
+		*named = (pid_t)pid;
+	}
+}
+
+/****************************************************************************
+ * Name: ttrace_write_compact
+ *
+ * Description:
+ *   Add a record written by the T-trace library.  'buffer' holds the
+ *   length, the kind and the payload of the record; the time is added
+ *   here, so that records are ordered as they enter the ring.  A SYNC
+ *   record and the names of the tasks seen for the first time are added
+ *   before it when needed.
+ *
+ ****************************************************************************/
+
+static int ttrace_write_compact(FAR struct ttrace_dev_s *priv, FAR const uint8_t *buffer, size_t len, FAR bool *notify)
+{
+	uint32_t pid;
+	uint32_t now;
+	size_t off;
+
+	off = TTRACE_REC_HDR_BYTES;
+	off += ttrace_getvarint(&buffer[off], &pid);
+
+	if ((uint32_t)clock_systimer() - priv->synctick >= CONFIG_TTRACE_SYNC_TICKS) {
+		ttrace_sync(priv, notify);
+	}
+
+	now = ttrace_clock();
+
+	ttrace_name(priv, pid, now, notify);
+	if (buffer[1] == TTRACE_REC_SCHED && off + 2 < len) {
+		ttrace_getvarint(&buffer[off + 2], &pid);
+		ttrace_name(priv, pid, now, notify);
+	}
+
+	return ttrace_record(priv, buffer[1], now, &buffer[TTRACE_REC_HDR_BYTES], len - TTRACE_REC_HDR_BYTES, notify);
+}
+#endif
+
 /****************************************************************************
  * Name: ttrace_read
+ *
+ * Description:
+ *   Move as many whole packets as fit in 'buffer' out of the ring.  This
+ *   may run while packets are being added: it takes no lock, and copied
+ *   bytes that the writer overwrote in the meantime are detected by
+ *   re-reading 'oldest' and discarded.  Returns 0 if the ring is empty.
+ *
  ****************************************************************************/
 
 static ssize_t ttrace_read(FAR struct file *filep, FAR char *buffer, size_t len)
 {
 	struct inode *inode = filep->f_inode;
 	struct ttrace_dev_s *priv = inode->i_private;
+	uint32_t start;
+	uint32_t oldest;
+	size_t nbytes;
+	size_t skip;
+	size_t offset;
+	size_t pktlen;
 
-	if (TTRACE_STATE_IDLE != g_state) {
-		return TTRACE_INVALID;
+	DEBUGASSERT(priv);
+
+	for (;;) {
+		start = priv->tail;
+		oldest = priv->oldest;
+		if (ttrace_isahead(oldest, start)) {
+			start = oldest;
+		}
+
+		nbytes = ttrace_distance(priv->head, start);
+		if (nbytes == 0) {
+			return 0;
+		}
+
+		if (nbytes > priv->bufsize) {
+			/* The writer went past 'start' since it was read */
+
+			continue;
+		}
+
+		if (nbytes > len) {
+			nbytes = len;
+		}
+
+		ttrace_barrier();
+		ttrace_copyout(priv, start, buffer, nbytes);
+		ttrace_barrier();
+
+		/* Bytes before the oldest packet were overwritten while they were
+		 * copied.  The oldest packet always starts a packet.
+		 */
+
+		oldest = priv->oldest;
+		if (!ttrace_isahead(oldest, start)) {
+			break;
+		}
+
+		skip = ttrace_distance(oldest, start);
+		if (skip < nbytes) {
+			memmove(buffer, buffer + skip, nbytes - skip);
+			nbytes -= skip;
+			start = oldest;
+			break;
+		}
 	}
 
-	DEBUGASSERT(priv);
-	sched_lock();
+	/* Only return whole packets */
 
-	ttdbg("buffer: %p, g_packets: %p, g_packets_size: %d\r\n", buffer, g_packets, priv->ttrace_head);
-	memcpy(buffer, g_packets, priv->ttrace_head);
+	offset = 0;
+	while (offset + TTRACE_MIN_BYTES <= nbytes) {
+		pktlen = TTRACE_LENGTH(buffer + offset);
+		if (offset + pktlen > nbytes) {
+			break;
+		}
 
-	memset((void *)g_packets, 0, priv->ttrace_head);
-	priv->ttrace_head = 0;
+		offset += pktlen;
+	}
 
-	sched_unlock();
-	return len;
+	if (offset == 0) {
+		/* The buffer cannot hold a single packet */
+
+		return -EINVAL;
+	}
+
+	priv->tail = ttrace_advance(start, offset);
+	return offset;
 }
 
 /****************************************************************************
  * Name: ttrace_write
+ *
+ * Description:
+ *   Add one packet to the ring.  Interrupts are disabled while the packet
+ *   is copied, which serializes the writers without involving the
+ *   scheduler.
+ *
  ****************************************************************************/
 
 static ssize_t ttrace_write(FAR struct file *filep, FAR const char *buffer, size_t len)
 {
 	struct inode *inode = filep->f_inode;
 	struct ttrace_dev_s *priv = inode->i_private;
+	irqstate_t flags;
+	bool notify = false;
+	bool sched;
+	int ret;
+
+	DEBUGASSERT(priv);
 
 	if (TTRACE_STATE_RUNNING != g_state) {
 		return TTRACE_INVALID;
 	}
 
-	if (priv->ttrace_head + len > sizeof(g_packets)) {
-		return TTRACE_OVERFLOW;
+#ifdef CONFIG_TTRACE_COMPACT
+	/* The time is not written by the library */
+
+	if (len <= TTRACE_REC_HDR_BYTES || len != TTRACE_LENGTH(buffer) || len + TTRACE_VARINT_MAX_BYTES > TTRACE_REC_MAX_BYTES) {
+		return -EINVAL;
 	}
 
-	DEBUGASSERT(priv);
-	sched_lock();
+	if (buffer[1] < TTRACE_REC_BEGIN || buffer[1] > TTRACE_REC_SCHED) {
+		return -EINVAL;
+	}
+
+	sched = buffer[1] == TTRACE_REC_SCHED;
+
+	flags = irqsave();
+	ret = ttrace_write_compact(priv, (FAR const uint8_t *)buffer, len, &notify);
+	irqrestore(flags);
+#else
+	if (len < TTRACE_HDR_BYTES || len > priv->bufsize || len != TTRACE_LENGTH(buffer)) {
+		return -EINVAL;
+	}
+
+	sched = ((FAR const struct trace_packet *)buffer)->event_type == 's';
+
+	flags = irqsave();
+	ret = ttrace_put(priv, buffer, len, &notify);
+	irqrestore(flags);
+#endif
+
+	if (ret != OK) {
+		return ret;
+	}
 
-	memcpy((void *)(g_packets + priv->ttrace_head), (void *)buffer, len);
+	/* Wake up readers when the ring becomes non-empty.  Scheduler events
+	 * are written from the context switch logic, where waiters cannot be
+	 * woken up; they are reported with the next packet.
+	 */
 
-	priv->ttrace_head += len;
+	if (notify && !sched) {
+		ttrace_pollnotify(priv, POLLIN);
+	}
 
-	sched_unlock();
 	return len;
 }
 
@@ -174,31 +662,59 @@ static ssize_t ttrace_write(FAR struct file *filep, FAR const char *buffer, size
  * Name: ttrace_ioctl
  ****************************************************************************/
 
-static ssize_t ttrace_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
+static int ttrace_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
 {
 	FAR struct inode *inode = filep->f_inode;
 	struct ttrace_dev_s *priv = inode->i_private;
+	irqstate_t flags;
+#ifdef CONFIG_TTRACE_COMPACT
+	bool notify = false;
+#endif
 	int ret = TTRACE_VALID;
 
 	DEBUGASSERT(priv);
-	sched_lock();
 
 	switch (cmd) {
 	case TTRACE_START:
+		flags = irqsave();
+		priv->head = 0;
+		priv->tail = 0;
+		priv->oldest = 0;
+		priv->npackets = 0;
+		priv->ndropped = 0;
+		priv->noverwritten = 0;
+#ifdef CONFIG_TTRACE_COMPACT
+		memset(g_named, 0xff, sizeof(g_named));
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+		up_perf_init();
+#endif
+		priv->last = ttrace_clock();
+		ttrace_sync(priv, &notify);
+#endif
 		g_state = TTRACE_STATE_RUNNING;
-		priv->ttrace_head = 0;
+		irqrestore(flags);
 		break;
 	case TTRACE_FINISH:
+		flags = irqsave();
+#ifdef CONFIG_TTRACE_COMPACT
+		if (g_state == TTRACE_STATE_RUNNING) {
+			ttrace_sync(priv, &notify);
+		}
+#endif
 		g_selected_tag = 0;
 		g_state = TTRACE_STATE_IDLE;
+		irqrestore(flags);
+#ifdef CONFIG_TTRACE_COMPACT
+		if (notify) {
+			ttrace_pollnotify(priv, POLLIN);
+		}
+#endif
 		break;
 	case TTRACE_INFO:
 		ttdbg("state: %d\r\n", g_state);
 		ttdbg("selected tags: %d\r\n", g_selected_tag);
-		/* TODO
-		ttdbg("available tags: \r\n");
-		ttdbg("buffer size: \r\n");
-		*/
+		ttdbg("buffer size: %d, used: %d\r\n", priv->bufsize, ttrace_used(priv));
+		ttdbg("packets: %u, dropped: %u, overwritten: %u\r\n", priv->npackets, priv->ndropped, priv->noverwritten);
 		break;
 	case TTRACE_SELECTED_TAG:
 		g_selected_tag |= arg;
@@ -211,8 +727,8 @@ static ssize_t ttrace_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
 		}
 		break;
 	case TTRACE_USED_BUFSIZE:
-		ttdbg("used bufsize: %d\r\n", priv->ttrace_head);
-		ret = priv->ttrace_head;
+		ret = ttrace_used(priv);
+		ttdbg("used bufsize: %d\r\n", ret);
 		break;
 	case TTRACE_BUFFER:
 		ttdbg("Resize of trace buffer is not supported yet.\r\n");
@@ -222,10 +738,62 @@ static ssize_t ttrace_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
 		break;
 	}
 
-	sched_unlock();
 	return ret;
 }
 
+/****************************************************************************
+ * Name: ttrace_poll
+ ****************************************************************************/
+
+#ifndef CONFIG_DISABLE_POLL
+static int ttrace_poll(FAR struct file *filep, FAR struct pollfd *fds, bool setup)
+{
+	FAR struct inode *inode = filep->f_inode;
+	FAR struct ttrace_dev_s *priv = inode->i_private;
+	FAR struct pollfd **slot;
+	irqstate_t flags;
+	int ret = OK;
+	int i;
+
+	DEBUGASSERT(priv && fds);
+
+	flags = irqsave();
+	if (setup) {
+		/* This is a request to set up the poll. Find an available
+		 * slot for the poll structure reference
+		 */
+
+		for (i = 0; i < CONFIG_TTRACE_NPOLLWAITERS; i++) {
+			if (!priv->fds[i]) {
+				priv->fds[i] = fds;
+				fds->priv = &priv->fds[i];
+				break;
+			}
+		}
+
+		if (i >= CONFIG_TTRACE_NPOLLWAITERS) {
+			fds->priv = NULL;
+			ret = -EBUSY;
+		} else if (ttrace_used(priv) > 0) {
+			/* Packets are already waiting */
+
+			ttrace_pollnotify(priv, POLLIN);
+		}
+	} else {
+		/* This is a request to tear down the poll. */
+
+		slot = (FAR struct pollfd **)fds->priv;
+		if (slot) {
+			*slot = NULL;
+			fds->priv = NULL;
+		}
+	}
+
+	irqrestore(flags);
+	return ret;
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -68,12 +68,19 @@
 #include <string.h>
 #include <debug.h>
 #include <errno.h>
+#ifdef CONFIG_MTD_SMART_BGGC
+#include <semaphore.h>
+#include <assert.h>
+#endif
 
 #include <crc8.h>
 #include <crc16.h>
 #include <crc32.h>
 #include <tinyara/math.h>
 #include <tinyara/kmalloc.h>
+#ifdef CONFIG_MTD_SMART_BGGC
+#include <tinyara/kthread.h>
+#endif
 #include <tinyara/fs/fs.h>
 #include <tinyara/fs/ioctl.h>
 #include <tinyara/fs/mtd.h>
@@ -126,6 +133,7 @@
 #define SMART_FMT_VERSION_POS     (SMART_FMT_POS1 + 4)
 #define SMART_FMT_NAMESIZE_POS    (SMART_FMT_POS1 + 5)
 #define SMART_FMT_ROOTDIRS_POS    (SMART_FMT_POS1 + 6)
+#define SMART_FMT_CKPT_POS        (SMART_FMT_POS1 + 7)
 #define SMARTFS_FMT_WEAR_POS      36
 #define SMART_WEAR_LEVEL_FORMAT_SIG 32
 #define SMART_PARTNAME_SIZE         4
@@ -154,7 +162,7 @@
 #define offsetof(type, member) ((size_t)&(((type *)0)->member))
 #endif
 
-#define SMART_MAX_ALLOCS        6
+#define SMART_MAX_ALLOCS        7
 //#define CONFIG_MTD_SMART_PACK_COUNTS
 
 #ifndef CONFIG_MTD_SMART_ALLOC_DEBUG
@@ -170,6 +178,45 @@
 #define SMART_WEAR_ZERO_MASK                0x0F
 #define SMART_WEAR_BLOCK_MASK               0x01
 
+#ifdef CONFIG_MTD_SMART_BGGC
+/* The background garbage collection collects blocks with at least a quarter
+ * of their sectors released, from when the free sectors fall below the low
+ * watermark until they reach the high watermark.
+ */
+
+#define SMART_BGGC_LOWMARK(d)     ((uint32_t)(d)->totalsectors * CONFIG_MTD_SMART_BGGC_LOWMARK / 100)
+#define SMART_BGGC_HIGHMARK(d)    ((uint32_t)(d)->totalsectors * CONFIG_MTD_SMART_BGGC_HIGHMARK / 100)
+#define SMART_BGGC_MINRELEASE(d)  ((d)->availSectPerBlk > 4 ? (d)->availSectPerBlk >> 2 : 1)
+#else
+#define smart_gc_update(d, b)
+#endif
+
+/* The checkpoint saves the sector map, which is not kept with minimized RAM */
+
+#ifdef CONFIG_MTD_SMART_MINIMIZE_RAM
+#undef CONFIG_MTD_SMART_CHECKPOINT
+#endif
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+/* Two checkpoint slots follow the erase blocks used for sectors.  A slot
+ * holds a sequence of checkpoint records, each of them a header sector,
+ * then the sector map, the release and free counts and the bitmap of the
+ * sectors not written since their block was erased.  Records are appended
+ * to a slot until it is full, then the other slot is erased.
+ */
+
+#define SMART_CKPT_MAGIC          "SCKP"
+#define SMART_CKPT_FULL           0xFFFF
+#define SMART_CKPT_ISFREE(d, s)   (((d)->ckptfree[(s) >> 3] & (1 << ((s) & 0x07))) != 0)
+#define SMART_CKPT_SLOTBLOCK(d, n) ((d)->geo.neraseblocks + (n) * (d)->ckptslotblocks)
+#define SMART_CKPT_SLOTOFFSET(d, n) ((uint32_t)SMART_CKPT_SLOTBLOCK(d, n) * (d)->geo.erasesize)
+#define SMART_CKPT_RECOFFSET(d, n, r) (SMART_CKPT_SLOTOFFSET(d, n) + (uint32_t)(r) * smart_ckpt_recsize(d))
+#else
+#define smart_ckpt_written(d, s)
+#define smart_ckpt_invalidate(d)
+#define smart_ckpt_erased(d, b)
+#endif
+
 #if CONFIG_SMARTFS_ERASEDSTATE == 0xFF
 #define SECTOR_IS_RELEASED(h) ((h.status & SMART_STATUS_RELEASED) == 0 ? true : false)
 #define SECTOR_IS_COMMITTED(h) ((h.status & SMART_STATUS_COMMITTED) == 0 ? true : false)
@@ -242,6 +289,22 @@ struct smart_allocsector_s {
 };
 #endif
 
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+struct smart_ckpt_header_s {
+	uint8_t magic[4];			/* SMART_CKPT_MAGIC */
+	uint32_t seq;				/* Sequence number, the latest is the highest */
+	uint16_t sectorsize;		/* Sector size the checkpoint was written with */
+	uint16_t neraseblocks;		/* Number of erase blocks */
+	uint32_t totalsectors;		/* Total number of sectors on device */
+	uint16_t freesectors;		/* Total number of free sectors */
+	uint16_t releasesectors;	/* Total number of released sectors */
+	uint32_t datasize;			/* Size of the data following the header sector */
+	uint32_t datacrc;			/* CRC-32 of the data */
+	uint32_t crc;				/* CRC-32 of the fields above */
+	uint8_t valid;				/* Programmed when the checkpoint is out of date */
+};
+#endif
+
 struct smart_struct_s {
 	FAR struct mtd_dev_s *mtd;	/* Contained MTD interface */
 	struct mtd_geometry_s geo;	/* Device geometry */
@@ -261,6 +324,25 @@ struct smart_struct_s {
 	uint32_t erasesize;			/* Size of an erase block */
 	FAR uint8_t *releasecount;	/* Count of released sectors per erase block */
 	FAR uint8_t *freecount;	/* Count of free sectors per erase block */
+#ifdef CONFIG_MTD_SMART_BGGC
+	FAR uint16_t *gchead;		/* First erase block listed per release count */
+	FAR uint16_t *gclink;		/* Next and previous erase block in the lists */
+	FAR uint8_t *gccount;		/* Release count each erase block is listed at */
+	sem_t exclsem;				/* Excludes the garbage collection task */
+	sem_t gcsem;				/* Wakes up the garbage collection task */
+	bool gcpending;				/* The garbage collection task was woken up */
+	pid_t gcpid;				/* The garbage collection task */
+#endif
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	FAR uint8_t *ckptfree;		/* Sectors not written since erased, one bit each */
+	uint32_t ckptseq;			/* Sequence number of the last checkpoint */
+	uint32_t ckptdirty;			/* Changes since the last checkpoint */
+	uint16_t ckptslotblocks;	/* Erase blocks per checkpoint slot, 0 if none */
+	uint16_t ckptrec;			/* Record of the last checkpoint in its slot */
+	uint16_t ckptnext;			/* Next erased record of that slot, or SMART_CKPT_FULL */
+	uint8_t ckptslot;			/* Slot of the last checkpoint */
+	bool ckptvalid;				/* The last checkpoint is up to date */
+#endif
 	FAR char *rwbuffer;			/* Our sector read/write buffer */
 	FAR uint8_t *bytebuffer;	/* Array of bytes to be used in smart_bytewrite */
 	char
@@ -411,6 +493,14 @@ static int smart_relocate_static_data(FAR struct smart_struct_s *dev, uint16_t b
 #endif
 
 static int smart_relocate_sector(FAR struct smart_struct_s *dev, uint16_t oldsector, uint16_t newsector);
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static uint32_t smart_ckpt_recsize(FAR struct smart_struct_s *dev);
+static void smart_ckpt_invalidate(FAR struct smart_struct_s *dev);
+static void smart_ckpt_erased(FAR struct smart_struct_s *dev, uint16_t block);
+static int smart_checkpoint(FAR struct smart_struct_s *dev);
+static void smart_ckpt_setslots(FAR struct smart_struct_s *dev, uint16_t slotblocks);
+static void smart_ckpt_reserve(FAR struct smart_struct_s *dev);
+#endif
 
 /****************************************************************************
  * Private Data
@@ -500,6 +590,28 @@ static void smart_free(FAR struct smart_struct_s *dev, FAR void *ptr)
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: smart_semtake
+ *
+ * Description: Take a semaphore, waiting again if awakened by a signal.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_BGGC
+static void smart_semtake(FAR sem_t *sem)
+{
+	while (sem_wait(sem) != 0) {
+		/* The only case that an error should occur here is if
+		 * the wait was awakened by a signal.
+		 */
+
+		ASSERT(*get_errno_ptr() == EINTR);
+	}
+}
+
+#define smart_semgive(s) sem_post(s)
+#endif
+
 /****************************************************************************
  * Name: smart_open
  *
@@ -522,7 +634,35 @@ static int smart_open(FAR struct inode *inode)
 
 static int smart_close(FAR struct inode *inode)
 {
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	FAR struct smart_struct_s *dev;
+#endif
+
 	fvdbg("Entry\n");
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	DEBUGASSERT(inode && inode->i_private);
+#ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
+	dev = ((FAR struct smart_multiroot_device_s *)inode->i_private)->dev;
+#else
+	dev = (FAR struct smart_struct_s *)inode->i_private;
+#endif
+
+	/* The device is closed at unmount, checkpoint the sector map so that
+	 * the next mount does not need to scan the device.
+	 */
+
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semtake(&dev->exclsem);
+#endif
+	if (smart_checkpoint(dev) != OK) {
+		fdbg("Error writing the sector map checkpoint\n");
+	}
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semgive(&dev->exclsem);
+#endif
+#endif
+
 	return OK;
 }
 
@@ -619,6 +759,66 @@ static void smart_add_count(struct smart_struct_s *dev, uint8_t *pCount, uint16_
 }
 #endif
 
+/****************************************************************************
+ * Name: smart_gc_update
+ *
+ * Description: Move an erase block to the list of its release count.  The
+ *              erase blocks with released sectors are listed by release
+ *              count, so that garbage collection finds the block with the
+ *              most released sectors without scanning all the blocks.  Must
+ *              be called each time the releasecount of a block changes.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_BGGC
+static void smart_gc_update(FAR struct smart_struct_s *dev, uint16_t block)
+{
+	uint16_t next;
+	uint16_t prev;
+	uint8_t count;
+
+#ifdef CONFIG_MTD_SMART_PACK_COUNTS
+	count = smart_get_count(dev, dev->releasecount, block);
+#else
+	count = dev->releasecount[block];
+#endif
+
+	if (count == dev->gccount[block]) {
+		return;
+	}
+
+	/* Unlink the block from the list of its previous count */
+
+	if (dev->gccount[block] > 0) {
+		next = dev->gclink[block << 1];
+		prev = dev->gclink[(block << 1) + 1];
+		if (prev == 0xFFFF) {
+			dev->gchead[dev->gccount[block]] = next;
+		} else {
+			dev->gclink[prev << 1] = next;
+		}
+
+		if (next != 0xFFFF) {
+			dev->gclink[(next << 1) + 1] = prev;
+		}
+	}
+
+	/* Blocks without released sectors are not listed */
+
+	dev->gccount[block] = count;
+	if (count > 0) {
+		next = dev->gchead[count];
+		dev->gclink[block << 1] = next;
+		dev->gclink[(block << 1) + 1] = 0xFFFF;
+		if (next != 0xFFFF) {
+			dev->gclink[(next << 1) + 1] = block;
+		}
+
+		dev->gchead[count] = block;
+	}
+}
+#endif
+
 /****************************************************************************
  * Name: smart_checkfree
  *
@@ -757,6 +957,9 @@ static ssize_t smart_reload(struct smart_struct_s *dev, FAR uint8_t *buffer, off
 static ssize_t smart_read(FAR struct inode *inode, unsigned char *buffer, size_t start_sector, unsigned int nsectors)
 {
 	struct smart_struct_s *dev;
+#ifdef CONFIG_MTD_SMART_BGGC
+	ssize_t ret;
+#endif
 
 	fvdbg("SMART: sector: %d nsectors: %d\n", start_sector, nsectors);
 
@@ -766,7 +969,15 @@ static ssize_t smart_read(FAR struct inode *inode, unsigned char *buffer, size_t
 #else
 	dev = (struct smart_struct_s *)inode->i_private;
 #endif
+
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semtake(&dev->exclsem);
+	ret = smart_reload(dev, buffer, start_sector, nsectors);
+	smart_semgive(&dev->exclsem);
+	return ret;
+#else
 	return smart_reload(dev, buffer, start_sector, nsectors);
+#endif
 }
 
 /****************************************************************************
@@ -801,13 +1012,19 @@ static ssize_t smart_write(FAR struct inode *inode, FAR const unsigned char *buf
 	dev = (FAR struct smart_struct_s *)inode->i_private;
 #endif
 
-	/* I think maybe we need to lock on a mutex here */
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semtake(&dev->exclsem);
+#endif
 
 	/* Get the aligned block.  Here is is assumed: (1) The number of R/W blocks
 	 * per erase block is a power of 2, and (2) the erase begins with that same
 	 * alignment.
 	 */
 
+	/* Raw writes are not tracked by the sector map checkpoint */
+
+	smart_ckpt_invalidate(dev);
+
 	mask = dev->sectorsPerBlk - 1;
 	alignedblock = ((start_sector + mask) & ~mask) * dev->mtdBlksPerSector;
 
@@ -837,10 +1054,7 @@ static ssize_t smart_write(FAR struct inode *inode, FAR const unsigned char *buf
 			ret = MTD_ERASE(dev->mtd, eraseblock, 1);
 			if (ret < 0) {
 				fdbg("Erase block=%d failed: %d\n", eraseblock, ret);
-
-				/* Unlock the mutex if we add one */
-
-				return ret;
+				goto errout;
 			}
 		}
 
@@ -863,10 +1077,8 @@ static ssize_t smart_write(FAR struct inode *inode, FAR const unsigned char *buf
 			/* The block is not empty!!  What to do? */
 
 			fdbg("Write block %d failed: %d.\n", nextblock, nxfrd);
-
-			/* Unlock the mutex if we add one */
-
-			return -EIO;
+			ret = -EIO;
+			goto errout;
 		}
 
 		/* Then update for amount written */
@@ -877,7 +1089,13 @@ static ssize_t smart_write(FAR struct inode *inode, FAR const unsigned char *buf
 		alignedblock += mtdBlksPerErase;
 	}
 
-	return nsectors;
+	ret = nsectors;
+
+errout:
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semgive(&dev->exclsem);
+#endif
+	return ret;
 }
 #endif							/* CONFIG_FS_WRITABLE */
 
@@ -1024,6 +1242,12 @@ static int smart_setsectorsize(FAR struct smart_struct_s *dev, uint16_t size)
 		dev->wearstatus = NULL;
 	}
 #endif
+#ifdef CONFIG_MTD_SMART_BGGC
+	if (dev->gchead != NULL) {
+		smart_free(dev, dev->gchead);
+		dev->gchead = NULL;
+	}
+#endif
 
 #ifdef CONFIG_SMARTFS_BAD_SECTOR
 
@@ -1078,6 +1302,13 @@ static int smart_setsectorsize(FAR struct smart_struct_s *dev, uint16_t size)
 
 #ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
 	allocsize = dev->neraseblocks << 1;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	/* The bitmap of the free sectors follows the counts, so that they are
+	 * checkpointed together with the sector map.
+	 */
+
+	allocsize += (totalsectors + 7) >> 3;
+#endif
 	dev->sMap = (FAR uint16_t *)smart_malloc(dev, totalsectors * sizeof(uint16_t) + allocsize, "Sector map");
 	if (!dev->sMap) {
 		fdbg("Error allocating SMART virtual map buffer\n");
@@ -1086,6 +1317,9 @@ static int smart_setsectorsize(FAR struct smart_struct_s *dev, uint16_t size)
 
 	dev->releasecount = (FAR uint8_t *)dev->sMap + (totalsectors * sizeof(uint16_t));
 	dev->freecount = dev->releasecount + dev->neraseblocks;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	dev->ckptfree = dev->freecount + dev->neraseblocks;
+#endif
 #else
 	dev->sBitMap = (FAR uint8_t *)smart_malloc(dev, (totalsectors + 7) >> 3, "Sector Bitmap");
 	if (dev->sBitMap == NULL) {
@@ -1165,6 +1399,22 @@ static int smart_setsectorsize(FAR struct smart_struct_s *dev, uint16_t size)
 	dev->uneven_wearcount = 0;
 #endif
 
+#ifdef CONFIG_MTD_SMART_BGGC
+	/* Allocate the release count lists, with no block listed */
+
+	allocsize = (dev->sectorsPerBlk + 1) * sizeof(uint16_t);
+	dev->gchead = (FAR uint16_t *)smart_malloc(dev, allocsize + dev->neraseblocks * (2 * sizeof(uint16_t) + 1), "GC lists");
+	if (!dev->gchead) {
+		fdbg("Error allocating garbage collection lists\n");
+		goto errexit;
+	}
+
+	dev->gclink = dev->gchead + dev->sectorsPerBlk + 1;
+	dev->gccount = (FAR uint8_t *)(dev->gclink + (dev->neraseblocks << 1));
+	memset(dev->gchead, 0xFF, allocsize);
+	memset(dev->gccount, 0, dev->neraseblocks);
+#endif
+
 	/* Allocate a read/write buffer */
 
 	dev->rwbuffer = (FAR char *)smart_malloc(dev, size, "RW Buffer");
@@ -1216,6 +1466,12 @@ errexit:
 	}
 #endif
 
+#ifdef CONFIG_MTD_SMART_BGGC
+	if (dev->gchead) {
+		smart_free(dev, dev->gchead);
+	}
+#endif
+
 #ifdef CONFIG_MTD_SMART_SECTOR_ERASE_DEBUG
 	if (dev->erasecounts) {
 		smart_free(dev, dev->erasecounts);
@@ -1287,6 +1543,92 @@ errout:
 	return ret;
 }
 
+/****************************************************************************
+ * Name: smart_ckpt_written
+ *
+ * Description: Records that a physical sector was written since its erase
+ *              block was erased, so that a mount from the checkpoint of the
+ *              sector map no longer needs to scan it.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static void smart_ckpt_written(FAR struct smart_struct_s *dev, uint16_t sector)
+{
+	if (SMART_CKPT_ISFREE(dev, sector)) {
+		dev->ckptfree[sector >> 3] &= ~(1 << (sector & 0x07));
+		dev->ckptdirty++;
+	}
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_retire
+ *
+ * Description: Marks a checkpoint record out of date by programming the
+ *              valid byte of its header.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static void smart_ckpt_retire(FAR struct smart_struct_s *dev, uint8_t slot, uint16_t rec)
+{
+	uint32_t offset;
+	uint8_t byte;
+
+	offset = SMART_CKPT_RECOFFSET(dev, slot, rec);
+	byte = (uint8_t)~CONFIG_SMARTFS_ERASEDSTATE;
+	if (smart_bytewrite(dev, offset + offsetof(struct smart_ckpt_header_s, valid), 1, &byte) != 1) {
+		/* Then erase the header.  The erase block may hold other records,
+		 * so the next checkpoint starts over in the other slot.
+		 */
+
+		fdbg("Error invalidating checkpoint slot %d record %d\n", slot, rec);
+		MTD_ERASE(dev->mtd, offset / dev->geo.erasesize, 1);
+		dev->ckptnext = SMART_CKPT_FULL;
+	}
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_invalidate
+ *
+ * Description: Marks the checkpoint of the sector map out of date.  Called
+ *              before a change that the scan of the sectors that were free
+ *              at the checkpoint would not find, such as an erase or the
+ *              release of a sector without a new copy.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static void smart_ckpt_invalidate(FAR struct smart_struct_s *dev)
+{
+	dev->ckptdirty++;
+	if (dev->ckptvalid) {
+		smart_ckpt_retire(dev, dev->ckptslot, dev->ckptrec);
+		dev->ckptvalid = false;
+	}
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_erased
+ *
+ * Description: Marks the sectors of an erase block free.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static void smart_ckpt_erased(FAR struct smart_struct_s *dev, uint16_t block)
+{
+	uint32_t sector;
+
+	for (sector = (uint32_t)block * dev->sectorsPerBlk; sector < (uint32_t)(block + 1) * dev->sectorsPerBlk && sector < dev->totalsectors; sector++) {
+		dev->ckptfree[sector >> 3] |= 1 << (sector & 0x07);
+	}
+}
+#endif
+
 /****************************************************************************
  * Name: smart_add_sector_to_cache
  *
@@ -1684,32 +2026,19 @@ static int smart_set_wear_level(FAR struct smart_struct_s *dev, uint16_t block,
 #endif
 
 /****************************************************************************
- * Name: smart_scan
+ * Name: smart_scan_format
  *
- * Description: Performs a scan of the MTD device searching for format
- *              information and fills in logical sector mapping, freesector
- *              count, etc.
+ * Description: Reads the format information from the physical sector
+ *              holding logical sector zero.
  *
  ****************************************************************************/
 
-static int smart_scan(FAR struct smart_struct_s *dev)
+static int smart_scan_format(FAR struct smart_struct_s *dev, uint16_t sector)
 {
-	int sector;
-	int ret;
-	uint16_t totalsectors;
-	uint16_t sectorsize, prerelease;
-	uint16_t logicalsector;
-	uint16_t loser;
 	uint32_t readaddress;
-	uint32_t offset;
-	uint16_t seq1;
-	uint16_t seq2;
-	struct smart_sect_header_s header;
-	uint8_t *sector_seq_log = NULL;
-	bool status_released, status_committed;
-#ifdef CONFIG_MTD_SMART_MINIMIZE_RAM
-	int dupsector;
-	uint16_t duplogsector;
+	int ret;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	uint16_t slotblocks;
 #endif
 #ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
 	int x;
@@ -1717,439 +2046,851 @@ static int smart_scan(FAR struct smart_struct_s *dev)
 	FAR struct smart_multiroot_device_s *rootdirdev;
 #endif
 
-	fvdbg("Entry\n");
+	readaddress = sector * dev->mtdBlksPerSector * dev->geo.blocksize;
 
-	/* Find the sector size on the volume by reading headers from
-	 * sectors of decreasing size.  On a formatted volume, the sector
-	 * size is saved in the header status byte of seach sector, so
-	 * by starting with the largest supported sector size and
-	 * decreasing from there, we will be sure to find data that is
-	 * a header and not sector data.
+	/* Read the sector data */
+
+	ret = MTD_READ(dev->mtd, readaddress, 32, (FAR uint8_t *)dev->rwbuffer);
+	if (ret != 32) {
+		fdbg("Error reading physical sector %d.\n", sector);
+		return -EIO;
+	}
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	/* The sectors were scanned with the checkpoint slots of this build.  If
+	 * the volume was formatted with other slots, or none, some of its
+	 * sectors may lie where the slots were taken.  Take the slots recorded
+	 * on the volume and let the caller scan again.
 	 */
 
-	sectorsize = 0xFFFF;
-	offset = 16384;
+	slotblocks = dev->rwbuffer[SMART_FMT_CKPT_POS];
+	if (slotblocks == CONFIG_SMARTFS_ERASEDSTATE || slotblocks * 2 > (dev->geo.neraseblocks + dev->ckptslotblocks * 2) / 4) {
+		slotblocks = 0;
+	}
 
-	while (sectorsize == 0xFFFF) {
-		readaddress = 0;
+	if (slotblocks != dev->ckptslotblocks) {
+		fdbg("Volume formatted with %d checkpoint slot blocks, not %d\n", slotblocks, dev->ckptslotblocks);
+		smart_ckpt_setslots(dev, slotblocks);
+		return -EAGAIN;
+	}
+#endif
 
-		while (readaddress < dev->erasesize * dev->geo.neraseblocks) {
-			/* Read the next sector from the device */
+	dev->formatstatus = SMART_FMT_STAT_FORMATTED;
+	dev->namesize = dev->rwbuffer[SMART_FMT_NAMESIZE_POS];
+	dev->formatversion = dev->rwbuffer[SMART_FMT_VERSION_POS];
 
-			ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
-			if (ret != sizeof(struct smart_sect_header_s)) {
-				goto err_out;
-			}
+#ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
+	dev->rootdirentries = dev->rwbuffer[SMART_FMT_ROOTDIRS_POS];
 
-			if (header.status != CONFIG_SMARTFS_ERASEDSTATE) {
-				sectorsize = (header.status & SMART_STATUS_SIZEBITS) << 7;
-				break;
-			}
+	/* If rootdirentries is greater than 1, then we need to register
+	 * additional block devices.
+	 */
 
-			readaddress += offset;
+	for (x = 1; x < dev->rootdirentries; x++) {
+		if (dev->partname[0] != '\0') {
+			snprintf(dev->rwbuffer, sizeof(devname), "/dev/smart%d%sd%d", dev->minor, dev->partname, x + 1);
+		} else {
+			snprintf(devname, sizeof(devname), "/dev/smart%dd%d", dev->minor, x + 1);
 		}
 
-		offset >>= 1;
-		if (offset < 256 && sectorsize == 0xFFFF) {
-			sectorsize = CONFIG_MTD_SMART_SECTOR_SIZE;
-		}
-	}
+		/* Inode private data is a reference to a struct containing
+		 * the SMART device structure and the root directory number.
+		 */
 
-	/* Now set the sectorsize and other sectorsize derived variables */
+		rootdirdev = (struct smart_multiroot_device_s *)smart_malloc(dev, sizeof(*rootdirdev), "Root Dir");
+		if (rootdirdev == NULL) {
+			fdbg("Memory alloc failed\n");
+			return -ENOMEM;
+		}
 
-	ret = smart_setsectorsize(dev, sectorsize);
-	if (ret != OK) {
-		goto err_out;
-	}
+		/* Populate the rootdirdev */
 
-	/* Initialize the device variables */
+		rootdirdev->dev = dev;
+		rootdirdev->rootdirnum = x;
+		ret = register_blockdriver(dev->rwbuffer, &g_bops, 0, rootdirdev);
 
-	totalsectors = dev->totalsectors;
+		/* Inode private data is a reference to the SMART device structure */
 
-	dev->reservedsector = SMART_FIRST_ALLOC_SECTOR;
-#ifdef CONFIG_SMARTFS_JOURNALING
-	if (totalsectors > CONFIG_SMARTFS_JOURNALING_THRESHOLD) {
-		dev->reservedsector += 2 * CONFIG_SMARTFS_NLOGGING_SECTORS;
+		ret = register_blockdriver(devname, &g_bops, 0, rootdirdev);
 	}
 #endif
 
-	dev->formatstatus = SMART_FMT_STAT_NOFMT;
-	dev->freesectors = dev->availSectPerBlk * dev->geo.neraseblocks;
-	dev->releasesectors = 0;
+	return OK;
+}
 
-	/* Initialize the freecount and releasecount arrays */
+/****************************************************************************
+ * Name: smart_ckpt_datasize
+ *
+ * Description: Returns the size of the checkpointed data: the sector map,
+ *              the release and free counts and the free sector bitmap.
+ *
+ ****************************************************************************/
 
-	for (sector = 0; sector < dev->neraseblocks; sector++) {
-		if (sector == dev->neraseblocks - 1 && dev->totalsectors == 65534) {
-			prerelease = 2;
-		} else {
-			prerelease = 0;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static uint32_t smart_ckpt_datasize(FAR struct smart_struct_s *dev)
+{
+	return (uint32_t)dev->totalsectors * sizeof(uint16_t) + (dev->neraseblocks << 1) + ((dev->totalsectors + 7) >> 3);
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_recsize
+ *
+ * Description: Returns the size of a checkpoint record: the header sector
+ *              and the data, rounded up to whole sectors.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static uint32_t smart_ckpt_recsize(FAR struct smart_struct_s *dev)
+{
+	return dev->sectorsize + (smart_ckpt_datasize(dev) + dev->sectorsize - 1) / dev->sectorsize * dev->sectorsize;
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_nrecords
+ *
+ * Description: Returns the number of checkpoint records a slot holds.  It
+ *              is zero if the device is formatted with a smaller sector
+ *              size than the slots were reserved for.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static uint16_t smart_ckpt_nrecords(FAR struct smart_struct_s *dev)
+{
+	if (dev->ckptslotblocks == 0) {
+		return 0;
+	}
+
+	return (uint32_t)dev->ckptslotblocks * dev->geo.erasesize / smart_ckpt_recsize(dev);
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_iserased
+ *
+ * Description: Tells whether a checkpoint record was not written since its
+ *              slot was erased.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static bool smart_ckpt_iserased(FAR struct smart_struct_s *dev, uint8_t slot, uint16_t rec)
+{
+	uint32_t offset;
+	uint32_t done;
+	uint32_t recsize;
+	uint16_t x;
+
+	offset = SMART_CKPT_RECOFFSET(dev, slot, rec);
+	recsize = smart_ckpt_recsize(dev);
+	for (done = 0; done < recsize; done += dev->sectorsize) {
+		if (MTD_READ(dev->mtd, offset + done, dev->sectorsize, (FAR uint8_t *)dev->rwbuffer) != dev->sectorsize) {
+			return false;
 		}
 
-#ifdef CONFIG_MTD_SMART_PACK_COUNTS
-		smart_set_count(dev, dev->freecount, sector, dev->availSectPerBlk - prerelease);
-		smart_set_count(dev, dev->releasecount, sector, prerelease);
-#else
-		dev->freecount[sector] = dev->availSectPerBlk - prerelease;
-		dev->releasecount[sector] = prerelease;
+		for (x = 0; x < dev->sectorsize; x++) {
+			if ((uint8_t)dev->rwbuffer[x] != CONFIG_SMARTFS_ERASEDSTATE) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
 #endif
+
+/****************************************************************************
+ * Name: smart_ckpt_readheader
+ *
+ * Description: Reads the header of a checkpoint record and validates it
+ *              for the current geometry.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static int smart_ckpt_readheader(FAR struct smart_struct_s *dev, uint8_t slot, uint16_t rec, FAR struct smart_ckpt_header_s *header)
+{
+	int ret;
+
+	ret = MTD_READ(dev->mtd, SMART_CKPT_RECOFFSET(dev, slot, rec), sizeof(struct smart_ckpt_header_s), (FAR uint8_t *)header);
+	if (ret != sizeof(struct smart_ckpt_header_s)) {
+		return -EIO;
 	}
 
-	/* Initialize the sector map */
+	if (memcmp(header->magic, SMART_CKPT_MAGIC, 4) != 0 || crc32((FAR const uint8_t *)header, offsetof(struct smart_ckpt_header_s, crc)) != header->crc) {
+		return -ENOENT;
+	}
 
-#ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
-	for (sector = 0; sector < totalsectors; sector++) {
-		dev->sMap[sector] = -1;
+	/* Never reuse the sequence number of a checkpoint on the device */
+
+	if (header->seq > dev->ckptseq) {
+		dev->ckptseq = header->seq;
 	}
-#else
-	/* Clear all logical sector used bits */
 
-	memset(dev->sBitMap, 0, (dev->totalsectors + 7) >> 3);
+	if (header->valid != CONFIG_SMARTFS_ERASEDSTATE || header->sectorsize != dev->sectorsize || header->totalsectors != dev->totalsectors || header->neraseblocks != dev->neraseblocks || header->datasize != smart_ckpt_datasize(dev)) {
+		return -ENOENT;
+	}
+
+	return OK;
+}
 #endif
 
-	/* Now scan the MTD device */
-	sector_seq_log = (uint8_t *)kmm_zalloc(sizeof(uint8_t) * totalsectors);
+/****************************************************************************
+ * Name: smart_ckpt_load
+ *
+ * Description: Loads the sector map, the release and free counts and the
+ *              free sector bitmap from the latest checkpoint that is up to
+ *              date.  Returns -ENOENT if there is none.
+ *
+ ****************************************************************************/
 
-	if (sector_seq_log == NULL) {
-		ret = -ENOMEM;
-		goto err_out;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static int smart_ckpt_load(FAR struct smart_struct_s *dev)
+{
+	struct smart_ckpt_header_s header;
+	struct smart_ckpt_header_s latest;
+	uint32_t limit;
+	uint32_t offset;
+	uint32_t done;
+	uint32_t toread;
+	uint32_t crc;
+	uint16_t nrecords;
+	uint16_t block;
+	uint16_t rec;
+	uint16_t x;
+	uint8_t slot;
+	bool found;
+	int ret;
+
+	nrecords = smart_ckpt_nrecords(dev);
+	if (nrecords == 0) {
+		return -ENOENT;
 	}
 
-	for (sector = 0; sector < totalsectors; sector++) {
-		fvdbg("Scan sector %d\n", sector);
+	/* Try the latest checkpoint first, then the older ones */
 
-		/* Calculate the read address for this sector */
+	limit = UINT32_MAX;
+	slot = 0;
+	rec = 0;
+	for (;;) {
+		found = false;
+		for (x = 0; x < 2 * nrecords; x++) {
+			if (smart_ckpt_readheader(dev, x / nrecords, x % nrecords, &header) == OK && header.seq < limit && (!found || header.seq > latest.seq)) {
+				memcpy(&latest, &header, sizeof(struct smart_ckpt_header_s));
+				slot = x / nrecords;
+				rec = x % nrecords;
+				found = true;
+			}
+		}
 
-		readaddress = sector * dev->mtdBlksPerSector * dev->geo.blocksize;
+		if (!found) {
+			return -ENOENT;
+		}
 
-		/* Read the header for this sector */
+		limit = latest.seq;
 
-		ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
-		if (ret != sizeof(struct smart_sect_header_s)) {
-			goto err_out;
+		/* Validate the data before it replaces the sector map */
+
+		offset = SMART_CKPT_RECOFFSET(dev, slot, rec) + dev->sectorsize;
+		crc = 0;
+		for (done = 0; done < latest.datasize; done += toread) {
+			toread = latest.datasize - done;
+			if (toread > dev->sectorsize) {
+				toread = dev->sectorsize;
+			}
+
+			ret = MTD_READ(dev->mtd, offset + done, toread, (FAR uint8_t *)dev->rwbuffer);
+			if (ret != toread) {
+				break;
+			}
+
+			crc = crc32part((FAR const uint8_t *)dev->rwbuffer, toread, crc);
 		}
 
-		/* Get the logical sector number for this physical sector */
+		if (done < latest.datasize || crc != latest.datacrc) {
+			fdbg("Checkpoint in slot %d record %d is corrupted\n", slot, rec);
+			continue;
+		}
 
-		//logicalsector = *((FAR uint16_t *)header.logicalsector);
-		logicalsector = UINT8TOUINT16(header.logicalsector);
-#if CONFIG_SMARTFS_ERASEDSTATE == 0x00
-		if (logicalsector == 0) {
-			logicalsector = -1;
+		ret = MTD_READ(dev->mtd, offset, latest.datasize, (FAR uint8_t *)dev->sMap);
+		if (ret != latest.datasize) {
+			fdbg("Error reading checkpoint in slot %d record %d\n", slot, rec);
+			return -EIO;
 		}
+
+		/* The previous checkpoint is still valid if the device lost power
+		 * before it was marked out of date.  Mark it now, or it would be
+		 * loaded once this one is invalidated.
+		 */
+
+		dev->ckptnext = 0;
+		for (x = 0; x < 2 * nrecords; x++) {
+			if ((x / nrecords != slot || x % nrecords != rec) && smart_ckpt_readheader(dev, x / nrecords, x % nrecords, &header) == OK) {
+				smart_ckpt_retire(dev, x / nrecords, x % nrecords);
+			}
+		}
+
+		/* Keep appending to this slot unless a later record was written,
+		 * even partly, when the device lost power.
+		 */
+
+		if (dev->ckptnext != SMART_CKPT_FULL) {
+			dev->ckptnext = SMART_CKPT_FULL;
+			if (rec + 1 < nrecords && smart_ckpt_iserased(dev, slot, rec + 1)) {
+				dev->ckptnext = rec + 1;
+			}
+		}
+
+		dev->freesectors = latest.freesectors;
+		dev->releasesectors = latest.releasesectors;
+		dev->ckptslot = slot;
+		dev->ckptrec = rec;
+		dev->ckptvalid = true;
+		dev->ckptdirty = 0;
+
+		for (block = 0; block < dev->neraseblocks; block++) {
+			smart_gc_update(dev, block);
+		}
+
+		fvdbg("Loaded checkpoint %d from slot %d record %d\n", latest.seq, slot, rec);
+		return OK;
+	}
+}
 #endif
 
-		status_released = SECTOR_IS_RELEASED(header);
-		status_committed = SECTOR_IS_COMMITTED(header);
+/****************************************************************************
+ * Name: smart_scan_sector
+ *
+ * Description: Reads the header of a physical sector and accounts for it
+ *              in the logical sector mapping, freesector count, etc.
+ *
+ ****************************************************************************/
 
-		if (logicalsector > 0 && header.status != CONFIG_SMARTFS_ERASEDSTATE && !status_released && status_committed) {
+static int smart_scan_sector(FAR struct smart_struct_s *dev, uint16_t sector, FAR uint8_t *sector_seq_log)
+{
+	int ret;
+	uint16_t logicalsector;
+	uint16_t loser;
+	uint32_t readaddress;
+	uint32_t offset;
+	uint16_t seq1;
+	uint16_t seq2;
+	struct smart_sect_header_s header;
+	bool status_released, status_committed;
+#ifdef CONFIG_MTD_SMART_MINIMIZE_RAM
+	int dupsector;
+	uint16_t duplogsector;
+#endif
+
+	fvdbg("Scan sector %d\n", sector);
+
+	/* Calculate the read address for this sector */
+
+	readaddress = sector * dev->mtdBlksPerSector * dev->geo.blocksize;
+
+	/* Read the header for this sector */
+
+	ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
+	if (ret != sizeof(struct smart_sect_header_s)) {
+		goto err_out;
+	}
+
+	/* Get the logical sector number for this physical sector */
+
+	//logicalsector = *((FAR uint16_t *)header.logicalsector);
+	logicalsector = UINT8TOUINT16(header.logicalsector);
+#if CONFIG_SMARTFS_ERASEDSTATE == 0x00
+	if (logicalsector == 0) {
+		logicalsector = -1;
+	}
+#endif
 
-			/* Map the sector and update the free sector counts */
-			if (header.seq >= sector_seq_log[logicalsector]) {
+	status_released = SECTOR_IS_RELEASED(header);
+	status_committed = SECTOR_IS_COMMITTED(header);
 
-				sector_seq_log[logicalsector] = header.seq;
-				fvdbg("logicalsector : physicalsector -> %d : %d\n", logicalsector, sector);
+	if (logicalsector > 0 && header.status != CONFIG_SMARTFS_ERASEDSTATE && !status_released && status_committed) {
 
-				/*Generate bad sector information from start */
+		/* Map the sector and update the free sector counts */
+		if (header.seq >= sector_seq_log[logicalsector]) {
+
+			sector_seq_log[logicalsector] = header.seq;
+			fvdbg("logicalsector : physicalsector -> %d : %d\n", logicalsector, sector);
+
+			/*Generate bad sector information from start */
 #ifdef CONFIG_SMARTFS_BAD_SECTOR
-				if (logicalsector == SMART_BAD_SECTOR_NUMBER) {
-					int bad_physical_sector_no = -1, bsm_ret;
-					int sect_header_size = sizeof(struct smart_sect_header_s);	// sector header size
-					int i, j, found_bad_physical_sector;
+			if (logicalsector == SMART_BAD_SECTOR_NUMBER) {
+				int bad_physical_sector_no = -1, bsm_ret;
+				int sect_header_size = sizeof(struct smart_sect_header_s);	// sector header size
+				int i, j, found_bad_physical_sector;
+
+				if (dev->bad_sector_rwbuffer != NULL) {
+					bad_physical_sector_no = (uint16_t)(dev->sMap[SMART_BAD_SECTOR_NUMBER]);
 
-					if (dev->bad_sector_rwbuffer != NULL) {
-						bad_physical_sector_no = (uint16_t)(dev->sMap[SMART_BAD_SECTOR_NUMBER]);
+					if (bad_physical_sector_no == ERROR) {
+						fdbg("bad_physical_sector_no not found\n");
+					} else {
+						bsm_ret = MTD_BREAD(dev->mtd, bad_physical_sector_no * dev->mtdBlksPerSector, dev->mtdBlksPerSector, (FAR uint8_t *)dev->bad_sector_rwbuffer);
 
-						if (bad_physical_sector_no == ERROR) {
-							fdbg("bad_physical_sector_no not found\n");
+						if (bsm_ret < 0) {
+							fdbg("error in sector read %d\n", bad_physical_sector_no);
 						} else {
-							bsm_ret = MTD_BREAD(dev->mtd, bad_physical_sector_no * dev->mtdBlksPerSector, dev->mtdBlksPerSector, (FAR uint8_t *)dev->bad_sector_rwbuffer);
-
-							if (bsm_ret < 0) {
-								fdbg("error in sector read %d\n", bad_physical_sector_no);
-							} else {
-								int bad_sector_info = dev->totalsectors / dev->sectorsPerBlk;
-								for (i = sect_header_size; i < bad_sector_info + sect_header_size; i++) {
-									for (j = 7; j >= 0; j--) {
-										if (((dev->bad_sector_rwbuffer[i] >> j) & 1) == 0) {
-											/* byte = 8 bit; left shift 3 byte = 8 */
-											found_bad_physical_sector = ((i << 3) + j) - (sect_header_size << 3);
-											fvdbg("After reboot: Found bad physical sector #%d\n", found_bad_physical_sector);
-											dev->badSectorList[found_bad_physical_sector] = TRUE;
-										}
+							int bad_sector_info = dev->totalsectors / dev->sectorsPerBlk;
+							for (i = sect_header_size; i < bad_sector_info + sect_header_size; i++) {
+								for (j = 7; j >= 0; j--) {
+									if (((dev->bad_sector_rwbuffer[i] >> j) & 1) == 0) {
+										/* byte = 8 bit; left shift 3 byte = 8 */
+										found_bad_physical_sector = ((i << 3) + j) - (sect_header_size << 3);
+										fvdbg("After reboot: Found bad physical sector #%d\n", found_bad_physical_sector);
+										dev->badSectorList[found_bad_physical_sector] = TRUE;
 									}
 								}
 							}
 						}
-					} else {
-						fdbg("Error: dev->bad_sector_rwbuffer is NULL\n");
 					}
-				}				//if(logicalsector == SMART_BAD_SECTOR_NUMBER)
+				} else {
+					fdbg("Error: dev->bad_sector_rwbuffer is NULL\n");
+				}
+			}				//if(logicalsector == SMART_BAD_SECTOR_NUMBER)
 #endif							/*CONFIG_SMARTFS_BAD_SECTOR */
 
-			} else {
-				fvdbg("logicalsector : physicalsector -> %d : %d; status_released: %d, status_committed: %d\n", logicalsector, sector, status_released, status_committed);
-			}
+		} else {
+			fvdbg("logicalsector : physicalsector -> %d : %d; status_released: %d, status_committed: %d\n", logicalsector, sector, status_released, status_committed);
 		}
+	}
 
-		/* Test if this sector has been committed */
+	/* Test if this sector has been committed */
 
-		if (!status_committed) {
-			/* Confirm that this sector is truly blank. */
-			if (logicalsector < dev->totalsectors) {
-				/* This sector might have been corrupted. committ and release this */
+	if (!status_committed) {
+		/* Confirm that this sector is truly blank. */
+		if (logicalsector < dev->totalsectors) {
+			/* This sector might have been corrupted. committ and release this */
 #if CONFIG_SMARTFS_ERASEDSTATE == 0xFF
-				header.status = header.status & ~(SMART_STATUS_COMMITTED | SMART_STATUS_RELEASED);
+			header.status = header.status & ~(SMART_STATUS_COMMITTED | SMART_STATUS_RELEASED);
 #else
-				header.status = header.status | SMART_STATUS_COMMITTED | SMART_STATUS_RELEASED;
+			header.status = header.status | SMART_STATUS_COMMITTED | SMART_STATUS_RELEASED;
 #endif
-				status_committed = true;
-				status_released = true;
-				ret = smart_bytewrite(dev, readaddress + offsetof(struct smart_sect_header_s, status), 1, &header.status);
-				if (ret < 0) {
-					goto err_out;
-				}
-			} else {
-				continue;
+			status_committed = true;
+			status_released = true;
+			ret = smart_bytewrite(dev, readaddress + offsetof(struct smart_sect_header_s, status), 1, &header.status);
+			if (ret < 0) {
+				goto err_out;
 			}
+		} else {
+			/* This sector is free */
+
+			return OK;
 		}
+	}
 
-		/* This block is commited, therefore not free.  Update the
-		 * erase block's freecount.
-		 */
+	/* This block is commited, therefore not free.  Update the
+	 * erase block's freecount.
+	 */
+
+	smart_ckpt_written(dev, sector);
 
 #ifdef CONFIG_MTD_SMART_PACK_COUNTS
-		smart_add_count(dev, dev->freecount, sector / dev->sectorsPerBlk, -1);
+	smart_add_count(dev, dev->freecount, sector / dev->sectorsPerBlk, -1);
 #else
-		dev->freecount[sector / dev->sectorsPerBlk]--;
+	dev->freecount[sector / dev->sectorsPerBlk]--;
 #endif
-		dev->freesectors--;
+	dev->freesectors--;
 
-		/* Test if this sector has been release and if it has,
-		 * update the erase block's releasecount.
-		 */
+	/* Test if this sector has been release and if it has,
+	 * update the erase block's releasecount.
+	 */
 
-		if (status_released) {
-			/* Keep track of the total number of released sectors and
-			 * released sectors per erase block.
-			 */
+	if (status_released) {
+		/* Keep track of the total number of released sectors and
+		 * released sectors per erase block.
+		 */
 
-			dev->releasesectors++;
+		dev->releasesectors++;
 #ifdef CONFIG_MTD_SMART_PACK_COUNTS
-			smart_add_count(dev, dev->releasecount, sector / dev->sectorsPerBlk, 1);
+		smart_add_count(dev, dev->releasecount, sector / dev->sectorsPerBlk, 1);
 #else
-			dev->releasecount[sector / dev->sectorsPerBlk]++;
+		dev->releasecount[sector / dev->sectorsPerBlk]++;
 #endif
-			continue;
-		}
+		smart_gc_update(dev, sector / dev->sectorsPerBlk);
+		return OK;
+	}
 
-		if ((header.status & SMART_STATUS_VERBITS) != SMART_STATUS_VERSION) {
-			continue;
+	if ((header.status & SMART_STATUS_VERBITS) != SMART_STATUS_VERSION) {
+		return OK;
+	}
+
+	/* Validate the logical sector number is in bounds */
+
+	if (logicalsector >= dev->totalsectors) {
+		/* Error in logical sector read from the MTD device */
+
+		fdbg("Invalid logical sector %d at physical %d.\n", logicalsector, sector);
+		return OK;
+	}
+
+	/* If this is logical sector zero, then read in the signature
+	 * information to validate the format signature.
+	 */
+
+	if (logicalsector == 0) {
+		ret = smart_scan_format(dev, sector);
+		if (ret != OK) {
+			goto err_out;
 		}
+	}
 
-		/* Validate the logical sector number is in bounds */
+	/* Test for duplicate logical sectors on the device */
 
-		if (logicalsector >= totalsectors) {
-			/* Error in logical sector read from the MTD device */
+#ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
+	if (dev->sMap[logicalsector] != 0xFFFF)
+#else
+	if (dev->sBitMap[logicalsector >> 3] & (1 << (logicalsector & 0x07)))
+#endif
+	{
+		/* Uh-oh, we found more than 1 physical sector claiming to be
+		 * the same logical sector.  Use the sequence number information
+		 * to resolve who wins.
+		 */
 
-			fdbg("Invalid logical sector %d at physical %d.\n", logicalsector, sector);
-			continue;
+#if SMART_STATUS_VERSION == 1
+		if (header.status & SMART_STATUS_CRC) {
+			seq2 = header.seq;
+		} else {
+			//seq2 = *((FAR uint16_t *)&header.seq);
+			seq2 = (uint16_t)(((header.crc8 << 8) & 0xFF00) | header.seq);
 		}
+#else
+		seq2 = header.seq;
+#endif
+
+		/* We must re-read the 1st physical sector to get it's seq number */
 
-		/* If this is logical sector zero, then read in the signature
-		 * information to validate the format signature.
+#ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
+		readaddress = dev->sMap[logicalsector] * dev->mtdBlksPerSector * dev->geo.blocksize;
+#else
+		/* For minimize RAM, we have to rescan to find the 1st sector claiming to
+		 * be this logical sector.
 		 */
 
-		if (logicalsector == 0) {
-			/* Read the sector data */
+		for (dupsector = 0; dupsector < sector; dupsector++) {
+			/* Calculate the read address for this sector */
 
-			ret = MTD_READ(dev->mtd, readaddress, 32, (FAR uint8_t *)dev->rwbuffer);
-			if (ret != 32) {
-				fdbg("Error reading physical sector %d.\n", sector);
+			readaddress = dupsector * dev->mtdBlksPerSector * dev->geo.blocksize;
+
+			/* Read the header for this sector */
+
+			ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
+			if (ret != sizeof(struct smart_sect_header_s)) {
 				goto err_out;
 			}
 
-			dev->formatstatus = SMART_FMT_STAT_FORMATTED;
-			dev->namesize = dev->rwbuffer[SMART_FMT_NAMESIZE_POS];
-			dev->formatversion = dev->rwbuffer[SMART_FMT_VERSION_POS];
+			/* Get the logical sector number for this physical sector */
 
-#ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
-			dev->rootdirentries = dev->rwbuffer[SMART_FMT_ROOTDIRS_POS];
-
-			/* If rootdirentries is greater than 1, then we need to register
-			 * additional block devices.
-			 */
+			duplogsector = *((FAR uint16_t *)header.logicalsector);
+#if CONFIG_SMARTFS_ERASEDSTATE == 0x00
+			if (duplogsector == 0) {
+				duplogsector = -1;
+			}
+#endif
 
-			for (x = 1; x < dev->rootdirentries; x++) {
-				if (dev->partname[0] != '\0') {
-					snprintf(dev->rwbuffer, sizeof(devname), "/dev/smart%d%sd%d", dev->minor, dev->partname, x + 1);
-				} else {
-					snprintf(devname, sizeof(devname), "/dev/smart%dd%d", dev->minor, x + 1);
-				}
+			/* Test if this sector has been committed */
 
-				/* Inode private data is a reference to a struct containing
-				 * the SMART device structure and the root directory number.
-				 */
+			if (!SECTOR_IS_COMMITTED(header)) {
+				continue;
+			}
 
-				rootdirdev = (struct smart_multiroot_device_s *)smart_malloc(dev, sizeof(*rootdirdev), "Root Dir");
-				if (rootdirdev == NULL) {
-					fdbg("Memory alloc failed\n");
-					ret = -ENOMEM;
-					goto err_out;
-				}
+			/* Test if this sector has been release and skip it if it has */
 
-				/* Populate the rootdirdev */
+			if (SECTOR_IS_RELEASED(header)) {
+				continue;
+			}
 
-				rootdirdev->dev = dev;
-				rootdirdev->rootdirnum = x;
-				ret = register_blockdriver(dev->rwbuffer, &g_bops, 0, rootdirdev);
+			if ((header.status & SMART_STATUS_VERBITS) != SMART_STATUS_VERSION) {
+				continue;
+			}
 
-				/* Inode private data is a reference to the SMART device structure */
+			/* Now compare if this logical sector matches the current sector */
 
-				ret = register_blockdriver(devname, &g_bops, 0, rootdirdev);
+			if (duplogsector == logicalsector) {
+				break;
 			}
-#endif
 		}
-
-		/* Test for duplicate logical sectors on the device */
-
-#ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
-		if (dev->sMap[logicalsector] != 0xFFFF)
-#else
-		if (dev->sBitMap[logicalsector >> 3] & (1 << (logicalsector & 0x07)))
 #endif
-		{
-			/* Uh-oh, we found more than 1 physical sector claiming to be
-			 * the same logical sector.  Use the sequence number information
-			 * to resolve who wins.
-			 */
 
+		ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
+		if (ret != sizeof(struct smart_sect_header_s)) {
+			goto err_out;
+		}
 #if SMART_STATUS_VERSION == 1
-			if (header.status & SMART_STATUS_CRC) {
-				seq2 = header.seq;
-			} else {
-				//seq2 = *((FAR uint16_t *)&header.seq);
-				seq2 = (uint16_t)(((header.crc8 << 8) & 0xFF00) | header.seq);
-			}
+		if (header.status & SMART_STATUS_CRC) {
+			seq1 = header.seq;
+		} else {
+			seq1 = (uint16_t)(((header.crc8 << 8) & 0xFF00) | header.seq);
+		}
 #else
-			seq2 = header.seq;
+		seq1 = header.seq;
 #endif
 
-			/* We must re-read the 1st physical sector to get it's seq number */
+		/* Now determine who wins.  A 1st sector released since the sector
+		 * map was checkpointed has been superseded by this one.
+		 */
+
+		if (SECTOR_IS_RELEASED(header) || (seq1 > 0xFFF0 && seq2 < 10) || seq2 > seq1) {
+			/* Seq 2 is the winner ... bigger or it wrapped */
 
 #ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
-			readaddress = dev->sMap[logicalsector] * dev->mtdBlksPerSector * dev->geo.blocksize;
+			loser = dev->sMap[logicalsector];
+			dev->sMap[logicalsector] = sector;
 #else
-			/* For minimize RAM, we have to rescan to find the 1st sector claiming to
-			 * be this logical sector.
-			 */
+			loser = dupsector;
+#endif
+		} else {
+			/* We keep the original mapping and seq2 is the loser */
 
-			for (dupsector = 0; dupsector < sector; dupsector++) {
-				/* Calculate the read address for this sector */
+			loser = sector;
+		}
 
-				readaddress = dupsector * dev->mtdBlksPerSector * dev->geo.blocksize;
+		/* Now release the loser sector */
 
-				/* Read the header for this sector */
+		readaddress = loser * dev->mtdBlksPerSector * dev->geo.blocksize;
+		ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
+		if (ret != sizeof(struct smart_sect_header_s)) {
+			goto err_out;
+		}
+#if CONFIG_SMARTFS_ERASEDSTATE == 0xFF
+		header.status &= ~SMART_STATUS_RELEASED;
+#else
+		header.status |= SMART_STATUS_RELEASED;
+#endif
+		offset = readaddress + offsetof(struct smart_sect_header_s, status);
+		ret = smart_bytewrite(dev, offset, 1, &header.status);
+		if (ret < 0) {
+			fdbg("Error %d releasing duplicate sector\n", -ret);
+			goto err_out;
+		}
 
-				ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
-				if (ret != sizeof(struct smart_sect_header_s)) {
-					goto err_out;
-				}
+		/* The loser no longer counts as in use */
 
-				/* Get the logical sector number for this physical sector */
+		dev->releasesectors++;
+#ifdef CONFIG_MTD_SMART_PACK_COUNTS
+		smart_add_count(dev, dev->releasecount, loser / dev->sectorsPerBlk, 1);
+#else
+		dev->releasecount[loser / dev->sectorsPerBlk]++;
+#endif
+		smart_gc_update(dev, loser / dev->sectorsPerBlk);
 
-				duplogsector = *((FAR uint16_t *)header.logicalsector);
-#if CONFIG_SMARTFS_ERASEDSTATE == 0x00
-				if (duplogsector == 0) {
-					duplogsector = -1;
-				}
+		if (loser == sector) {
+			return OK;
+		}
+	}
+#ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
+	/* Update the logical to physical sector map */
+
+	dev->sMap[logicalsector] = sector;
+#else
+	/* Mark the logical sector as used in the bitmap */
+	dev->sBitMap[logicalsector >> 3] |= 1 << (logicalsector & 0x07);
+
+	if (logicalsector < dev->reservedsector) {
+		smart_add_sector_to_cache(dev, logicalsector, sector, __LINE__);
+	}
 #endif
 
-				/* Test if this sector has been committed */
+	return OK;
 
-				if (!SECTOR_IS_COMMITTED(header)) {
-					continue;
-				}
+err_out:
+	return ret;
+}
 
-				/* Test if this sector has been release and skip it if it has */
+/****************************************************************************
+ * Name: smart_scan
+ *
+ * Description: Performs a scan of the MTD device searching for format
+ *              information and fills in logical sector mapping, freesector
+ *              count, etc.
+ *
+ ****************************************************************************/
 
-				if (SECTOR_IS_RELEASED(header)) {
-					continue;
-				}
+static int smart_scan(FAR struct smart_struct_s *dev)
+{
+	int sector;
+	int ret;
+	uint16_t totalsectors;
+	uint16_t sectorsize, prerelease;
+	uint32_t readaddress;
+	uint32_t offset;
+	struct smart_sect_header_s header;
+	uint8_t *sector_seq_log = NULL;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	uint16_t slotblocks;
+#endif
 
-				if ((header.status & SMART_STATUS_VERBITS) != SMART_STATUS_VERSION) {
-					continue;
-				}
+	fvdbg("Entry\n");
 
-				/* Now compare if this logical sector matches the current sector */
+	/* Find the sector size on the volume by reading headers from
+	 * sectors of decreasing size.  On a formatted volume, the sector
+	 * size is saved in the header status byte of seach sector, so
+	 * by starting with the largest supported sector size and
+	 * decreasing from there, we will be sure to find data that is
+	 * a header and not sector data.
+	 */
 
-				if (duplogsector == logicalsector) {
-					break;
-				}
-			}
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+rescan:
+	slotblocks = dev->ckptslotblocks;
 #endif
+	sectorsize = 0xFFFF;
+	offset = 16384;
+
+	while (sectorsize == 0xFFFF) {
+		readaddress = 0;
+
+		while (readaddress < dev->erasesize * dev->geo.neraseblocks) {
+			/* Read the next sector from the device */
 
 			ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
 			if (ret != sizeof(struct smart_sect_header_s)) {
 				goto err_out;
 			}
-#if SMART_STATUS_VERSION == 1
-			if (header.status & SMART_STATUS_CRC) {
-				seq1 = header.seq;
-			} else {
-				seq1 = (uint16_t)(((header.crc8 << 8) & 0xFF00) | header.seq);
+
+			if (header.status != CONFIG_SMARTFS_ERASEDSTATE) {
+				sectorsize = (header.status & SMART_STATUS_SIZEBITS) << 7;
+				break;
 			}
-#else
-			seq1 = header.seq;
+
+			readaddress += offset;
+		}
+
+		offset >>= 1;
+		if (offset < 256 && sectorsize == 0xFFFF) {
+			sectorsize = CONFIG_MTD_SMART_SECTOR_SIZE;
+		}
+	}
+
+	/* Now set the sectorsize and other sectorsize derived variables */
+
+	ret = smart_setsectorsize(dev, sectorsize);
+	if (ret != OK) {
+		goto err_out;
+	}
+
+	/* Initialize the device variables */
+
+	totalsectors = dev->totalsectors;
+
+	dev->reservedsector = SMART_FIRST_ALLOC_SECTOR;
+#ifdef CONFIG_SMARTFS_JOURNALING
+	if (totalsectors > CONFIG_SMARTFS_JOURNALING_THRESHOLD) {
+		dev->reservedsector += 2 * CONFIG_SMARTFS_NLOGGING_SECTORS;
+	}
 #endif
 
-			/* Now determine who wins */
+	dev->formatstatus = SMART_FMT_STAT_NOFMT;
+	dev->freesectors = dev->availSectPerBlk * dev->geo.neraseblocks;
+	dev->releasesectors = 0;
 
-			if ((seq1 > 0xFFF0 && seq2 < 10) || seq2 > seq1) {
-				/* Seq 2 is the winner ... bigger or it wrapped */
+	/* Initialize the freecount and releasecount arrays */
+
+	for (sector = 0; sector < dev->neraseblocks; sector++) {
+		if (sector == dev->neraseblocks - 1 && dev->totalsectors == 65534) {
+			prerelease = 2;
+		} else {
+			prerelease = 0;
+		}
+
+#ifdef CONFIG_MTD_SMART_PACK_COUNTS
+		smart_set_count(dev, dev->freecount, sector, dev->availSectPerBlk - prerelease);
+		smart_set_count(dev, dev->releasecount, sector, prerelease);
+#else
+		dev->freecount[sector] = dev->availSectPerBlk - prerelease;
+		dev->releasecount[sector] = prerelease;
+#endif
+		smart_gc_update(dev, sector);
+	}
+
+	/* Initialize the sector map */
 
 #ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
-				loser = dev->sMap[logicalsector];
-				dev->sMap[logicalsector] = sector;
+	for (sector = 0; sector < totalsectors; sector++) {
+		dev->sMap[sector] = -1;
+	}
 #else
-				loser = dupsector;
+	/* Clear all logical sector used bits */
+
+	memset(dev->sBitMap, 0, (dev->totalsectors + 7) >> 3);
 #endif
-			} else {
-				/* We keep the original mapping and seq2 is the loser */
 
-				loser = sector;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	/* All sectors are free until found written */
+
+	memset(dev->ckptfree, 0xFF, (totalsectors + 7) >> 3);
+#endif
+
+	/* Now scan the MTD device */
+	sector_seq_log = (uint8_t *)kmm_zalloc(sizeof(uint8_t) * totalsectors);
+
+	if (sector_seq_log == NULL) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	/* Start from the checkpoint of the sector map if there is one up to
+	 * date.  Only the sectors that were free when it was written can have
+	 * been written since.
+	 */
+
+	ret = smart_ckpt_load(dev);
+	if (ret != OK && ret != -ENOENT) {
+		goto err_out;
+	}
+
+	if (ret == OK) {
+		for (sector = 0; sector < totalsectors; sector++) {
+			if (!SMART_CKPT_ISFREE(dev, sector)) {
+				continue;
+			}
+
+			ret = smart_scan_sector(dev, sector, sector_seq_log);
+			if (ret != OK) {
+				goto err_out;
+			}
+#ifndef CONFIG_MTD_SMART_ENABLE_CRC
+			/* The sectors of an erase block are allocated in order, so the
+			 * rest of the erase block is free too.
+			 */
+
+			if (SMART_CKPT_ISFREE(dev, sector)) {
+				sector = (sector / dev->sectorsPerBlk + 1) * dev->sectorsPerBlk - 1;
 			}
+#endif
+		}
 
-			/* Now release the loser sector */
+		/* Read the format information if logical sector zero was not
+		 * written since the checkpoint.
+		 */
 
-			readaddress = loser * dev->mtdBlksPerSector * dev->geo.blocksize;
-			ret = MTD_READ(dev->mtd, readaddress, sizeof(struct smart_sect_header_s), (FAR uint8_t *)&header);
-			if (ret != sizeof(struct smart_sect_header_s)) {
+		if (dev->formatstatus != SMART_FMT_STAT_FORMATTED && dev->sMap[0] != 0xFFFF) {
+			ret = smart_scan_format(dev, dev->sMap[0]);
+			if (ret != OK) {
 				goto err_out;
 			}
-#if CONFIG_SMARTFS_ERASEDSTATE == 0xFF
-			header.status &= ~SMART_STATUS_RELEASED;
-#else
-			header.status |= SMART_STATUS_RELEASED;
+		}
+	} else
 #endif
-			offset = readaddress + offsetof(struct smart_sect_header_s, status);
-			ret = smart_bytewrite(dev, offset, 1, &header.status);
-			if (ret < 0) {
-				fdbg("Error %d releasing duplicate sector\n", -ret);
+	{
+		for (sector = 0; sector < totalsectors; sector++) {
+			ret = smart_scan_sector(dev, sector, sector_seq_log);
+			if (ret != OK) {
 				goto err_out;
 			}
 		}
-#ifndef CONFIG_MTD_SMART_MINIMIZE_RAM
-		/* Update the logical to physical sector map */
-
-		dev->sMap[logicalsector] = sector;
-#else
-		/* Mark the logical sector as used in the bitmap */
-		dev->sBitMap[logicalsector >> 3] |= 1 << (logicalsector & 0x07);
 
-		if (logicalsector < dev->reservedsector) {
-			smart_add_sector_to_cache(dev, logicalsector, sector, __LINE__);
-		}
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+		dev->ckptvalid = false;
+		dev->ckptdirty = 0;
 #endif
 	}
 
@@ -2211,6 +2952,7 @@ static int smart_scan(FAR struct smart_struct_s *dev)
 			smart_add_count(dev, dev->freecount, newsector / dev->sectorsPerBlk, -1);
 			smart_add_count(dev, dev->releasecount, sector / dev->sectorsPerBlk, 1);
 #endif
+			smart_gc_update(dev, sector / dev->sectorsPerBlk);
 
 		}
 	}
@@ -2242,7 +2984,20 @@ static int smart_scan(FAR struct smart_struct_s *dev)
 err_out:
 	if (sector_seq_log != NULL) {
 		kmm_free(sector_seq_log);
+		sector_seq_log = NULL;
+	}
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+
+	/* The format sector moved the end of the sector area, start over with
+	 * the new geometry.
+	 */
+
+	if (ret == -EAGAIN && dev->ckptslotblocks != slotblocks) {
+		dev->sectorsize = 0;
+		goto rescan;
 	}
+#endif
+
 	return ret;
 }
 
@@ -2339,7 +3094,9 @@ static void smart_erase_block_if_empty(FAR struct smart_struct_s *dev, uint16_t
 		dev->unusedsectors += freecount;
 		dev->blockerases++;
 #endif
+		smart_ckpt_invalidate(dev);
 		MTD_ERASE(dev->mtd, block, 1);
+		smart_ckpt_erased(dev, block);
 
 #ifdef CONFIG_MTD_SMART_SECTOR_ERASE_DEBUG
 		if (dev->erasecounts) {
@@ -2373,6 +3130,7 @@ static void smart_erase_block_if_empty(FAR struct smart_struct_s *dev, uint16_t
 		dev->releasecount[block] = prerelease;
 		dev->freecount[block] = dev->availSectPerBlk - prerelease;
 #endif							/* CONFIG_MTD_SMART_PACK_COUNTS */
+		smart_gc_update(dev, block);
 
 		/* Now that we have erased this block and updated the release / free counts,
 		 * if we are in WEAR LEVELING enabled mode, we must check if this erase block's
@@ -2752,6 +3510,9 @@ static inline int smart_llformat(FAR struct smart_struct_s *dev, unsigned long a
 	int x;
 	int ret;
 	uint8_t sectsize, prerelease;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+	uint16_t slotblocks;
+#endif
 
 	fvdbg("Entry\n");
 
@@ -2782,6 +3543,27 @@ static inline int smart_llformat(FAR struct smart_struct_s *dev, unsigned long a
 	if (ret < 0) {
 		return ret;
 	}
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+
+	/* The checkpoints were erased too.  The device may have been mounted
+	 * with the slots recorded by an older format, take the slots of this
+	 * build again.
+	 */
+
+	slotblocks = dev->ckptslotblocks;
+	smart_ckpt_reserve(dev);
+	if (dev->ckptslotblocks != slotblocks) {
+		dev->sectorsize = 0;
+		ret = smart_setsectorsize(dev, CONFIG_MTD_SMART_SECTOR_SIZE);
+		if (ret != OK) {
+			return ret;
+		}
+	}
+
+	/* The first checkpoint can go to the erased slot right away */
+
+	dev->ckptnext = 0;
+#endif
 
 	/* Now construct a logical sector zero header to write to the device. */
 
@@ -2839,6 +3621,12 @@ static inline int smart_llformat(FAR struct smart_struct_s *dev, unsigned long a
 	/* Record the number of root directory entries we have */
 
 	dev->rwbuffer[SMART_FMT_ROOTDIRS_POS] = (uint8_t)arg;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+
+	/* Record the checkpoint slots taken off the end of the device */
+
+	dev->rwbuffer[SMART_FMT_CKPT_POS] = (uint8_t)dev->ckptslotblocks;
+#endif
 
 #ifdef CONFIG_SMART_CRC_8
 	sectorheader->crc8 = smart_calc_sector_crc(dev);
@@ -2894,6 +3682,7 @@ static inline int smart_llformat(FAR struct smart_struct_s *dev, unsigned long a
 		dev->releasecount[x] = prerelease;
 		dev->freecount[x] = dev->availSectPerBlk - prerelease;
 #endif
+		smart_gc_update(dev, x);
 	}
 
 	/* Account for the format sector */
@@ -3000,6 +3789,7 @@ static int smart_relocate_sector(FAR struct smart_struct_s *dev, uint16_t oldsec
 	/* Write the data to the new physical sector location */
 
 	ret = MTD_BWRITE(dev->mtd, newsector * dev->mtdBlksPerSector, dev->mtdBlksPerSector, (FAR uint8_t *)dev->rwbuffer);
+	smart_ckpt_written(dev, newsector);
 
 #else							/* CONFIG_MTD_SMART_ENABLE_CRC */
 
@@ -3012,6 +3802,7 @@ static int smart_relocate_sector(FAR struct smart_struct_s *dev, uint16_t oldsec
 	/* Write the data to the new physical sector location */
 
 	ret = MTD_BWRITE(dev->mtd, newsector * dev->mtdBlksPerSector, dev->mtdBlksPerSector, (FAR uint8_t *)dev->rwbuffer);
+	smart_ckpt_written(dev, newsector);
 
 	/* Commit the sector */
 
@@ -3223,7 +4014,9 @@ static int smart_relocate_block(FAR struct smart_struct_s *dev, uint16_t block)
 
 	/* Now erase the erase block */
 
+	smart_ckpt_invalidate(dev);
 	MTD_ERASE(dev->mtd, block, 1);
+	smart_ckpt_erased(dev, block);
 #if defined(CONFIG_FS_PROCFS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_SMARTFS)
 	dev->unusedsectors += freecount;
 	dev->blockerases++;
@@ -3267,6 +4060,7 @@ static int smart_relocate_block(FAR struct smart_struct_s *dev, uint16_t block)
 	dev->freecount[block] = dev->availSectPerBlk - prerelease;
 	dev->releasecount[block] = prerelease;
 #endif
+	smart_gc_update(dev, block);
 
 #ifdef CONFIG_SMART_LOCAL_CHECKFREE
 	if (smart_checkfree(dev, __LINE__) != OK) {
@@ -3508,12 +4302,45 @@ retry:
 	return physicalsector;
 }
 
+/****************************************************************************
+ * Name: smart_gc_findblock
+ *
+ * Description:  Return the erase block with the most released sectors, at
+ *               least 'minrelease', or 0xFFFF if there is none.  Blocks that
+ *               have been worn completely are not collected.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_BGGC
+static uint16_t smart_gc_findblock(FAR struct smart_struct_s *dev, uint8_t minrelease)
+{
+	uint16_t block;
+	int count;
+
+	for (count = dev->availSectPerBlk; count >= minrelease && count > 0; count--) {
+		for (block = dev->gchead[count]; block != 0xFFFF; block = dev->gclink[block << 1]) {
+#ifdef CONFIG_MTD_SMART_WEAR_LEVEL
+			if (smart_get_wear_level(dev, block) >= SMART_WEAR_REORG_THRESHOLD) {
+				continue;
+			}
+#endif
+
+			return block;
+		}
+	}
+
+	return 0xFFFF;
+}
+#endif
+
 /****************************************************************************
  * Name: smart_garbagecollect
  *
  * Description:  Performs garbage collection if needed.  This is determined
  *               by the count of released sectors relative to free and
- *               total sectors.
+ *               total sectors.  With the background garbage collection, the
+ *               writers only collect when the reserved free sector limit is
+ *               reached.
  *
  ****************************************************************************/
 
@@ -3521,17 +4348,20 @@ retry:
 static int smart_garbagecollect(FAR struct smart_struct_s *dev)
 {
 	uint16_t collectblock;
-	uint16_t releasemax;
 	bool collect = TRUE;
-	int x;
 	int ret;
+#ifndef CONFIG_MTD_SMART_BGGC
+	uint16_t releasemax;
+	int x;
 #ifdef CONFIG_MTD_SMART_PACK_COUNTS
 	uint8_t count;
+#endif
 #endif
 
 	while (collect) {
 		collect = FALSE;
 
+#ifndef CONFIG_MTD_SMART_BGGC
 		/* Test if the released sectors count is greater than the
 		 * free sectors.  If it is, then we will do garbage collection.
 		 */
@@ -3539,6 +4369,7 @@ static int smart_garbagecollect(FAR struct smart_struct_s *dev)
 		if (dev->releasesectors > dev->freesectors && dev->freesectors < (dev->totalsectors >> 5)) {
 			collect = TRUE;
 		}
+#endif
 
 		/* Test if we have more reached our reserved free sector limit */
 
@@ -3551,6 +4382,9 @@ static int smart_garbagecollect(FAR struct smart_struct_s *dev)
 		if (collect) {
 			/* Find the block with the most released sectors */
 
+#ifdef CONFIG_MTD_SMART_BGGC
+			collectblock = smart_gc_findblock(dev, 1);
+#else
 			collectblock = 0xFFFF;
 			releasemax = 0;
 			for (x = 0; x < dev->neraseblocks; x++) {
@@ -3576,6 +4410,7 @@ static int smart_garbagecollect(FAR struct smart_struct_s *dev)
 #endif
 			}
 			//releasemax = smart_get_count(dev, dev->releasecount, collectblock);
+#endif
 
 			if (collectblock == 0xFFFF) {
 				/* Need to collect, but no sectors with released blocks! */
@@ -3892,6 +4727,7 @@ static int smart_write_alloc_sector(FAR struct smart_struct_s *dev, uint16_t log
 #ifndef CONFIG_MTD_SMART_ENABLE_CRC
 	fvdbg("Write MTD block %d\n", physical * dev->mtdBlksPerSector);
 	ret = MTD_BWRITE(dev->mtd, physical * dev->mtdBlksPerSector, 1, (FAR uint8_t *)dev->rwbuffer);
+	smart_ckpt_written(dev, physical);
 	if (ret != 1) {
 		/* The block is not empty!!  What to do? */
 
@@ -4220,6 +5056,7 @@ relocate_good_sector:
 		/* Write the entire sector to the new physical location, uncommitted. */
 
 		ret = MTD_BWRITE(dev->mtd, physsector * dev->mtdBlksPerSector, dev->mtdBlksPerSector, (FAR uint8_t *)dev->rwbuffer);
+		smart_ckpt_written(dev, physsector);
 		if (ret != dev->mtdBlksPerSector) {
 			fdbg("Error writing to physical sector %d\n", physsector);
 			ret = -EIO;
@@ -4288,6 +5125,7 @@ relocate_good_sector:
 		dev->releasecount[block]++;
 		dev->freecount[physsector / dev->sectorsPerBlk]--;
 #endif
+		smart_gc_update(dev, block);
 		dev->freesectors--;
 		dev->releasesectors++;
 
@@ -4319,6 +5157,7 @@ relocate_good_sector:
 		/* Write the entire sector to FLASH when CRC enabled */
 
 		ret = MTD_BWRITE(dev->mtd, physsector * dev->mtdBlksPerSector, dev->mtdBlksPerSector, (FAR uint8_t *)dev->rwbuffer);
+		smart_ckpt_written(dev, physsector);
 		if (ret != dev->mtdBlksPerSector) {
 			fdbg("Error writing to physical sector %d\n", physsector);
 			ret = -EIO;
@@ -4408,6 +5247,7 @@ errout:
 		dev->releasecount[block]++;
 		dev->freecount[physsector / dev->sectorsPerBlk]--;
 #endif
+		smart_gc_update(dev, block);
 		dev->freesectors--;
 		dev->releasesectors++;
 
@@ -4858,6 +5698,7 @@ static inline int smart_freesector(FAR struct smart_struct_s *dev, unsigned long
 
 	/* Write the status back to the device */
 
+	smart_ckpt_invalidate(dev);
 	offset = readaddr + offsetof(struct smart_sect_header_s, status);
 	ret = smart_bytewrite(dev, offset, 1, &header.status);
 	if (ret != 1) {
@@ -4874,6 +5715,7 @@ static inline int smart_freesector(FAR struct smart_struct_s *dev, unsigned long
 #else
 	dev->releasecount[block]++;
 #endif
+	smart_gc_update(dev, block);
 
 	/* Unmap this logical sector */
 
@@ -4894,6 +5736,297 @@ errout:
 }
 #endif							/* CONFIG_FS_WRITABLE */
 
+/****************************************************************************
+ * Name: smart_checkpoint
+ *
+ * Description: Writes a checkpoint of the sector map, the release and free
+ *              counts and the free sector bitmap if anything changed since
+ *              the last one.  The checkpoint is appended to the slot of the
+ *              previous one, or to the other slot after erasing it once the
+ *              slot is full.  The data is written first and the header last,
+ *              then the previous checkpoint is marked out of date.  Must be
+ *              called with the device excluded.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static int smart_checkpoint(FAR struct smart_struct_s *dev)
+{
+	FAR struct smart_ckpt_header_s *header;
+	FAR uint8_t *data;
+	uint32_t datasize;
+	uint32_t done;
+	uint32_t towrite;
+	uint32_t mtdblock;
+	uint32_t offset;
+	uint16_t nrecords;
+	uint16_t rec;
+	uint8_t slot;
+	int ret;
+
+	if (dev->ckptslotblocks == 0 || dev->formatstatus != SMART_FMT_STAT_FORMATTED || (dev->ckptvalid && dev->ckptdirty == 0)) {
+		return OK;
+	}
+#ifdef CONFIG_MTD_SMART_ENABLE_CRC
+	/* Sectors allocated but not written yet are counted as used, but the
+	 * mount would find them free.
+	 */
+
+	if (dev->allocsector != NULL) {
+		return OK;
+	}
+#endif
+
+#ifdef CONFIG_MTD_SMART_WEAR_LEVEL
+	/* The mount reads the wear status from the device */
+
+	if (dev->wearflags & SMART_WEARFLAGS_WRITE_NEEDED) {
+		ret = smart_write_wearstatus(dev);
+		if (ret != OK) {
+			return ret;
+		}
+	}
+#endif
+
+	/* The device may be formatted with a smaller sector size than the slots
+	 * were reserved for.
+	 */
+
+	nrecords = smart_ckpt_nrecords(dev);
+	if (nrecords == 0) {
+		return OK;
+	}
+
+	slot = dev->ckptslot;
+	rec = dev->ckptnext;
+	if (rec >= nrecords) {
+		slot ^= 1;
+		rec = 0;
+		ret = MTD_ERASE(dev->mtd, SMART_CKPT_SLOTBLOCK(dev, slot), dev->ckptslotblocks);
+		if (ret < 0) {
+			fdbg("Error %d erasing checkpoint slot %d\n", -ret, slot);
+			return ret;
+		}
+	}
+
+	/* Write the data after the header sector.  A record written in part
+	 * is never written again, the slot is erased first.
+	 */
+
+	dev->ckptnext = SMART_CKPT_FULL;
+	datasize = smart_ckpt_datasize(dev);
+	data = (FAR uint8_t *)dev->sMap;
+	offset = SMART_CKPT_RECOFFSET(dev, slot, rec);
+	mtdblock = offset / dev->geo.blocksize;
+	for (done = 0; done < datasize; done += towrite) {
+		towrite = datasize - done;
+		if (towrite > dev->sectorsize) {
+			towrite = dev->sectorsize;
+		}
+
+		memset(dev->rwbuffer, CONFIG_SMARTFS_ERASEDSTATE, dev->sectorsize);
+		memcpy(dev->rwbuffer, &data[done], towrite);
+
+		mtdblock += dev->mtdBlksPerSector;
+		ret = MTD_BWRITE(dev->mtd, mtdblock, dev->mtdBlksPerSector, (FAR uint8_t *)dev->rwbuffer);
+		if (ret != dev->mtdBlksPerSector) {
+			fdbg("Error writing checkpoint slot %d\n", slot);
+			return -EIO;
+		}
+	}
+
+	/* Then the header, which makes the checkpoint valid */
+
+	memset(dev->rwbuffer, CONFIG_SMARTFS_ERASEDSTATE, dev->sectorsize);
+	header = (FAR struct smart_ckpt_header_s *)dev->rwbuffer;
+	memcpy(header->magic, SMART_CKPT_MAGIC, 4);
+	header->seq = dev->ckptseq + 1;
+	header->sectorsize = dev->sectorsize;
+	header->totalsectors = dev->totalsectors;
+	header->neraseblocks = dev->neraseblocks;
+	header->freesectors = dev->freesectors;
+	header->releasesectors = dev->releasesectors;
+	header->datasize = datasize;
+	header->datacrc = crc32(data, datasize);
+	header->crc = crc32((FAR const uint8_t *)header, offsetof(struct smart_ckpt_header_s, crc));
+
+	ret = MTD_BWRITE(dev->mtd, offset / dev->geo.blocksize, dev->mtdBlksPerSector, (FAR uint8_t *)dev->rwbuffer);
+	if (ret != dev->mtdBlksPerSector) {
+		fdbg("Error writing checkpoint slot %d header\n", slot);
+		return -EIO;
+	}
+
+	/* The mount takes the latest valid checkpoint, retire the previous one
+	 * so that it is never taken instead.  Retiring it may erase a block of
+	 * the slot, then the next checkpoint goes to the other slot.
+	 */
+
+	dev->ckptnext = rec + 1;
+	smart_ckpt_invalidate(dev);
+
+	fvdbg("Wrote checkpoint %d to slot %d record %d\n", dev->ckptseq + 1, slot, rec);
+	dev->ckptseq++;
+	dev->ckptslot = slot;
+	dev->ckptrec = rec;
+	dev->ckptvalid = true;
+	dev->ckptdirty = 0;
+	return OK;
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_setslots
+ *
+ * Description: Moves the end of the sector area to leave room for two
+ *              checkpoint slots of 'slotblocks' erase blocks, or for none.
+ *              The sector size must be set again afterwards.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static void smart_ckpt_setslots(FAR struct smart_struct_s *dev, uint16_t slotblocks)
+{
+	dev->geo.neraseblocks += dev->ckptslotblocks * 2;
+	dev->geo.neraseblocks -= slotblocks * 2;
+	dev->ckptseq = 0;
+	dev->ckptdirty = 0;
+	dev->ckptslotblocks = slotblocks;
+	dev->ckptslot = 0;
+	dev->ckptrec = 0;
+	dev->ckptnext = SMART_CKPT_FULL;
+	dev->ckptvalid = false;
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_ckpt_reserve
+ *
+ * Description: Reserves the two checkpoint slots at the end of the device,
+ *              sized for CONFIG_MTD_SMART_CHECKPOINT_RECORDS records of the
+ *              configured sector size.  Fewer records are kept if the slots
+ *              would take more than a quarter of the device, and none if a
+ *              single one does not fit.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+static void smart_ckpt_reserve(FAR struct smart_struct_s *dev)
+{
+	uint32_t neraseblocks;
+	uint32_t sectorsperblk;
+	uint32_t totalsectors;
+	uint32_t recsize;
+	uint32_t records;
+	uint32_t slotblocks;
+
+	/* The slots are erased in erase blocks of the MTD device */
+
+	neraseblocks = dev->geo.neraseblocks + dev->ckptslotblocks * 2;
+	slotblocks = 0;
+	if (dev->geo.erasesize != 0 && dev->geo.erasesize % CONFIG_MTD_SMART_SECTOR_SIZE == 0) {
+		sectorsperblk = dev->geo.erasesize / CONFIG_MTD_SMART_SECTOR_SIZE;
+		totalsectors = neraseblocks * sectorsperblk;
+		if (sectorsperblk <= 256 && totalsectors <= 65536) {
+			recsize = totalsectors * sizeof(uint16_t) + (neraseblocks << 1) + ((totalsectors + 7) >> 3);
+			recsize = (recsize + CONFIG_MTD_SMART_SECTOR_SIZE - 1) / CONFIG_MTD_SMART_SECTOR_SIZE * CONFIG_MTD_SMART_SECTOR_SIZE;
+			recsize += CONFIG_MTD_SMART_SECTOR_SIZE;
+
+			/* The format sector records the slot size in one byte */
+
+			for (records = CONFIG_MTD_SMART_CHECKPOINT_RECORDS; records > 0; records--) {
+				slotblocks = (records * recsize + dev->geo.erasesize - 1) / dev->geo.erasesize;
+				if (slotblocks * 2 <= neraseblocks / 4 && slotblocks < 0xFF) {
+					break;
+				}
+			}
+
+			if (records == 0) {
+				fdbg("Device too small for the sector map checkpoint\n");
+				slotblocks = 0;
+			}
+		}
+	}
+
+	smart_ckpt_setslots(dev, slotblocks);
+}
+#endif
+
+/****************************************************************************
+ * Name: smart_gc_request
+ *
+ * Description: Wake up the garbage collection task if the free sectors fell
+ *              below the low watermark.  Must be called with the device
+ *              excluded.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MTD_SMART_BGGC
+static void smart_gc_request(FAR struct smart_struct_s *dev)
+{
+	if (!dev->gcpending && dev->formatstatus == SMART_FMT_STAT_FORMATTED && dev->freesectors < SMART_BGGC_LOWMARK(dev) && dev->releasesectors >= SMART_BGGC_MINRELEASE(dev)) {
+		dev->gcpending = true;
+		smart_semgive(&dev->gcsem);
+	}
+}
+
+/****************************************************************************
+ * Name: smart_gc_task
+ *
+ * Description: The background garbage collection task.  Once woken up, it
+ *              collects one erase block at a time, releasing the device
+ *              between blocks, until the free sectors reach the high
+ *              watermark or no block has enough released sectors.
+ *
+ ****************************************************************************/
+
+static int smart_gc_task(int argc, char *argv[])
+{
+	FAR struct smart_struct_s *dev;
+	uint16_t block;
+	bool collect;
+	int ret;
+
+	DEBUGASSERT(argc > 1);
+	dev = (FAR struct smart_struct_s *)((uintptr_t)strtoul(argv[1], NULL, 16));
+
+	for (;;) {
+		smart_semtake(&dev->gcsem);
+
+		do {
+			collect = false;
+			smart_semtake(&dev->exclsem);
+			dev->gcpending = false;
+
+			if (dev->formatstatus == SMART_FMT_STAT_FORMATTED && dev->freesectors < SMART_BGGC_HIGHMARK(dev)) {
+				block = smart_gc_findblock(dev, SMART_BGGC_MINRELEASE(dev));
+				if (block != 0xFFFF) {
+					fvdbg("Collecting block %d, totalfree=%d, totalrelease=%d\n", block, dev->freesectors, dev->releasesectors);
+
+					ret = smart_relocate_block(dev, block);
+					if (ret == OK) {
+						collect = true;
+					} else {
+						fdbg("Error %d collecting block %d\n", -ret, block);
+					}
+
+#ifdef CONFIG_MTD_SMART_WEAR_LEVEL
+					if (dev->wearflags & SMART_WEARFLAGS_WRITE_NEEDED) {
+						/* Write new wear status bits to the device */
+
+						smart_write_wearstatus(dev);
+					}
+#endif
+				}
+			}
+
+			smart_semgive(&dev->exclsem);
+		} while (collect);
+	}
+
+	return OK;
+}
+#endif							/* CONFIG_MTD_SMART_BGGC */
+
 /****************************************************************************
  * Name: smart_ioctl
  *
@@ -4918,6 +6051,12 @@ static int smart_ioctl(FAR struct inode *inode, int cmd, unsigned long arg)
 	dev = (FAR struct smart_struct_s *)inode->i_private;
 #endif
 
+#ifdef CONFIG_MTD_SMART_BGGC
+	/* Exclude the garbage collection task while the device is in use */
+
+	smart_semtake(&dev->exclsem);
+#endif
+
 	/* Process the ioctl's we care about first, pass any we don't respond
 	 * to directly to the underlying MTD device.
 	 */
@@ -4932,7 +6071,8 @@ static int smart_ioctl(FAR struct inode *inode, int cmd, unsigned long arg)
 #ifdef CONFIG_DEBUG
 		if (arg == 0) {
 			fdbg("ERROR: BIOC_XIPBASE argument is NULL\n");
-			return -EINVAL;
+			ret = -EINVAL;
+			goto ok_out;
 		}
 #endif
 
@@ -4980,6 +6120,18 @@ static int smart_ioctl(FAR struct inode *inode, int cmd, unsigned long arg)
 		ret = smart_freesector(dev, arg);
 		goto ok_out;
 
+	case BIOC_FLUSH:
+
+		/* Checkpoint the sector map once enough sectors were written */
+
+		ret = OK;
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+		if (dev->ckptdirty >= CONFIG_MTD_SMART_CHECKPOINT_SYNC_SECTORS) {
+			ret = smart_checkpoint(dev);
+		}
+#endif
+		goto ok_out;
+
 	case BIOC_WRITESECT:
 
 		/* Write to the sector */
@@ -5064,6 +6216,13 @@ static int smart_ioctl(FAR struct inode *inode, int cmd, unsigned long arg)
 	}
 
 ok_out:
+#ifdef CONFIG_MTD_SMART_BGGC
+	if (cmd == BIOC_WRITESECT || cmd == BIOC_ALLOCSECT || cmd == BIOC_FREESECT) {
+		smart_gc_request(dev);
+	}
+
+	smart_semgive(&dev->exclsem);
+#endif
 	return ret;
 }
 
@@ -5092,6 +6251,10 @@ int smart_initialize(int minor, FAR struct mtd_dev_s *mtd, FAR const char *partn
 #ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
 	FAR struct smart_multiroot_device_s *rootdirdev = NULL;
 #endif
+#ifdef CONFIG_MTD_SMART_BGGC
+	char gcarg[2 * sizeof(uintptr_t) + 1];
+	FAR char *gcargv[2];
+#endif
 
 #ifdef CONFIG_SMARTFS_DYNAMIC_HEADER
 	//Set chunk_shift & used_block_divident
@@ -5114,6 +6277,12 @@ int smart_initialize(int minor, FAR struct mtd_dev_s *mtd, FAR const char *partn
 		/* Initialize the SMART device structure */
 
 		dev->mtd = mtd;
+#ifdef CONFIG_MTD_SMART_BGGC
+		dev->gchead = NULL;
+		dev->gcpending = false;
+		sem_init(&dev->exclsem, 0, 1);
+		sem_init(&dev->gcsem, 0, 0);
+#endif
 #ifdef CONFIG_MTD_SMART_ALLOC_DEBUG
 		dev->bytesalloc = 0;
 		for (totalsectors = 0; totalsectors < SMART_MAX_ALLOCS; totalsectors++) {
@@ -5134,6 +6303,13 @@ int smart_initialize(int minor, FAR struct mtd_dev_s *mtd, FAR const char *partn
 			goto errout;
 		}
 
+#ifdef CONFIG_MTD_SMART_CHECKPOINT
+		/* Take the checkpoint slots out of the device geometry */
+
+		dev->ckptslotblocks = 0;
+		smart_ckpt_reserve(dev);
+#endif
+
 		/* Set the sector size to the default for now */
 
 #ifdef CONFIG_SMARTFS_BAD_SECTOR
@@ -5243,6 +6419,22 @@ int smart_initialize(int minor, FAR struct mtd_dev_s *mtd, FAR const char *partn
 		/* Do a scan of the device */
 
 		smart_scan(dev);
+
+#ifdef CONFIG_MTD_SMART_BGGC
+		/* Start the background garbage collection task.  The device is
+		 * passed as a hexadecimal string argument.  Without the task,
+		 * garbage is still collected when the reserved free sector limit
+		 * is reached.
+		 */
+
+		snprintf(gcarg, sizeof(gcarg), "%lx", (unsigned long)(uintptr_t)dev);
+		gcargv[0] = gcarg;
+		gcargv[1] = NULL;
+		dev->gcpid = kernel_thread("smart_gc", CONFIG_MTD_SMART_BGGC_PRIORITY, CONFIG_MTD_SMART_BGGC_STACKSIZE, smart_gc_task, gcargv);
+		if (dev->gcpid < 0) {
+			fdbg("Failed to start the garbage collection task: %d\n", dev->gcpid);
+		}
+#endif
 	}
 
 	return OK;
@@ -5271,6 +6463,14 @@ errout:
 #ifdef CONFIG_MTD_SMART_SECTOR_ERASE_DEBUG
 	smart_free(dev, dev->erasecounts);
 #endif
+#ifdef CONFIG_MTD_SMART_BGGC
+	if (dev->gchead != NULL) {
+		smart_free(dev, dev->gchead);
+	}
+
+	sem_destroy(&dev->exclsem);
+	sem_destroy(&dev->gcsem);
+#endif
 #ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
 	if (rootdirdev) {
 		smart_free(dev, rootdirdev);
@@ -5290,15 +6490,9 @@ errout:
  *   valid in the "validsectors" array provided
  *
  ****************************************************************************/
-int smart_validatesector(FAR struct inode *inode, uint16_t logsector, char *validsectors)
+static int smart_validate(FAR struct smart_struct_s *dev, uint16_t logsector, char *validsectors)
 {
-	FAR struct smart_struct_s *dev;
 	uint16_t physsector;
-#ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
-	dev = ((FAR struct smart_multiroot_device_s *)inode->i_private)->dev;
-#else
-	dev = (FAR struct smart_struct_s *)inode->i_private;
-#endif
 
 	if (logsector >= dev->totalsectors) {
 		return -EINVAL;
@@ -5318,6 +6512,26 @@ int smart_validatesector(FAR struct inode *inode, uint16_t logsector, char *vali
 	return -EINVAL;
 }
 
+int smart_validatesector(FAR struct inode *inode, uint16_t logsector, char *validsectors)
+{
+	FAR struct smart_struct_s *dev;
+	int ret;
+#ifdef CONFIG_SMARTFS_MULTI_ROOT_DIRS
+	dev = ((FAR struct smart_multiroot_device_s *)inode->i_private)->dev;
+#else
+	dev = (FAR struct smart_struct_s *)inode->i_private;
+#endif
+
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semtake(&dev->exclsem);
+#endif
+	ret = smart_validate(dev, logsector, validsectors);
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semgive(&dev->exclsem);
+#endif
+	return ret;
+}
+
 int smart_recoversectors(FAR struct inode *inode, char *validsectors, int *nobsolete, int *nrecovered)
 {
 	FAR struct smart_struct_s *dev;
@@ -5340,11 +6554,14 @@ int smart_recoversectors(FAR struct inode *inode, char *validsectors, int *nobso
 	dev = (FAR struct smart_struct_s *)inode->i_private;
 #endif
 
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semtake(&dev->exclsem);
+#endif
 	totalsectors = dev->totalsectors;
 
 	/* Mark the reserved sectors valid */
 	for (logicalsector = 0; logicalsector < dev->reservedsector; logicalsector++) {
-		smart_validatesector(inode, logicalsector, validsectors);
+		smart_validate(dev, logicalsector, validsectors);
 	}
 
 	for (sector = 1; sector < totalsectors; sector++) {
@@ -5384,6 +6601,7 @@ int smart_recoversectors(FAR struct inode *inode, char *validsectors, int *nobso
 #else
 			header.status |= SMART_STATUS_RELEASED;
 #endif
+			smart_ckpt_invalidate(dev);
 			offset = readaddress + offsetof(struct smart_sect_header_s, status);
 			ret = smart_bytewrite(dev, offset, 1, &header.status);
 			if (ret < 0) {
@@ -5398,6 +6616,7 @@ int smart_recoversectors(FAR struct inode *inode, char *validsectors, int *nobso
 #else
 			dev->releasecount[block]++;
 #endif
+			smart_gc_update(dev, block);
 
 			/* if the mapping is sane, Unmap this logical->physicalsector map */
 			if (physsector == sector) {
@@ -5416,6 +6635,9 @@ int smart_recoversectors(FAR struct inode *inode, char *validsectors, int *nobso
 
 	ret = OK;
 err_out:
+#ifdef CONFIG_MTD_SMART_BGGC
+	smart_semgive(&dev->exclsem);
+#endif
 	return ret;
 }
 #endif
@@ -96,6 +96,10 @@ extern const struct procfs_operations proc_operations;
 extern const struct procfs_operations cpuload_operations;
 extern const struct procfs_operations uptime_operations;
 extern const struct procfs_operations version_operations;
+extern const struct procfs_operations heapcache_operations;
+extern const struct procfs_operations kmemcache_operations;
+extern const struct procfs_operations heapprof_operations;
+extern const struct procfs_operations wqueue_operations;
 
 /* This is not good.  These are implemented in drivers/mtd.  Having to
  * deal with them here is not a good coupling.
@@ -151,6 +155,22 @@ static const struct procfs_entry_s g_procfsentries[] = {
 	{"version", &version_operations},
 #endif
 
+#if defined(CONFIG_MM_UMM_CACHE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_HEAPCACHE)
+	{"heapcache", &heapcache_operations},
+#endif
+
+#if defined(CONFIG_MM_KMEM_CACHE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_KMEMCACHE)
+	{"kmemcache", &kmemcache_operations},
+#endif
+
+#if defined(CONFIG_DEBUG_MM_HEAPPROF) && !defined(CONFIG_FS_PROCFS_EXCLUDE_HEAP)
+	{"heap", &heapprof_operations},
+#endif
+
+#if defined(CONFIG_SCHED_WORKQUEUE_STATS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_WQUEUE)
+	{"wqueue", &wqueue_operations},
+#endif
+
 #if defined(CONFIG_CM) && !defined(CONFIG_FS_PROCFS_EXCLUDE_CONNECTIVITY)
 	{"connectivity**", &cm_operations},
 #endif
@@ -392,9 +412,20 @@ static ssize_t procfs_write(FAR struct file *filep, FAR const char *buffer, size
 
 static int procfs_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
 {
+	FAR struct procfs_file_s *handler;
+
 	fvdbg("cmd: %d arg: %08lx\n", cmd, arg);
 
-	/* No IOCTL commands supported */
+	/* Recover our private data from the struct file instance */
+
+	handler = (FAR struct procfs_file_s *)filep->f_priv;
+	DEBUGASSERT(handler);
+
+	/* Call the handler's ioctl routine, if it supports any command */
+
+	if (handler->procfsentry->ops->ioctl) {
+		return handler->procfsentry->ops->ioctl(filep, cmd, arg);
+	}
 
 	return -ENOTTY;
 }
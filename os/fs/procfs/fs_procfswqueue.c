@@ -0,0 +1,395 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * fs/procfs/fs_procfswqueue.c
+ *
+ * /proc/wqueue shows the work queue statistics: for every worker function
+ * and work queue, the number of works run, the longest wait once due and
+ * the longest run in microseconds, the total run time in milliseconds, and
+ * the histograms of the wait and of the run time.  The WQUEUEIOC_RESET
+ * ioctl command clears the statistics.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <tinyara/kmalloc.h>
+#include <tinyara/wqueue.h>
+#include <tinyara/fs/fs.h>
+#include <tinyara/fs/ioctl.h>
+#include <tinyara/fs/procfs.h>
+
+#if !defined(CONFIG_DISABLE_MOUNTPOINT) && defined(CONFIG_FS_PROCFS)
+#if defined(CONFIG_SCHED_WORKQUEUE_STATS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_WQUEUE)
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Determines the size of an intermediate buffer that must be large enough
+ * to handle the longest line generated by this logic.
+ */
+
+#define WQUEUE_LINELEN 200
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* This structure describes one open "file" */
+
+struct wqueue_file_s {
+	struct procfs_file_s base;	/* Base open file structure */
+	struct work_stats_s stats;	/* Entry being formatted */
+	char line[WQUEUE_LINELEN];	/* Pre-allocated buffer for formatted lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* File system methods */
+
+static int wqueue_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode);
+static int wqueue_close(FAR struct file *filep);
+static ssize_t wqueue_read(FAR struct file *filep, FAR char *buffer, size_t buflen);
+
+static int wqueue_dup(FAR const struct file *oldp, FAR struct file *newp);
+
+static int wqueue_stat(FAR const char *relpath, FAR struct stat *buf);
+
+static int wqueue_ioctl(FAR struct file *filep, int cmd, unsigned long arg);
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+
+/* Work queue names, indexed by work queue ID */
+
+static const char *const g_wqueuenames[] = {
+	"hpwork",
+	"lpwork",
+	"usrwork"
+};
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See fs_procfs.c -- this structure is explicitly externed there.
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations wqueue_operations = {
+	wqueue_open,				/* open */
+	wqueue_close,				/* close */
+	wqueue_read,				/* read */
+	NULL,						/* write */
+
+	wqueue_dup,					/* dup */
+
+	NULL,						/* opendir */
+	NULL,						/* closedir */
+	NULL,						/* readdir */
+	NULL,						/* rewinddir */
+
+	wqueue_stat,				/* stat */
+
+	wqueue_ioctl				/* ioctl */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wqueue_open
+ ****************************************************************************/
+
+static int wqueue_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode)
+{
+	FAR struct wqueue_file_s *attr;
+
+	fvdbg("Open '%s'\n", relpath);
+
+	/* PROCFS is read-only.  Any attempt to open with any kind of write
+	 * access is not permitted.
+	 */
+
+	if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0) {
+		fdbg("ERROR: Only O_RDONLY supported\n");
+		return -EACCES;
+	}
+
+	/* "wqueue" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "wqueue") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* Allocate a container to hold the file attributes */
+
+	attr = (FAR struct wqueue_file_s *)kmm_zalloc(sizeof(struct wqueue_file_s));
+	if (!attr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* Save the attributes as the open-specific state in filep->f_priv */
+
+	filep->f_priv = (FAR void *)attr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: wqueue_close
+ ****************************************************************************/
+
+static int wqueue_close(FAR struct file *filep)
+{
+	FAR struct wqueue_file_s *attr;
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct wqueue_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	/* Release the file attributes structure */
+
+	kmm_free(attr);
+	filep->f_priv = NULL;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: wqueue_histogram
+ *
+ * Description:
+ *   Format one histogram, or the lower bounds of its buckets if 'counts' is
+ *   NULL, after the label 'name'.  Returns the length of the line.
+ *
+ ****************************************************************************/
+
+static size_t wqueue_histogram(FAR struct wqueue_file_s *attr, FAR const char *name, FAR const uint32_t *counts)
+{
+	size_t linesize;
+	int ndx;
+
+	linesize = snprintf(attr->line, WQUEUE_LINELEN, "%-8s", name);
+	for (ndx = 0; ndx < WORK_STATS_NBUCKETS && linesize < WQUEUE_LINELEN; ndx++) {
+		linesize += snprintf(&attr->line[linesize], WQUEUE_LINELEN - linesize, " %u", (unsigned int)(counts ? counts[ndx] : WORK_STATS_BUCKET_USEC(ndx)));
+	}
+
+	if (linesize < WQUEUE_LINELEN - 1) {
+		attr->line[linesize++] = '\n';
+	}
+
+	return linesize < WQUEUE_LINELEN ? linesize : WQUEUE_LINELEN - 1;
+}
+
+/****************************************************************************
+ * Name: wqueue_read
+ ****************************************************************************/
+
+static ssize_t wqueue_read(FAR struct file *filep, FAR char *buffer, size_t buflen)
+{
+	FAR struct wqueue_file_s *attr;
+	FAR struct work_stats_s *stats;
+	FAR const char *qname;
+	size_t remaining;
+	size_t linesize;
+	size_t copysize;
+	size_t totalsize;
+	off_t offset;
+	int ndx;
+
+	fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct wqueue_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+	stats = &attr->stats;
+
+	remaining = buflen;
+	totalsize = 0;
+	offset = filep->f_pos;
+
+	/* Lower bounds of the histogram buckets and column headers */
+
+	linesize = wqueue_histogram(attr, "USEC", NULL);
+	copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+	totalsize += copysize;
+	buffer += copysize;
+	remaining -= copysize;
+
+	if (remaining > 0) {
+		linesize = snprintf(attr->line, WQUEUE_LINELEN, "\n%-8s %10s %10s %10s %10s %10s\n", "QUEUE", "WORKER", "COUNT", "MAXLAT", "MAXRUN", "RUNTIME");
+		copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+		totalsize += copysize;
+		buffer += copysize;
+		remaining -= copysize;
+	}
+
+	/* One summary line and two histograms per worker function.  The last
+	 * entry, with a worker of 0, gathers the worker functions that did not
+	 * fit in the table.
+	 */
+
+	for (ndx = 0; ndx <= CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS && remaining > 0; ndx++) {
+		if (work_stats_get(ndx, stats) != OK) {
+			continue;
+		}
+
+		if (stats->worker == NULL) {
+			qname = "other";
+		} else if (stats->qid < sizeof(g_wqueuenames) / sizeof(g_wqueuenames[0])) {
+			qname = g_wqueuenames[stats->qid];
+		} else {
+			qname = "?";
+		}
+
+		linesize = snprintf(attr->line, WQUEUE_LINELEN, "%-8s 0x%08x %10u %10u %10u %10u\n", qname, (unsigned int)(uintptr_t)stats->worker, (unsigned int)stats->count, (unsigned int)stats->maxlatency, (unsigned int)stats->maxruntime, (unsigned int)(stats->runtime / 1000));
+		copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+		totalsize += copysize;
+		buffer += copysize;
+		remaining -= copysize;
+
+		if (remaining > 0) {
+			linesize = wqueue_histogram(attr, "  lat", stats->latency);
+			copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+			totalsize += copysize;
+			buffer += copysize;
+			remaining -= copysize;
+		}
+
+		if (remaining > 0) {
+			linesize = wqueue_histogram(attr, "  run", stats->run);
+			copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+			totalsize += copysize;
+			buffer += copysize;
+			remaining -= copysize;
+		}
+	}
+
+	/* Update the file offset */
+
+	filep->f_pos += totalsize;
+	return totalsize;
+}
+
+/****************************************************************************
+ * Name: wqueue_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int wqueue_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+	FAR struct wqueue_file_s *oldattr;
+	FAR struct wqueue_file_s *newattr;
+
+	fvdbg("Dup %p->%p\n", oldp, newp);
+
+	/* Recover our private data from the old struct file instance */
+
+	oldattr = (FAR struct wqueue_file_s *)oldp->f_priv;
+	DEBUGASSERT(oldattr);
+
+	/* Allocate a new container to hold the task and attribute selection */
+
+	newattr = (FAR struct wqueue_file_s *)kmm_malloc(sizeof(struct wqueue_file_s));
+	if (!newattr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* The copy the file attributes from the old attributes to the new */
+
+	memcpy(newattr, oldattr, sizeof(struct wqueue_file_s));
+
+	/* Save the new attributes in the new file structure */
+
+	newp->f_priv = (FAR void *)newattr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: wqueue_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int wqueue_stat(const char *relpath, struct stat *buf)
+{
+	/* "wqueue" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "wqueue") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* "wqueue" is the name for a read-only file */
+
+	buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+	buf->st_size = 0;
+	buf->st_blksize = 0;
+	buf->st_blocks = 0;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: wqueue_ioctl
+ ****************************************************************************/
+
+static int wqueue_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
+{
+	fvdbg("cmd: %d arg: %08lx\n", cmd, arg);
+
+	switch (cmd) {
+	case WQUEUEIOC_RESET:
+		work_stats_reset();
+		return OK;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif							/* CONFIG_SCHED_WORKQUEUE_STATS && !CONFIG_FS_PROCFS_EXCLUDE_WQUEUE */
+#endif							/* !CONFIG_DISABLE_MOUNTPOINT && CONFIG_FS_PROCFS */
@@ -218,7 +218,20 @@
 #define CONFIG_SMARTFS_DIRDEPTH 8
 #endif
 
-/* Buffer flags (when CRC enabled) */
+#ifdef CONFIG_SMARTFS_DIRINDEX
+#ifndef CONFIG_SMARTFS_DIRINDEX_BUCKETS
+#define CONFIG_SMARTFS_DIRINDEX_BUCKETS 64
+#endif
+#ifndef CONFIG_SMARTFS_DIRINDEX_MAXENTRIES
+#define CONFIG_SMARTFS_DIRINDEX_MAXENTRIES 512
+#endif
+
+/* nentries of a directory with more entries than the index can hold */
+
+#define SMARTFS_DIRINDEX_UNINDEXED 0xFFFF
+#endif
+
+/* Buffer flags (when the sector buffer is used) */
 
 #define SMARTFS_BFLAG_DIRTY       0x01	/* Set if data changed in the sector */
 #define SMARTFS_BFLAG_NEWALLOC    0x02	/* Set if sector not written since alloc */
@@ -232,9 +245,13 @@
 #define UINT8_TO_UINT16(UINT8_ARRAY)                    ((uint16_t)(((uint16_t)UINT8_ARRAY[1] << 8) & 0xFF00) | UINT8_ARRAY[0])
 #define SMARTFS_NEXTSECTOR(h)   (UINT8_TO_UINT16(h->nextsector))
 #define SMARTFS_USED(h)                 (UINT8_TO_UINT16(h->used))
-#ifdef CONFIG_MTD_SMART_ENABLE_CRC
+#if defined(CONFIG_MTD_SMART_ENABLE_CRC) || defined(CONFIG_SMARTFS_FILE_BUFFER)
 #define CONFIG_SMARTFS_USE_SECTOR_BUFFER
 #endif
+#if !defined(CONFIG_SMARTFS_FILE_BUFFER) || !defined(CONFIG_SMARTFS_READAHEAD_SECTORS)
+#undef  CONFIG_SMARTFS_READAHEAD_SECTORS
+#define CONFIG_SMARTFS_READAHEAD_SECTORS 0
+#endif
 #ifdef CONFIG_SMARTFS_BAD_SECTOR
 #define SMARTFS_BSM_LOG_SECTOR_NUMBER   11
 #endif
@@ -358,6 +375,14 @@ struct smartfs_ofile_s {
 #ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
 	uint8_t *buffer;			/* Sector buffer to reduce writes */
 	uint8_t bflags;				/* Buffer flags */
+	uint16_t bsector;			/* Sector in the buffer, 0xFFFF if none */
+	uint16_t bstart;			/* Offset of the first byte changed in
+								 * the buffer since it was written */
+#endif
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	uint8_t *rabuffer;			/* Sectors read ahead */
+	uint16_t rasector[CONFIG_SMARTFS_READAHEAD_SECTORS];	/* Their sector numbers */
+	uint8_t racount;			/* Number of sectors read ahead */
 #endif
 	int16_t crefs;				/* Reference count */
 	mode_t oflags;				/* Open mode */
@@ -373,6 +398,30 @@ struct smartfs_ofile_s {
 								 * causes the sector to change. */
 };
 
+#ifdef CONFIG_SMARTFS_DIRINDEX
+/* This structure is one entry of the directory index.  It records where
+ * the entry of a name is found in a directory.
+ */
+
+struct smartfs_dirindex_entry_s {
+	struct smartfs_dirindex_entry_s *next;	/* Next entry in the hash bucket */
+	uint16_t dirsector;			/* First sector of the directory */
+	uint16_t hash;				/* Hash of the name */
+	uint16_t sector;			/* Directory sector holding the entry */
+	uint16_t offset;			/* Offset of the entry in the sector */
+};
+
+/* This structure describes one directory in the directory index */
+
+struct smartfs_dirindex_dir_s {
+	struct smartfs_dirindex_dir_s *next;	/* Next directory, least recently
+										 * searched last */
+	uint16_t dirsector;			/* First sector of the directory */
+	uint16_t nentries;			/* Number of entries indexed, or
+								 * SMARTFS_DIRINDEX_UNINDEXED */
+};
+#endif
+
 /* This structure represents the overall mountpoint state.  An instance of this
  * structure is retained as inode private data on each mountpoint that is
  * mounted with a smartfs filesystem.
@@ -395,6 +444,11 @@ struct smartfs_mountpt_s {
 #endif
 #ifdef CONFIG_SMARTFS_JOURNALING
 	struct journal_transaction_manager_s *journal;
+#endif
+#ifdef CONFIG_SMARTFS_DIRINDEX
+	struct smartfs_dirindex_dir_s *fs_indexdirs;	/* Directories indexed */
+	struct smartfs_dirindex_entry_s *fs_index[CONFIG_SMARTFS_DIRINDEX_BUCKETS];
+	uint16_t fs_nindexed;		/* Number of entries indexed */
 #endif
 	uint8_t fs_rootsector;		/* Root directory sector num */
 };
@@ -555,6 +609,14 @@ struct fs_dirent_s;
 struct statfs;
 struct stat;
 
+#ifdef CONFIG_SMARTFS_DIRINDEX
+int smartfs_dirindex_find(struct smartfs_mountpt_s *fs, uint16_t dirsector, const char *name, uint16_t *sector, uint16_t *offset);
+void smartfs_dirindex_add(struct smartfs_mountpt_s *fs, uint16_t dirsector, const char *name, uint16_t sector, uint16_t offset);
+void smartfs_dirindex_remove(struct smartfs_mountpt_s *fs, const char *name, uint16_t sector, uint16_t offset);
+void smartfs_dirindex_drop(struct smartfs_mountpt_s *fs, uint16_t dirsector);
+void smartfs_dirindex_free(struct smartfs_mountpt_s *fs);
+#endif
+
 #ifdef CONFIG_SMARTFS_JOURNALING
 int smartfs_journal_init(struct smartfs_mountpt_s *fs);
 int smartfs_create_journalentry(struct smartfs_mountpt_s *fs, enum logging_transaction_type_e type, uint16_t curr_sector, uint16_t offset, uint16_t datalen, uint16_t genericdata, uint8_t needsync, const uint8_t *data, uint16_t *t_sector, uint16_t *t_offset);
@@ -0,0 +1,461 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * fs/smartfs/smartfs_dirindex.c
+ *
+ * Hash index of the directory entries, kept in RAM for each mountpoint.
+ *
+ * The index of a directory is built the first time the directory is
+ * searched.  It maps the hash of each name to the directory sector and
+ * offset of its entry, so a search reads the sector holding the entry
+ * instead of every sector of the directory.  A directory that is in the
+ * index and has no entry with the hash of a name does not hold the name.
+ *
+ * Every entry found through the index is checked against the sector read
+ * from the device.  If the check fails, the directory is dropped from the
+ * index and searched the usual way.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <tinyara/kmalloc.h>
+#include <tinyara/fs/fs.h>
+#include <tinyara/fs/ioctl.h>
+
+#include "smartfs.h"
+
+#ifdef CONFIG_SMARTFS_DIRINDEX
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: smartfs_dirindex_hash
+ *
+ * Description: Hashes a name as it is compared in a directory, up to the
+ *   name size of the volume.
+ *
+ ****************************************************************************/
+
+static uint16_t smartfs_dirindex_hash(struct smartfs_mountpt_s *fs, const char *name)
+{
+	uint32_t hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < fs->fs_llformat.namesize && name[i] != '\0'; i++) {
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+
+	return (uint16_t)(hash ^ (hash >> 16));
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_getdir
+ *
+ * Description: Returns the index record of a directory, or NULL if the
+ *   directory is not in the index.
+ *
+ ****************************************************************************/
+
+static struct smartfs_dirindex_dir_s *smartfs_dirindex_getdir(struct smartfs_mountpt_s *fs, uint16_t dirsector)
+{
+	struct smartfs_dirindex_dir_s *dir;
+
+	for (dir = fs->fs_indexdirs; dir != NULL; dir = dir->next) {
+		if (dir->dirsector == dirsector) {
+			break;
+		}
+	}
+
+	return dir;
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_freeentries
+ *
+ * Description: Frees the index entries of a directory.
+ *
+ ****************************************************************************/
+
+static void smartfs_dirindex_freeentries(struct smartfs_mountpt_s *fs, uint16_t dirsector)
+{
+	struct smartfs_dirindex_entry_s **prev;
+	struct smartfs_dirindex_entry_s *node;
+	int i;
+
+	for (i = 0; i < CONFIG_SMARTFS_DIRINDEX_BUCKETS; i++) {
+		prev = &fs->fs_index[i];
+		while ((node = *prev) != NULL) {
+			if (node->dirsector == dirsector) {
+				*prev = node->next;
+				kmm_free(node);
+				fs->fs_nindexed--;
+			} else {
+				prev = &node->next;
+			}
+		}
+	}
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_makeroom
+ *
+ * Description: Drops the directories searched least recently, other than
+ *   the given one, until the index has room for one more entry.
+ *
+ ****************************************************************************/
+
+static int smartfs_dirindex_makeroom(struct smartfs_mountpt_s *fs, struct smartfs_dirindex_dir_s *keep)
+{
+	struct smartfs_dirindex_dir_s *dir;
+	struct smartfs_dirindex_dir_s *victim;
+
+	while (fs->fs_nindexed >= CONFIG_SMARTFS_DIRINDEX_MAXENTRIES) {
+		victim = NULL;
+		for (dir = fs->fs_indexdirs; dir != NULL; dir = dir->next) {
+			if (dir != keep && dir->nentries != SMARTFS_DIRINDEX_UNINDEXED && dir->nentries > 0) {
+				victim = dir;
+			}
+		}
+
+		if (victim == NULL) {
+			return -ENOSPC;
+		}
+
+		smartfs_dirindex_drop(fs, victim->dirsector);
+	}
+
+	return OK;
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_insert
+ *
+ * Description: Adds one entry of an indexed directory to the index.  If
+ *   the index cannot hold it, the directory is left out of the index.
+ *
+ ****************************************************************************/
+
+static int smartfs_dirindex_insert(struct smartfs_mountpt_s *fs, struct smartfs_dirindex_dir_s *dir, uint16_t hash, uint16_t sector, uint16_t offset)
+{
+	struct smartfs_dirindex_entry_s *node;
+	int ret;
+
+	ret = smartfs_dirindex_makeroom(fs, dir);
+	if (ret < 0) {
+		/* The directory alone is bigger than the index */
+
+		smartfs_dirindex_freeentries(fs, dir->dirsector);
+		dir->nentries = SMARTFS_DIRINDEX_UNINDEXED;
+		return ret;
+	}
+
+	node = (struct smartfs_dirindex_entry_s *)kmm_malloc(sizeof(struct smartfs_dirindex_entry_s));
+	if (node == NULL) {
+		/* Build it again the next time it is searched */
+
+		smartfs_dirindex_drop(fs, dir->dirsector);
+		return -ENOMEM;
+	}
+
+	node->dirsector = dir->dirsector;
+	node->hash = hash;
+	node->sector = sector;
+	node->offset = offset;
+	node->next = fs->fs_index[hash % CONFIG_SMARTFS_DIRINDEX_BUCKETS];
+	fs->fs_index[hash % CONFIG_SMARTFS_DIRINDEX_BUCKETS] = node;
+	fs->fs_nindexed++;
+	dir->nentries++;
+
+	return OK;
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_build
+ *
+ * Description: Reads every sector of a directory and adds its entries to
+ *   the index.  The sector buffer of the mountpoint is used.
+ *
+ ****************************************************************************/
+
+static int smartfs_dirindex_build(struct smartfs_mountpt_s *fs, uint16_t dirsector, struct smartfs_dirindex_dir_s **result)
+{
+	struct smartfs_dirindex_dir_s *dir;
+	struct smartfs_chain_header_s *header;
+	struct smartfs_entry_header_s *entry;
+	struct smart_read_write_s readwrite;
+	uint16_t entrysize;
+	uint16_t sector;
+	uint16_t offset;
+	int ret;
+
+	dir = (struct smartfs_dirindex_dir_s *)kmm_malloc(sizeof(struct smartfs_dirindex_dir_s));
+	if (dir == NULL) {
+		return -EAGAIN;
+	}
+
+	dir->dirsector = dirsector;
+	dir->nentries = 0;
+	dir->next = fs->fs_indexdirs;
+	fs->fs_indexdirs = dir;
+	*result = dir;
+
+	entrysize = sizeof(struct smartfs_entry_header_s) + fs->fs_llformat.namesize;
+	header = (struct smartfs_chain_header_s *)fs->fs_rwbuffer;
+	sector = dirsector;
+	while (sector != SMARTFS_ERASEDSTATE_16BIT) {
+		readwrite.logsector = sector;
+		readwrite.offset = 0;
+		readwrite.count = fs->fs_llformat.availbytes;
+		readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
+		ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+		if (ret < 0) {
+			fdbg("Error %d reading directory sector %d\n", ret, sector);
+			smartfs_dirindex_drop(fs, dirsector);
+			return ret;
+		}
+
+		for (offset = sizeof(struct smartfs_chain_header_s); offset + entrysize < readwrite.count; offset += entrysize) {
+			entry = (struct smartfs_entry_header_s *)&fs->fs_rwbuffer[offset];
+			if (!ENTRY_VALID(entry)) {
+				continue;
+			}
+
+			ret = smartfs_dirindex_insert(fs, dir, smartfs_dirindex_hash(fs, entry->name), sector, offset);
+			if (ret < 0) {
+				/* Search the directory without the index */
+
+				return -EAGAIN;
+			}
+		}
+
+		sector = SMARTFS_NEXTSECTOR(header);
+	}
+
+	return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: smartfs_dirindex_find
+ *
+ * Description: Looks a name up in a directory through the index, building
+ *   the index of the directory if needed.  On success, the directory
+ *   sector holding the entry is in the sector buffer of the mountpoint.
+ *   Returns -ENOENT if the directory has no such entry, or -EAGAIN if the
+ *   index cannot tell and the directory has to be searched.
+ *
+ ****************************************************************************/
+
+int smartfs_dirindex_find(struct smartfs_mountpt_s *fs, uint16_t dirsector, const char *name, uint16_t *sector, uint16_t *offset)
+{
+	struct smartfs_dirindex_dir_s **prev;
+	struct smartfs_dirindex_dir_s *dir;
+	struct smartfs_dirindex_entry_s *node;
+	struct smartfs_entry_header_s *entry;
+	struct smart_read_write_s readwrite;
+	uint16_t hash;
+	int ret;
+
+	/* Move the directory to the head of the list, where it is dropped last */
+
+	for (prev = &fs->fs_indexdirs; (dir = *prev) != NULL; prev = &dir->next) {
+		if (dir->dirsector == dirsector) {
+			*prev = dir->next;
+			dir->next = fs->fs_indexdirs;
+			fs->fs_indexdirs = dir;
+			break;
+		}
+	}
+
+	if (dir == NULL) {
+		ret = smartfs_dirindex_build(fs, dirsector, &dir);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	if (dir->nentries == SMARTFS_DIRINDEX_UNINDEXED) {
+		return -EAGAIN;
+	}
+
+	hash = smartfs_dirindex_hash(fs, name);
+	for (node = fs->fs_index[hash % CONFIG_SMARTFS_DIRINDEX_BUCKETS]; node != NULL; node = node->next) {
+		if (node->dirsector != dirsector || node->hash != hash) {
+			continue;
+		}
+
+		readwrite.logsector = node->sector;
+		readwrite.offset = 0;
+		readwrite.count = fs->fs_llformat.availbytes;
+		readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
+		ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+		if (ret < 0) {
+			return ret;
+		}
+
+		entry = (struct smartfs_entry_header_s *)&fs->fs_rwbuffer[node->offset];
+		if (ENTRY_VALID(entry)) {
+			if (strncmp(entry->name, name, fs->fs_llformat.namesize) == 0) {
+				*sector = node->sector;
+				*offset = node->offset;
+				return OK;
+			}
+
+			if (smartfs_dirindex_hash(fs, entry->name) == hash) {
+				/* Another name with the same hash */
+
+				continue;
+			}
+		}
+
+		/* The index does not match the directory */
+
+		fdbg("Directory %d index out of date at sector %d offset %d\n", dirsector, node->sector, node->offset);
+		smartfs_dirindex_drop(fs, dirsector);
+		return -EAGAIN;
+	}
+
+	return -ENOENT;
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_add
+ *
+ * Description: Records an entry written in a directory.  Nothing is done
+ *   if the directory is not in the index.
+ *
+ ****************************************************************************/
+
+void smartfs_dirindex_add(struct smartfs_mountpt_s *fs, uint16_t dirsector, const char *name, uint16_t sector, uint16_t offset)
+{
+	struct smartfs_dirindex_dir_s *dir;
+
+	dir = smartfs_dirindex_getdir(fs, dirsector);
+	if (dir == NULL || dir->nentries == SMARTFS_DIRINDEX_UNINDEXED) {
+		return;
+	}
+
+	(void)smartfs_dirindex_insert(fs, dir, smartfs_dirindex_hash(fs, name), sector, offset);
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_remove
+ *
+ * Description: Forgets the entry of a name at a directory sector and
+ *   offset, once the entry is marked inactive.
+ *
+ ****************************************************************************/
+
+void smartfs_dirindex_remove(struct smartfs_mountpt_s *fs, const char *name, uint16_t sector, uint16_t offset)
+{
+	struct smartfs_dirindex_entry_s **prev;
+	struct smartfs_dirindex_entry_s *node;
+	struct smartfs_dirindex_dir_s *dir;
+	uint16_t hash;
+
+	hash = smartfs_dirindex_hash(fs, name);
+	for (prev = &fs->fs_index[hash % CONFIG_SMARTFS_DIRINDEX_BUCKETS]; (node = *prev) != NULL; prev = &node->next) {
+		if (node->sector == sector && node->offset == offset) {
+			*prev = node->next;
+			fs->fs_nindexed--;
+
+			dir = smartfs_dirindex_getdir(fs, node->dirsector);
+			if (dir != NULL && dir->nentries != SMARTFS_DIRINDEX_UNINDEXED) {
+				dir->nentries--;
+			}
+
+			kmm_free(node);
+			return;
+		}
+	}
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_drop
+ *
+ * Description: Removes a directory from the index, when it is deleted or
+ *   when its index cannot be trusted.
+ *
+ ****************************************************************************/
+
+void smartfs_dirindex_drop(struct smartfs_mountpt_s *fs, uint16_t dirsector)
+{
+	struct smartfs_dirindex_dir_s **prev;
+	struct smartfs_dirindex_dir_s *dir;
+
+	for (prev = &fs->fs_indexdirs; (dir = *prev) != NULL; prev = &dir->next) {
+		if (dir->dirsector == dirsector) {
+			*prev = dir->next;
+			if (dir->nentries != SMARTFS_DIRINDEX_UNINDEXED && dir->nentries > 0) {
+				smartfs_dirindex_freeentries(fs, dirsector);
+			}
+
+			kmm_free(dir);
+			return;
+		}
+	}
+}
+
+/****************************************************************************
+ * Name: smartfs_dirindex_free
+ *
+ * Description: Frees the whole index of a mountpoint.
+ *
+ ****************************************************************************/
+
+void smartfs_dirindex_free(struct smartfs_mountpt_s *fs)
+{
+	struct smartfs_dirindex_entry_s *node;
+	struct smartfs_dirindex_dir_s *dir;
+	int i;
+
+	for (i = 0; i < CONFIG_SMARTFS_DIRINDEX_BUCKETS; i++) {
+		while ((node = fs->fs_index[i]) != NULL) {
+			fs->fs_index[i] = node->next;
+			kmm_free(node);
+		}
+	}
+
+	while ((dir = fs->fs_indexdirs) != NULL) {
+		fs->fs_indexdirs = dir->next;
+		kmm_free(dir);
+	}
+
+	fs->fs_nindexed = 0;
+}
+
+#endif							/* CONFIG_SMARTFS_DIRINDEX */
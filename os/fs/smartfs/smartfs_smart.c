@@ -115,6 +115,13 @@ static int smartfs_rename(struct inode *mountpt, const char *oldrelpath, const c
 static int smartfs_stat(struct inode *mountpt, const char *relpath, struct stat *buf);
 
 static off_t smartfs_seek_internal(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *sf, off_t offset, int whence);
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+static int smartfs_loadbuffer(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *sf, uint16_t sector);
+static void smartfs_invalidate_buffers(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *writer, uint16_t sector);
+#endif
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+static FAR uint8_t *smartfs_readahead(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *sf, uint16_t sector, FAR int *ret);
+#endif
 
 /****************************************************************************
  * Private Variables
@@ -219,8 +226,24 @@ static int smartfs_open(FAR struct file *filep, const char *relpath, int oflags,
 	}
 
 	sf->bflags = 0;
+	sf->bsector = 0xFFFF;
+	sf->bstart = 0;
 #endif							/* CONFIG_SMARTFS_USE_SECTOR_BUFFER */
 
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	/* Allocate the buffer of the sectors read ahead */
+
+	sf->rabuffer = (uint8_t *)kmm_malloc(CONFIG_SMARTFS_READAHEAD_SECTORS * fs->fs_llformat.availbytes);
+	if (sf->rabuffer == NULL) {
+		kmm_free(sf->buffer);
+		kmm_free(sf);
+		ret = -ENOMEM;
+		goto errout_with_semaphore;
+	}
+
+	sf->racount = 0;
+#endif
+
 	sf->entry.name = NULL;
 	ret = smartfs_finddirentry(fs, &sf->entry, relpath, &parentdirsector, &filename);
 
@@ -263,6 +286,12 @@ static int smartfs_open(FAR struct file *filep, const char *relpath, int oflags,
 				if (ret < 0) {
 					goto errout_with_buffer;
 				}
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+
+				/* Other open files must not read the released sectors */
+
+				smartfs_invalidate_buffers(fs, sf, 0xFFFF);
+#endif
 			}
 		}
 	} else if (ret == -ENOENT) {
@@ -351,6 +380,12 @@ errout_with_buffer:
 		kmm_free(sf->entry.name);
 		sf->entry.name = NULL;
 	}
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+	kmm_free(sf->buffer);
+#endif
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	kmm_free(sf->rabuffer);
+#endif
 
 	kmm_free(sf);
 
@@ -443,6 +478,9 @@ static int smartfs_close(FAR struct file *filep)
 		kmm_free(sf->buffer);
 	}
 #endif
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	kmm_free(sf->rabuffer);
+#endif
 
 	kmm_free(sf);
 
@@ -460,8 +498,11 @@ static ssize_t smartfs_read(FAR struct file *filep, char *buffer, size_t buflen)
 	struct inode *inode;
 	struct smartfs_mountpt_s *fs;
 	struct smartfs_ofile_s *sf;
+#if CONFIG_SMARTFS_READAHEAD_SECTORS == 0
 	struct smart_read_write_s readwrite;
+#endif
 	struct smartfs_chain_header_s *header;
+	FAR uint8_t *data;
 	int ret = OK;
 	uint32_t bytesread;
 	uint16_t bytestoread;
@@ -495,25 +536,50 @@ static ssize_t smartfs_read(FAR struct file *filep, char *buffer, size_t buflen)
 			break;
 		}
 
-		/* Read the curent sector into our buffer */
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+		if (sf->bsector == sf->currsector) {
+			/* The sector is in our sector buffer, maybe with data that
+			 * is not written yet.
+			 */
 
-		readwrite.logsector = sf->currsector;
-		readwrite.offset = 0;
-		readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
-		readwrite.count = fs->fs_llformat.availbytes;
-		ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
-		if (ret < 0) {
-			fdbg("Error %d reading sector %d data\n", ret, sf->currsector);
-			goto errout_with_semaphore;
+			data = sf->buffer;
+		} else
+#endif
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+		{
+			/* Get the sector from the sectors read ahead */
+
+			data = smartfs_readahead(fs, sf, sf->currsector, &ret);
+			if (data == NULL) {
+				fdbg("Error %d reading sector %d data\n", ret, sf->currsector);
+				goto errout_with_semaphore;
+			}
+		}
+#else
+		{
+			/* Read the curent sector into our buffer */
+
+			readwrite.logsector = sf->currsector;
+			readwrite.offset = 0;
+			readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
+			readwrite.count = fs->fs_llformat.availbytes;
+			ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+			if (ret < 0) {
+				fdbg("Error %d reading sector %d data\n", ret, sf->currsector);
+				goto errout_with_semaphore;
+			}
+
+			data = (uint8_t *)fs->fs_rwbuffer;
 		}
+#endif
 
 		/* Point header to the read data to get used byte count */
 
-		header = (struct smartfs_chain_header_s *)fs->fs_rwbuffer;
+		header = (struct smartfs_chain_header_s *)data;
 
 		/* Get number of used bytes in this sector */
 #ifdef CONFIG_SMARTFS_DYNAMIC_HEADER
-		bytesinsector = get_leftover_used_byte_count((uint8_t *)readwrite.buffer, get_used_byte_count((uint8_t *)header->used));
+		bytesinsector = get_leftover_used_byte_count(data, get_used_byte_count((uint8_t *)header->used));
 #else
 		bytesinsector = SMARTFS_USED(header);
 
@@ -522,6 +588,13 @@ static ssize_t smartfs_read(FAR struct file *filep, char *buffer, size_t buflen)
 
 			bytesinsector = 0;
 		}
+#endif
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+		if (data == sf->buffer) {
+			/* Count the bytes written but not recorded yet */
+
+			bytesinsector += sf->byteswritten;
+		}
 #endif
 		/* Calculate the number of bytes to read into the buffer */
 
@@ -537,7 +610,7 @@ static ssize_t smartfs_read(FAR struct file *filep, char *buffer, size_t buflen)
 		if (bytestoread > 0) {
 			/* Do incremental copy from this sector */
 
-			memcpy(&buffer[bytesread], &fs->fs_rwbuffer[sf->curroffset], bytestoread);
+			memcpy(&buffer[bytesread], &data[sf->curroffset], bytestoread);
 			bytesread += bytestoread;
 			sf->filepos += bytestoread;
 			sf->curroffset += bytestoread;
@@ -599,36 +672,68 @@ static int smartfs_sync_internal(struct smartfs_mountpt_s *fs, struct smartfs_of
 
 		header = (struct smartfs_chain_header_s *)sf->buffer;
 #ifdef CONFIG_SMARTFS_DYNAMIC_HEADER
-		used_value = get_leftover_used_byte_count((uint8_t *)sf.buffer, get_used_byte_count((uint8_t *)header->used));
+		used_value = get_leftover_used_byte_count((uint8_t *)sf->buffer, get_used_byte_count((uint8_t *)header->used));
 		if (used_value == 0) {
 			set_used_byte_count((uint8_t *)header->used, sf->byteswritten);
 #else
-		if (header->used[0] == CONFIG_SMARTFS_ERASEDSTATE) {
-			*((uint16_t *)header->used) = sf->byteswritten;
+		if (SMARTFS_USED(header) == SMARTFS_ERASEDSTATE_16BIT) {
+			header->used[0] = (uint8_t)(sf->byteswritten & 0x00FF);
+			header->used[1] = (uint8_t)(sf->byteswritten >> 8);
 #endif
 		} else {
 #ifdef CONFIG_SMARTFS_DYNAMIC_HEADER
 			set_used_byte_count((uint8_t *)header->used, used_value + sf->byteswritten);
 #else
-			*((uint16_t *)header->used) += sf->byteswritten;
+			uint16_t tmp = SMARTFS_USED(header);
+			tmp += sf->byteswritten;
+			header->used[0] = (uint8_t)(tmp & 0x00FF);
+			header->used[1] = (uint8_t)(tmp >> 8);
 #endif
 		}
 
+#ifdef CONFIG_SMARTFS_JOURNALING
+		/* Log the changed bytes up to the end of the data and the number of
+		 * bytes used, in one entry for the whole sector.
+		 */
+
+		used_bytes = SMARTFS_USED(header);
+		ret = smartfs_create_journalentry(fs, T_SYNC, sf->bsector, sf->bstart, sizeof(struct smartfs_chain_header_s) + used_bytes - sf->bstart, used_bytes, 1, &sf->buffer[sf->bstart], &t_sector, &t_offset);
+		if (ret != OK) {
+			fdbg("Journal entry creation failed.\n");
+			goto errout;
+		}
+#endif
+
 		/* Write the entire sector to FLASH */
 
-		readwrite.logsector = sf->currsector;
+		readwrite.logsector = sf->bsector;
 		readwrite.offset = 0;
 		readwrite.count = fs->fs_llformat.availbytes;
 		readwrite.buffer = sf->buffer;
 
 		ret = FS_IOCTL(fs, BIOC_WRITESECT, (unsigned long)&readwrite);
+#ifdef CONFIG_SMARTFS_JOURNALING
+		retj = smartfs_finish_journalentry(fs, readwrite.logsector, t_sector, t_offset, T_SYNC);
+		if (retj != OK) {
+			fdbg("Error finishing transaction\n");
+			ret = retj;
+			goto errout;
+		}
+#endif
 		if (ret < 0) {
-			fdbg("Error %d writing used bytes for sector %d\n", ret, sf->currsector);
+			fdbg("Error %d writing used bytes for sector %d\n", ret, sf->bsector);
 			goto errout;
 		}
 
 		sf->byteswritten = 0;
 		sf->bflags = 0;
+		sf->bstart = fs->fs_llformat.availbytes;
+
+		/* The copies of the sector buffered by other open files are out
+		 * of date.
+		 */
+
+		smartfs_invalidate_buffers(fs, sf, sf->bsector);
 	}
 #else							/* CONFIG_SMARTFS_USE_SECTOR_BUFFER */
 
@@ -702,6 +807,176 @@ errout:
 	return ret;
 }
 
+/****************************************************************************
+ * Name: smartfs_findreadahead
+ *
+ * Description: Returns the copy of a sector read ahead by an open file, or
+ *   NULL if the sector was not read ahead.
+ *
+ ****************************************************************************/
+
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+static FAR uint8_t *smartfs_findreadahead(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *sf, uint16_t sector)
+{
+	int i;
+
+	for (i = 0; i < sf->racount; i++) {
+		if (sf->rasector[i] == sector) {
+			return &sf->rabuffer[i * fs->fs_llformat.availbytes];
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+/****************************************************************************
+ * Name: smartfs_readahead
+ *
+ * Description: Returns the data of a sector of an open file, reading it
+ *   and the sectors that follow it in the chain if it was not read ahead
+ *   yet.  Sectors are only read ahead when the file is read in sequence,
+ *   from its first sector or from the sector that follows the ones read
+ *   ahead before.
+ *
+ ****************************************************************************/
+
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+static FAR uint8_t *smartfs_readahead(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *sf, uint16_t sector, FAR int *ret)
+{
+	struct smart_read_write_s readwrite;
+	struct smartfs_chain_header_s *header;
+	FAR uint8_t *data;
+	int nsectors;
+	int i;
+
+	data = smartfs_findreadahead(fs, sf, sector);
+	if (data != NULL) {
+		return data;
+	}
+
+	nsectors = 1;
+	if (sector == sf->entry.firstsector) {
+		nsectors = CONFIG_SMARTFS_READAHEAD_SECTORS;
+	} else if (sf->racount > 0) {
+		header = (struct smartfs_chain_header_s *)&sf->rabuffer[(sf->racount - 1) * fs->fs_llformat.availbytes];
+		if (SMARTFS_NEXTSECTOR(header) == sector) {
+			nsectors = CONFIG_SMARTFS_READAHEAD_SECTORS;
+		}
+	}
+
+	sf->racount = 0;
+	for (i = 0; i < nsectors && sector != SMARTFS_ERASEDSTATE_16BIT; i++) {
+		data = &sf->rabuffer[i * fs->fs_llformat.availbytes];
+
+		readwrite.logsector = sector;
+		readwrite.offset = 0;
+		readwrite.count = fs->fs_llformat.availbytes;
+		readwrite.buffer = data;
+		*ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+		if (*ret < 0) {
+			/* The sectors read ahead are still good */
+
+			break;
+		}
+
+		sf->rasector[i] = sector;
+		sf->racount++;
+
+		header = (struct smartfs_chain_header_s *)data;
+		sector = SMARTFS_NEXTSECTOR(header);
+	}
+
+	return sf->racount > 0 ? sf->rabuffer : NULL;
+}
+#endif
+
+/****************************************************************************
+ * Name: smartfs_loadbuffer
+ *
+ * Description: Reads a sector of an open file into its sector buffer, once
+ *   the sector in the buffer is written if it was changed.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+static int smartfs_loadbuffer(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *sf, uint16_t sector)
+{
+	struct smart_read_write_s readwrite;
+	int ret;
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	FAR uint8_t *data;
+#endif
+
+	if (sf->bsector == sector) {
+		return OK;
+	}
+
+	ret = smartfs_sync_internal(fs, sf);
+	if (ret != OK) {
+		return ret;
+	}
+
+	sf->bsector = 0xFFFF;
+
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	data = smartfs_findreadahead(fs, sf, sector);
+	if (data != NULL) {
+		memcpy(sf->buffer, data, fs->fs_llformat.availbytes);
+	} else
+#endif
+	{
+		readwrite.logsector = sector;
+		readwrite.offset = 0;
+		readwrite.count = fs->fs_llformat.availbytes;
+		readwrite.buffer = sf->buffer;
+		ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	sf->bsector = sector;
+	sf->bstart = fs->fs_llformat.availbytes;
+	return OK;
+}
+#endif
+
+/****************************************************************************
+ * Name: smartfs_invalidate_buffers
+ *
+ * Description: Drops the copies of a sector, or of all sectors if the
+ *   sector is 0xFFFF, that open files other than the writer hold in their
+ *   sector buffer without changes, or read ahead.  The writer only drops
+ *   the sectors it read ahead, as its sector buffer is up to date.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+static void smartfs_invalidate_buffers(struct smartfs_mountpt_s *fs, struct smartfs_ofile_s *writer, uint16_t sector)
+{
+	struct smartfs_ofile_s *sf;
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+	int i;
+#endif
+
+	for (sf = fs->fs_head; sf != NULL; sf = sf->fnext) {
+		if (sf != writer && !(sf->bflags & SMARTFS_BFLAG_DIRTY) && (sector == 0xFFFF || sf->bsector == sector)) {
+			sf->bsector = 0xFFFF;
+		}
+#if CONFIG_SMARTFS_READAHEAD_SECTORS > 0
+
+		for (i = 0; i < sf->racount; i++) {
+			if (sector == 0xFFFF || sf->rasector[i] == sector) {
+				sf->racount = 0;
+				break;
+			}
+		}
+#endif
+	}
+}
+#endif
+
 /****************************************************************************
  * Name: smartfs_write
  ****************************************************************************/
@@ -716,7 +991,7 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 	size_t byteswritten;
 	int ret;
 
-#ifdef CONFIG_SMARTFS_JOURNALING
+#if defined(CONFIG_SMARTFS_JOURNALING) && !defined(CONFIG_SMARTFS_USE_SECTOR_BUFFER)
 	int retj;
 	uint16_t t_sector, t_offset;
 #endif
@@ -791,6 +1066,21 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 		/* Now perform the write. */
 
 		if (readwrite.count > 0) {
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+			/* Change the data in our sector buffer */
+
+			ret = smartfs_loadbuffer(fs, sf, sf->currsector);
+			if (ret < 0) {
+				fdbg("Error %d reading sector %d data\n", ret, sf->currsector);
+				goto errout_with_semaphore;
+			}
+
+			memcpy(&sf->buffer[sf->curroffset], readwrite.buffer, readwrite.count);
+			sf->bflags |= SMARTFS_BFLAG_DIRTY;
+			if (sf->curroffset < sf->bstart) {
+				sf->bstart = sf->curroffset;
+			}
+#else							/* CONFIG_SMARTFS_USE_SECTOR_BUFFER */
 #ifdef CONFIG_SMARTFS_JOURNALING
 			ret = smartfs_create_journalentry(fs, T_WRITE, readwrite.logsector, readwrite.offset, readwrite.count, 0, 0, readwrite.buffer, &t_sector, &t_offset);
 			if (ret != OK) {
@@ -812,6 +1102,7 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 				fdbg("Error %d writing sector %d data\n", ret, sf->currsector);
 				goto errout_with_semaphore;
 			}
+#endif							/* CONFIG_SMARTFS_USE_SECTOR_BUFFER */
 
 			/* Update our control variables */
 
@@ -829,6 +1120,15 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 			 * header to get the sector chain info.
 			 */
 
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+			ret = smartfs_loadbuffer(fs, sf, sf->currsector);
+			if (ret < 0) {
+				fdbg("Error %d reading sector %d header\n", ret, sf->currsector);
+				goto errout_with_semaphore;
+			}
+
+			header = (struct smartfs_chain_header_s *)sf->buffer;
+#else
 			readwrite.offset = 0;
 			readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
 			readwrite.count = sizeof(struct smartfs_chain_header_s);
@@ -837,6 +1137,7 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 				fdbg("Error %d reading sector %d header\n", ret, sf->currsector);
 				goto errout_with_semaphore;
 			}
+#endif
 
 			/* Now get the chained sector info and reset the offset */
 
@@ -853,6 +1154,12 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 		 */
 
 #ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+		ret = smartfs_loadbuffer(fs, sf, sf->currsector);
+		if (ret < 0) {
+			fdbg("Error %d reading sector %d data\n", ret, sf->currsector);
+			goto errout_with_semaphore;
+		}
+
 		readwrite.count = fs->fs_llformat.availbytes - sf->curroffset;
 		if (readwrite.count > buflen) {
 			readwrite.count = buflen;
@@ -860,6 +1167,9 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 
 		memcpy(&sf->buffer[sf->curroffset], &buffer[byteswritten], readwrite.count);
 		sf->bflags |= SMARTFS_BFLAG_DIRTY;
+		if (sf->curroffset < sf->bstart) {
+			sf->bstart = sf->curroffset;
+		}
 
 #else							/* CONFIG_SMARTFS_USE_SECTOR_BUFFER */
 		readwrite.offset = sf->curroffset;
@@ -916,6 +1226,9 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 
 			header = (struct smartfs_chain_header_s *)sf->buffer;
 			*((uint16_t *)header->nextsector) = (uint16_t)ret;
+			if (sf->bstart > offsetof(struct smartfs_chain_header_s, nextsector)) {
+				sf->bstart = offsetof(struct smartfs_chain_header_s, nextsector);
+			}
 
 			/* Now sync the file to write this sector out */
 
@@ -934,11 +1247,13 @@ static ssize_t smartfs_write(FAR struct file *filep, const char *buffer, size_t
 				fdbg("Error - duplicate logical sector %d\n", sf->currsector);
 			}
 
-			sf->bflags = SMARTFS_BFLAG_DIRTY;
+			sf->bflags = SMARTFS_BFLAG_DIRTY | SMARTFS_BFLAG_NEWALLOC;
 			sf->currsector = SMARTFS_NEXTSECTOR(header);
 			sf->curroffset = sizeof(struct smartfs_chain_header_s);
+			sf->bsector = sf->currsector;
+			sf->bstart = 0;
 			memset(sf->buffer, CONFIG_SMARTFS_ERASEDSTATE, fs->fs_llformat.availbytes);
-			header->type = SMARTFS_DIRENT_TYPE_FILE;
+			header->type = SMARTFS_SECTOR_TYPE_FILE;
 		}
 #else							/* CONFIG_SMARTFS_USE_SECTOR_BUFFER */
 
@@ -1044,7 +1359,12 @@ static off_t smartfs_seek_internal(struct smartfs_mountpt_s *fs, struct smartfs_
 
 	/* Test if we need to sync the file */
 
-	if (sf->byteswritten > 0) {
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+	if (sf->bflags & SMARTFS_BFLAG_DIRTY)
+#else
+	if (sf->byteswritten > 0)
+#endif
+	{
 		/* Perform a sync */
 
 		smartfs_sync_internal(fs, sf);
@@ -1129,25 +1449,6 @@ static off_t smartfs_seek_internal(struct smartfs_mountpt_s *fs, struct smartfs_
 		sf->currsector = SMARTFS_NEXTSECTOR(header);
 	}
 
-#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
-
-	/* When using sector buffering, we must read in the last buffer to our
-	 * sf->buffer in case any changes are made.
-	 */
-
-	if (sf->currsector != SMARTFS_ERASEDSTATE_16BIT) {
-		readwrite.logsector = sf->currsector;
-		readwrite.offset = 0;
-		readwrite.count = fs->fs_llformat.availbytes;
-		readwrite.buffer = (uint8_t *)sf->buffer;
-		ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
-		if (ret < 0) {
-			fdbg("Error %d reading sector %d header\n", ret, sf->currsector);
-			goto errout;
-		}
-	}
-#endif
-
 	/* Now calculate the offset */
 
 	sf->curroffset = sizeof(struct smartfs_chain_header_s) + newpos - sf->filepos;
@@ -1240,6 +1541,11 @@ static int smartfs_sync(FAR struct file *filep)
 	smartfs_semtake(fs);
 
 	ret = smartfs_sync_internal(fs, sf);
+	if (ret == OK) {
+		/* Let the block device flush the state it caches, if any */
+
+		(void)FS_IOCTL(fs, BIOC_FLUSH, 0);
+	}
 
 	smartfs_semgive(fs);
 	return ret;
@@ -1686,6 +1992,9 @@ static int smartfs_unlink(struct inode *mountpt, const char *relpath)
 #endif
 
 		smartfs_deleteentry(fs, &entry);
+#ifdef CONFIG_SMARTFS_USE_SECTOR_BUFFER
+		smartfs_invalidate_buffers(fs, NULL, 0xFFFF);
+#endif
 #ifdef CONFIG_SMARTFS_JOURNALING
 		ret = smartfs_finish_journalentry(fs, 0, t_sector, t_offset, T_DELETE);
 		if (ret != OK) {
@@ -2086,6 +2395,9 @@ int smartfs_rename(struct inode *mountpt, const char *oldrelpath, const char *ne
 			fdbg("Error %d writing flag bytes for sector %d\n", ret, readwrite.logsector);
 			goto errout_with_semaphore;
 		}
+#ifdef CONFIG_SMARTFS_DIRINDEX
+		smartfs_dirindex_remove(fs, ((struct smartfs_entry_header_s *)tmp_pntr)->name, oldentry.dsector, oldentry.doffset);
+#endif
 	} else {
 		/* Trying to create in a directory that doesn't exist */
 
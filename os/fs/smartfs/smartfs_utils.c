@@ -642,6 +642,10 @@ int smartfs_unmount(struct smartfs_mountpt_s *fs)
 	int found = FALSE;
 #endif
 
+#ifdef CONFIG_SMARTFS_DIRINDEX
+	smartfs_dirindex_free(fs);
+#endif
+
 #if defined(CONFIG_SMARTFS_MULTI_ROOT_DIRS) || \
 	(defined(CONFIG_FS_PROCFS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_SMARTFS))
 	/* Start at the head of the mounts and search for our entry.  Also
@@ -852,8 +856,26 @@ int smartfs_finddirentry(struct smartfs_mountpt_s *fs, struct smartfs_entry_s *d
 
 			/* Read the directory */
 
+			readwrite.count = fs->fs_llformat.availbytes;
 			offset = 0xFFFF;
 
+#ifdef CONFIG_SMARTFS_DIRINDEX
+			/* Look the name up in the directory index first, and read
+			 * through the directory only if the index cannot tell.
+			 */
+
+			ret = smartfs_dirindex_find(fs, dirsector, fs->fs_workbuffer, &readwrite.logsector, &offset);
+			if (ret == OK) {
+				entry = (struct smartfs_entry_header_s *)&fs->fs_rwbuffer[offset];
+			} else if (ret != -ENOENT && ret != -EAGAIN) {
+				goto errout;
+			}
+
+			if (ret != -EAGAIN) {
+				dirsector = SMARTFS_ERASEDSTATE_16BIT;
+			}
+#endif
+
 #if CONFIG_SMARTFS_ERASEDSTATE == 0xFF
 			while (dirsector != 0xFFFF)
 #else
@@ -896,170 +918,173 @@ int smartfs_finddirentry(struct smartfs_mountpt_s *fs, struct smartfs_entry_s *d
 					/* Test if the name matches */
 
 					if (strncmp(entry->name, fs->fs_workbuffer, fs->fs_llformat.namesize) == 0) {
-						/* We found it!  If this is the last segment entry,
-						 * then report the entry.  If it isn't the last
-						 * entry, then validate it is a directory entry and
-						 * open it and continue searching.
-						 */
+						/* We found it! */
 
-						if (*ptr == '\0') {
-							/* We are at the last segment.  Report the entry */
+						break;
+					}
 
-							/* Fill in the entry */
+					/* Not this entry.  Skip to the next one */
 
-#ifdef CONFIG_SMARTFS_ALIGNED_ACCESS
-							direntry->firstsector = smartfs_rdle16(&entry->firstsector);
-							direntry->flags = smartfs_rdle16(&entry->flags);
-							direntry->utc = smartfs_rdle32(&entry->utc);
-#else
-							direntry->firstsector = entry->firstsector;
-							direntry->flags = entry->flags;
-							direntry->utc = entry->utc;
-#endif
-							direntry->dsector = readwrite.logsector;
-							direntry->doffset = offset;
-							direntry->dfirst = dirstack[depth];
-							if (direntry->name == NULL) {
-								direntry->name = (char *)kmm_malloc(fs->fs_llformat.namesize + 1);
-								if (direntry->name == NULL) {
-									ret = ERROR;
-									goto errout;
-								}
-							}
+					offset += entrysize;
+					entry = (struct smartfs_entry_header_s *)
+							&fs->fs_rwbuffer[offset];
+				}
 
-							memset(direntry->name, 0, fs->fs_llformat.namesize + 1);
-							strncpy(direntry->name, entry->name, fs->fs_llformat.namesize);
-							direntry->datlen = 0;
+				/* Test if a directory entry was found and break if it was */
 
-							/* Scan the file's sectors to calculate the length and perform
-							 * a rudimentary check.
-							 */
+				if (offset < readwrite.count) {
+					break;
+				}
+			}
 
-#ifdef CONFIG_SMARTFS_ALIGNED_ACCESS
-							if ((smartfs_rdle16(&entry->flags) & SMARTFS_DIRENT_TYPE) == SMARTFS_DIRENT_TYPE_FILE) {
-								dirsector = smartfs_rdle16(&entry->firstsector);
-#else
-							if ((entry->flags & SMARTFS_DIRENT_TYPE) == SMARTFS_DIRENT_TYPE_FILE) {
-								dirsector = entry->firstsector;
-#endif
-								readwrite.count = sizeof(struct smartfs_chain_header_s);
-								readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
-								readwrite.offset = 0;
-
-								while (dirsector != SMARTFS_ERASEDSTATE_16BIT) {
-									/* Read the next sector of the file */
-
-									readwrite.logsector = dirsector;
-									ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
-									if (ret < 0) {
-										fdbg("Error in sector chain at %d!\n", dirsector);
-										break;
-									}
-#ifdef CONFIG_SMARTFS_DYNAMIC_HEADER
-									if (SMARTFS_NEXTSECTOR(header) == SMARTFS_ERASEDSTATE_16BIT) {
-
-										readwrite.count = fs->fs_llformat.availbytes;
-										readwrite.buffer = (uint8_t *)fs->fs_chunk_buffer;
-
-										ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
-										if (ret < 0) {
-											fdbg("Error %d reading sector %d header\n", ret, sf->currsector);
-											break;
-										}
-										used_value = get_leftover_used_byte_count((uint8_t *)readwrite.buffer, get_used_byte_count((uint8_t *)header->used));
-										direntry->datlen += used_value;
-									} else {
-										direntry->datlen += (fs->fs_llformat.availbytes - sizeof(struct smartfs_chain_header_s));
-									}
-									readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
-#else
-									/* Add used bytes to the total and point to next sector */
-									if (SMARTFS_USED(header) != SMARTFS_ERASEDSTATE_16BIT) {
-										direntry->datlen += SMARTFS_USED(header);
-									}
-#endif
-									dirsector = SMARTFS_NEXTSECTOR(header);
-								}
-							}
+			/* Test if the entry was found */
 
-							*parentdirsector = dirstack[depth];
-							*filename = segment;
-							ret = OK;
-							goto errout;
-						} else {
-							/* Validate it's a directory */
+			if (offset >= readwrite.count) {
+				/* Entry not found!  Report the error.  Also, if this is the
+				 * last segment, then report the parent directory sector.
+				 */
+
+				if (*ptr == '\0') {
+					*parentdirsector = dirstack[depth];
+					*filename = segment;
+				} else {
+					*parentdirsector = 0xFFFF;
+					*filename = NULL;
+				}
+
+				ret = -ENOENT;
+				goto errout;
+			}
+
+			/* We found it!  If this is the last segment entry,
+			 * then report the entry.  If it isn't the last
+			 * entry, then validate it is a directory entry and
+			 * open it and continue searching.
+			 */
+
+			if (*ptr == '\0') {
+				/* We are at the last segment.  Report the entry */
+
+				/* Fill in the entry */
 
 #ifdef CONFIG_SMARTFS_ALIGNED_ACCESS
-							if ((smartfs_rdle16(&entry->flags) & SMARTFS_DIRENT_TYPE) != SMARTFS_DIRENT_TYPE_DIR)
+				direntry->firstsector = smartfs_rdle16(&entry->firstsector);
+				direntry->flags = smartfs_rdle16(&entry->flags);
+				direntry->utc = smartfs_rdle32(&entry->utc);
 #else
-							if ((entry->flags & SMARTFS_DIRENT_TYPE) != SMARTFS_DIRENT_TYPE_DIR)
+				direntry->firstsector = entry->firstsector;
+				direntry->flags = entry->flags;
+				direntry->utc = entry->utc;
 #endif
-							{
-								/* Not a directory!  Report the error */
-
-								ret = -ENOTDIR;
-								goto errout;
-							}
+				direntry->dsector = readwrite.logsector;
+				direntry->doffset = offset;
+				direntry->dfirst = dirstack[depth];
+				if (direntry->name == NULL) {
+					direntry->name = (char *)kmm_malloc(fs->fs_llformat.namesize + 1);
+					if (direntry->name == NULL) {
+						ret = ERROR;
+						goto errout;
+					}
+				}
 
-							/* "Push" the directory and continue searching */
+				memset(direntry->name, 0, fs->fs_llformat.namesize + 1);
+				strncpy(direntry->name, entry->name, fs->fs_llformat.namesize);
+				direntry->datlen = 0;
 
-							if (depth >= CONFIG_SMARTFS_DIRDEPTH - 1) {
-								/* Directory depth too big */
+				/* Scan the file's sectors to calculate the length and perform
+				 * a rudimentary check.
+				 */
 
-								ret = -ENAMETOOLONG;
-								goto errout;
-							}
 #ifdef CONFIG_SMARTFS_ALIGNED_ACCESS
-							dirstack[++depth] = smartfs_rdle16(&entry->firstsector);
+				if ((smartfs_rdle16(&entry->flags) & SMARTFS_DIRENT_TYPE) == SMARTFS_DIRENT_TYPE_FILE) {
+					dirsector = smartfs_rdle16(&entry->firstsector);
 #else
-							dirstack[++depth] = entry->firstsector;
+				if ((entry->flags & SMARTFS_DIRENT_TYPE) == SMARTFS_DIRENT_TYPE_FILE) {
+					dirsector = entry->firstsector;
 #endif
-							segment = ptr + 1;
+					header = (struct smartfs_chain_header_s *)fs->fs_rwbuffer;
+					readwrite.count = sizeof(struct smartfs_chain_header_s);
+					readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
+					readwrite.offset = 0;
+
+					while (dirsector != SMARTFS_ERASEDSTATE_16BIT) {
+						/* Read the next sector of the file */
+
+						readwrite.logsector = dirsector;
+						ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+						if (ret < 0) {
+							fdbg("Error in sector chain at %d!\n", dirsector);
 							break;
 						}
-					}
+#ifdef CONFIG_SMARTFS_DYNAMIC_HEADER
+						if (SMARTFS_NEXTSECTOR(header) == SMARTFS_ERASEDSTATE_16BIT) {
 
-					/* Not this entry.  Skip to the next one */
+							readwrite.count = fs->fs_llformat.availbytes;
+							readwrite.buffer = (uint8_t *)fs->fs_chunk_buffer;
 
-					offset += entrysize;
-					entry = (struct smartfs_entry_header_s *)
-							&fs->fs_rwbuffer[offset];
+							ret = FS_IOCTL(fs, BIOC_READSECT, (unsigned long)&readwrite);
+							if (ret < 0) {
+								fdbg("Error %d reading sector %d header\n", ret, sf->currsector);
+								break;
+							}
+							used_value = get_leftover_used_byte_count((uint8_t *)readwrite.buffer, get_used_byte_count((uint8_t *)header->used));
+							direntry->datlen += used_value;
+						} else {
+							direntry->datlen += (fs->fs_llformat.availbytes - sizeof(struct smartfs_chain_header_s));
+						}
+						readwrite.buffer = (uint8_t *)fs->fs_rwbuffer;
+#else
+						/* Add used bytes to the total and point to next sector */
+						if (SMARTFS_USED(header) != SMARTFS_ERASEDSTATE_16BIT) {
+							direntry->datlen += SMARTFS_USED(header);
+						}
+#endif
+						dirsector = SMARTFS_NEXTSECTOR(header);
+					}
 				}
 
-				/* Test if a directory entry was found and break if it was */
+				*parentdirsector = dirstack[depth];
+				*filename = segment;
+				ret = OK;
+				goto errout;
+			} else {
+				/* Validate it's a directory */
 
-				if (offset < readwrite.count) {
-					break;
+#ifdef CONFIG_SMARTFS_ALIGNED_ACCESS
+				if ((smartfs_rdle16(&entry->flags) & SMARTFS_DIRENT_TYPE) != SMARTFS_DIRENT_TYPE_DIR)
+#else
+				if ((entry->flags & SMARTFS_DIRENT_TYPE) != SMARTFS_DIRENT_TYPE_DIR)
+#endif
+				{
+					/* Not a directory!  Report the error */
+
+					ret = -ENOTDIR;
+					goto errout;
 				}
-			}
 
-			/* If we found a dir entry, then continue searching */
+				/* "Push" the directory and continue searching */
 
-			if (offset < readwrite.count) {
-				/* Update the segment pointer */
+				if (depth >= CONFIG_SMARTFS_DIRDEPTH - 1) {
+					/* Directory depth too big */
 
-				if (*ptr != '\0') {
-					ptr++;
+					ret = -ENAMETOOLONG;
+					goto errout;
 				}
-
-				segment = ptr;
-				continue;
+#ifdef CONFIG_SMARTFS_ALIGNED_ACCESS
+				dirstack[++depth] = smartfs_rdle16(&entry->firstsector);
+#else
+				dirstack[++depth] = entry->firstsector;
+#endif
 			}
 
-			/* Entry not found!  Report the error.  Also, if this is the last
-			 * segment, then report the parent directory sector.
-			 */
+			/* Update the segment pointer and continue searching */
 
-			if (*ptr == '\0') {
-				*parentdirsector = dirstack[depth];
-				*filename = segment;
-			} else {
-				*parentdirsector = 0xFFFF;
-				*filename = NULL;
+			if (*ptr != '\0') {
+				ptr++;
 			}
 
-			ret = -ENOENT;
-			goto errout;
+			segment = ptr;
+			continue;
 		}
 	}
 
@@ -1229,6 +1254,8 @@ int smartfs_createentry(struct smartfs_mountpt_s *fs, uint16_t parentdirsector,
 			chainheader = (struct smartfs_chain_header_s *)sf->buffer;
 			chainheader->type = SMARTFS_SECTOR_TYPE_FILE;
 			sf->bflags = SMARTFS_BFLAG_DIRTY | SMARTFS_BFLAG_NEWALLOC;
+			sf->bsector = nextsector;
+			sf->bstart = 0;
 		} else
 #endif
 		{
@@ -1276,6 +1303,9 @@ int smartfs_createentry(struct smartfs_mountpt_s *fs, uint16_t parentdirsector,
 	if (ret < 0) {
 		goto errout;
 	}
+#ifdef CONFIG_SMARTFS_DIRINDEX
+	smartfs_dirindex_add(fs, parentdirsector, filename, psector, offset);
+#endif
 
 	/* Now fill in the entry */
 
@@ -1408,6 +1438,13 @@ int smartfs_deleteentry(struct smartfs_mountpt_s *fs, struct smartfs_entry_s *en
 		fdbg("Error marking entry inactive at sector %d\n", entry->dsector);
 		goto errout;
 	}
+#ifdef CONFIG_SMARTFS_DIRINDEX
+	smartfs_dirindex_remove(fs, direntry->name, entry->dsector, entry->doffset);
+
+	/* Forget the index of the entry if it was a directory */
+
+	smartfs_dirindex_drop(fs, entry->firstsector);
+#endif
 
 	/* Test if any entries in this sector are being used */
 
@@ -1679,6 +1716,8 @@ int smartfs_truncatefile(struct smartfs_mountpt_s *fs, struct smartfs_entry_s *e
 		header = (struct smartfs_chain_header_s *)sf->buffer;
 		header->type = SMARTFS_SECTOR_TYPE_FILE;
 		sf->bflags = SMARTFS_BFLAG_DIRTY;
+		sf->bsector = entry->firstsector;
+		sf->bstart = 0;
 		entry->datlen = 0;
 	}
 #endif
@@ -2533,6 +2572,11 @@ static int smartfs_redo_rename(struct smartfs_mountpt_s *fs)
 	req.count = sizeof(direntry->flags);
 	req.buffer = (uint8_t *)&direntry->flags;
 	ret = FS_IOCTL(fs, BIOC_WRITESECT, (unsigned long)&req);
+#ifdef CONFIG_SMARTFS_DIRINDEX
+	if (ret >= 0) {
+		smartfs_dirindex_remove(fs, direntry->name, req.logsector, oldoffset);
+	}
+#endif
 errout:
 	if (filename) {
 		kmm_free(filename);
@@ -2621,6 +2665,9 @@ static int smartfs_redo_create(struct smartfs_mountpt_s *fs, uint16_t type, uint
 					fdbg("Error marking entry inactive at sector %d\n", req.logsector);
 					goto err_out;
 				}
+#ifdef CONFIG_SMARTFS_DIRINDEX
+				smartfs_dirindex_remove(fs, direntry->name, req.logsector, offset);
+#endif
 				break;
 			}
 			offset += direntrysize;
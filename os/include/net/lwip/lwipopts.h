@@ -338,6 +338,10 @@
 #define MEMP_SEPARATE_POOLS	CONFIG_NET_MEMP_SEPARATE_POOLS
 #endif
 
+#ifdef CONFIG_NET_MEMP_KMEM_CACHE
+#define MEMP_KMEM_CACHE	1
+#endif
+
 /* ---------- Memory options ---------- */
 
 /*---------- Interanl Memory Pool Sizes ----*/
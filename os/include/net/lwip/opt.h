@@ -158,6 +158,16 @@
 #define MEMP_SEPARATE_POOLS             0
 #endif
 
+/**
+ * MEMP_KMEM_CACHE==1: Allocate the elements of each pool from a kernel
+ * object cache (see tinyara/mm/kmem_cache.h) instead of a static array.
+ * Pool sizes and statistics are unchanged; the caches also show up in
+ * /proc/kmemcache.
+ */
+#ifndef MEMP_KMEM_CACHE
+#define MEMP_KMEM_CACHE                 0
+#endif
+
 /**
  * MEMP_OVERFLOW_CHECK: memp overflow protection reserves a configurable
  * amount of bytes before and after each memp element in every pool and fills
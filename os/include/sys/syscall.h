@@ -425,9 +425,18 @@
 
 #if CONFIG_TASK_NAME_SIZE > 0
 #define SYS_prctl                      (SYS_nnetsocket+0)
-#define SYS_maxsyscall                 (SYS_nnetsocket+1)
+#define __SYS_wqueue                   (SYS_nnetsocket+1)
 #else
-#define SYS_maxsyscall                 SYS_nnetsocket
+#define __SYS_wqueue                   SYS_nnetsocket
+#endif
+
+/* The following is defined only if the work queue statistics are enabled */
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+#define SYS_work_stats_record          (__SYS_wqueue+0)
+#define SYS_maxsyscall                 (__SYS_wqueue+1)
+#else
+#define SYS_maxsyscall                 __SYS_wqueue
 #endif
 
 /* Note that the reported number of system calls does *NOT* include the
@@ -1468,6 +1468,25 @@ void up_timer_initialize(void);
 int up_timer_gettime(FAR struct timespec *ts);
 #endif
 
+/****************************************************************************
+ * Name: up_perf_init and up_perf_gettime
+ *
+ * Description:
+ *   up_perf_init() starts a free-running 32-bit counter of CPU cycles and
+ *   up_perf_gettime() returns its value.  The counter wraps around every
+ *   2^32 cycles and is meant for fine-grained timestamps, e.g. of trace
+ *   events.
+ *
+ *   Provided by architecture-specific code when
+ *   CONFIG_ARCH_HAVE_PERF_EVENTS is selected.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+void up_perf_init(void);
+uint32_t up_perf_gettime(void);
+#endif
+
 /****************************************************************************
  * Name: up_alarm_cancel
  *
@@ -93,6 +93,7 @@
 #define _RTCBASE        (0x1800)	/* RTC ioctl commands */
 #define _FOTABASE       (0x1900)	/* FOTA ioctl commands */
 #define _GPIOBASE       (0x2000)	/* GPIO ioctl commands */
+#define _WQUEUEBASE     (0x2100)	/* Work queue ioctl commands */
 
 /* boardctl() commands share the same number space */
 #define _BOARDBASE      (0xff00)	/* boardctl commands */
@@ -229,6 +230,11 @@
 										 *      the block with specific debug
 										 *      command and data.
 										 * OUT: None.  */
+#define BIOC_FLUSH      _BIOC(0x000C)	/* Flush the state cached by the block
+										 * device to the media.
+										 * IN:  None
+										 * OUT: None (ioctl return value provides
+										 *      success/failure indication). */
 
 /* TinyAra MTD driver ioctl definitions ***************************************/
 
@@ -340,6 +346,15 @@
 #define _GPIOIOCVALID(c)   (_IOC_TYPE(c) == _GPIOBASE)
 #define _GPIOIOC(nr)       _IOC(_GPIOBASE, nr)
 
+/* Work queue ioctl definitions (see /proc/wqueue) *************************/
+
+#define _WQUEUEIOCVALID(c) (_IOC_TYPE(c) == _WQUEUEBASE)
+#define _WQUEUEIOC(nr)     _IOC(_WQUEUEBASE, nr)
+
+#define WQUEUEIOC_RESET    _WQUEUEIOC(0x0001)	/* Clear the statistics
+											 * IN: None
+											 * OUT: None */
+
 /* boardctl() command definitions *******************************************/
 #define _BOARDIOCVALID(c)  (_IOC_TYPE(c) == _BOARDBASE)
 #define _BOARDIOC(nr)      _IOC(_BOARDBASE, nr)
@@ -104,6 +104,12 @@ struct procfs_operations {
 	/* Operations on paths */
 
 	int (*stat)(FAR const char *relpath, FAR struct stat *buf);
+
+	/* Additional open-file-specific operations.  Handlers that do not
+	 * support any ioctl command may leave this out of their initializer.
+	 */
+
+	int (*ioctl)(FAR struct file *filep, int cmd, unsigned long arg);
 };
 
 /* Procfs handler prototypes ************************************************/
@@ -0,0 +1,201 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * include/tinyara/mm/kmem_cache.h
+ *
+ * Fixed-size object caches built on the granule allocator.
+ *
+ ****************************************************************************/
+
+#ifndef __INCLUDE_MM_KMEM_CACHE_H
+#define __INCLUDE_MM_KMEM_CACHE_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <tinyara/mm/gran.h>
+
+#ifdef CONFIG_MM_KMEM_CACHE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Flags for kmem_cache_create() */
+
+#define KMEM_CACHE_OVERFLOW  0x01	/* Fall back to the kernel heap when full */
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Constructor called on every object handed out by a cache */
+
+typedef CODE void (*kmem_ctor_t)(FAR void *obj);
+
+/* Usage counters of one cache */
+
+struct kmem_cache_stats_s {
+	uint32_t allocs;			/* Objects allocated from the pool */
+	uint32_t frees;				/* Objects returned to the pool */
+	uint32_t overflows;			/* Allocations served by the kernel heap */
+	uint32_t fails;				/* Allocations that returned NULL */
+	uint16_t inuse;				/* Pool objects currently allocated */
+	uint16_t peak;				/* Highest value of inuse */
+};
+
+/* This structure describes one object cache.  Its pool is a single kernel
+ * heap block managed by a private granule allocator, so that objects are
+ * found in the granule allocation bitmap rather than in the variable-size
+ * free lists of the heap.
+ */
+
+struct kmem_cache_s {
+	FAR struct kmem_cache_s *flink;	/* Next cache in the list of all caches */
+	FAR const char *name;		/* Name shown in /proc/kmemcache */
+	GRAN_HANDLE gran;			/* Granule allocator of the pool */
+	FAR void *pool;				/* Kernel heap block holding the pool */
+	uintptr_t start;			/* First byte of the pool */
+	uintptr_t end;				/* First byte after the pool */
+	size_t objsize;				/* Size of one object */
+	size_t slotsize;			/* Pool bytes taken by one object */
+	uint16_t nobjs;				/* Number of objects in the pool */
+	uint8_t flags;				/* KMEM_CACHE_* flags */
+	kmem_ctor_t ctor;			/* Object constructor or NULL */
+	struct kmem_cache_stats_s stats;
+};
+
+/* Snapshot of one cache returned by kmem_cache_getinfo() */
+
+struct kmem_cache_info_s {
+	FAR const char *name;
+	size_t objsize;
+	size_t slotsize;
+	uint16_t nobjs;
+	struct kmem_cache_stats_s stats;
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+#ifdef __cplusplus
+#define EXTERN extern "C"
+extern "C" {
+#else
+#define EXTERN extern
+#endif
+
+/****************************************************************************
+ * Name: kmem_cache_create
+ *
+ * Description:
+ *   Create a cache of 'nobjs' objects of 'size' bytes.  The pool is
+ *   allocated from the kernel heap at once.  'name' must remain valid for
+ *   the life of the cache.
+ *
+ * Input Parameters:
+ *   name  - Name of the cache
+ *   size  - Size of one object
+ *   nobjs - Number of objects in the pool
+ *   flags - KMEM_CACHE_* flags
+ *   ctor  - Constructor called on every allocated object, or NULL
+ *
+ * Returned Value:
+ *   The new cache or NULL if the pool could not be allocated.
+ *
+ ****************************************************************************/
+
+FAR struct kmem_cache_s *kmem_cache_create(FAR const char *name, size_t size, uint16_t nobjs, uint8_t flags, kmem_ctor_t ctor);
+
+/****************************************************************************
+ * Name: kmem_cache_destroy
+ *
+ * Description:
+ *   Release a cache and its pool.  All of its objects must have been
+ *   freed.
+ *
+ ****************************************************************************/
+
+void kmem_cache_destroy(FAR struct kmem_cache_s *cache);
+
+/****************************************************************************
+ * Name: kmem_cache_alloc and kmem_cache_zalloc
+ *
+ * Description:
+ *   Allocate one object from a cache.  kmem_cache_zalloc() clears the
+ *   object before the constructor runs.  When the pool is exhausted, the
+ *   object comes from the kernel heap if the cache was created with
+ *   KMEM_CACHE_OVERFLOW; otherwise NULL is returned.
+ *
+ *   Without KMEM_CACHE_OVERFLOW, these may be called from interrupt
+ *   handlers.
+ *
+ ****************************************************************************/
+
+FAR void *kmem_cache_alloc(FAR struct kmem_cache_s *cache);
+FAR void *kmem_cache_zalloc(FAR struct kmem_cache_s *cache);
+
+/****************************************************************************
+ * Name: kmem_cache_free
+ *
+ * Description:
+ *   Return an object to its cache.  Objects that do not belong to the pool
+ *   are released to the kernel heap.
+ *
+ ****************************************************************************/
+
+void kmem_cache_free(FAR struct kmem_cache_s *cache, FAR void *obj);
+
+/****************************************************************************
+ * Name: kmem_cache_member
+ *
+ * Description:
+ *   Return true if 'obj' lies in the pool of 'cache'.
+ *
+ ****************************************************************************/
+
+bool kmem_cache_member(FAR struct kmem_cache_s *cache, FAR const void *obj);
+
+/****************************************************************************
+ * Name: kmem_cache_getinfo
+ *
+ * Description:
+ *   Take a snapshot of the 'index'th cache in the list of all caches.
+ *
+ * Returned Value:
+ *   OK on success, -ENOENT if there is no such cache.
+ *
+ ****************************************************************************/
+
+int kmem_cache_getinfo(int index, FAR struct kmem_cache_info_s *info);
+
+#undef EXTERN
+#ifdef __cplusplus
+}
+#endif
+
+#endif							/* CONFIG_MM_KMEM_CACHE */
+#endif							/* __INCLUDE_MM_KMEM_CACHE_H */
@@ -176,6 +176,25 @@
 #define MM_MAX_CHUNK     (1 << MM_MAX_SHIFT)
 #define MM_NNODES        (MM_MAX_SHIFT - MM_MIN_SHIFT + 1)
 
+/* TLSF (two-level segregated fit) free list geometry.  Each power-of-two
+ * first-level class of the nodelist is split into MM_TLSF_SL_COUNT linear
+ * second-level classes so that a fitting free list can be found with two
+ * bitmap lookups instead of a walk.
+ */
+
+#ifdef CONFIG_MM_TLSF
+#ifndef CONFIG_MM_TLSF_SL_SHIFT
+#define CONFIG_MM_TLSF_SL_SHIFT 3
+#endif
+
+#if CONFIG_MM_TLSF_SL_SHIFT > MM_MIN_SHIFT
+#error CONFIG_MM_TLSF_SL_SHIFT must not be larger than MM_MIN_SHIFT
+#endif
+
+#define MM_TLSF_SL_SHIFT CONFIG_MM_TLSF_SL_SHIFT
+#define MM_TLSF_SL_COUNT (1 << MM_TLSF_SL_SHIFT)
+#endif
+
 #define MM_GRAN_MASK     (MM_MIN_CHUNK-1)
 #define MM_ALIGN_UP(a)   (((a) + MM_GRAN_MASK) & ~MM_GRAN_MASK)
 #define MM_ALIGN_DOWN(a) ((a) & ~MM_GRAN_MASK)
@@ -320,14 +339,89 @@ struct mm_heap_s {
 	int mm_nregions;
 #endif
 
+#ifdef CONFIG_MM_TLSF
+	/* Free nodes are kept in MM_NNODES x MM_TLSF_SL_COUNT segregated,
+	 * unordered lists.  Bit n of mm_flbitmap is set when any list of first
+	 * level n is non-empty, bit m of mm_slbitmap[n] when mm_freelist[n][m]
+	 * is non-empty.
+	 */
+
+	uint32_t mm_flbitmap;
+	uint32_t mm_slbitmap[MM_NNODES];
+	FAR struct mm_freenode_s *mm_freelist[MM_NNODES][MM_TLSF_SL_COUNT];
+#else
 	/* All free nodes are maintained in a doubly linked list.  This
 	 * array provides some hooks into the list at various points to
 	 * speed searches for free nodes.
 	 */
 
 	struct mm_freenode_s mm_nodelist[MM_NNODES];
+#endif
 };
 
+#ifdef CONFIG_MM_UMM_CACHE
+/* Small user allocations are served from per-priority-band caches of
+ * allocated chunks, one list per chunk size class of MM_MIN_CHUNK bytes.
+ */
+
+#define UMM_CACHE_MAXCHUNK  MM_ALIGN_UP(CONFIG_MM_UMM_CACHE_MAXSIZE + SIZEOF_MM_ALLOCNODE)
+#define UMM_CACHE_NCLASSES  (UMM_CACHE_MAXCHUNK >> MM_MIN_SHIFT)
+
+/* This describes the activity of the cache of one priority band */
+
+struct umm_cache_stats_s {
+	uint32_t hits;				/* Allocations served from the cache */
+	uint32_t misses;			/* Allocations that found their class empty */
+	uint32_t frees;				/* Frees kept in the cache */
+	uint32_t refills;			/* Batches taken from the heap */
+	uint32_t drains;			/* Batches returned to the heap */
+	uint16_t count[UMM_CACHE_NCLASSES];	/* Chunks currently cached per class */
+};
+#endif
+
+#ifdef CONFIG_DEBUG_MM_HEAPPROF
+/* Types of the events recorded by the heap profiler */
+
+#define HEAPPROF_EVENT_ALLOC 1
+#define HEAPPROF_EVENT_FREE  2
+
+/* This describes one allocation or free.  'seq' is one more than the
+ * sequence number of the event and is rewritten last, so that a reader can
+ * detect a slot that was overwritten while it was being copied.
+ */
+
+struct heapprof_event_s {
+	uint32_t seq;				/* Sequence number + 1, 0 while being written */
+	uint32_t time;				/* System timer ticks */
+	mmaddress_t caller;			/* Return address of the allocation call */
+	mmaddress_t addr;			/* Address of the chunk */
+	mmsize_t size;				/* Size of the chunk */
+	int16_t pid;				/* Owner of the chunk */
+	uint8_t type;				/* HEAPPROF_EVENT_* */
+};
+
+/* Live allocations of one call site.  Call sites that do not fit in the
+ * table are accounted together with caller 0.
+ */
+
+struct heapprof_caller_s {
+	mmaddress_t caller;			/* Return address of the allocation call */
+	uint32_t live;				/* Bytes currently allocated */
+	uint32_t peak;				/* Highest value of live */
+	uint32_t count;				/* Chunks currently allocated */
+	uint32_t allocs;			/* Total number of allocations */
+};
+
+/* Totals of all profiled heaps */
+
+struct heapprof_stats_s {
+	uint32_t events;			/* Number of events recorded so far */
+	uint32_t live;				/* Bytes currently allocated */
+	uint32_t peak;				/* Highest value of live */
+	uint32_t hist[MM_NNODES];	/* Live chunks per power-of-two size class */
+};
+#endif
+
 /****************************************************************************
  * Public Data
  ****************************************************************************/
@@ -406,6 +500,15 @@ int umm_trysemaphore(void);
 void umm_givesemaphore(void);
 #endif
 
+/* Functions contained in umm_cache.c ***************************************/
+
+#ifdef CONFIG_MM_UMM_CACHE
+FAR void *umm_cache_malloc(size_t size);
+bool umm_cache_free(FAR void *mem);
+size_t umm_cache_flush(void);
+void umm_cache_getstats(int band, FAR struct umm_cache_stats_s *stats);
+#endif
+
 /* Functions contained in kmm_sem.c ****************************************/
 
 #ifdef CONFIG_MM_KERNEL_HEAP
@@ -582,13 +685,26 @@ int kmm_mallinfo(struct mallinfo *info);
 
 void mm_shrinkchunk(FAR struct mm_heap_s *heap, FAR struct mm_allocnode_s *node, size_t size);
 
-/* Functions contained in mm_addfreechunk.c *********************************/
+/* Functions contained in mm_addfreechunk.c (mm_tlsf.c) *********************/
 
 void mm_addfreechunk(FAR struct mm_heap_s *heap, FAR struct mm_freenode_s *node);
 
+/* Functions contained in mm_delfreechunk.c (mm_tlsf.c) *********************/
+
+void mm_delfreechunk(FAR struct mm_heap_s *heap, FAR struct mm_freenode_s *node);
+
+/* Functions contained in mm_findfreechunk.c (mm_tlsf.c) ********************/
+
+FAR struct mm_freenode_s *mm_findfreechunk(FAR struct mm_heap_s *heap, size_t size);
+#ifdef CONFIG_DEBUG_MM_HEAPPROF
+size_t mm_maxfreechunk(FAR struct mm_heap_s *heap);
+#endif
+
+#ifndef CONFIG_MM_TLSF
 /* Functions contained in mm_size2ndx.c.c ***********************************/
 
 int mm_size2ndx(size_t size);
+#endif
 
 #ifdef CONFIG_DEBUG_MM_HEAPINFO
 /* Functions contained in kmm_mallinfo.c . Used to display memory allocation details */
@@ -601,6 +717,17 @@ void heapinfo_subtract_size(int16_t pid, size_t size);
 void heapinfo_update_total_size(struct mm_heap_s *heap, int size);
 #endif
 
+/* Functions contained in mm_heapprof.c *************************************/
+
+#ifdef CONFIG_DEBUG_MM_HEAPPROF
+void heapprof_record(uint8_t type, FAR struct mm_allocnode_s *node, size_t size);
+void heapprof_getstats(FAR struct heapprof_stats_s *stats);
+int heapprof_getcaller(int index, FAR struct heapprof_caller_s *caller);
+int heapprof_getevent(uint32_t seq, FAR struct heapprof_event_s *event);
+#elif defined(CONFIG_DEBUG_MM_HEAPINFO)
+#define heapprof_record(t, n, s)
+#endif
+
 #ifdef CONFIG_DEBUG_MM_HEAPINFO
 /* Functions to get heap information */
 struct mm_heap_s *mm_get_heap_info(void);
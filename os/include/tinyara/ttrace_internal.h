@@ -68,6 +68,30 @@
 #define TTRACE_INVALID             -1
 #define TTRACE_VALID                0
 
+/* Compact records, used instead of struct trace_packet when
+ * CONFIG_TTRACE_COMPACT is selected.  A record starts with its total length
+ * and its kind, followed by the payload.  In the trace buffer, the driver
+ * inserts after the kind the time elapsed since the previous record, in
+ * trace clock counts, as a varint.  Varints are unsigned LEB128: 7 bits per
+ * byte, least significant first, bit 7 set on all but the last byte.
+ *
+ * SYNC and TASK records are only written by the driver.  SYNC anchors the
+ * trace clock to the system timer: it is written when tracing starts and
+ * finishes and at least every CONFIG_TTRACE_SYNC_TICKS.  TASK names a pid
+ * the first time it appears in the trace.
+ */
+
+#define TTRACE_REC_SYNC             1	/* ticks, usec per tick, records lost: varints; trace clock: 4 bytes LE */
+#define TTRACE_REC_TASK             2	/* pid: varint; name */
+#define TTRACE_REC_BEGIN            3	/* pid: varint; message */
+#define TTRACE_REC_BEGIN_U          4	/* pid: varint; uid */
+#define TTRACE_REC_END              5	/* pid: varint */
+#define TTRACE_REC_SCHED            6	/* prev pid: varint; prev prio; prev state; next pid: varint; next prio */
+
+#define TTRACE_REC_HDR_BYTES        2	/* Length and kind */
+#define TTRACE_REC_MAX_BYTES        (TTRACE_REC_HDR_BYTES + 5 + 3 + TTRACE_MSG_BYTES)
+#define TTRACE_VARINT_MAX_BYTES     5
+
 /****************************************************************************
  * Public Variables
  ****************************************************************************/
@@ -121,6 +145,35 @@ struct trace_packet {        // total 44 byte(message), 12byte(uid)
 	union trace_message msg;   // 32B
 };
 
+/* Append a varint to 'buf' and return the number of bytes written */
+
+static inline int ttrace_putvarint(uint8_t *buf, uint32_t value)
+{
+	int len = 0;
+
+	while (value >= 0x80) {
+		buf[len++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+
+	buf[len++] = (uint8_t)value;
+	return len;
+}
+
+/* Read a varint from 'buf' and return the number of bytes read */
+
+static inline int ttrace_getvarint(const uint8_t *buf, uint32_t *value)
+{
+	int len = 0;
+
+	*value = 0;
+	do {
+		*value |= (uint32_t)(buf[len] & 0x7f) << (7 * len);
+	} while ((buf[len++] & 0x80) != 0 && len < TTRACE_VARINT_MAX_BYTES);
+
+	return len;
+}
+
 static int show_packet(struct trace_packet *packet)
 {
 	int uid = (packet->codelen & TTRACE_CODE_UNIQUE) >> 7;
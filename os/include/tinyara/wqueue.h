@@ -80,6 +80,8 @@
  *   (which runs at the lowest of priority and may not be appropriate
  *   if memory reclamation is of high priority).  If CONFIG_SCHED_HPWORK
  *   is enabled, then the following options can also be used:
+ * CONFIG_SCHED_HPNTHREADS - The number of thread in the high-priority
+ *   queue's thread pool.  Default: 1
  * CONFIG_SCHED_HPWORKPRIORITY - The execution priority of the high-
  *   priority worker thread.  Default: 224
  * CONFIG_SCHED_HPWORKPERIOD - How often the worker thread checks for
@@ -107,6 +109,11 @@
  * CONFIG_SCHED_LPWORKSTACKSIZE - The stack size allocated for the lower
  *   priority worker thread.  Default: 2048.
  *
+ * CONFIG_SCHED_WORKQUEUE_STATS - Record the wait and run time of the work
+ *   of every worker function, shown in /proc/wqueue.
+ * CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS - The number of worker functions
+ *   recorded.  Default: 32
+ *
  * The user-mode work queue is only available in the protected or kernel
  * builds.  This those configurations, the user-mode work queue provides the
  * same (non-standard) facility for use by applications.
@@ -161,6 +168,10 @@
 
 #ifdef CONFIG_SCHED_HPWORK
 
+#ifndef CONFIG_SCHED_HPNTHREADS
+#define CONFIG_SCHED_HPNTHREADS 1
+#endif
+
 #ifndef CONFIG_SCHED_HPWORKPRIORITY
 #define CONFIG_SCHED_HPWORKPRIORITY 224
 #endif
@@ -308,7 +319,33 @@ struct work_s {
 	FAR void *arg;				/* Callback argument */
 	systime_t qtime;			/* Time work queued */
 	systime_t delay;			/* Delay until work performed */
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	uint32_t stime;				/* Statistics clock when queued */
+#endif
+};
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+/* Work queue statistics.  Bucket 0 of the histograms counts the times
+ * below 16 microseconds, bucket n the times from 8 << n microseconds up to
+ * twice that, and the last bucket all the longer times.
+ */
+
+#define WORK_STATS_NBUCKETS      16
+#define WORK_STATS_BUCKET_USEC(n) ((n) == 0 ? 0 : (uint32_t)8 << (n))
+
+/* Statistics of the work of one worker function on one work queue */
+
+struct work_stats_s {
+	worker_t worker;			/* Worker function, NULL for the others */
+	uint8_t qid;				/* Work queue ID */
+	uint32_t count;				/* Number of works run */
+	uint32_t maxlatency;		/* Longest wait once due (usec) */
+	uint32_t maxruntime;		/* Longest run (usec) */
+	uint64_t runtime;			/* Total run time (usec) */
+	uint32_t latency[WORK_STATS_NBUCKETS];	/* Wait once due */
+	uint32_t run[WORK_STATS_NBUCKETS];		/* Run time */
 };
+#endif
 
 /****************************************************************************
  * Public Data
@@ -474,6 +511,55 @@ void lpwork_boostpriority(uint8_t reqprio);
 void lpwork_restorepriority(uint8_t reqprio);
 #endif
 
+/****************************************************************************
+ * Name: work_stats_record
+ *
+ * Description:
+ *   Record the work of one worker function in the work queue statistics.
+ *   This function is used internally by the work logic; it is a system
+ *   call so that the user-mode work queue can record its work too.
+ *
+ * Input parameters:
+ *   qid     - The work queue ID
+ *   worker  - The worker function
+ *   latency - Time the work waited once due (usec)
+ *   runtime - Time the work ran (usec)
+ *
+ * Returned Value:
+ *   None
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+void work_stats_record(int qid, worker_t worker, uint32_t latency, uint32_t runtime);
+
+/****************************************************************************
+ * Name: work_stats_get
+ *
+ * Description:
+ *   Copy entry 'index' of the work queue statistics.  The entry that
+ *   gathers the worker functions that did not fit in the table is at index
+ *   CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS.
+ *
+ * Returned Value:
+ *   Zero on success, -ENOENT if the entry is not used, -EINVAL if 'index'
+ *   is out of range.
+ *
+ ****************************************************************************/
+
+int work_stats_get(int index, FAR struct work_stats_s *stats);
+
+/****************************************************************************
+ * Name: work_stats_reset
+ *
+ * Description:
+ *   Clear the work queue statistics.
+ *
+ ****************************************************************************/
+
+void work_stats_reset(void);
+#endif
+
 #undef EXTERN
 #ifdef __cplusplus
 }
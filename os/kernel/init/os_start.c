@@ -180,6 +180,14 @@ volatile sq_queue_t g_delayed_kfree;
 
 volatile pid_t g_lastpid;
 
+#ifdef CONFIG_MM_KMEM_CACHE
+/* This is the cache from which task_create() and kernel_thread() allocate
+ * task TCBs.
+ */
+
+FAR struct kmem_cache_s *g_tcbcache;
+#endif
+
 /* The following hash table is used for two things:
  *
  * 1. This hash table greatly speeds the determination of
@@ -393,6 +401,13 @@ void os_start(void)
 	}
 #endif
 
+#ifdef CONFIG_MM_KMEM_CACHE
+	/* Create the cache of task TCBs */
+
+	g_tcbcache = kmem_cache_create("tcb", sizeof(struct task_tcb_s), CONFIG_MM_KMEM_CACHE_NTCBS, KMEM_CACHE_OVERFLOW, NULL);
+	DEBUGASSERT(g_tcbcache);
+#endif
+
 #if defined(CONFIG_SCHED_HAVE_PARENT) && defined(CONFIG_SCHED_CHILD_STATUS)
 	/* Initialize tasking data structures */
 
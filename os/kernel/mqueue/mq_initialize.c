@@ -57,6 +57,7 @@
 #include <tinyara/config.h>
 
 #include <stdint.h>
+#include <assert.h>
 #include <queue.h>
 #include <tinyara/kmalloc.h>
 
@@ -101,6 +102,14 @@ sq_queue_t g_msgfreeirq;
 
 sq_queue_t g_desfree;
 
+#ifdef CONFIG_MM_KMEM_CACHE
+/* The g_msgqcache is the cache from which message queue structures are
+ * allocated.
+ */
+
+FAR struct kmem_cache_s *g_msgqcache;
+#endif
+
 /************************************************************************
  * Private Variables
  ************************************************************************/
@@ -200,6 +209,13 @@ void mq_initialize(void)
 	/* Allocate a block of message queue descriptors */
 
 	mq_desblockalloc();
+
+#ifdef CONFIG_MM_KMEM_CACHE
+	/* Create the cache of message queue structures */
+
+	g_msgqcache = kmem_cache_create("mqueue", sizeof(struct mqueue_inode_s), CONFIG_MM_KMEM_CACHE_NMSGQS, KMEM_CACHE_OVERFLOW, NULL);
+	DEBUGASSERT(g_msgqcache);
+#endif
 }
 
 /************************************************************************
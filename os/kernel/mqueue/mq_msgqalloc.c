@@ -124,7 +124,11 @@ FAR struct mqueue_inode_s *mq_msgqalloc(mode_t mode, FAR struct mq_attr *attr)
 
 	/* Allocate memory for the new message queue. */
 
+#ifdef CONFIG_MM_KMEM_CACHE
+	msgq = (FAR struct mqueue_inode_s *)kmem_cache_zalloc(g_msgqcache);
+#else
 	msgq = (FAR struct mqueue_inode_s *)kmm_zalloc(sizeof(struct mqueue_inode_s));
+#endif
 
 	if (msgq) {
 		/* Initialize the new named message queue */
@@ -120,5 +120,12 @@ void mq_msgqfree(FAR struct mqueue_inode_s *msgq)
 
 	/* Then deallocate the message queue itself */
 
-	sched_kfree(msgq);
+#ifdef CONFIG_MM_KMEM_CACHE
+	if (kmem_cache_member(g_msgqcache, msgq)) {
+		kmem_cache_free(g_msgqcache, msgq);
+	} else
+#endif
+	{
+		sched_kfree(msgq);
+	}
 }
@@ -69,6 +69,7 @@
 #include <signal.h>
 
 #include <tinyara/mqueue.h>
+#include <tinyara/mm/kmem_cache.h>
 
 #if !defined(CONFIG_DISABLE_MQUEUE) && CONFIG_MQ_MAXMSGSIZE > 0
 
@@ -146,6 +147,14 @@ EXTERN sq_queue_t g_msgfreeirq;
 
 EXTERN sq_queue_t g_desfree;
 
+#ifdef CONFIG_MM_KMEM_CACHE
+/* The g_msgqcache is the cache from which message queue structures are
+ * allocated.
+ */
+
+EXTERN FAR struct kmem_cache_s *g_msgqcache;
+#endif
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -65,6 +65,7 @@
 #include <sched.h>
 
 #include <tinyara/kmalloc.h>
+#include <tinyara/mm/kmem_cache.h>
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -209,6 +210,14 @@ extern volatile sq_queue_t g_delayed_kfree;
 
 extern volatile pid_t g_lastpid;
 
+#ifdef CONFIG_MM_KMEM_CACHE
+/* This is the cache from which task_create() and kernel_thread() allocate
+ * task TCBs.
+ */
+
+extern FAR struct kmem_cache_s *g_tcbcache;
+#endif
+
 /* The following hash table is used for two things:
  *
  * 1. This hash table greatly speeds the determination of a new unique
@@ -215,7 +215,14 @@ int sched_releasetcb(FAR struct tcb_s *tcb, uint8_t ttype)
 
 		/* And, finally, release the TCB itself */
 
-		sched_kfree(tcb);
+#ifdef CONFIG_MM_KMEM_CACHE
+		if (kmem_cache_member(g_tcbcache, tcb)) {
+			kmem_cache_free(g_tcbcache, tcb);
+		} else
+#endif
+		{
+			sched_kfree(tcb);
+		}
 	}
 
 	return ret;
@@ -129,7 +129,11 @@ static int thread_create(FAR const char *name, uint8_t ttype, int priority, int
 
 	/* Allocate a TCB for the new task. */
 
+#ifdef CONFIG_MM_KMEM_CACHE
+	tcb = (FAR struct task_tcb_s *)kmem_cache_zalloc(g_tcbcache);
+#else
 	tcb = (FAR struct task_tcb_s *)kmm_zalloc(sizeof(struct task_tcb_s));
+#endif
 	if (!tcb) {
 		sdbg("ERROR: Failed to allocate TCB\n");
 		errcode = ENOMEM;
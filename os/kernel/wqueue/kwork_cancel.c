@@ -111,7 +111,9 @@
 
 static int work_qcancel(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *work)
 {
+#ifndef CONFIG_SCHED_WORKQUEUE_WHEEL
 	struct work_s *cur_work;
+#endif
 	irqstate_t flags;
 	int ret = -ENOENT;
 
@@ -123,6 +125,17 @@ static int work_qcancel(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *wo
 	 */
 
 	flags = irqsave();
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	/* Queued work has a worker, so it is in the ready list or in the timer
+	 * wheel.
+	 */
+
+	if (work->worker != NULL) {
+		work_wheel_remove(wqueue, work);
+		work->worker = NULL;
+		ret = OK;
+	}
+#else
 	if (work->worker != NULL) {
 		/* A little test of the integrity of the work queue */
 
@@ -150,6 +163,7 @@ static int work_qcancel(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *wo
 		work->worker = NULL;
 		ret = OK;
 	}
+#endif
 
 	irqrestore(flags);
 	return ret;
@@ -56,6 +56,8 @@
 
 #include <tinyara/config.h>
 
+#include <unistd.h>
+#include <sched.h>
 #include <errno.h>
 #include <queue.h>
 #include <debug.h>
@@ -121,9 +123,37 @@ struct hp_wqueue_s g_hpwork;
 
 static int work_hpthread(int argc, char *argv[])
 {
+#if CONFIG_SCHED_HPNTHREADS > 1
+	int wndx;
+	pid_t me = getpid();
+	int i;
+
+	/* Find out thread index by search the workers in g_hpwork */
+
+	for (wndx = 0, i = 0; i < CONFIG_SCHED_HPNTHREADS; i++) {
+		if (g_hpwork.worker[i].pid == me) {
+			wndx = i;
+			break;
+		}
+	}
+
+	DEBUGASSERT(i < CONFIG_SCHED_HPNTHREADS);
+#endif
+
 	/* Loop forever */
 
 	for (;;) {
+#if CONFIG_SCHED_HPNTHREADS > 1
+		/* Only thread 0 polls the queue and performs garbage collection.
+		 * The other threads run work when they are signalled.
+		 */
+
+		if (wndx > 0) {
+			work_process((FAR struct kwork_wqueue_s *)&g_hpwork, 0, wndx);
+			continue;
+		}
+#endif
+
 #ifndef CONFIG_SCHED_LPWORK
 		/* First, perform garbage collection.  This cleans-up memory
 		 * de-allocations that were queued because they could not be freed in
@@ -172,30 +202,49 @@ static int work_hpthread(int argc, char *argv[])
 int work_hpstart(void)
 {
 	int pid;
+	int wndx;
 
 	/* Initialize work queue data structures */
 
 	g_hpwork.delay = CONFIG_SCHED_HPWORKPERIOD / USEC_PER_TICK;
 	dq_init(&g_hpwork.q);
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	g_hpwork.nworkers = CONFIG_SCHED_HPNTHREADS;
+	g_hpwork.tick = clock_systimer();
+#endif
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	work_stats_initialize();
+#endif
+
+	/* Don't permit any of the threads to run until we have fully initialized
+	 * g_hpwork.
+	 */
+
+	sched_lock();
+
+	/* Start the high-priority, kernel mode worker thread(s) */
 
-	/* Start the high-priority, kernel mode worker thread */
+	svdbg("Starting high-priority kernel worker thread(s)\n");
 
-	svdbg("Starting high-priority kernel worker thread\n");
+	for (wndx = 0; wndx < CONFIG_SCHED_HPNTHREADS; wndx++) {
+		pid = kernel_thread(HPWORKNAME, CONFIG_SCHED_HPWORKPRIORITY, CONFIG_SCHED_HPWORKSTACKSIZE, (main_t)work_hpthread, (FAR char *const *)NULL);
 
-	pid = kernel_thread(HPWORKNAME, CONFIG_SCHED_HPWORKPRIORITY, CONFIG_SCHED_HPWORKSTACKSIZE, (main_t)work_hpthread, (FAR char *const *)NULL);
+		DEBUGASSERT(pid > 0);
+		if (pid < 0) {
+			int errcode = errno;
+			DEBUGASSERT(errcode > 0);
 
-	DEBUGASSERT(pid > 0);
-	if (pid < 0) {
-		int errcode = errno;
-		DEBUGASSERT(errcode > 0);
+			slldbg("kernel_thread %d failed: %d\n", wndx, errcode);
+			sched_unlock();
+			return -errcode;
+		}
 
-		slldbg("kernel_thread failed: %d\n", errcode);
-		return -errcode;
+		g_hpwork.worker[wndx].pid = (pid_t)pid;
+		g_hpwork.worker[wndx].busy = true;
 	}
 
-	g_hpwork.worker[0].pid = pid;
-	g_hpwork.worker[0].busy = true;
-	return pid;
+	sched_unlock();
+	return g_hpwork.worker[0].pid;
 }
 
 #endif							/* CONFIG_SCHED_HPWORK */
@@ -212,6 +212,13 @@ int work_lpstart(void)
 
 	g_lpwork.delay = CONFIG_SCHED_LPWORKPERIOD / USEC_PER_TICK;
 	dq_init(&g_lpwork.q);
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	g_lpwork.nworkers = CONFIG_SCHED_LPNTHREADS;
+	g_lpwork.tick = clock_systimer();
+#endif
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	work_stats_initialize();
+#endif
 
 	/* Don't permit any of the threads to run until we have fully initialized
 	 * g_lpwork.
@@ -61,6 +61,7 @@
 #include <assert.h>
 #include <queue.h>
 
+#include <tinyara/arch.h>
 #include <tinyara/clock.h>
 #include <tinyara/wqueue.h>
 
@@ -137,6 +138,10 @@ void work_process(FAR struct kwork_wqueue_s *wqueue, uint32_t period, int wndx)
 	systime_t stick;
 	systime_t ctick;
 	systime_t next;
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	struct work_stamp_s start;
+	uint32_t latency;
+#endif
 
 	/* Then process queued work.  We need to keep interrupts disabled while
 	 * we process items in the work list.
@@ -184,6 +189,9 @@ void work_process(FAR struct kwork_wqueue_s *wqueue, uint32_t period, int wndx)
 				/* Extract the work argument (before re-enabling interrupts) */
 
 				arg = work->arg;
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+				latency = work_stats_begin((FAR struct work_s *)work, &start);
+#endif
 
 				/* Mark the work as no longer being queued */
 
@@ -195,6 +203,9 @@ void work_process(FAR struct kwork_wqueue_s *wqueue, uint32_t period, int wndx)
 
 				irqrestore(flags);
 				worker(arg);
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+				work_stats_end(wqueue, worker, latency, &start);
+#endif
 
 				/* Now, unfortunately, since we re-enabled interrupts we don't
 				 * know the state of the work list and we will have to start
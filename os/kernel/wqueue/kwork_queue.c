@@ -120,6 +120,33 @@
 
 static int work_qqueue(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *work, worker_t worker, FAR void *arg, uint32_t delay)
 {
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	irqstate_t flags;
+	DEBUGASSERT(work != NULL);
+
+	flags = irqsave();
+
+	/* Queued work has a worker until it is run or cancelled */
+
+	if (work->worker != NULL) {
+		irqrestore(flags);
+		return -EALREADY;
+	}
+
+	work->worker = worker;		/* Work callback */
+	work->arg = arg;			/* Callback argument */
+	work->delay = delay;		/* Delay until work performed */
+	work->qtime = clock_systimer();	/* Time work queued */
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	work->stime = work_stats_clock();
+#endif
+
+	work_wheel_add(wqueue, work);
+
+	irqrestore(flags);
+
+	return OK;
+#else
 	struct work_s *cur_work;
 	struct work_s *next_work;
 	irqstate_t flags;
@@ -147,6 +174,9 @@ static int work_qqueue(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *wor
 	work->arg = arg;			/* Callback argument */
 	work->delay = delay;		/* Delay until work performed */
 	work->qtime = clock_systimer();	/* Time work queued */
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	work->stime = work_stats_clock();
+#endif
 
 #ifdef CONFIG_SCHED_WORKQUEUE_SORTING
 	if (next_work) {
@@ -161,6 +191,7 @@ static int work_qqueue(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *wor
 	irqrestore(flags);
 
 	return OK;
+#endif
 }
 #endif
 
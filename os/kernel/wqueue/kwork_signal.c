@@ -93,7 +93,19 @@ int work_signal(int qid)
 
 #ifdef CONFIG_SCHED_HPWORK
 	if (qid == HPWORK) {
-		pid = g_hpwork.worker[0].pid;
+		int wndx;
+		int i;
+
+		/* Find an IDLE worker thread */
+
+		for (wndx = 0, i = 0; i < CONFIG_SCHED_HPNTHREADS; i++) {
+			if (!g_hpwork.worker[i].busy) {
+				wndx = i;
+				break;
+			}
+		}
+
+		pid = g_hpwork.worker[wndx].pid;
 	} else
 #endif
 #ifdef CONFIG_SCHED_LPWORK
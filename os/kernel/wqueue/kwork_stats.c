@@ -0,0 +1,329 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * kernel/wqueue/kwork_stats.c
+ *
+ * Work queue statistics.  The work run by the work queues is recorded per
+ * worker function and work queue in an open-addressed table; the work of
+ * the functions that do not fit in the table is recorded in one extra
+ * entry.  Entries are only added, until the statistics are reset.
+ *
+ * With a cycle counter, times shorter than WORK_STATS_SPAN ticks are
+ * measured in cycles and converted with the number of cycles per tick,
+ * which is calibrated against the system tick as work is recorded.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <tinyara/arch.h>
+#include <tinyara/clock.h>
+#include <tinyara/wqueue.h>
+
+#include <arch/irq.h>
+
+#include "wqueue/wqueue.h"
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define WORK_STATS_NENTRIES  (CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS + 1)
+#define WORK_STATS_OTHERS    CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS
+
+/* Times measured in cycles and the calibration period stay below one
+ * second, and two seconds, so that the 32-bit counter cannot wrap around
+ * below 2GHz.
+ */
+
+#define WORK_STATS_SPAN      (USEC_PER_SEC / USEC_PER_TICK > 0 ? USEC_PER_SEC / USEC_PER_TICK : 1)
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct work_stats_s g_workstats[WORK_STATS_NENTRIES];
+
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+/* Cycles per tick, zero until calibrated */
+
+static uint32_t g_cyclespertick;
+static struct work_stamp_s g_calibration;
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: work_stats_ticks
+ *
+ * Description:
+ *   Convert a number of system ticks to microseconds.
+ *
+ ****************************************************************************/
+
+static uint32_t work_stats_ticks(systime_t ticks)
+{
+	return ticks > UINT32_MAX / USEC_PER_TICK ? UINT32_MAX : (uint32_t)ticks * USEC_PER_TICK;
+}
+
+/****************************************************************************
+ * Name: work_stats_usec
+ *
+ * Description:
+ *   Convert a time of 'clock' units of the statistics clock, and of 'ticks'
+ *   system ticks, to microseconds.
+ *
+ ****************************************************************************/
+
+static uint32_t work_stats_usec(uint32_t clock, systime_t ticks)
+{
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+	if (ticks < WORK_STATS_SPAN && g_cyclespertick > 0) {
+		return (uint32_t)((uint64_t)clock * USEC_PER_TICK / g_cyclespertick);
+	}
+#endif
+
+	return work_stats_ticks(ticks);
+}
+
+/****************************************************************************
+ * Name: work_stats_calibrate
+ *
+ * Description:
+ *   Count the cycles of the last period of WORK_STATS_SPAN to twice that
+ *   ticks.  Must be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+static void work_stats_calibrate(void)
+{
+	systime_t now = clock_systimer();
+	uint32_t cycles = up_perf_gettime();
+	systime_t elapsed = now - g_calibration.tick;
+
+	if (elapsed >= WORK_STATS_SPAN) {
+		if (elapsed < 2 * WORK_STATS_SPAN) {
+			g_cyclespertick = (cycles - g_calibration.clock) / elapsed;
+		}
+
+		g_calibration.tick = now;
+		g_calibration.clock = cycles;
+	}
+}
+#endif
+
+/****************************************************************************
+ * Name: work_stats_bucket
+ ****************************************************************************/
+
+static int work_stats_bucket(uint32_t usec)
+{
+	int bucket = 0;
+
+	/* Bucket n holds the times from 8 << n microseconds */
+
+	usec >>= 3;
+	while (usec > 1 && bucket < WORK_STATS_NBUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/****************************************************************************
+ * Name: work_stats_find
+ *
+ * Description:
+ *   Return the entry of 'worker' on work queue 'qid', adding it if there is
+ *   room.  Must be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+static FAR struct work_stats_s *work_stats_find(int qid, worker_t worker)
+{
+	FAR struct work_stats_s *stats;
+	unsigned int ndx;
+	int i;
+
+	ndx = (((uintptr_t)worker >> 2) ^ qid) % CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS;
+	for (i = 0; i < CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS; i++) {
+		stats = &g_workstats[ndx];
+		if (stats->worker == NULL) {
+			stats->worker = worker;
+			stats->qid = qid;
+			return stats;
+		}
+
+		if (stats->worker == worker && stats->qid == qid) {
+			return stats;
+		}
+
+		if (++ndx >= CONFIG_SCHED_WORKQUEUE_STATS_NWORKERS) {
+			ndx = 0;
+		}
+	}
+
+	return &g_workstats[WORK_STATS_OTHERS];
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: work_stats_initialize
+ ****************************************************************************/
+
+void work_stats_initialize(void)
+{
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+	up_perf_init();
+#endif
+}
+
+/****************************************************************************
+ * Name: work_stats_begin
+ ****************************************************************************/
+
+uint32_t work_stats_begin(FAR struct work_s *work, FAR struct work_stamp_s *start)
+{
+	systime_t elapsed;
+	uint32_t latency;
+
+	start->clock = work_stats_clock();
+	start->tick = clock_systimer();
+
+	/* Delayed work has waited since its expiry tick, other work since it
+	 * was queued.  Delayed work moved to the ready list of the timer wheel
+	 * has its expiry tick in qtime and the time it was moved in stime, so
+	 * that it waited at least since then and the ticks elapsed since its
+	 * expiry tick, but one.
+	 */
+
+	elapsed = start->tick - work->qtime;
+	if (work->delay > 0) {
+		return work_stats_ticks(elapsed - work->delay);
+	}
+
+	latency = work_stats_usec(start->clock - work->stime, elapsed);
+	if (elapsed > 1 && work_stats_ticks(elapsed - 1) > latency) {
+		latency = work_stats_ticks(elapsed - 1);
+	}
+
+	return latency;
+}
+
+/****************************************************************************
+ * Name: work_stats_end
+ ****************************************************************************/
+
+void work_stats_end(FAR struct kwork_wqueue_s *wqueue, worker_t worker, uint32_t latency, FAR const struct work_stamp_s *start)
+{
+	uint32_t runtime;
+	int qid;
+
+	runtime = work_stats_usec(work_stats_clock() - start->clock, clock_systimer() - start->tick);
+
+#ifdef CONFIG_SCHED_HPWORK
+	qid = wqueue == (FAR struct kwork_wqueue_s *)&g_hpwork ? HPWORK : LPWORK;
+#else
+	qid = LPWORK;
+#endif
+
+	work_stats_record(qid, worker, latency, runtime);
+}
+
+/****************************************************************************
+ * Name: work_stats_record
+ ****************************************************************************/
+
+void work_stats_record(int qid, worker_t worker, uint32_t latency, uint32_t runtime)
+{
+	FAR struct work_stats_s *stats;
+	irqstate_t flags;
+
+	flags = irqsave();
+
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+	work_stats_calibrate();
+#endif
+
+	stats = work_stats_find(qid, worker);
+	stats->count++;
+	stats->runtime += runtime;
+	stats->latency[work_stats_bucket(latency)]++;
+	stats->run[work_stats_bucket(runtime)]++;
+
+	if (latency > stats->maxlatency) {
+		stats->maxlatency = latency;
+	}
+
+	if (runtime > stats->maxruntime) {
+		stats->maxruntime = runtime;
+	}
+
+	irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: work_stats_get
+ ****************************************************************************/
+
+int work_stats_get(int index, FAR struct work_stats_s *stats)
+{
+	irqstate_t flags;
+
+	if (index < 0 || index >= WORK_STATS_NENTRIES) {
+		return -EINVAL;
+	}
+
+	flags = irqsave();
+	memcpy(stats, &g_workstats[index], sizeof(struct work_stats_s));
+	irqrestore(flags);
+
+	return stats->count > 0 ? OK : -ENOENT;
+}
+
+/****************************************************************************
+ * Name: work_stats_reset
+ ****************************************************************************/
+
+void work_stats_reset(void)
+{
+	irqstate_t flags;
+
+	flags = irqsave();
+	memset(g_workstats, 0, sizeof(g_workstats));
+	irqrestore(flags);
+}
+
+#endif							/* CONFIG_SCHED_WORKQUEUE_STATS */
@@ -0,0 +1,327 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * kernel/wqueue/kwork_wheel.c
+ *
+ * Work processing with a timer wheel.  Delayed work is hashed by its expiry
+ * tick into CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE slots; work delayed by more
+ * ticks than there are slots stays in its slot for as many turns of the
+ * wheel.  When the worker threads wake up, the work of the slots of the
+ * elapsed ticks that is due is moved to the ready list 'q', from which all
+ * the worker threads of the queue take work in order.
+ *
+ * Work in the ready list has a delay of zero, so that work_wheel_remove()
+ * knows which list holds it.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include <assert.h>
+#include <queue.h>
+
+#include <tinyara/arch.h>
+#include <tinyara/clock.h>
+#include <tinyara/wqueue.h>
+
+#include <arch/irq.h>
+
+#include "wqueue/wqueue.h"
+
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: work_wheel_expire
+ *
+ * Description:
+ *   Move the delayed work that is due at tick 'now' to the ready list.
+ *   Only the slots of the ticks elapsed since the last call are visited,
+ *   all of them at most.  Must be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+static void work_wheel_expire(FAR struct kwork_wqueue_s *wqueue, systime_t now)
+{
+	FAR struct work_s *work;
+	FAR struct work_s *next;
+	FAR struct dq_queue_s *slot;
+	systime_t nslots;
+	systime_t i;
+
+	nslots = now - wqueue->tick + 1;
+	if (nslots == 0 || nslots > (systime_t)-1 / 2) {
+		/* This tick was already expired */
+
+		return;
+	}
+
+	if (nslots > CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE) {
+		nslots = CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE;
+	}
+
+	for (i = 0; i < nslots && wqueue->ndelayed > 0; i++) {
+		slot = &wqueue->wheel[WORK_WHEEL_SLOT(wqueue->tick + i)];
+		for (work = (FAR struct work_s *)slot->head; work != NULL; work = next) {
+			next = (FAR struct work_s *)work->dq.flink;
+
+			/* Work of later turns of the wheel stays in the slot */
+
+			if (now - work->qtime >= work->delay) {
+				dq_rem((FAR dq_entry_t *)work, slot);
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+				work->qtime += work->delay;
+				work->stime = work_stats_clock();
+#endif
+				work->delay = 0;
+				dq_addlast((FAR dq_entry_t *)work, &wqueue->q);
+				wqueue->ndelayed--;
+			}
+		}
+	}
+
+	wqueue->tick = now + 1;
+}
+
+/****************************************************************************
+ * Name: work_wheel_next
+ *
+ * Description:
+ *   Return the number of ticks until the first non-empty slot of the timer
+ *   wheel, or zero if there is no delayed work.  The work of that slot may
+ *   belong to a later turn, in which case the worker wakes up early.  Must
+ *   be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+static systime_t work_wheel_next(FAR struct kwork_wqueue_s *wqueue, systime_t now)
+{
+	systime_t i;
+
+	if (wqueue->ndelayed == 0) {
+		return 0;
+	}
+
+	for (i = 0; i < CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE; i++) {
+		if (!dq_empty(&wqueue->wheel[WORK_WHEEL_SLOT(wqueue->tick + i)])) {
+			break;
+		}
+	}
+
+	/* wqueue->tick is at most now + 1 */
+
+	return wqueue->tick + i - now;
+}
+
+/****************************************************************************
+ * Name: work_wheel_wakeup
+ *
+ * Description:
+ *   Wake up an idle worker thread, other than the caller, to take work
+ *   from the ready list.
+ *
+ ****************************************************************************/
+
+static void work_wheel_wakeup(FAR struct kwork_wqueue_s *wqueue, int wndx)
+{
+	int i;
+
+	for (i = 0; i < wqueue->nworkers; i++) {
+		if (i != wndx && !wqueue->worker[i].busy) {
+			/* Mark it busy so that it is not signalled twice */
+
+			wqueue->worker[i].busy = true;
+			(void)kill(wqueue->worker[i].pid, SIGWORK);
+			break;
+		}
+	}
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: work_wheel_add
+ *
+ * Description:
+ *   Add work to the ready list if it has no delay, to the timer wheel
+ *   otherwise.  Must be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+void work_wheel_add(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *work)
+{
+	if (work->delay == 0) {
+		dq_addlast((FAR dq_entry_t *)work, &wqueue->q);
+	} else {
+		/* The expiry tick is after the last tick that was expired */
+
+		dq_addlast((FAR dq_entry_t *)work, &wqueue->wheel[WORK_WHEEL_SLOT(work->qtime + work->delay)]);
+		wqueue->ndelayed++;
+	}
+}
+
+/****************************************************************************
+ * Name: work_wheel_remove
+ *
+ * Description:
+ *   Remove queued work from the ready list or from the timer wheel.  Must
+ *   be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+void work_wheel_remove(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *work)
+{
+	if (work->delay == 0) {
+		dq_rem((FAR dq_entry_t *)work, &wqueue->q);
+	} else {
+		dq_rem((FAR dq_entry_t *)work, &wqueue->wheel[WORK_WHEEL_SLOT(work->qtime + work->delay)]);
+		wqueue->ndelayed--;
+	}
+}
+
+/****************************************************************************
+ * Name: work_process
+ *
+ * Description:
+ *   This is the logic that performs actions placed on any work list.  This
+ *   logic is the common underlying logic to all work queues.  This logic is
+ *   part of the internal implementation of each work queue; it should not
+ *   be called from application level logic.
+ *
+ *   The worker runs the ready work, expiring the delayed work as time
+ *   passes, then waits.  Worker 0 wakes up at least every 'period' ticks.
+ *   While worker 0 is busy, the other workers wait for the next delayed
+ *   work to expire; otherwise they wait until signalled.
+ *
+ * Input parameters:
+ *   wqueue - Describes the work queue to be processed
+ *   period - The polling period in clock ticks, zero to wait for a signal
+ *   wndx   - The worker thread index
+ *
+ * Returned Value:
+ *   None
+ *
+ ****************************************************************************/
+
+void work_process(FAR struct kwork_wqueue_s *wqueue, uint32_t period, int wndx)
+{
+	FAR struct work_s *work;
+	worker_t worker;
+	irqstate_t flags;
+	FAR void *arg;
+	systime_t next;
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+	struct work_stamp_s start;
+	uint32_t latency;
+#endif
+
+	flags = irqsave();
+
+	for (;;) {
+		work_wheel_expire(wqueue, clock_systimer());
+
+		work = (FAR struct work_s *)dq_remfirst(&wqueue->q);
+		if (work == NULL) {
+			break;
+		}
+
+		/* Extract the work description from the entry (in case the work
+		 * instance will be re-used after it has been de-queued) and mark
+		 * the work as no longer being queued.
+		 */
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+		latency = work_stats_begin(work, &start);
+#endif
+		worker = work->worker;
+		arg = work->arg;
+		work->worker = NULL;
+
+		/* Let another worker take the rest of the ready work, or stand in
+		 * for worker 0 while it is busy.
+		 */
+
+		if (!dq_empty(&wqueue->q) || (wndx == 0 && wqueue->ndelayed > 0)) {
+			work_wheel_wakeup(wqueue, wndx);
+		}
+
+		/* Do the work.  Re-enable interrupts while the work is being
+		 * performed... we don't have any idea how long this will take!
+		 */
+
+		irqrestore(flags);
+		worker(arg);
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+		work_stats_end(wqueue, worker, latency, &start);
+#endif
+		flags = irqsave();
+	}
+
+	if (period == 0 && wqueue->worker[0].busy && wndx != 0) {
+		/* Stand in for worker 0 to expire the delayed work */
+
+		period = wqueue->delay;
+	}
+
+	next = work_wheel_next(wqueue, clock_systimer());
+	if (period > 0) {
+		next = next > 0 ? MIN(next, period) : period;
+	}
+
+	wqueue->worker[wndx].busy = false;
+	if (next == 0) {
+		sigset_t set;
+
+		/* Wait indefinitely until signalled with SIGWORK */
+
+		sigemptyset(&set);
+		sigaddset(&set, SIGWORK);
+		DEBUGVERIFY(sigwaitinfo(&set, NULL));
+	} else {
+		/* Wait until the next work expires or until we are awakened by a
+		 * signal.  Interrupts will be re-enabled while we wait.
+		 */
+
+		usleep(next * USEC_PER_TICK);
+	}
+
+	wqueue->worker[wndx].busy = true;
+	irqrestore(flags);
+}
+
+#endif							/* CONFIG_SCHED_WORKQUEUE_WHEEL */
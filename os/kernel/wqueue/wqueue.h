@@ -74,9 +74,37 @@
 #define HPWORKNAME "hpwork"
 #define LPWORKNAME "lpwork"
 
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+#if CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE & (CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE - 1)
+#error "CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE should be power of 2"
+#endif
+
+#define WORK_WHEEL_MASK     (CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE - 1)
+#define WORK_WHEEL_SLOT(t)  ((t) & WORK_WHEEL_MASK)
+#endif
+
+/* The statistics clock is the cycle counter if there is one */
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+#ifdef CONFIG_ARCH_HAVE_PERF_EVENTS
+#define work_stats_clock()  up_perf_gettime()
+#else
+#define work_stats_clock()  ((uint32_t)clock_systimer())
+#endif
+#endif
+
 /****************************************************************************
  * Public Type Definitions
  ****************************************************************************/
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+/* A point in time for the work queue statistics */
+
+struct work_stamp_s {
+	systime_t tick;				/* System tick */
+	uint32_t clock;				/* Statistics clock */
+};
+#endif
+
 /* This represents one worker */
 
 struct kworker_s {
@@ -89,6 +117,12 @@ struct kworker_s {
 struct kwork_wqueue_s {
 	uint32_t delay;				/* Delay between polling cycles (ticks) */
 	struct dq_queue_s q;		/* The queue of pending work */
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	uint8_t nworkers;			/* Number of worker threads */
+	uint16_t ndelayed;			/* Number of works in the timer wheel */
+	systime_t tick;				/* Next tick of the timer wheel to expire */
+	struct dq_queue_s wheel[CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE];
+#endif
 	struct kworker_s worker[1];	/* Describes a worker thread */
 };
 
@@ -100,7 +134,16 @@ struct kwork_wqueue_s {
 struct hp_wqueue_s {
 	uint32_t delay;				/* Delay between polling cycles (ticks) */
 	struct dq_queue_s q;		/* The queue of pending work */
-	struct kworker_s worker[1];	/* Describes the single high priority worker */
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	uint8_t nworkers;			/* Number of worker threads */
+	uint16_t ndelayed;			/* Number of works in the timer wheel */
+	systime_t tick;				/* Next tick of the timer wheel to expire */
+	struct dq_queue_s wheel[CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE];
+#endif
+
+	/* Describes each thread in the high priority queue's thread pool */
+
+	struct kworker_s worker[CONFIG_SCHED_HPNTHREADS];
 };
 #endif
 
@@ -112,6 +155,12 @@ struct hp_wqueue_s {
 struct lp_wqueue_s {
 	uint32_t delay;				/* Delay between polling cycles (ticks) */
 	struct dq_queue_s q;		/* The queue of pending work */
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+	uint8_t nworkers;			/* Number of worker threads */
+	uint16_t ndelayed;			/* Number of works in the timer wheel */
+	systime_t tick;				/* Next tick of the timer wheel to expire */
+	struct dq_queue_s wheel[CONFIG_SCHED_WORKQUEUE_WHEEL_SIZE];
+#endif
 
 	/* Describes each thread in the low priority queue's thread pool */
 
@@ -198,5 +247,63 @@ int work_lpstart(void);
 
 void work_process(FAR struct kwork_wqueue_s *wqueue, uint32_t period, int wndx);
 
+/****************************************************************************
+ * Name: work_wheel_add
+ *
+ * Description:
+ *   Add work to the ready list if it has no delay, to the timer wheel
+ *   otherwise.  Must be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_WORKQUEUE_WHEEL
+void work_wheel_add(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *work);
+
+/****************************************************************************
+ * Name: work_wheel_remove
+ *
+ * Description:
+ *   Remove queued work from the ready list or from the timer wheel.  Must
+ *   be called with interrupts disabled.
+ *
+ ****************************************************************************/
+
+void work_wheel_remove(FAR struct kwork_wqueue_s *wqueue, FAR struct work_s *work);
+#endif
+
+/****************************************************************************
+ * Name: work_stats_initialize
+ *
+ * Description:
+ *   Start the statistics clock.  Called when each work queue is started.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+void work_stats_initialize(void);
+
+/****************************************************************************
+ * Name: work_stats_begin
+ *
+ * Description:
+ *   Take the time at which 'work' starts to run and return how long it
+ *   waited once due, in microseconds.  Must be called with interrupts
+ *   disabled, before the work is marked as no longer queued.
+ *
+ ****************************************************************************/
+
+uint32_t work_stats_begin(FAR struct work_s *work, FAR struct work_stamp_s *start);
+
+/****************************************************************************
+ * Name: work_stats_end
+ *
+ * Description:
+ *   Record the work of 'worker' on 'wqueue' that started at 'start'.
+ *
+ ****************************************************************************/
+
+void work_stats_end(FAR struct kwork_wqueue_s *wqueue, worker_t worker, uint32_t latency, FAR const struct work_stamp_s *start);
+#endif
+
 #endif							/* CONFIG_SCHED_WORKQUEUE */
 #endif							/* __SCHED_WQUEUE_WQUEUE_H */
@@ -0,0 +1,356 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/mm_gran/mm_kmemcache.c
+ *
+ * Fixed-size object caches.  Every cache owns one kernel heap block that
+ * is handed to a private granule allocator.  The granule size is chosen so
+ * that an object spans at most KMEM_CACHE_MAXGRANS granules, which bounds
+ * both the quantization waste and the bitmap search.  Since all
+ * allocations from a pool have the same size, freed slots can always be
+ * reused and the pool never fragments.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <arch/irq.h>
+#include <tinyara/kmalloc.h>
+#include <tinyara/mm/gran.h>
+#include <tinyara/mm/kmem_cache.h>
+
+#ifdef CONFIG_MM_KMEM_CACHE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Objects are aligned to 8 bytes and span at most this many granules */
+
+#define KMEM_CACHE_LOG2ALIGN  3
+#define KMEM_CACHE_MAXGRANS   8
+
+#define KMEM_CACHE_ALIGN_UP(a) \
+	(((a) + (1 << KMEM_CACHE_LOG2ALIGN) - 1) & ~((1 << KMEM_CACHE_LOG2ALIGN) - 1))
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* List of all caches, most recently created first */
+
+static FAR struct kmem_cache_s *g_kmem_caches;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: kmem_cache_common_alloc
+ *
+ * Description:
+ *   Allocate one object from the pool or, if allowed, from the kernel heap.
+ *
+ ****************************************************************************/
+
+static FAR void *kmem_cache_common_alloc(FAR struct kmem_cache_s *cache, bool zero)
+{
+	FAR void *obj;
+	irqstate_t flags;
+
+	DEBUGASSERT(cache);
+
+	obj = gran_alloc(cache->gran, cache->slotsize);
+
+	flags = irqsave();
+	if (obj) {
+		cache->stats.allocs++;
+		if (++cache->stats.inuse > cache->stats.peak) {
+			cache->stats.peak = cache->stats.inuse;
+		}
+	} else if ((cache->flags & KMEM_CACHE_OVERFLOW) == 0) {
+		cache->stats.fails++;
+	}
+
+	irqrestore(flags);
+
+	if (!obj && (cache->flags & KMEM_CACHE_OVERFLOW) != 0) {
+		/* The pool is exhausted, use the kernel heap */
+
+		obj = kmm_malloc(cache->objsize);
+
+		flags = irqsave();
+		if (obj) {
+			cache->stats.overflows++;
+		} else {
+			cache->stats.fails++;
+		}
+
+		irqrestore(flags);
+	}
+
+	if (obj) {
+		if (zero) {
+			memset(obj, 0, cache->objsize);
+		}
+
+		if (cache->ctor) {
+			cache->ctor(obj);
+		}
+	}
+
+	return obj;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: kmem_cache_create
+ *
+ * Description:
+ *   Create a cache of 'nobjs' objects of 'size' bytes.  The pool is
+ *   allocated from the kernel heap at once.  'name' must remain valid for
+ *   the life of the cache.
+ *
+ * Input Parameters:
+ *   name  - Name of the cache
+ *   size  - Size of one object
+ *   nobjs - Number of objects in the pool
+ *   flags - KMEM_CACHE_* flags
+ *   ctor  - Constructor called on every allocated object, or NULL
+ *
+ * Returned Value:
+ *   The new cache or NULL if the pool could not be allocated.
+ *
+ ****************************************************************************/
+
+FAR struct kmem_cache_s *kmem_cache_create(FAR const char *name, size_t size, uint16_t nobjs, uint8_t flags, kmem_ctor_t ctor)
+{
+	FAR struct kmem_cache_s *cache;
+	irqstate_t irqflags;
+	size_t poolsize;
+	size_t ngranules;
+	uint8_t log2gran;
+
+	DEBUGASSERT(name && size > 0 && nobjs > 0);
+
+	/* Pick the smallest granule that keeps one object within
+	 * KMEM_CACHE_MAXGRANS granules.
+	 */
+
+	size = KMEM_CACHE_ALIGN_UP(size);
+	for (log2gran = KMEM_CACHE_LOG2ALIGN; (size + (1 << log2gran) - 1) >> log2gran > KMEM_CACHE_MAXGRANS; log2gran++) ;
+
+	ngranules = (size + (1 << log2gran) - 1) >> log2gran;
+	if (ngranules * nobjs > UINT16_MAX) {
+		mdbg("ERROR: %s: too many objects (%d)\n", name, nobjs);
+		return NULL;
+	}
+
+	cache = (FAR struct kmem_cache_s *)kmm_zalloc(sizeof(struct kmem_cache_s));
+	if (!cache) {
+		return NULL;
+	}
+
+	/* Leave room for aligning the start of the pool */
+
+	cache->slotsize = ngranules << log2gran;
+	poolsize = cache->slotsize * nobjs + (1 << KMEM_CACHE_LOG2ALIGN) - 1;
+
+	cache->pool = kmm_malloc(poolsize);
+	if (!cache->pool) {
+		mdbg("ERROR: %s: failed to allocate %d bytes\n", name, poolsize);
+		goto errout_with_cache;
+	}
+
+	cache->gran = gran_initialize(cache->pool, poolsize, log2gran, KMEM_CACHE_LOG2ALIGN);
+	if (!cache->gran) {
+		goto errout_with_pool;
+	}
+
+	cache->name = name;
+	cache->start = KMEM_CACHE_ALIGN_UP((uintptr_t)cache->pool);
+	cache->end = cache->start + cache->slotsize * nobjs;
+	cache->objsize = size;
+	cache->nobjs = nobjs;
+	cache->flags = flags;
+	cache->ctor = ctor;
+
+	irqflags = irqsave();
+	cache->flink = g_kmem_caches;
+	g_kmem_caches = cache;
+	irqrestore(irqflags);
+
+	mvdbg("%s: %d objects of %d bytes in %d byte slots\n", name, nobjs, size, cache->slotsize);
+	return cache;
+
+errout_with_pool:
+	kmm_free(cache->pool);
+
+errout_with_cache:
+	kmm_free(cache);
+	return NULL;
+}
+
+/****************************************************************************
+ * Name: kmem_cache_destroy
+ *
+ * Description:
+ *   Release a cache and its pool.  All of its objects must have been
+ *   freed.
+ *
+ ****************************************************************************/
+
+void kmem_cache_destroy(FAR struct kmem_cache_s *cache)
+{
+	FAR struct kmem_cache_s *prev;
+	irqstate_t flags;
+
+	DEBUGASSERT(cache && cache->stats.inuse == 0);
+
+	/* Remove the cache from the list of all caches */
+
+	flags = irqsave();
+	if (g_kmem_caches == cache) {
+		g_kmem_caches = cache->flink;
+	} else {
+		for (prev = g_kmem_caches; prev && prev->flink != cache; prev = prev->flink) ;
+
+		if (prev) {
+			prev->flink = cache->flink;
+		}
+	}
+
+	irqrestore(flags);
+
+	gran_release(cache->gran);
+	kmm_free(cache->pool);
+	kmm_free(cache);
+}
+
+/****************************************************************************
+ * Name: kmem_cache_alloc and kmem_cache_zalloc
+ *
+ * Description:
+ *   Allocate one object from a cache.  kmem_cache_zalloc() clears the
+ *   object before the constructor runs.
+ *
+ ****************************************************************************/
+
+FAR void *kmem_cache_alloc(FAR struct kmem_cache_s *cache)
+{
+	return kmem_cache_common_alloc(cache, false);
+}
+
+FAR void *kmem_cache_zalloc(FAR struct kmem_cache_s *cache)
+{
+	return kmem_cache_common_alloc(cache, true);
+}
+
+/****************************************************************************
+ * Name: kmem_cache_free
+ *
+ * Description:
+ *   Return an object to its cache.  Objects that do not belong to the pool
+ *   are released to the kernel heap.
+ *
+ ****************************************************************************/
+
+void kmem_cache_free(FAR struct kmem_cache_s *cache, FAR void *obj)
+{
+	irqstate_t flags;
+
+	DEBUGASSERT(cache);
+
+	if (!obj) {
+		return;
+	}
+
+	if (!kmem_cache_member(cache, obj)) {
+		kmm_free(obj);
+		return;
+	}
+
+	DEBUGASSERT(((uintptr_t)obj - cache->start) % cache->slotsize == 0);
+
+	gran_free(cache->gran, obj, cache->slotsize);
+
+	flags = irqsave();
+	cache->stats.frees++;
+	cache->stats.inuse--;
+	irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: kmem_cache_member
+ *
+ * Description:
+ *   Return true if 'obj' lies in the pool of 'cache'.
+ *
+ ****************************************************************************/
+
+bool kmem_cache_member(FAR struct kmem_cache_s *cache, FAR const void *obj)
+{
+	return cache && (uintptr_t)obj >= cache->start && (uintptr_t)obj < cache->end;
+}
+
+/****************************************************************************
+ * Name: kmem_cache_getinfo
+ *
+ * Description:
+ *   Take a snapshot of the 'index'th cache in the list of all caches.
+ *
+ * Returned Value:
+ *   OK on success, -ENOENT if there is no such cache.
+ *
+ ****************************************************************************/
+
+int kmem_cache_getinfo(int index, FAR struct kmem_cache_info_s *info)
+{
+	FAR struct kmem_cache_s *cache;
+	irqstate_t flags;
+	int ret = -ENOENT;
+
+	flags = irqsave();
+	for (cache = g_kmem_caches; cache && index > 0; cache = cache->flink, index--) ;
+
+	if (cache) {
+		info->name = cache->name;
+		info->objsize = cache->objsize;
+		info->slotsize = cache->slotsize;
+		info->nobjs = cache->nobjs;
+		memcpy(&info->stats, &cache->stats, sizeof(struct kmem_cache_stats_s));
+		ret = OK;
+	}
+
+	irqrestore(flags);
+	return ret;
+}
+
+#endif							/* CONFIG_MM_KMEM_CACHE */
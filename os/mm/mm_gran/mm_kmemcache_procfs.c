@@ -0,0 +1,286 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/mm_gran/mm_kmemcache_procfs.c
+ *
+ * /proc/kmemcache shows one line of counters per object cache.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <tinyara/kmalloc.h>
+#include <tinyara/fs/fs.h>
+#include <tinyara/fs/procfs.h>
+#include <tinyara/mm/kmem_cache.h>
+
+#if defined(CONFIG_MM_KMEM_CACHE) && !defined(CONFIG_DISABLE_MOUNTPOINT) && defined(CONFIG_FS_PROCFS)
+#ifndef CONFIG_FS_PROCFS_EXCLUDE_KMEMCACHE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Determines the size of an intermediate buffer that must be large enough
+ * to handle the longest line generated by this logic.
+ */
+
+#define KMEMCACHE_LINELEN 96
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* This structure describes one open "file" */
+
+struct kmemcache_file_s {
+	struct procfs_file_s base;	/* Base open file structure */
+	char line[KMEMCACHE_LINELEN];	/* Pre-allocated buffer for formatted lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* File system methods */
+
+static int kmemcache_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode);
+static int kmemcache_close(FAR struct file *filep);
+static ssize_t kmemcache_read(FAR struct file *filep, FAR char *buffer, size_t buflen);
+
+static int kmemcache_dup(FAR const struct file *oldp, FAR struct file *newp);
+
+static int kmemcache_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See fs_procfs.c -- this structure is explicitly externed there.
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations kmemcache_operations = {
+	kmemcache_open,				/* open */
+	kmemcache_close,			/* close */
+	kmemcache_read,				/* read */
+	NULL,						/* write */
+
+	kmemcache_dup,				/* dup */
+
+	NULL,						/* opendir */
+	NULL,						/* closedir */
+	NULL,						/* readdir */
+	NULL,						/* rewinddir */
+
+	kmemcache_stat				/* stat */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: kmemcache_open
+ ****************************************************************************/
+
+static int kmemcache_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode)
+{
+	FAR struct kmemcache_file_s *attr;
+
+	fvdbg("Open '%s'\n", relpath);
+
+	/* PROCFS is read-only.  Any attempt to open with any kind of write
+	 * access is not permitted.
+	 */
+
+	if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0) {
+		fdbg("ERROR: Only O_RDONLY supported\n");
+		return -EACCES;
+	}
+
+	/* "kmemcache" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "kmemcache") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* Allocate a container to hold the file attributes */
+
+	attr = (FAR struct kmemcache_file_s *)kmm_zalloc(sizeof(struct kmemcache_file_s));
+	if (!attr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* Save the attributes as the open-specific state in filep->f_priv */
+
+	filep->f_priv = (FAR void *)attr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: kmemcache_close
+ ****************************************************************************/
+
+static int kmemcache_close(FAR struct file *filep)
+{
+	FAR struct kmemcache_file_s *attr;
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct kmemcache_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	/* Release the file attributes structure */
+
+	kmm_free(attr);
+	filep->f_priv = NULL;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: kmemcache_read
+ ****************************************************************************/
+
+static ssize_t kmemcache_read(FAR struct file *filep, FAR char *buffer, size_t buflen)
+{
+	FAR struct kmemcache_file_s *attr;
+	struct kmem_cache_info_s info;
+	size_t remaining;
+	size_t linesize;
+	size_t copysize;
+	size_t totalsize;
+	off_t offset;
+	int index;
+
+	fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct kmemcache_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	remaining = buflen;
+	totalsize = 0;
+	offset = filep->f_pos;
+
+	linesize = snprintf(attr->line, KMEMCACHE_LINELEN, "%-12s %5s %5s %5s %5s %5s %10s %10s %8s %6s\n", "NAME", "SIZE", "SLOT", "TOTAL", "INUSE", "PEAK", "ALLOCS", "FREES", "OVERFLOW", "FAILS");
+	copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+	totalsize += copysize;
+	buffer += copysize;
+	remaining -= copysize;
+
+	/* One line per cache */
+
+	for (index = 0; remaining > 0 && kmem_cache_getinfo(index, &info) == OK; index++) {
+		linesize = snprintf(attr->line, KMEMCACHE_LINELEN, "%-12.12s %5u %5u %5u %5u %5u %10u %10u %8u %6u\n", info.name, (unsigned int)info.objsize, (unsigned int)info.slotsize, (unsigned int)info.nobjs, (unsigned int)info.stats.inuse, (unsigned int)info.stats.peak, (unsigned int)info.stats.allocs, (unsigned int)info.stats.frees, (unsigned int)info.stats.overflows, (unsigned int)info.stats.fails);
+		copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+		totalsize += copysize;
+		buffer += copysize;
+		remaining -= copysize;
+	}
+
+	/* Update the file offset */
+
+	filep->f_pos += totalsize;
+	return totalsize;
+}
+
+/****************************************************************************
+ * Name: kmemcache_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int kmemcache_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+	FAR struct kmemcache_file_s *oldattr;
+	FAR struct kmemcache_file_s *newattr;
+
+	fvdbg("Dup %p->%p\n", oldp, newp);
+
+	/* Recover our private data from the old struct file instance */
+
+	oldattr = (FAR struct kmemcache_file_s *)oldp->f_priv;
+	DEBUGASSERT(oldattr);
+
+	/* Allocate a new container to hold the task and attribute selection */
+
+	newattr = (FAR struct kmemcache_file_s *)kmm_malloc(sizeof(struct kmemcache_file_s));
+	if (!newattr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* The copy the file attributes from the old attributes to the new */
+
+	memcpy(newattr, oldattr, sizeof(struct kmemcache_file_s));
+
+	/* Save the new attributes in the new file structure */
+
+	newp->f_priv = (FAR void *)newattr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: kmemcache_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int kmemcache_stat(const char *relpath, struct stat *buf)
+{
+	/* "kmemcache" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "kmemcache") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* "kmemcache" is the name for a read-only file */
+
+	buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+	buf->st_size = 0;
+	buf->st_blksize = 0;
+	buf->st_blocks = 0;
+	return OK;
+}
+
+#endif							/* CONFIG_FS_PROCFS_EXCLUDE_KMEMCACHE */
+#endif							/* CONFIG_MM_KMEM_CACHE && !CONFIG_DISABLE_MOUNTPOINT && CONFIG_FS_PROCFS */
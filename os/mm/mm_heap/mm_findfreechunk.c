@@ -0,0 +1,135 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/mm_heap/mm_findfreechunk.c
+ *
+ *   Copyright (C) 2007, 2009, 2013 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <tinyara/mm/mm.h>
+
+#ifndef CONFIG_MM_TLSF
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: mm_findfreechunk
+ *
+ * Description:
+ *   Find the smallest free chunk of at least 'size' bytes.  The chunk is
+ *   not removed from the nodelist.  It is assumed that the caller holds the
+ *   mm semaphore
+ *
+ ****************************************************************************/
+
+FAR struct mm_freenode_s *mm_findfreechunk(FAR struct mm_heap_s *heap, size_t size)
+{
+	FAR struct mm_freenode_s *node;
+	int ndx;
+
+	/* Get the location in the node list to start the search. Special case
+	 * really big allocations
+	 */
+
+	if (size >= MM_MAX_CHUNK) {
+		ndx = MM_NNODES - 1;
+	} else {
+		/* Convert the request size into a nodelist index */
+
+		ndx = mm_size2ndx(size);
+	}
+
+	/* Search for a large enough chunk in the list of nodes. This list is
+	 * ordered by size, but will have occasional zero sized nodes as we visit
+	 * other mm_nodelist[] entries.
+	 */
+
+	for (node = heap->mm_nodelist[ndx].flink; node && node->size < size; node = node->flink) ;
+
+	return node;
+}
+
+#ifdef CONFIG_DEBUG_MM_HEAPPROF
+/****************************************************************************
+ * Name: mm_maxfreechunk
+ *
+ * Description:
+ *   Return the size of the largest free chunk, or zero if there is none.
+ *   Only the highest non-empty nodelist entry is walked.  It is assumed
+ *   that the caller holds the mm semaphore.  Only /proc/heap needs it
+ *
+ ****************************************************************************/
+
+size_t mm_maxfreechunk(FAR struct mm_heap_s *heap)
+{
+	FAR struct mm_freenode_s *node;
+	size_t maxsize = 0;
+	int ndx;
+
+	/* The nodes of one entry are ordered by size and the list continues
+	 * with the zero sized head of the next entry.
+	 */
+
+	for (ndx = MM_NNODES - 1; ndx >= 0 && maxsize == 0; ndx--) {
+		for (node = heap->mm_nodelist[ndx].flink; node && node->size; node = node->flink) {
+			maxsize = node->size;
+		}
+	}
+
+	return maxsize;
+}
+#endif
+
+#endif /* !CONFIG_MM_TLSF */
@@ -116,6 +116,7 @@ void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
 	if ((alloc_node->preceding & MM_ALLOC_BIT) != 0) {
 		heapinfo_subtract_size(alloc_node->pid, alloc_node->size);
 		heapinfo_update_total_size(heap, ((-1) * alloc_node->size));
+		heapprof_record(HEAPPROF_EVENT_FREE, alloc_node, alloc_node->size);
 	}
 #endif
 	node->preceding &= ~MM_ALLOC_BIT;
@@ -133,15 +134,9 @@ void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
 
 		andbeyond = (FAR struct mm_allocnode_s *)((char *)next + next->size);
 
-		/* Remove the next node.  There must be a predecessor,
-		 * but there may not be a successor node.
-		 */
+		/* Remove the next node from the free nodes */
 
-		DEBUGASSERT(next->blink);
-		next->blink->flink = next->flink;
-		if (next->flink) {
-			next->flink->blink = next->blink;
-		}
+		mm_delfreechunk(heap, next);
 
 		/* Then merge the two chunks */
 
@@ -156,15 +151,9 @@ void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
 
 	prev = (FAR struct mm_freenode_s *)((char *)node - node->preceding);
 	if ((prev->preceding & MM_ALLOC_BIT) == 0) {
-		/* Remove the node.  There must be a predecessor, but there may
-		 * not be a successor node.
-		 */
+		/* Remove the previous node from the free nodes */
 
-		DEBUGASSERT(prev->blink);
-		prev->blink->flink = prev->flink;
-		if (prev->flink) {
-			prev->flink->blink = prev->blink;
-		}
+		mm_delfreechunk(heap, prev);
 
 		/* Then merge the two chunks */
 
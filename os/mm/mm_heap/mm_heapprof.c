@@ -0,0 +1,275 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/mm_heap/mm_heapprof.c
+ *
+ * Heap profiler.  Every allocation and free that updates the heapinfo
+ * accounting is also appended to a ring of CONFIG_DEBUG_MM_HEAPPROF_NEVENTS
+ * events and charged to its call site in a table of live bytes per caller.
+ *
+ * Recording masks interrupts for a few stores.  Readers never block
+ * writers and take no lock at all: an event is copied out of the ring and
+ * kept only if its sequence number did not change during the copy.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <string.h>
+#include <errno.h>
+
+#include <tinyara/irq.h>
+#include <tinyara/clock.h>
+#include <tinyara/mm/mm.h>
+
+#ifdef CONFIG_DEBUG_MM_HEAPPROF
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define HEAPPROF_NEVENTS  CONFIG_DEBUG_MM_HEAPPROF_NEVENTS
+#define HEAPPROF_NCALLERS CONFIG_DEBUG_MM_HEAPPROF_NCALLERS
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct heapprof_s {
+	struct heapprof_stats_s stats;
+	struct heapprof_caller_s other;	/* Call sites that did not fit */
+	struct heapprof_caller_s callers[HEAPPROF_NCALLERS];
+	struct heapprof_event_s ring[HEAPPROF_NEVENTS];
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct heapprof_s g_heapprof;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapprof_sizeclass
+ *
+ * Description:
+ *   Return the power-of-two size class of a chunk size.
+ *
+ ****************************************************************************/
+
+static inline int heapprof_sizeclass(size_t size)
+{
+	int ndx = 0;
+
+	for (size >>= MM_MIN_SHIFT; size > 1 && ndx < MM_NNODES - 1; size >>= 1) {
+		ndx++;
+	}
+
+	return ndx;
+}
+
+/****************************************************************************
+ * Name: heapprof_findcaller
+ *
+ * Description:
+ *   Return the table entry of a call site, creating it on allocation if
+ *   there is room.  Entries are never removed, so a call site is always
+ *   found in the same place.
+ *
+ ****************************************************************************/
+
+static FAR struct heapprof_caller_s *heapprof_findcaller(mmaddress_t caller, bool create)
+{
+	FAR struct heapprof_caller_s *entry;
+	int ndx = (int)((caller >> 1) % HEAPPROF_NCALLERS);
+	int i;
+
+	for (i = 0; i < HEAPPROF_NCALLERS; i++) {
+		entry = &g_heapprof.callers[ndx];
+		if (entry->caller == caller) {
+			return entry;
+		}
+
+		if (entry->caller == 0) {
+			if (!create || caller == 0) {
+				break;
+			}
+
+			entry->caller = caller;
+			return entry;
+		}
+
+		if (++ndx >= HEAPPROF_NCALLERS) {
+			ndx = 0;
+		}
+	}
+
+	return &g_heapprof.other;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapprof_record
+ *
+ * Description:
+ *   Record the allocation or the free of a chunk.  'size' is the chunk
+ *   size that was added to or subtracted from the heapinfo accounting.
+ *   The call site and the owner are taken from the chunk header.
+ *
+ ****************************************************************************/
+
+void heapprof_record(uint8_t type, FAR struct mm_allocnode_s *node, size_t size)
+{
+	FAR struct heapprof_event_s *event;
+	FAR struct heapprof_caller_s *caller;
+	irqstate_t flags;
+	uint32_t seq;
+	int ndx;
+
+	flags = irqsave();
+
+	seq = g_heapprof.stats.events++;
+	event = &g_heapprof.ring[seq % HEAPPROF_NEVENTS];
+
+	event->seq = 0;
+	event->time = (uint32_t)clock_systimer();
+	event->caller = node->alloc_call_addr;
+	event->addr = (mmaddress_t)node;
+	event->size = (mmsize_t)size;
+	event->pid = node->pid;
+	event->type = type;
+	event->seq = seq + 1;
+
+	caller = heapprof_findcaller(node->alloc_call_addr, type == HEAPPROF_EVENT_ALLOC);
+	ndx = heapprof_sizeclass(size);
+
+	if (type == HEAPPROF_EVENT_ALLOC) {
+		caller->live += size;
+		caller->count++;
+		caller->allocs++;
+		if (caller->live > caller->peak) {
+			caller->peak = caller->live;
+		}
+
+		g_heapprof.stats.live += size;
+		g_heapprof.stats.hist[ndx]++;
+		if (g_heapprof.stats.live > g_heapprof.stats.peak) {
+			g_heapprof.stats.peak = g_heapprof.stats.live;
+		}
+	} else {
+		caller->live -= size;
+		caller->count--;
+		g_heapprof.stats.live -= size;
+		g_heapprof.stats.hist[ndx]--;
+	}
+
+	irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: heapprof_getstats
+ *
+ * Description:
+ *   Take a snapshot of the profiler totals.
+ *
+ ****************************************************************************/
+
+void heapprof_getstats(FAR struct heapprof_stats_s *stats)
+{
+	irqstate_t flags;
+
+	flags = irqsave();
+	memcpy(stats, &g_heapprof.stats, sizeof(struct heapprof_stats_s));
+	irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: heapprof_getcaller
+ *
+ * Description:
+ *   Take a snapshot of one entry of the call site table.  Index
+ *   CONFIG_DEBUG_MM_HEAPPROF_NCALLERS returns the call sites that did not
+ *   fit in the table.
+ *
+ * Returned Value:
+ *   OK if the entry is used, -ENOENT if it is empty and -EINVAL if the
+ *   index is out of range.
+ *
+ ****************************************************************************/
+
+int heapprof_getcaller(int index, FAR struct heapprof_caller_s *caller)
+{
+	FAR struct heapprof_caller_s *entry;
+	irqstate_t flags;
+
+	if (index < 0 || index > HEAPPROF_NCALLERS) {
+		return -EINVAL;
+	}
+
+	entry = index < HEAPPROF_NCALLERS ? &g_heapprof.callers[index] : &g_heapprof.other;
+
+	flags = irqsave();
+	memcpy(caller, entry, sizeof(struct heapprof_caller_s));
+	irqrestore(flags);
+
+	return caller->allocs > 0 ? OK : -ENOENT;
+}
+
+/****************************************************************************
+ * Name: heapprof_getevent
+ *
+ * Description:
+ *   Copy the event with sequence number 'seq' out of the ring without
+ *   locking.
+ *
+ * Returned Value:
+ *   OK on success, -ENOENT if the event has not been recorded yet or was
+ *   overwritten.
+ *
+ ****************************************************************************/
+
+int heapprof_getevent(uint32_t seq, FAR struct heapprof_event_s *event)
+{
+	FAR volatile struct heapprof_event_s *slot = &g_heapprof.ring[seq % HEAPPROF_NEVENTS];
+
+	if (slot->seq != seq + 1) {
+		return -ENOENT;
+	}
+
+	event->time = slot->time;
+	event->caller = slot->caller;
+	event->addr = slot->addr;
+	event->size = slot->size;
+	event->pid = slot->pid;
+	event->type = slot->type;
+	event->seq = slot->seq;
+
+	return event->seq == seq + 1 ? OK : -ENOENT;
+}
+
+#endif							/* CONFIG_DEBUG_MM_HEAPPROF */
@@ -0,0 +1,471 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/mm_heap/mm_heapprof_procfs.c
+ *
+ * /proc/heap shows the heap profiler data: a summary of the user heap
+ * including its fragmentation, the number of live chunks per size class,
+ * the live allocations of every call site and the events still held in
+ * the ring.  The summary is taken when the file is opened, so that it is
+ * consistent across reads; call sites and events are read as the file is
+ * read.  Each line is formatted only once and the open file remembers where
+ * the next read resumes, so a line is never torn or repeated when the data
+ * changes between two reads.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <tinyara/kmalloc.h>
+#include <tinyara/fs/fs.h>
+#include <tinyara/fs/procfs.h>
+#include <tinyara/mm/mm.h>
+
+#if defined(CONFIG_DEBUG_MM_HEAPPROF) && !defined(CONFIG_DISABLE_MOUNTPOINT) && defined(CONFIG_FS_PROCFS)
+#ifndef CONFIG_FS_PROCFS_EXCLUDE_HEAP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Determines the size of an intermediate buffer that must be large enough
+ * to handle the longest line generated by this logic.
+ */
+
+#define HEAPPROF_LINELEN 80
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Sections of the file, in the order they are read */
+
+enum heapprof_section_e {
+	HEAPPROF_SUMMARY = 0,
+	HEAPPROF_HISTOGRAM,
+	HEAPPROF_CALLERS,
+	HEAPPROF_EVENTS,
+	HEAPPROF_END
+};
+
+/* This structure describes one open "file" */
+
+struct heapprof_file_s {
+	struct procfs_file_s base;	/* Base open file structure */
+	struct heapprof_stats_s stats;	/* Profiler totals when opened */
+	size_t heapsize;			/* Usable size of the heap */
+	size_t used;				/* Bytes allocated when opened */
+	size_t peak;				/* Highest value of used */
+	size_t largest;				/* Largest free chunk when opened */
+	off_t offset;				/* File offset of the next byte of line */
+	uint32_t index;				/* Next item of the current section */
+	uint8_t section;			/* Section of the next line, see heapprof_section_e */
+	uint8_t linepos;			/* Bytes of line already read */
+	uint8_t linelen;			/* Length of line */
+	char line[HEAPPROF_LINELEN];	/* Pre-allocated buffer for formatted lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* File system methods */
+
+static int heapprof_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode);
+static int heapprof_close(FAR struct file *filep);
+static ssize_t heapprof_read(FAR struct file *filep, FAR char *buffer, size_t buflen);
+
+static int heapprof_dup(FAR const struct file *oldp, FAR struct file *newp);
+
+static int heapprof_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See fs_procfs.c -- this structure is explicitly externed there.
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations heapprof_operations = {
+	heapprof_open,				/* open */
+	heapprof_close,				/* close */
+	heapprof_read,				/* read */
+	NULL,						/* write */
+
+	heapprof_dup,				/* dup */
+
+	NULL,						/* opendir */
+	NULL,						/* closedir */
+	NULL,						/* readdir */
+	NULL,						/* rewinddir */
+
+	heapprof_stat				/* stat */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapprof_open
+ ****************************************************************************/
+
+static int heapprof_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode)
+{
+	FAR struct heapprof_file_s *attr;
+	FAR struct mm_heap_s *heap;
+	int nregions;
+
+	fvdbg("Open '%s'\n", relpath);
+
+	/* PROCFS is read-only.  Any attempt to open with any kind of write
+	 * access is not permitted.
+	 */
+
+	if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0) {
+		fdbg("ERROR: Only O_RDONLY supported\n");
+		return -EACCES;
+	}
+
+	/* "heap" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "heap") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* Allocate a container to hold the file attributes */
+
+	attr = (FAR struct heapprof_file_s *)kmm_zalloc(sizeof(struct heapprof_file_s));
+	if (!attr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* Take the summary.  The largest free chunk is found in the free lists
+	 * without walking the heap; the guard nodes at both ends of every
+	 * region are not usable.
+	 */
+
+	heap = mm_get_heap_info();
+#if CONFIG_MM_REGIONS > 1
+	nregions = heap->mm_nregions;
+#else
+	nregions = 1;
+#endif
+
+	mm_takesemaphore(heap);
+	attr->heapsize = heap->mm_heapsize - 2 * SIZEOF_MM_ALLOCNODE * nregions;
+	attr->used = heap->total_alloc_size;
+	attr->peak = heap->peak_alloc_size;
+	attr->largest = mm_maxfreechunk(heap);
+	mm_givesemaphore(heap);
+
+	heapprof_getstats(&attr->stats);
+
+	/* Save the attributes as the open-specific state in filep->f_priv */
+
+	filep->f_priv = (FAR void *)attr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: heapprof_close
+ ****************************************************************************/
+
+static int heapprof_close(FAR struct file *filep)
+{
+	FAR struct heapprof_file_s *attr;
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct heapprof_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	/* Release the file attributes structure */
+
+	kmm_free(attr);
+	filep->f_priv = NULL;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: heapprof_summary
+ *
+ * Description:
+ *   Format line 'index' of the summary.  Returns the length of the line, or
+ *   zero after the last line.
+ *
+ ****************************************************************************/
+
+static size_t heapprof_summary(FAR struct heapprof_file_s *attr, int index)
+{
+	size_t avail = attr->heapsize - attr->used;
+	unsigned int frag;
+
+	switch (index) {
+	case 0:
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "size", (unsigned int)attr->heapsize);
+	case 1:
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "used", (unsigned int)attr->used);
+	case 2:
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "peak", (unsigned int)attr->peak);
+	case 3:
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "free", (unsigned int)avail);
+	case 4:
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "largest", (unsigned int)attr->largest);
+	case 5:
+		/* 0 when all free memory is one chunk, close to 100 when it is
+		 * scattered in small chunks.
+		 */
+
+		frag = avail > 0 ? 100 - (unsigned int)((uint64_t)attr->largest * 100 / avail) : 0;
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "frag", frag);
+	case 6:
+		return snprintf(attr->line, HEAPPROF_LINELEN, "%-10s %10u\n", "events", (unsigned int)attr->stats.events);
+	default:
+		return 0;
+	}
+}
+
+/****************************************************************************
+ * Name: heapprof_nextline
+ *
+ * Description:
+ *   Format the line following the last one formatted.  Returns the length
+ *   of the line, or zero after the last line.
+ *
+ ****************************************************************************/
+
+static size_t heapprof_nextline(FAR struct heapprof_file_s *attr)
+{
+	struct heapprof_caller_s caller;
+	struct heapprof_event_s event;
+	size_t linesize;
+	uint32_t ndx;
+
+	switch (attr->section) {
+	case HEAPPROF_SUMMARY:
+		linesize = heapprof_summary(attr, attr->index++);
+		if (linesize > 0) {
+			return linesize;
+		}
+
+		attr->section = HEAPPROF_HISTOGRAM;
+		attr->index = 0;
+		return snprintf(attr->line, HEAPPROF_LINELEN, "\n%10s %10s\n", "SIZE", "CHUNKS");
+
+	case HEAPPROF_HISTOGRAM:
+		/* Live chunks per size class.  SIZE is the smallest chunk size of
+		 * the class, headers included.
+		 */
+
+		while (attr->index < MM_NNODES) {
+			ndx = attr->index++;
+			if (attr->stats.hist[ndx] > 0) {
+				return snprintf(attr->line, HEAPPROF_LINELEN, "%10u %10u\n", (unsigned int)(MM_MIN_CHUNK << ndx), (unsigned int)attr->stats.hist[ndx]);
+			}
+		}
+
+		attr->section = HEAPPROF_CALLERS;
+		attr->index = 0;
+		return snprintf(attr->line, HEAPPROF_LINELEN, "\n%10s %10s %8s %10s %10s\n", "CALLER", "LIVE", "COUNT", "PEAK", "ALLOCS");
+
+	case HEAPPROF_CALLERS:
+		/* Live allocations per call site.  The last entry, with a caller of
+		 * 0, gathers the call sites that did not fit in the table.
+		 */
+
+		while (attr->index <= CONFIG_DEBUG_MM_HEAPPROF_NCALLERS) {
+			if (heapprof_getcaller(attr->index++, &caller) == OK) {
+				return snprintf(attr->line, HEAPPROF_LINELEN, "0x%08x %10u %8u %10u %10u\n", (unsigned int)caller.caller, (unsigned int)caller.live, (unsigned int)caller.count, (unsigned int)caller.peak, (unsigned int)caller.allocs);
+			}
+		}
+
+		/* Events recorded before the file was opened that are still in the
+		 * ring, oldest first.  Events overwritten in the meantime are
+		 * skipped.
+		 */
+
+		attr->section = HEAPPROF_EVENTS;
+		attr->index = attr->stats.events > CONFIG_DEBUG_MM_HEAPPROF_NEVENTS ? attr->stats.events - CONFIG_DEBUG_MM_HEAPPROF_NEVENTS : 0;
+		return snprintf(attr->line, HEAPPROF_LINELEN, "\n%10s %4s %10s %5s %10s %8s %10s\n", "SEQ", "TYPE", "TIME", "PID", "CALLER", "SIZE", "ADDR");
+
+	case HEAPPROF_EVENTS:
+		while (attr->index < attr->stats.events) {
+			ndx = attr->index++;
+			if (heapprof_getevent(ndx, &event) == OK) {
+				return snprintf(attr->line, HEAPPROF_LINELEN, "%10u %4s %10u %5d 0x%08x %8u 0x%08x\n", (unsigned int)ndx, event.type == HEAPPROF_EVENT_ALLOC ? "A" : "F", (unsigned int)event.time, event.pid, (unsigned int)event.caller, (unsigned int)event.size, (unsigned int)event.addr);
+			}
+		}
+
+		attr->section = HEAPPROF_END;
+		return 0;
+
+	default:
+		return 0;
+	}
+}
+
+/****************************************************************************
+ * Name: heapprof_read
+ ****************************************************************************/
+
+static ssize_t heapprof_read(FAR struct file *filep, FAR char *buffer, size_t buflen)
+{
+	FAR struct heapprof_file_s *attr;
+	size_t copysize;
+	size_t totalsize;
+
+	fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct heapprof_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	/* The lines are formatted again from the start only if the file was
+	 * seeked backwards.
+	 */
+
+	if (filep->f_pos < attr->offset) {
+		attr->offset = 0;
+		attr->index = 0;
+		attr->section = HEAPPROF_SUMMARY;
+		attr->linepos = 0;
+		attr->linelen = 0;
+	}
+
+	totalsize = 0;
+	while (totalsize < buflen) {
+		if (attr->linepos == attr->linelen) {
+			attr->linelen = heapprof_nextline(attr);
+			attr->linepos = 0;
+			if (attr->linelen == 0) {
+				break;
+			}
+		}
+
+		copysize = attr->linelen - attr->linepos;
+		if (attr->offset < filep->f_pos) {
+			/* Skip what is before the file offset */
+
+			if (copysize > filep->f_pos - attr->offset) {
+				copysize = filep->f_pos - attr->offset;
+			}
+		} else {
+			if (copysize > buflen - totalsize) {
+				copysize = buflen - totalsize;
+			}
+
+			memcpy(buffer + totalsize, &attr->line[attr->linepos], copysize);
+			totalsize += copysize;
+		}
+
+		attr->linepos += copysize;
+		attr->offset += copysize;
+	}
+
+	/* Update the file offset */
+
+	filep->f_pos += totalsize;
+	return totalsize;
+}
+
+/****************************************************************************
+ * Name: heapprof_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int heapprof_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+	FAR struct heapprof_file_s *oldattr;
+	FAR struct heapprof_file_s *newattr;
+
+	fvdbg("Dup %p->%p\n", oldp, newp);
+
+	/* Recover our private data from the old struct file instance */
+
+	oldattr = (FAR struct heapprof_file_s *)oldp->f_priv;
+	DEBUGASSERT(oldattr);
+
+	/* Allocate a new container to hold the task and attribute selection */
+
+	newattr = (FAR struct heapprof_file_s *)kmm_malloc(sizeof(struct heapprof_file_s));
+	if (!newattr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* The copy the file attributes from the old attributes to the new */
+
+	memcpy(newattr, oldattr, sizeof(struct heapprof_file_s));
+
+	/* Save the new attributes in the new file structure */
+
+	newp->f_priv = (FAR void *)newattr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: heapprof_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int heapprof_stat(const char *relpath, struct stat *buf)
+{
+	/* "heap" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "heap") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* "heap" is the name for a read-only file */
+
+	buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+	buf->st_size = 0;
+	buf->st_blksize = 0;
+	buf->st_blocks = 0;
+	return OK;
+}
+
+#endif							/* CONFIG_FS_PROCFS_EXCLUDE_HEAP */
+#endif							/* CONFIG_DEBUG_MM_HEAPPROF && !CONFIG_DISABLE_MOUNTPOINT && CONFIG_FS_PROCFS */
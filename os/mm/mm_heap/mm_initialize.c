@@ -190,7 +190,9 @@ void mm_addregion(FAR struct mm_heap_s *heap, FAR void *heapstart, size_t heapsi
 
 void mm_initialize(FAR struct mm_heap_s *heap, FAR void *heapstart, size_t heapsize)
 {
+#ifndef CONFIG_MM_TLSF
 	int i;
+#endif
 
 	mlldbg("Heap: start=%p size=%u\n", heapstart, heapsize);
 
@@ -212,6 +214,13 @@ void mm_initialize(FAR struct mm_heap_s *heap, FAR void *heapstart, size_t heaps
 	heap->mm_nregions = 0;
 #endif
 
+#ifdef CONFIG_MM_TLSF
+	/* Initialize the segregated free lists and their bitmaps */
+
+	heap->mm_flbitmap = 0;
+	memset(heap->mm_slbitmap, 0, sizeof(heap->mm_slbitmap));
+	memset(heap->mm_freelist, 0, sizeof(heap->mm_freelist));
+#else
 	/* Initialize the node array */
 
 	memset(heap->mm_nodelist, 0, sizeof(struct mm_freenode_s) * MM_NNODES);
@@ -219,6 +228,7 @@ void mm_initialize(FAR struct mm_heap_s *heap, FAR void *heapstart, size_t heaps
 		heap->mm_nodelist[i - 1].flink = &heap->mm_nodelist[i];
 		heap->mm_nodelist[i].blink = &heap->mm_nodelist[i - 1];
 	}
+#endif
 
 	/* Initialize the malloc semaphore to one (to support one-at-
 	 * a-time access to private data sets).
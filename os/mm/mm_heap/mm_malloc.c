@@ -110,7 +110,6 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
 {
 	FAR struct mm_freenode_s *node;
 	void *ret = NULL;
-	int ndx;
 
 	/* Handle bad sizes */
 
@@ -128,28 +127,13 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
 
 	mm_takesemaphore(heap);
 
-	/* Get the location in the node list to start the search. Special case
-	 * really big allocations
-	 */
+	/* Search for a large enough chunk in the free nodes */
 
-	if (size >= MM_MAX_CHUNK) {
-		ndx = MM_NNODES - 1;
-	} else {
-		/* Convert the request size into a nodelist index */
+	node = mm_findfreechunk(heap, size);
 
-		ndx = mm_size2ndx(size);
-	}
-
-	/* Search for a large enough chunk in the list of nodes. This list is
-	 * ordered by size, but will have occasional zero sized nodes as we visit
-	 * other mm_nodelist[] entries.
-	 */
-
-	for (node = heap->mm_nodelist[ndx].flink; node && node->size < size; node = node->flink) ;
-
-	/* If we found a node with non-zero size, then this is one to use. Since
-	 * the list is ordered, we know that is must be best fitting chunk
-	 * available.
+	/* If we found a node with non-zero size, then this is one to use. With
+	 * the ordered nodelist it is the best fitting chunk available, with the
+	 * TLSF lists a chunk from the smallest class that is known to fit.
 	 */
 
 	if (node) {
@@ -157,15 +141,9 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
 		FAR struct mm_freenode_s *next;
 		size_t remaining;
 
-		/* Remove the node.  There must be a predecessor, but there may not be
-		 * a successor node.
-		 */
+		/* Remove the node from the free nodes */
 
-		DEBUGASSERT(node->blink);
-		node->blink->flink = node->flink;
-		if (node->flink) {
-			node->flink->blink = node->blink;
-		}
+		mm_delfreechunk(heap, node);
 
 		/* Check if we have to split the free node into one of the allocated
 		 * size and another smaller freenode.  In some cases, the remaining
@@ -209,6 +187,7 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
 		heapinfo_update_node((struct mm_allocnode_s *)node, caller_retaddr);
 		heapinfo_add_size(((struct mm_allocnode_s *)node)->pid, node->size);
 		heapinfo_update_total_size(heap, node->size);
+		heapprof_record(HEAPPROF_EVENT_ALLOC, (struct mm_allocnode_s *)node, node->size);
 #endif
 		ret = (void *)((char *)node + SIZEOF_MM_ALLOCNODE);
 	}
@@ -150,6 +150,7 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment, size_t size)
 #ifdef CONFIG_DEBUG_MM_HEAPINFO
 		heapinfo_subtract_size(node->pid, node->size);
 		heapinfo_update_total_size(heap, ((-1) * (node->size)));
+		heapprof_record(HEAPPROF_EVENT_FREE, node, node->size);
 #endif
 	/* Find the aligned subregion */
 
@@ -238,6 +239,7 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment, size_t size)
 
 	heapinfo_add_size(node->pid, node->size);
 	heapinfo_update_total_size(heap, node->size);
+	heapprof_record(HEAPPROF_EVENT_ALLOC, node, node->size);
 #endif
 	mm_givesemaphore(heap);
 	return (FAR void *)alignedchunk;
@@ -161,6 +161,7 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem, size_t size)
 			/* modify the current allocated size of old node */
 			heapinfo_subtract_size(oldnode->pid, oldsize);
 			heapinfo_update_total_size(heap, (-1) * oldsize);
+			heapprof_record(HEAPPROF_EVENT_FREE, oldnode, oldsize);
 #endif
 
 			mm_shrinkchunk(heap, oldnode, newsize);
@@ -170,6 +171,7 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem, size_t size)
 
 			heapinfo_add_size(oldnode->pid, oldnode->size);
 			heapinfo_update_total_size(heap, oldnode->size);
+			heapprof_record(HEAPPROF_EVENT_ALLOC, oldnode, oldnode->size);
 #endif
 		}
 
@@ -205,6 +207,7 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem, size_t size)
 		/* modify the current allocated size of old node */
 		heapinfo_subtract_size(oldnode->pid, oldsize);
 		heapinfo_update_total_size(heap, (-1) * oldsize);
+		heapprof_record(HEAPPROF_EVENT_FREE, oldnode, oldsize);
 #endif
 
 		/* Check if we can extend into the previous chunk and if the
@@ -259,15 +262,9 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem, size_t size)
 		if (takeprev) {
 			FAR struct mm_allocnode_s *newnode;
 
-			/* Remove the previous node.  There must be a predecessor, but
-			 * there may not be a successor node.
-			 */
+			/* Remove the previous node from the free nodes */
 
-			DEBUGASSERT(prev->blink);
-			prev->blink->flink = prev->flink;
-			if (prev->flink) {
-				prev->flink->blink = prev->blink;
-			}
+			mm_delfreechunk(heap, prev);
 
 			/* Extend the node into the previous free chunk */
 			/* Did we consume the entire preceding chunk? */
@@ -317,15 +314,9 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem, size_t size)
 
 			andbeyond = (FAR struct mm_allocnode_s *)((char *)next + nextsize);
 
-			/* Remove the next node.  There must be a predecessor, but there
-			 * may not be a successor node.
-			 */
+			/* Remove the next node from the free nodes */
 
-			DEBUGASSERT(next->blink);
-			next->blink->flink = next->flink;
-			if (next->flink) {
-				next->flink->blink = next->blink;
-			}
+			mm_delfreechunk(heap, next);
 
 			/* Extend the node into the next chunk */
 			/* Did we consume the entire preceding chunk? */
@@ -356,6 +347,7 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem, size_t size)
 
 		heapinfo_add_size(oldnode->pid, oldnode->size);
 		heapinfo_update_total_size(heap, oldnode->size);
+		heapprof_record(HEAPPROF_EVENT_ALLOC, oldnode, oldnode->size);
 #endif
 
 		mm_givesemaphore(heap);
@@ -0,0 +1,289 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/mm_heap/mm_tlsf.c
+ *
+ * Two-level segregated fit (TLSF) management of the free nodes.
+ *
+ * A free chunk of size s with fl = floor(log2(s)) belongs to first-level
+ * class fl - MM_MIN_SHIFT and to second-level class
+ * (s >> (fl - MM_TLSF_SL_SHIFT)) - MM_TLSF_SL_COUNT, i.e. every power of two
+ * range is split into MM_TLSF_SL_COUNT equally wide sub-ranges.  Chunks of
+ * MM_MAX_CHUNK bytes and more all share the last list.
+ *
+ * Lists are unordered and only ever touched at the head or at a known
+ * node; non-empty lists are tracked in bitmaps so that the search for a
+ * fitting chunk is a couple of find-first-set operations.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <assert.h>
+#include <debug.h>
+
+#include <tinyara/mm/mm.h>
+
+#ifdef CONFIG_MM_TLSF
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#if MM_NNODES > 32
+#error MM_TLSF needs one first-level bitmap bit per nodelist entry
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: mm_tlsf_fls
+ *
+ * Description:
+ *   Return the index of the most significant set bit of a non-zero value.
+ *
+ ****************************************************************************/
+
+static inline int mm_tlsf_fls(size_t value)
+{
+#ifdef __GNUC__
+	return (int)(sizeof(unsigned long) * 8) - 1 - __builtin_clzl((unsigned long)value);
+#else
+	int bit = 0;
+
+	while (value >>= 1) {
+		bit++;
+	}
+
+	return bit;
+#endif
+}
+
+/****************************************************************************
+ * Name: mm_tlsf_ffs
+ *
+ * Description:
+ *   Return the index of the least significant set bit of a non-zero bitmap.
+ *
+ ****************************************************************************/
+
+static inline int mm_tlsf_ffs(uint32_t bitmap)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(bitmap);
+#else
+	int bit = 0;
+
+	while ((bitmap & 1) == 0) {
+		bitmap >>= 1;
+		bit++;
+	}
+
+	return bit;
+#endif
+}
+
+/****************************************************************************
+ * Name: mm_tlsf_mapping
+ *
+ * Description:
+ *   Convert a chunk size into its first- and second-level list indices.
+ *
+ ****************************************************************************/
+
+static inline void mm_tlsf_mapping(size_t size, FAR int *fl, FAR int *sl)
+{
+	int bit = mm_tlsf_fls(size);
+
+	if (bit > MM_MAX_SHIFT) {
+		*fl = MM_NNODES - 1;
+		*sl = MM_TLSF_SL_COUNT - 1;
+	} else {
+		*fl = bit - MM_MIN_SHIFT;
+		*sl = (int)(size >> (bit - MM_TLSF_SL_SHIFT)) - MM_TLSF_SL_COUNT;
+	}
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: mm_addfreechunk
+ *
+ * Description:
+ *   Add a free chunk to the head of its segregated list.  It is assumed
+ *   that the caller holds the mm semaphore
+ *
+ ****************************************************************************/
+
+void mm_addfreechunk(FAR struct mm_heap_s *heap, FAR struct mm_freenode_s *node)
+{
+	FAR struct mm_freenode_s *head;
+	int fl;
+	int sl;
+
+	mm_tlsf_mapping(node->size, &fl, &sl);
+
+	head = heap->mm_freelist[fl][sl];
+	node->blink = NULL;
+	node->flink = head;
+	if (head) {
+		head->blink = node;
+	}
+
+	heap->mm_freelist[fl][sl] = node;
+	heap->mm_slbitmap[fl] |= (uint32_t)1 << sl;
+	heap->mm_flbitmap |= (uint32_t)1 << fl;
+}
+
+/****************************************************************************
+ * Name: mm_delfreechunk
+ *
+ * Description:
+ *   Remove a free chunk from its segregated list.  The chunk size must not
+ *   have been modified since it was added.  It is assumed that the caller
+ *   holds the mm semaphore
+ *
+ ****************************************************************************/
+
+void mm_delfreechunk(FAR struct mm_heap_s *heap, FAR struct mm_freenode_s *node)
+{
+	int fl;
+	int sl;
+
+	if (node->flink) {
+		node->flink->blink = node->blink;
+	}
+
+	if (node->blink) {
+		node->blink->flink = node->flink;
+		return;
+	}
+
+	/* The node was the head of its list */
+
+	mm_tlsf_mapping(node->size, &fl, &sl);
+	DEBUGASSERT(heap->mm_freelist[fl][sl] == node);
+
+	heap->mm_freelist[fl][sl] = node->flink;
+	if (!node->flink) {
+		heap->mm_slbitmap[fl] &= ~((uint32_t)1 << sl);
+		if (heap->mm_slbitmap[fl] == 0) {
+			heap->mm_flbitmap &= ~((uint32_t)1 << fl);
+		}
+	}
+}
+
+/****************************************************************************
+ * Name: mm_findfreechunk
+ *
+ * Description:
+ *   Find a free chunk of at least 'size' bytes.  The request is rounded up
+ *   to the next second-level class boundary so that the head of any list
+ *   at or above that class fits, then the first non-empty such list is
+ *   picked from the bitmaps.  Only the shared list of MM_MAX_CHUNK and
+ *   larger chunks may need to be walked.  The chunk is not removed from
+ *   its list.  It is assumed that the caller holds the mm semaphore
+ *
+ ****************************************************************************/
+
+FAR struct mm_freenode_s *mm_findfreechunk(FAR struct mm_heap_s *heap, size_t size)
+{
+	FAR struct mm_freenode_s *node;
+	uint32_t bitmap;
+	int fl;
+	int sl;
+
+	mm_tlsf_mapping(size + ((size_t)1 << (mm_tlsf_fls(size) - MM_TLSF_SL_SHIFT)) - 1, &fl, &sl);
+
+	/* Look for a non-empty list in the same first-level class first, then
+	 * in the smallest non-empty larger first-level class.
+	 */
+
+	bitmap = heap->mm_slbitmap[fl] & (~(uint32_t)0 << sl);
+	if (bitmap == 0 && fl + 1 < MM_NNODES) {
+		bitmap = heap->mm_flbitmap & (~(uint32_t)0 << (fl + 1));
+		if (bitmap != 0) {
+			fl = mm_tlsf_ffs(bitmap);
+			bitmap = heap->mm_slbitmap[fl];
+		}
+	}
+
+	if (bitmap != 0) {
+		sl = mm_tlsf_ffs(bitmap);
+		for (node = heap->mm_freelist[fl][sl]; node && node->size < size; node = node->flink) ;
+
+		if (node) {
+			return node;
+		}
+	}
+
+	/* Before failing, give the chunks of the class that the request itself
+	 * maps to a chance: rounding up skipped them, but some may be large
+	 * enough.  This walk only happens when the heap is nearly exhausted.
+	 */
+
+	mm_tlsf_mapping(size, &fl, &sl);
+	for (node = heap->mm_freelist[fl][sl]; node && node->size < size; node = node->flink) ;
+
+	return node;
+}
+
+#ifdef CONFIG_DEBUG_MM_HEAPPROF
+/****************************************************************************
+ * Name: mm_maxfreechunk
+ *
+ * Description:
+ *   Return the size of the largest free chunk, or zero if there is none.
+ *   Only the highest non-empty list is walked.  It is assumed that the
+ *   caller holds the mm semaphore.  Only /proc/heap needs it
+ *
+ ****************************************************************************/
+
+size_t mm_maxfreechunk(FAR struct mm_heap_s *heap)
+{
+	FAR struct mm_freenode_s *node;
+	size_t maxsize = 0;
+	int fl;
+	int sl;
+
+	if (heap->mm_flbitmap == 0) {
+		return 0;
+	}
+
+	fl = mm_tlsf_fls(heap->mm_flbitmap);
+	sl = mm_tlsf_fls(heap->mm_slbitmap[fl]);
+
+	for (node = heap->mm_freelist[fl][sl]; node; node = node->flink) {
+		if (node->size > maxsize) {
+			maxsize = node->size;
+		}
+	}
+
+	return maxsize;
+}
+#endif
+
+#endif /* CONFIG_MM_TLSF */
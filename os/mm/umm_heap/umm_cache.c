@@ -0,0 +1,360 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/umm_heap/umm_cache.c
+ *
+ * Small-object caches in front of the user heap.
+ *
+ * Chunks of up to CONFIG_MM_UMM_CACHE_MAXSIZE bytes that are freed are not
+ * returned to the heap but kept, still allocated from the heap's point of
+ * view, in a list per chunk size class.  There is one set of lists per
+ * priority band so that a busy low priority task cannot starve the cache
+ * of a higher priority one.  A cache hit or a cached free only masks
+ * interrupts for a list push or pop and never waits for the heap
+ * semaphore.  Empty classes are refilled and full classes drained in
+ * batches of CONFIG_MM_UMM_CACHE_BATCH chunks under a single hold of the
+ * heap semaphore.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+
+#include <tinyara/irq.h>
+#include <tinyara/sched.h>
+#include <tinyara/mm/mm.h>
+
+#ifdef CONFIG_MM_UMM_CACHE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define USR_HEAP &g_mmheap
+
+#define UMM_CACHE_NBANDS     CONFIG_MM_UMM_CACHE_NBANDS
+#define UMM_CACHE_BATCH      CONFIG_MM_UMM_CACHE_BATCH
+#define UMM_CACHE_DEPTH      CONFIG_MM_UMM_CACHE_DEPTH
+
+/* Map a task priority to its band and a chunk size to its class */
+
+#define UMM_CACHE_BAND(prio) ((prio) * UMM_CACHE_NBANDS / (SCHED_PRIORITY_MAX + 1))
+#define UMM_CACHE_CLASS(sz)  (((sz) >> MM_MIN_SHIFT) - 1)
+
+#define UMM_CACHE_NODE(mem) \
+	((FAR struct mm_allocnode_s *)((FAR char *)(mem) - SIZEOF_MM_ALLOCNODE))
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* A cached chunk reuses the first word of its payload as the list link */
+
+struct umm_cache_obj_s {
+	FAR struct umm_cache_obj_s *flink;
+};
+
+struct umm_cache_band_s {
+	FAR struct umm_cache_obj_s *head[UMM_CACHE_NCLASSES];
+	struct umm_cache_stats_s stats;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct umm_cache_band_s g_umm_cache[UMM_CACHE_NBANDS];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: umm_cache_band
+ *
+ * Description:
+ *   Return the cache of the priority band of the calling task.
+ *
+ ****************************************************************************/
+
+static FAR struct umm_cache_band_s *umm_cache_band(void)
+{
+	FAR struct tcb_s *tcb = sched_self();
+
+	if (!tcb) {
+		return &g_umm_cache[0];
+	}
+
+	return &g_umm_cache[UMM_CACHE_BAND(tcb->sched_priority)];
+}
+
+/****************************************************************************
+ * Name: umm_cache_release
+ *
+ * Description:
+ *   Return a list of detached chunks to the heap under one hold of the
+ *   heap semaphore.
+ *
+ ****************************************************************************/
+
+static void umm_cache_release(FAR struct umm_cache_obj_s *list)
+{
+	FAR struct umm_cache_obj_s *next;
+
+	mm_takesemaphore(USR_HEAP);
+	while (list) {
+		next = list->flink;
+		mm_free(USR_HEAP, list);
+		list = next;
+	}
+
+	mm_givesemaphore(USR_HEAP);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: umm_cache_malloc
+ *
+ * Description:
+ *   Allocate a small chunk from the cache of the calling task's priority
+ *   band, refilling its size class from the user heap if it is empty.
+ *
+ * Parameters:
+ *   size - Size (in bytes) of the memory region to be allocated.
+ *
+ * Return Value:
+ *   The address of the allocated memory.  NULL if the size is not cached
+ *   or if the heap could not provide a chunk; the caller then falls back
+ *   to mm_malloc().
+ *
+ ****************************************************************************/
+
+FAR void *umm_cache_malloc(size_t size)
+{
+	FAR struct umm_cache_band_s *band;
+	FAR struct umm_cache_obj_s *obj;
+	FAR struct umm_cache_obj_s *list = NULL;
+	FAR struct umm_cache_obj_s *tail = NULL;
+	FAR struct umm_cache_obj_s *extra;
+	irqstate_t flags;
+	size_t chunk;
+	int ndx;
+	int n;
+
+	if (size < 1 || size > CONFIG_MM_UMM_CACHE_MAXSIZE) {
+		return NULL;
+	}
+
+	chunk = MM_ALIGN_UP(size + SIZEOF_MM_ALLOCNODE);
+	ndx = UMM_CACHE_CLASS(chunk);
+	band = umm_cache_band();
+
+	flags = irqsave();
+	obj = band->head[ndx];
+	if (obj) {
+		band->head[ndx] = obj->flink;
+		band->stats.count[ndx]--;
+		band->stats.hits++;
+		irqrestore(flags);
+		return (FAR void *)obj;
+	}
+
+	band->stats.misses++;
+	irqrestore(flags);
+
+	/* The class is empty.  Take one chunk for the caller and a batch for
+	 * the cache while holding the heap semaphore once.  Chunks that came
+	 * out larger than the class (a remainder too small to split) are
+	 * handed back.
+	 */
+
+	mm_takesemaphore(USR_HEAP);
+	obj = (FAR struct umm_cache_obj_s *)mm_malloc(USR_HEAP, chunk - SIZEOF_MM_ALLOCNODE);
+	for (n = 0; obj && n < UMM_CACHE_BATCH - 1; n++) {
+		extra = (FAR struct umm_cache_obj_s *)mm_malloc(USR_HEAP, chunk - SIZEOF_MM_ALLOCNODE);
+		if (!extra) {
+			break;
+		}
+
+		if (UMM_CACHE_NODE(extra)->size != chunk) {
+			mm_free(USR_HEAP, extra);
+			break;
+		}
+
+		extra->flink = list;
+		list = extra;
+		if (!tail) {
+			tail = extra;
+		}
+	}
+
+	mm_givesemaphore(USR_HEAP);
+
+	if (list) {
+		flags = irqsave();
+		tail->flink = band->head[ndx];
+		band->head[ndx] = list;
+		band->stats.count[ndx] += n;
+		band->stats.refills++;
+		irqrestore(flags);
+	}
+
+	return (FAR void *)obj;
+}
+
+/****************************************************************************
+ * Name: umm_cache_free
+ *
+ * Description:
+ *   Keep a freed small chunk in the cache of the calling task's priority
+ *   band.  If its size class is full, a batch of cached chunks is returned
+ *   to the user heap first.
+ *
+ * Parameters:
+ *   mem - The memory to be freed.
+ *
+ * Return Value:
+ *   true if the chunk was taken by the cache, false if it is not a cached
+ *   size and must be released with mm_free().
+ *
+ ****************************************************************************/
+
+bool umm_cache_free(FAR void *mem)
+{
+	FAR struct umm_cache_band_s *band;
+	FAR struct umm_cache_obj_s *obj = (FAR struct umm_cache_obj_s *)mem;
+	FAR struct umm_cache_obj_s *list = NULL;
+	FAR struct umm_cache_obj_s *tail;
+	irqstate_t flags;
+	size_t chunk;
+	int ndx;
+	int n;
+
+	if (!mem) {
+		return false;
+	}
+
+	chunk = UMM_CACHE_NODE(mem)->size;
+	if (chunk > UMM_CACHE_MAXCHUNK) {
+		return false;
+	}
+
+	ndx = UMM_CACHE_CLASS(chunk);
+	band = umm_cache_band();
+
+	flags = irqsave();
+	if (band->stats.count[ndx] >= UMM_CACHE_DEPTH) {
+		/* Detach a batch from the head of the full class */
+
+		list = band->head[ndx];
+		for (tail = list, n = 1; n < UMM_CACHE_BATCH && tail->flink; n++) {
+			tail = tail->flink;
+		}
+
+		band->head[ndx] = tail->flink;
+		tail->flink = NULL;
+		band->stats.count[ndx] -= n;
+		band->stats.drains++;
+	}
+
+	obj->flink = band->head[ndx];
+	band->head[ndx] = obj;
+	band->stats.count[ndx]++;
+	band->stats.frees++;
+	irqrestore(flags);
+
+	if (list) {
+		umm_cache_release(list);
+	}
+
+	return true;
+}
+
+/****************************************************************************
+ * Name: umm_cache_flush
+ *
+ * Description:
+ *   Return every cached chunk of every band to the user heap.  This is
+ *   used when the heap runs out of memory.
+ *
+ * Return Value:
+ *   The number of bytes given back to the heap.
+ *
+ ****************************************************************************/
+
+size_t umm_cache_flush(void)
+{
+	FAR struct umm_cache_band_s *band;
+	FAR struct umm_cache_obj_s *list;
+	irqstate_t flags;
+	size_t total = 0;
+	int i;
+	int ndx;
+
+	for (i = 0; i < UMM_CACHE_NBANDS; i++) {
+		band = &g_umm_cache[i];
+		for (ndx = 0; ndx < UMM_CACHE_NCLASSES; ndx++) {
+			flags = irqsave();
+			list = band->head[ndx];
+			total += (size_t)band->stats.count[ndx] * ((ndx + 1) << MM_MIN_SHIFT);
+			band->head[ndx] = NULL;
+			band->stats.count[ndx] = 0;
+			irqrestore(flags);
+
+			if (list) {
+				umm_cache_release(list);
+			}
+		}
+	}
+
+	return total;
+}
+
+/****************************************************************************
+ * Name: umm_cache_getstats
+ *
+ * Description:
+ *   Take a consistent snapshot of the counters of one priority band.
+ *
+ ****************************************************************************/
+
+void umm_cache_getstats(int band, FAR struct umm_cache_stats_s *stats)
+{
+	irqstate_t flags;
+
+	if (band < 0 || band >= UMM_CACHE_NBANDS) {
+		memset(stats, 0, sizeof(struct umm_cache_stats_s));
+		return;
+	}
+
+	flags = irqsave();
+	memcpy(stats, &g_umm_cache[band].stats, sizeof(struct umm_cache_stats_s));
+	irqrestore(flags);
+}
+
+#endif							/* CONFIG_MM_UMM_CACHE */
@@ -0,0 +1,333 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * mm/umm_heap/umm_cache_procfs.c
+ *
+ * /proc/heapcache shows the counters of the user heap small-object caches:
+ * one line per priority band, then the number of chunks cached in each
+ * size class of every band.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <tinyara/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <tinyara/kmalloc.h>
+#include <tinyara/fs/fs.h>
+#include <tinyara/fs/procfs.h>
+#include <tinyara/mm/mm.h>
+
+#if defined(CONFIG_MM_UMM_CACHE) && !defined(CONFIG_DISABLE_MOUNTPOINT) && defined(CONFIG_FS_PROCFS)
+#ifndef CONFIG_FS_PROCFS_EXCLUDE_HEAPCACHE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Determines the size of an intermediate buffer that must be large enough
+ * to handle the longest line generated by this logic.
+ */
+
+#define HEAPCACHE_LINELEN (8 + 6 * CONFIG_MM_UMM_CACHE_NBANDS + 2)
+
+#if HEAPCACHE_LINELEN < 80
+#undef HEAPCACHE_LINELEN
+#define HEAPCACHE_LINELEN 80
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* This structure describes one open "file" */
+
+struct heapcache_file_s {
+	struct procfs_file_s base;	/* Base open file structure */
+	char line[HEAPCACHE_LINELEN];	/* Pre-allocated buffer for formatted lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* File system methods */
+
+static int heapcache_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode);
+static int heapcache_close(FAR struct file *filep);
+static ssize_t heapcache_read(FAR struct file *filep, FAR char *buffer, size_t buflen);
+
+static int heapcache_dup(FAR const struct file *oldp, FAR struct file *newp);
+
+static int heapcache_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See fs_procfs.c -- this structure is explicitly externed there.
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations heapcache_operations = {
+	heapcache_open,				/* open */
+	heapcache_close,			/* close */
+	heapcache_read,				/* read */
+	NULL,						/* write */
+
+	heapcache_dup,				/* dup */
+
+	NULL,						/* opendir */
+	NULL,						/* closedir */
+	NULL,						/* readdir */
+	NULL,						/* rewinddir */
+
+	heapcache_stat				/* stat */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapcache_open
+ ****************************************************************************/
+
+static int heapcache_open(FAR struct file *filep, FAR const char *relpath, int oflags, mode_t mode)
+{
+	FAR struct heapcache_file_s *attr;
+
+	fvdbg("Open '%s'\n", relpath);
+
+	/* PROCFS is read-only.  Any attempt to open with any kind of write
+	 * access is not permitted.
+	 */
+
+	if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0) {
+		fdbg("ERROR: Only O_RDONLY supported\n");
+		return -EACCES;
+	}
+
+	/* "heapcache" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "heapcache") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* Allocate a container to hold the file attributes */
+
+	attr = (FAR struct heapcache_file_s *)kmm_zalloc(sizeof(struct heapcache_file_s));
+	if (!attr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* Save the attributes as the open-specific state in filep->f_priv */
+
+	filep->f_priv = (FAR void *)attr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: heapcache_close
+ ****************************************************************************/
+
+static int heapcache_close(FAR struct file *filep)
+{
+	FAR struct heapcache_file_s *attr;
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct heapcache_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	/* Release the file attributes structure */
+
+	kmm_free(attr);
+	filep->f_priv = NULL;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: heapcache_read
+ ****************************************************************************/
+
+static ssize_t heapcache_read(FAR struct file *filep, FAR char *buffer, size_t buflen)
+{
+	FAR struct heapcache_file_s *attr;
+	struct umm_cache_stats_s stats;
+	size_t remaining;
+	size_t linesize;
+	size_t copysize;
+	size_t totalsize;
+	size_t cached;
+	off_t offset;
+	int band;
+	int ndx;
+
+	fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+	/* Recover our private data from the struct file instance */
+
+	attr = (FAR struct heapcache_file_s *)filep->f_priv;
+	DEBUGASSERT(attr);
+
+	remaining = buflen;
+	totalsize = 0;
+	offset = filep->f_pos;
+
+	/* One line of counters per priority band */
+
+	linesize = snprintf(attr->line, HEAPCACHE_LINELEN, "%4s %10s %10s %10s %8s %8s %8s\n", "BAND", "HITS", "MISSES", "FREES", "REFILLS", "DRAINS", "CACHED");
+	copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+	totalsize += copysize;
+	buffer += copysize;
+	remaining -= copysize;
+
+	for (band = 0; band < CONFIG_MM_UMM_CACHE_NBANDS && remaining > 0; band++) {
+		umm_cache_getstats(band, &stats);
+
+		cached = 0;
+		for (ndx = 0; ndx < UMM_CACHE_NCLASSES; ndx++) {
+			cached += (size_t)stats.count[ndx] * ((ndx + 1) << MM_MIN_SHIFT);
+		}
+
+		linesize = snprintf(attr->line, HEAPCACHE_LINELEN, "%4d %10u %10u %10u %8u %8u %8u\n", band, (unsigned int)stats.hits, (unsigned int)stats.misses, (unsigned int)stats.frees, (unsigned int)stats.refills, (unsigned int)stats.drains, (unsigned int)cached);
+		copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+		totalsize += copysize;
+		buffer += copysize;
+		remaining -= copysize;
+	}
+
+	/* Then the number of chunks cached per size class, one column per band.
+	 * SIZE is the largest request served by the class.
+	 */
+
+	if (remaining > 0) {
+		linesize = snprintf(attr->line, HEAPCACHE_LINELEN, "\n%7s", "SIZE");
+		for (band = 0; band < CONFIG_MM_UMM_CACHE_NBANDS; band++) {
+			linesize += snprintf(&attr->line[linesize], HEAPCACHE_LINELEN - linesize, " %5d", band);
+		}
+
+		linesize += snprintf(&attr->line[linesize], HEAPCACHE_LINELEN - linesize, "\n");
+		copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+		totalsize += copysize;
+		buffer += copysize;
+		remaining -= copysize;
+	}
+
+	for (ndx = 0; ndx < UMM_CACHE_NCLASSES && remaining > 0; ndx++) {
+		linesize = snprintf(attr->line, HEAPCACHE_LINELEN, "%7d", (int)(((ndx + 1) << MM_MIN_SHIFT) - SIZEOF_MM_ALLOCNODE));
+		for (band = 0; band < CONFIG_MM_UMM_CACHE_NBANDS; band++) {
+			umm_cache_getstats(band, &stats);
+			linesize += snprintf(&attr->line[linesize], HEAPCACHE_LINELEN - linesize, " %5u", (unsigned int)stats.count[ndx]);
+		}
+
+		linesize += snprintf(&attr->line[linesize], HEAPCACHE_LINELEN - linesize, "\n");
+		copysize = procfs_memcpy(attr->line, linesize, buffer, remaining, &offset);
+		totalsize += copysize;
+		buffer += copysize;
+		remaining -= copysize;
+	}
+
+	/* Update the file offset */
+
+	filep->f_pos += totalsize;
+	return totalsize;
+}
+
+/****************************************************************************
+ * Name: heapcache_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int heapcache_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+	FAR struct heapcache_file_s *oldattr;
+	FAR struct heapcache_file_s *newattr;
+
+	fvdbg("Dup %p->%p\n", oldp, newp);
+
+	/* Recover our private data from the old struct file instance */
+
+	oldattr = (FAR struct heapcache_file_s *)oldp->f_priv;
+	DEBUGASSERT(oldattr);
+
+	/* Allocate a new container to hold the task and attribute selection */
+
+	newattr = (FAR struct heapcache_file_s *)kmm_malloc(sizeof(struct heapcache_file_s));
+	if (!newattr) {
+		fdbg("ERROR: Failed to allocate file attributes\n");
+		return -ENOMEM;
+	}
+
+	/* The copy the file attributes from the old attributes to the new */
+
+	memcpy(newattr, oldattr, sizeof(struct heapcache_file_s));
+
+	/* Save the new attributes in the new file structure */
+
+	newp->f_priv = (FAR void *)newattr;
+	return OK;
+}
+
+/****************************************************************************
+ * Name: heapcache_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int heapcache_stat(const char *relpath, struct stat *buf)
+{
+	/* "heapcache" is the only acceptable value for the relpath */
+
+	if (strcmp(relpath, "heapcache") != 0) {
+		fdbg("ERROR: relpath is '%s'\n", relpath);
+		return -ENOENT;
+	}
+
+	/* "heapcache" is the name for a read-only file */
+
+	buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+	buf->st_size = 0;
+	buf->st_blksize = 0;
+	buf->st_blocks = 0;
+	return OK;
+}
+
+#endif							/* CONFIG_FS_PROCFS_EXCLUDE_HEAPCACHE */
+#endif							/* CONFIG_MM_UMM_CACHE && !CONFIG_DISABLE_MOUNTPOINT && CONFIG_FS_PROCFS */
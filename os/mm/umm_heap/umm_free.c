@@ -102,6 +102,14 @@
 
 void free(FAR void *mem)
 {
+#ifdef CONFIG_MM_UMM_CACHE
+	/* Small chunks go back to the size-class caches */
+
+	if (umm_cache_free(mem)) {
+		return;
+	}
+#endif
+
 	mm_free(USR_HEAP, mem);
 }
 
@@ -145,6 +145,23 @@ FAR void *malloc(size_t size)
 		}
 	} while (mem == NULL);
 
+	return mem;
+#elif defined(CONFIG_MM_UMM_CACHE)
+	FAR void *mem;
+
+	/* Small requests are served from the size-class caches.  If the heap
+	 * runs dry, memory sitting in the caches is given back and the
+	 * allocation retried once.
+	 */
+
+	mem = umm_cache_malloc(size);
+	if (!mem) {
+		mem = mm_malloc(USR_HEAP, size);
+		if (!mem && umm_cache_flush() > 0) {
+			mem = mm_malloc(USR_HEAP, size);
+		}
+	}
+
 	return mem;
 #else
 #ifdef CONFIG_DEBUG_MM_HEAPINFO
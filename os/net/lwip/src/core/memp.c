@@ -77,8 +77,16 @@
 
 #include <string.h>
 
+#if MEMP_KMEM_CACHE
+#include <tinyara/mm/kmem_cache.h>
+#endif
+
 #if !MEMP_MEM_MALLOC			/* don't build if not configured for use in lwipopts.h */
 
+#if MEMP_KMEM_CACHE && (MEMP_OVERFLOW_CHECK || MEMP_SEPARATE_POOLS)
+#error MEMP_KMEM_CACHE cannot be used with MEMP_OVERFLOW_CHECK or MEMP_SEPARATE_POOLS
+#endif
+
 struct memp {
 	struct memp *next;
 #if MEMP_OVERFLOW_CHECK
@@ -128,9 +136,14 @@ struct memp {
 
 #endif							/* MEMP_OVERFLOW_CHECK */
 
+#if MEMP_KMEM_CACHE
+/** This array holds the object cache of each pool. */
+static struct kmem_cache_s *memp_cache[MEMP_MAX];
+#else
 /** This array holds the first free element of each pool.
  *  Elements form a linked list. */
 static struct memp *memp_tab[MEMP_MAX];
+#endif							/* MEMP_KMEM_CACHE */
 
 #else							/* MEMP_MEM_MALLOC */
 
@@ -156,14 +169,18 @@ static const u16_t memp_num[MEMP_MAX] = {
 };
 
 /** This array holds a textual description of each pool. */
-#ifdef LWIP_DEBUG
+#if defined(LWIP_DEBUG) || MEMP_KMEM_CACHE
 static const char *memp_desc[MEMP_MAX] = {
 #define LWIP_MEMPOOL(name, num, size, desc)  (desc),
 #include <net/lwip/memp_std.h>
 };
-#endif							/* LWIP_DEBUG */
+#endif							/* LWIP_DEBUG || MEMP_KMEM_CACHE */
 
-#if MEMP_SEPARATE_POOLS
+#if MEMP_KMEM_CACHE
+
+/* The elements of each pool are preallocated by its object cache */
+
+#elif MEMP_SEPARATE_POOLS
 
 /** This creates each memory pool. These are named memp_memory_XXX_base (where
  * XXX is the name of the pool defined in memp_std.h).
@@ -190,7 +207,7 @@ static u8_t memp_memory[MEM_ALIGNMENT - 1
 
 #endif							/* MEMP_SEPARATE_POOLS */
 
-#if MEMP_SANITY_CHECK
+#if MEMP_SANITY_CHECK && !MEMP_KMEM_CACHE
 /**
  * Check that memp-lists don't form a circle, using "Floyd's cycle-finding algorithm".
  */
@@ -211,7 +228,7 @@ static int memp_sanity(void)
 	}
 	return 1;
 }
-#endif							/* MEMP_SANITY_CHECK */
+#endif							/* MEMP_SANITY_CHECK && !MEMP_KMEM_CACHE */
 #if MEMP_OVERFLOW_CHECK
 #if defined(LWIP_DEBUG) && MEMP_STATS
 static const char *memp_overflow_names[] = {
@@ -346,8 +363,12 @@ static void memp_overflow_init(void)
  */
 void memp_init(void)
 {
+#if MEMP_KMEM_CACHE
+	u16_t i;
+#else
 	struct memp *memp;
 	u16_t i, j;
+#endif
 
 	for (i = 0; i < MEMP_MAX; ++i) {
 		MEMP_STATS_AVAIL(used, i, 0);
@@ -356,6 +377,15 @@ void memp_init(void)
 		MEMP_STATS_AVAIL(avail, i, memp_num[i]);
 	}
 
+#if MEMP_KMEM_CACHE
+	/* for every pool: create its object cache */
+	for (i = 0; i < MEMP_MAX; ++i) {
+		if (memp_num[i] > 0) {
+			memp_cache[i] = kmem_cache_create(memp_desc[i], memp_sizes[i], memp_num[i], 0, NULL);
+			LWIP_ASSERT("memp_init: failed to create pool cache", memp_cache[i] != NULL);
+		}
+	}
+#else							/* MEMP_KMEM_CACHE */
 #if !MEMP_SEPARATE_POOLS
 	memp = (struct memp *)LWIP_MEM_ALIGN(memp_memory);
 #endif							/* !MEMP_SEPARATE_POOLS */
@@ -381,6 +411,7 @@ void memp_init(void)
 	/* check everything a first time to see if it worked */
 	memp_overflow_check_all();
 #endif							/* MEMP_OVERFLOW_CHECK */
+#endif							/* MEMP_KMEM_CACHE */
 }
 
 /**
@@ -411,6 +442,17 @@ memp_malloc_fn(memp_t type, const char *file, const int line)
 	memp_overflow_check_all();
 #endif							/* MEMP_OVERFLOW_CHECK >= 2 */
 
+#if MEMP_KMEM_CACHE
+	memp = memp_cache[type] ? (struct memp *)kmem_cache_alloc(memp_cache[type]) : NULL;
+
+	if (memp != NULL) {
+		MEMP_STATS_INC_USED(used, type);
+		LWIP_ASSERT("memp_malloc: memp properly aligned", ((mem_ptr_t)memp % MEM_ALIGNMENT) == 0);
+	} else {
+		LWIP_DEBUGF(MEMP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("memp_malloc: out of memory in pool %s\n", memp_desc[type]));
+		MEMP_STATS_INC(err, type);
+	}
+#else							/* MEMP_KMEM_CACHE */
 	memp = memp_tab[type];
 
 	if (memp != NULL) {
@@ -427,6 +469,7 @@ memp_malloc_fn(memp_t type, const char *file, const int line)
 		LWIP_DEBUGF(MEMP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("memp_malloc: out of memory in pool %s\n", memp_desc[type]));
 		MEMP_STATS_INC(err, type);
 	}
+#endif							/* MEMP_KMEM_CACHE */
 
 	SYS_ARCH_UNPROTECT(old_level);
 
@@ -463,12 +506,16 @@ void memp_free(memp_t type, void *mem)
 
 	MEMP_STATS_DEC(used, type);
 
+#if MEMP_KMEM_CACHE
+	kmem_cache_free(memp_cache[type], memp);
+#else							/* MEMP_KMEM_CACHE */
 	memp->next = memp_tab[type];
 	memp_tab[type] = memp;
+#endif							/* MEMP_KMEM_CACHE */
 
-#if MEMP_SANITY_CHECK
+#if MEMP_SANITY_CHECK && !MEMP_KMEM_CACHE
 	LWIP_ASSERT("memp sanity", memp_sanity());
-#endif							/* MEMP_SANITY_CHECK */
+#endif							/* MEMP_SANITY_CHECK && !MEMP_KMEM_CACHE */
 
 	SYS_ARCH_UNPROTECT(old_level);
 }
@@ -103,6 +103,7 @@
 
 #include <tinyara/errno.h>
 #include <tinyara/clock.h>
+#include <tinyara/wqueue.h>
 
 /* clock_systimer is a special case:  In the kernel build, proxying for
  * clock_systimer() must be handled specially.  In the kernel phase of
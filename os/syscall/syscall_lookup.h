@@ -330,6 +330,12 @@ SYSCALL_LOOKUP(socket,                  3, STUB_socket)
 SYSCALL_LOOKUP(prctl,                   5, STUB_prctl)
 #endif
 
+/* The following is defined only if the work queue statistics are enabled */
+
+#ifdef CONFIG_SCHED_WORKQUEUE_STATS
+SYSCALL_LOOKUP(work_stats_record,       4, STUB_work_stats_record)
+#endif
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
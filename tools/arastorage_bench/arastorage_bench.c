@@ -0,0 +1,691 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * tools/arastorage_bench/arastorage_bench.c
+ *
+ * Runs workloads against ARAStorage built for the host, where its files
+ * are kept in CONFIG_MOUNT_POINT through the POSIX calls of
+ * storage_abstraction.c. For each workload it reports the throughput,
+ * latency percentiles, the bytes written to files and the peak heap.
+ *
+ * write() and the heap functions are wrapped at link time (see Makefile),
+ * so only the calls made by ARAStorage itself are accounted for.
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <tinyara/config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <malloc.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <arastorage/arastorage.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define RELATION_NAME   "bench"
+#define QUERY_LENGTH    128
+
+/* Number of distinct values of the v attribute, which removals select */
+#define VALUE_CLASSES   10
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+struct bench_options_s {
+	int rows;					/* Rows inserted */
+	int queries;				/* Queries run by the select workloads */
+	int range;					/* Number of ids selected by a range query */
+	int removals;				/* Value classes removed, one per REMOVE */
+	const char *index;			/* Index type of the id attribute */
+	const char *type;			/* Relation type, NULL for the row layout */
+	bool text;					/* Parse every query instead of preparing it */
+	bool crash;					/* Check the recovery from a power cut instead */
+	unsigned seed;
+};
+
+struct bench_result_s {
+	const char *name;
+	int ops;
+	int failed;
+	double seconds;
+	unsigned long long *latency;	/* Nanoseconds of each operation */
+	long long bytes_written;
+	long long peak_heap;
+};
+
+typedef void (*bench_workload_t)(struct bench_options_s *, struct bench_result_s *);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static long long g_bytes_written;
+static long long g_heap_used;
+static long long g_heap_peak;
+
+/****************************************************************************
+ * Link-time Wrappers
+ ****************************************************************************/
+ssize_t __real_write(int fd, const void *buffer, size_t length);
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static void heap_account(long long delta)
+{
+	long long used;
+	long long peak;
+
+	used = __atomic_add_fetch(&g_heap_used, delta, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(&g_heap_peak, __ATOMIC_RELAXED);
+	while (used > peak && !__atomic_compare_exchange_n(&g_heap_peak, &peak, used, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+ssize_t __wrap_write(int fd, const void *buffer, size_t length)
+{
+	ssize_t r;
+
+	r = __real_write(fd, buffer, length);
+	if (r > 0 && fd > STDERR_FILENO) {
+		__atomic_add_fetch(&g_bytes_written, r, __ATOMIC_RELAXED);
+	}
+	return r;
+}
+
+void *__wrap_malloc(size_t size)
+{
+	void *ptr;
+
+	ptr = __real_malloc(size);
+	if (ptr != NULL) {
+		heap_account(malloc_usable_size(ptr));
+	}
+	return ptr;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	ptr = __real_calloc(nmemb, size);
+	if (ptr != NULL) {
+		heap_account(malloc_usable_size(ptr));
+	}
+	return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	size_t old;
+	void *new;
+
+	old = ptr != NULL ? malloc_usable_size(ptr) : 0;
+	new = __real_realloc(ptr, size);
+	if (new != NULL) {
+		heap_account((long long)malloc_usable_size(new) - (long long)old);
+	} else if (size == 0) {
+		heap_account(-(long long)old);
+	}
+	return new;
+}
+
+void __wrap_free(void *ptr)
+{
+	if (ptr != NULL) {
+		heap_account(-(long long)malloc_usable_size(ptr));
+	}
+	__real_free(ptr);
+}
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static unsigned long long bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_begin(struct bench_result_s *result, const char *name, int ops)
+{
+	memset(result, 0, sizeof(struct bench_result_s));
+	result->name = name;
+	result->latency = __real_calloc(ops > 0 ? ops : 1, sizeof(unsigned long long));
+	if (result->latency == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	result->bytes_written = g_bytes_written;
+	__atomic_store_n(&g_heap_peak, g_heap_used, __ATOMIC_RELAXED);
+}
+
+/* Accounts for one operation which started at start */
+static void bench_record(struct bench_result_s *result, unsigned long long start, db_result_t res)
+{
+	unsigned long long elapsed;
+
+	elapsed = bench_now() - start;
+	result->latency[result->ops++] = elapsed;
+	result->seconds += elapsed / 1e9;
+	if (DB_ERROR(res)) {
+		result->failed++;
+	}
+}
+
+static void bench_end(struct bench_result_s *result)
+{
+	result->bytes_written = g_bytes_written - result->bytes_written;
+	result->peak_heap = g_heap_peak;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double bench_percentile(struct bench_result_s *result, int percent)
+{
+	int i;
+
+	i = (result->ops * percent + 99) / 100 - 1;
+	if (i < 0) {
+		i = 0;
+	}
+	return result->latency[i] / 1e3;
+}
+
+static void bench_print_header(void)
+{
+	printf("%-10s %7s %6s %10s %10s %10s %10s %10s %12s %10s\n", "workload", "ops", "fail", "ops/s", "p50(us)", "p90(us)", "p99(us)", "max(us)", "written(B)", "heap(B)");
+}
+
+static void bench_print(struct bench_result_s *result)
+{
+	if (result->ops == 0) {
+		printf("%-10s %7d\n", result->name, 0);
+		return;
+	}
+	qsort(result->latency, result->ops, sizeof(unsigned long long), bench_compare);
+	printf("%-10s %7d %6d %10.0f %10.1f %10.1f %10.1f %10.1f %12lld %10lld\n", result->name, result->ops, result->failed, result->seconds > 0 ? result->ops / result->seconds : 0, bench_percentile(result, 50), bench_percentile(result, 90), bench_percentile(result, 99), result->latency[result->ops - 1] / 1e3, result->bytes_written, result->peak_heap);
+}
+
+/* Bytes used by the files of the database */
+static long long bench_footprint(void)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	struct stat st;
+	long long total = 0;
+	DIR *dir;
+
+	dir = opendir(CONFIG_MOUNT_POINT);
+	if (dir == NULL) {
+		return 0;
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		snprintf(path, sizeof(path), "%s%s", CONFIG_MOUNT_POINT, entry->d_name);
+		if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+			total += st.st_size;
+		}
+	}
+	closedir(dir);
+	return total;
+}
+
+static void bench_clean(void)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	DIR *dir;
+
+	mkdir(CONFIG_MOUNT_POINT, 0755);
+	dir = opendir(CONFIG_MOUNT_POINT);
+	if (dir == NULL) {
+		fprintf(stderr, "Cannot open %s\n", CONFIG_MOUNT_POINT);
+		exit(EXIT_FAILURE);
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		snprintf(path, sizeof(path), "%s%s", CONFIG_MOUNT_POINT, entry->d_name);
+		unlink(path);
+	}
+	closedir(dir);
+}
+
+/* Runs a query on ids from to, through a prepared statement unless text is set */
+static db_result_t bench_select(struct bench_options_s *options, db_stmt_t *stmt, const char *format, int from, int to)
+{
+	char query[QUERY_LENGTH];
+	db_cursor_t *cursor = NULL;
+	db_result_t res;
+
+	if (options->text) {
+		snprintf(query, QUERY_LENGTH, format, from, to);
+		cursor = db_query(query);
+		res = cursor != NULL ? DB_OK : DB_STORAGE_ERROR;
+	} else {
+		db_bind_int(stmt, 0, from);
+		if (to > from) {
+			db_bind_int(stmt, 1, to);
+		}
+		res = db_step(stmt, &cursor);
+	}
+	if (cursor != NULL) {
+		db_cursor_free(cursor);
+	}
+	return res;
+}
+
+static void bench_insert(struct bench_options_s *options, struct bench_result_s *result)
+{
+	char query[QUERY_LENGTH];
+	unsigned long long start;
+	db_stmt_t *stmt = NULL;
+	db_result_t res;
+	int i;
+
+	bench_begin(result, "insert", options->rows);
+	if (!options->text) {
+		stmt = db_prepare("INSERT (?, ?, ?) INTO " RELATION_NAME ";");
+		if (stmt == NULL) {
+			fprintf(stderr, "db_prepare failed\n");
+			return;
+		}
+	}
+	for (i = 0; i < options->rows; i++) {
+		start = bench_now();
+		if (options->text) {
+			snprintf(query, QUERY_LENGTH, "INSERT (%d, %d, %ld) INTO " RELATION_NAME ";", i, i % VALUE_CLASSES, 1000000L + i * 10L);
+			res = db_exec(query);
+		} else {
+			db_bind_int(stmt, 0, i);
+			db_bind_int(stmt, 1, i % VALUE_CLASSES);
+			db_bind_long(stmt, 2, 1000000L + i * 10L);
+			res = db_step(stmt, NULL);
+		}
+		bench_record(result, start, res);
+	}
+	if (stmt != NULL) {
+		db_finalize(stmt);
+	}
+	db_flush();
+	bench_end(result);
+}
+
+static void bench_point(struct bench_options_s *options, struct bench_result_s *result)
+{
+	const char *format = "SELECT id, v FROM " RELATION_NAME " WHERE id = %d;";
+	unsigned long long start;
+	db_stmt_t *stmt = NULL;
+	db_result_t res;
+	int id;
+	int i;
+
+	bench_begin(result, "point", options->queries);
+	if (!options->text) {
+		stmt = db_prepare("SELECT id, v FROM " RELATION_NAME " WHERE id = ?;");
+		if (stmt == NULL) {
+			fprintf(stderr, "db_prepare failed\n");
+			return;
+		}
+	}
+	for (i = 0; i < options->queries; i++) {
+		id = rand() % options->rows;
+		start = bench_now();
+		res = bench_select(options, stmt, format, id, id);
+		bench_record(result, start, res);
+	}
+	if (stmt != NULL) {
+		db_finalize(stmt);
+	}
+	bench_end(result);
+}
+
+static void bench_range(struct bench_options_s *options, struct bench_result_s *result)
+{
+	const char *format = "SELECT id, v FROM " RELATION_NAME " WHERE id >= %d AND id < %d;";
+	unsigned long long start;
+	db_stmt_t *stmt = NULL;
+	db_result_t res;
+	int from;
+	int i;
+
+	bench_begin(result, "range", options->queries);
+	if (!options->text) {
+		stmt = db_prepare("SELECT id, v FROM " RELATION_NAME " WHERE id >= ? AND id < ?;");
+		if (stmt == NULL) {
+			fprintf(stderr, "db_prepare failed\n");
+			return;
+		}
+	}
+	for (i = 0; i < options->queries; i++) {
+		from = rand() % options->rows;
+		start = bench_now();
+		res = bench_select(options, stmt, format, from, from + options->range);
+		bench_record(result, start, res);
+	}
+	if (stmt != NULL) {
+		db_finalize(stmt);
+	}
+	bench_end(result);
+}
+
+static void bench_aggregate(struct bench_options_s *options, struct bench_result_s *result)
+{
+	unsigned long long start;
+	db_cursor_t *cursor;
+	int i;
+
+	bench_begin(result, "aggregate", options->queries);
+	for (i = 0; i < options->queries; i++) {
+		start = bench_now();
+		cursor = db_query("SELECT COUNT(id), SUM(v), MAX(t) FROM " RELATION_NAME ";");
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		bench_record(result, start, cursor != NULL ? DB_OK : DB_STORAGE_ERROR);
+	}
+	bench_end(result);
+}
+
+/* Each removal drops a tenth of the rows, and vacuums the relation */
+static void bench_remove(struct bench_options_s *options, struct bench_result_s *result)
+{
+	char query[QUERY_LENGTH];
+	unsigned long long start;
+	db_cursor_t *cursor;
+	int i;
+
+	bench_begin(result, "remove", options->removals);
+	for (i = 0; i < options->removals; i++) {
+		snprintf(query, QUERY_LENGTH, "REMOVE FROM " RELATION_NAME " WHERE v = %d;", i);
+		start = bench_now();
+		cursor = db_query(query);
+		if (cursor != NULL) {
+			db_cursor_free(cursor);
+		}
+		db_flush();
+		bench_record(result, start, cursor != NULL ? DB_OK : DB_STORAGE_ERROR);
+	}
+	bench_end(result);
+}
+
+static db_result_t bench_setup(struct bench_options_s *options)
+{
+	char query[QUERY_LENGTH];
+	db_result_t res;
+
+	if (options->type != NULL) {
+		snprintf(query, QUERY_LENGTH, "CREATE RELATION " RELATION_NAME " TYPE %s;", options->type);
+	} else {
+		snprintf(query, QUERY_LENGTH, "CREATE RELATION " RELATION_NAME ";");
+	}
+	res = db_exec(query);
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE id DOMAIN INT IN " RELATION_NAME ";");
+	}
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE v DOMAIN INT IN " RELATION_NAME ";");
+	}
+	if (DB_SUCCESS(res)) {
+		res = db_exec("CREATE ATTRIBUTE t DOMAIN LONG IN " RELATION_NAME ";");
+	}
+	if (DB_SUCCESS(res) && options->index != NULL) {
+		snprintf(query, QUERY_LENGTH, "CREATE INDEX " RELATION_NAME ".id TYPE %s;", options->index);
+		res = db_exec(query);
+	}
+	return res;
+}
+
+/* Number of rows whose id is id, 0 for an empty result */
+static int bench_count_id(int id)
+{
+	char query[QUERY_LENGTH];
+	db_cursor_t *cursor;
+	int count;
+
+	snprintf(query, QUERY_LENGTH, "SELECT id FROM " RELATION_NAME " WHERE id = %d;", id);
+	cursor = db_query(query);
+	if (cursor == NULL) {
+		return 0;
+	}
+	count = cursor_get_count(cursor);
+	db_cursor_free(cursor);
+	/* An empty cursor reports INVALID_CURSOR_VALUE rather than 0 */
+	return count < 0 ? 0 : count;
+}
+
+/*
+ * Inserts the rows in a child process which exits without db_deinit(),
+ * as at a power cut, then checks what db_init() recovers from the log:
+ * every id up to the last committed group is found exactly once through
+ * the index, and the lost rows can be inserted again.
+ */
+static int bench_crash(struct bench_options_s *options)
+{
+#ifdef CONFIG_ARASTORAGE_ENABLE_WAL
+	char query[QUERY_LENGTH];
+	db_cursor_t *cursor;
+	pid_t pid;
+	int status;
+	int rows;
+	int i;
+
+	bench_clean();
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "fork failed\n");
+		return EXIT_FAILURE;
+	}
+	if (pid == 0) {
+		if (DB_ERROR(db_init()) || DB_ERROR(bench_setup(options))) {
+			_exit(EXIT_FAILURE);
+		}
+		for (i = 0; i < options->rows; i++) {
+			snprintf(query, QUERY_LENGTH, "INSERT (%d, %d, %ld) INTO " RELATION_NAME ";", i, i % VALUE_CLASSES, 1000000L + i * 10L);
+			if (DB_ERROR(db_exec(query))) {
+				_exit(EXIT_FAILURE);
+			}
+		}
+		/* No db_deinit(): the insert buffer, the page cache and the pending log records are lost */
+		_exit(EXIT_SUCCESS);
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		fprintf(stderr, "The inserting process failed\n");
+		return EXIT_FAILURE;
+	}
+
+	if (DB_ERROR(db_init())) {
+		fprintf(stderr, "db_init failed after the power cut\n");
+		return EXIT_FAILURE;
+	}
+	cursor = db_query("SELECT id FROM " RELATION_NAME ";");
+	rows = cursor != NULL ? cursor_get_count(cursor) : 0;
+	if (cursor != NULL) {
+		db_cursor_free(cursor);
+	}
+	if (rows < 0) {
+		rows = 0;
+	}
+	printf("crash: %d of %d rows recovered\n", rows, options->rows);
+	if (rows > options->rows || options->rows - rows >= CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_COUNT) {
+		fprintf(stderr, "Committed rows were lost\n");
+		goto failed;
+	}
+	for (i = 0; i < options->rows; i++) {
+		if (bench_count_id(i) != (i < rows)) {
+			fprintf(stderr, "id %d is found %d times\n", i, bench_count_id(i));
+			goto failed;
+		}
+	}
+	for (i = rows; i < options->rows; i++) {
+		snprintf(query, QUERY_LENGTH, "INSERT (%d, %d, %ld) INTO " RELATION_NAME ";", i, i % VALUE_CLASSES, 1000000L + i * 10L);
+		if (DB_ERROR(db_exec(query)) || bench_count_id(i) != 1) {
+			fprintf(stderr, "Failed to insert id %d again\n", i);
+			goto failed;
+		}
+	}
+	printf("crash: recovered rows and index are consistent\n");
+	db_deinit();
+	return EXIT_SUCCESS;
+
+failed:
+	db_deinit();
+	return EXIT_FAILURE;
+#else
+	fprintf(stderr, "The recovery needs WAL in FEATURES\n");
+	return EXIT_FAILURE;
+#endif
+}
+
+static void bench_usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [options]\n", progname);
+	fprintf(stderr, "  -n rows      rows inserted (default 1000)\n");
+	fprintf(stderr, "  -q queries   queries per select workload (default 200)\n");
+	fprintf(stderr, "  -r range     ids selected by a range query (default 10)\n");
+	fprintf(stderr, "  -d removals  value classes removed, 0 to %d (default 5)\n", VALUE_CLASSES);
+	fprintf(stderr, "  -i index     index of id: INLINE, BTREE, HASH or BPLUSTREE\n");
+	fprintf(stderr, "  -t type      relation type: COLUMNAR or MEMORY\n");
+	fprintf(stderr, "  -w list      workloads among insert,point,range,aggregate,remove\n");
+	fprintf(stderr, "  -e           parse every query instead of preparing it\n");
+	fprintf(stderr, "  -s seed      seed of the query keys (default 1)\n");
+	fprintf(stderr, "  -c           check the recovery from a power cut after inserting\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		bench_workload_t run;
+	} workloads[] = {
+		{ "insert", bench_insert },
+		{ "point", bench_point },
+		{ "range", bench_range },
+		{ "aggregate", bench_aggregate },
+		{ "remove", bench_remove },
+	};
+	struct bench_options_s options;
+	struct bench_result_s result;
+	const char *selected = "insert,point,range,aggregate,remove";
+	int opt;
+	int i;
+
+	memset(&options, 0, sizeof(options));
+	options.rows = 1000;
+	options.queries = 200;
+	options.range = 10;
+	options.removals = 5;
+	options.seed = 1;
+
+	while ((opt = getopt(argc, argv, "n:q:r:d:i:t:w:es:ch")) != -1) {
+		switch (opt) {
+		case 'n':
+			options.rows = atoi(optarg);
+			break;
+		case 'q':
+			options.queries = atoi(optarg);
+			break;
+		case 'r':
+			options.range = atoi(optarg);
+			break;
+		case 'd':
+			options.removals = atoi(optarg);
+			break;
+		case 'i':
+			options.index = optarg;
+			break;
+		case 't':
+			options.type = optarg;
+			break;
+		case 'w':
+			selected = optarg;
+			break;
+		case 'e':
+			options.text = true;
+			break;
+		case 's':
+			options.seed = (unsigned)strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			options.crash = true;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (options.rows <= 0 || options.queries < 0 || options.range <= 0 || options.removals < 0 || options.removals > VALUE_CLASSES) {
+		bench_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (options.rows > CONFIG_DB_TUPLES_LIMIT) {
+		fprintf(stderr, "At most %d rows, see CONFIG_DB_TUPLES_LIMIT\n", CONFIG_DB_TUPLES_LIMIT);
+		return EXIT_FAILURE;
+	}
+	srand(options.seed);
+
+	if (options.crash) {
+		return bench_crash(&options);
+	}
+
+	bench_clean();
+	if (DB_ERROR(db_init())) {
+		fprintf(stderr, "db_init failed\n");
+		return EXIT_FAILURE;
+	}
+	if (DB_ERROR(bench_setup(&options))) {
+		fprintf(stderr, "Failed to create the relation\n");
+		db_deinit();
+		return EXIT_FAILURE;
+	}
+
+	printf("rows %d, index %s, type %s, %s queries, files in %s\n", options.rows, options.index != NULL ? options.index : "NONE", options.type != NULL ? options.type : "ROW", options.text ? "parsed" : "prepared", CONFIG_MOUNT_POINT);
+	bench_print_header();
+	for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+		const char *found = strstr(selected, workloads[i].name);
+
+		if (found == NULL) {
+			continue;
+		}
+		workloads[i].run(&options, &result);
+		bench_print(&result);
+		__real_free(result.latency);
+	}
+	printf("footprint %lld bytes, heap in use %lld bytes\n", bench_footprint(), g_heap_used);
+
+	db_deinit();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * tools/arastorage_bench/include/crc32.h
+ *
+ * Bitwise equivalent of lib/libc/misc/lib_crc32.c, so that the host and the
+ * board compute the same checksums in the write-ahead log.
+ ****************************************************************************/
+
+#ifndef __TOOLS_ARASTORAGE_BENCH_INCLUDE_CRC32_H
+#define __TOOLS_ARASTORAGE_BENCH_INCLUDE_CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline uint32_t crc32part(const uint8_t *src, size_t len, uint32_t crc32val)
+{
+	int i;
+
+	while (len--) {
+		crc32val ^= *src++;
+		for (i = 0; i < 8; i++) {
+			crc32val = (crc32val >> 1) ^ (0xedb88320 & -(crc32val & 1));
+		}
+	}
+	return crc32val;
+}
+
+static inline uint32_t crc32(const uint8_t *src, size_t len)
+{
+	return crc32part(src, len, 0);
+}
+
+#endif							/* __TOOLS_ARASTORAGE_BENCH_INCLUDE_CRC32_H */
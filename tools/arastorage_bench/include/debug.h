@@ -0,0 +1,33 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * tools/arastorage_bench/include/debug.h
+ *
+ * Stands in for the TinyAra debug.h, which ARAStorage includes but whose
+ * macros it does not use.
+ ****************************************************************************/
+
+#ifndef __TOOLS_ARASTORAGE_BENCH_INCLUDE_DEBUG_H
+#define __TOOLS_ARASTORAGE_BENCH_INCLUDE_DEBUG_H
+
+#include <stdio.h>
+
+#define dbg(format, ...)    fprintf(stderr, format, ##__VA_ARGS__)
+#define lldbg(format, ...)  fprintf(stderr, format, ##__VA_ARGS__)
+
+#endif							/* __TOOLS_ARASTORAGE_BENCH_INCLUDE_DEBUG_H */
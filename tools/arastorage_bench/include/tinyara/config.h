@@ -0,0 +1,136 @@
+/****************************************************************************
+ *
+ * Copyright 2016 Samsung Electronics All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+ ****************************************************************************/
+/****************************************************************************
+ * tools/arastorage_bench/include/tinyara/config.h
+ *
+ * Configuration of ARAStorage for the host benchmark. The values default
+ * to those of framework/src/arastorage/Kconfig, and any of them can be
+ * overridden from the make command line. The optional features are
+ * selected through FEATURES in the Makefile.
+ ****************************************************************************/
+
+#ifndef __TOOLS_ARASTORAGE_BENCH_INCLUDE_TINYARA_CONFIG_H
+#define __TOOLS_ARASTORAGE_BENCH_INCLUDE_TINYARA_CONFIG_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <float.h>
+#include <string.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Definitions which TinyAra provides through its own system headers */
+#define OK                                   0
+#define TRUE                                 1
+#define FALSE                                0
+#define FAR
+#define O_WROK                               O_WRONLY
+
+/* The TinyAra libc has strlcpy(), glibc only since 2.38 */
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+static inline size_t bench_strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t length = strlen(src);
+
+	if (size > 0) {
+		size_t n = length < size - 1 ? length : size - 1;
+
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return length;
+}
+#define strlcpy                              bench_strlcpy
+#endif
+
+#define CONFIG_ARASTORAGE                    1
+#define CONFIG_HAVE_DOUBLE                   1
+#define CONFIG_ARCH_FLOAT_H                  1
+
+/* Files are kept in this directory of the host, which is emptied first */
+#ifndef CONFIG_MOUNT_POINT
+#define CONFIG_MOUNT_POINT                   "/tmp/arastorage_bench/"
+#endif
+
+#ifndef CONFIG_NODE_LIMIT
+#define CONFIG_NODE_LIMIT                    110
+#endif
+#ifndef CONFIG_BUCKETS_LIMIT
+#define CONFIG_BUCKETS_LIMIT                 80
+#endif
+#ifndef CONFIG_BRANCH_FACTOR
+#define CONFIG_BRANCH_FACTOR                 5
+#endif
+#ifndef CONFIG_DB_TUPLES_LIMIT
+#define CONFIG_DB_TUPLES_LIMIT               100000
+#endif
+#ifndef CONFIG_ARASTORAGE_BTREE_ORDER
+#define CONFIG_ARASTORAGE_BTREE_ORDER        16
+#endif
+#ifndef CONFIG_ARASTORAGE_HASH_BUCKET_SIZE
+#define CONFIG_ARASTORAGE_HASH_BUCKET_SIZE   16
+#endif
+#ifndef CONFIG_ARASTORAGE_HASH_MAX_DEPTH
+#define CONFIG_ARASTORAGE_HASH_MAX_DEPTH     8
+#endif
+#ifndef CONFIG_ARASTORAGE_VACUUM_THRESHOLD
+#define CONFIG_ARASTORAGE_VACUUM_THRESHOLD   40
+#endif
+#ifndef CONFIG_ARASTORAGE_PAGE_SIZE
+#define CONFIG_ARASTORAGE_PAGE_SIZE          512
+#endif
+#ifndef CONFIG_ARASTORAGE_PAGE_CACHE_SIZE
+#define CONFIG_ARASTORAGE_PAGE_CACHE_SIZE    8192
+#endif
+#ifndef CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_COUNT
+#define CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_COUNT 16
+#endif
+#ifndef CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_MS
+#define CONFIG_ARASTORAGE_WAL_GROUP_COMMIT_MS 100
+#endif
+#ifndef CONFIG_ARASTORAGE_WAL_BUFFER_SIZE
+#define CONFIG_ARASTORAGE_WAL_BUFFER_SIZE    1024
+#endif
+#ifndef CONFIG_ARASTORAGE_WAL_CHECKPOINT_SIZE
+#define CONFIG_ARASTORAGE_WAL_CHECKPOINT_SIZE 16384
+#endif
+#ifndef CONFIG_ARASTORAGE_COLUMN_BLOCK_ROWS
+#define CONFIG_ARASTORAGE_COLUMN_BLOCK_ROWS  64
+#endif
+#ifndef CONFIG_ARASTORAGE_MEMORY_SIZE
+#define CONFIG_ARASTORAGE_MEMORY_SIZE        (1024 * 1024)
+#endif
+#ifndef CONFIG_ARASTORAGE_MEMORY_CHUNK_SIZE
+#define CONFIG_ARASTORAGE_MEMORY_CHUNK_SIZE  256
+#endif
+
+/* The host paths are longer than those of the board */
+#define DB_MAX_FILENAME_LENGTH               64
+
+/* LVM operands take twice as much space with the 64-bit long of the host */
+#define DB_VM_BYTECODE_SIZE                  128
+
+#endif							/* __TOOLS_ARASTORAGE_BENCH_INCLUDE_TINYARA_CONFIG_H */
@@ -0,0 +1,159 @@
+#!/usr/bin/env python
+###########################################################################
+#
+# Copyright 2016 Samsung Electronics All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+# either express or implied. See the License for the specific
+# language governing permissions and limitations under the License.
+#
+###########################################################################
+#
+# heapflame.py turns a dump of /proc/heap into folded stacks or into an
+# SVG flame graph of the heap usage per call site.
+#
+# Example: heapflame.py -f heap.txt -e build/output/bin/tinyara -m live -s heap.svg
+
+import sys
+import subprocess
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("-f", "--file", dest="infilename", help="dump of /proc/heap to be parsed", metavar="INPUT_FILE")
+parser.add_option("-e", "--elf", dest="elf", help="ELF image used to symbolize the call sites with addr2line", metavar="ELF")
+parser.add_option("-m", "--mode", dest="mode", default="live", help="live: bytes held per call site, peak: highest bytes held per call site, alloc: bytes allocated per task and call site by the recorded events. Default is live.")
+parser.add_option("-o", "--output", dest="output", help="Folded stacks written to this file. Default is stdout.", metavar="OUTPUT_FILE")
+parser.add_option("-s", "--svg", dest="svg", help="Flame graph written to this file.", metavar="SVG_FILE")
+parser.add_option("-a", "--addr2line", dest="addr2line", default="arm-none-eabi-addr2line", help="addr2line of the toolchain. Default is arm-none-eabi-addr2line.")
+
+(options, args) = parser.parse_args()
+if not options.infilename or options.mode not in ("live", "peak", "alloc"):
+	parser.print_help()
+	sys.exit(1)
+
+###########################################################################
+# Parse the dump
+###########################################################################
+
+summary = {}
+callers = []
+events = []
+
+section = "summary"
+for line in open(options.infilename):
+	fields = line.split()
+	if not fields:
+		continue
+	if fields[0] in ("SIZE", "CALLER", "SEQ"):
+		section = fields[0]
+		continue
+	if section == "summary" and len(fields) == 2:
+		summary[fields[0]] = int(fields[1])
+	elif section == "CALLER" and len(fields) == 5:
+		callers.append((int(fields[0], 16), int(fields[1]), int(fields[3])))
+	elif section == "SEQ" and len(fields) == 7:
+		events.append((fields[1], int(fields[3]), int(fields[4], 16), int(fields[5])))
+
+###########################################################################
+# Symbolize the call sites
+###########################################################################
+
+symbols = {0: "other"}
+
+addrs = set([c[0] for c in callers] + [e[2] for e in events])
+addrs.discard(0)
+for addr in addrs:
+	symbols[addr] = "0x%08x" % addr
+
+if options.elf and addrs:
+	addrs = sorted(addrs)
+	try:
+		proc = subprocess.Popen([options.addr2line, "-f", "-e", options.elf] + ["0x%x" % a for a in addrs], stdout=subprocess.PIPE, universal_newlines=True)
+		lines = proc.communicate()[0].splitlines()
+		for i in range(min(len(addrs), len(lines) // 2)):
+			func = lines[2 * i]
+			where = lines[2 * i + 1].split("/")[-1]
+			if func != "??":
+				symbols[addrs[i]] = "%s (%s)" % (func, where)
+	except OSError:
+		sys.stderr.write("warning: cannot run %s, call sites are not symbolized\n" % options.addr2line)
+
+###########################################################################
+# Build the folded stacks
+###########################################################################
+
+stacks = {}
+
+def add(stack, weight):
+	if weight > 0:
+		stacks[stack] = stacks.get(stack, 0) + weight
+
+if options.mode == "alloc":
+	for (kind, pid, caller, size) in events:
+		if kind == "A":
+			add("pid %d;%s" % (pid, symbols[caller]), size)
+else:
+	for (caller, live, peak) in callers:
+		add("heap;%s" % symbols[caller], live if options.mode == "live" else peak)
+
+out = open(options.output, "w") if options.output else sys.stdout
+for stack in sorted(stacks):
+	out.write("%s %d\n" % (stack, stacks[stack]))
+if options.output:
+	out.close()
+
+if "size" in summary:
+	sys.stderr.write("heap %d used %d peak %d free %d largest %d frag %d%%\n" %
+	                 (summary["size"], summary["used"], summary["peak"], summary["free"], summary["largest"], summary["frag"]))
+
+###########################################################################
+# Draw the flame graph
+###########################################################################
+
+def escape(s):
+	return s.replace("&", "&amp;").replace("<", "&lt;").replace(">", "&gt;")
+
+def draw(svg, tree, x, depth, scale, height):
+	for name in sorted(tree, key=lambda n: -tree[n][0]):
+		(weight, children) = tree[name]
+		width = weight * scale
+		y = height - (depth + 1) * 18
+		hue = 20 + sum([ord(c) for c in name]) % 40
+		svg.write('<g><title>%s: %d bytes</title>' % (escape(name), weight))
+		svg.write('<rect x="%.1f" y="%d" width="%.1f" height="17" fill="hsl(%d,90%%,55%%)"/>' % (x, y, width, hue))
+		if width > 40:
+			label = name[:int(width / 7)]
+			svg.write('<text x="%.1f" y="%d" font-size="12" font-family="monospace">%s</text>' % (x + 3, y + 13, escape(label)))
+		svg.write('</g>\n')
+		draw(svg, children, x, depth + 1, scale, height)
+		x += width
+
+if options.svg:
+	tree = {}
+	for stack in stacks:
+		node = tree
+		for frame in stack.split(";"):
+			if frame not in node:
+				node[frame] = [0, {}]
+			node[frame][0] += stacks[stack]
+			node = node[frame][1]
+
+	total = sum(stacks.values())
+	width = 1200
+	height = 18 * (max([s.count(";") for s in stacks] + [0]) + 1) + 40
+	svg = open(options.svg, "w")
+	svg.write('<?xml version="1.0" standalone="no"?>\n')
+	svg.write('<svg version="1.1" width="%d" height="%d" xmlns="http://www.w3.org/2000/svg">\n' % (width, height))
+	svg.write('<text x="10" y="20" font-size="14" font-family="sans-serif">%s heap, %d bytes</text>\n' % (options.mode, total))
+	if total > 0:
+		draw(svg, tree, 0.0, 0, float(width) / total, height)
+	svg.write('</svg>\n')
+	svg.close()
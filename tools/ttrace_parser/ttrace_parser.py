@@ -0,0 +1,317 @@
+#!/usr/bin/env python
+###########################################################################
+#
+# Copyright 2016 Samsung Electronics All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+# either express or implied. See the License for the specific
+# language governing permissions and limitations under the License.
+#
+###########################################################################
+#
+# ttrace_parser.py converts a dump of the T-trace buffer into a Chrome
+# trace-event JSON file or a Perfetto protobuf trace, both of which can be
+# opened in ui.perfetto.dev or chrome://tracing.
+#
+# Example: ttrace_parser.py -f ttrace.bin -o ttrace.json
+#          ttrace_parser.py -f ttrace.bin -p -o ttrace.pftrace
+
+import sys
+import json
+import struct
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("-f", "--file", dest="infilename", help="dump of the trace buffer to be parsed", metavar="INPUT_FILE")
+parser.add_option("-o", "--output", dest="output", help="trace written to this file", metavar="OUTPUT_FILE")
+parser.add_option("-p", "--perfetto", dest="perfetto", action="store_true", default=False, help="write a Perfetto protobuf trace instead of Chrome JSON")
+parser.add_option("-l", "--legacy", dest="legacy", action="store_true", default=False, help="the dump holds struct trace_packet, CONFIG_TTRACE_COMPACT was not set")
+parser.add_option("-c", "--clock", dest="clock", type="float", help="trace clock frequency in Hz. Default is derived from the SYNC records.", metavar="HZ")
+
+(options, args) = parser.parse_args()
+if not options.infilename or not options.output:
+	parser.print_help()
+	sys.exit(1)
+
+data = bytearray(open(options.infilename, "rb").read())
+
+# Events are (time in usec, kind, pid, arguments), kind is one of
+# "B" (begin, name), "E" (end) and "S" (switch, next pid).
+
+events = []
+names = {0: "Idle Task"}
+dropped = 0
+
+###########################################################################
+# Compact records
+###########################################################################
+
+REC_SYNC = 1
+REC_TASK = 2
+REC_BEGIN = 3
+REC_BEGIN_U = 4
+REC_END = 5
+REC_SCHED = 6
+
+def varint(buf, off):
+	value = 0
+	shift = 0
+	while True:
+		byte = buf[off]
+		off += 1
+		value |= (byte & 0x7f) << shift
+		shift += 7
+		if byte & 0x80 == 0 or shift >= 35:
+			return (value, off)
+
+def parse_compact():
+	global dropped
+
+	# First pass: split the records and follow the trace clock.  'cycles'
+	# is the trace clock without wrap-around, rebuilt at each SYNC record
+	# from its counter value and from the system ticks elapsed since the
+	# previous one.
+
+	records = []
+	syncs = []
+	cycles = 0
+	off = 0
+	while off + 2 <= len(data):
+		length = data[off]
+		if length <= 2 or off + length > len(data):
+			sys.stderr.write("warning: truncated record at offset %d\n" % off)
+			break
+		rec = data[off:off + length]
+		off += length
+
+		(delta, pos) = varint(rec, 2)
+		cycles += delta
+		if rec[1] == REC_SYNC:
+			(ticks, pos) = varint(rec, pos)
+			(usec, pos) = varint(rec, pos)
+			(lost, pos) = varint(rec, pos)
+			counter = struct.unpack_from("<I", rec, pos)[0]
+			syncs.append([cycles, ticks * usec, counter])
+			dropped = max(dropped, lost)
+		records.append((cycles, rec, pos))
+
+	# Trace clock frequency, in counts per usec.  Without a cycle counter,
+	# the trace clock is the system tick and this gives 1 / USEC_PER_TICK.
+
+	freq = options.clock / 1000000.0 if options.clock else None
+	if freq is None:
+		total_counts = 0
+		total_usec = 0
+		for i in range(1, len(syncs)):
+			dt = syncs[i][1] - syncs[i - 1][1]
+			if 0 < dt <= 2000000:
+				total_counts += (syncs[i][2] - syncs[i - 1][2]) & 0xffffffff
+				total_usec += dt
+		if total_usec > 0 and total_counts > 0:
+			freq = float(total_counts) / total_usec
+		else:
+			sys.stderr.write("warning: no SYNC records close enough to derive the trace clock, use -c\n")
+			freq = 1.0
+
+	# Unwrap the counter at each SYNC: the number of wrap-arounds since the
+	# previous SYNC is the one that best matches the elapsed ticks.
+
+	shift = {}
+	base = syncs[0] if syncs else [0, 0, 0]
+	anchor = base[0]
+	for i in range(1, len(syncs)):
+		raw = (syncs[i][2] - syncs[i - 1][2]) & 0xffffffff
+		expected = (syncs[i][1] - syncs[i - 1][1]) * freq
+		wraps = max(0, int(round((expected - raw) / 4294967296.0)))
+		unwrapped = syncs[i - 1][0] + shift.get(i - 1, 0) + raw + wraps * 4294967296
+		shift[i] = unwrapped - syncs[i][0]
+
+	# Second pass: decode the records with absolute times
+
+	nsync = -1
+	for (cycles, rec, pos) in records:
+		kind = rec[1]
+		if kind == REC_SYNC:
+			nsync += 1
+		time = base[1] + (cycles + shift.get(max(nsync, 0), 0) - anchor) / freq
+
+		if kind == REC_SYNC:
+			continue
+		(pid, pos) = varint(rec, pos)
+		if kind == REC_TASK:
+			names[pid] = rec[pos:].decode("ascii", "replace")
+		elif kind == REC_BEGIN:
+			events.append((time, "B", pid, rec[pos:].decode("ascii", "replace")))
+		elif kind == REC_BEGIN_U:
+			events.append((time, "B", pid, "uid %d" % rec[pos]))
+		elif kind == REC_END:
+			events.append((time, "E", pid, None))
+		elif kind == REC_SCHED:
+			(nextpid, pos) = varint(rec, pos + 2)
+			events.append((time, "S", pid, nextpid))
+
+	sys.stderr.write("%d records, %d SYNC, trace clock %.3f MHz, %d dropped\n" % (len(records), len(syncs), freq, dropped))
+
+###########################################################################
+# struct trace_packet
+###########################################################################
+
+def cstring(buf):
+	return bytes(buf).split(b"\0")[0].decode("ascii", "replace")
+
+def parse_legacy():
+	# 8 bytes of timeval, pid, event type, codelen, pad and a 32 bytes message
+	# that is left out when the packet carries a unique code.
+
+	off = 0
+	count = 0
+	while off + 16 <= len(data):
+		(sec, usec, pid, event, codelen) = struct.unpack_from("<iihcb", data, off)
+		time = sec * 1000000 + usec
+		count += 1
+		if codelen & 0x80:
+			if event == b"b":
+				events.append((time, "B", pid, "uid %d" % (codelen & 0x7f)))
+			else:
+				events.append((time, "E", pid, None))
+			off += 16
+			continue
+
+		msg = data[off + 16:off + 48]
+		off += 48
+		if event == b"s":
+			(prevpid, nextpid) = struct.unpack_from("<h", msg, 0)[0], struct.unpack_from("<h", msg, 16)[0]
+			names[prevpid] = cstring(msg[4:16])
+			names[nextpid] = cstring(msg[20:32])
+			events.append((time, "S", prevpid, nextpid))
+		elif event == b"b":
+			events.append((time, "B", pid, cstring(msg)))
+		else:
+			events.append((time, "E", pid, None))
+
+	sys.stderr.write("%d packets\n" % count)
+
+if options.legacy:
+	parse_legacy()
+else:
+	parse_compact()
+
+###########################################################################
+# Slices
+###########################################################################
+
+# Task slices are shown as threads of one process, the task that runs on
+# the CPU as slices of a CPU track of another process.
+
+TASKS_PID = 10000
+CPU_PID = 10001
+
+def task_name(pid):
+	return names.get(pid, "pid %d" % pid)
+
+slices = []         # (time, "B" or "E", pid, name), pid None for the CPU track
+running = None
+for (time, kind, pid, arg) in events:
+	if kind == "S":
+		if running is not None:
+			slices.append((time, "E", None, None))
+		running = arg
+		slices.append((time, "B", None, task_name(arg)))
+	else:
+		slices.append((time, kind, pid, arg))
+
+if running is not None and events:
+	slices.append((events[-1][0], "E", None, None))
+
+pids = sorted(set([s[2] for s in slices if s[2] is not None]))
+
+###########################################################################
+# Chrome trace-event JSON
+###########################################################################
+
+def write_json(out):
+	trace = []
+	trace.append({"ph": "M", "name": "process_name", "pid": TASKS_PID, "tid": 0, "args": {"name": "TinyAra"}})
+	trace.append({"ph": "M", "name": "process_name", "pid": CPU_PID, "tid": 0, "args": {"name": "CPU"}})
+	trace.append({"ph": "M", "name": "thread_name", "pid": CPU_PID, "tid": 0, "args": {"name": "cpu0"}})
+	for pid in pids:
+		trace.append({"ph": "M", "name": "thread_name", "pid": TASKS_PID, "tid": pid, "args": {"name": task_name(pid)}})
+
+	for (time, kind, pid, name) in slices:
+		event = {"ph": kind, "ts": round(time, 3)}
+		if pid is None:
+			event["pid"] = CPU_PID
+			event["tid"] = 0
+		else:
+			event["pid"] = TASKS_PID
+			event["tid"] = pid
+		if name is not None:
+			event["name"] = name
+		trace.append(event)
+
+	json.dump({"traceEvents": trace, "displayTimeUnit": "ns"}, out)
+
+###########################################################################
+# Perfetto protobuf
+###########################################################################
+
+def pb_varint(value):
+	out = bytearray()
+	while value >= 0x80:
+		out.append((value & 0x7f) | 0x80)
+		value >>= 7
+	out.append(value)
+	return out
+
+def pb_int(field, value):
+	return pb_varint(field << 3) + pb_varint(value)
+
+def pb_bytes(field, value):
+	if not isinstance(value, (bytes, bytearray)):
+		value = value.encode("utf-8")
+	return pb_varint((field << 3) | 2) + pb_varint(len(value)) + value
+
+SEQUENCE_ID = 1
+SLICE_BEGIN = 1
+SLICE_END = 2
+CPU_UUID = 1
+
+def pb_packet(body):
+	return pb_bytes(1, pb_int(10, SEQUENCE_ID) + body)
+
+def pb_track(uuid, name, pid, tid=None):
+	if tid is None:
+		desc = pb_bytes(3, pb_int(1, pid) + pb_bytes(6, name))
+	else:
+		desc = pb_bytes(4, pb_int(1, pid) + pb_int(2, tid) + pb_bytes(5, name))
+	return pb_packet(pb_bytes(60, pb_int(1, uuid) + pb_bytes(2, name) + desc))
+
+def write_perfetto(out):
+	out.write(pb_track(2, "TinyAra", TASKS_PID))
+	out.write(pb_track(3, "CPU", CPU_PID))
+	out.write(pb_track(CPU_UUID, "cpu0", CPU_PID, 0))
+	for pid in pids:
+		out.write(pb_track(100 + pid, task_name(pid), TASKS_PID, pid))
+
+	for (time, kind, pid, name) in slices:
+		event = pb_int(9, SLICE_BEGIN if kind == "B" else SLICE_END)
+		event += pb_int(11, CPU_UUID if pid is None else 100 + pid)
+		if name is not None:
+			event += pb_bytes(23, name)
+		out.write(pb_packet(pb_int(8, max(0, int(time * 1000))) + pb_bytes(11, event)))
+
+if options.perfetto:
+	out = open(options.output, "wb")
+	write_perfetto(out)
+else:
+	out = open(options.output, "w")
+	write_json(out)
+out.close()